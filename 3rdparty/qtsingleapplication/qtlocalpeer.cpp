@@ -66,6 +66,8 @@ namespace QtLP_Private {
 }
 
 const char* QtLocalPeer::ack = "ack";
+// Message with this prefix is answered by reply instead of ack
+const char* QtLocalPeer::requestTag = "qtlp-request:";
 
 QtLocalPeer::QtLocalPeer(QObject* parent, const QString &appId)
     : QObject(parent), id(appId)
@@ -133,17 +135,13 @@ bool QtLocalPeer::isClient()
 }
 
 
-bool QtLocalPeer::sendMessage(const QString &message, int timeout)
+bool QtLocalPeer::writeMessage(QLocalSocket *socket, const QString &message, int timeout)
 {
-    if (!isClient())
-        return false;
-
-    QLocalSocket socket;
     bool connOk = false;
     for(int i = 0; i < 2; i++) {
         // Try twice, in case the other instance is just starting up
-        socket.connectToServer(socketName);
-        connOk = socket.waitForConnected(timeout/2);
+        socket->connectToServer(socketName);
+        connOk = socket->waitForConnected(timeout/2);
         if (connOk || i)
             break;
         int ms = 250;
@@ -158,9 +156,19 @@ bool QtLocalPeer::sendMessage(const QString &message, int timeout)
         return false;
 
     QByteArray uMsg(message.toUtf8());
-    QDataStream ds(&socket);
+    QDataStream ds(socket);
     ds.writeBytes(uMsg.constData(), uMsg.size());
-    bool res = socket.waitForBytesWritten(timeout);
+    return socket->waitForBytesWritten(timeout);
+}
+
+
+bool QtLocalPeer::sendMessage(const QString &message, int timeout)
+{
+    if (!isClient())
+        return false;
+
+    QLocalSocket socket;
+    bool res = writeMessage(&socket, message, timeout);
     if (res) {
         res &= socket.waitForReadyRead(timeout);   // wait for ack
         if (res)
@@ -170,6 +178,32 @@ bool QtLocalPeer::sendMessage(const QString &message, int timeout)
 }
 
 
+bool QtLocalPeer::sendRequest(const QString &request, QString *reply, int timeout)
+{
+    if (!isClient())
+        return false;
+
+    QLocalSocket socket;
+    if (!writeMessage(&socket, QLatin1String(requestTag) + request, timeout))
+        return false;
+
+    // Reply is sent with the same framing as message
+    while (socket.bytesAvailable() < (int)sizeof(quint32)) {
+        if (!socket.waitForReadyRead(timeout))
+            return false;
+    }
+    QDataStream ds(&socket);
+    quint32 size;
+    ds >> size;
+    while (socket.bytesAvailable() < (qint64)size) {
+        if (!socket.waitForReadyRead(timeout))
+            return false;
+    }
+    *reply = QString::fromUtf8(socket.read(size));
+    return true;
+}
+
+
 void QtLocalPeer::receiveConnection()
 {
     QLocalSocket* socket = server->nextPendingConnection();
@@ -196,6 +230,17 @@ void QtLocalPeer::receiveConnection()
         return;
     }
     QString message(QString::fromUtf8(uMsg));
+    if (message.startsWith(QLatin1String(requestTag))) {
+        QString reply;
+        emit requestReceived(message.mid(qstrlen(requestTag)), &reply);
+        QByteArray uReply(reply.toUtf8());
+        QDataStream rds(socket);
+        rds.writeBytes(uReply.constData(), uReply.size());
+        socket->waitForBytesWritten(1000);
+        socket->waitForDisconnected(1000);
+        delete socket;
+        return;
+    }
     socket->write(ack, qstrlen(ack));
     socket->waitForBytesWritten(1000);
     socket->waitForDisconnected(1000); // make sure client reads ack
@@ -55,11 +55,13 @@ public:
     QtLocalPeer(QObject *parent = 0, const QString &appId = QString());
     bool isClient();
     bool sendMessage(const QString &message, int timeout);
+    bool sendRequest(const QString &request, QString *reply, int timeout);
     QString applicationId() const
         { return id; }
 
 Q_SIGNALS:
     void messageReceived(const QString &message);
+    void requestReceived(const QString &request, QString *reply);
 
 protected Q_SLOTS:
     void receiveConnection();
@@ -71,7 +73,9 @@ protected:
     QtLP_Private::QtLockedFile lockFile;
 
 private:
+    bool writeMessage(QLocalSocket *socket, const QString &message, int timeout);
     static const char* ack;
+    static const char* requestTag;
 };
 
 #endif // QTLOCALPEER_H
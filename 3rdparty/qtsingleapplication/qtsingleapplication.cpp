@@ -138,6 +138,7 @@ void QtSingleApplication::sysInit(const QString &appId)
     actWin = 0;
     peer = new QtLocalPeer(this, appId);
     connect(peer, SIGNAL(messageReceived(const QString&)), SIGNAL(messageReceived(const QString&)));
+    connect(peer, SIGNAL(requestReceived(const QString&,QString*)), SIGNAL(requestReceived(const QString&,QString*)));
 }
 
 
@@ -262,6 +263,25 @@ bool QtSingleApplication::sendMessage(const QString &message, int timeout)
 }
 
 
+/*!
+    Sends the text \a request to the currently running instance and
+    waits for its answer. The QtSingleApplication object in the running
+    instance emits the requestReceived() signal, the text set by the
+    receiver is returned in \a reply. Receiver must be connected
+    directly, the reply is sent when the signal returns.
+
+    This function returns false if there is no instance currently
+    running or if the answer is not received within \a timeout
+    milliseconds.
+
+    \sa sendMessage(), requestReceived()
+*/
+bool QtSingleApplication::sendRequest(const QString &request, QString *reply, int timeout)
+{
+    return peer->sendRequest(request, reply, timeout);
+}
+
+
 /*!
     Returns the application identifier. Two processes with the same
     identifier will be regarded as instances of the same application.
@@ -89,11 +89,13 @@ public:
 
 public Q_SLOTS:
     bool sendMessage(const QString &message, int timeout = 5000);
+    bool sendRequest(const QString &request, QString *reply, int timeout = 5000);
     void activateWindow();
 
 
 Q_SIGNALS:
     void messageReceived(const QString &message);
+    void requestReceived(const QString &request, QString *reply);
 
 
 private:
@@ -7,6 +7,7 @@ INCLUDEPATH += $$PWD \
 os2|win32|mac {
   CONFIG(release, debug|release):DEFINES *= NDEBUG
   DEFINES += SQLITE_OMIT_LOAD_EXTENSION SQLITE_OMIT_COMPLETE
+  DEFINES += SQLITE_ENABLE_FTS5
 
   HEADERS +=      $$PWD/sqlite/sqlite3.h
   SOURCES +=      $$PWD/sqlite/sqlite3.c
@@ -19,8 +20,10 @@ os2|win32|mac {
 
 HEADERS += $$PWD/sqlitex/sqlcachedresult.h \
            $$PWD/sqlitex/sqlitedriver.h \
-           $$PWD/sqlitex/sqliteextension.h
+           $$PWD/sqlitex/sqliteextension.h \
+           $$PWD/sqlitex/sqlitestatement.h
 
 SOURCES += $$PWD/sqlitex/sqlcachedresult.cpp \
            $$PWD/sqlitex/sqlitedriver.cpp \
-           $$PWD/sqlitex/sqliteextension.cpp
+           $$PWD/sqlitex/sqliteextension.cpp \
+           $$PWD/sqlitex/sqlitestatement.cpp
@@ -23,9 +23,28 @@
 
 #include <qvariant.h>
 #include <qdatetime.h>
+#include <qmutex.h>
 #include <qvector.h>
 
 static const uint initial_cache_size = 128;
+// Part of cache window read ahead in fetch()
+static const int prefetch_divider = 64;
+// Change of cache size added to total of all results at once
+static const qint64 account_step = 65536;
+// Backward seeks before cache window after which all rows are cached
+static const int rewind_max = 8;
+
+static QMutex cachedBytesMutex;
+static qint64 totalCachedBytes = 0;
+
+static inline qint64 payloadBytes(const QVariant &value)
+{
+  if (value.type() == QVariant::String)
+    return value.toString().size() * sizeof(QChar);
+  if (value.type() == QVariant::ByteArray)
+    return value.toByteArray().size();
+  return 0;
+}
 
 class SqlCachedResultPrivate
 {
@@ -37,17 +56,59 @@ public:
   void cleanup();
   int nextIndex();
   void revertLast();
+  qint64 cellsPayload(int from, int count) const;
+  void account();
 
   SqlCachedResult::ValueCache cache;
   int rowCacheEnd;
   int colCount;
   bool forwardOnly;
   bool atEnd;
+  // Window mode: only rows from windowStart are kept in cache,
+  // at most windowRows of them. Window is turned off for current result
+  // set after rewind_max rewinds, windowLimit is restored on next one
+  int windowStart;
+  int windowRows;
+  int windowLimit;
+  int rewinds;
+  // Keys of rows read by first pass in window mode, set if rows read
+  // again after rewind differ from them
+  QVector<qint64> rowKeys;
+  bool changed;
+  // Text and data of cached rows, and size last added to total
+  qint64 payload;
+  qint64 reported;
 };
 
 SqlCachedResultPrivate::SqlCachedResultPrivate():
-  rowCacheEnd(0), colCount(0), forwardOnly(false), atEnd(false)
+  rowCacheEnd(0), colCount(0), forwardOnly(false), atEnd(false),
+  windowStart(0), windowRows(0), windowLimit(0), rewinds(0),
+  changed(false), payload(0), reported(0)
+{
+}
+
+qint64 SqlCachedResultPrivate::cellsPayload(int from, int count) const
 {
+  qint64 bytes = 0;
+  for (int i = from; i < from + count; ++i)
+    bytes += payloadBytes(cache.at(i));
+  return bytes;
+}
+
+/**
+* Add change of cache size to total of all results, small changes are
+* collected first.
+*/
+void SqlCachedResultPrivate::account()
+{
+  qint64 current = cache.size() * qint64(sizeof(QVariant)) +
+      rowKeys.size() * qint64(sizeof(qint64)) + payload;
+  qint64 delta = current - reported;
+  if ((qAbs(delta) < account_step) && current)
+    return;
+  QMutexLocker locker(&cachedBytesMutex);
+  totalCachedBytes += delta;
+  reported = current;
 }
 
 void SqlCachedResultPrivate::cleanup()
@@ -57,6 +118,13 @@ void SqlCachedResultPrivate::cleanup()
   atEnd = false;
   colCount = 0;
   rowCacheEnd = 0;
+  windowStart = 0;
+  windowRows = windowLimit;
+  rewinds = 0;
+  rowKeys.clear();
+  changed = false;
+  payload = 0;
+  account();
 }
 
 void SqlCachedResultPrivate::init(int count, bool fo)
@@ -71,12 +139,21 @@ void SqlCachedResultPrivate::init(int count, bool fo)
   } else {
     cache.resize(initial_cache_size * count);
   }
+  account();
 }
 
 int SqlCachedResultPrivate::nextIndex()
 {
   if (forwardOnly)
     return 0;
+  // Drop older half of window
+  if (windowRows && (rowCacheEnd >= windowRows * colCount)) {
+    int dropRows = windowRows / 2;
+    payload -= cellsPayload(0, dropRows * colCount);
+    cache.remove(0, dropRows * colCount);
+    rowCacheEnd -= dropRows * colCount;
+    windowStart += dropRows;
+  }
   int newIdx = rowCacheEnd;
   if (newIdx + colCount > cache.size())
     cache.resize(qMin(cache.size() * 2, cache.size() + 10000));
@@ -87,9 +164,9 @@ int SqlCachedResultPrivate::nextIndex()
 
 bool SqlCachedResultPrivate::canSeek(int i) const
 {
-  if (forwardOnly || i < 0)
+  if (forwardOnly || i < windowStart)
     return false;
-  return rowCacheEnd >= (i + 1) * colCount;
+  return rowCacheEnd >= (i - windowStart + 1) * colCount;
 }
 
 void SqlCachedResultPrivate::revertLast()
@@ -103,7 +180,7 @@ inline int SqlCachedResultPrivate::cacheCount() const
 {
   Q_ASSERT(!forwardOnly);
   Q_ASSERT(colCount);
-  return rowCacheEnd / colCount;
+  return windowStart + rowCacheEnd / colCount;
 }
 
 //////////////
@@ -115,9 +192,28 @@ SqlCachedResult::SqlCachedResult(const QSqlDriver * db): QSqlResult (db)
 
 SqlCachedResult::~SqlCachedResult()
 {
+  d->cleanup();
   delete d;
 }
 
+/**
+* Rows read again after rewind differ from rows of first pass, so rows
+* of result moved since they were shown.
+*/
+bool SqlCachedResult::rowsChanged() const
+{
+  return d->changed;
+}
+
+/**
+* Approximate memory of rows cached by all results.
+*/
+qint64 SqlCachedResult::cachedBytes()
+{
+  QMutexLocker locker(&cachedBytesMutex);
+  return totalCachedBytes;
+}
+
 void SqlCachedResult::init(int colCount)
 {
   d->init(colCount, isForwardOnly());
@@ -147,9 +243,17 @@ bool SqlCachedResult::fetch(int i)
     setAt(i);
     return true;
   }
+  if (d->windowRows && ((i < d->windowStart) ||
+                        (!d->atEnd && (i >= d->cacheCount() + d->windowRows)))) {
+    if (!moveWindow(i))
+      return false;
+  }
   if (d->rowCacheEnd > 0)
     setAt(d->cacheCount());
-  while (at() < i + 1) {
+  // In window mode rows ahead of requested one are read too, so scrolling
+  // view does not step statement for every row
+  int last = d->windowRows ? (i + 1 + d->windowRows / prefetch_divider) : (i + 1);
+  while (at() < last) {
     if (!cacheNext()) {
       if (d->canSeek(i))
         break;
@@ -184,6 +288,8 @@ bool SqlCachedResult::fetchFirst()
     setAt(0);
     return true;
   }
+  if (d->windowStart > 0)
+    return fetch(0);
   return cacheNext();
 }
 
@@ -209,8 +315,8 @@ bool SqlCachedResult::fetchLast()
 
 QVariant SqlCachedResult::data(int i)
 {
-  int idx = d->forwardOnly ? i : at() * d->colCount + i;
-  if (i >= d->colCount || i < 0 || at() < 0 || idx >= d->rowCacheEnd)
+  int idx = d->forwardOnly ? i : (at() - d->windowStart) * d->colCount + i;
+  if (i >= d->colCount || i < 0 || at() < d->windowStart || idx >= d->rowCacheEnd)
     return QVariant();
 
   return d->cache.at(idx);
@@ -218,8 +324,8 @@ QVariant SqlCachedResult::data(int i)
 
 bool SqlCachedResult::isNull(int i)
 {
-  int idx = d->forwardOnly ? i : at() * d->colCount + i;
-  if (i >= d->colCount || i < 0 || at() < 0 || idx >= d->rowCacheEnd)
+  int idx = d->forwardOnly ? i : (at() - d->windowStart) * d->colCount + i;
+  if (i >= d->colCount || i < 0 || at() < d->windowStart || idx >= d->rowCacheEnd)
     return true;
 
   return d->cache.at(idx).isNull();
@@ -236,7 +342,101 @@ void SqlCachedResult::clearValues()
 {
   setAt(QSql::BeforeFirstRow);
   d->rowCacheEnd = 0;
+  d->windowStart = 0;
+  d->windowRows = d->windowLimit;
+  d->rewinds = 0;
+  d->rowKeys.clear();
+  d->changed = false;
   d->atEnd = false;
+  d->payload = 0;
+  d->account();
+}
+
+/**
+* Restart result set from first row. Needed in window mode to go back
+* to rows dropped from cache.
+*/
+bool SqlCachedResult::rewind()
+{
+  return false;
+}
+
+/**
+* Key of current row of statement which identifies it in result set,
+* 0 if rows are not checked after rewind.
+*/
+qint64 SqlCachedResult::rowKey()
+{
+  return 0;
+}
+
+/**
+* Remember key of \a row on first pass, compare it after rewind. Row which
+* is not \a found any more changes result too.
+*/
+void SqlCachedResult::checkRow(int row, bool found)
+{
+  if (d->forwardOnly || !d->windowLimit)
+    return;
+  if (row < d->rowKeys.count()) {
+    if (d->changed || (found && (d->rowKeys.at(row) == rowKey())))
+      return;
+    qWarning("SqlCachedResult: rows of result changed after rewind at row %d", row);
+    d->changed = true;
+  } else if (found && (row == d->rowKeys.count())) {
+    d->rowKeys.append(rowKey());
+  }
+}
+
+/**
+* Keep only \a rows rows around current position in cache instead of
+* all fetched rows. 0 disables window mode.
+*/
+void SqlCachedResult::setCacheWindow(int rows)
+{
+  d->windowLimit = rows;
+  d->windowRows = rows;
+}
+
+/**
+* Start cache window near row \a i, rows before it are skipped without
+* copying values.
+*
+* Seek before window rewinds result and steps again from first row, which
+* is O(n). After rewind_max of such seeks window is turned off and all
+* rows are cached, so random access keeps O(1) at cost of memory.
+*/
+bool SqlCachedResult::moveWindow(int i)
+{
+  int start = qMax(0, i - d->windowRows / 4);
+  int row = d->cacheCount();
+  if (start < row) {
+    if (++d->rewinds > rewind_max) {
+      qWarning("SqlCachedResult: %d backward seeks, cache window is turned off "
+               "for result of %d rows", rewind_max, row);
+      d->windowRows = 0;
+      start = 0;
+    }
+    if (!rewind())
+      return false;
+    row = 0;
+  }
+  d->atEnd = false;
+  d->rowCacheEnd = 0;
+  d->payload = 0;
+  while (row < start) {
+    if (!gotoNext(d->cache, -1)) {
+      checkRow(row, false);
+      d->windowStart = row;
+      d->atEnd = true;
+      return false;
+    }
+    checkRow(row, true);
+    ++row;
+  }
+  d->windowStart = start;
+  setAt(start - 1);
+  return true;
 }
 
 bool SqlCachedResult::cacheNext()
@@ -249,11 +449,19 @@ bool SqlCachedResult::cacheNext()
     d->cache.resize(d->colCount);
   }
 
-  if (!gotoNext(d->cache, d->nextIndex())) {
+  int newIdx = d->nextIndex();
+  if (!gotoNext(d->cache, newIdx)) {
     d->revertLast();
+    if (!isForwardOnly())
+      checkRow(d->cacheCount(), false);
     d->atEnd = true;
     return false;
   }
+  if (!isForwardOnly()) {
+    checkRow(d->cacheCount() - 1, true);
+    d->payload += d->cellsPayload(newIdx, d->colCount);
+    d->account();
+  }
   setAt(at() + 1);
   return true;
 }
@@ -36,6 +36,9 @@ public:
 
   typedef QVector<QVariant> ValueCache;
 
+  static qint64 cachedBytes();
+  bool rowsChanged() const;
+
 protected:
   SqlCachedResult(const QSqlDriver * db);
 
@@ -44,6 +47,13 @@ protected:
   void clearValues();
 
   virtual bool gotoNext(ValueCache &values, int index) = 0;
+  virtual bool rewind();
+  virtual qint64 rowKey();
+  // Backward seek before window is O(n): rows are stepped again from first
+  // one. After few of them the whole result set is cached instead.
+  // Statement is run again then, so rows are checked by rowKey() against
+  // the first pass and rowsChanged() tells if they differ.
+  void setCacheWindow(int rows);
 
   QVariant data(int i);
   bool isNull(int i);
@@ -64,6 +74,8 @@ protected:
 
 private:
   bool cacheNext();
+  bool moveWindow(int i);
+  void checkRow(int row, bool found);
   SqlCachedResultPrivate *d;
 };
 
@@ -33,6 +33,9 @@
 #include <qvector.h>
 #include <qdebug.h>
 #include <qsqldriverplugin.h>
+#include <qelapsedtimer.h>
+#include <qhash.h>
+#include <qmutex.h>
 
 #if defined Q_OS_WIN
 # include <qt_windows.h>
@@ -42,6 +45,14 @@
 
 #include <sqlite3.h>
 
+// Rows of select result kept in cache, older rows are fetched again on seek
+// from first row (O(n)). Results seeked back often stop using window.
+#define RESULT_CACHE_ROWS 4096
+// Maximum number of different statements kept in trace
+#define TRACE_MAX_STATEMENTS 1000
+// Length of statement text kept in trace
+#define TRACE_TEXT_SIZE 300
+
 #ifdef HAVE_QT5
 Q_DECLARE_OPAQUE_POINTER(sqlite3*)
 Q_DECLARE_OPAQUE_POINTER(sqlite3_stmt*)
@@ -92,6 +103,24 @@ static void trace( void* /*arg*/, const char* query )
 }
 #endif
 
+// Statements of all connections are traced together
+static bool traceEnabled_ = false;
+static QMutex traceMutex_;
+static QHash<QString, SQLiteStatementTrace> traceMap_;
+
+/* Returns trace entry of statement, locked traceMutex_ is expected */
+static SQLiteStatementTrace *traceEntry(const QString &key)
+{
+  QHash<QString, SQLiteStatementTrace>::iterator it = traceMap_.find(key);
+  if (it == traceMap_.end()) {
+    if (traceMap_.count() >= TRACE_MAX_STATEMENTS)
+      return 0;
+    it = traceMap_.insert(key, SQLiteStatementTrace());
+    it.value().sql = key;
+  }
+  return &it.value();
+}
+
 class SQLiteDriverPrivate
 {
 public:
@@ -101,6 +130,45 @@ public:
 };
 
 
+static int bindValue(sqlite3_stmt *stmt, int column, const QVariant &value)
+{
+  int res = SQLITE_OK;
+  if (value.isNull()) {
+    res = sqlite3_bind_null(stmt, column);
+  } else {
+    switch (value.type()) {
+    case QVariant::ByteArray: {
+      const QByteArray *ba = static_cast<const QByteArray*>(value.constData());
+      res = sqlite3_bind_blob(stmt, column, ba->constData(),
+                              ba->size(), SQLITE_STATIC);
+      break; }
+    case QVariant::Int:
+      res = sqlite3_bind_int(stmt, column, value.toInt());
+      break;
+    case QVariant::Double:
+      res = sqlite3_bind_double(stmt, column, value.toDouble());
+      break;
+    case QVariant::UInt:
+    case QVariant::LongLong:
+      res = sqlite3_bind_int64(stmt, column, value.toLongLong());
+      break;
+    case QVariant::String: {
+      // lifetime of string == lifetime of its qvariant
+      const QString *str = static_cast<const QString*>(value.constData());
+      res = sqlite3_bind_text16(stmt, column, str->utf16(),
+                                (str->size()) * sizeof(QChar), SQLITE_STATIC);
+      break; }
+    default: {
+      QString str = value.toString();
+      // SQLITE_TRANSIENT makes sure that sqlite buffers the data
+      res = sqlite3_bind_text16(stmt, column, str.utf16(),
+                                (str.size()) * sizeof(QChar), SQLITE_TRANSIENT);
+      break; }
+    }
+  }
+  return res;
+}
+
 class SQLiteResultPrivate
 {
 public:
@@ -110,20 +178,30 @@ public:
   // initializes the recordInfo and the cache
   void initColumns(bool emptyResultset);
   void finalize();
+  int countRows(const QVector<QVariant> &values);
+  void flushTrace();
 
   SQLiteResult* q;
   sqlite3 *access;
 
   sqlite3_stmt *stmt;
 
+  QString traceKey; // normalized statement, empty if not traced
+  bool traced; // execution is traced and not flushed yet
+  qint64 stepTime;
+  qint64 rows;
+
   bool skippedStatus; // the status of the fetchNext() that's skipped
   bool skipRow; // skip the next fetchNext()?
+  int rowCount; // rows of select result, -1 if not counted yet
+  int stepRows; // rows stepped since statement was reset
   QSqlRecord rInf;
   QVector<QVariant> firstRow;
 };
 
 SQLiteResultPrivate::SQLiteResultPrivate(SQLiteResult* res) : q(res), access(0),
-  stmt(0), skippedStatus(false), skipRow(false)
+  stmt(0), traced(false), stepTime(0), rows(0), skippedStatus(false), skipRow(false),
+  rowCount(-1), stepRows(0)
 {
 }
 
@@ -133,6 +211,8 @@ void SQLiteResultPrivate::cleanup()
   rInf.clear();
   skippedStatus = false;
   skipRow = false;
+  rowCount = -1;
+  stepRows = 0;
   q->setAt(QSql::BeforeFirstRow);
   q->setActive(false);
   q->cleanup();
@@ -143,10 +223,60 @@ void SQLiteResultPrivate::finalize()
   if (!stmt)
     return;
 
+  flushTrace();
+  traceKey.clear();
   sqlite3_finalize(stmt);
   stmt = 0;
 }
 
+/* Adds step statistics of finished or abandoned execution to trace */
+void SQLiteResultPrivate::flushTrace()
+{
+  if (!traced)
+    return;
+  traced = false;
+
+  int fullScanSteps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+
+  QMutexLocker locker(&traceMutex_);
+  SQLiteStatementTrace *trace = traceEntry(traceKey);
+  if (!trace)
+    return;
+  trace->execCount++;
+  trace->stepTime += stepTime;
+  trace->rows += rows;
+  if (fullScanSteps > 0) {
+    trace->fullScanCount++;
+    trace->fullScanSteps += fullScanSteps;
+  }
+}
+
+int SQLiteResultPrivate::countRows(const QVector<QVariant> &values)
+{
+  if (!stmt)
+    return -1;
+
+  QByteArray sql = QByteArray(sqlite3_sql(stmt)).trimmed();
+  while (sql.endsWith(';'))
+    sql.chop(1);
+  sql = "SELECT count(*) FROM (" + sql + "\n)";
+
+  sqlite3_stmt *countStmt = 0;
+  if (sqlite3_prepare_v2(access, sql.constData(), -1, &countStmt, 0) != SQLITE_OK) {
+    sqlite3_finalize(countStmt);
+    return -1;
+  }
+
+  int count = -1;
+  int res = SQLITE_OK;
+  for (int i = 0; (res == SQLITE_OK) && (i < values.count()); ++i)
+    res = bindValue(countStmt, i + 1, values.at(i));
+  if ((res == SQLITE_OK) && (sqlite3_step(countStmt) == SQLITE_ROW))
+    count = sqlite3_column_int(countStmt, 0);
+  sqlite3_finalize(countStmt);
+  return count;
+}
+
 void SQLiteResultPrivate::initColumns(bool emptyResultset)
 {
   int nCols = sqlite3_column_count(stmt);
@@ -225,10 +355,22 @@ bool SQLiteResultPrivate::fetchNext(SqlCachedResult::ValueCache &values, int idx
     q->setAt(QSql::AfterLastRow);
     return false;
   }
-  res = sqlite3_step(stmt);
+  if (traced) {
+    QElapsedTimer timer;
+    timer.start();
+    res = sqlite3_step(stmt);
+    stepTime += timer.nsecsElapsed() / 1000;
+    if (res == SQLITE_ROW)
+      rows++;
+    else
+      flushTrace();
+  } else {
+    res = sqlite3_step(stmt);
+  }
 
   switch (res) {
   case SQLITE_ROW:
+    stepRows++;
     // check to see if should fill out columns
     if (rInf.isEmpty())
       // must be first call.
@@ -276,7 +418,11 @@ bool SQLiteResultPrivate::fetchNext(SqlCachedResult::ValueCache &values, int idx
       // must be first call.
       initColumns(true);
     q->setAt(QSql::AfterLastRow);
+    // All rows are stepped in one read transaction, so they are the exact size
+    if (rowCount < 0)
+      rowCount = stepRows;
     sqlite3_reset(stmt);
+    stepRows = 0;
     return false;
   case SQLITE_CONSTRAINT:
   case SQLITE_ERROR:
@@ -306,6 +452,9 @@ SQLiteResult::SQLiteResult(const SQLiteDriver* db)
   d = new SQLiteResultPrivate(this);
   d->access = db->d->access;
   db->d->results.append(this);
+  // Sequential readers keep memory flat, random access like scrolling
+  // back in large view pays for rewinds until window is turned off
+  setCacheWindow(RESULT_CACHE_ROWS);
 }
 
 SQLiteResult::~SQLiteResult()
@@ -353,6 +502,10 @@ bool SQLiteResult::prepare(const QString &query)
 
   const void *pzTail = NULL;
 
+  QElapsedTimer timer;
+  if (traceEnabled_)
+    timer.start();
+
 #if (SQLITE_VERSION_NUMBER >= 3003011)
   int res = sqlite3_prepare16_v2(d->access, query.constData(), (query.size() + 1) * sizeof(QChar),
                                  &d->stmt, &pzTail);
@@ -375,6 +528,17 @@ bool SQLiteResult::prepare(const QString &query)
     d->finalize();
     return false;
   }
+
+  if (traceEnabled_) {
+    qint64 prepareTime = timer.nsecsElapsed() / 1000;
+    d->traceKey = SQLiteDriver::normalizeStatement(query);
+    QMutexLocker locker(&traceMutex_);
+    SQLiteStatementTrace *trace = traceEntry(d->traceKey);
+    if (trace) {
+      trace->prepareCount++;
+      trace->prepareTime += prepareTime;
+    }
+  }
   return true;
 }
 
@@ -384,10 +548,18 @@ bool SQLiteResult::exec()
 
   d->skippedStatus = false;
   d->skipRow = false;
+  d->rowCount = -1;
+  d->stepRows = 0;
   d->rInf.clear();
   clearValues();
   setLastError(QSqlError());
 
+  // Previous execution could be left before its last row
+  d->flushTrace();
+  d->traced = !d->traceKey.isEmpty();
+  d->stepTime = 0;
+  d->rows = 0;
+
   int res = sqlite3_reset(d->stmt);
   if (res != SQLITE_OK) {
     setLastError(qMakeError(d->access, QCoreApplication::translate("SQLiteResult",
@@ -398,42 +570,7 @@ bool SQLiteResult::exec()
   int paramCount = sqlite3_bind_parameter_count(d->stmt);
   if (paramCount == values.count()) {
     for (int i = 0; i < paramCount; ++i) {
-      res = SQLITE_OK;
-      const QVariant value = values.at(i);
-
-      if (value.isNull()) {
-        res = sqlite3_bind_null(d->stmt, i + 1);
-      } else {
-        switch (value.type()) {
-        case QVariant::ByteArray: {
-          const QByteArray *ba = static_cast<const QByteArray*>(value.constData());
-          res = sqlite3_bind_blob(d->stmt, i + 1, ba->constData(),
-                                  ba->size(), SQLITE_STATIC);
-          break; }
-        case QVariant::Int:
-          res = sqlite3_bind_int(d->stmt, i + 1, value.toInt());
-          break;
-        case QVariant::Double:
-          res = sqlite3_bind_double(d->stmt, i + 1, value.toDouble());
-          break;
-        case QVariant::UInt:
-        case QVariant::LongLong:
-          res = sqlite3_bind_int64(d->stmt, i + 1, value.toLongLong());
-          break;
-        case QVariant::String: {
-          // lifetime of string == lifetime of its qvariant
-          const QString *str = static_cast<const QString*>(value.constData());
-          res = sqlite3_bind_text16(d->stmt, i + 1, str->utf16(),
-                                    (str->size()) * sizeof(QChar), SQLITE_STATIC);
-          break; }
-        default: {
-          QString str = value.toString();
-          // SQLITE_TRANSIENT makes sure that sqlite buffers the data
-          res = sqlite3_bind_text16(d->stmt, i + 1, str.utf16(),
-                                    (str.size()) * sizeof(QChar), SQLITE_TRANSIENT);
-          break; }
-        }
-      }
+      res = bindValue(d->stmt, i + 1, values.at(i));
       if (res != SQLITE_OK) {
         setLastError(qMakeError(d->access, QCoreApplication::translate("SQLiteResult",
                                                                        "Unable to bind parameters"), QSqlError::StatementError, res));
@@ -462,9 +599,53 @@ bool SQLiteResult::gotoNext(SqlCachedResult::ValueCache& row, int idx)
   return d->fetchNext(row, idx, false);
 }
 
+// Step statement again from first row, bindings are kept by sqlite3_reset()
+bool SQLiteResult::rewind()
+{
+  if (!d->stmt)
+    return false;
+  if (sqlite3_reset(d->stmt) != SQLITE_OK)
+    return false;
+  d->skipRow = false;
+  d->stepRows = 0;
+  return true;
+}
+
+// Drop cached rows and step statement again, so rows committed after exec()
+// are seen without new prepare and bind
+bool SQLiteResult::refresh()
+{
+  if (!isActive() || !isSelect() || !rewind())
+    return false;
+  clearValues();
+  d->rowCount = -1;
+  setLastError(QSqlError());
+  // Step first row as exec() does, it opens read transaction for size()
+  d->skippedStatus = d->fetchNext(d->firstRow, 0, true);
+  return !lastError().isValid();
+}
+
+// First column identifies row, it is id of row for list queries
+qint64 SQLiteResult::rowKey()
+{
+  if (!d->stmt)
+    return 0;
+  if (sqlite3_column_type(d->stmt, 0) == SQLITE_INTEGER)
+    return sqlite3_column_int64(d->stmt, 0);
+  const char *text = reinterpret_cast<const char *>(sqlite3_column_text(d->stmt, 0));
+  return qHash(QByteArray::fromRawData(text, sqlite3_column_bytes(d->stmt, 0)));
+}
+
+// Counted on demand only, so views get row count without fetching all rows.
+// Count runs on same connection while statement is stepped and not reset,
+// so it reads same snapshot as cursor. After reset size is unknown.
 int SQLiteResult::size()
 {
-  return -1;
+  if (!isActive() || !isSelect())
+    return -1;
+  if ((d->rowCount < 0) && (d->stepRows > 0))
+    d->rowCount = d->countRows(boundValues());
+  return d->rowCount;
 }
 
 int SQLiteResult::numRowsAffected()
@@ -546,8 +727,8 @@ bool SQLiteDriver::hasFeature(DriverFeature f) const
   case SimpleLocking:
   case FinishQuery:
   case LowPrecisionNumbers:
-    return true;
   case QuerySize:
+    return true;
   case NamedPlaceholders:
   case BatchOperations:
   case EventNotifications:
@@ -590,6 +771,9 @@ bool SQLiteDriver::open(const QString & db, const QString &, const QString &, co
 
   sqlite3_enable_shared_cache(sharedCache);
 
+  // URI file names are used to attach archive read-only
+  openMode |= SQLITE_OPEN_URI;
+
   if (sqlite3_open_v2(db.toUtf8().constData(), &d->access, openMode, NULL) == SQLITE_OK) {
     sqlite3_busy_timeout(d->access, timeOut);
 #if defined(SQLITEDRIVER_DEBUG)
@@ -781,3 +965,69 @@ void SQLiteDriver::setLastError(const QSqlError& e)
 #endif
   QSqlDriver::setLastError(e);
 }
+
+/*
+   Tracing collects prepare and step times, returned rows and full table
+   scans of each statement. It is enabled before connections are used.
+*/
+void SQLiteDriver::setTraceEnabled(bool enabled)
+{
+  traceEnabled_ = enabled;
+}
+
+bool SQLiteDriver::isTraceEnabled()
+{
+  return traceEnabled_;
+}
+
+QList<SQLiteStatementTrace> SQLiteDriver::traceStatements()
+{
+  QMutexLocker locker(&traceMutex_);
+  return traceMap_.values();
+}
+
+void SQLiteDriver::clearTrace()
+{
+  QMutexLocker locker(&traceMutex_);
+  traceMap_.clear();
+}
+
+/*
+   Replaces literals with "?" and collapses spaces, so statements which
+   differ by values only are traced as one statement.
+*/
+QString SQLiteDriver::normalizeStatement(const QString &sql)
+{
+  QString text;
+  text.reserve(TRACE_TEXT_SIZE);
+  bool space = false;
+  const QChar *ch = sql.constData();
+  const QChar *end = ch + sql.size();
+  for (; (ch < end) && (text.size() < TRACE_TEXT_SIZE); ++ch) {
+    if (ch->isSpace()) {
+      space = !text.isEmpty();
+      continue;
+    }
+    if (space) {
+      text.append(QLatin1Char(' '));
+      space = false;
+    }
+
+    if (*ch == QLatin1Char('\'')) {
+      while ((ch + 1 < end) && (*(ch + 1) != QLatin1Char('\'')))
+        ++ch;
+      if (ch + 1 < end)
+        ++ch;
+      text.append(QLatin1Char('?'));
+    } else if (ch->isDigit() && (text.isEmpty() ||
+                                 !(text.at(text.size() - 1).isLetterOrNumber() ||
+                                   (text.at(text.size() - 1) == QLatin1Char('_'))))) {
+      while ((ch + 1 < end) && ((ch + 1)->isLetterOrNumber() || (*(ch + 1) == QLatin1Char('.'))))
+        ++ch;
+      text.append(QLatin1Char('?'));
+    } else {
+      text.append(*ch);
+    }
+  }
+  return text;
+}
@@ -33,6 +33,23 @@ class SQLiteDriverPrivate;
 class SQLiteResultPrivate;
 class SQLiteDriver;
 
+// Statistics of traced statement, times are in microseconds
+struct SQLiteStatementTrace
+{
+  SQLiteStatementTrace()
+    : prepareCount(0), prepareTime(0), execCount(0), stepTime(0),
+      rows(0), fullScanCount(0), fullScanSteps(0) {}
+
+  QString sql;
+  qint64 prepareCount;
+  qint64 prepareTime;
+  qint64 execCount;
+  qint64 stepTime;
+  qint64 rows;
+  qint64 fullScanCount;
+  qint64 fullScanSteps;
+};
+
 class SQLiteResult : public SqlCachedResult
 {
   friend class SQLiteDriver;
@@ -41,9 +58,12 @@ public:
   explicit SQLiteResult(const SQLiteDriver* db);
   ~SQLiteResult();
   QVariant handle() const;
+  bool refresh();
 
 protected:
   bool gotoNext(SqlCachedResult::ValueCache& row, int idx);
+  bool rewind();
+  qint64 rowKey();
   bool reset(const QString &query);
   bool prepare(const QString &query);
   bool exec();
@@ -89,6 +109,12 @@ public:
   QVariant handle() const;
   QString escapeIdentifier(const QString &identifier, IdentifierType) const;
 
+  static void setTraceEnabled(bool enabled);
+  static bool isTraceEnabled();
+  static QList<SQLiteStatementTrace> traceStatements();
+  static void clearTrace();
+  static QString normalizeStatement(const QString &sql);
+
 protected:
   void setLastError(const QSqlError& e);
 
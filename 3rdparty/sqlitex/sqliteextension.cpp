@@ -21,6 +21,7 @@
 
 #include "sqliteextension.h"
 
+#include <QByteArray>
 #include <QString>
 #include <QDebug>
 
@@ -76,10 +77,57 @@ static void upperFunction(sqlite3_context* context, int /*argc*/, sqlite3_value*
   sqlite3_result_text16(context, string.data(), -1, SQLITE_TRANSIENT);
 }
 
+// Shorter texts are not worth compressing
+#define COMPRESS_MIN_SIZE 256
+
+/**
+* Compress text with deflate. Result is BLOB, text is returned as is when it
+* is short or does not get smaller.
+*/
+static void compressFunction(sqlite3_context* context, int /*argc*/, sqlite3_value** argv)
+{
+  if (sqlite3_value_type(argv[0]) != SQLITE_TEXT) {
+    sqlite3_result_value(context, argv[0]);
+    return;
+  }
+
+  int len = sqlite3_value_bytes(argv[0]);
+  const unsigned char* data = sqlite3_value_text(argv[0]);
+  if (len < COMPRESS_MIN_SIZE) {
+    sqlite3_result_value(context, argv[0]);
+    return;
+  }
+
+  QByteArray compressed = qCompress(data, len);
+  if (compressed.size() >= len) {
+    sqlite3_result_value(context, argv[0]);
+    return;
+  }
+  sqlite3_result_blob(context, compressed.constData(), compressed.size(), SQLITE_TRANSIENT);
+}
+
+/**
+* Uncompress value compressed by compressFunction, other values are returned as is.
+*/
+static void uncompressFunction(sqlite3_context* context, int /*argc*/, sqlite3_value** argv)
+{
+  if (sqlite3_value_type(argv[0]) != SQLITE_BLOB) {
+    sqlite3_result_value(context, argv[0]);
+    return;
+  }
+
+  int len = sqlite3_value_bytes(argv[0]);
+  const unsigned char* data = static_cast<const unsigned char*>(sqlite3_value_blob(argv[0]));
+  QByteArray text = qUncompress(data, len);
+  sqlite3_result_text(context, text.constData(), text.size(), SQLITE_TRANSIENT);
+}
+
 void installSQLiteExtension( sqlite3* db )
 {
   sqlite3_create_collation( db, "LOCALE", SQLITE_UTF16, NULL, &localeCompare );
   sqlite3_create_collation( db, "NOCASE", SQLITE_UTF16, NULL, &nocaseCompare );
   sqlite3_create_function( db, "UPPER", 1, SQLITE_UTF16, NULL, &upperFunction, NULL, NULL );
   sqlite3_create_function( db, "regexp", 2, SQLITE_UTF16, NULL, &regexpFunction, NULL, NULL );
+  sqlite3_create_function( db, "compress", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, NULL, &compressFunction, NULL, NULL );
+  sqlite3_create_function( db, "uncompress", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, NULL, &uncompressFunction, NULL, NULL );
 }
@@ -0,0 +1,137 @@
+/**************************************************************************
+* Extensible SQLite driver for Qt4/Qt5
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This library is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License version 2.1
+* as published by the Free Software Foundation.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this library.  If not, see <https://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include "sqlitestatement.h"
+
+#include <qdebug.h>
+
+#include <sqlite3.h>
+
+SQLiteStatement::SQLiteStatement(sqlite3 *db, const QString &sql)
+  : db_(db), stmt_(0), done_(false)
+{
+  if (!db_)
+    return;
+  if (sqlite3_prepare16_v2(db_, sql.constData(), (sql.size() + 1) * sizeof(QChar),
+                           &stmt_, 0) != SQLITE_OK) {
+    qWarning() << "SQLiteStatement:" << lastError() << sql;
+    sqlite3_finalize(stmt_);
+    stmt_ = 0;
+  }
+}
+
+SQLiteStatement::~SQLiteStatement()
+{
+  sqlite3_finalize(stmt_);
+}
+
+QString SQLiteStatement::lastError() const
+{
+  if (!db_)
+    return QString("No connection");
+  return QString(reinterpret_cast<const QChar *>(sqlite3_errmsg16(db_)));
+}
+
+void SQLiteStatement::bind(int index, int value)
+{
+  sqlite3_bind_int(stmt_, index, value);
+}
+
+void SQLiteStatement::bind(int index, qint64 value)
+{
+  sqlite3_bind_int64(stmt_, index, value);
+}
+
+void SQLiteStatement::bind(int index, const QString &value)
+{
+  sqlite3_bind_text16(stmt_, index, value.utf16(), value.size() * sizeof(QChar),
+                      SQLITE_TRANSIENT);
+}
+
+/**
+* Step to next row. Statement is reset after the last row, so it is not
+* left holding read transaction and can be executed again.
+*/
+bool SQLiteStatement::next()
+{
+  if (!stmt_ || done_)
+    return false;
+
+  int res = sqlite3_step(stmt_);
+  if (res == SQLITE_ROW)
+    return true;
+  if (res != SQLITE_DONE)
+    qWarning() << "SQLiteStatement:" << lastError();
+  done_ = true;
+  sqlite3_reset(stmt_);
+  return false;
+}
+
+void SQLiteStatement::reset()
+{
+  if (!stmt_)
+    return;
+  sqlite3_reset(stmt_);
+  done_ = false;
+}
+
+bool SQLiteStatement::isNull(int column) const
+{
+  return sqlite3_column_type(stmt_, column) == SQLITE_NULL;
+}
+
+int SQLiteStatement::intValue(int column) const
+{
+  return sqlite3_column_int(stmt_, column);
+}
+
+qint64 SQLiteStatement::int64Value(int column) const
+{
+  return sqlite3_column_int64(stmt_, column);
+}
+
+double SQLiteStatement::doubleValue(int column) const
+{
+  return sqlite3_column_double(stmt_, column);
+}
+
+// Text is copied once from UTF-16 of SQLite into string
+QString SQLiteStatement::stringValue(int column) const
+{
+  const void *text = sqlite3_column_text16(stmt_, column);
+  if (!text)
+    return QString();
+  return QString(reinterpret_cast<const QChar *>(text),
+                 sqlite3_column_bytes16(stmt_, column) / sizeof(QChar));
+}
+
+// Views share data of SQLite and are valid until next step or reset
+QByteArray SQLiteStatement::utf8View(int column) const
+{
+  const char *text = reinterpret_cast<const char *>(sqlite3_column_text(stmt_, column));
+  if (!text)
+    return QByteArray();
+  return QByteArray::fromRawData(text, sqlite3_column_bytes(stmt_, column));
+}
+
+QByteArray SQLiteStatement::blobView(int column) const
+{
+  const char *data = static_cast<const char *>(sqlite3_column_blob(stmt_, column));
+  if (!data)
+    return QByteArray();
+  return QByteArray::fromRawData(data, sqlite3_column_bytes(stmt_, column));
+}
@@ -0,0 +1,90 @@
+/**************************************************************************
+* Extensible SQLite driver for Qt4/Qt5
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This library is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License version 2.1
+* as published by the Free Software Foundation.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this library.  If not, see <https://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef SQLITESTATEMENT_H
+#define SQLITESTATEMENT_H
+
+#include <QByteArray>
+#include <QString>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+/**
+* Prepared statement read by columns of known type.
+* Rows are not cached and values are not boxed into QVariant, so it is
+* meant for hot queries of fixed shape reading many rows. Text and blobs
+* can be taken as views valid until next step. Statements are not traced.
+*/
+class SQLiteStatement
+{
+public:
+  SQLiteStatement(sqlite3 *db, const QString &sql);
+  ~SQLiteStatement();
+
+  bool isValid() const { return stmt_ != 0; }
+  QString lastError() const;
+
+  void bind(int index, int value);
+  void bind(int index, qint64 value);
+  void bind(int index, const QString &value);
+  bool next();
+  void reset();
+
+  bool isNull(int column) const;
+  int intValue(int column) const;
+  qint64 int64Value(int column) const;
+  double doubleValue(int column) const;
+  QString stringValue(int column) const;
+  QByteArray utf8View(int column) const;
+  QByteArray blobView(int column) const;
+
+  template <typename T> T value(int column) const;
+
+  /**
+  * Decode next row into \a row by its read(const SQLiteStatement &).
+  * @return false if there are no more rows
+  */
+  template <typename Row> bool fetch(Row *row)
+  {
+    if (!next())
+      return false;
+    row->read(*this);
+    return true;
+  }
+
+private:
+  SQLiteStatement(const SQLiteStatement &);
+  SQLiteStatement &operator=(const SQLiteStatement &);
+
+  sqlite3 *db_;
+  sqlite3_stmt *stmt_;
+  bool done_;
+};
+
+template <> inline int SQLiteStatement::value<int>(int column) const
+{ return intValue(column); }
+template <> inline qint64 SQLiteStatement::value<qint64>(int column) const
+{ return int64Value(column); }
+template <> inline double SQLiteStatement::value<double>(int column) const
+{ return doubleValue(column); }
+template <> inline QString SQLiteStatement::value<QString>(int column) const
+{ return stringValue(column); }
+template <> inline QByteArray SQLiteStatement::value<QByteArray>(int column) const
+{ return blobView(column); }
+
+#endif
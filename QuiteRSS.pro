@@ -47,20 +47,38 @@ isEqual(QT_MAJOR_VERSION, 5) {
 
 unix:!mac:DEFINES += HAVE_X11
 
+# Replies of feeds are decoded by zlib, so their size on the wire is known
+isEmpty(DISABLE_ZLIB) {
+  DEFINES += HAVE_ZLIB
+  win32 {
+    # zlib bundled with Qt is exported by QtCore
+    INCLUDEPATH += $$[QT_INSTALL_HEADERS]/QtZlib
+  } else {
+    LIBS += -lz
+  }
+}
+
 TEMPLATE = app
 
 HEADERS += \
     src/VersionNo.h \
     src/parseobject.h \
+    src/parsebenchmark.h \
+    src/kernelbenchmark.h \
+    src/uibenchmark.h \
+    src/stressrun.h \
+    src/parseworker.h \
     src/optionsdialog.h \
     src/newsview/newsview.h \
     src/newsview/newsmodel.h \
     src/newsview/newsheader.h \
     src/aboutdialog.h \
+    src/pipelinemetricsdialog.h \
     src/updateappdialog.h \
     src/feedpropertiesdialog.h \
     src/addfeedwizard.h \
     src/newstabwidget.h \
+    src/htmltemplate.h \
     src/findtext.h \
     src/findfeed.h \
     src/feedsview/feedsview.h \
@@ -69,6 +87,8 @@ HEADERS += \
     src/addfolderdialog.h \
     src/labeldialog.h \
     src/faviconobject.h \
+    src/imageprefetcher.h \
+    src/articlefetcher.h \
     src/customizetoolbardialog.h \
     src/plugins/webpluginfactory.h \
     src/plugins/clicktoflash.h \
@@ -82,13 +102,20 @@ HEADERS += \
     src/notifications/notificationsfeeditem.h \
     src/notifications/notificationsnewsitem.h \
     src/notifications/notificationswidget.h \
+    src/notifications/soundpool.h \
     src/application/mainapplication.h \
     src/application/settings.h \
     src/application/logfile.h \
+    src/application/eventtrace.h \
+    src/application/pipelinemetrics.h \
+    src/application/memoryaccounting.h \
+    src/application/updatedaemon.h \
+    src/application/localapi.h \
     src/application/mainwindow.h \
     src/adblock/adblocktreewidget.h \
     src/adblock/adblocksubscription.h \
     src/adblock/adblocksearchtree.h \
+    src/adblock/adblockrulesindex.h \
     src/adblock/adblockrule.h \
     src/adblock/adblockmanager.h \
     src/adblock/adblockicon.h \
@@ -100,36 +127,57 @@ HEADERS += \
     src/network/authenticationdialog.h \
     src/network/cookiejar.h \
     src/network/networkmanager.h \
+    src/network/networkarchive.h \
+    src/network/thumbnailreply.h \
     src/webview/locationbar.h \
     src/webview/rssdetectionwidget.h \
     src/webview/webpage.h \
     src/webview/webview.h \
     src/database/database.h \
+    src/database/databasebackup.h \
+    src/database/databasegenerator.h \
+    src/database/newsexporter.h \
+    src/database/querycache.h \
+    src/database/asyncquery.h \
+    src/common/bytescan.h \
+    src/common/feedtags.h \
     src/common/common.h \
     src/common/delegatewithoutfocus.h \
     src/common/dialog.h \
+    src/common/jsonreader.h \
     src/common/lineedit.h \
     src/common/toolbutton.h \
     src/newsfilters/filterrulesdialog.h \
     src/newsfilters/newsfiltersdialog.h \
     src/newsfilters/itemcondition.h \
     src/newsfilters/itemaction.h \
+    src/newsfilters/filtermatcher.h \
     src/network/sslerrordialog.h \
     src/network/networkmanagerproxy.h \
+    src/network/websubclient.h \
+    src/syncrss/greadersync.h \
+    src/network/sharednetworkcache.h \
     src/adblock/adblockmatcher.h \
     src/feedsview/feedsproxymodel.h \
 
 SOURCES += \
     src/parseobject.cpp \
+    src/parsebenchmark.cpp \
+    src/kernelbenchmark.cpp \
+    src/uibenchmark.cpp \
+    src/stressrun.cpp \
+    src/parseworker.cpp \
     src/optionsdialog.cpp \
     src/newsview/newsview.cpp \
     src/newsview/newsmodel.cpp \
     src/newsview/newsheader.cpp \
     src/aboutdialog.cpp \
+    src/pipelinemetricsdialog.cpp \
     src/updateappdialog.cpp \
     src/feedpropertiesdialog.cpp \
     src/addfeedwizard.cpp \
     src/newstabwidget.cpp \
+    src/htmltemplate.cpp \
     src/findtext.cpp \
     src/findfeed.cpp \
     src/feedsview/feedsview.cpp \
@@ -137,6 +185,8 @@ SOURCES += \
     src/addfolderdialog.cpp \
     src/labeldialog.cpp \
     src/faviconobject.cpp \
+    src/imageprefetcher.cpp \
+    src/articlefetcher.cpp \
     src/customizetoolbardialog.cpp \
     src/plugins/webpluginfactory.cpp \
     src/plugins/clicktoflash.cpp \
@@ -150,14 +200,21 @@ SOURCES += \
     src/notifications/notificationsfeeditem.cpp \
     src/notifications/notificationsnewsitem.cpp \
     src/notifications/notificationswidget.cpp \
+    src/notifications/soundpool.cpp \
     src/application/mainapplication.cpp \
     src/application/settings.cpp \
     src/application/logfile.cpp \
+    src/application/eventtrace.cpp \
+    src/application/pipelinemetrics.cpp \
+    src/application/memoryaccounting.cpp \
+    src/application/updatedaemon.cpp \
+    src/application/localapi.cpp \
     src/application/mainwindow.cpp \
     src/main/main.cpp \
     src/adblock/adblocktreewidget.cpp \
     src/adblock/adblocksubscription.cpp \
     src/adblock/adblocksearchtree.cpp \
+    src/adblock/adblockrulesindex.cpp \
     src/adblock/adblockrule.cpp \
     src/adblock/adblockmanager.cpp \
     src/adblock/adblockicon.cpp \
@@ -169,22 +226,36 @@ SOURCES += \
     src/network/authenticationdialog.cpp \
     src/network/cookiejar.cpp \
     src/network/networkmanager.cpp \
+    src/network/networkarchive.cpp \
+    src/network/thumbnailreply.cpp \
     src/webview/locationbar.cpp \
     src/webview/rssdetectionwidget.cpp \
     src/webview/webpage.cpp \
     src/webview/webview.cpp \
     src/database/database.cpp \
+    src/database/databasebackup.cpp \
+    src/database/databasegenerator.cpp \
+    src/database/newsexporter.cpp \
+    src/database/querycache.cpp \
+    src/database/asyncquery.cpp \
+    src/common/bytescan.cpp \
+    src/common/feedtags.cpp \
     src/common/common.cpp \
     src/common/delegatewithoutfocus.cpp \
     src/common/dialog.cpp \
+    src/common/jsonreader.cpp \
     src/common/lineedit.cpp \
     src/common/toolbutton.cpp \
     src/newsfilters/filterrulesdialog.cpp \
     src/newsfilters/newsfiltersdialog.cpp \
     src/newsfilters/itemcondition.cpp \
     src/newsfilters/itemaction.cpp \
+    src/newsfilters/filtermatcher.cpp \
     src/network/sslerrordialog.cpp \
     src/network/networkmanagerproxy.cpp \
+    src/network/websubclient.cpp \
+    src/syncrss/greadersync.cpp \
+    src/network/sharednetworkcache.cpp \
     src/adblock/adblockmatcher.cpp \
     src/feedsview/feedsproxymodel.cpp
 
@@ -201,6 +272,7 @@ INCLUDEPATH +=  $$PWD/src \
                 $$PWD/src/plugins \
                 $$PWD/src/adblock \
                 $$PWD/src/network \
+                $$PWD/src/syncrss \
                 $$PWD/src/webview \
 
 CONFIG += debug_and_release
@@ -211,6 +283,12 @@ CONFIG(debug, debug|release) {
 #  DEFINES += QT_NO_DEBUG_OUTPUT
 }
 
+# Race detection of update threads, for --stress: qmake CONFIG+=tsan
+tsan {
+  QMAKE_CXXFLAGS += -fsanitize=thread -fno-omit-frame-pointer
+  QMAKE_LFLAGS += -fsanitize=thread
+}
+
 DESTDIR = $${BUILD_DIR}/target
 OBJECTS_DIR = $${BUILD_DIR}/obj
 MOC_DIR = $${BUILD_DIR}/moc
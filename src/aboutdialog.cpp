@@ -16,6 +16,7 @@
 * along with this program.  If not, see <https://www.gnu.org/licenses/>.
 * ============================================================ */
 #include "aboutdialog.h"
+#include "database.h"
 #include "mainapplication.h"
 #include "settings.h"
 #include "VersionNo.h"
@@ -138,6 +139,9 @@ AboutDialog::AboutDialog(const QString &lang, QWidget *parent) :
       "<td>" + tr("Database file:") + " </td>"
       "<td>" + mainApp->dbFileName() + "</td>"
       "</tr><tr>"
+      "<td valign=\"top\">" + tr("Database storage:") + " </td>"
+      "<td>" + Database::storageInfo().join("<br>") + "</td>"
+      "</tr><tr>"
       "<td>" + tr("Settings file:") + " </td>"
       "<td>" + settings.fileName() + "</td>"
       "</tr><tr>"
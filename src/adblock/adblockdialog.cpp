@@ -88,6 +88,11 @@ AdBlockDialog::AdBlockDialog(QWidget* parent)
   connect(tabWidget, SIGNAL(currentChanged(int)), this, SLOT(currentChanged(int)));
   connect(buttonBox, SIGNAL(accepted()), this, SLOT(close()));
 
+  QTimer* cacheStatsTimer = new QTimer(this);
+  connect(cacheStatsTimer, SIGNAL(timeout()), this, SLOT(updateCacheStats()));
+  cacheStatsTimer->start(1000);
+  updateCacheStats();
+
   load();
 
   buttonBox->setFocus();
@@ -216,6 +221,15 @@ void AdBlockDialog::load()
   QTimer::singleShot(50, this, SLOT(loadSubscriptions()));
 }
 
+void AdBlockDialog::updateCacheStats()
+{
+  const qint64 hits = m_manager->decisionCacheHits();
+  const qint64 total = hits + m_manager->decisionCacheMisses();
+  const int hitRate = (total > 0) ? int(hits * 100 / total) : 0;
+
+  cacheStatsLabel->setText(tr("Cache hits: %1 of %2 (%3%)").arg(hits).arg(total).arg(hitRate));
+}
+
 void AdBlockDialog::closeEvent(QCloseEvent* ev)
 {
   if (useLimitedEasyList->isChecked() != m_useLimitedEasyList) {
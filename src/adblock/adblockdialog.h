@@ -69,6 +69,7 @@ private slots:
 
   void loadSubscriptions();
   void load();
+  void updateCacheStats();
 
 private:
   void closeEvent(QCloseEvent* ev);
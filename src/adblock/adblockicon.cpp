@@ -54,14 +54,13 @@ AdBlockIcon::AdBlockIcon(MainWindow *window, QWidget *parent)
   setStyleSheet("QToolButton { border: none; padding: 0px; }");
 
   connect(this, SIGNAL(clicked(QPoint)), this, SLOT(showMenu(QPoint)));
-  connect(AdBlockManager::instance(), SIGNAL(enabledChanged(bool)), this, SLOT(setEnabled(bool)));
 }
 
 void AdBlockIcon::retranslateStrings()
 {
   setToolTip(tr("AdBlock lets you block unwanted content on web pages"));
 
-  if (!m_enabled)
+  if (!m_enabled || !AdBlockManager::isCreated())
     return;
 
   AdBlockManager::instance()->customList()->retranslateStrings();
@@ -70,6 +70,8 @@ AdBlockManager::AdBlockManager(QObject* parent)
 
 AdBlockManager::~AdBlockManager()
 {
+  // Wait for matcher update before rules are deleted
+  delete m_matcher;
   qDeleteAll(m_subscriptions);
 }
 
@@ -77,11 +79,21 @@ AdBlockManager* AdBlockManager::instance()
 {
   if (!s_adBlockManager) {
     s_adBlockManager = new AdBlockManager(mainApp->networkManager());
+    // Manager is created after main window on first use
+    if (mainApp->mainWindow()) {
+      connect(s_adBlockManager, SIGNAL(enabledChanged(bool)),
+              mainApp->mainWindow()->adBlockIcon(), SLOT(setEnabled(bool)));
+    }
   }
 
   return s_adBlockManager;
 }
 
+bool AdBlockManager::isCreated()
+{
+  return s_adBlockManager != 0;
+}
+
 void AdBlockManager::setEnabled(bool enabled)
 {
   if (m_enabled == enabled) {
@@ -118,7 +130,8 @@ QNetworkReply* AdBlockManager::block(const QNetworkRequest &request)
   if (!isEnabled() || !canRunOnScheme(urlScheme))
     return 0;
 
-  const AdBlockRule* blockedRule = m_matcher->match(request, urlDomain, urlString);
+  const AdBlockRequestInfo requestInfo(request, urlDomain, urlString);
+  const AdBlockRule* blockedRule = m_matcher->match(requestInfo, urlDomain, urlString);
 
   if (blockedRule) {
     QVariant v = request.attribute((QNetworkRequest::Attribute)(QNetworkRequest::User + 100));
@@ -148,6 +161,16 @@ QNetworkReply* AdBlockManager::block(const QNetworkRequest &request)
   return 0;
 }
 
+qint64 AdBlockManager::decisionCacheHits() const
+{
+  return m_matcher->decisionCacheHits();
+}
+
+qint64 AdBlockManager::decisionCacheMisses() const
+{
+  return m_matcher->decisionCacheMisses();
+}
+
 QStringList AdBlockManager::disabledRules() const
 {
   return m_disabledRules;
@@ -186,9 +209,9 @@ AdBlockSubscription* AdBlockManager::addSubscription(const QString &title, const
   AdBlockSubscription* subscription = new AdBlockSubscription(title, this);
   subscription->setUrl(QUrl(url));
   subscription->setFilePath(filePath);
-  subscription->loadSubscription(m_disabledRules);
 
   m_subscriptions.insert(m_subscriptions.count() - 1, subscription);
+  subscription->loadSubscription();
 
   return subscription;
 }
@@ -200,12 +223,26 @@ bool AdBlockManager::removeSubscription(AdBlockSubscription* subscription)
   }
 
   QFile(subscription->filePath()).remove();
+  QFile(AdBlockSubscription::cacheFilePath(subscription->filePath())).remove();
   m_subscriptions.removeOne(subscription);
 
+  m_matcher->retireRules(subscription->releaseRules());
+  m_matcher->update();
+
   delete subscription;
   return true;
 }
 
+void AdBlockManager::reloadSubscription(AdBlockSubscription* subscription)
+{
+  m_matcher->reloadSubscription(subscription);
+}
+
+void AdBlockManager::retireRules(const QVector<AdBlockRule*> &rules)
+{
+  m_matcher->retireRules(rules);
+}
+
 AdBlockCustomList* AdBlockManager::customList() const
 {
   foreach (AdBlockSubscription* subscription, m_subscriptions) {
@@ -292,7 +329,7 @@ void AdBlockManager::load()
 
   // Load all subscriptions
   foreach (AdBlockSubscription* subscription, m_subscriptions) {
-    subscription->loadSubscription(m_disabledRules);
+    subscription->loadSubscription();
 
     connect(subscription, SIGNAL(subscriptionUpdated()), mainApp, SLOT(reloadUserStyleBrowser()));
     connect(subscription, SIGNAL(subscriptionChanged()), m_matcher, SLOT(update()));
@@ -306,7 +343,6 @@ void AdBlockManager::load()
   qDebug() << "AdBlock loaded in" << timer.elapsed();
 #endif
 
-  m_matcher->update();
   m_loaded = true;
 }
 
@@ -37,6 +37,7 @@
 
 #include <QObject>
 #include <QStringList>
+#include <QVector>
 #include <QPointer>
 
 class QUrl;
@@ -58,6 +59,7 @@ public:
   ~AdBlockManager();
 
   static AdBlockManager* instance();
+  static bool isCreated();
 
   void load();
   void save();
@@ -76,6 +78,9 @@ public:
 
   QNetworkReply* block(const QNetworkRequest &request);
 
+  qint64 decisionCacheHits() const;
+  qint64 decisionCacheMisses() const;
+
   QStringList disabledRules() const;
   void addDisabledRule(const QString &filter);
   void removeDisabledRule(const QString &filter);
@@ -83,6 +88,9 @@ public:
   AdBlockSubscription* addSubscription(const QString &title, const QString &url);
   bool removeSubscription(AdBlockSubscription* subscription);
 
+  void reloadSubscription(AdBlockSubscription* subscription);
+  void retireRules(const QVector<AdBlockRule*> &rules);
+
   AdBlockCustomList* customList() const;
 
 signals:
@@ -36,53 +36,168 @@
 #include "adblockmanager.h"
 #include "adblockrule.h"
 #include "adblocksubscription.h"
+#include "mainapplication.h"
 #include "common.h"
+#include "memoryaccounting.h"
+
+#include <QThread>
+#include <QTimer>
+
+// Number of remembered decisions for network requests
+#define ADBLOCK_DECISION_CACHE_SIZE 2000
+// Number of remembered element hiding stylesheets for domains
+#define ADBLOCK_DOMAIN_CSS_CACHE_SIZE 100
+
+AdBlockMatcherData::~AdBlockMatcherData()
+{
+  qDeleteAll(createdRules);
+}
+
+qint64 AdBlockMatcherData::memoryUsage() const
+{
+  return rulesBytes + elementHidingRules.capacity() * sizeof(QChar) +
+      networkBlockTree.memoryUsage() + networkExceptionTree.memoryUsage() +
+      networkBlockIndex.memoryUsage() + networkExceptionIndex.memoryUsage();
+}
+
+AdBlockMatcherBuilder::AdBlockMatcherBuilder(const QList<Source> &sources, const QStringList &disabledRules)
+  : QObject(0)
+  , m_sources(sources)
+  , m_disabledRules(disabledRules.toSet())
+  , m_data(0)
+{
+}
+
+AdBlockMatcherBuilder::~AdBlockMatcherBuilder()
+{
+  delete m_data;
+  for (int i = 0; i < m_sources.count(); ++i) {
+    if (m_sources.at(i).reload)
+      qDeleteAll(m_sources.at(i).rules);
+  }
+}
+
+/** @brief Read changed subscriptions and build matcher data from all rules
+ *----------------------------------------------------------------------------*/
+void AdBlockMatcherBuilder::run()
+{
+  QVector<AdBlockRule*> rules;
+
+  for (int i = 0; i < m_sources.count(); ++i) {
+    Source &source = m_sources[i];
+    if (source.reload) {
+      source.loaded = AdBlockSubscription::readRules(source.subscription, source.filePath,
+                                                     m_disabledRules, source.rules);
+    }
+    rules += source.rules;
+  }
+
+  m_data = AdBlockMatcher::createData(rules);
+
+  emit finished();
+}
+
+QList<AdBlockMatcherBuilder::Source> AdBlockMatcherBuilder::takeSources()
+{
+  QList<Source> sources = m_sources;
+  m_sources.clear();
+  return sources;
+}
+
+AdBlockMatcherData* AdBlockMatcherBuilder::takeData()
+{
+  AdBlockMatcherData* data = m_data;
+  m_data = 0;
+  return data;
+}
 
 AdBlockMatcher::AdBlockMatcher(AdBlockManager* manager)
   : QObject(manager)
   , m_manager(manager)
+  , m_data(new AdBlockMatcherData)
+  , m_updateThread(0)
+  , m_builder(0)
+  , m_updateScheduled(false)
+  , m_domainCssCache(ADBLOCK_DOMAIN_CSS_CACHE_SIZE)
+  , m_decisionCache(ADBLOCK_DECISION_CACHE_SIZE)
+  , m_decisionCacheHits(0)
+  , m_decisionCacheMisses(0)
 {
   connect(manager, SIGNAL(enabledChanged(bool)), this, SLOT(enabledChanged(bool)));
 }
 
 AdBlockMatcher::~AdBlockMatcher()
 {
-  clear();
+  if (m_updateThread) {
+    m_updateThread->wait();
+    delete m_builder;
+    delete m_updateThread;
+  }
+
+  delete m_data;
+  qDeleteAll(m_updateRetiredRules);
+  qDeleteAll(m_retiredRules);
+  MemoryAccounting::remove(this);
 }
 
-const AdBlockRule* AdBlockMatcher::match(const QNetworkRequest &request, const QString &urlDomain, const QString &urlString) const
+/** @brief Find block rule for request using cache of previous decisions
+ *
+ * The same trackers, fonts and scripts are requested by many pages, so
+ * the result of matching is remembered for the request URL together with
+ * everything else rules check: request type options of request.
+ *----------------------------------------------------------------------------*/
+const AdBlockRule* AdBlockMatcher::match(const AdBlockRequestInfo &request, const QString &urlDomain, const QString &urlString) const
+{
+  QString key = QString::number((request.knownTypes() << 8) | request.types(), 16);
+  key.append(QLatin1Char('|'));
+  key.append(urlString);
+
+  if (Decision* decision = m_decisionCache.object(key)) {
+    m_decisionCacheHits++;
+    return decision->rule;
+  }
+
+  m_decisionCacheMisses++;
+
+  Decision* decision = new Decision;
+  decision->rule = matchRules(request, urlDomain, urlString);
+  m_decisionCache.insert(key, decision);
+
+  return decision->rule;
+}
+
+qint64 AdBlockMatcher::decisionCacheHits() const
+{
+  return m_decisionCacheHits;
+}
+
+qint64 AdBlockMatcher::decisionCacheMisses() const
+{
+  return m_decisionCacheMisses;
+}
+
+const AdBlockRule* AdBlockMatcher::matchRules(const AdBlockRequestInfo &request, const QString &urlDomain, const QString &urlString) const
 {
   // Exception rules
-  if (m_networkExceptionTree.find(request, urlDomain, urlString))
+  if (m_data->networkExceptionTree.find(request, urlDomain, urlString))
     return 0;
 
-  int count = m_networkExceptionRules.count();
-  for (int i = 0; i < count; ++i) {
-    const AdBlockRule* rule = m_networkExceptionRules.at(i);
-    if (rule->networkMatch(request, urlDomain, urlString))
-      return 0;
-  }
+  if (m_data->networkExceptionIndex.find(request, urlDomain, urlString))
+    return 0;
 
   // Block rules
-  if (const AdBlockRule* rule = m_networkBlockTree.find(request, urlDomain, urlString))
+  if (const AdBlockRule* rule = m_data->networkBlockTree.find(request, urlDomain, urlString))
     return rule;
 
-  count = m_networkBlockRules.count();
-  for (int i = 0; i < count; ++i) {
-    const AdBlockRule* rule = m_networkBlockRules.at(i);
-    if (rule->networkMatch(request, urlDomain, urlString))
-      return rule;
-  }
-
-  return 0;
+  return m_data->networkBlockIndex.find(request, urlDomain, urlString);
 }
 
 bool AdBlockMatcher::adBlockDisabledForUrl(const QUrl &url) const
 {
-  int count = m_documentRules.count();
+  int count = m_data->documentRules.count();
 
   for (int i = 0; i < count; ++i)
-    if (m_documentRules.at(i)->urlMatch(url))
+    if (m_data->documentRules.at(i)->urlMatch(url))
       return true;
 
   return false;
@@ -93,10 +208,10 @@ bool AdBlockMatcher::elemHideDisabledForUrl(const QUrl &url) const
   if (adBlockDisabledForUrl(url))
     return true;
 
-  int count = m_elemhideRules.count();
+  int count = m_data->elemhideRules.count();
 
   for (int i = 0; i < count; ++i)
-    if (m_elemhideRules.at(i)->urlMatch(url))
+    if (m_data->elemhideRules.at(i)->urlMatch(url))
       return true;
 
   return false;
@@ -104,17 +219,43 @@ bool AdBlockMatcher::elemHideDisabledForUrl(const QUrl &url) const
 
 QString AdBlockMatcher::elementHidingRules() const
 {
-  return m_elementHidingRules;
+  return m_data->elementHidingRules;
 }
 
+/** @brief Build stylesheet of element hiding rules restricted to domain
+ *
+ * Only rules listed under the domain or one of its parent domains and
+ * rules restricted just by excluded domains are checked.
+ *----------------------------------------------------------------------------*/
 QString AdBlockMatcher::elementHidingRulesForDomain(const QString &domain) const
 {
+  if (QString* cachedRules = m_domainCssCache.object(domain))
+    return *cachedRules;
+
+  QVector<const AdBlockRule*> domainRules = m_data->exceptDomainCssRules;
+  QSet<const AdBlockRule*> addedRules;
+  int pos = 0;
+  while (pos >= 0) {
+    QHash<QString, QVector<const AdBlockRule*> >::const_iterator it = m_data->domainCssRules.constFind(domain.mid(pos));
+    if (it != m_data->domainCssRules.constEnd()) {
+      foreach (const AdBlockRule* rule, it.value()) {
+        if (addedRules.contains(rule))
+          continue;
+        addedRules.insert(rule);
+        domainRules.append(rule);
+      }
+    }
+    pos = domain.indexOf(QLatin1Char('.'), pos);
+    if (pos >= 0)
+      pos++;
+  }
+
   QString rules;
   int addedRulesCount = 0;
-  int count = m_domainRestrictedCssRules.count();
+  int count = domainRules.count();
 
   for (int i = 0; i < count; ++i) {
-    const AdBlockRule* rule = m_domainRestrictedCssRules.at(i);
+    const AdBlockRule* rule = domainRules.at(i);
     if (!rule->matchDomain(domain))
       continue;
 
@@ -134,47 +275,171 @@ QString AdBlockMatcher::elementHidingRulesForDomain(const QString &domain) const
     rules.append(QLatin1String("{display:none !important;}\n"));
   }
 
+  m_domainCssCache.insert(domain, new QString(rules));
+
   return rules;
 }
 
+/** @brief Read subscription file again and rebuild matcher
+ *----------------------------------------------------------------------------*/
+void AdBlockMatcher::reloadSubscription(AdBlockSubscription* subscription)
+{
+  m_reloadSubscriptions.insert(subscription);
+  update();
+}
+
+/** @brief Delete rules once matcher does not use them anymore
+ *
+ * Rules removed from subscription can still be referenced by current
+ * matcher data and by update being built, so they are deleted only after
+ * data built without them is set.
+ *----------------------------------------------------------------------------*/
+void AdBlockMatcher::retireRules(const QVector<AdBlockRule*> &rules)
+{
+  m_retiredRules += rules;
+}
+
+/** @brief Schedule rebuild of matcher
+ *
+ * Rebuild runs in own thread, pages are matched by current data until
+ * new one is ready. Requests done meanwhile are joined to one update.
+ *----------------------------------------------------------------------------*/
 void AdBlockMatcher::update()
 {
-  clear();
+  if (m_updateScheduled)
+    return;
+
+  m_updateScheduled = true;
+  if (!m_updateThread)
+    QTimer::singleShot(0, this, SLOT(startUpdate()));
+}
+
+void AdBlockMatcher::startUpdate()
+{
+  if (m_updateThread || !m_updateScheduled)
+    return;
+
+  m_updateScheduled = false;
+
+  QList<AdBlockMatcherBuilder::Source> sources;
+  foreach (AdBlockSubscription* subscription, m_manager->subscriptions()) {
+    AdBlockMatcherBuilder::Source source;
+    source.subscription = subscription;
+    source.filePath = subscription->filePath();
+    source.reload = m_reloadSubscriptions.contains(subscription);
+    source.loaded = false;
+    if (!source.reload)
+      source.rules = subscription->allRules();
+    sources.append(source);
+  }
+  m_reloadSubscriptions.clear();
+
+  m_updateRetiredRules = m_retiredRules;
+  m_retiredRules.clear();
+
+  m_updateThread = new QThread();
+  m_builder = new AdBlockMatcherBuilder(sources, m_manager->disabledRules());
+  m_builder->moveToThread(m_updateThread);
+  connect(m_updateThread, SIGNAL(started()), m_builder, SLOT(run()));
+  connect(m_builder, SIGNAL(finished()), m_updateThread, SLOT(quit()), Qt::DirectConnection);
+  connect(m_builder, SIGNAL(finished()), this, SLOT(updateFinished()), Qt::QueuedConnection);
+  m_updateThread->start(QThread::LowPriority);
+}
+
+void AdBlockMatcher::updateFinished()
+{
+  m_updateThread->wait();
+
+  QList<AdBlockMatcherBuilder::Source> sources = m_builder->takeSources();
+  AdBlockMatcherData* data = m_builder->takeData();
+
+  delete m_builder;
+  m_builder = 0;
+  delete m_updateThread;
+  m_updateThread = 0;
+
+  if (m_manager->isEnabled())
+    setData(data);
+  else
+    delete data;
+
+  // Old data is not used anymore
+  qDeleteAll(m_updateRetiredRules);
+  m_updateRetiredRules.clear();
+
+  const QList<AdBlockSubscription*> subscriptions = m_manager->subscriptions();
+  foreach (const AdBlockMatcherBuilder::Source &source, sources) {
+    if (!source.reload)
+      continue;
+
+    if (subscriptions.contains(source.subscription)) {
+      // Previous rules of subscription are not in any data now
+      source.subscription->setLoadedRules(source.rules, source.loaded);
+    }
+    else {
+      // Subscription was removed meanwhile
+      retireRules(source.rules);
+      m_updateScheduled = true;
+    }
+  }
+
+  if (m_updateScheduled)
+    QTimer::singleShot(0, this, SLOT(startUpdate()));
+}
+
+void AdBlockMatcher::setData(AdBlockMatcherData* data)
+{
+  const bool elementHidingChanged = (data->elementHidingRules != m_data->elementHidingRules);
+
+  delete m_data;
+  m_data = data;
+  m_decisionCache.clear();
+  m_domainCssCache.clear();
+  MemoryAccounting::report(MemoryAccounting::AdBlock, this, m_data->memoryUsage());
+
+  if (elementHidingChanged)
+    mainApp->reloadUserStyleBrowser();
+}
+
+AdBlockMatcherData* AdBlockMatcher::createData(const QVector<AdBlockRule*> &rules)
+{
+  AdBlockMatcherData* data = new AdBlockMatcherData;
 
   QHash<QString, const AdBlockRule*> cssRulesHash;
   QVector<const AdBlockRule*> exceptionCssRules;
 
-  foreach (AdBlockSubscription* subscription, m_manager->subscriptions()) {
-    foreach (const AdBlockRule* rule, subscription->allRules()) {
-      // Don't add internally disabled rules to cache
-      if (rule->isInternalDisabled())
-        continue;
+  foreach (const AdBlockRule* rule, rules) {
+    // Filter is kept in rule with string which is matched
+    data->rulesBytes += sizeof(AdBlockRule) + 2 * rule->filter().size() * sizeof(QChar);
 
-      if (rule->isCssRule()) {
-        // We will add only enabled css rules to cache, because there is no enabled/disabled
-        // check on match. They are directly embedded to pages.
-        if (!rule->isEnabled())
-          continue;
+    // Don't add internally disabled rules to cache
+    if (rule->isInternalDisabled())
+      continue;
 
-        if (rule->isException())
-          exceptionCssRules.append(rule);
-        else
-          cssRulesHash.insert(rule->cssSelector(), rule);
-      }
-      else if (rule->isDocument()) {
-        m_documentRules.append(rule);
-      }
-      else if (rule->isElemhide()) {
-        m_elemhideRules.append(rule);
-      }
-      else if (rule->isException()) {
-        if (!m_networkExceptionTree.add(rule))
-          m_networkExceptionRules.append(rule);
-      }
-      else {
-        if (!m_networkBlockTree.add(rule))
-          m_networkBlockRules.append(rule);
-      }
+    if (rule->isCssRule()) {
+      // We will add only enabled css rules to cache, because there is no enabled/disabled
+      // check on match. They are directly embedded to pages.
+      if (!rule->isEnabled())
+        continue;
+
+      if (rule->isException())
+        exceptionCssRules.append(rule);
+      else
+        cssRulesHash.insert(rule->cssSelector(), rule);
+    }
+    else if (rule->isDocument()) {
+      data->documentRules.append(rule);
+    }
+    else if (rule->isElemhide()) {
+      data->elemhideRules.append(rule);
+    }
+    else if (rule->isException()) {
+      if (!data->networkExceptionTree.add(rule))
+        data->networkExceptionIndex.add(rule);
+    }
+    else {
+      if (!data->networkBlockTree.add(rule))
+        data->networkBlockIndex.add(rule);
     }
   }
 
@@ -188,9 +453,10 @@ void AdBlockMatcher::update()
     AdBlockRule* copiedRule = originalRule->copy();
     copiedRule->m_options |= AdBlockRule::DomainRestrictedOption;
     copiedRule->m_blockedDomains.append(rule->m_allowedDomains);
+    copiedRule->m_blockedDomainIds += rule->m_allowedDomainIds;
 
     cssRulesHash[rule->cssSelector()] = copiedRule;
-    m_createdRules.append(copiedRule);
+    data->createdRules.append(copiedRule);
   }
 
   // Apparently, excessive amount of selectors for one CSS rule is not what WebKit likes.
@@ -204,37 +470,36 @@ void AdBlockMatcher::update()
     const AdBlockRule* rule = it.value();
 
     if (rule->isDomainRestricted()) {
-      m_domainRestrictedCssRules.append(rule);
+      if (rule->m_allowedDomains.isEmpty()) {
+        data->exceptDomainCssRules.append(rule);
+      }
+      else {
+        foreach (const QString &domain, rule->m_allowedDomains)
+          data->domainCssRules[domain].append(rule);
+      }
     }
     else if (Q_UNLIKELY(hidingRulesCount == 1000)) {
-      m_elementHidingRules.append(rule->cssSelector());
-      m_elementHidingRules.append(QLatin1String("{display:none !important;} "));
+      data->elementHidingRules.append(rule->cssSelector());
+      data->elementHidingRules.append(QLatin1String("{display:none !important;} "));
       hidingRulesCount = 0;
     }
     else {
-      m_elementHidingRules.append(rule->cssSelector() + QLatin1Char(','));
+      data->elementHidingRules.append(rule->cssSelector() + QLatin1Char(','));
       hidingRulesCount++;
     }
   }
 
   if (hidingRulesCount != 0) {
-    m_elementHidingRules = m_elementHidingRules.left(m_elementHidingRules.size() - 1);
-    m_elementHidingRules.append(QLatin1String("{display:none !important;} "));
+    data->elementHidingRules = data->elementHidingRules.left(data->elementHidingRules.size() - 1);
+    data->elementHidingRules.append(QLatin1String("{display:none !important;} "));
   }
+
+  return data;
 }
 
 void AdBlockMatcher::clear()
 {
-  m_networkExceptionTree.clear();
-  m_networkExceptionRules.clear();
-  m_networkBlockTree.clear();
-  m_networkBlockRules.clear();
-  m_domainRestrictedCssRules.clear();
-  m_elementHidingRules.clear();
-  m_documentRules.clear();
-  m_elemhideRules.clear();
-  qDeleteAll(m_createdRules);
-  m_createdRules.clear();
+  setData(new AdBlockMatcherData);
 }
 
 void AdBlockMatcher::enabledChanged(bool enabled)
@@ -38,11 +38,75 @@
 #include <QUrl>
 #include <QObject>
 #include <QVector>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+#include <QCache>
 
 #include "adblocksearchtree.h"
+#include "adblockrulesindex.h"
 
+class QThread;
 class AdBlockManager;
+class AdBlockRequestInfo;
 class AdBlockRule;
+class AdBlockSubscription;
+
+/** @brief Rules of all subscriptions prepared for matching
+ *----------------------------------------------------------------------------*/
+struct AdBlockMatcherData
+{
+  AdBlockMatcherData() : rulesBytes(0) {}
+  ~AdBlockMatcherData();
+
+  qint64 memoryUsage() const;
+
+  QVector<AdBlockRule*> createdRules;
+  QHash<QString, QVector<const AdBlockRule*> > domainCssRules;
+  QVector<const AdBlockRule*> exceptDomainCssRules;
+  QVector<const AdBlockRule*> documentRules;
+  QVector<const AdBlockRule*> elemhideRules;
+
+  QString elementHidingRules;
+  AdBlockSearchTree networkBlockTree;
+  AdBlockSearchTree networkExceptionTree;
+  AdBlockRulesIndex networkBlockIndex;
+  AdBlockRulesIndex networkExceptionIndex;
+  // Approximate memory of all rules with their filters
+  qint64 rulesBytes;
+};
+
+/** @brief Parses subscription files and builds matcher data in own thread
+ *----------------------------------------------------------------------------*/
+class AdBlockMatcherBuilder : public QObject
+{
+  Q_OBJECT
+public:
+  struct Source {
+    AdBlockSubscription* subscription;
+    QString filePath;
+    bool reload;
+    bool loaded;
+    QVector<AdBlockRule*> rules;
+  };
+
+  AdBlockMatcherBuilder(const QList<Source> &sources, const QStringList &disabledRules);
+  ~AdBlockMatcherBuilder();
+
+  QList<Source> takeSources();
+  AdBlockMatcherData* takeData();
+
+public slots:
+  void run();
+
+signals:
+  void finished();
+
+private:
+  QList<Source> m_sources;
+  QSet<QString> m_disabledRules;
+  AdBlockMatcherData* m_data;
+};
 
 class AdBlockMatcher : public QObject
 {
@@ -52,7 +116,7 @@ public:
   explicit AdBlockMatcher(AdBlockManager* manager);
   ~AdBlockMatcher();
 
-  const AdBlockRule* match(const QNetworkRequest &request, const QString &urlDomain, const QString &urlString) const;
+  const AdBlockRule* match(const AdBlockRequestInfo &request, const QString &urlDomain, const QString &urlString) const;
 
   bool adBlockDisabledForUrl(const QUrl &url) const;
   bool elemHideDisabledForUrl(const QUrl &url) const;
@@ -60,26 +124,45 @@ public:
   QString elementHidingRules() const;
   QString elementHidingRulesForDomain(const QString &domain) const;
 
+  qint64 decisionCacheHits() const;
+  qint64 decisionCacheMisses() const;
+
+  void reloadSubscription(AdBlockSubscription* subscription);
+  void retireRules(const QVector<AdBlockRule*> &rules);
+
+  static AdBlockMatcherData* createData(const QVector<AdBlockRule*> &rules);
+
 public slots:
   void update();
   void clear();
 
 private slots:
   void enabledChanged(bool enabled);
+  void startUpdate();
+  void updateFinished();
 
 private:
+  struct Decision {
+    const AdBlockRule* rule;
+  };
+
+  const AdBlockRule* matchRules(const AdBlockRequestInfo &request, const QString &urlDomain, const QString &urlString) const;
+  void setData(AdBlockMatcherData* data);
+
   AdBlockManager* m_manager;
+  AdBlockMatcherData* m_data;
 
-  QVector<AdBlockRule*> m_createdRules;
-  QVector<const AdBlockRule*> m_networkExceptionRules;
-  QVector<const AdBlockRule*> m_networkBlockRules;
-  QVector<const AdBlockRule*> m_domainRestrictedCssRules;
-  QVector<const AdBlockRule*> m_documentRules;
-  QVector<const AdBlockRule*> m_elemhideRules;
+  QThread* m_updateThread;
+  AdBlockMatcherBuilder* m_builder;
+  bool m_updateScheduled;
+  QSet<AdBlockSubscription*> m_reloadSubscriptions;
+  QVector<AdBlockRule*> m_retiredRules;
+  QVector<AdBlockRule*> m_updateRetiredRules;
 
-  QString m_elementHidingRules;
-  AdBlockSearchTree m_networkBlockTree;
-  AdBlockSearchTree m_networkExceptionTree;
+  mutable QCache<QString, QString> m_domainCssCache;
+  mutable QCache<QString, Decision> m_decisionCache;
+  mutable qint64 m_decisionCacheHits;
+  mutable qint64 m_decisionCacheMisses;
 };
 
 #endif // ADBLOCKMATCHER_H
@@ -65,7 +65,10 @@
 #include "adblocksubscription.h"
 #include "common.h"
 
+#include <QDataStream>
 #include <QDebug>
+#include <QHash>
+#include <QMutex>
 #include <QUrl>
 #include <QString>
 #include <QStringList>
@@ -111,6 +114,97 @@ static QString toSecondLevelDomain(const QUrl &url)
 #endif
 }
 
+// Ids of domains used in rule options. Rules are parsed in thread
+// of matcher update, so access to table is locked.
+static QMutex s_domainIdsMutex;
+static QHash<QString, int> s_domainIds;
+
+static QVector<int> domainIds(const QStringList &domains)
+{
+  QMutexLocker locker(&s_domainIdsMutex);
+
+  QVector<int> ids;
+  ids.reserve(domains.count());
+  foreach (const QString &domain, domains) {
+    QHash<QString, int>::const_iterator it = s_domainIds.constFind(domain);
+    if (it == s_domainIds.constEnd())
+      it = s_domainIds.insert(domain, s_domainIds.count());
+    ids.append(it.value());
+  }
+
+  return ids;
+}
+
+static bool containsDomainId(const QVector<int> &requestIds, const QVector<int> &ruleIds)
+{
+  foreach (int id, ruleIds) {
+    if (requestIds.contains(id))
+      return true;
+  }
+  return false;
+}
+
+AdBlockRequestInfo::AdBlockRequestInfo(const QNetworkRequest &request, const QString &domain, const QString &encodedUrl)
+  : m_domain(domain)
+  , m_types(0)
+  , m_knownTypes(AdBlockRule::ObjectOption | AdBlockRule::XMLHttpRequestOption | AdBlockRule::ImageOption)
+  , m_domainIdsReady(false)
+{
+  const QString referer = request.attribute(QNetworkRequest::Attribute(QNetworkRequest::User + 151), QString()).toString();
+  if (!referer.isEmpty()) {
+    m_knownTypes |= AdBlockRule::ThirdPartyOption;
+
+    // Third-party matching should be performed on second-level domains
+    if (toSecondLevelDomain(QUrl(referer)) != toSecondLevelDomain(request.url()))
+      m_types |= AdBlockRule::ThirdPartyOption;
+  }
+
+  if (request.attribute(QNetworkRequest::Attribute(QNetworkRequest::User + 150)).toString() == QL1S("object"))
+    m_types |= AdBlockRule::ObjectOption;
+
+  QWebFrame* originatingFrame = static_cast<QWebFrame*>(request.originatingObject());
+  if (originatingFrame && originatingFrame->page()) {
+    m_knownTypes |= AdBlockRule::SubdocumentOption;
+
+    if (originatingFrame != originatingFrame->page()->mainFrame())
+      m_types |= AdBlockRule::SubdocumentOption;
+  }
+
+  if (request.rawHeader("X-Requested-With") == QByteArray("XMLHttpRequest"))
+    m_types |= AdBlockRule::XMLHttpRequestOption;
+
+  if (encodedUrl.endsWith(QL1S(".png")) ||
+      encodedUrl.endsWith(QL1S(".jpg")) ||
+      encodedUrl.endsWith(QL1S(".gif")) ||
+      encodedUrl.endsWith(QL1S(".jpeg"))) {
+    m_types |= AdBlockRule::ImageOption;
+  }
+}
+
+/** @brief Ids of domain and its parent domains known from rule options
+ *
+ * Computed on first use, most requests don't reach domain restricted rules.
+ *----------------------------------------------------------------------------*/
+const QVector<int> &AdBlockRequestInfo::domainIds() const
+{
+  if (!m_domainIdsReady) {
+    m_domainIdsReady = true;
+
+    QMutexLocker locker(&s_domainIdsMutex);
+    int pos = 0;
+    while (pos >= 0) {
+      QHash<QString, int>::const_iterator it = s_domainIds.constFind(m_domain.mid(pos));
+      if (it != s_domainIds.constEnd())
+        m_domainIds.append(it.value());
+      pos = m_domain.indexOf(QL1C('.'), pos);
+      if (pos >= 0)
+        pos++;
+    }
+  }
+
+  return m_domainIds;
+}
+
 AdBlockRule::AdBlockRule(const QString &filter, AdBlockSubscription* subscription)
   : m_subscription(subscription)
   , m_type(StringContainsMatchRule)
@@ -143,6 +237,8 @@ AdBlockRule* AdBlockRule::copy() const
   rule->m_isInternalDisabled = m_isInternalDisabled;
   rule->m_allowedDomains = m_allowedDomains;
   rule->m_blockedDomains = m_blockedDomains;
+  rule->m_allowedDomainIds = m_allowedDomainIds;
+  rule->m_blockedDomainIds = m_blockedDomainIds;
 
   if (m_regExp) {
     rule->m_regExp = new RegExp;
@@ -174,6 +270,58 @@ void AdBlockRule::setFilter(const QString &filter)
   parseFilter();
 }
 
+/** @brief Write result of parseFilter() for subscription cache
+ *----------------------------------------------------------------------------*/
+void AdBlockRule::writeParsed(QDataStream &stream) const
+{
+  stream << m_filter << qint8(m_type) << qint32(m_options) << qint32(m_exceptions)
+         << qint8(m_caseSensitivity) << m_isEnabled << m_isException << m_isInternalDisabled
+         << m_matchString << m_allowedDomains << m_blockedDomains;
+
+  stream << bool(m_regExp != 0);
+  if (m_regExp) {
+    QStringList matchers;
+    foreach (const QStringMatcher &matcher, m_regExp->matchers)
+      matchers.append(matcher.pattern());
+    stream << m_regExp->regExp.pattern() << matchers;
+  }
+}
+
+/** @brief Restore rule written by writeParsed() without parsing filter
+ *----------------------------------------------------------------------------*/
+bool AdBlockRule::readParsed(QDataStream &stream)
+{
+  qint8 type;
+  qint32 options;
+  qint32 exceptions;
+  qint8 caseSensitivity;
+  bool hasRegExp;
+
+  stream >> m_filter >> type >> options >> exceptions
+         >> caseSensitivity >> m_isEnabled >> m_isException >> m_isInternalDisabled
+         >> m_matchString >> m_allowedDomains >> m_blockedDomains >> hasRegExp;
+
+  m_type = RuleType(type);
+  m_options = RuleOptions(QFlag(options));
+  m_exceptions = RuleOptions(QFlag(exceptions));
+  m_caseSensitivity = Qt::CaseSensitivity(caseSensitivity);
+  m_allowedDomainIds = domainIds(m_allowedDomains);
+  m_blockedDomainIds = domainIds(m_blockedDomains);
+
+  delete m_regExp;
+  m_regExp = 0;
+  if (hasRegExp) {
+    QString pattern;
+    QStringList matchers;
+    stream >> pattern >> matchers;
+    m_regExp = new RegExp;
+    m_regExp->regExp = QzRegExp(pattern, m_caseSensitivity);
+    m_regExp->matchers = createStringMatchers(matchers);
+  }
+
+  return (stream.status() == QDataStream::Ok);
+}
+
 bool AdBlockRule::isCssRule() const
 {
   return m_type == CssRule;
@@ -221,7 +369,7 @@ void AdBlockRule::setEnabled(bool enabled)
 
 bool AdBlockRule::isSlow() const
 {
-  return m_regExp != 0;
+  return m_type == RegExpMatchRule;
 }
 
 bool AdBlockRule::isInternalDisabled() const
@@ -238,10 +386,10 @@ bool AdBlockRule::urlMatch(const QUrl &url) const
   const QString encodedUrl = url.toEncoded();
   const QString domain = url.host();
 
-  return networkMatch(QNetworkRequest(url), domain, encodedUrl);
+  return networkMatch(AdBlockRequestInfo(QNetworkRequest(url), domain, encodedUrl), domain, encodedUrl);
 }
 
-bool AdBlockRule::networkMatch(const QNetworkRequest &request, const QString &domain, const QString &encodedUrl) const
+bool AdBlockRule::networkMatch(const AdBlockRequestInfo &request, const QString &domain, const QString &encodedUrl) const
 {
   if (m_type == CssRule || !m_isEnabled || m_isInternalDisabled) {
     return false;
@@ -265,36 +413,31 @@ bool AdBlockRule::networkMatch(const QNetworkRequest &request, const QString &do
 
     matched = (m_regExp->regExp.indexIn(encodedUrl) != -1);
   }
-
-  if (matched) {
-    // Check domain restrictions
-    if (hasOption(DomainRestrictedOption) && !matchDomain(domain)) {
-      return false;
-    }
-
-    // Check third-party restriction
-    if (hasOption(ThirdPartyOption) && !matchThirdParty(request)) {
+  else if (m_type == WildcardMatchRule) {
+    if (!isMatchingRegExpStrings(encodedUrl)) {
       return false;
     }
 
-    // Check object restrictions
-    if (hasOption(ObjectOption) && !matchObject(request)) {
-      return false;
-    }
+    matched = isMatchingWildcard(encodedUrl);
+  }
 
-    // Check subdocument restriction
-    if (hasOption(SubdocumentOption) && !matchSubdocument(request)) {
+  if (matched) {
+    // Check domain restrictions
+    if (hasOption(DomainRestrictedOption) && !matchDomain(request)) {
       return false;
     }
 
-    // Check xmlhttprequest restriction
-    if (hasOption(XMLHttpRequestOption) && !matchXmlHttpRequest(request)) {
-      return false;
-    }
+    // Check third-party, object, subdocument, xmlhttprequest and image
+    // restrictions, option matches when request type differs from exception
+    const int typeOptions = m_options & RequestTypeOptions;
+    if (typeOptions) {
+      if ((typeOptions & request.knownTypes()) != typeOptions) {
+        return false;
+      }
 
-    // Check image restriction
-    if (hasOption(ImageOption) && !matchImage(encodedUrl)) {
-      return false;
+      if (((request.types() ^ m_exceptions) & typeOptions) != typeOptions) {
+        return false;
+      }
     }
   }
 
@@ -343,62 +486,26 @@ bool AdBlockRule::matchDomain(const QString &domain) const
   return false;
 }
 
-bool AdBlockRule::matchThirdParty(const QNetworkRequest &request) const
+bool AdBlockRule::matchDomain(const AdBlockRequestInfo &request) const
 {
-  const QString referer = request.attribute(QNetworkRequest::Attribute(QNetworkRequest::User + 151), QString()).toString();
-
-  if (referer.isEmpty()) {
+  if (!m_isEnabled) {
     return false;
   }
 
-  // Third-party matching should be performed on second-level domains
-  const QString refererHost = toSecondLevelDomain(QUrl(referer));
-  const QString host = toSecondLevelDomain(request.url());
-
-  bool match = refererHost != host;
-
-  return hasException(ThirdPartyOption) ? !match : match;
-}
-
-bool AdBlockRule::matchObject(const QNetworkRequest &request) const
-{
-  bool match = request.attribute(QNetworkRequest::Attribute(QNetworkRequest::User + 150)).toString() == QL1S("object");
+  if (!hasOption(DomainRestrictedOption)) {
+    return true;
+  }
 
-  return hasException(ObjectOption) ? !match : match;
-}
+  const QVector<int> &ids = request.domainIds();
 
-bool AdBlockRule::matchSubdocument(const QNetworkRequest &request) const
-{
-  QWebFrame* originatingFrame = static_cast<QWebFrame*>(request.originatingObject());
-  if (!originatingFrame) {
-    return false;
+  if (m_blockedDomainIds.isEmpty()) {
+    return containsDomainId(ids, m_allowedDomainIds);
   }
-
-  QWebPage* page = originatingFrame->page();
-  if (!page) {
-    return false;
+  else if (m_allowedDomainIds.isEmpty()) {
+    return !containsDomainId(ids, m_blockedDomainIds);
   }
 
-  bool match = !(originatingFrame == page->mainFrame());
-
-  return hasException(SubdocumentOption) ? !match : match;
-}
-
-bool AdBlockRule::matchXmlHttpRequest(const QNetworkRequest &request) const
-{
-  bool match = request.rawHeader("X-Requested-With") == QByteArray("XMLHttpRequest");
-
-  return hasException(XMLHttpRequestOption) ? !match : match;
-}
-
-bool AdBlockRule::matchImage(const QString &encodedUrl) const
-{
-  bool match = encodedUrl.endsWith(QL1S(".png")) ||
-      encodedUrl.endsWith(QL1S(".jpg")) ||
-      encodedUrl.endsWith(QL1S(".gif")) ||
-      encodedUrl.endsWith(QL1S(".jpeg"));
-
-  return hasException(ImageOption) ? !match : match;
+  return !containsDomainId(ids, m_blockedDomainIds) && containsDomainId(ids, m_allowedDomainIds);
 }
 
 void AdBlockRule::parseFilter()
@@ -544,14 +651,14 @@ void AdBlockRule::parseFilter()
   }
 
   // If we still find a wildcard (*) or separator (^) or (|)
-  // we must modify parsedLine to comply with QzRegExp
+  // rule is matched by isMatchingWildcard()
   if (parsedLine.contains(QL1C('*')) ||
       parsedLine.contains(QL1C('^')) ||
       parsedLine.contains(QL1C('|'))
       ) {
-    m_type = RegExpMatchRule;
+    m_type = WildcardMatchRule;
+    m_matchString = (m_caseSensitivity == Qt::CaseInsensitive) ? parsedLine.toLower() : parsedLine;
     m_regExp = new RegExp;
-    m_regExp->regExp = QzRegExp(createRegExpFromFilter(parsedLine), m_caseSensitivity);
     m_regExp->matchers = createStringMatchers(parseRegExpFilter(parsedLine));
     return;
   }
@@ -580,6 +687,9 @@ void AdBlockRule::parseDomains(const QString &domains, const QChar &separator)
   if (!m_blockedDomains.isEmpty() || !m_allowedDomains.isEmpty()) {
     setOption(DomainRestrictedOption);
   }
+
+  m_allowedDomainIds = domainIds(m_allowedDomains);
+  m_blockedDomainIds = domainIds(m_blockedDomains);
 }
 
 bool AdBlockRule::filterIsOnlyDomain(const QString &filter) const
@@ -626,53 +736,132 @@ static bool wordCharacter(const QChar &c)
   return c.isLetterOrNumber() || c.isMark() || c == QL1C('_');
 }
 
-QString AdBlockRule::createRegExpFromFilter(const QString &filter) const
+// Separator (^) is anything but a letter, a digit or one of _ - . %
+static bool separatorCharacter(const QChar &c)
 {
-  QString parsed;
-  parsed.reserve(filter.size());
+  return !wordCharacter(c) && c != QL1C('-') && c != QL1C('.') && c != QL1C('%');
+}
 
-  bool hadWildcard = false; // Filter multiple wildcards
+// Match url from urlStart against pattern part [patternStart, patternEnd)
+// with wildcards (*) and separators (^). Separators also match end of url.
+// Pattern is in lower case for case insensitive rules.
+static bool wildcardMatch(const QString &pattern, int patternStart, int patternEnd,
+                          const QString &url, int urlStart, bool anchorStart, bool anchorEnd,
+                          Qt::CaseSensitivity caseSensitivity)
+{
+  const QChar* p = pattern.constData();
+  const QChar* u = url.constData();
+  const int urlEnd = url.size();
 
-  for (int i = 0; i < filter.size(); ++i) {
-    const QChar c = filter.at(i);
-    switch (c.toLatin1()) {
-    case '^':
-      parsed.append(QL1S("(?:[^\\w\\d\\-.%]|$)"));
-      break;
+  int pi = patternStart;
+  int ui = urlStart;
+  // Pattern position after last wildcard and url position matched by it
+  int starPi = anchorStart ? -1 : patternStart;
+  int starUi = urlStart;
 
-    case '*':
-      if (!hadWildcard)
-        parsed.append(QL1S(".*"));
-      break;
+  for (;;) {
+    if (pi < patternEnd && p[pi] == QL1C('*')) {
+      starPi = ++pi;
+      starUi = ui;
+      continue;
+    }
 
-    case '|':
-      if (i == 0) {
-        if (filter.size() > 1 && filter.at(1) == QL1C('|')) {
-          parsed.append(QL1S("^[\\w\\-]+:\\/+(?!\\/)(?:[^\\/]+\\.)?"));
-          i++;
+    if (ui < urlEnd) {
+      if (pi < patternEnd) {
+        const QChar c = p[pi];
+        bool match;
+        if (c == QL1C('^'))
+          match = separatorCharacter(u[ui]);
+        else if (caseSensitivity == Qt::CaseSensitive)
+          match = (c == u[ui]);
+        else
+          match = (c == u[ui].toLower());
+
+        if (match) {
+          ++pi;
+          ++ui;
+          continue;
         }
-        else {
-          parsed.append('^');
-        }
-        break;
       }
-      else if (i == filter.size() - 1) {
-        parsed.append(QL1C('$'));
-        break;
+      else if (!anchorEnd) {
+        return true;
       }
-      // fallthrough
-
-    default:
-      if (!wordCharacter(c))
-        parsed.append(QL1C('\\') + c);
-      else
-        parsed.append(c);
     }
+    else {
+      while (pi < patternEnd && (p[pi] == QL1C('*') || p[pi] == QL1C('^')))
+        ++pi;
+      if (pi == patternEnd)
+        return true;
+    }
+
+    // Let last wildcard match one more character
+    if (starPi < 0 || starUi >= urlEnd)
+      return false;
+
+    pi = starPi;
+    ui = ++starUi;
+  }
+}
 
-    hadWildcard = c == QL1C('*');
+/** @brief Match url against wildcard rule without regular expression
+ *
+ * Supports wildcards (*), separators (^), start (|) and end (|) anchors
+ * and domain anchor (||) which matches at start of host or any of its
+ * subdomains.
+ *----------------------------------------------------------------------------*/
+bool AdBlockRule::isMatchingWildcard(const QString &url) const
+{
+  const QString &pattern = m_matchString;
+  int patternStart = 0;
+  int patternEnd = pattern.size();
+  bool anchorStart = false;
+  bool anchorDomain = false;
+  bool anchorEnd = false;
+
+  if (pattern.startsWith(QL1S("||"))) {
+    anchorDomain = true;
+    patternStart = 2;
+  }
+  else if (pattern.startsWith(QL1C('|'))) {
+    anchorStart = true;
+    patternStart = 1;
   }
 
-  return parsed;
+  if (patternEnd > patternStart && pattern.at(patternEnd - 1) == QL1C('|')) {
+    anchorEnd = true;
+    patternEnd--;
+  }
+
+  if (!anchorDomain) {
+    return wildcardMatch(pattern, patternStart, patternEnd, url, 0,
+                         anchorStart, anchorEnd, m_caseSensitivity);
+  }
+
+  // Scheme, colon and slashes: [\w\-]+:/+
+  int pos = 0;
+  while (pos < url.size() && (wordCharacter(url.at(pos)) || url.at(pos) == QL1C('-')))
+    pos++;
+  if (pos == 0 || pos >= url.size() || url.at(pos) != QL1C(':'))
+    return false;
+  pos++;
+  const int slashesStart = pos;
+  while (pos < url.size() && url.at(pos) == QL1C('/'))
+    pos++;
+  if (pos == slashesStart)
+    return false;
+
+  // Start of host or position after any dot before next slash
+  if (wildcardMatch(pattern, patternStart, patternEnd, url, pos, true, anchorEnd, m_caseSensitivity))
+    return true;
+
+  for (int i = pos + 1; i < url.size() && url.at(i) != QL1C('/'); ++i) {
+    if (url.at(i) == QL1C('.') &&
+        wildcardMatch(pattern, patternStart, patternEnd, url, i + 1, true, anchorEnd, m_caseSensitivity)) {
+      return true;
+    }
+  }
+
+  return false;
 }
 
 QList<QStringMatcher> AdBlockRule::createStringMatchers(const QStringList &filters) const
@@ -65,13 +65,40 @@
 
 #include <QObject>
 #include <QStringList>
+#include <QVector>
 #include <qzregexp.h>
 
+class QDataStream;
 class QNetworkRequest;
 class QUrl;
 
 class AdBlockSubscription;
 
+/** @brief Properties of network request checked by rule options
+ *
+ * Computed once for request, rules then test bit masks and ids
+ * of domains instead of strings.
+ *----------------------------------------------------------------------------*/
+class AdBlockRequestInfo
+{
+public:
+  AdBlockRequestInfo(const QNetworkRequest &request, const QString &domain, const QString &encodedUrl);
+
+  // Request type options (third-party, object, ...) of request
+  int types() const { return m_types; }
+  // Options which can be checked at all, e.g. third-party needs referer
+  int knownTypes() const { return m_knownTypes; }
+  // Ids of request domain and its parent domains
+  const QVector<int> &domainIds() const;
+
+private:
+  QString m_domain;
+  int m_types;
+  int m_knownTypes;
+  mutable bool m_domainIdsReady;
+  mutable QVector<int> m_domainIds;
+};
+
 class AdBlockRule
 {
 public:
@@ -86,6 +113,9 @@ public:
   QString filter() const;
   void setFilter(const QString &filter);
 
+  void writeParsed(QDataStream &stream) const;
+  bool readParsed(QDataStream &stream);
+
   bool isCssRule() const;
   QString cssSelector() const;
 
@@ -103,18 +133,15 @@ public:
   bool isInternalDisabled() const;
 
   bool urlMatch(const QUrl &url) const;
-  bool networkMatch(const QNetworkRequest &request, const QString &domain, const QString &encodedUrl) const;
+  bool networkMatch(const AdBlockRequestInfo &request, const QString &domain, const QString &encodedUrl) const;
 
   bool matchDomain(const QString &domain) const;
-  bool matchThirdParty(const QNetworkRequest &request) const;
-  bool matchObject(const QNetworkRequest &request) const;
-  bool matchSubdocument(const QNetworkRequest &request) const;
-  bool matchXmlHttpRequest(const QNetworkRequest &request) const;
-  bool matchImage(const QString &encodedUrl) const;
+  bool matchDomain(const AdBlockRequestInfo &request) const;
 
 protected:
   bool isMatchingDomain(const QString &domain, const QString &filter) const;
   bool isMatchingRegExpStrings(const QString &url) const;
+  bool isMatchingWildcard(const QString &url) const;
   QStringList parseRegExpFilter(const QString &filter) const;
 
 private:
@@ -124,7 +151,8 @@ private:
     RegExpMatchRule = 2,
     StringEndsMatchRule = 3,
     StringContainsMatchRule = 4,
-    Invalid = 5
+    Invalid = 5,
+    WildcardMatchRule = 6
   };
 
   enum RuleOption {
@@ -137,7 +165,10 @@ private:
 
     // Exception only options
     DocumentOption = 64,
-    ElementHideOption = 128
+    ElementHideOption = 128,
+
+    RequestTypeOptions = ThirdPartyOption | ObjectOption | SubdocumentOption |
+                         XMLHttpRequestOption | ImageOption
   };
 
   Q_DECLARE_FLAGS(RuleOptions, RuleOption)
@@ -152,7 +183,6 @@ private:
   void parseDomains(const QString &domains, const QChar &separator);
   bool filterIsOnlyDomain(const QString &filter) const;
   bool filterIsOnlyEndsMatch(const QString &filter) const;
-  QString createRegExpFromFilter(const QString &filter) const;
   QList<QStringMatcher> createStringMatchers(const QStringList &filters) const;
 
   AdBlockSubscription* m_subscription;
@@ -174,7 +204,10 @@ private:
 
   QStringList m_allowedDomains;
   QStringList m_blockedDomains;
+  QVector<int> m_allowedDomainIds;
+  QVector<int> m_blockedDomainIds;
 
+  // Wildcard rules use only string matchers, regExp is empty
   struct RegExp {
     QzRegExp regExp;
     QList<QStringMatcher> matchers;
@@ -183,8 +216,10 @@ private:
   // Use dynamic allocation to save memory
   RegExp* m_regExp;
 
+  friend class AdBlockRequestInfo;
   friend class AdBlockMatcher;
   friend class AdBlockSearchTree;
+  friend class AdBlockRulesIndex;
   friend class AdBlockSubscription;
 };
 
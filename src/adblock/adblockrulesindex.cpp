@@ -0,0 +1,160 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "adblockrulesindex.h"
+#include "adblockrule.h"
+
+#include <QSet>
+#include <QStringList>
+#include <QStringMatcher>
+
+// Length of url substring under which rules are stored
+#define TOKEN_LENGTH 4
+
+AdBlockRulesIndex::AdBlockRulesIndex()
+{
+}
+
+void AdBlockRulesIndex::clear()
+{
+  m_tokenRules.clear();
+  m_domainRules.clear();
+  m_otherRules.clear();
+}
+
+/** @brief Approximate memory of hashes and lists of rules
+ *----------------------------------------------------------------------------*/
+qint64 AdBlockRulesIndex::memoryUsage() const
+{
+  qint64 bytes = sizeof(AdBlockRulesIndex) + m_otherRules.capacity() * sizeof(const AdBlockRule*);
+  QHash<quint64, RulesList>::const_iterator token = m_tokenRules.constBegin();
+  for (; token != m_tokenRules.constEnd(); ++token)
+    bytes += sizeof(quint64) + sizeof(RulesList) + token.value().capacity() * sizeof(const AdBlockRule*);
+  QHash<QString, RulesList>::const_iterator domain = m_domainRules.constBegin();
+  for (; domain != m_domainRules.constEnd(); ++domain) {
+    bytes += sizeof(QString) + domain.key().size() * sizeof(QChar) +
+        sizeof(RulesList) + domain.value().capacity() * sizeof(const AdBlockRule*);
+  }
+  return bytes;
+}
+
+quint64 AdBlockRulesIndex::tokenKey(const QChar* string)
+{
+  quint64 key = 0;
+  for (int i = 0; i < TOKEN_LENGTH; ++i)
+    key = (key << 16) | string[i].unicode();
+  return key;
+}
+
+void AdBlockRulesIndex::add(const AdBlockRule* rule)
+{
+  if (rule->m_type == AdBlockRule::DomainMatchRule) {
+    m_domainRules[rule->m_matchString].append(rule);
+    return;
+  }
+
+  // Literal parts of filter which url must contain
+  QStringList literals;
+  if ((rule->m_type == AdBlockRule::RegExpMatchRule) ||
+      (rule->m_type == AdBlockRule::WildcardMatchRule)) {
+    foreach (const QStringMatcher &matcher, rule->m_regExp->matchers)
+      literals.append(matcher.pattern());
+  }
+  else if ((rule->m_type == AdBlockRule::StringContainsMatchRule) ||
+           (rule->m_type == AdBlockRule::StringEndsMatchRule)) {
+    literals.append(rule->m_matchString);
+  }
+
+  // Url is matched in lower case, so rule goes under substring with
+  // the least rules to keep lists short
+  bool found = false;
+  quint64 bestKey = 0;
+  int bestCount = 0;
+  foreach (const QString &literal, literals) {
+    const QString str = literal.toLower();
+    for (int i = 0; i + TOKEN_LENGTH <= str.size(); ++i) {
+      quint64 key = tokenKey(str.constData() + i);
+      int count = m_tokenRules.value(key).count();
+      if (!found || (count < bestCount)) {
+        found = true;
+        bestKey = key;
+        bestCount = count;
+        if (!count)
+          break;
+      }
+    }
+    if (found && !bestCount)
+      break;
+  }
+
+  if (found)
+    m_tokenRules[bestKey].append(rule);
+  else
+    m_otherRules.append(rule);
+}
+
+const AdBlockRule* AdBlockRulesIndex::findInList(const RulesList &rules,
+                                                 const AdBlockRequestInfo &request,
+                                                 const QString &domain,
+                                                 const QString &urlString) const
+{
+  int count = rules.count();
+  for (int i = 0; i < count; ++i) {
+    const AdBlockRule* rule = rules.at(i);
+    if (rule->networkMatch(request, domain, urlString))
+      return rule;
+  }
+  return 0;
+}
+
+const AdBlockRule* AdBlockRulesIndex::find(const AdBlockRequestInfo &request, const QString &domain, const QString &urlString) const
+{
+  if (const AdBlockRule* rule = findInList(m_otherRules, request, domain, urlString))
+    return rule;
+
+  if (!m_domainRules.isEmpty()) {
+    int pos = 0;
+    while (pos >= 0) {
+      QHash<QString, RulesList>::const_iterator it = m_domainRules.constFind(domain.mid(pos));
+      if (it != m_domainRules.constEnd()) {
+        if (const AdBlockRule* rule = findInList(it.value(), request, domain, urlString))
+          return rule;
+      }
+      pos = domain.indexOf(QLatin1Char('.'), pos);
+      if (pos >= 0)
+        pos++;
+    }
+  }
+
+  if (!m_tokenRules.isEmpty()) {
+    QSet<quint64> checkedKeys;
+    const QChar* string = urlString.constData();
+    for (int i = 0; i + TOKEN_LENGTH <= urlString.size(); ++i) {
+      quint64 key = tokenKey(string + i);
+      QHash<quint64, RulesList>::const_iterator it = m_tokenRules.constFind(key);
+      if (it == m_tokenRules.constEnd())
+        continue;
+      if (checkedKeys.contains(key))
+        continue;
+      checkedKeys.insert(key);
+      if (const AdBlockRule* rule = findInList(it.value(), request, domain, urlString))
+        return rule;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,59 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef ADBLOCKRULESINDEX_H
+#define ADBLOCKRULESINDEX_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+class AdBlockRequestInfo;
+class AdBlockRule;
+
+/** @brief Index of network rules which can't be put into AdBlockSearchTree
+ *
+ * Every rule is stored under one literal part of its filter, which any
+ * matching url must contain: rare substring of TOKEN_LENGTH characters for
+ * string and regexp rules, whole domain for domain rules. On match only
+ * rules stored under substrings of url or under its parent domains are
+ * checked. Rules without such literal part are always checked.
+ *----------------------------------------------------------------------------*/
+class AdBlockRulesIndex
+{
+public:
+  explicit AdBlockRulesIndex();
+
+  void clear();
+
+  void add(const AdBlockRule* rule);
+  const AdBlockRule* find(const AdBlockRequestInfo &request, const QString &domain, const QString &urlString) const;
+  qint64 memoryUsage() const;
+
+private:
+  typedef QVector<const AdBlockRule*> RulesList;
+
+  static quint64 tokenKey(const QChar* string);
+  const AdBlockRule* findInList(const RulesList &rules, const AdBlockRequestInfo &request,
+                                const QString &domain, const QString &urlString) const;
+
+  QHash<quint64, RulesList> m_tokenRules;
+  QHash<QString, RulesList> m_domainRules;
+  RulesList m_otherRules;
+};
+
+#endif // ADBLOCKRULESINDEX_H
@@ -38,19 +38,54 @@
 #include <QDebug>
 
 AdBlockSearchTree::AdBlockSearchTree()
-  : m_root(new Node)
 {
+  clear();
 }
 
 AdBlockSearchTree::~AdBlockSearchTree()
 {
-  deleteNode(m_root);
 }
 
 void AdBlockSearchTree::clear()
 {
-  deleteNode(m_root);
-  m_root = new Node;
+  m_nodes.clear();
+  m_nodes.append(Node());
+  for (int i = 0; i < 128; ++i)
+    m_rootChildren[i] = -1;
+}
+
+qint64 AdBlockSearchTree::memoryUsage() const
+{
+  return sizeof(AdBlockSearchTree) + qint64(m_nodes.capacity()) * sizeof(Node);
+}
+
+int AdBlockSearchTree::child(int node, const QChar &c) const
+{
+  if (node == 0 && c.unicode() < 128)
+    return m_rootChildren[c.unicode()];
+
+  int i = m_nodes.at(node).firstChild;
+  while (i != -1) {
+    const Node &n = m_nodes.at(i);
+    if (n.c == c)
+      return i;
+    i = n.nextSibling;
+  }
+  return -1;
+}
+
+int AdBlockSearchTree::addChild(int node, const QChar &c)
+{
+  Node n;
+  n.c = c;
+  n.nextSibling = m_nodes.at(node).firstChild;
+  int i = m_nodes.count();
+  m_nodes.append(n);
+  m_nodes[node].firstChild = i;
+
+  if (node == 0 && c.unicode() < 128)
+    m_rootChildren[c.unicode()] = i;
+  return i;
 }
 
 bool AdBlockSearchTree::add(const AdBlockRule* rule)
@@ -67,26 +102,22 @@ bool AdBlockSearchTree::add(const AdBlockRule* rule)
     return false;
   }
 
-  Node* node = m_root;
+  int node = 0;
 
   for (int i = 0; i < len; ++i) {
     const QChar c = filter.at(i);
-    if (!node->children.contains(c)) {
-      Node* n = new Node;
-      n->c = c;
-
-      node->children[c] = n;
-    }
-
-    node = node->children[c];
+    int next = child(node, c);
+    if (next == -1)
+      next = addChild(node, c);
+    node = next;
   }
 
-  node->rule = rule;
+  m_nodes[node].rule = rule;
 
   return true;
 }
 
-const AdBlockRule* AdBlockSearchTree::find(const QNetworkRequest &request, const QString &domain, const QString &urlString) const
+const AdBlockRule* AdBlockSearchTree::find(const AdBlockRequestInfo &request, const QString &domain, const QString &urlString) const
 {
   int len = urlString.size();
 
@@ -106,52 +137,33 @@ const AdBlockRule* AdBlockSearchTree::find(const QNetworkRequest &request, const
   return 0;
 }
 
-const AdBlockRule* AdBlockSearchTree::prefixSearch(const QNetworkRequest &request, const QString &domain, const QString &urlString, const QChar* string, int len) const
+const AdBlockRule* AdBlockSearchTree::prefixSearch(const AdBlockRequestInfo &request, const QString &domain, const QString &urlString, const QChar* string, int len) const
 {
   if (len <= 0) {
     return 0;
   }
 
-  QChar c = string[0];
-
-  if (!m_root->children.contains(c)) {
+  int node = child(0, string[0]);
+  if (node == -1) {
     return 0;
   }
 
-  Node* node = m_root->children[c];
-
   for (int i = 1; i < len; ++i) {
-    const QChar c = (++string)[0];
-
-    if (node->rule && node->rule->networkMatch(request, domain, urlString)) {
-      return node->rule;
+    const AdBlockRule* rule = m_nodes.at(node).rule;
+    if (rule && rule->networkMatch(request, domain, urlString)) {
+      return rule;
     }
 
-    if (!node->children.contains(c)) {
+    node = child(node, (++string)[0]);
+    if (node == -1) {
       return 0;
     }
-
-    node = node->children[c];
   }
 
-  if (node->rule && node->rule->networkMatch(request, domain, urlString)) {
-    return node->rule;
+  const AdBlockRule* rule = m_nodes.at(node).rule;
+  if (rule && rule->networkMatch(request, domain, urlString)) {
+    return rule;
   }
 
   return 0;
 }
-
-void AdBlockSearchTree::deleteNode(AdBlockSearchTree::Node* node)
-{
-  if (!node) {
-    return;
-  }
-
-  QHashIterator<QChar, Node*> i(node->children);
-  while (i.hasNext()) {
-    i.next();
-    deleteNode(i.value());
-  }
-
-  delete node;
-}
@@ -36,10 +36,10 @@
 #define ADBLOCKSEARCHTREE_H
 
 #include <QChar>
-#include <QHash>
-
-class QNetworkRequest;
+#include <QString>
+#include <QVector>
 
+class AdBlockRequestInfo;
 class AdBlockRule;
 
 class AdBlockSearchTree
@@ -51,23 +51,29 @@ public:
   void clear();
 
   bool add(const AdBlockRule* rule);
-  const AdBlockRule* find(const QNetworkRequest &request, const QString &domain, const QString &urlString) const;
+  const AdBlockRule* find(const AdBlockRequestInfo &request, const QString &domain, const QString &urlString) const;
+  qint64 memoryUsage() const;
 
 private:
+  // Nodes are kept in one vector and refer to each other by index.
+  // Children of node form list through nextSibling, children of root
+  // with ASCII characters are also indexed by m_rootChildren
   struct Node {
     QChar c;
+    int firstChild;
+    int nextSibling;
     const AdBlockRule* rule;
-    QHash<QChar, Node*> children;
 
-    Node() : c(0) , rule(0) { }
+    Node() : c(0), firstChild(-1), nextSibling(-1), rule(0) { }
   };
 
-  const AdBlockRule* prefixSearch(const QNetworkRequest &request, const QString &domain,
+  int child(int node, const QChar &c) const;
+  int addChild(int node, const QChar &c);
+  const AdBlockRule* prefixSearch(const AdBlockRequestInfo &request, const QString &domain,
                                   const QString &urlString, const QChar* string, int len) const;
 
-  void deleteNode(Node* node);
-
-  Node* m_root;
+  QVector<Node> m_nodes;
+  int m_rootChildren[128];
 };
 
 #endif // ADBLOCKSEARCHTREE_H
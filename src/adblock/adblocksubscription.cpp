@@ -68,11 +68,17 @@
 #include "common.h"
 
 #include <QFile>
+#include <QFileInfo>
+#include <QDataStream>
 #include <QTimer>
 #include <QNetworkReply>
 #include <QDebug>
 #include <QWebPage>
 
+// Format of file with parsed rules of subscription
+#define ADBLOCK_CACHE_MAGIC 0x41424331  // "ABC1"
+#define ADBLOCK_CACHE_VERSION 2
+
 AdBlockSubscription::AdBlockSubscription(const QString &title, QObject* parent)
   : QObject(parent)
   , m_reply(0)
@@ -111,19 +117,39 @@ void AdBlockSubscription::setUrl(const QUrl &url)
   m_url = url;
 }
 
-void AdBlockSubscription::loadSubscription(const QStringList &disabledRules)
+/** @brief Request reading of subscription file
+ *
+ * File is parsed in thread of matcher update, rules are set
+ * by setLoadedRules() when matcher built from them is ready.
+ *----------------------------------------------------------------------------*/
+void AdBlockSubscription::loadSubscription()
 {
-  QFile file(m_filePath);
-
-  if (!file.exists()) {
+  if (m_title.isEmpty()) {
+    qWarning() << "AdBlockSubscription::" << __FUNCTION__ << "invalid format of adblock file" << m_filePath;
     QTimer::singleShot(0, this, SLOT(updateSubscription()));
     return;
   }
 
+  AdBlockManager::instance()->reloadSubscription(this);
+}
+
+/** @brief Parse rules of subscription file
+ *
+ * Called not in GUI thread, so it must not use subscription itself.
+ * @return false if file is missing or invalid and must be downloaded again
+ *----------------------------------------------------------------------------*/
+bool AdBlockSubscription::readRules(AdBlockSubscription* subscription, const QString &filePath,
+                                    const QSet<QString> &disabledRules, QVector<AdBlockRule*> &rules)
+{
+  QFile file(filePath);
+
+  if (!file.exists()) {
+    return false;
+  }
+
   if (!file.open(QFile::ReadOnly)) {
-    qWarning() << "AdBlockSubscription::" << __FUNCTION__ << "Unable to open adblock file for reading" << m_filePath;
-    QTimer::singleShot(0, this, SLOT(updateSubscription()));
-    return;
+    qWarning() << "AdBlockSubscription::" << __FUNCTION__ << "Unable to open adblock file for reading" << filePath;
+    return false;
   }
 
   QTextStream textStream(&file);
@@ -133,34 +159,143 @@ void AdBlockSubscription::loadSubscription(const QStringList &disabledRules)
   textStream.readLine(1024);
   QString header = textStream.readLine(1024);
 
-  if (!header.startsWith(QLatin1String("[Adblock")) || m_title.isEmpty()) {
-    qWarning() << "AdBlockSubscription::" << __FUNCTION__ << "invalid format of adblock file" << m_filePath;
-    QTimer::singleShot(0, this, SLOT(updateSubscription()));
-    return;
+  if (!header.startsWith(QLatin1String("[Adblock"))) {
+    qWarning() << "AdBlockSubscription::" << __FUNCTION__ << "invalid format of adblock file" << filePath;
+    return false;
   }
 
-  m_rules.clear();
+  if (!loadCache(subscription, filePath, disabledRules, rules)) {
+    while (!textStream.atEnd()) {
+      AdBlockRule* rule = new AdBlockRule(textStream.readLine(), subscription);
 
-  while (!textStream.atEnd()) {
-    AdBlockRule* rule = new AdBlockRule(textStream.readLine(), this);
+      if (disabledRules.contains(rule->filter())) {
+        rule->setEnabled(false);
+      }
 
-    if (disabledRules.contains(rule->filter())) {
-      rule->setEnabled(false);
+      rules.append(rule);
     }
 
-    m_rules.append(rule);
+    saveCache(filePath, rules);
+  }
+
+  return true;
+}
+
+/** @brief Replace rules with ones read by readRules()
+ *
+ * Called by matcher when previous rules are not used anymore.
+ *----------------------------------------------------------------------------*/
+void AdBlockSubscription::setLoadedRules(const QVector<AdBlockRule*> &rules, bool loaded)
+{
+  qDeleteAll(m_rules);
+  m_rules = rules;
+
+  if (m_updated) {
+    emit subscriptionUpdated();
   }
 
   // Initial update
-  if (m_rules.isEmpty() && !m_updated) {
+  if (!loaded || (m_rules.isEmpty() && !m_updated)) {
     QTimer::singleShot(0, this, SLOT(updateSubscription()));
   }
 }
 
+/** @brief Give up ownership of rules, used when subscription is removed
+ *----------------------------------------------------------------------------*/
+QVector<AdBlockRule*> AdBlockSubscription::releaseRules()
+{
+  QVector<AdBlockRule*> rules = m_rules;
+  m_rules.clear();
+  return rules;
+}
+
 void AdBlockSubscription::saveSubscription()
 {
 }
 
+QString AdBlockSubscription::cacheFilePath(const QString &filePath)
+{
+  return filePath + QLatin1String(".cache");
+}
+
+/** @brief Load parsed rules from cache file
+ *
+ * Cache is used only if subscription file has the same size and
+ * modification time as when cache was written.
+ *----------------------------------------------------------------------------*/
+bool AdBlockSubscription::loadCache(AdBlockSubscription* subscription, const QString &filePath,
+                                    const QSet<QString> &disabledRules, QVector<AdBlockRule*> &rules)
+{
+  QFile file(cacheFilePath(filePath));
+  if (!file.open(QFile::ReadOnly) || (file.size() <= 0))
+    return false;
+
+  uchar* data = file.map(0, file.size());
+  if (!data)
+    return false;
+
+  QByteArray byteArray = QByteArray::fromRawData(reinterpret_cast<const char*>(data), file.size());
+  QDataStream stream(byteArray);
+  stream.setVersion(QDataStream::Qt_4_6);
+
+  QFileInfo fileInfo(filePath);
+  quint32 magic;
+  quint32 version;
+  qint64 size;
+  qint64 modified;
+  qint32 count;
+  stream >> magic >> version >> size >> modified >> count;
+  if ((stream.status() != QDataStream::Ok) ||
+      (magic != ADBLOCK_CACHE_MAGIC) || (version != ADBLOCK_CACHE_VERSION) ||
+      (size != fileInfo.size()) ||
+      (modified != fileInfo.lastModified().toMSecsSinceEpoch()) ||
+      (count < 0)) {
+    return false;
+  }
+
+  QVector<AdBlockRule*> cachedRules;
+  cachedRules.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    AdBlockRule* rule = new AdBlockRule(QString(), subscription);
+    if (!rule->readParsed(stream)) {
+      delete rule;
+      qDeleteAll(cachedRules);
+      qWarning() << "AdBlockSubscription::" << __FUNCTION__ << "invalid adblock cache file" << cacheFilePath(filePath);
+      return false;
+    }
+
+    if (disabledRules.contains(rule->filter())) {
+      rule->setEnabled(false);
+    }
+
+    cachedRules.append(rule);
+  }
+
+  rules = cachedRules;
+  return true;
+}
+
+/** @brief Write parsed rules to cache file
+ *----------------------------------------------------------------------------*/
+void AdBlockSubscription::saveCache(const QString &filePath, const QVector<AdBlockRule*> &rules)
+{
+  QFile file(cacheFilePath(filePath));
+  if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+    qWarning() << "AdBlockSubscription::" << __FUNCTION__ << "Unable to open adblock cache file for writing" << cacheFilePath(filePath);
+    return;
+  }
+
+  QFileInfo fileInfo(filePath);
+  QDataStream stream(&file);
+  stream.setVersion(QDataStream::Qt_4_6);
+  stream << quint32(ADBLOCK_CACHE_MAGIC) << quint32(ADBLOCK_CACHE_VERSION)
+         << qint64(fileInfo.size()) << qint64(fileInfo.lastModified().toMSecsSinceEpoch())
+         << qint32(rules.count());
+  foreach (const AdBlockRule* rule, rules) {
+    rule->writeParsed(stream);
+  }
+}
+
 void AdBlockSubscription::updateSubscription()
 {
   if (m_reply || !m_url.isValid()) {
@@ -196,10 +331,8 @@ void AdBlockSubscription::subscriptionDownloaded()
     return;
   }
 
-  loadSubscription(AdBlockManager::instance()->disabledRules());
-
-  emit subscriptionUpdated();
-  emit subscriptionChanged();
+  m_updated = true;
+  loadSubscription();
 }
 
 bool AdBlockSubscription::saveDownloadedData(const QByteArray &data)
@@ -330,7 +463,7 @@ void AdBlockCustomList::retranslateStrings()
   setTitle(tr("Custom Rules"));
 }
 
-void AdBlockCustomList::loadSubscription(const QStringList &disabledRules)
+void AdBlockCustomList::loadSubscription()
 {
   // DuckDuckGo ad whitelist rules
   // They cannot be removed, but can be disabled.
@@ -354,7 +487,7 @@ void AdBlockCustomList::loadSubscription(const QStringList &disabledRules)
   }
   file.close();
 
-  AdBlockSubscription::loadSubscription(disabledRules);
+  AdBlockSubscription::loadSubscription();
 }
 
 void AdBlockCustomList::saveSubscription()
@@ -443,7 +576,7 @@ bool AdBlockCustomList::removeRule(int offset)
 
   AdBlockManager::instance()->removeDisabledRule(filter);
 
-  delete rule;
+  AdBlockManager::instance()->retireRules(QVector<AdBlockRule*>() << rule);
   return true;
 }
 
@@ -461,6 +594,6 @@ const AdBlockRule* AdBlockCustomList::replaceRule(AdBlockRule* rule, int offset)
   if (rule->isCssRule() || oldRule->isCssRule())
     mainApp->reloadUserStyleBrowser();
 
-  delete oldRule;
+  AdBlockManager::instance()->retireRules(QVector<AdBlockRule*>() << oldRule);
   return m_rules[offset];
 }
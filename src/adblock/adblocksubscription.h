@@ -63,6 +63,7 @@
 #ifndef ADBLOCKSUBSCRIPTION_H
 #define ADBLOCKSUBSCRIPTION_H
 
+#include <QSet>
 #include <QVector>
 #include <QUrl>
 
@@ -91,9 +92,16 @@ public:
   QUrl url() const;
   void setUrl(const QUrl &url);
 
-  virtual void loadSubscription(const QStringList &disabledRules);
+  virtual void loadSubscription();
   virtual void saveSubscription();
 
+  static bool readRules(AdBlockSubscription* subscription, const QString &filePath,
+                        const QSet<QString> &disabledRules, QVector<AdBlockRule*> &rules);
+  void setLoadedRules(const QVector<AdBlockRule*> &rules, bool loaded);
+  QVector<AdBlockRule*> releaseRules();
+
+  static QString cacheFilePath(const QString &filePath);
+
   const AdBlockRule* rule(int offset) const;
   QVector<AdBlockRule*> allRules() const;
 
@@ -121,6 +129,10 @@ protected slots:
 protected:
   virtual bool saveDownloadedData(const QByteArray &data);
 
+  static bool loadCache(AdBlockSubscription* subscription, const QString &filePath,
+                        const QSet<QString> &disabledRules, QVector<AdBlockRule*> &rules);
+  static void saveCache(const QString &filePath, const QVector<AdBlockRule*> &rules);
+
   FollowRedirectReply* m_reply;
 
   QVector<AdBlockRule*> m_rules;
@@ -141,7 +153,7 @@ public:
 
   void retranslateStrings();
 
-  void loadSubscription(const QStringList &disabledRules);
+  void loadSubscription();
   void saveSubscription();
 
   bool canEditRules() const;
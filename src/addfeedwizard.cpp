@@ -22,14 +22,22 @@
 #include "authenticationdialog.h"
 #include "toolbutton.h"
 #include "settings.h"
+#include "updatefeeds.h"
 
 #include <QDomDocument>
 #include <qzregexp.h>
 
+// Bytes of reply checked before candidate is dropped as not a feed
+#define PROBE_SNIFF_SIZE 4096
+// Bytes of page read when its head does not end earlier
+#define PAGE_HEAD_MAX_SIZE 65536
+#define PROBE_REDIRECTS_MAX 5
+
 extern QString kCreateNewsTableQuery;
 
 AddFeedWizard::AddFeedWizard(QWidget *parent, int curFolderId)
   : QWizard(parent),
+    feedId_(-1),
     curFolderId_(curFolderId)
 {
   setModal(true);
@@ -42,7 +50,12 @@ AddFeedWizard::AddFeedWizard(QWidget *parent, int curFolderId)
   addPage(createUrlFeedPage());
   addPage(createNameFeedPage());
 
-  updateFeeds_ = new UpdateFeeds(this, true);
+  // Found feed is parsed and stored by pipeline of updates
+  UpdateFeeds *updateFeeds = mainApp->updateFeeds();
+  connect(this, SIGNAL(xmlReadyParse(QByteArray,int,QDateTime,QString)),
+          updateFeeds->parseObject_, SLOT(parseXml(QByteArray,int,QDateTime,QString)));
+  connect(updateFeeds->parseObject_, SIGNAL(signalFinishUpdate(int,bool,int,QString)),
+          this, SLOT(slotUpdateFeed(int,bool,int,QString)));
 
   connect(button(QWizard::BackButton), SIGNAL(clicked()),
           this, SLOT(backButtonClicked()));
@@ -64,13 +77,13 @@ AddFeedWizard::~AddFeedWizard()
   Settings settings;
   settings.setValue("addFeedWizard/geometry", saveGeometry());
 
-  updateFeeds_->disconnectObjects();
-  delete updateFeeds_;
+  stopProbes();
 }
 
 /*virtual*/ void AddFeedWizard::done(int result)
 {
   if (result == QDialog::Rejected) {
+    stopProbes();
     if (progressBar_->isVisible() || (currentId() == 1))
       deleteFeed();
   }
@@ -408,7 +421,16 @@ void AddFeedWizard::addFeed()
       mainApp->cookieJar()->setCookiesFromUrl(loadedCookies, feedUrlString_);
     }
 
-    emit signalRequestUrl(feedId_, feedUrlString_, QDateTime(), userInfo);
+    QUrl url(feedUrlString_);
+    if (!userInfo.isEmpty())
+      url.setUserInfo(userInfo);
+
+    probes_.clear();
+    FeedProbe probe;
+    probe.url = feedUrlString_;
+    probe.state = FeedProbe::Pending;
+    probes_.append(probe);
+    probeUrl(0, url);
   }
 }
 
@@ -460,120 +482,261 @@ void AddFeedWizard::slotProgressBarUpdate()
     QTimer::singleShot(250, this, SLOT(slotProgressBarUpdate()));
 }
 
-void AddFeedWizard::getUrlDone(int result, int feedId, QString feedUrlStr,
-                               QString error, QByteArray data,
-                               QDateTime dtReply, QString codecName)
+/** @brief Check if data is RSS, Atom or JSON feed
+ *----------------------------------------------------------------------------*/
+/*static*/ bool AddFeedWizard::isFeedData(const QByteArray &data)
+{
+  if (RequestFeed::isJsonFeedData(data))
+    return true;
+  if (!RequestFeed::isFeedData(data))
+    return false;
+
+  QString errorStr;
+  int errorLine;
+  int errorColumn;
+  QDomDocument doc("parseDoc");
+  if (!doc.setContent(data, false, &errorStr, &errorLine, &errorColumn)) {
+    qWarning() << QString("Parse data error (1): line %1, column %2: %3").
+                  arg(errorLine).arg(errorColumn).arg(errorStr);
+    return false;
+  }
+  QDomElement docElem = doc.documentElement();
+  return ((docElem.tagName() == "rss") || (docElem.tagName() == "feed") ||
+          (docElem.tagName() == "rdf:RDF"));
+}
+
+/** @brief Request candidate URL of feed
+ *
+ * Probes share network manager of application and run in parallel.
+ *----------------------------------------------------------------------------*/
+void AddFeedWizard::probeUrl(int index, const QUrl &url, int redirects)
 {
-  if (!data.isEmpty()) {
-    bool isFeed = false;
-    QString errorStr;
-    int errorLine;
-    int errorColumn;
-    QDomDocument doc("parseDoc");
-    if (!doc.setContent(data, false, &errorStr, &errorLine, &errorColumn)) {
-      qWarning() << QString("Parse data error (1): url %1, id %2, line %3, column %4: %5").
-                    arg(feedUrlStr).arg(feedId).
-                    arg(errorLine).arg(errorColumn).arg(errorStr);
+  QNetworkRequest request(url);
+  request.setRawHeader("Accept", "application/atom+xml,application/rss+xml;q=0.9,application/xml;q=0.8,text/xml;q=0.7,*/*;q=0.6");
+
+  QNetworkReply *reply = mainApp->networkManager()->get(request);
+  reply->setProperty("redirects", redirects);
+  connect(reply, SIGNAL(readyRead()), this, SLOT(slotProbeDataRead()));
+  connect(reply, SIGNAL(finished()), this, SLOT(slotProbeFinished()));
+  probeReplies_.insert(reply, index);
+}
+
+/** @brief Stop reading reply which is known not to be a feed
+ *
+ * Only head of entered page is needed to find links to feeds, candidates
+ * are dropped after first bytes if they don't look like feed.
+ *----------------------------------------------------------------------------*/
+void AddFeedWizard::slotProbeDataRead()
+{
+  QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+  if (!reply || !probeReplies_.contains(reply) ||
+      (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() != 200))
+    return;
+
+  const QByteArray data = reply->peek(reply->bytesAvailable());
+  if ((data.size() < PROBE_SNIFF_SIZE) || RequestFeed::isFeedData(data))
+    return;
+
+  if (probeReplies_.value(reply) == 0) {
+    QByteArray lowerData = data.toLower();
+    if ((data.size() < PAGE_HEAD_MAX_SIZE) &&
+        (lowerData.indexOf("</head") == -1) && (lowerData.indexOf("<body") == -1))
+      return;
+    reply->setProperty("pageHead", reply->readAll());
+  } else {
+    reply->setProperty("notFeed", true);
+  }
+  disconnect(reply, SIGNAL(readyRead()), this, SLOT(slotProbeDataRead()));
+  reply->abort();
+}
+
+/** @brief Finish probe request
+ *
+ * Feed links found in entered page are probed all at once.
+ *----------------------------------------------------------------------------*/
+void AddFeedWizard::slotProbeFinished()
+{
+  QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+  if (!reply) return;
+  reply->deleteLater();
+  if (!probeReplies_.contains(reply)) return;
+
+  int index = probeReplies_.take(reply);
+  FeedProbe &probe = probes_[index];
+  QByteArray pageHead = reply->property("pageHead").toByteArray();
+
+  if (reply->property("notFeed").toBool()) {
+    probe.state = FeedProbe::Failed;
+  } else if ((reply->error() == QNetworkReply::NoError) || !pageHead.isNull()) {
+    QUrl redirectionTarget = reply->attribute(QNetworkRequest::RedirectionTargetAttribute).toUrl();
+    if (redirectionTarget.isValid()) {
+      int redirects = reply->property("redirects").toInt();
+      if (redirects < PROBE_REDIRECTS_MAX) {
+        probeUrl(index, reply->url().resolved(redirectionTarget), redirects + 1);
+        return;
+      }
+      probe.state = FeedProbe::Failed;
+      probe.error = tr("Request failed!");
     } else {
-      QDomElement docElem = doc.documentElement();
-      if ((docElem.tagName() == "rss") || (docElem.tagName() == "feed") ||
-          (docElem.tagName() == "rdf:RDF"))
-        isFeed = true;
+      QByteArray data = pageHead.isNull() ? reply->readAll() : pageHead;
+      QByteArray feedData = RequestFeed::sanitizeData(data);
+      if (!feedData.isEmpty() && isFeedData(feedData)) {
+        QzRegExp rx("charset=([^\t]+)$", Qt::CaseInsensitive);
+        if (rx.indexIn(reply->header(QNetworkRequest::ContentTypeHeader).toString()) > -1)
+          probe.codecName = rx.cap(1);
+        probe.data = feedData;
+        QDateTime replyDate = reply->header(QNetworkRequest::LastModifiedHeader).toDateTime();
+        probe.dtReply = QDateTime(replyDate.date(), replyDate.time());
+        probe.state = FeedProbe::Feed;
+      } else {
+        probe.state = FeedProbe::Failed;
+        // Probes are appended, so probe is not used after
+        if (index == 0)
+          probeFeedLinks(data, reply->url().toString());
+      }
     }
+  } else {
+    probe.state = FeedProbe::Failed;
+    probe.error = reply->errorString();
+    qWarning() << QString("Request failed: error - %1, url - %2").
+                  arg(probe.error, probe.url);
+  }
 
-    if (!isFeed) {
-      QString str = QString::fromUtf8(data);
-
-      QzRegExp rx("<link[^>]+(atom|rss)\\+xml[^>]+>", Qt::CaseInsensitive);
-      int pos = rx.indexIn(str);
-      if (pos > -1) {
-        str = rx.cap(0);
-        rx.setPattern("href=\"([^\"]+)");
-        pos = rx.indexIn(str);
-        if (pos > -1) {
-          QString linkFeedString = rx.cap(1);
-          linkFeedString.replace("&amp;", "&", Qt::CaseInsensitive);
-          QUrl url(linkFeedString);
-          QUrl feedUrl(feedUrlStr);
-          if (url.host().isEmpty()) {
-            url.setScheme(feedUrl.scheme());
-            url.setHost(feedUrl.host());
-            if (feedUrl.toString().indexOf('?') > -1) {
-              str = feedUrl.path();
-              str = str.left(str.lastIndexOf('/')+1);
-              url.setPath(str+url.path());
-            }
-          }
-          linkFeedString = url.toString();
-          qDebug() << "Parse feed URL, valid:" << linkFeedString;
-
-          QSqlQuery q;
-          int duplicateFoundId = -1;
-          q.prepare("SELECT id FROM feeds WHERE xmlUrl LIKE :xmlUrl");
-          q.bindValue(":xmlUrl", linkFeedString);
-          q.exec();
-          if (q.next()) duplicateFoundId = q.value(0).toInt();
-
-          if (0 <= duplicateFoundId) {
-            if (feedUrlString_ != linkFeedString)
-              textWarning->setText(tr("Duplicate feed!"));
-            else
-              textWarning->setText(tr("Can't find feed URL!"));
-            warningWidget_->setVisible(true);
-
-            deleteFeed();
-            progressBar_->hide();
-            page(0)->setEnabled(true);
-            selectedPage = false;
-            button(QWizard::CancelButton)->setEnabled(true);
-          } else {
-            feedUrlString_ = linkFeedString;
-            q.prepare("UPDATE feeds SET xmlUrl = :xmlUrl WHERE id == :id");
-            q.bindValue(":xmlUrl", linkFeedString);
-            q.bindValue(":id", feedId);
-            q.exec();
-
-            authentication_->setChecked(false);
-
-            emit signalRequestUrl(feedId, linkFeedString, QDateTime(), "");
-          }
-        }
+  checkProbes();
+}
+
+/** @brief Probe every feed link of page
+ *----------------------------------------------------------------------------*/
+void AddFeedWizard::probeFeedLinks(const QByteArray &data, const QString &pageUrl)
+{
+  QString str = QString::fromUtf8(data);
+  QUrl feedUrl(pageUrl);
+
+  QzRegExp rx("<link[^>]+(atom\\+xml|rss\\+xml|feed\\+json)[^>]+>", Qt::CaseInsensitive);
+  QzRegExp rxHref("href=\"([^\"]+)", Qt::CaseInsensitive);
+  int pos = 0;
+  while ((pos = rx.indexIn(str, pos)) > -1) {
+    QString linkStr = rx.cap(0);
+    pos += rx.matchedLength();
+    if (rxHref.indexIn(linkStr) == -1)
+      continue;
+
+    QString linkFeedString = rxHref.cap(1);
+    linkFeedString.replace("&amp;", "&", Qt::CaseInsensitive);
+    QUrl url(linkFeedString);
+    if (url.host().isEmpty()) {
+      url.setScheme(feedUrl.scheme());
+      url.setHost(feedUrl.host());
+      if (feedUrl.toString().indexOf('?') > -1) {
+        QString path = feedUrl.path();
+        path = path.left(path.lastIndexOf('/')+1);
+        url.setPath(path+url.path());
       }
-      if (pos < 0) {
-        textWarning->setText(tr("Can't find feed URL!"));
-        warningWidget_->setVisible(true);
-
-        deleteFeed();
-        progressBar_->hide();
-        page(0)->setEnabled(true);
-        selectedPage = false;
-        button(QWizard::CancelButton)->setEnabled(true);
+    }
+    linkFeedString = url.toString();
+
+    bool probed = false;
+    foreach (const FeedProbe &probe, probes_) {
+      if (probe.url == linkFeedString) {
+        probed = true;
+        break;
       }
-      return;
     }
+    if (probed) continue;
+
+    qDebug() << "Parse feed URL, valid:" << linkFeedString;
+    FeedProbe probe;
+    probe.url = linkFeedString;
+    probe.state = FeedProbe::Pending;
+    probes_.append(probe);
+    probeUrl(probes_.count() - 1, url);
+  }
+}
 
-    emit xmlReadyParse(data, feedId, dtReply, codecName);
+/** @brief Select first feed in order of page links when it is known
+ *
+ * Feed is rejected if other feed already has its URL. Data of selected
+ * feed is passed to parser without new request.
+ *----------------------------------------------------------------------------*/
+void AddFeedWizard::checkProbes()
+{
+  int index = -1;
+  for (int i = 0; i < probes_.count(); ++i) {
+    if (probes_.at(i).state == FeedProbe::Pending)
+      return;
+    if (probes_.at(i).state == FeedProbe::Feed) {
+      index = i;
+      break;
+    }
   }
 
-  if ((result < 0) || data.isEmpty()) {
-    if ((result >= -5) && (result <= -1))
-      textWarning->setText(error);
+  if (index == -1) {
+    if ((probes_.count() == 1) && !probes_.at(0).error.isEmpty())
+      addFeedFailed(probes_.at(0).error);
     else
-      textWarning->setText(tr("Request failed!"));
-    warningWidget_->setVisible(true);
-    qWarning() << QString("Request failed: result = %1, error - %2, url - %3").
-                  arg(result).arg(error).arg(feedUrlStr);
+      addFeedFailed(tr("Can't find feed URL!"));
+    return;
+  }
 
-    deleteFeed();
-    progressBar_->hide();
-    page(0)->setEnabled(true);
-    selectedPage = false;
-    button(QWizard::CancelButton)->setEnabled(true);
+  stopProbes();
+  FeedProbe probe = probes_.at(index);
+  probes_.clear();
+
+  if (index > 0) {
+    QSqlQuery q;
+    q.prepare("SELECT id FROM feeds WHERE xmlUrl LIKE :xmlUrl");
+    q.bindValue(":xmlUrl", probe.url);
+    q.exec();
+    if (q.next()) {
+      addFeedFailed(tr("Duplicate feed!"));
+      return;
+    }
+
+    feedUrlString_ = probe.url;
+    q.prepare("UPDATE feeds SET xmlUrl = :xmlUrl WHERE id == :id");
+    q.bindValue(":xmlUrl", probe.url);
+    q.bindValue(":id", feedId_);
+    q.exec();
+
+    authentication_->setChecked(false);
+  }
+
+  emit xmlReadyParse(probe.data, feedId_, probe.dtReply, probe.codecName);
+}
+
+/** @brief Abort probes which are not finished
+ *----------------------------------------------------------------------------*/
+void AddFeedWizard::stopProbes()
+{
+  QList<QNetworkReply*> replies = probeReplies_.keys();
+  probeReplies_.clear();
+  foreach (QNetworkReply *reply, replies) {
+    reply->abort();
   }
 }
 
+/** @brief Show error and return to page of URL
+ *----------------------------------------------------------------------------*/
+void AddFeedWizard::addFeedFailed(const QString &error)
+{
+  stopProbes();
+  probes_.clear();
+
+  textWarning->setText(error);
+  warningWidget_->setVisible(true);
+
+  deleteFeed();
+  progressBar_->hide();
+  page(0)->setEnabled(true);
+  selectedPage = false;
+  button(QWizard::CancelButton)->setEnabled(true);
+}
+
 void AddFeedWizard::slotUpdateFeed(int feedId, bool, int newCount, QString)
 {
+  // Pipeline reports all updated feeds
+  if (feedId != feedId_) return;
+
   qDebug() << "ParseDone: " << feedUrlString_;
   selectedPage = true;
   newCount_ = newCount;
@@ -25,9 +25,9 @@
 #include <QWizard>
 #endif
 #include <QtSql>
+#include <QNetworkReply>
 
 #include "lineedit.h"
-#include "updatefeeds.h"
 
 class AddFeedWizard : public QWizard
 {
@@ -47,16 +47,11 @@ public:
   int newCount_;
 
 public slots:
-  void getUrlDone(int result, int feedId, QString feedUrlStr,
-                  QString error, QByteArray data,
-                  QDateTime dtReply, QString codecName);
   void slotUpdateFeed(int feedId, bool, int newCount, QString);
 
 signals:
   void xmlReadyParse(QByteArray data, int feedId,
                      QDateTime dtReply, QString codecName);
-  void signalRequestUrl(int feedId, QString urlString,
-                        QDateTime date, QString userInfo);
 
 protected:
   virtual bool validateCurrentPage();
@@ -73,14 +68,34 @@ private slots:
   void titleFeedAsNameStateChanged(int);
   void slotProgressBarUpdate();
   void newFolder();
+  void slotProbeDataRead();
+  void slotProbeFinished();
 
 private:
+  // Candidate URL of feed checked by probe request
+  struct FeedProbe {
+    enum State { Pending, Failed, Feed };
+    QString url;
+    State state;
+    QString error;
+    QByteArray data;
+    QDateTime dtReply;
+    QString codecName;
+  };
+
   void addFeed();
   void deleteFeed();
   void showProgressBar();
   void finish();
+  void probeUrl(int index, const QUrl &url, int redirects = 0);
+  void probeFeedLinks(const QByteArray &data, const QString &pageUrl);
+  void checkProbes();
+  void stopProbes();
+  void addFeedFailed(const QString &error);
+  static bool isFeedData(const QByteArray &data);
 
-  UpdateFeeds *updateFeeds_;
+  QList<FeedProbe> probes_;
+  QHash<QNetworkReply*, int> probeReplies_;
   QWizardPage *createUrlFeedPage();
   QWizardPage *createNameFeedPage();
   QCheckBox *titleFeedAsName_;
@@ -0,0 +1,204 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "eventtrace.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStringList>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+
+namespace {
+
+struct Record {
+  qint64 time;     // microseconds since start of trace
+  qint32 value;    // duration of complete event or value of instant event
+  qint32 feedId;
+  quint16 thread;  // index in thread names
+  quint8 event;
+  char phase;      // Chrome trace phase: X, b, e, i
+};
+
+QMutex traceMutex;
+QElapsedTimer traceClock;
+QVector<Record> records;
+// Total number of appended records, position in ring is its remainder
+qint64 recordsTotal = 0;
+QHash<Qt::HANDLE, quint16> threadIndexes;
+QStringList threadNames;
+
+const char *eventNames[EventTrace::EventCount] = {
+  "FeedUpdate", "QueueWait", "Request", "Decode", "Parse", "Store", "Result"
+};
+
+QString jsonString(const QString &text)
+{
+  QString result = text;
+  result.replace('\\', "\\\\").replace('"', "\\\"");
+  return "\"" + result + "\"";
+}
+
+} // namespace
+
+bool EventTrace::enabled_ = false;
+
+EventTrace::EventTrace()
+{
+}
+
+void EventTrace::setEnabled(bool enabled)
+{
+  QMutexLocker locker(&traceMutex);
+
+  if (enabled && records.isEmpty()) {
+    records.resize(TRACE_RING_SIZE);
+    traceClock.start();
+  }
+  enabled_ = enabled;
+}
+
+void EventTrace::clear()
+{
+  QMutexLocker locker(&traceMutex);
+  recordsTotal = 0;
+}
+
+/** @brief Time of trace in microseconds
+ *----------------------------------------------------------------------------*/
+qint64 EventTrace::now()
+{
+  return traceClock.nsecsElapsed() / 1000;
+}
+
+/** @brief Add event lasted from \a start till now
+ *----------------------------------------------------------------------------*/
+void EventTrace::complete(Event event, int feedId, qint64 start)
+{
+  if (!enabled_) return;
+  qint64 time = now();
+  append(event, 'X', feedId, start, time - start);
+}
+
+/** @brief Start event of feed, which can end in other thread
+ *----------------------------------------------------------------------------*/
+void EventTrace::begin(Event event, int feedId)
+{
+  if (!enabled_) return;
+  append(event, 'b', feedId, now(), 0);
+}
+
+void EventTrace::end(Event event, int feedId)
+{
+  if (!enabled_) return;
+  append(event, 'e', feedId, now(), 0);
+}
+
+void EventTrace::instant(Event event, int feedId, int value)
+{
+  if (!enabled_) return;
+  append(event, 'i', feedId, now(), value);
+}
+
+void EventTrace::append(Event event, char phase, int feedId, qint64 time, qint64 value)
+{
+  Qt::HANDLE threadId = QThread::currentThreadId();
+
+  QMutexLocker locker(&traceMutex);
+
+  QHash<Qt::HANDLE, quint16>::const_iterator it = threadIndexes.constFind(threadId);
+  quint16 thread;
+  if (it == threadIndexes.constEnd()) {
+    thread = threadNames.count();
+    QString name = QThread::currentThread()->objectName();
+    if (name.isEmpty())
+      name = QString("thread_%1").arg(thread);
+    threadNames.append(name);
+    threadIndexes.insert(threadId, thread);
+  } else {
+    thread = it.value();
+  }
+
+  Record &record = records[recordsTotal % TRACE_RING_SIZE];
+  record.time = time;
+  record.value = static_cast<qint32>(qMin(value, static_cast<qint64>(0x7fffffff)));
+  record.feedId = feedId;
+  record.thread = thread;
+  record.event = event;
+  record.phase = phase;
+  recordsTotal++;
+}
+
+/** @brief Write records kept in ring as Chrome trace JSON
+ *
+ * File can be opened in chrome://tracing or ui.perfetto.dev.
+ *----------------------------------------------------------------------------*/
+bool EventTrace::exportChromeTrace(const QString &fileName)
+{
+  QVector<Record> snapshot;
+  QStringList names;
+  {
+    QMutexLocker locker(&traceMutex);
+    int count = static_cast<int>(qMin(recordsTotal, static_cast<qint64>(TRACE_RING_SIZE)));
+    snapshot.reserve(count);
+    for (qint64 i = recordsTotal - count; i < recordsTotal; ++i)
+      snapshot.append(records.at(i % TRACE_RING_SIZE));
+    names = threadNames;
+  }
+
+  QFile file(fileName);
+  if (!file.open(QFile::WriteOnly | QFile::Truncate))
+    return false;
+
+  QTextStream out(&file);
+  out.setCodec("UTF-8");
+  out << "{\"traceEvents\":[\n";
+  for (int i = 0; i < names.count(); ++i) {
+    out << QString("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%1,"
+                   "\"args\":{\"name\":%2}},\n").arg(i).arg(jsonString(names.at(i)));
+  }
+
+  for (int i = 0; i < snapshot.count(); ++i) {
+    const Record &record = snapshot.at(i);
+    QString line = QString("{\"name\":\"%1\",\"cat\":\"feed\",\"ph\":\"%2\",\"pid\":1,"
+                           "\"tid\":%3,\"ts\":%4").
+        arg(eventNames[record.event]).arg(QChar(record.phase)).
+        arg(record.thread).arg(record.time);
+    switch (record.phase) {
+    case 'X':
+      line.append(QString(",\"dur\":%1,\"args\":{\"feedId\":%2}").
+                  arg(record.value).arg(record.feedId));
+      break;
+    case 'i':
+      line.append(QString(",\"s\":\"t\",\"args\":{\"feedId\":%1,\"result\":%2}").
+                  arg(record.feedId).arg(record.value));
+      break;
+    default:
+      line.append(QString(",\"id\":%1,\"args\":{\"feedId\":%1}").arg(record.feedId));
+    }
+    line.append((i < snapshot.count() - 1) ? "},\n" : "}\n");
+    out << line;
+  }
+  out << "],\"displayTimeUnit\":\"ms\"}\n";
+  out.flush();
+
+  return file.error() == QFile::NoError;
+}
@@ -0,0 +1,67 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef EVENTTRACE_H
+#define EVENTTRACE_H
+
+#include <QString>
+
+// Number of records kept in ring, older records are overwritten
+#define TRACE_RING_SIZE (1 << 18)
+
+/** @brief Binary trace of feed update events
+ *
+ * Records are fixed size and stored in ring buffer, so tracing of long
+ * update sessions costs constant memory. Trace is converted into Chrome
+ * trace (Perfetto) JSON only on export.
+ *----------------------------------------------------------------------------*/
+class EventTrace
+{
+public:
+  enum Event {
+    FeedUpdate = 0, // feed in update queue till finish of update
+    QueueWait,      // request waits in host queue
+    Request,        // network request
+    Decode,         // conversion of data to unicode
+    Parse,          // reading xml
+    Store,          // writing of feed into base
+    Result,         // result of request
+    EventCount
+  };
+
+  static bool isEnabled() { return enabled_; }
+  static void setEnabled(bool enabled);
+  static void clear();
+
+  static qint64 now();
+  static void complete(Event event, int feedId, qint64 start);
+  static void begin(Event event, int feedId);
+  static void end(Event event, int feedId);
+  static void instant(Event event, int feedId, int value);
+
+  static bool exportChromeTrace(const QString &fileName);
+
+private:
+  explicit EventTrace();
+
+  static void append(Event event, char phase, int feedId, qint64 time, qint64 value);
+
+  static bool enabled_;
+
+};
+
+#endif // EVENTTRACE_H
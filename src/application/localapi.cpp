@@ -0,0 +1,171 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "localapi.h"
+
+#include "common.h"
+#include "database.h"
+#include "logfile.h"
+#include "mainapplication.h"
+#include "updatefeeds.h"
+
+#include <QDebug>
+#include <QSqlQuery>
+
+// Number of news returned by 'latest' without count and maximum number
+#define LATEST_NEWS_DEFAULT 20
+#define LATEST_NEWS_MAX 1000
+
+static QString jsonError(const QString &text)
+{
+  return QString("{\"error\": %1}").arg(Common::jsonString(text));
+}
+
+LocalApi::LocalApi(QObject *parent)
+  : QObject(parent)
+{
+  setObjectName("localApi_");
+}
+
+/** @brief Process request, called directly by local peer
+ *---------------------------------------------------------------------------*/
+void LocalApi::handleRequest(const QString &request, QString *reply)
+{
+  LOG_DEBUG(LogFile::Local) << QString("Local request: %1").arg(request);
+
+  QStringList words = request.simplified().split(' ', QString::SkipEmptyParts);
+  QString command = words.value(0).toLower();
+  bool ok = true;
+  QList<int> args;
+  for (int i = 1; i < words.count() && ok; ++i)
+    args.append(words.at(i).toInt(&ok));
+
+  if (mainApp->isClosing()) {
+    *reply = jsonError("closing");
+  } else if (!ok) {
+    *reply = jsonError("wrong argument");
+  } else if (command == "refresh") {
+    *reply = refresh(args.value(0));
+  } else if (command == "unread") {
+    *reply = unreadCounts(args.value(0));
+  } else if (command == "latest") {
+    *reply = latestNews(args.value(0, LATEST_NEWS_DEFAULT), args.value(1));
+  } else {
+    *reply = jsonError("unknown request");
+  }
+}
+
+/** @brief Condition of news of feed or folder, all feeds if id is 0
+ *---------------------------------------------------------------------------*/
+QString LocalApi::feedsCondition(int id) const
+{
+  if (id <= 0)
+    return QString("1");
+  return UpdateObject::getIdFeedsString(id);
+}
+
+/** @brief Queue update of feeds
+ *---------------------------------------------------------------------------*/
+QString LocalApi::refresh(int id)
+{
+  UpdateFeeds *updateFeeds = mainApp->updateFeeds();
+  if (!updateFeeds || !updateFeeds->updateObject_)
+    return jsonError("update is not available");
+
+  QString condition = "xmlUrl!='' AND disableUpdate=0";
+  if (id > 0)
+    condition.append(QString(" AND id IN (WITH RECURSIVE folder(id) AS ("
+                             "SELECT %1 UNION ALL "
+                             "SELECT feeds.id FROM feeds, folder WHERE feeds.parentId=folder.id) "
+                             "SELECT id FROM folder)").arg(id));
+
+  QSqlQuery q;
+  q.exec(QString("SELECT count(*) FROM feeds WHERE %1").arg(condition));
+  int count = q.first() ? q.value(0).toInt() : 0;
+  if (!count)
+    return jsonError("no feeds to update");
+
+  // Update object selects feeds by query in own thread
+  QMetaObject::invokeMethod(updateFeeds->updateObject_, "slotGetFeedsFolder",
+                            Qt::QueuedConnection,
+                            Q_ARG(QString, QString("SELECT id, xmlUrl, lastBuildDate, authentication "
+                                                   "FROM feeds WHERE %1").arg(condition)));
+  return QString("{\"queued\": %1}").arg(count);
+}
+
+/** @brief Unread and new counts, per feed if all feeds are requested
+ *---------------------------------------------------------------------------*/
+QString LocalApi::unreadCounts(int id)
+{
+  QSqlQuery q(Database::readConnection(Database::ReadCounters));
+  if (id > 0) {
+    q.prepare("SELECT text, feedsState.unread, feedsState.newCount FROM feeds "
+              "LEFT JOIN feedsState ON feedsState.feedId=feeds.id WHERE id=?");
+    q.addBindValue(id);
+    q.exec();
+    if (!q.first())
+      return jsonError("feed not found");
+    return QString("{\"id\": %1, \"title\": %2, \"unread\": %3, \"new\": %4}").
+        arg(QString::number(id), Common::jsonString(q.value(0).toString()),
+            QString::number(q.value(1).toInt()), QString::number(q.value(2).toInt()));
+  }
+
+  int unreadTotal = 0;
+  int newTotal = 0;
+  QStringList feeds;
+  q.exec("SELECT id, text, feedsState.unread, feedsState.newCount FROM feeds "
+         "LEFT JOIN feedsState ON feedsState.feedId=feeds.id WHERE xmlUrl!='' ORDER BY id");
+  while (q.next()) {
+    int unread = q.value(2).toInt();
+    int newCount = q.value(3).toInt();
+    unreadTotal += unread;
+    newTotal += newCount;
+    // Values are substituted at once, titles may contain '%'
+    feeds.append(QString("{\"id\": %1, \"title\": %2, \"unread\": %3, \"new\": %4}").
+                 arg(QString::number(q.value(0).toInt()), Common::jsonString(q.value(1).toString()),
+                     QString::number(unread), QString::number(newCount)));
+  }
+  return QString("{\"unread\": %1, \"new\": %2, \"feeds\": [%3]}").
+      arg(QString::number(unreadTotal), QString::number(newTotal), feeds.join(", "));
+}
+
+/** @brief Last received news, newest first
+ *---------------------------------------------------------------------------*/
+QString LocalApi::latestNews(int count, int id)
+{
+  count = qBound(1, count, LATEST_NEWS_MAX);
+
+  QSqlQuery q(Database::readConnection(Database::ReadNewsList));
+  q.exec(QString("SELECT id, feedId, title, ifnull(nullif(link_href, ''), link_alternate), "
+                 "published, author_name, read, starred "
+                 "FROM news WHERE deleted=0 AND %1 ORDER BY id DESC LIMIT %2").
+         arg(feedsCondition(id)).arg(count));
+  QStringList news;
+  while (q.next()) {
+    news.append(QString("{\"id\": %1, \"feedId\": %2, \"title\": %3, \"link\": %4, "
+                        "\"published\": %5, \"author\": %6, \"read\": %7, \"starred\": %8}").
+                arg(QString::number(q.value(0).toLongLong()),
+                    QString::number(q.value(1).toInt()),
+                    Common::jsonString(q.value(2).toString()),
+                    Common::jsonString(q.value(3).toString()),
+                    Common::jsonString(q.value(4).toString()),
+                    Common::jsonString(q.value(5).toString()),
+                    QLatin1String(q.value(6).toInt() ? "true" : "false"),
+                    QLatin1String(q.value(7).toInt() ? "true" : "false")));
+  }
+  return QString("[%1]").arg(news.join(", "));
+}
@@ -0,0 +1,50 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef LOCALAPI_H
+#define LOCALAPI_H
+
+#include <QObject>
+#include <QStringList>
+
+/** @brief Answers requests of external scripts through local socket
+ *
+ * Request is a line of words sent by QtSingleApplication::sendRequest():
+ *   refresh [id]        - update all feeds, feed or folder
+ *   unread [id]         - unread and new counts of all feeds, feed or folder
+ *   latest [count] [id] - last received news of all feeds, feed or folder
+ * Answer is JSON. Base is read by connection of running instance, so
+ * scripts do not open the file concurrently.
+ *----------------------------------------------------------------------------*/
+class LocalApi : public QObject
+{
+  Q_OBJECT
+public:
+  explicit LocalApi(QObject *parent = 0);
+
+public slots:
+  void handleRequest(const QString &request, QString *reply);
+
+private:
+  QString refresh(int id);
+  QString unreadCounts(int id);
+  QString latestNews(int count, int id);
+  QString feedsCondition(int id) const;
+
+};
+
+#endif // LOCALAPI_H
@@ -19,109 +19,265 @@
 
 #include "mainapplication.h"
 
-LogFile::LogFile()
-{
-}
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
 
-#ifdef HAVE_QT5
-void LogFile::msgHandler(QtMsgType type, const QMessageLogContext &, const QString &msg)
+// Number of rotated files kept: debug.log.1 is the newest one
+#define LOG_FILE_BACKUPS 2
+// Messages queued above this number are dropped until writer catches up
+#define LOG_QUEUE_MAX 100000
+
+struct LogMessage {
+  qint64 time;
+  QtMsgType type;
+  QString text;
+};
+
+/** @brief Writer of log file in own thread
+ *
+ * Threads which log only append message to queue, writer formats queued
+ * messages and writes them at once, so file is not opened and flushed for
+ * every message.
+ *----------------------------------------------------------------------------*/
+class LogWriter : public QThread
 {
-  if (!mainApp)
-    return;
-  if (msg.startsWith("libpng warning: iCCP"))
-    return;
+public:
+  explicit LogWriter(const QString &fileName)
+    : fileName_(fileName)
+    , stopped_(false)
+    , dropped_(0)
+    , queuedBytes_(0)
+  {
+  }
 
-  if (type == QtDebugMsg) {
-    if (mainApp->isNoDebugOutput()) return;
+  void append(const LogMessage &message)
+  {
+    QMutexLocker locker(&mutex_);
+    if (queue_.count() >= LOG_QUEUE_MAX) {
+      ++dropped_;
+      return;
+    }
+    queue_.append(message);
+    queuedBytes_ += sizeof(LogMessage) + message.text.size() * sizeof(QChar);
+    if (queue_.count() == 1)
+      condition_.wakeOne();
   }
 
-  if (!mainApp->dataDirInitialized())
-    return;
+  /** @brief Write queued messages and finish thread
+   *--------------------------------------------------------------------------*/
+  void stop()
+  {
+    {
+      QMutexLocker locker(&mutex_);
+      stopped_ = true;
+      condition_.wakeOne();
+    }
+    wait();
+  }
+
+  qint64 queuedBytes()
+  {
+    QMutexLocker locker(&mutex_);
+    return queuedBytes_;
+  }
 
-  QFile file;
-  file.setFileName(mainApp->dataDir() + "/debug.log");
-  QIODevice::OpenMode openMode = QIODevice::WriteOnly | QIODevice::Text;
+  void write(const QList<LogMessage> &messages, int dropped = 0)
+  {
+    if (!file_.isOpen()) {
+      file_.setFileName(fileName_);
+      if (file_.size() >= (qint64)maxLogFileSize)
+        rotate();
+      file_.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text);
+      if (!file_.isOpen())
+        return;
+    }
+
+    QString text;
+    foreach (const LogMessage &message, messages) {
+      text.append(QDateTime::fromMSecsSinceEpoch(message.time).toString("dd.MM.yyyy hh:mm:ss.zzz"));
+      switch (message.type) {
+      case QtDebugMsg:
+        text.append(" DEBUG: ");
+        break;
+      case QtWarningMsg:
+        text.append(" WARNING: ");
+        break;
+      case QtCriticalMsg:
+        text.append(" CRITICAL: ");
+        break;
+      case QtFatalMsg:
+        text.append(" FATAL: ");
+        break;
+      default:
+        text.append(" ");
+      }
+      text.append(message.text);
+      text.append('\n');
+    }
+    if (dropped) {
+      text.append(QString("%1 WARNING: %2 log messages dropped\n").
+                  arg(QDateTime::currentDateTime().toString("dd.MM.yyyy hh:mm:ss.zzz")).
+                  arg(dropped));
+    }
+    file_.write(text.toUtf8());
+    file_.flush();
 
-  if (file.exists() && (file.size() < (qint64)maxLogFileSize)) {
-    openMode |= QIODevice::Append;
+    if (file_.size() >= (qint64)maxLogFileSize) {
+      file_.close();
+      rotate();
+      file_.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text);
+    }
   }
 
-  file.open(openMode);
-
-  QTextStream stream;
-  stream.setDevice(&file);
-  stream.setCodec("UTF-8");
-
-  if (file.isOpen()) {
-    QString currentDateTime = QDateTime::currentDateTime().toString("dd.MM.yyyy hh:mm:ss.zzz");
-    switch (type) {
-    case QtDebugMsg:
-      stream << currentDateTime << " DEBUG: " << msg << "\n";
-      break;
-    case QtWarningMsg:
-      stream << currentDateTime << " WARNING: " << msg << "\n";
-      break;
-    case QtCriticalMsg:
-      stream << currentDateTime << " CRITICAL: " << msg << "\n";
-      break;
-    case QtFatalMsg:
-      stream << currentDateTime << " FATAL: " << msg << "\n";
-      qApp->exit(EXIT_FAILURE);
-    default:
-      break;
+protected:
+  void run()
+  {
+    forever {
+      QList<LogMessage> messages;
+      int dropped;
+      {
+        QMutexLocker locker(&mutex_);
+        while (queue_.isEmpty() && !stopped_)
+          condition_.wait(&mutex_);
+        if (queue_.isEmpty())
+          break;
+        messages = queue_;
+        queue_.clear();
+        queuedBytes_ = 0;
+        dropped = dropped_;
+        dropped_ = 0;
+      }
+      write(messages, dropped);
     }
+    file_.close();
+  }
+
+private:
+  /** @brief Shift full log to debug.log.1 and older ones further
+   *--------------------------------------------------------------------------*/
+  void rotate()
+  {
+    QFile::remove(QString("%1.%2").arg(fileName_).arg(LOG_FILE_BACKUPS));
+    for (int i = LOG_FILE_BACKUPS - 1; i > 0; --i)
+      QFile::rename(QString("%1.%2").arg(fileName_).arg(i), QString("%1.%2").arg(fileName_).arg(i + 1));
+    QFile::rename(fileName_, fileName_ + ".1");
+  }
+
+  QString fileName_;
+  QFile file_;
+  QMutex mutex_;
+  QWaitCondition condition_;
+  QList<LogMessage> queue_;
+  bool stopped_;
+  int dropped_;
+  qint64 queuedBytes_;
+
+};
+
+static QMutex writerMutex;
+static LogWriter *writer = 0;
+static bool writerStopped = false;
+
+int LogFile::categories_ = 0;
 
-    stream.flush();
-    file.flush();
-    file.close();
+LogFile::LogFile()
+{
+}
+
+/** @brief Enable debug categories listed by comma
+ *----------------------------------------------------------------------------*/
+void LogFile::setCategories(const QString &categories)
+{
+  categories_ = 0;
+  foreach (const QString &category, categories.split(',')) {
+    QString name = category.trimmed().toLower();
+    if (name == "parse") categories_ |= Parse;
+    else if (name == "fetch") categories_ |= Fetch;
+    else if (name == "update") categories_ |= Update;
+    else if (name == "trace") categories_ |= Trace;
+    else if (name == "sql") categories_ |= Sql;
+    else if (name == "websub") categories_ |= WebSub;
+    else if (name == "local") categories_ |= Local;
+    else if (name == "sync") categories_ |= Sync;
+  }
+}
+
+/** @brief Write queued messages and stop writer thread
+ *
+ * Messages logged later are written at once by calling thread.
+ *----------------------------------------------------------------------------*/
+void LogFile::shutdown()
+{
+  QMutexLocker locker(&writerMutex);
+  writerStopped = true;
+  if (writer) {
+    writer->stop();
+    delete writer;
+    writer = 0;
   }
 }
+
+/** @brief Memory of messages waiting for writer
+ *----------------------------------------------------------------------------*/
+qint64 LogFile::queuedBytes()
+{
+  QMutexLocker locker(&writerMutex);
+  return writer ? writer->queuedBytes() : 0;
+}
+
+#ifdef HAVE_QT5
+void LogFile::msgHandler(QtMsgType type, const QMessageLogContext &, const QString &msg)
+{
+  if (msg.startsWith("libpng warning: iCCP"))
+    return;
+
+  writeMessage(type, msg);
+}
 #else
 void LogFile::msgHandler(QtMsgType type, const char *msg)
 {
-  if (QString::fromUtf8(msg) == "QFont::setPixelSize: Pixel size <= 0 (0)")
+  QString text = QString::fromUtf8(msg);
+  if (text == "QFont::setPixelSize: Pixel size <= 0 (0)")
+    return;
+
+  writeMessage(type, text);
+}
+#endif
+
+void LogFile::writeMessage(QtMsgType type, const QString &text)
+{
+  if (!mainApp)
     return;
 
   if (type == QtDebugMsg) {
     if (mainApp->isNoDebugOutput()) return;
   }
 
-  QFile file;
-  file.setFileName(mainApp->dataDir() + "/debug.log");
-  QIODevice::OpenMode openMode = QIODevice::WriteOnly | QIODevice::Text;
+  if (!mainApp->dataDirInitialized())
+    return;
 
-  if (file.exists() && (file.size() < (qint64)maxLogFileSize)) {
-    openMode |= QIODevice::Append;
-  }
+  LogMessage message;
+  message.time = QDateTime::currentMSecsSinceEpoch();
+  message.type = type;
+  message.text = text;
 
-  file.open(openMode);
-
-  QTextStream stream;
-  stream.setDevice(&file);
-  stream.setCodec("UTF-8");
-
-  if (file.isOpen()) {
-    QString currentDateTime = QDateTime::currentDateTime().toString("dd.MM.yyyy hh:mm:ss.zzz");
-    switch (type) {
-    case QtDebugMsg:
-      stream << currentDateTime << " DEBUG: " << QString::fromUtf8(msg) << "\n";
-      break;
-    case QtWarningMsg:
-      stream << currentDateTime << " WARNING: " << QString::fromUtf8(msg) << "\n";
-      break;
-    case QtCriticalMsg:
-      stream << currentDateTime << " CRITICAL: " << QString::fromUtf8(msg) << "\n";
-      break;
-    case QtFatalMsg:
-      stream << currentDateTime << " FATAL: " << QString::fromUtf8(msg) << "\n";
-      qApp->exit(EXIT_FAILURE);
-    default:
-      break;
+  {
+    QMutexLocker locker(&writerMutex);
+    if (!writer && !writerStopped) {
+      writer = new LogWriter(mainApp->dataDir() + "/debug.log");
+      writer->start(QThread::LowPriority);
+    }
+    if (writer) {
+      writer->append(message);
+    } else {
+      LogWriter lateWriter(mainApp->dataDir() + "/debug.log");
+      lateWriter.write(QList<LogMessage>() << message);
     }
+  }
 
-    stream.flush();
-    file.flush();
-    file.close();
+  if (type == QtFatalMsg) {
+    shutdown();
+    qApp->exit(EXIT_FAILURE);
   }
 }
-#endif
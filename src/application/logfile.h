@@ -26,9 +26,32 @@
 
 const size_t maxLogFileSize = 1 * 1024 * 1024; //1 MB
 
+/** @brief Debug message of category
+ *
+ * Arguments are not evaluated when category is disabled.
+ *----------------------------------------------------------------------------*/
+#define LOG_DEBUG(category) \
+  if (!LogFile::isEnabled(category)) {} else qDebug()
+
 class LogFile
 {
 public:
+  enum Category {
+    Parse  = 0x01,  // feed parsing and storing news
+    Fetch  = 0x02,  // feed requests and replies
+    Update = 0x04,  // update queue
+    Trace  = 0x08,  // every news item and reply header
+    Sql    = 0x10,  // statistics of SQL statements
+    WebSub = 0x20,  // WebSub subscriptions and pushed content
+    Local  = 0x40,  // requests of local API
+    Sync   = 0x80   // sync of news with GReader API
+  };
+
+  static bool isEnabled(int category) { return categories_ & category; }
+  static void setCategories(const QString &categories);
+  static void shutdown();
+  static qint64 queuedBytes();
+
 #ifdef HAVE_QT5
   static void msgHandler(QtMsgType type, const QMessageLogContext &, const QString &msg);
 #else
@@ -37,6 +60,9 @@ public:
 
 private:
   explicit LogFile();
+  static void writeMessage(QtMsgType type, const QString &text);
+
+  static int categories_;
 
 };
 
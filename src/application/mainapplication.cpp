@@ -17,15 +17,38 @@
 * ============================================================ */
 #include "mainapplication.h"
 
+#include "asyncquery.h"
 #include "common.h"
+#include "logfile.h"
 #include "cookiejar.h"
 #include "database.h"
+#include "eventtrace.h"
+#include "databasegenerator.h"
+#include "kernelbenchmark.h"
+#include "localapi.h"
+#include "memoryaccounting.h"
+#include "networkarchive.h"
 #include "networkmanager.h"
 #include "adblockmanager.h"
 #include "settings.h"
+#include "sharednetworkcache.h"
 #include "splashscreen.h"
+#include "stressrun.h"
+#include "parsebenchmark.h"
+#include "uibenchmark.h"
+#include "updatedaemon.h"
 #include "updatefeeds.h"
 #include "VersionNo.h"
+#if defined(Q_OS_WIN) || defined(Q_OS_OS2)
+#include "cabundleupdater.h"
+#endif
+
+#include <stdio.h>
+
+// Delay of check for new version after first paint (ms)
+#define UPDATE_APP_CHECK_DELAY 5000
+// Interval of logging memory used by subsystems (ms)
+#define MEMORY_LOG_INTERVAL 1800000
 
 MainApplication::MainApplication(int &argc, char **argv)
   : QtSingleApplication(argc, argv)
@@ -38,12 +61,111 @@ MainApplication::MainApplication(int &argc, char **argv)
   , mainWindow_(0)
   , networkManager_(0)
   , cookieJar_(0)
-  , diskCache_(0)
+  , updateFeeds_(0)
+  , updateDaemon_(0)
+  , localApi_(0)
   , downloadManager_(0)
+  , asyncQuery_(0)
+  , networkArchive_(0)
+  , closingWidget_(0)
   , analytics_(0)
+  , startupPhaseTime_(0)
+  , startupProfile_(false)
+  , startupFinished_(false)
+  , headless_(false)
+  , generateFeeds_(0)
+  , generateNews_(0)
+  , stressRounds_(0)
+  , stressRun_(0)
 {
+  startupTimer_.start();
+  startupProfile_ = arguments().contains("--startup-profile");
+  // Only update of feeds on schedule, without windows: --headless
+  headless_ = arguments().contains("--headless");
+  // Headless parse benchmark: --bench-parse <directory or file>
+  int benchIndex = arguments().indexOf("--bench-parse");
+  if (benchIndex != -1)
+    benchCorpus_ = arguments().value(benchIndex + 1);
+  // Micro-benchmarks of parsing and AdBlock: --bench-kernels <directory>
+  int kernelsIndex = arguments().indexOf("--bench-kernels");
+  if (kernelsIndex != -1)
+    benchKernels_ = arguments().value(kernelsIndex + 1);
+  // Synthetic base: --generate-db <file> [feeds] [news]
+  int generateIndex = arguments().indexOf("--generate-db");
+  if (generateIndex != -1) {
+    generateDbFile_ = arguments().value(generateIndex + 1);
+    generateFeeds_ = arguments().value(generateIndex + 2).toInt();
+    generateNews_ = arguments().value(generateIndex + 3).toInt();
+  }
+  // Scripted main window benchmark on copy of base: --bench-ui <file>
+  int benchUiIndex = arguments().indexOf("--bench-ui");
+  if (benchUiIndex != -1)
+    benchUiFile_ = arguments().value(benchUiIndex + 1);
+  // Load of update pipeline on copy of base: --stress <file> [rounds]
+  int stressIndex = arguments().indexOf("--stress");
+  if (stressIndex != -1) {
+    stressFile_ = arguments().value(stressIndex + 1);
+    stressRounds_ = arguments().value(stressIndex + 2).toInt();
+  }
+  // Feed replies written to archive: --net-record <file>
+  int recordIndex = arguments().indexOf("--net-record");
+  QString recordFile = arguments().value(recordIndex + 1);
+  // Feed replies served from archive: --net-replay <file> [latency] [bandwidth]
+  int replayIndex = arguments().indexOf("--net-replay");
+  QString replayFile = arguments().value(replayIndex + 1);
+  if (((benchIndex != -1) && benchCorpus_.isEmpty()) ||
+      ((kernelsIndex != -1) && !QFileInfo(benchKernels_).isDir()) ||
+      ((generateIndex != -1) && (generateDbFile_.isEmpty() || QFile::exists(generateDbFile_))) ||
+      ((benchUiIndex != -1) && !QFile::exists(benchUiFile_)) ||
+      ((stressIndex != -1) && !QFile::exists(stressFile_)) ||
+      ((recordIndex != -1) && (recordFile.isEmpty() || (replayIndex != -1))) ||
+      ((replayIndex != -1) && !QFile::exists(replayFile))) {
+    fprintf(stderr, "Usage: --headless\n"
+                    "       --request <refresh [id] | unread [id] | latest [count] [id]>\n"
+                    "       --bench-parse <directory of saved feeds or file>\n"
+                    "       --bench-kernels <directory of corpus>\n"
+                    "       --generate-db <new file> [feeds] [news]\n"
+                    "       --bench-ui <file made by --generate-db>\n"
+                    "       --stress <file made by --generate-db> [rounds]\n"
+                    "       --net-record <new file>\n"
+                    "       --net-replay <file made by --net-record> [latency ms] [bytes per sec]\n");
+    isClosing_ = true;
+    return;
+  }
+  if (!generateDbFile_.isEmpty())
+    generateDbFile_ = QFileInfo(generateDbFile_).absoluteFilePath();
+  if (recordIndex != -1) {
+    networkArchive_ = new NetworkArchive(NetworkArchive::Record, recordFile);
+  } else if (replayIndex != -1) {
+    bool ok;
+    int latency = arguments().value(replayIndex + 2).toInt(&ok);
+    if (!ok) latency = -1;
+    int bandwidth = arguments().value(replayIndex + 3).toInt();
+    networkArchive_ = new NetworkArchive(NetworkArchive::Replay, replayFile,
+                                         latency, bandwidth);
+  }
+
+  // Request to running instance, answer is printed: --request <text>
+  int requestIndex = arguments().indexOf("--request");
+  if (requestIndex != -1) {
+    QString reply;
+    if (!isRunning())
+      fprintf(stderr, "QuiteRSS is not running\n");
+    else if (!sendRequest(arguments().value(requestIndex + 1), &reply))
+      fprintf(stderr, "No answer from QuiteRSS\n");
+    else
+      printf("%s\n", reply.toUtf8().constData());
+    isClosing_ = true;
+    return;
+  }
+
   QString message = arguments().value(1);
-  if (isRunning()) {
+  if (isRunning() && !isBenchmark()) {
+    if (headless_) {
+      fprintf(stderr, "QuiteRSS is already running\n");
+      isClosing_ = true;
+      return;
+    }
     if (argc == 1) {
       sendMessage("--show");
     } else {
@@ -74,50 +196,115 @@ MainApplication::MainApplication(int &argc, char **argv)
   createSettings();
 
   qWarning() << "Run application!";
+  startupPhase("settings");
+
+  // Benchmark uses scratch base and keeps data of user untouched
+  if (isBenchmark()) {
+    isSaveDataLastFeed_ = false;
+    showSplashScreen_ = false;
+    if (generateDbFile_.isEmpty()) {
+      QFile::remove(dbFileName());
+      QFile::remove(dbFileName() % "-wal");
+      QFile::remove(dbFileName() % "-shm");
+    } else {
+      // Generated base is written directly into file
+      storeDBMemory_ = false;
+      mapDBMemory_ = false;
+    }
+    if (!benchUiFile_.isEmpty())
+      QFile::copy(benchUiFile_, dbFileName());
+    if (!stressFile_.isEmpty())
+      QFile::copy(stressFile_, dbFileName());
+  }
 
-  setStyleApplication();
-  setTranslateApplication();
-  showSplashScreen();
-
-  createGoogleAnalytics();
+  if (headless_) {
+    showSplashScreen_ = false;
+    setTranslateApplication();
+  } else {
+    setStyleApplication();
+    setTranslateApplication();
+    showSplashScreen();
+  }
+  startupPhase("style and splash screen");
 
   connectDatabase();
   setProgressSplashScreen(30);
-  qWarning() << "Run application 2";
+  startupPhase("database");
+  if (!generateDbFile_.isEmpty()) {
+    QTimer::singleShot(0, this, SLOT(runDatabaseGenerator()));
+    return;
+  }
+  if (!benchKernels_.isEmpty()) {
+    QTimer::singleShot(0, this, SLOT(runKernelBenchmark()));
+    return;
+  }
+  // Update objects are driven by daemon instead of main window
+  if (headless_) {
+    updateDaemon_ = new UpdateDaemon();
+    updateFeeds_ = new UpdateFeeds(updateDaemon_);
+    updateDaemon_->start();
+    startupPhase("update objects");
+    startupFinished_ = true;
+    connect(this, SIGNAL(messageReceived(QString)), SLOT(receiveMessage(QString)));
+    createLocalApi();
+    startMemoryLog();
+    return;
+  }
   mainWindow_ = new MainWindow();
-  qWarning() << "Run application 3";
   setProgressSplashScreen(60);
+  startupPhase("main window");
+
+  // Parsing reads options of main window, but the window is not shown
+  if (!benchCorpus_.isEmpty()) {
+    closeSplashScreen();
+    QTimer::singleShot(0, this, SLOT(runParseBenchmark()));
+    return;
+  }
 
   loadSettings();
-  qWarning() << "Run application 4";
   updateFeeds_ = new UpdateFeeds(mainWindow_);
   setProgressSplashScreen(90);
-  qWarning() << "Run application 5";
+  startupPhase("update objects");
   mainWindow_->restoreFeedsOnStartUp();
   setProgressSplashScreen(100);
-  qWarning() << "Run application 6";
+  startupPhase("restore feeds");
   if (!mainWindow_->startingTray_ || !mainWindow_->showTrayIcon_) {
     mainWindow_->show();
   }
   mainWindow_->isMinimizeToTray_ = false;
 
   closeSplashScreen();
+  startupPhase("show window");
+
+  // Subsystems not needed for first paint are created when event loop runs
+  QTimer::singleShot(0, this, SLOT(initDeferredSubsystems()));
 
   if (mainWindow_->showTrayIcon_) {
     QTimer::singleShot(0, mainWindow_->traySystem, SLOT(show()));
   }
 
   if (updateFeedsStartUp_) {
-    QTimer::singleShot(0, mainWindow_, SLOT(slotGetAllFeeds()));
+    QTimer::singleShot(0, mainWindow_, SLOT(slotGetAllFeedsStartUp()));
+  }
+
+  if (!benchUiFile_.isEmpty()) {
+    QTimer::singleShot(0, this, SLOT(runUiBenchmark()));
+    return;
+  }
+  if (!stressFile_.isEmpty()) {
+    QTimer::singleShot(0, this, SLOT(runStress()));
+    return;
   }
 
   receiveMessage(message);
   connect(this, SIGNAL(messageReceived(QString)), SLOT(receiveMessage(QString)));
+  createLocalApi();
 }
 
 MainApplication::~MainApplication()
 {
-
+  delete networkArchive_;
+  LogFile::shutdown();
 }
 
 MainApplication *MainApplication::getInstance()
@@ -131,6 +318,12 @@ void MainApplication::receiveMessage(const QString &message)
     qWarning() << QString("Received message: %1").arg(message);
 
     QStringList params = message.split('\n');
+    // Headless daemon can only be asked to quit
+    if (headless_) {
+      if (params.contains("--exit"))
+        updateDaemon_->quitApp();
+      return;
+    }
     foreach (QString param, params) {
       if (param == "--show") {
         if (isClosing_)
@@ -153,6 +346,16 @@ void MainApplication::receiveMessage(const QString &message)
   }
 }
 
+/** @brief Answer requests of scripts sent by --request
+ *---------------------------------------------------------------------------*/
+void MainApplication::createLocalApi()
+{
+  localApi_ = new LocalApi(this);
+  // Reply is sent when signal returns
+  connect(this, SIGNAL(requestReceived(QString,QString*)),
+          localApi_, SLOT(handleRequest(QString,QString*)), Qt::DirectConnection);
+}
+
 void MainApplication::checkPortable()
 {
 #if defined(Q_OS_WIN)
@@ -208,16 +411,49 @@ void MainApplication::createSettings()
   QString fileName;
   if (isPortable_)
     fileName = mainApp->dataDir() % "/" % QCoreApplication::applicationName() % ".ini";
+  // Benchmarks change options, so they work with copy of options of user
+  if (isBenchmark()) {
+    if (fileName.isEmpty()) {
+      QSettings userSettings(QSettings::IniFormat, QSettings::UserScope,
+                             organizationName(), applicationName());
+      fileName = userSettings.fileName();
+    }
+    QString benchFileName = QDir::tempPath() % "/quiterss-bench.ini";
+    QFile::remove(benchFileName);
+    QFile::copy(fileName, benchFileName);
+    fileName = benchFileName;
+  }
   Settings::createSettings(fileName);
 
   Settings settings;
+  if (!benchUiFile_.isEmpty() || !stressFile_.isEmpty()) {
+    // Scripted run is not disturbed by network, tray and restored tabs
+    settings.setValue("Settings/autoUpdatefeedsStartUp", false);
+    settings.setValue("Settings/autoUpdatefeeds", false);
+    settings.setValue("Settings/startingTray", false);
+    settings.setValue("Settings/reopenFeedStartup", false);
+    settings.setValue("Settings/updateCheckEnabled", false);
+    settings.setValue("Settings/statisticsEnabled2", false);
+  }
   settings.beginGroup("Settings");
   storeDBMemory_ = settings.value("storeDBMemory", true).toBool();
+  // Readers do not block on writes in WAL mode, memory copy is not needed
+  walDB_ = settings.value("walDB", false).toBool();
+  // Memory mode served by file mapped in WAL mode, without copy on startup
+  mapDBMemory_ = storeDBMemory_ && !walDB_ && settings.value("mapDBMemory", false).toBool();
+  if (mapDBMemory_)
+    walDB_ = true;
+  if (walDB_)
+    storeDBMemory_ = false;
   isSaveDataLastFeed_ = settings.value("createLastFeed", false).toBool();
   styleApplication_ = settings.value("styleApplication", "greenStyle_").toString();
   showSplashScreen_ = settings.value("showSplashScreen", true).toBool();
   updateFeedsStartUp_ = settings.value("autoUpdatefeedsStartUp", false).toBool();
   noDebugOutput_ = settings.value("noDebugOutput", true).toBool();
+  if (!noDebugOutput_)
+    LogFile::setCategories(settings.value("debugCategories", "parse,fetch,update,websub").toString());
+  // Timeline of feed updates for export from Performance dialog
+  EventTrace::setEnabled(settings.value("traceEvents", false).toBool());
 
   QString strLang;
   QString strLocalLang = QLocale::system().name();
@@ -262,7 +498,131 @@ void MainApplication::createGoogleAnalytics()
     analytics_ = new GAnalytics(this, TRACKING_ID, clientID);
     analytics_->generateUserAgentEtc();
     analytics_->startSession();
+    analytics_->sendScreenview("MainWindow");
+  }
+}
+
+/** @brief Create subsystems deferred until main window is painted
+ *---------------------------------------------------------------------------*/
+void MainApplication::initDeferredSubsystems()
+{
+  if (isClosing_)
+    return;
+
+  startupPhase("first paint");
+
+  createGoogleAnalytics();
+  // Rules are parsed in own thread, stylesheet is reloaded when ready
+  AdBlockManager::instance();
+#if defined(Q_OS_WIN) || defined(Q_OS_OS2)
+  new CaBundleUpdater(networkManager(), networkManager());
+#endif
+  QTimer::singleShot(UPDATE_APP_CHECK_DELAY, mainWindow_, SLOT(slotUpdateAppCheck()));
+  startMemoryLog();
+
+  startupPhase("deferred subsystems");
+  startupFinished_ = true;
+}
+
+/** @brief Log memory of subsystems periodically, so growth shows in log
+ *---------------------------------------------------------------------------*/
+void MainApplication::startMemoryLog()
+{
+  QTimer *memoryLogTimer = new QTimer(this);
+  connect(memoryLogTimer, SIGNAL(timeout()), this, SLOT(logMemoryUsage()));
+  memoryLogTimer->start(MEMORY_LOG_INTERVAL);
+}
+
+void MainApplication::logMemoryUsage()
+{
+  qWarning() << "Memory usage (KB):" << qPrintable(MemoryAccounting::toString());
+}
+
+/** @brief Log duration of startup phase since previous one
+ *
+ *  With --startup-profile phases are also printed to stderr
+ *---------------------------------------------------------------------------*/
+void MainApplication::startupPhase(const QString &phase)
+{
+  if (startupFinished_)
+    return;
+
+  qint64 elapsed = startupTimer_.elapsed();
+  QString text = QString("Startup phase '%1': %2 ms (total %3 ms)").
+      arg(phase).arg(elapsed - startupPhaseTime_).arg(elapsed);
+  startupPhaseTime_ = elapsed;
+
+  qWarning() << text;
+  if (startupProfile_) {
+    fprintf(stderr, "%s\n", qPrintable(text));
+    fflush(stderr);
+  }
+}
+
+/** @brief Run parse benchmark and quit with its result
+ *---------------------------------------------------------------------------*/
+void MainApplication::runParseBenchmark()
+{
+  int result;
+  {
+    ParseBenchmark benchmark(benchCorpus_);
+    result = benchmark.run();
+  }
+  exit(result);
+}
+
+/** @brief Run micro-benchmarks and quit with their result
+ *---------------------------------------------------------------------------*/
+void MainApplication::runKernelBenchmark()
+{
+  int result;
+  {
+    KernelBenchmark benchmark(benchKernels_);
+    result = benchmark.run();
+  }
+  exit(result);
+}
+
+/** @brief Fill new base and quit
+ *---------------------------------------------------------------------------*/
+void MainApplication::runDatabaseGenerator()
+{
+  int result;
+  {
+    DatabaseGenerator generator(generateFeeds_, generateNews_);
+    result = generator.run();
   }
+  exit(result);
+}
+
+/** @brief Run main window benchmark, then quit the usual way
+ *
+ *  Shutdown time is printed by quitApplication()
+ *---------------------------------------------------------------------------*/
+void MainApplication::runUiBenchmark()
+{
+  printf("Startup: %lld ms\n", startupTimer_.elapsed());
+  UiBenchmark benchmark(mainWindow_);
+  benchmark.run();
+
+  shutdownTimer_.start();
+  mainWindow_->quitApp();
+}
+
+void MainApplication::runStress()
+{
+  printf("Startup: %lld ms\n", startupTimer_.elapsed());
+  stressRun_ = new StressRun(mainWindow_, stressRounds_, this);
+  connect(stressRun_, SIGNAL(finished()), SLOT(finishStress()));
+  stressRun_->start();
+}
+
+/** @brief Close application while update pipeline is still busy
+ *---------------------------------------------------------------------------*/
+void MainApplication::finishStress()
+{
+  shutdownTimer_.start();
+  mainWindow_->quitApp();
 }
 
 void MainApplication::connectDatabase()
@@ -298,7 +658,10 @@ void MainApplication::quitApplication()
 {
   qWarning() << "quitApplication 1";
   delete mainWindow_;
+  delete updateDaemon_;
+  delete asyncQuery_;
   qWarning() << "quitApplication 2";
+  Database::dumpStatementTrace();
   delete networkManager_;
   delete cookieJar_;
   delete closingWidget_;
@@ -311,6 +674,16 @@ void MainApplication::quitApplication()
 
   qWarning() << "Quit application";
 
+  if (!benchUiFile_.isEmpty() || !stressFile_.isEmpty()) {
+    printf("%-24s %10lld\n", "shutdown", shutdownTimer_.elapsed());
+    fflush(stdout);
+  }
+
+  // Failed stress run is reported by exit code
+  if (stressRun_ && !stressRun_->passed()) {
+    exit(1);
+    return;
+  }
   quit();
 }
 
@@ -331,7 +704,10 @@ void MainApplication::showClosingWidget()
 void MainApplication::commitData(QSessionManager &manager)
 {
   manager.release();
-  mainWindow_->quitApp();
+  if (headless_)
+    updateDaemon_->quitApp();
+  else
+    mainWindow_->quitApp();
 }
 
 bool MainApplication::isPortable() const
@@ -377,9 +753,22 @@ QString MainApplication::absolutePath(const QString &path) const
 
 QString MainApplication::dbFileName() const
 {
+  if (!generateDbFile_.isEmpty())
+    return generateDbFile_;
+  if (isBenchmark())
+    return QDir::tempPath() % "/quiterss-bench.db";
   return dataDir_ % "/feeds.db";
 }
 
+/** @brief Application runs benchmark or generator instead of usual work
+ *---------------------------------------------------------------------------*/
+bool MainApplication::isBenchmark() const
+{
+  return !benchCorpus_.isEmpty() || !benchKernels_.isEmpty() ||
+      !generateDbFile_.isEmpty() || !benchUiFile_.isEmpty() ||
+      !stressFile_.isEmpty();
+}
+
 bool MainApplication::isSaveDataLastFeed() const
 {
   return isSaveDataLastFeed_;
@@ -421,13 +810,40 @@ void MainApplication::setStyleApplication()
   setStyle(new QProxyStyle);
 }
 
+/** @brief Install translation of chosen language from mapped file
+ *
+ * Translator is replaced only when language changes. English has no
+ * file, source strings are used.
+ *---------------------------------------------------------------------------*/
 void MainApplication::setTranslateApplication()
 {
-  if (!translator_)
-    translator_ = new QTranslator(this);
-  removeTranslator(translator_);
-  translator_->load(resourcesDir_ + QString("/lang/quiterss_%1").arg(langFileName_));
-  installTranslator(translator_);
+  QString fileName = resourcesDir_ + QString("/lang/quiterss_%1.qm").arg(langFileName_);
+  if (fileName == translationFileName_)
+    return;
+  translationFileName_ = fileName;
+
+  if (translator_) {
+    removeTranslator(translator_);
+    delete translator_;
+    translator_ = 0;
+  }
+
+  QFile *file = new QFile(fileName);
+  if (!file->open(QFile::ReadOnly)) {
+    delete file;
+    return;
+  }
+
+  // Translator uses mapped data, so file lives as long as translator
+  translator_ = new QTranslator(this);
+  file->setParent(translator_);
+  uchar *data = file->map(0, file->size());
+  bool ok = data ? translator_->load(data, int(file->size()))
+                 : translator_->load(fileName);
+  if (ok)
+    installTranslator(translator_);
+  else
+    qWarning() << "Failed to load translation:" << fileName;
 }
 
 void MainApplication::showSplashScreen()
@@ -471,6 +887,7 @@ NetworkManager *MainApplication::networkManager()
 {
   if (!networkManager_) {
     networkManager_ = new NetworkManager(false, this);
+    networkManager_->setCache(new SharedNetworkCache(SharedNetworkCache::Browser));
     setDiskCache();
   }
   return networkManager_;
@@ -491,10 +908,6 @@ void MainApplication::setDiskCache()
 
   bool useDiskCache = settings.value("useDiskCache", true).toBool();
   if (useDiskCache) {
-    if (!diskCache_) {
-      diskCache_ = new QNetworkDiskCache(this);
-    }
-
     QString diskCacheDirPath = settings.value("dirDiskCache", cacheDir_).toString();
     if (diskCacheDirPath.isEmpty()) diskCacheDirPath = cacheDir_;
     diskCacheDirPath = absolutePath(diskCacheDirPath);
@@ -505,16 +918,10 @@ void MainApplication::setDiskCache()
       settings.setValue("cleanDiskCache", false);
     }
 
-    diskCache_->setCacheDirectory(diskCacheDirPath);
     int maxDiskCache = settings.value("maxDiskCache", 50).toInt();
-    diskCache_->setMaximumCacheSize(maxDiskCache*1024*1024);
-
-    networkManager()->setCache(diskCache_);
+    SharedNetworkCache::setCacheDirectory(diskCacheDirPath, maxDiskCache*1024*1024);
   } else {
-    if (diskCache_) {
-      diskCache_->setMaximumCacheSize(0);
-      diskCache_->clear();
-    }
+    SharedNetworkCache::disable();
   }
 
   settings.endGroup();
@@ -558,11 +965,31 @@ void MainApplication::runUserFilter(int feedId, int filterId)
   emit signalRunUserFilter(feedId, filterId);
 }
 
+void MainApplication::reloadUserFilters()
+{
+  emit signalReloadUserFilters();
+}
+
 void MainApplication::sqlQueryExec(const QString &query)
 {
   emit signalSqlQueryExec(query);
 }
 
+/** @brief Queue change of news state, written in batch by update object
+ *---------------------------------------------------------------------------*/
+void MainApplication::setNewsState(int newsId, int feedId, const QString &field,
+                                   const QVariant &value)
+{
+  updateFeeds_->updateObject_->setNewsState(newsId, feedId, field, value);
+}
+
+/** @brief Write queued news state before news are read from DB
+ *---------------------------------------------------------------------------*/
+void MainApplication::flushNewsState()
+{
+  updateFeeds_->updateObject_->flushNewsState();
+}
+
 /** @brief Click to Flash
  *---------------------------------------------------------------------------*/
 void MainApplication::c2fLoadSettings()
@@ -611,14 +1038,37 @@ void MainApplication::c2fAddWhitelist(const QString &site)
   c2fWhitelist_.append(site);
 }
 
+AsyncQuery *MainApplication::asyncQuery()
+{
+  if (!asyncQuery_)
+    asyncQuery_ = new AsyncQuery();
+  return asyncQuery_;
+}
+
 DownloadManager *MainApplication::downloadManager()
 {
   if (!downloadManager_) {
     downloadManager_ = new DownloadManager();
+    if (mainWindow_) {
+      connect(downloadManager_, SIGNAL(signalShowDownloads(bool)),
+              mainWindow_, SLOT(showDownloadManager(bool)));
+      connect(downloadManager_, SIGNAL(signalUpdateInfo(QString)),
+              mainWindow_, SLOT(updateInfoDownloads(QString)));
+    }
   }
   return downloadManager_;
 }
 
+/** @brief Pass enclosure of new news to download manager
+ *
+ * Download manager is created by first enclosure, not on start.
+ *----------------------------------------------------------------------------*/
+void MainApplication::downloadEnclosure(int feedId, const QString &url,
+                                        const QString &type, qint64 length)
+{
+  downloadManager()->addEnclosure(feedId, url, type, length);
+}
+
 void MainApplication::reloadUserStyleBrowser()
 {
   Settings settings;
@@ -651,7 +1101,9 @@ QUrl MainApplication::userStyleSheet(const QString &filePath) const
   userStyle += QString("::selection {background: %1; color: %2;} ").arg(highlightColor, highlightedTextColor);
 #endif
 
-  userStyle += AdBlockManager::instance()->elementHidingRules();
+  // AdBlock created after startup reloads style when its rules are ready
+  if (AdBlockManager::isCreated())
+    userStyle += AdBlockManager::instance()->elementHidingRules();
 
   QFile file(filePath);
   if (!filePath.isEmpty() && file.open(QFile::ReadOnly)) {
@@ -26,15 +26,19 @@
 #include <QtGui>
 #endif
 #include <qtsingleapplication.h>
-#include <QNetworkDiskCache>
 
 #include "cookiejar.h"
 #include "downloadmanager.h"
 #include "mainwindow.h"
 #include "ganalytics.h"
 
+class AsyncQuery;
+class LocalApi;
+class NetworkArchive;
 class NetworkManager;
 class SplashScreen;
+class StressRun;
+class UpdateDaemon;
 class UpdateFeeds;
 
 class MainApplication : public QtSingleApplication
@@ -51,6 +55,7 @@ public:
   void setClosing();
   bool isClosing() const;
   bool isNoDebugOutput() const { return noDebugOutput_; }
+  bool isHeadless() const { return headless_; }
   void showClosingWidget();
   bool dataDirInitialized() const { return dataDirInitialized_; }
 
@@ -64,9 +69,14 @@ public:
   QString styleSheetWebDarkFile() const;
 
   bool storeDBMemory() const;
+  bool walDB() const { return walDB_; }
+  bool mapDBMemory() const { return mapDBMemory_; }
   bool dbFileExists() const { return dbFileExists_; }
   bool isSaveDataLastFeed() const;
   void sqlQueryExec(const QString &query);
+  void setNewsState(int newsId, int feedId, const QString &field,
+                    const QVariant &value);
+  void flushNewsState();
 
   MainWindow *mainWindow();
   NetworkManager *networkManager();
@@ -74,7 +84,11 @@ public:
   void setDiskCache();
   UpdateFeeds *updateFeeds();
   void runUserFilter(int feedId, int filterId);
+  void reloadUserFilters();
   DownloadManager *downloadManager();
+  bool hasDownloadManager() const { return downloadManager_ != 0; }
+  AsyncQuery *asyncQuery();
+  NetworkArchive *networkArchive() const { return networkArchive_; }
 
   void c2fLoadSettings();
   void c2fSaveSettings();
@@ -89,30 +103,46 @@ public:
   void setLanguage(const QString &lang) { langFileName_ = lang; }
 
   GAnalytics *analytics() const { return analytics_; }
+  void setProgressSplashScreen(int value);
+
+  void startupPhase(const QString &phase);
 
 public slots:
   void receiveMessage(const QString &message);
   void quitApplication();
   void reloadUserStyleBrowser();
+  void downloadEnclosure(int feedId, const QString &url,
+                         const QString &type, qint64 length);
 
 signals:
   void signalRunUserFilter(int feedId, int filterId);
+  void signalReloadUserFilters();
   void signalSqlQueryExec(const QString &query);
 
 private slots:
   void commitData(QSessionManager &manager);
+  void initDeferredSubsystems();
+  void logMemoryUsage();
+  void runParseBenchmark();
+  void runKernelBenchmark();
+  void runDatabaseGenerator();
+  void runUiBenchmark();
+  void runStress();
+  void finishStress();
 
 private:
   void checkPortable();
   void checkDir();
+  void startMemoryLog();
   void createSettings();
   void createGoogleAnalytics();
   void connectDatabase();
+  void createLocalApi();
   void loadSettings();
   void setStyleApplication();
   void showSplashScreen();
   void closeSplashScreen();
-  void setProgressSplashScreen(int value);
+  bool isBenchmark() const;
 
   QUrl userStyleSheet(const QString &filePath) const;
 
@@ -127,6 +157,8 @@ private:
   QString soundNotifyDir_;
 
   bool storeDBMemory_;
+  bool walDB_;
+  bool mapDBMemory_;
   bool dbFileExists_;
   bool isSaveDataLastFeed_;
   QString styleApplication_;
@@ -135,14 +167,18 @@ private:
   bool noDebugOutput_;
 
   QTranslator *translator_;
+  QString translationFileName_;
   QString langFileName_;
   SplashScreen *splashScreen_;
   MainWindow *mainWindow_;
   NetworkManager *networkManager_;
   CookieJar *cookieJar_;
-  QNetworkDiskCache *diskCache_;
   UpdateFeeds *updateFeeds_;
+  UpdateDaemon *updateDaemon_;
+  LocalApi *localApi_;
   DownloadManager *downloadManager_;
+  AsyncQuery *asyncQuery_;
+  NetworkArchive *networkArchive_;
   QWidget *closingWidget_;
 
   QStringList c2fWhitelist_;
@@ -150,6 +186,22 @@ private:
 
   GAnalytics *analytics_;
 
+  QElapsedTimer startupTimer_;
+  qint64 startupPhaseTime_;
+  bool startupProfile_;
+  bool startupFinished_;
+  bool headless_;
+  QString benchCorpus_;
+  QString benchKernels_;
+  QString generateDbFile_;
+  int generateFeeds_;
+  int generateNews_;
+  QString benchUiFile_;
+  QString stressFile_;
+  int stressRounds_;
+  StressRun *stressRun_;
+  QElapsedTimer shutdownTimer_;
+
 };
 
 #endif // MAINAPPLICATION_H
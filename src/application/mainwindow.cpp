@@ -20,6 +20,8 @@
 #include "common.h"
 #include "mainapplication.h"
 #include "database.h"
+#include "databasebackup.h"
+#include "newsexporter.h"
 #include "aboutdialog.h"
 #include "adblockmanager.h"
 #include "adblockicon.h"
@@ -30,17 +32,30 @@
 #include "feedpropertiesdialog.h"
 #include "filterrulesdialog.h"
 #include "newsfiltersdialog.h"
+#include "pipelinemetrics.h"
+#include "pipelinemetricsdialog.h"
+#include "updatefeeds.h"
 #include "webpage.h"
 #include "settings.h"
+#include "soundpool.h"
 
 #if defined(Q_OS_WIN)
 #include <windows.h>
 #include <psapi.h>
+#elif defined(__GLIBC__)
+#include <malloc.h>
 #endif
 #include <QMainWindow>
 #include <QStatusBar>
 #include <qzregexp.h>
 
+// Interval to merge feed counts sent by update thread, ms
+#define FEED_COUNTS_INTERVAL 30
+// Interval to look for tabs to hibernate, ms
+#define HIBERNATE_CHECK_INTERVAL 60000
+// Number of rendered tray icons with number kept
+#define TRAY_ICONS_CACHE_SIZE 20
+
 // ---------------------------------------------------------------------------
 MainWindow::MainWindow(QWidget *parent)
   : QMainWindow(parent)
@@ -52,23 +67,20 @@ MainWindow::MainWindow(QWidget *parent)
   , newsFilterAction_(NULL)
   , newsView_(NULL)
   , updateTimeCount_(0)
-#if defined(HAVE_QT5) || defined(HAVE_PHONON)
-  , mediaPlayer_(NULL)
-#endif
   , updateAppDialog_(NULL)
   , notificationWidget(NULL)
   , feedIdOld_(-2)
   , isStartImportFeed_(false)
   , recountCategoryCountsOn_(false)
+  , trayIcons_(TRAY_ICONS_CACHE_SIZE)
+  , backupRunning_(false)
+  , restoreFeedId_(0)
   , optionsDialog_(NULL)
 {
   setObjectName("mainWindow");
   setWindowTitle("QuiteRSS");
   setContextMenuPolicy(Qt::CustomContextMenu);
 
-  if (mainApp->analytics())
-    mainApp->analytics()->sendScreenview("MainWindow");
-
   db_ = QSqlDatabase::database();
 
   createFeedsWidget();
@@ -84,19 +96,20 @@ MainWindow::MainWindow(QWidget *parent)
 
   createTabBarWidget();
   createCentralWidget();
+  mainApp->startupPhase("main window widgets");
 
   loadSettingsFeeds();
+  mainApp->startupPhase("feeds tree");
 
   setStyleSheet("QMainWindow::separator { width: 1px; }");
 
+  soundPool_ = new SoundPool(this);
   loadSettings();
 
   addOurFeed();
 
   initUpdateFeeds();
 
-  QTimer::singleShot(5000, this, SLOT(slotUpdateAppCheck()));
-
   connect(this, SIGNAL(signalShowNotification(bool)),
           SLOT(showNotification(bool)), Qt::QueuedConnection);
   connect(this, SIGNAL(signalPlaySoundNewNews()),
@@ -105,10 +118,14 @@ MainWindow::MainWindow(QWidget *parent)
   connect(&timerLinkOpening_, SIGNAL(timeout()),
           this, SLOT(slotTimerLinkOpening()));
 
-  connect(mainApp->downloadManager(), SIGNAL(signalShowDownloads(bool)),
-          this, SLOT(showDownloadManager(bool)));
-  connect(mainApp->downloadManager(), SIGNAL(signalUpdateInfo(QString)),
-          this, SLOT(updateInfoDownloads(QString)));
+  feedCountsTimer_.setSingleShot(true);
+  feedCountsTimer_.setInterval(FEED_COUNTS_INTERVAL);
+  connect(&feedCountsTimer_, SIGNAL(timeout()),
+          this, SLOT(applyFeedCounts()));
+
+  connect(&hibernateTimer_, SIGNAL(timeout()),
+          this, SLOT(slotHibernateTabs()));
+  hibernateTimer_.start(HIBERNATE_CHECK_INTERVAL);
 
   connect(&timerTrayOpenNotify, SIGNAL(timeout()), this, SLOT(slotTrayOpenNotifyTimer()));
   timerTrayOpenNotify.setSingleShot(true);
@@ -166,6 +183,13 @@ void MainWindow::quitApp()
 
   saveSettings();
 
+  // Backup reads memory base by its handle, so it must end before base
+  // is saved and connections are closed
+  if (backupThread_)
+    backupThread_->wait();
+  // Deletes and restores of news queued by tabs are written before save
+  mainApp->asyncQuery()->flush();
+
   for (int i = 0; i < stackedWidget_->count(); i++) {
     NewsTabWidget *widget = (NewsTabWidget*)stackedWidget_->widget(i);
     widget->disconnectObjects();
@@ -287,6 +311,7 @@ void MainWindow::changeEvent(QEvent *event)
   } else if (event->type() == QEvent::ActivationChange) {
     if (isActiveWindow() && (behaviorIconTray_ == CHANGE_ICON_TRAY)) {
       traySystem->setIcon(QIcon(":/images/quiterss128"));
+      trayIconText_ = QString();
     }
   } else if (event->type() == QEvent::LanguageChange) {
     retranslateStrings();
@@ -302,7 +327,7 @@ void MainWindow::slotPlaceToTray()
   hide();
 
   if (emptyWorking_)
-    QTimer::singleShot(10000, this, SLOT(myEmptyWorkingSet()));
+    QTimer::singleShot(10000, this, SLOT(releaseMemory()));
   if (markReadMinimize_)
     setFeedRead(currentNewsTab->type_, currentNewsTab->feedId_, FeedReadPlaceToTray, currentNewsTab);
   if (clearStatusNew_)
@@ -784,6 +809,11 @@ void MainWindow::createActions()
   this->addAction(exportFeedsAct_);
   connect(exportFeedsAct_, SIGNAL(triggered()), this, SLOT(slotExportFeeds()));
 
+  exportNewsAct_ = new QAction(this);
+  exportNewsAct_->setObjectName("exportNewsAct");
+  this->addAction(exportNewsAct_);
+  connect(exportNewsAct_, SIGNAL(triggered()), this, SLOT(slotExportNews()));
+
   createBackupAct_ = new QAction(this);
   createBackupAct_->setObjectName("createBackupAct");
   createBackupAct_->setIcon(QIcon(":/images/backup"));
@@ -845,6 +875,11 @@ void MainWindow::createActions()
   newspaperLayoutAct_->setIcon(QIcon(":/images/layout_newspaper"));
   newspaperLayoutAct_->setCheckable(true);
   newspaperLayoutAct_->setData(1);
+  clusteredLayoutAct_ = new QAction(this);
+  clusteredLayoutAct_->setObjectName("clusteredLayoutAct_");
+  clusteredLayoutAct_->setIcon(QIcon(":/images/layout_classic"));
+  clusteredLayoutAct_->setCheckable(true);
+  clusteredLayoutAct_->setData(2);
   layoutToggle_ = new QAction(this);
   layoutToggle_->setObjectName("layoutToggle");
   layoutToggle_->setIcon(QIcon(":/images/layout_classic"));
@@ -1001,6 +1036,11 @@ void MainWindow::createActions()
   this->addAction(showCleanUpWizardAct_);
   connect(showCleanUpWizardAct_, SIGNAL(triggered()), this, SLOT(cleanUp()));
 
+  showPipelineMetricsAct_ = new QAction(this);
+  showPipelineMetricsAct_->setObjectName("showPipelineMetricsAct");
+  this->addAction(showPipelineMetricsAct_);
+  connect(showPipelineMetricsAct_, SIGNAL(triggered()), this, SLOT(showPipelineMetrics()));
+
   setNewsFiltersAct_ = new QAction(this);
   setNewsFiltersAct_->setObjectName("setNewsFiltersAct");
   setNewsFiltersAct_->setIcon(QIcon(":/images/filterOff"));
@@ -1504,6 +1544,7 @@ void MainWindow::createShortcut()
   listActions_.append(openHomeFeedAct_);
   listActions_.append(showDownloadManagerAct_);
   listActions_.append(showCleanUpWizardAct_);
+  listActions_.append(showPipelineMetricsAct_);
   listActions_.append(setNewsFiltersAct_);
   listActions_.append(setFilterNewsAct_);
   optionsAct_->setShortcut(QKeySequence(Qt::Key_F8));
@@ -1533,6 +1574,7 @@ void MainWindow::createShortcut()
 
   listActions_.append(importFeedsAct_);
   listActions_.append(exportFeedsAct_);
+  listActions_.append(exportNewsAct_);
   listActions_.append(createBackupAct_);
   listActions_.append(autoLoadImagesToggle_);
   listActions_.append(markAllFeedsRead_);
@@ -1679,6 +1721,7 @@ void MainWindow::createMenu()
   fileMenu_->addSeparator();
   fileMenu_->addAction(importFeedsAct_);
   fileMenu_->addAction(exportFeedsAct_);
+  fileMenu_->addAction(exportNewsAct_);
   fileMenu_->addSeparator();
   fileMenu_->addAction(createBackupAct_);
   fileMenu_->addSeparator();
@@ -1706,6 +1749,7 @@ void MainWindow::createMenu()
   layoutGroup_ = new QActionGroup(this);
   layoutGroup_->addAction(classicLayoutAct_);
   layoutGroup_->addAction(newspaperLayoutAct_);
+  layoutGroup_->addAction(clusteredLayoutAct_);
   layoutMenu_ = new QMenu(this);
   layoutMenu_->addActions(layoutGroup_->actions());
   layoutToggle_->setMenu(layoutMenu_);
@@ -1853,13 +1897,14 @@ void MainWindow::createMenu()
   browserMenu_->addSeparator();
   browserMenu_->addAction(savePageAsAct_);
   browserMenu_->addSeparator();
-  browserMenu_->addAction(tr("&AdBlock"), AdBlockManager::instance(), SLOT(showDialog()));
+  browserMenu_->addAction(tr("&AdBlock"), this, SLOT(showAdBlockDialog()));
 
   toolsMenu_ = new QMenu(this);
   toolsMenu_->addAction(showDownloadManagerAct_);
   toolsMenu_->addSeparator();
   toolsMenu_->addAction(showCleanUpWizardAct_);
   toolsMenu_->addAction(setNewsFiltersAct_);
+  toolsMenu_->addAction(showPipelineMetricsAct_);
   toolsMenu_->addSeparator();
   toolsMenu_->addAction(optionsAct_);
 
@@ -1875,6 +1920,7 @@ void MainWindow::createMenu()
   mainMenu_->addSeparator();
   mainMenu_->addAction(importFeedsAct_);
   mainMenu_->addAction(exportFeedsAct_);
+  mainMenu_->addAction(exportNewsAct_);
   mainMenu_->addSeparator();
   mainMenu_->addAction(createBackupAct_);
   mainMenu_->addSeparator();
@@ -2085,6 +2131,8 @@ void MainWindow::loadSettings()
 
   soundNewNews_ = settings.value("soundNewNews", true).toBool();
   soundNotifyPath_ = settings.value("soundNotifyPath", mainApp->soundNotifyDefaultFile()).toString();
+  if (soundNewNews_)
+    soundPool_->preload(soundNotifyPath_);
   showNotifyOn_ = settings.value("showNotifyOn", true).toBool();
   screenNotify_ = settings.value("screenNotify", 0).toInt();
   positionNotify_ = settings.value("positionNotify", 3).toInt();
@@ -2187,6 +2235,10 @@ void MainWindow::loadSettings()
     newspaperLayoutAct_->setChecked(true);
     layoutToggle_->setIcon(QIcon(":/images/layout_newspaper"));
     break;
+  case 2:
+    clusteredLayoutAct_->setChecked(true);
+    layoutToggle_->setIcon(QIcon(":/images/layout_classic"));
+    break;
   default:
     classicLayoutAct_->setChecked(true);
     layoutToggle_->setIcon(QIcon(":/images/layout_classic"));
@@ -2521,7 +2573,8 @@ void MainWindow::saveSettings()
 
   mainApp->cookieJar()->saveCookies();
   mainApp->c2fSaveSettings();
-  AdBlockManager::instance()->save();
+  if (AdBlockManager::isCreated())
+    AdBlockManager::instance()->save();
 }
 
 void MainWindow::setProxy(const QNetworkProxy proxy)
@@ -2569,7 +2622,7 @@ void MainWindow::addFeed()
 
   QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
   feedsView_->setCurrentIndex(QModelIndex());
-  feedsModelReload();
+  feedsModel_->insertNewFeeds();
   QModelIndex index = feedsProxyModel_->mapFromSource(addFeedWizard->feedId_);
   feedsView_->selectIdEn_ = true;
   feedsView_->setCurrentIndex(index);
@@ -2623,7 +2676,7 @@ void MainWindow::addFolder()
   delete addFolderDialog;
 
   QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
-  feedsModelReload();
+  feedsModel_->insertNewFeeds();
   QApplication::restoreOverrideCursor();
 }
 
@@ -2658,8 +2711,8 @@ void MainWindow::deleteItemFeedsTree()
   for (int i = indexList.count()-1; i >= 0; --i) {
     QModelIndex index = feedsProxyModel_->mapToSource(indexList[i]);
     if (feedsModel_->isFolder(index)) {
-      idList.append(feedsModel_->dataField(index, "id").toInt());
-      int parentId = feedsModel_->dataField(index, "parentId").toInt();
+      idList.append(feedsModel_->dataField(index, FeedsModel::FieldId).toInt());
+      int parentId = feedsModel_->dataField(index, FeedsModel::FieldParentId).toInt();
       if (!parentIdList.contains(parentId)) {
         parentIdList.append(parentId);
       }
@@ -2668,10 +2721,10 @@ void MainWindow::deleteItemFeedsTree()
   }
   for (int i = indexList.count()-1; i >= 0; --i) {
     QModelIndex index = feedsProxyModel_->mapToSource(indexList[i]);
-    int parentId = feedsModel_->dataField(index, "parentId").toInt();
+    int parentId = feedsModel_->dataField(index, FeedsModel::FieldParentId).toInt();
     if (!idList.contains(parentId)) {
-      idList.append(feedsModel_->dataField(index, "id").toInt());
-      int parentId = feedsModel_->dataField(index, "parentId").toInt();
+      idList.append(feedsModel_->dataField(index, FeedsModel::FieldId).toInt());
+      int parentId = feedsModel_->dataField(index, FeedsModel::FieldParentId).toInt();
       if (!parentIdList.contains(parentId)) {
         parentIdList.append(parentId);
       }
@@ -2725,7 +2778,7 @@ void MainWindow::deleteItemFeedsTree()
   }
 
   recountFeedCategories(parentIdList);
-  feedsModelReload();
+  feedsModel_->removeFeeds(idList);
   currentIndex = feedsProxyModel_->mapFromSource(feedIdCur);
   feedsView_->setCurrentIndex(currentIndex);
   slotFeedClicked(currentIndex);
@@ -2785,63 +2838,59 @@ void MainWindow::slotExportFeeds()
     return;
   }
 
-  QXmlStreamWriter xml(&file);
-  xml.setAutoFormatting(true);
-  xml.writeStartDocument();
-  xml.writeStartElement("opml");
-  xml.writeAttribute("version", "2.0");
-  xml.writeStartElement("head");
-  xml.writeTextElement("title", "QuiteRSS");
-  xml.writeTextElement("dateModified", QDateTime::currentDateTime().toString());
-  xml.writeEndElement(); // </head>
-
-  xml.writeStartElement("body");
-
-  // Create model and view for export
-  // Expand the view to step on every item
-  FeedsModel exportTreeModel(this);
-  QTreeView exportTreeView;
-  exportTreeView.setModel(&exportTreeModel);
-  exportTreeModel.setView(feedsView_);
-  exportTreeView.expandAll();
-
-  QModelIndex index = exportTreeModel.index(0, 0);
-  QStack<int> parentIdsStack;
-  parentIdsStack.push(0);
-  while (index.isValid()) {
-    int feedId = exportTreeModel.idByIndex(index);
-    int feedParId = exportTreeModel.paridByIndex(index);
+  NewsExporter exporter(QSqlDatabase::database());
+  if (!exporter.exportFeeds(&file))
+    statusBar()->showMessage(tr("Export: can't write a file"), 3000);
 
-    // Parent differs from previouse one - close folder
-    while (feedParId != parentIdsStack.top()) {
-      xml.writeEndElement();  // "outline" - folder finishes
-      parentIdsStack.pop();
-    }
+  file.close();
+}
 
-    // Folder has found. Open it
-    if (exportTreeModel.isFolder(index)) {
-      parentIdsStack.push(feedId);
-      xml.writeStartElement("outline");  // Folder starts
-      xml.writeAttribute("text", exportTreeModel.dataField(index, "text").toString());
-    }
-    // Feed has found. Save it
-    else {
-      xml.writeEmptyElement("outline");
-      xml.writeAttribute("text",    exportTreeModel.dataField(index, "text").toString());
-      xml.writeAttribute("type",    "rss");
-      xml.writeAttribute("htmlUrl", exportTreeModel.dataField(index, "htmlUrl").toString());
-      xml.writeAttribute("xmlUrl",  exportTreeModel.dataField(index, "xmlUrl").toString());
-    }
+/** @brief Export news of current list to file
+ *
+ * Format is chosen by filter of file dialog.
+ *---------------------------------------------------------------------------*/
+void MainWindow::slotExportNews()
+{
+  if (!newsModel_) {
+    statusBar()->showMessage(tr("Export: no news to export"), 3000);
+    return;
+  }
+
+  QString jsonFilter = tr("JSON Feed (*.json)");
+  QString mboxFilter = tr("Mailbox (*.mbox)");
+  QString htmlFilter = tr("HTML-Files (*.html)");
+  QString selectedFilter = jsonFilter;
+  QString fileName = QFileDialog::getSaveFileName(this, tr("Export News"),
+                                                  QDir::homePath(),
+                                                  QString("%1;;%2;;%3").
+                                                  arg(jsonFilter, mboxFilter, htmlFilter),
+                                                  &selectedFilter);
 
-    index = exportTreeView.indexBelow(index);
+  if (fileName.isNull()) {
+    statusBar()->showMessage(tr("Export canceled"), 3000);
+    return;
   }
 
-  xml.writeEndElement(); // </body>
+  NewsExporter::Format format = NewsExporter::FormatJson;
+  if (selectedFilter == mboxFilter) format = NewsExporter::FormatMbox;
+  else if (selectedFilter == htmlFilter) format = NewsExporter::FormatHtml;
 
-  xml.writeEndElement(); // </opml>
-  xml.writeEndDocument();
+  QFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly)) {
+    statusBar()->showMessage(tr("Export: can't open a file"), 3000);
+    return;
+  }
 
+  QApplication::setOverrideCursor(Qt::WaitCursor);
+  NewsExporter exporter(QSqlDatabase::database());
+  bool ok = exporter.exportNews(&file, format, newsModel_->filter());
+  QApplication::restoreOverrideCursor();
   file.close();
+
+  if (ok)
+    statusBar()->showMessage(tr("Exported news: %1").arg(exporter.count()), 3000);
+  else
+    statusBar()->showMessage(tr("Export: can't write a file"), 3000);
 }
 // ----------------------------------------------------------------------------
 void MainWindow::slotFeedsViewportUpdate()
@@ -2860,38 +2909,92 @@ void MainWindow::slotFeedsViewportUpdate()
 // ----------------------------------------------------------------------------
 void MainWindow::slotFeedCountsUpdate(FeedCountStruct counts)
 {
-  QModelIndex index = feedsModel_->indexById(counts.feedId);
-  if (index.isValid()) {
-    QModelIndex indexUnread   = feedsModel_->indexSibling(index, "unread");
-    QModelIndex indexNew      = feedsModel_->indexSibling(index, "newCount");
-    QModelIndex indexUndelete = feedsModel_->indexSibling(index, "undeleteCount");
-    feedsModel_->setData(indexUnread, counts.unreadCount);
-    feedsModel_->setData(indexNew, counts.newCount);
-    feedsModel_->setData(indexUndelete, counts.undeleteCount);
+  QHash<int,FeedCountStruct>::iterator iter = pendingFeedCounts_.find(counts.feedId);
+  if (iter == pendingFeedCounts_.end()) {
+    pendingFeedCounts_.insert(counts.feedId, counts);
+  } else {
+    FeedCountStruct &pending = iter.value();
+    pending.unreadCount = counts.unreadCount;
+    pending.newCount = counts.newCount;
+    pending.undeleteCount = counts.undeleteCount;
+    if (!counts.updated.isEmpty()) pending.updated = counts.updated;
+    if (!counts.lastBuildDate.isEmpty()) pending.lastBuildDate = counts.lastBuildDate;
+    if (!counts.htmlUrl.isEmpty()) pending.htmlUrl = counts.htmlUrl;
+    if (!counts.title.isEmpty()) pending.title = counts.title;
+  }
+  if (!feedCountsTimer_.isActive())
+    feedCountsTimer_.start();
+
+  if (isStartImportFeed_ && !counts.xmlUrl.isEmpty()) {
+    emit faviconRequestUrl(counts.htmlUrl, counts.xmlUrl);
+  }
+}
+
+/** @brief Apply counts collected since last call to feeds model
+ *
+ *  Feeds send counts for themselves and for each parent folder, so during
+ *  update of all feeds they are merged and the view is repainted once per
+ *  FEED_COUNTS_INTERVAL.
+ *---------------------------------------------------------------------------*/
+void MainWindow::applyFeedCounts()
+{
+  feedCountsTimer_.stop();
+  if (pendingFeedCounts_.isEmpty()) return;
+
+  QElapsedTimer timer;
+  timer.start();
+
+  foreach (const FeedCountStruct &counts, pendingFeedCounts_) {
+    QModelIndex index = feedsModel_->indexById(counts.feedId);
+    if (!index.isValid()) continue;
+
+    feedsModel_->setData(feedsModel_->indexSibling(index, "unread"), counts.unreadCount);
+    feedsModel_->setData(feedsModel_->indexSibling(index, "newCount"), counts.newCount);
+    feedsModel_->setData(feedsModel_->indexSibling(index, "undeleteCount"), counts.undeleteCount);
 
     if (!counts.updated.isEmpty()) {
-      QModelIndex indexUpdated  = feedsModel_->indexSibling(index, "updated");
-      feedsModel_->setData(indexUpdated, counts.updated);
+      feedsModel_->setData(feedsModel_->indexSibling(index, "updated"), counts.updated);
     }
-
     if (!counts.lastBuildDate.isEmpty()) {
-      QModelIndex indexLastBuildDate = feedsModel_->indexSibling(index, "lastBuildDate");
-      feedsModel_->setData(indexLastBuildDate, counts.lastBuildDate);
+      feedsModel_->setData(feedsModel_->indexSibling(index, "lastBuildDate"), counts.lastBuildDate);
     }
-
     if (!counts.htmlUrl.isEmpty()) {
-      QModelIndex indexHtmlUrl = feedsModel_->indexSibling(index, "htmlUrl");
-      feedsModel_->setData(indexHtmlUrl, counts.htmlUrl);
+      feedsModel_->setData(feedsModel_->indexSibling(index, "htmlUrl"), counts.htmlUrl);
     }
-
     if (!counts.title.isEmpty()) {
-      QModelIndex indexTitle = feedsModel_->indexSibling(index, "title");
-      feedsModel_->setData(indexTitle, counts.title);
+      feedsModel_->setData(feedsModel_->indexSibling(index, "title"), counts.title);
     }
   }
+  pendingFeedCounts_.clear();
+  feedsModel_->emitCountsChanged();
 
-  if (isStartImportFeed_ && !counts.xmlUrl.isEmpty()) {
-    emit faviconRequestUrl(counts.htmlUrl, counts.xmlUrl);
+  feedsView_->viewport()->update();
+  PipelineMetrics::record(PipelineMetrics::UiApply, timer.elapsed());
+}
+
+/** @brief Hibernate tabs which were not shown for Settings/tabHibernateTime
+ *  minutes, 0 disables hibernation
+ *---------------------------------------------------------------------------*/
+void MainWindow::slotHibernateTabs()
+{
+  Settings settings;
+  qint64 hibernateTime = qint64(settings.value("Settings/tabHibernateTime", 30).toInt()) * 60 * 1000;
+  if (hibernateTime <= 0) return;
+
+  for (int i = 0; i < stackedWidget_->count(); i++) {
+    NewsTabWidget *widget = (NewsTabWidget*)stackedWidget_->widget(i);
+    if ((widget == currentNewsTab) || widget->isHibernated())
+      continue;
+    if (widget->idleTime() >= hibernateTime)
+      widget->hibernate();
+  }
+}
+
+// ----------------------------------------------------------------------------
+void MainWindow::slotFeedsCountsUpdate(QList<FeedCountStruct> countsList)
+{
+  foreach (const FeedCountStruct &counts, countsList) {
+    slotFeedCountsUpdate(counts);
   }
 }
 
@@ -2916,7 +3019,8 @@ void MainWindow::recountFeedCategories(const QList<int> &categoriesList)
 
       // Calculate sum of all feeds with same parent
       qStr = QString("SELECT sum(unread), sum(undeleteCount), sum(newCount) "
-                     "FROM feeds WHERE parentId=='%1'").arg(categoryId);
+                     "FROM feedsState WHERE feedId IN "
+                     "(SELECT id FROM feeds WHERE parentId=='%1')").arg(categoryId);
       q.exec(qStr);
       if (q.next()) {
         unreadCount   = q.value(0).toInt();
@@ -2925,9 +3029,16 @@ void MainWindow::recountFeedCategories(const QList<int> &categoriesList)
       }
 
       if (unreadCount != -1) {
-        qStr = QString("UPDATE feeds SET unread='%1', undeleteCount='%2', newCount='%3' WHERE id=='%4'").
+        qStr = QString("UPDATE feedsState SET unread='%1', undeleteCount='%2', newCount='%3' WHERE feedId=='%4'").
             arg(unreadCount).arg(undeleteCount).arg(newCount).arg(categoryId);
         q.exec(qStr);
+
+        QModelIndex index = feedsModel_->indexById(categoryId);
+        if (index.isValid()) {
+          feedsModel_->setData(feedsModel_->indexSibling(index, "unread"), unreadCount);
+          feedsModel_->setData(feedsModel_->indexSibling(index, "undeleteCount"), undeleteCount);
+          feedsModel_->setData(feedsModel_->indexSibling(index, "newCount"), newCount);
+        }
       }
 
       // go to next parent's parent
@@ -2938,6 +3049,7 @@ void MainWindow::recountFeedCategories(const QList<int> &categoriesList)
       if (q.next()) categoryId = q.value(0).toInt();
     }
   }
+  feedsModel_->emitCountsChanged();
 }
 // ----------------------------------------------------------------------------
 void MainWindow::recountCategoryCounts()
@@ -2950,16 +3062,31 @@ void MainWindow::recountCategoryCounts()
   emit signalRecountCategoryCounts();
 }
 
+/** @brief Change counters of feed and its parents before news state is written
+ *
+ * Counters are recalculated from DB when queued news state is written.
+ *----------------------------------------------------------------------------*/
+void MainWindow::adjustFeedCounts(int feedId, int unreadDelta, int newDelta)
+{
+  QModelIndex index = feedsModel_->indexById(feedId);
+  while (index.isValid()) {
+    int unread = feedsModel_->dataField(index, FeedsModel::FieldUnread).toInt() + unreadDelta;
+    int newCount = feedsModel_->dataField(index, FeedsModel::FieldNewCount).toInt() + newDelta;
+    feedsModel_->setData(feedsModel_->indexSibling(index, "unread"), qMax(0, unread));
+    feedsModel_->setData(feedsModel_->indexSibling(index, "newCount"), qMax(0, newCount));
+    index = feedsModel_->indexById(feedsModel_->dataField(index, FeedsModel::FieldParentId).toInt());
+  }
+  feedsModel_->emitCountsChanged();
+  feedsView_->viewport()->update();
+}
+
 /** @brief Process recalculating categories counters
  *----------------------------------------------------------------------------*/
-void MainWindow::slotRecountCategoryCounts(QList<int> deletedList, QList<int> starredList,
-                                           QList<int> readList, QStringList labelList)
-{
-  int allStarredCount = 0;
-  int unreadStarredCount = 0;
-  int deletedCount = 0;
-  QMap<int,int> allCountList;
-  QMap<int,int> unreadCountList;
+void MainWindow::slotRecountCategoryCounts(CategoryCountStruct counts)
+{
+  int allStarredCount = counts.allStarredCount;
+  int unreadStarredCount = counts.unreadStarredCount;
+  int deletedCount = counts.deletedCount;
   int allLabelCount = 0;
   int unreadLabelCount = 0;
   QFont font;
@@ -2967,51 +3094,23 @@ void MainWindow::slotRecountCategoryCounts(QList<int> deletedList, QList<int> st
   QTreeWidgetItem *labelTreeItem = categoriesTree_->topLevelItem(CategoriesTreeWidget::LabelsItem);
   for (int i = 0; i < labelTreeItem->childCount(); i++) {
     int id = labelTreeItem->child(i)->text(2).toInt();
-    allCountList.insert(id, 0);
-    unreadCountList.insert(id, 0);
-  }
-
-  for (int i = 0; i < deletedList.count(); ++i) {
-    if (deletedList.at(i) == 0) {
-      if (starredList.at(i) == 1) {
-        allStarredCount++;
-        if (readList.at(i) == 0)
-          unreadStarredCount++;
-      }
-      QString idString = labelList.at(i);
-      if (!idString.isEmpty() && idString != ",") {
-        QStringList idList = idString.split(",", QString::SkipEmptyParts);
-        foreach (QString idStr, idList) {
-          int id = idStr.toInt();
-          if (allCountList.contains(id)) {
-            allCountList[id]++;
-            if (readList.at(i) == 0)
-              unreadCountList[id]++;
-          }
-        }
-      }
-    } else if (deletedList.at(i) == 1) {
-      deletedCount++;
-    }
-  }
-
-  for (int i = 0; i < labelTreeItem->childCount(); i++) {
-    int id = labelTreeItem->child(i)->text(2).toInt();
+    int allCount = counts.allLabelCount.value(id, 0);
+    int unreadCount = counts.unreadLabelCount.value(id, 0);
     QString countStr;
-    if (!unreadCountList[id] && !allCountList[id])
+    if (!unreadCount && !allCount)
       countStr = "";
     else
-      countStr = QString("(%1/%2)").arg(unreadCountList[id]).arg(allCountList[id]);
+      countStr = QString("(%1/%2)").arg(unreadCount).arg(allCount);
     labelTreeItem->child(i)->setText(4, countStr);
     font = labelTreeItem->child(i)->font(0);
-    if (unreadCountList[id])
+    if (unreadCount)
       font.setBold(true);
     else
       font.setBold(false);
     labelTreeItem->child(i)->setFont(0, font);
 
-    unreadLabelCount = unreadLabelCount + unreadCountList[id];
-    allLabelCount = allLabelCount + allCountList[id];
+    unreadLabelCount = unreadLabelCount + unreadCount;
+    allLabelCount = allLabelCount + allCount;
   }
 
   QString countStr;
@@ -3064,6 +3163,22 @@ void MainWindow::slotRecountCategoryCounts(QList<int> deletedList, QList<int> st
  * @param changed Flag indicating that feed is updated indeed
  *---------------------------------------------------------------------------*/
 void MainWindow::slotUpdateFeed(int feedId, bool changed, int newCount, bool finish)
+{
+  QList<int> feedIds;
+  QList<int> newCounts;
+  if (changed) {
+    feedIds.append(feedId);
+    newCounts.append(newCount);
+  }
+  slotFeedsUpdated(feedIds, newCounts, finish);
+}
+
+/** @brief Process feeds finished since last progress snapshot
+ *
+ * Only changed feeds are listed. Tray, sound and category counters are
+ * updated once for all of them.
+ *---------------------------------------------------------------------------*/
+void MainWindow::slotFeedsUpdated(QList<int> feedIds, QList<int> newCounts, bool finish)
 {
   if (finish) {
     emit signalShowNotification();
@@ -3073,18 +3188,23 @@ void MainWindow::slotUpdateFeed(int feedId, bool changed, int newCount, bool fin
     isStartImportFeed_ = false;
   }
 
-  if (!changed) {
+  if (feedIds.isEmpty()) {
     emit signalNextUpdate(finish);
     return;
   }
 
+  int newCountAll = 0;
+  foreach (int newCount, newCounts)
+    newCountAll += newCount;
+
   // Action after new news has arrived: tray, sound
-  if (!isActiveWindow() && (newCount > 0) &&
+  if (!isActiveWindow() && (newCountAll > 0) &&
       (behaviorIconTray_ == CHANGE_ICON_TRAY)) {
     traySystem->setIcon(QIcon(":/images/quiterss128_NewNews"));
+    trayIconText_ = QString();
   }
   emit signalRefreshInfoTray();
-  if (newCount > 0)
+  if (newCountAll > 0)
     emit signalPlaySoundNewNews();
 
   // Manage notifications
@@ -3100,8 +3220,13 @@ void MainWindow::slotUpdateFeed(int feedId, bool changed, int newCount, bool fin
     clearNotification();
   }
 
-  if (newCount > 0)
+  for (int i = 0; i < feedIds.count(); ++i)
   {
+    int feedId = feedIds.at(i);
+    int newCount = newCounts.at(i);
+    if (newCount <= 0)
+      continue;
+
     bool bAddRecentNews = !onlySelectedFeeds_ || idFeedsNotifyList_.contains(feedId);
     bool bAddNewNews = bAddRecentNews && showNotify;
 
@@ -3146,7 +3271,15 @@ void MainWindow::slotUpdateFeed(int feedId, bool changed, int newCount, bool fin
 void MainWindow::slotUpdateNews(int refresh)
 {
   int newsId = newsModel_->index(
-        newsView_->currentIndex().row(), newsModel_->fieldIndex("id")).data(Qt::EditRole).toInt();
+        newsView_->currentIndex().row(), newsModel_->fieldColumn(NewsModel::FieldId)).data(Qt::EditRole).toInt();
+
+  mainApp->flushNewsState();
+
+  // News of update are inserted, current item and scroll are kept by view
+  if ((refresh == NewsTabWidget::RefreshInsert) && newsModel_->mergeNews()) {
+    currentNewsTab->loadNewspaper(refresh);
+    return;
+  }
 
   newsModel_->select();
 
@@ -3157,11 +3290,11 @@ void MainWindow::slotUpdateNews(int refresh)
 
   currentNewsTab->loadNewspaper(refresh);
 
-  QModelIndex index = newsModel_->index(0, newsModel_->fieldIndex("id"));
+  QModelIndex index = newsModel_->index(0, newsModel_->fieldColumn(NewsModel::FieldId));
   QModelIndexList indexList = newsModel_->match(index, Qt::EditRole, newsId);
   if (indexList.count()) {
     int newsRow = indexList.first().row();
-    newsView_->setCurrentIndex(newsModel_->index(newsRow, newsModel_->fieldIndex("title")));
+    newsView_->setCurrentIndex(newsModel_->index(newsRow, newsModel_->fieldColumn(NewsModel::FieldTitle)));
   } else {
     currentNewsTab->currentNewsIdOld = newsId;
     currentNewsTab->hideWebContent();
@@ -3256,7 +3389,7 @@ void MainWindow::slotFeedSelected(QModelIndex index, bool createTab)
   bool isFeed = (index.isValid() && feedsModel_->isFolder(index)) ? false : true;
 
   QPixmap iconTab;
-  QByteArray byteArray = feedsModel_->dataField(index, "image").toByteArray();
+  QByteArray byteArray = feedsModel_->dataField(index, FeedsModel::FieldImage).toByteArray();
   if (!isFeed) {
     iconTab.load(":/images/folder");
   } else {
@@ -3269,7 +3402,7 @@ void MainWindow::slotFeedSelected(QModelIndex index, bool createTab)
   currentNewsTab->newsIconTitle_->setPixmap(iconTab);
 
   // Set title for tab has opened
-  currentNewsTab->setTextTab(feedsModel_->dataField(index, "text").toString());
+  currentNewsTab->setTextTab(feedsModel_->dataField(index, FeedsModel::FieldText).toString());
 
   feedProperties_->setEnabled(index.isValid());
 
@@ -3280,33 +3413,32 @@ void MainWindow::slotFeedSelected(QModelIndex index, bool createTab)
   if (openingFeedAction_ == 0) {
     QModelIndex feedIndex = feedsModel_->indexById(feedId);
     int newsIdCur = feedsModel_->dataField(feedIndex, "currentNews").toInt();
-    QModelIndex index = newsModel_->index(0, newsModel_->fieldIndex("id"));
+    QModelIndex index = newsModel_->index(0, newsModel_->fieldColumn(NewsModel::FieldId));
     QModelIndexList indexList = newsModel_->match(index, Qt::EditRole, newsIdCur);
 
     if (!indexList.isEmpty()) newsRow = indexList.first().row();
   } else if (openingFeedAction_ == 1) {
     newsRow = 0;
   } else if ((openingFeedAction_ == 3) || (openingFeedAction_ == 4)) {
-    QModelIndex index = newsModel_->index(0, newsModel_->fieldIndex("read"));
-    QModelIndexList indexList;
-    if ((newsView_->header()->sortIndicatorOrder() == Qt::DescendingOrder) &&
-        (openingFeedAction_ != 4))
-      indexList = newsModel_->match(index, Qt::EditRole, 0, -1);
-    else
-      indexList = newsModel_->match(index, Qt::EditRole, 0);
-
-    if (!indexList.isEmpty()) newsRow = indexList.last().row();
+    const QVector<int> &unreadRows = newsModel_->unreadRows();
+    if (!unreadRows.isEmpty()) {
+      if ((newsView_->header()->sortIndicatorOrder() == Qt::DescendingOrder) &&
+          (openingFeedAction_ != 4))
+        newsRow = unreadRows.last();
+      else
+        newsRow = unreadRows.first();
+    }
   }
 
   // Focus feed news that displayed before
-  newsView_->setCurrentIndex(newsModel_->index(newsRow, newsModel_->fieldIndex("title")));
+  newsView_->setCurrentIndex(newsModel_->index(newsRow, newsModel_->fieldColumn(NewsModel::FieldTitle)));
   if (newsRow == -1) newsView_->verticalScrollBar()->setValue(newsRow);
 
   if ((openingFeedAction_ != 2) && openNewsWebViewOn_) {
-    currentNewsTab->slotNewsViewSelected(newsModel_->index(newsRow, newsModel_->fieldIndex("title")));
+    currentNewsTab->slotNewsViewSelected(newsModel_->index(newsRow, newsModel_->fieldColumn(NewsModel::FieldTitle)));
   } else {
-    currentNewsTab->slotNewsViewSelected(newsModel_->index(-1, newsModel_->fieldIndex("title")));
-    int newsId = newsModel_->index(newsRow, newsModel_->fieldIndex("id")).data(Qt::EditRole).toInt();
+    currentNewsTab->slotNewsViewSelected(newsModel_->index(-1, newsModel_->fieldColumn(NewsModel::FieldTitle)));
+    int newsId = newsModel_->index(newsRow, newsModel_->fieldColumn(NewsModel::FieldId)).data(Qt::EditRole).toInt();
     QString qStr = QString("UPDATE feeds SET currentNews='%1' WHERE id=='%2'").arg(newsId).arg(feedId);
     mainApp->sqlQueryExec(qStr);
     QModelIndex feedIndex = feedsModel_->indexById(feedId);
@@ -3322,12 +3454,16 @@ void MainWindow::showOptionDlg(int index)
 
   if (index != -1) pageIndex = index;
 
-  if (optionsDialog_) {
+  if (optionsDialog_ && optionsDialog_->isVisible()) {
     optionsDialog_->activateWindow();
     return;
   }
 
-  optionsDialog_ = new OptionsDialog(this);
+  // Dialog is built once and kept between openings
+  if (optionsDialog_)
+    optionsDialog_->reloadPages();
+  else
+    optionsDialog_ = new OptionsDialog(this);
 
   settings.beginGroup("Settings");
   bool updateFeedsStartUp = settings.value("autoUpdatefeedsStartUp", false).toBool();
@@ -3658,11 +3794,8 @@ void MainWindow::showOptionDlg(int index)
   int result = optionsDialog_->exec();
   pageIndex = optionsDialog_->currentIndex();
 
-  if (result == QDialog::Rejected) {
-    delete optionsDialog_;
-    optionsDialog_ = NULL;
+  if (result == QDialog::Rejected)
     return;
-  }
 
   // Apply accepted settings
 
@@ -3775,6 +3908,7 @@ void MainWindow::showOptionDlg(int index)
     emit signalRefreshInfoTray();
   } else {
     traySystem->setIcon(QIcon(":/images/quiterss128"));
+    trayIconText_ = QString();
   }
   singleClickTray_ = optionsDialog_->singleClickTray_->isChecked();
   clearStatusNew_ = optionsDialog_->clearStatusNew_->isChecked();
@@ -3791,6 +3925,9 @@ void MainWindow::showOptionDlg(int index)
   settings.setValue("Settings/timeoutRequest", timeoutRequest);
   settings.setValue("Settings/numberRequest", numberRequests);
   settings.setValue("Settings/numberRepeats", numberRepeats);
+  // Running update uses new proxy and request settings at once
+  Settings::publishSnapshot();
+  emit signalNetworkSettingsChanged();
 
   if (optionsDialog_->embeddedBrowserOn_->isChecked()) {
     if (optionsDialog_->defaultExternalBrowserOn_->isChecked())
@@ -3917,6 +4054,8 @@ void MainWindow::showOptionDlg(int index)
 
   soundNewNews_ = optionsDialog_->soundNotifyBox_->isChecked();
   soundNotifyPath_ = optionsDialog_->editSoundNotifer_->text();
+  if (soundNewNews_)
+    soundPool_->preload(soundNotifyPath_);
   showNotifyOn_ = optionsDialog_->showNotifyOn_->isChecked();
   screenNotify_ = optionsDialog_->screenNotify_->currentIndex()-1;
   positionNotify_ = optionsDialog_->positionNotify_->currentIndex();
@@ -3935,6 +4074,7 @@ void MainWindow::showOptionDlg(int index)
   showButtonDeleteNotify_ = optionsDialog_->showButtonDeleteNotify_->isChecked();
   closeNotify_ = optionsDialog_->closeNotify_->isChecked();
 
+  bool languageChanged = (mainApp->language() != optionsDialog_->language());
   mainApp->setLanguage(optionsDialog_->language());
   mainApp->setTranslateApplication();
 
@@ -4025,14 +4165,18 @@ void MainWindow::showOptionDlg(int index)
   notifierTextColor_ = optionsDialog_->colorsTree_->topLevelItem(21)->text(1);
   notifierBackgroundColor_ = optionsDialog_->colorsTree_->topLevelItem(22)->text(1);
 
-  delete optionsDialog_;
-  optionsDialog_ = NULL;
+  // Texts of dialog are set on creation only
+  if (languageChanged) {
+    delete optionsDialog_;
+    optionsDialog_ = NULL;
+  }
 
   settings.beginGroup("Settings");
   settings.setValue("autoUpdatefeedsStartUp", updateFeedsStartUp);
   settings.endGroup();
 
   saveSettings();
+  Settings::publishSnapshot();
   saveActionShortcuts();
   mainApp->reloadUserStyleBrowser();
 
@@ -4070,13 +4214,27 @@ void MainWindow::createTrayMenu()
   traySystem->setContextMenu(trayMenu_);
 }
 
-/** @brief Free memory working set in Windows
+/** @brief Free memory while window is hidden in tray
+ *
+ * Pages of inactive tabs and caches are dropped, they are built again when
+ * used. Freed memory is returned to system at the end.
  *---------------------------------------------------------------------------*/
-void MainWindow::myEmptyWorkingSet()
+void MainWindow::releaseMemory()
 {
+  if (!isHidden()) return;
+
+  for (int i = 0; i < stackedWidget_->count(); i++) {
+    NewsTabWidget *widget = (NewsTabWidget*)stackedWidget_->widget(i);
+    widget->releaseMemory(widget != currentNewsTab);
+  }
+  QWebSettings::clearMemoryCaches();
+  QPixmapCache::clear();
+  mainApp->updateFeeds()->releaseMemory();
+
 #if defined(Q_OS_WIN)
-  if (isHidden())
-    EmptyWorkingSet(GetCurrentProcess());
+  EmptyWorkingSet(GetCurrentProcess());
+#elif defined(__GLIBC__)
+  malloc_trim(0);
 #endif
 }
 // ----------------------------------------------------------------------------
@@ -4124,7 +4282,7 @@ void MainWindow::slotGetFeedsTimer()
     if (updateTimeCount_ >= updateIntervalSec_) {
       updateTimeCount_ = 0;
 
-      emit signalGetAllFeedsTimer();
+      emit signalGetAllFeedsTimer(updateIntervalSec_);
     }
   } else {
     updateTimeCount_ = 0;
@@ -4155,14 +4313,14 @@ void MainWindow::slotGetFeed()
   foreach (QModelIndex indexProxy, indexList) {
     QModelIndex index = feedsProxyModel_->mapToSource(indexProxy);
     if (feedsModel_->isFolder(index)) {
-      QList<int> list = UpdateObject::getIdFeedsInList(db_, feedsModel_->dataField(index, "id").toInt());
+      QList<int> list = UpdateObject::getIdFeedsInList(db_, feedsModel_->dataField(index, FeedsModel::FieldId).toInt());
       foreach (int idFeed, list) {
         if (!idList.contains(idFeed)) {
           idList.append(idFeed);
           index = feedsModel_->indexById(idFeed);
-          if (!feedsModel_->dataField(index, "disableUpdate").toBool()) {
-            emit signalGetFeed(feedsModel_->dataField(index, "id").toInt(),
-                               feedsModel_->dataField(index, "xmlUrl").toString(),
+          if (!feedsModel_->dataField(index, FeedsModel::FieldDisableUpdate).toBool()) {
+            emit signalGetFeed(feedsModel_->dataField(index, FeedsModel::FieldId).toInt(),
+                               feedsModel_->dataField(index, FeedsModel::FieldXmlUrl).toString(),
                                feedsModel_->dataField(index, "lastBuildDate").toDateTime(),
                                feedsModel_->dataField(index, "authentication").toInt());
           }
@@ -4170,11 +4328,11 @@ void MainWindow::slotGetFeed()
       }
 
     } else {
-      int idFeed = feedsModel_->dataField(index, "id").toInt();
+      int idFeed = feedsModel_->dataField(index, FeedsModel::FieldId).toInt();
       if (!idList.contains(idFeed)) {
         idList.append(idFeed);
-        emit signalGetFeed(feedsModel_->dataField(index, "id").toInt(),
-                           feedsModel_->dataField(index, "xmlUrl").toString(),
+        emit signalGetFeed(feedsModel_->dataField(index, FeedsModel::FieldId).toInt(),
+                           feedsModel_->dataField(index, FeedsModel::FieldXmlUrl).toString(),
                            feedsModel_->dataField(index, "lastBuildDate").toDateTime(),
                            feedsModel_->dataField(index, "authentication").toInt());
       }
@@ -4186,7 +4344,14 @@ void MainWindow::slotGetFeed()
  *---------------------------------------------------------------------------*/
 void MainWindow::slotGetAllFeeds()
 {
-  emit signalGetAllFeeds();
+  emit signalGetAllFeeds(RequestFeed::PriorityScheduled);
+}
+
+/** @brief Update all feeds on start up ahead of update by timer
+ *---------------------------------------------------------------------------*/
+void MainWindow::slotGetAllFeedsStartUp()
+{
+  emit signalGetAllFeeds(RequestFeed::PriorityStartup);
 }
 
 void MainWindow::slotStopUpdate()
@@ -4266,11 +4431,14 @@ void MainWindow::setFeedsFilter(bool clicked)
   if (setFilter) return;
   setFilter = true;
 
+  // Filters by counts need the last received ones
+  applyFeedCounts();
+
   QAction* filterAct = feedsFilterGroup_->checkedAction();
 
   if (filterAct->objectName() == "filterFeedsNew_") {
     QModelIndex index = feedsProxyModel_->mapToSource(feedsView_->currentIndex());
-    int newCount = feedsModel_->dataField(index, "newCount").toInt();
+    int newCount = feedsModel_->dataField(index, FeedsModel::FieldNewCount).toInt();
     if (!(clicked && !newCount)) {
       while (index.isValid()) {
         idList << feedsModel_->idByIndex(index);
@@ -4279,7 +4447,7 @@ void MainWindow::setFeedsFilter(bool clicked)
     }
   } else if (filterAct->objectName() == "filterFeedsUnread_") {
     QModelIndex index = feedsProxyModel_->mapToSource(feedsView_->currentIndex());
-    int unRead = feedsModel_->dataField(index, "unread").toInt();
+    int unRead = feedsModel_->dataField(index, FeedsModel::FieldUnread).toInt();
     if (!(clicked && !unRead)) {
       while (index.isValid()) {
         idList << feedsModel_->idByIndex(index);
@@ -4305,7 +4473,8 @@ void MainWindow::setFeedsFilter(bool clicked)
     }
   } else if (filterAct->objectName() == "filterFeedsError_") {
     QSqlQuery q;
-    q.exec(QString("SELECT id, parentId FROM feeds WHERE status!=0 AND status!=''"));
+    q.exec(QString("SELECT id, parentId FROM feeds WHERE status!=0 AND status!='' "
+                   "AND status NOT LIKE '2 %'"));
     while (q.next()) {
       idList.append(q.value(0).toInt());
       int parentId = q.value(1).toInt();
@@ -4340,15 +4509,15 @@ void MainWindow::setFeedsFilter(bool clicked)
     }
   }
 
-  // Set filter
-  feedsProxyModel_->setFilter(filterAct->objectName(), idList,
-                              findFeeds_->findGroup_->checkedAction()->objectName(),
-                              findFeeds_->text());
-
-  feedsView_->restoreExpanded();
+  // Set filter, rows of changed counters are already filtered by proxy
+  if (feedsProxyModel_->setFilter(filterAct->objectName(), idList,
+                                  findFeeds_->findGroup_->checkedAction()->objectName(),
+                                  findFeeds_->text())) {
+    feedsView_->restoreExpanded();
 
-  feedsView_->clearSelection();
-  feedsView_->setCurrentIndex(feedsView_->currentIndex());
+    feedsView_->clearSelection();
+    feedsView_->setCurrentIndex(feedsView_->currentIndex());
+  }
 
   if (clicked && (tabBar_->currentIndex() == TAB_WIDGET_PERMANENT)) {
     slotFeedClicked(feedsView_->currentIndex());
@@ -4377,7 +4546,7 @@ void MainWindow::setNewsFilter(QAction* pAct, bool clicked)
   QModelIndex index = newsView_->currentIndex();
   int feedId = currentNewsTab->feedId_;
   int newsId = newsModel_->index(
-        index.row(), newsModel_->fieldIndex("id")).data(Qt::EditRole).toInt();
+        index.row(), newsModel_->fieldColumn(NewsModel::FieldId)).data(Qt::EditRole).toInt();
 
   // Hide news has marrked "Read"
   // read=1 - show regardless of filter
@@ -4409,55 +4578,30 @@ void MainWindow::setNewsFilter(QAction* pAct, bool clicked)
   } else if (pAct->objectName() == "filterNewsUnreadStar_") {
     newsFilterStr.append(QString("(read < 2 OR starred = 1) AND deleted = 0"));
   } else if (pAct->objectName() == "filterNewsLastDay_") {
-    newsFilterStr.append(QString("(published >= datetime('now', '-1 day')) AND deleted = 0"));
+    newsFilterStr.append(QString("(published >= strftime('%Y-%m-%dT%H:%M:%S', 'now', '-1 day')) AND deleted = 0"));
   } else if (pAct->objectName() == "filterNewsLastWeek_") {
-    newsFilterStr.append(QString("(published >= datetime('now', '-7 day')) AND deleted = 0"));
+    newsFilterStr.append(QString("(published >= strftime('%Y-%m-%dT%H:%M:%S', 'now', '-7 day')) AND deleted = 0"));
   }
 
   // ... add filter from "search"
   QString filterStr = newsFilterStr;
+  // Archive news are shown in list of all news only
+  QString archiveFilterStr;
+  if (pAct->objectName() == "filterNewsAll_")
+    archiveFilterStr = newsFilterStr;
   QString objectName = currentNewsTab->findText_->findGroup_->checkedAction()->objectName();
   if (objectName != "findInBrowserAct") {
-    QString findText = currentNewsTab->findText_->text();
-    if (!findText.isEmpty()) {
-      findText = findText.replace("'", "''").toUpper();
-      if (objectName == "findTitleAct") {
-        filterStr.append(
-              QString(" AND UPPER(title) LIKE '%%1%'").arg(findText));
-      } else if (objectName == "findAuthorAct") {
-        filterStr.append(
-              QString(" AND UPPER(author_name) LIKE '%%1%'").arg(findText));
-      } else if (objectName == "findCategoryAct") {
-        filterStr.append(
-              QString(" AND UPPER(category) LIKE '%%1%'").arg(findText));
-      } else if (objectName == "findContentAct") {
-        filterStr.append(
-              QString(" AND (UPPER(content) LIKE '%%1%' OR UPPER(description) LIKE '%%1%')").
-              arg(findText));
-      } else if (objectName == "findLinkAct") {
-        filterStr.append(
-              QString(" AND link_href LIKE '%%1%'").
-              arg(findText));
-      } else {
-        filterStr.append(
-              QString(" AND (UPPER(title) LIKE '%%1%' OR UPPER(author_name) LIKE '%%1%' "
-                      "OR UPPER(category) LIKE '%%1%' OR UPPER(content) LIKE '%%1%' "
-                      "OR UPPER(description) LIKE '%%1%')").
-              arg(findText));
-      }
-    }
+    filterStr.append(Database::findNewsFilter(objectName,
+                                              currentNewsTab->findText_->text()));
+    if (!archiveFilterStr.isEmpty())
+      archiveFilterStr.append(Database::findNewsFilter(objectName,
+                                                       currentNewsTab->findText_->text(), true));
   }
 
-  newsModel_->setFilter(filterStr);
+  newsModel_->setFilter(filterStr, archiveFilterStr);
   while (newsModel_->canFetchMore())
     newsModel_->fetchMore();
 
-  if ((currentNewsTab->newsHeader_->sortIndicatorSection() == newsModel_->fieldIndex("read")) ||
-      currentNewsTab->newsHeader_->sortIndicatorSection() == newsModel_->fieldIndex("starred")) {
-    currentNewsTab->slotSort(currentNewsTab->newsHeader_->sortIndicatorSection(),
-                             currentNewsTab->newsHeader_->sortIndicatorOrder());
-  }
-
   currentNewsTab->loadNewspaper();
 
   // Set icon right before user click
@@ -4466,11 +4610,11 @@ void MainWindow::setNewsFilter(QAction* pAct, bool clicked)
 
   // Set focus on previous displayed feed, if user click has been
   if (clicked) {
-    QModelIndex index = newsModel_->index(0, newsModel_->fieldIndex("id"));
+    QModelIndex index = newsModel_->index(0, newsModel_->fieldColumn(NewsModel::FieldId));
     QModelIndexList indexList = newsModel_->match(index, Qt::EditRole, newsId);
     if (indexList.count()) {
       int newsRow = indexList.first().row();
-      newsView_->setCurrentIndex(newsModel_->index(newsRow, newsModel_->fieldIndex("title")));
+      newsView_->setCurrentIndex(newsModel_->index(newsRow, newsModel_->fieldColumn(NewsModel::FieldTitle)));
     } else {
       currentNewsTab->currentNewsIdOld = newsId;
       currentNewsTab->hideWebContent();
@@ -4502,21 +4646,20 @@ void MainWindow::setFeedRead(int type, int feedId, FeedReedType feedReadType,
       emit signalSetFeedRead(feedReadType, feedId, idException, idNewsList);
     }
   } else if (widgetTab) {
+    widgetTab->wakeUp();
     int cnt = widgetTab->newsModel_->rowCount();
     if (cnt == 0) return;
 
     QList<int> idNewsList;
     for (int i = cnt-1; i >= 0; --i) {
-      int newsId = widgetTab->newsModel_->index(i, widgetTab->newsModel_->fieldIndex("id")).data().toInt();
+      int newsId = widgetTab->newsModel_->index(i, widgetTab->newsModel_->fieldColumn(NewsModel::FieldId)).data().toInt();
       idNewsList.append(newsId);
     }
     for (int i = 0; i < stackedWidget_->count(); i++) {
       NewsTabWidget *widget = (NewsTabWidget*)stackedWidget_->widget(i);
       if ((widget->type_ < NewsTabWidget::TabTypeWeb) &&
           !((feedReadType == FeedReadSwitchingFeed) && (i == TAB_WIDGET_PERMANENT))) {
-        int row = widget->newsView_->currentIndex().row();
-        int newsId = widget->newsModel_->index(row, widget->newsModel_->fieldIndex("id")).data().toInt();
-        idNewsList.removeOne(newsId);
+        idNewsList.removeOne(widget->currentNewsId());
       }
     }
     emit signalSetFeedRead(FeedReadSwitchingTab, feedId, idException, idNewsList);
@@ -4539,22 +4682,22 @@ void MainWindow::markFeedRead()
   for (int i = indexList.count()-1; i >= 0; --i) {
     QModelIndex index = feedsProxyModel_->mapToSource(indexList[i]);
     if (feedsModel_->isFolder(index)) {
-      idList.append(feedsModel_->dataField(index, "id").toInt());
+      idList.append(feedsModel_->dataField(index, FeedsModel::FieldId).toInt());
       indexList.removeAt(i);
     }
   }
   for (int i = indexList.count()-1; i >= 0; --i) {
     QModelIndex index = feedsProxyModel_->mapToSource(indexList[i]);
-    int parentId = feedsModel_->dataField(index, "parentId").toInt();
+    int parentId = feedsModel_->dataField(index, FeedsModel::FieldParentId).toInt();
     if (!idList.contains(parentId)) {
-      idList.append(feedsModel_->dataField(index, "id").toInt());
+      idList.append(feedsModel_->dataField(index, FeedsModel::FieldId).toInt());
     }
     indexList.removeAt(i);
   }
   foreach (int id, idList) {
     bool openFeedT = false;
     QModelIndex index = feedsModel_->indexById(id);
-    int parentId = feedsModel_->dataField(index, "parentId").toInt();
+    int parentId = feedsModel_->dataField(index, FeedsModel::FieldParentId).toInt();
     if (currentNewsTab->feedId_ == id) {
       openFeedT = true;
       openFeed = true;
@@ -4579,7 +4722,7 @@ void MainWindow::markFeedRead()
         feedsModel_->setData(indexNew, 0);
 
         if (!openFeed) {
-          int parentId1 = feedsModel_->dataField(index1, "parentId").toInt();
+          int parentId1 = feedsModel_->dataField(index1, FeedsModel::FieldParentId).toInt();
           if ((currentNewsTab->feedId_ == id1) || (currentNewsTab->feedId_ == parentId1)) {
             openFeed = true;
           }
@@ -4635,7 +4778,7 @@ void MainWindow::slotRefreshNewsView(int nextUnread)
 
     currentNewsTab->loadNewspaper(NewsTabWidget::RefreshWithPos);
 
-    newsView_->setCurrentIndex(newsModel_->index(currentRow, newsModel_->fieldIndex("title")));
+    newsView_->setCurrentIndex(newsModel_->index(currentRow, newsModel_->fieldColumn(NewsModel::FieldTitle)));
   }
 }
 
@@ -4729,6 +4872,12 @@ void MainWindow::restoreFeedsOnStartUp()
     Settings settings;
     int feedId = settings.value("feedSettings/currentId", 0).toInt();
     feedIndex = feedsProxyModel_->mapFromSource(feedId);
+    // Feed inside folder is selected when feeds tree is loaded
+    if (!feedIndex.isValid() && feedsModel_->isLoading()) {
+      restoreFeedId_ = feedId;
+      connect(feedsModel_, SIGNAL(signalFeedsLoaded()),
+              this, SLOT(slotFeedsLoaded()), Qt::UniqueConnection);
+    }
   }
   feedsView_->setCurrentIndex(feedIndex);
   updateCurrentTab_ = false;
@@ -4739,12 +4888,57 @@ void MainWindow::restoreFeedsOnStartUp()
   slotUpdateStatus(-1, false);
   recountCategoryCounts();
 
-  // Open feeds in tabs
-  QSqlQuery q;
-  q.exec(QString("SELECT id, parentId FROM feeds WHERE displayOnStartup=1"));
-  while (q.next()) {
-    creatFeedTab(q.value(0).toInt(), q.value(1).toInt());
+  // Open feeds in tabs one by one from event loop
+  mainApp->asyncQuery()->exec("SELECT id, parentId FROM feeds WHERE displayOnStartup=1",
+                              QVariantList(), this, "slotStartupTabsLoaded");
+}
+
+/** @brief Queue feeds displayed on startup for opening in tabs
+ *---------------------------------------------------------------------------*/
+void MainWindow::slotStartupTabsLoaded(AsyncQueryResult result)
+{
+  foreach (const QVariantList &row, result.rows) {
+    startupTabs_.append(qMakePair(row.at(0).toInt(), row.at(1).toInt()));
+  }
+  if (!startupTabs_.isEmpty())
+    QTimer::singleShot(0, this, SLOT(slotOpenStartupTab()));
+}
+
+/** @brief Select feed saved as current when feeds tree is loaded
+ *---------------------------------------------------------------------------*/
+void MainWindow::slotFeedsLoaded()
+{
+  int feedId = restoreFeedId_;
+  restoreFeedId_ = 0;
+
+  // User has already selected other feed
+  if (!feedId || feedsView_->currentIndex().isValid() ||
+      (stackedWidget_->currentIndex() != TAB_WIDGET_PERMANENT)) {
+    return;
   }
+
+  QModelIndex feedIndex = feedsProxyModel_->mapFromSource(feedId);
+  if (!feedIndex.isValid())
+    return;
+
+  feedsView_->setCurrentIndex(feedIndex);
+  updateCurrentTab_ = false;
+  slotFeedClicked(feedIndex);
+  updateCurrentTab_ = true;
+}
+
+/** @brief Open next feed tab restored on startup
+ *---------------------------------------------------------------------------*/
+void MainWindow::slotOpenStartupTab()
+{
+  if (startupTabs_.isEmpty() || mainApp->isClosing())
+    return;
+
+  QPair<int,int> tab = startupTabs_.takeFirst();
+  creatFeedTab(tab.first, tab.second);
+
+  if (!startupTabs_.isEmpty())
+    QTimer::singleShot(0, this, SLOT(slotOpenStartupTab()));
 }
 // ----------------------------------------------------------------------------
 void MainWindow::slotFeedsFilter()
@@ -4839,6 +5033,7 @@ void MainWindow::retranslateStrings()
       QString(tr("New News: %1")).arg(str.section(": ", 1).section("\n", 0, 0)) +
       QString("\n") +
       QString(tr("Unread News: %1")).arg(str.section(": ", 2));
+  trayToolTip_ = info;
   traySystem->setToolTip(info);
 
   mainMenuButton_->setToolTip(tr("Menu"));
@@ -4864,6 +5059,8 @@ void MainWindow::retranslateStrings()
 
   exportFeedsAct_->setText(tr("&Export Feeds..."));
   exportFeedsAct_->setToolTip(tr("Export Feeds to OPML File"));
+  exportNewsAct_->setText(tr("Export &News..."));
+  exportNewsAct_->setToolTip(tr("Export News of List to JSON, Mailbox or HTML File"));
 
   createBackupAct_->setText(tr("&Create Backup..."));
   showMenuBarAct_->setText(tr("S&how Menu Bar"));
@@ -4891,6 +5088,8 @@ void MainWindow::retranslateStrings()
 
   showCleanUpWizardAct_->setText(tr("Clean Up..."));
 
+  showPipelineMetricsAct_->setText(tr("Performance..."));
+
   setNewsFiltersAct_->setText(tr("News Filters..."));
   setFilterNewsAct_->setText(tr("Filter News..."));
 
@@ -4968,6 +5167,7 @@ void MainWindow::retranslateStrings()
   layoutMenu_->setTitle(tr("Layout"));
   classicLayoutAct_->setText(tr("Classic"));
   newspaperLayoutAct_->setText(tr("Newspaper"));
+  clusteredLayoutAct_->setText(tr("Clustered"));
   layoutToggle_->setText(tr("Layout"));
 
   styleMenu_->setTitle(tr("Application Style"));
@@ -5075,6 +5275,7 @@ void MainWindow::retranslateStrings()
   categoriesTree_->topLevelItem(CategoriesTreeWidget::StarredItem)->setText(0, tr("Starred"));
   categoriesTree_->topLevelItem(CategoriesTreeWidget::DeletedItem)->setText(0, tr("Deleted"));
   categoriesTree_->topLevelItem(CategoriesTreeWidget::LabelsItem)->setText(0, tr("Labels"));
+  categoriesTree_->topLevelItem(CategoriesTreeWidget::SearchItem)->setText(0, tr("Search"));
 
   reduceNewsListAct_->setText(tr("Decrease news list/increase browser"));
   increaseNewsListAct_->setText(tr("Increase news list/decrease browser"));
@@ -5163,7 +5364,8 @@ void MainWindow::retranslateStrings()
     currentNewsTab->retranslateStrings();
   }
   findFeeds_->retranslateStrings();
-  mainApp->downloadManager()->retranslateStrings();
+  if (mainApp->hasDownloadManager())
+    mainApp->downloadManager()->retranslateStrings();
   adblockIcon_->retranslateStrings();
   QApplication::translate("AdBlockCustomList", "Custom Rules");
 
@@ -5249,7 +5451,7 @@ void MainWindow::showFeedPropertiesDlg()
   FEED_PROPERTIES properties;
   FEED_PROPERTIES properties_tmp;
 
-  QByteArray byteArray = feedsModel_->dataField(index, "image").toByteArray();
+  QByteArray byteArray = feedsModel_->dataField(index, FeedsModel::FieldImage).toByteArray();
   if (!byteArray.isNull()) {
     QPixmap icon;
     icon.loadFromData(QByteArray::fromBase64(byteArray));
@@ -5263,16 +5465,16 @@ void MainWindow::showFeedPropertiesDlg()
 
   QString str(feedPropertiesDialog->windowTitle() +
               " '" +
-              feedsModel_->dataField(index, "text").toString() +
+              feedsModel_->dataField(index, FeedsModel::FieldText).toString() +
               "'");
   feedPropertiesDialog->setWindowTitle(str);
 
   properties.general.text =
-      feedsModel_->dataField(index, "text").toString();
+      feedsModel_->dataField(index, FeedsModel::FieldText).toString();
   properties.general.title =
       feedsModel_->dataField(index, "title").toString();
   properties.general.url =
-      feedsModel_->dataField(index, "xmlUrl").toString();
+      feedsModel_->dataField(index, FeedsModel::FieldXmlUrl).toString();
   properties.general.homepage =
       feedsModel_->dataField(index, "htmlUrl").toString();
   properties.general.displayOnStartup =
@@ -5290,7 +5492,7 @@ void MainWindow::showFeedPropertiesDlg()
       feedsModel_->dataField(index, "layoutDirection").toInt();
 
   properties.general.disableUpdate =
-      feedsModel_->dataField(index, "disableUpdate").toBool();
+      feedsModel_->dataField(index, FeedsModel::FieldDisableUpdate).toBool();
 
   if (feedsModel_->dataField(index, "updateIntervalEnable").isNull() ||
       (feedsModel_->dataField(index, "updateIntervalEnable").toInt() == -1)) {
@@ -5313,6 +5515,8 @@ void MainWindow::showFeedPropertiesDlg()
 
   properties.general.duplicateNewsMode =
       feedsModel_->dataField(index, "duplicateNewsMode").toBool();
+  properties.general.downloadEnclosures =
+      feedsModel_->dataField(index, "downloadEnclosures").toBool();
 
   properties.general.addSingleNewsAnyDateOn =
       feedsModel_->dataField(index, "addSingleNewsAnyDateOn").toBool();
@@ -5331,7 +5535,7 @@ void MainWindow::showFeedPropertiesDlg()
     properties.columnDefault.columns.append(indexStr.toInt());
   }
   NewsTabWidget *widget = (NewsTabWidget*)stackedWidget_->widget(TAB_WIDGET_PERMANENT);
-  int sortBy = settings.value("sortBy", widget->newsModel_->fieldIndex("published")).toInt();
+  int sortBy = settings.value("sortBy", widget->newsModel_->fieldColumn(NewsModel::FieldPublished)).toInt();
   properties.columnDefault.sortBy = sortBy;
   int sortType = settings.value("sortOrder", Qt::DescendingOrder).toInt();
   properties.columnDefault.sortType = sortType;
@@ -5375,7 +5579,7 @@ void MainWindow::showFeedPropertiesDlg()
   if (feedsModel_->dataField(index, "authentication").toInt() == 1) {
     properties.authentication.on = true;
   }
-  QUrl url(feedsModel_->dataField(index, "xmlUrl").toString());
+  QUrl url(feedsModel_->dataField(index, FeedsModel::FieldXmlUrl).toString());
   QSqlQuery q;
   q.prepare("SELECT username, password FROM passwords WHERE server=?");
   q.addBindValue(url.host());
@@ -5385,7 +5589,12 @@ void MainWindow::showFeedPropertiesDlg()
     properties.authentication.pass = QString::fromUtf8(QByteArray::fromBase64(q.value(1).toByteArray()));
   }
 
-  properties.status.feedStatus = feedsModel_->dataField(index, "status").toString();
+  q.prepare("SELECT value FROM feeds_ex WHERE feedId=? AND name='costDemotionDisabled'");
+  q.addBindValue(feedId);
+  q.exec();
+  properties.general.costDemotion = !q.next();
+
+  properties.status.feedStatus = feedsModel_->dataField(index, FeedsModel::FieldStatus).toString();
 
   QDateTime dtLocalTime = QDateTime::currentDateTime();
   QDateTime dtUTC = QDateTime(dtLocalTime.date(), dtLocalTime.time(), Qt::UTC);
@@ -5397,7 +5606,7 @@ void MainWindow::showFeedPropertiesDlg()
   properties.status.createdTime = dt.addSecs(nTimeShift);
 
   dt = QDateTime::fromString(
-        feedsModel_->dataField(index, "updated").toString(),
+        feedsModel_->dataField(index, FeedsModel::FieldUpdated).toString(),
         Qt::ISODate);
   properties.status.lastUpdate = dt.addSecs(nTimeShift);
 
@@ -5406,26 +5615,21 @@ void MainWindow::showFeedPropertiesDlg()
         Qt::ISODate);
   properties.status.lastBuildDate = dt.addSecs(nTimeShift);
 
-  properties.status.undeleteCount = feedsModel_->dataField(index, "undeleteCount").toInt();
-  properties.status.newCount      = feedsModel_->dataField(index, "newCount").toInt();
-  properties.status.unreadCount   = feedsModel_->dataField(index, "unread").toInt();
+  properties.status.undeleteCount = feedsModel_->dataField(index, FeedsModel::FieldUndeleteCount).toInt();
+  properties.status.newCount      = feedsModel_->dataField(index, FeedsModel::FieldNewCount).toInt();
+  properties.status.unreadCount   = feedsModel_->dataField(index, FeedsModel::FieldUnread).toInt();
   properties.status.description   = feedsModel_->dataField(index, "description").toString();
 
+  properties.status.feedId = feedId;
   properties.status.feedsCount = 0;
   if (!isFeed) {
-    QQueue<int> parentIds;
-    parentIds.enqueue(feedId);
-    while (!parentIds.empty()) {
-      int parentId = parentIds.dequeue();
-      q.exec(QString("SELECT id, xmlUrl FROM feeds WHERE parentId='%1'").arg(parentId));
-      while (q.next()) {
-        QString xmlUrl = q.value(1).toString();
-        if (xmlUrl.isEmpty())
-          parentIds.enqueue(q.value(0).toInt());
-        else
-          properties.status.feedsCount++;
-      }
-    }
+    // Feeds of folder are counted in update thread while dialog is shown
+    properties.status.feedsCount = -1;
+    UpdateObject *updateObject = mainApp->updateFeeds()->updateObject_;
+    connect(updateObject, SIGNAL(signalFeedsCount(int,int)),
+            feedPropertiesDialog, SLOT(slotFeedsCount(int,int)));
+    QMetaObject::invokeMethod(updateObject, "slotFeedsCount", Qt::QueuedConnection,
+                              Q_ARG(int, feedId));
   }
 
   feedPropertiesDialog->setFeedProperties(properties);
@@ -5449,7 +5653,7 @@ void MainWindow::showFeedPropertiesDlg()
             "displayEmbeddedImages = ?, displayNews = ?, layoutDirection = ?, "
             "label = ?, duplicateNewsMode = ?, addSingleNewsAnyDateOn = ?, avoidedOldSingleNewsDateOn = ?, avoidedOldSingleNewsDate = ?,"
             " authentication = ?, disableUpdate = ?, "
-            "javaScriptEnable = ? WHERE id == ?");
+            "javaScriptEnable = ?, downloadEnclosures = ? WHERE id == ?");
   q.addBindValue(properties.general.text);
   q.addBindValue(properties.general.url);
   q.addBindValue(properties.general.displayOnStartup);
@@ -5467,9 +5671,16 @@ void MainWindow::showFeedPropertiesDlg()
   q.addBindValue(properties.authentication.on ? 1 : 0);
   q.addBindValue(properties.general.disableUpdate ? 1 : 0);
   q.addBindValue(properties.display.javaScriptEnable);
+  q.addBindValue(properties.general.downloadEnclosures ? 1 : 0);
   q.addBindValue(feedId);
   q.exec();
 
+  // Demotion state is owned by update thread
+  if (isFeed && (properties.general.costDemotion != properties_tmp.general.costDemotion)) {
+    QMetaObject::invokeMethod(mainApp->updateFeeds()->updateObject_, "slotCostDemotion",
+                              Qt::QueuedConnection, Q_ARG(int, feedId),
+                              Q_ARG(bool, properties.general.costDemotion));
+  }
 
   indexColumnsStr = "";
   if ((properties.column.columns != properties.columnDefault.columns) ||
@@ -5574,6 +5785,7 @@ void MainWindow::showFeedPropertiesDlg()
   QModelIndex indexAuthentication = feedsModel_->indexSibling(index, "authentication");
   QModelIndex indexDisableUpdate = feedsModel_->indexSibling(index, "disableUpdate");
   QModelIndex indexJavaScript = feedsModel_->indexSibling(index, "javaScriptEnable");
+  QModelIndex indexEnclosures = feedsModel_->indexSibling(index, "downloadEnclosures");
   feedsModel_->setData(indexText, properties.general.text);
   feedsModel_->setData(indexUrl, properties.general.url);
   feedsModel_->setData(indexStartup, properties.general.displayOnStartup);
@@ -5588,6 +5800,7 @@ void MainWindow::showFeedPropertiesDlg()
   feedsModel_->setData(indexAuthentication, properties.authentication.on ? 1 : 0);
   feedsModel_->setData(indexDisableUpdate, properties.general.disableUpdate ? 1 : 0);
   feedsModel_->setData(indexJavaScript, properties.display.javaScriptEnable);
+  feedsModel_->setData(indexEnclosures, properties.general.downloadEnclosures ? 1 : 0);
 
   if (!properties.general.updateEnable ||
       (properties.general.updateEnable != updateFeedsEnable_) ||
@@ -5678,9 +5891,9 @@ void MainWindow::showFeedPropertiesDlg()
   }
 
   if (properties.general.image != properties_tmp.general.image) {
-    q.prepare("UPDATE feeds SET image = ? WHERE id == ?");
-    q.addBindValue(properties.general.image.toBase64());
+    q.prepare("INSERT OR REPLACE INTO feedsIcons(feedId, image) VALUES (?, ?)");
     q.addBindValue(feedId);
+    q.addBindValue(properties.general.image.toBase64());
     q.exec();
     slotIconFeedUpdate(feedId, properties.general.image);
   }
@@ -5764,6 +5977,9 @@ void MainWindow::showFeedPropertiesDlg()
 }
 
 /** @brief Update tray information: icon and tooltip text
+ *
+ * Tray is changed only when shown text differs, icons with numbers are
+ * rendered once for each number.
  *---------------------------------------------------------------------------*/
 void MainWindow::slotRefreshInfoTray(int newCount, int unreadCount)
 {
@@ -5786,31 +6002,44 @@ void MainWindow::slotRefreshInfoTray(int newCount, int unreadCount)
       QString(tr("New News: %1")).arg(newCount) +
       QString("\n") +
       QString(tr("Unread News: %1")).arg(unreadCount);
-  traySystem->setToolTip(info);
+  if (info != trayToolTip_) {
+    trayToolTip_ = info;
+    traySystem->setToolTip(info);
+  }
 
   // Display new number or unread number of news
   if (behaviorIconTray_ > CHANGE_ICON_TRAY) {
     int trayCount = (behaviorIconTray_ == UNREAD_COUNT_ICON_TRAY) ? unreadCount : newCount;
-    // Display icon with number
-    if (trayCount != 0) {
-      // Prepare number
-      QString trayCountStr;
-      QFont font("Consolas");
-      if (trayCount > 99) {
-        font.setBold(false);
-        if (trayCount < 1000) {
-          font.setPixelSize(60);
-          trayCountStr = QString::number(trayCount);
-        } else {
-          font.setPixelSize(86);
-          trayCountStr = "#";
-        }
-      } else {
-        font.setBold(true);
-        font.setPixelSize(90);
+    // Prepare number, empty for icon without number
+    QString trayCountStr;
+    QFont font("Consolas");
+    if (trayCount > 99) {
+      font.setBold(false);
+      if (trayCount < 1000) {
+        font.setPixelSize(60);
         trayCountStr = QString::number(trayCount);
+      } else {
+        font.setPixelSize(86);
+        trayCountStr = "#";
       }
+    } else if (trayCount != 0) {
+      font.setBold(true);
+      font.setPixelSize(90);
+      trayCountStr = QString::number(trayCount);
+    } else {
+      trayCountStr = "";
+    }
 
+    if (!trayIconText_.isNull() && (trayCountStr == trayIconText_))
+      return;
+    trayIconText_ = trayCountStr;
+
+    QIcon *cachedIcon = trayIcons_.object(trayCountStr);
+    if (cachedIcon) {
+      traySystem->setIcon(*cachedIcon);
+    }
+    // Display icon with number
+    else if (trayCount != 0) {
       // Draw icon, text above it, and set this icon to tray icon
       QPixmap icon(128, 128);
       icon.fill(Qt::transparent);
@@ -5831,6 +6060,7 @@ void MainWindow::slotRefreshInfoTray(int newCount, int unreadCount)
       trayPainter.drawText(rectangle, Qt::AlignVCenter | Qt::AlignHCenter,
                            trayCountStr);
       trayPainter.end();
+      trayIcons_.insert(trayCountStr, new QIcon(icon));
       traySystem->setIcon(icon);
     }
     // Draw icon without number
@@ -5840,52 +6070,41 @@ void MainWindow::slotRefreshInfoTray(int newCount, int unreadCount)
   }
 }
 
-/** @brief Prepare feed icon for storing in DB
+/** @brief Update feed icon in model and view
  *---------------------------------------------------------------------------*/
-void MainWindow::slotIconFeedPreparing(QString feedUrl, QByteArray byteArray,
-                                       QString format)
+void MainWindow::slotIconFeedUpdate(int feedId, QByteArray faviconData)
 {
-  QPixmap icon;
-  if (icon.loadFromData(byteArray)) {
-    icon = icon.scaled(16, 16, Qt::IgnoreAspectRatio,
-                       Qt::SmoothTransformation);
-    QByteArray faviconData;
-    QBuffer    buffer(&faviconData);
-    buffer.open(QIODevice::WriteOnly);
-    if (icon.save(&buffer, "ICO")) {
-      emit signalIconFeedReady(feedUrl, faviconData);
-    }
-  } else if (icon.loadFromData(byteArray, format.toUtf8().data())) {
-    icon = icon.scaled(16, 16, Qt::IgnoreAspectRatio,
-                       Qt::SmoothTransformation);
-    QByteArray faviconData;
-    QBuffer    buffer(&faviconData);
-    buffer.open(QIODevice::WriteOnly);
-    if (icon.save(&buffer, "ICO")) {
-      emit signalIconFeedReady(feedUrl, faviconData);
-    }
-  }
+  slotIconsFeedUpdate(QList<int>() << feedId, QList<QByteArray>() << faviconData);
 }
 
-/** @brief Update feed icon in model and view
+/** @brief Update icons of several feeds with one repaint of views
  *---------------------------------------------------------------------------*/
-void MainWindow::slotIconFeedUpdate(int feedId, QByteArray faviconData)
-{
-  QModelIndex index = feedsModel_->indexById(feedId);
-  if (index.isValid()) {
+void MainWindow::slotIconsFeedUpdate(QList<int> feedIds, QList<QByteArray> faviconsData)
+{
+  // Feeds sharing icon get the same encoded data
+  QHash<QByteArray, QByteArray> encodedIcons;
+  for (int i = 0; i < feedIds.count(); ++i) {
+    QModelIndex index = feedsModel_->indexById(feedIds.at(i));
+    if (!index.isValid()) continue;
+
+    const QByteArray &faviconData = faviconsData.at(i);
+    QHash<QByteArray, QByteArray>::iterator it = encodedIcons.find(faviconData);
+    if (it == encodedIcons.end())
+      it = encodedIcons.insert(faviconData, faviconData.toBase64());
     QModelIndex indexImage = feedsModel_->indexSibling(index, "image");
-    feedsModel_->setData(indexImage, faviconData.toBase64());
-    feedsView_->viewport()->update();
+    feedsModel_->setData(indexImage, it.value());
   }
+  feedsView_->viewport()->update();
 
   if (defaultIconFeeds_) return;
 
   for (int i = 0; i < stackedWidget_->count(); i++) {
     NewsTabWidget *widget = (NewsTabWidget*)stackedWidget_->widget(i);
-    if (widget->feedId_ == feedId) {
+    int pos = feedIds.lastIndexOf(widget->feedId_);
+    if (pos != -1) {
       QPixmap iconTab;
-      if (!faviconData.isNull()) {
-        iconTab.loadFromData(faviconData);
+      if (!faviconsData.at(pos).isNull()) {
+        iconTab.loadFromData(faviconsData.at(pos));
       } else {
         iconTab.load(":/images/feed");
       }
@@ -5898,100 +6117,8 @@ void MainWindow::slotIconFeedUpdate(int feedId, QByteArray faviconData)
 // ----------------------------------------------------------------------------
 void MainWindow::slotPlaySound(const QString &path)
 {
-  QString soundPath = mainApp->absolutePath(path);
-
-  if (!QFile::exists(soundPath)) {
-    qWarning() << QString("Error playing sound: %1").arg(soundPath);
-    return;
-  }
-
-  bool playing = false;
-  Settings settings;
-  bool useMediaPlayer = settings.value("Settings/useMediaPlayer", true).toBool();
-
-  if (useMediaPlayer) {
-#ifdef HAVE_QT5
-    if (mediaPlayer_ == NULL) {
-      playlist_ = new QMediaPlaylist(this);
-      mediaPlayer_ = new QMediaPlayer(this);
-      mediaPlayer_->setPlaylist(playlist_);
-      connect(mediaPlayer_, SIGNAL(mediaStatusChanged(QMediaPlayer::MediaStatus)),
-              this, SLOT(mediaStatusChanged(QMediaPlayer::MediaStatus)));
-      connect(mediaPlayer_, SIGNAL(error(QMediaPlayer::Error)),
-              this, SLOT(mediaError(QMediaPlayer::Error)));
-    }
-
-    playlist_->addMedia(QUrl::fromLocalFile(soundPath));
-    if (playlist_->currentIndex() == -1) {
-      playlist_->setCurrentIndex(1);
-      mediaPlayer_->play();
-    }
-
-    playing = true;
-#else
-#ifdef HAVE_PHONON
-    if (mediaPlayer_ == NULL) {
-      mediaPlayer_ = new Phonon::MediaObject(this);
-      audioOutput_ = new Phonon::AudioOutput(Phonon::MusicCategory, this);
-      Phonon::createPath(mediaPlayer_, audioOutput_);
-      connect(mediaPlayer_, SIGNAL(stateChanged(Phonon::State,Phonon::State)),
-              this, SLOT(mediaStateChanged(Phonon::State,Phonon::State)));
-    }
-
-    if (mediaPlayer_->state() == Phonon::ErrorState)
-      mediaPlayer_->clear();
-
-    if ((mediaPlayer_->state() != Phonon::PausedState) &&
-        (mediaPlayer_->state() != Phonon::StoppedState)) {
-      mediaPlayer_->enqueue(soundPath);
-    }
-    else {
-      mediaPlayer_->setCurrentSource(soundPath);
-    }
-    mediaPlayer_->play();
-
-    playing = true;
-#endif
-#endif
-  }
-
-  if (!playing) {
-#if defined(Q_OS_WIN) || defined(Q_OS_OS2)
-    QSound::play(soundPath);
-#else
-    QProcess::startDetached(QString("play %1").arg(soundPath));
-#endif
-  }
-}
-
-#ifdef HAVE_QT5
-void MainWindow::mediaStatusChanged(QMediaPlayer::MediaStatus status)
-{
-  if (status == QMediaPlayer::EndOfMedia) {
-    playlist_->removeMedia(0);
-  }
-}
-
-void MainWindow::mediaError(QMediaPlayer::Error error)
-{
-  QTextCodec *codec = QTextCodec::codecForLocale();
-  qCritical() << QString("Error Media: %1 - %2").
-                 arg(error).
-                 arg(codec->toUnicode(mediaPlayer_->errorString().toUtf8()));
-}
-#endif
-
-#ifdef HAVE_PHONON
-void MainWindow::mediaStateChanged(Phonon::State newstate, Phonon::State)
-{
-  if (newstate == Phonon::ErrorState) {
-    QTextCodec *codec = QTextCodec::codecForLocale();
-    qCritical() << QString("Error Phonon: %1 - %2").
-                   arg(mediaPlayer_->errorType()).
-                   arg(codec->toUnicode(mediaPlayer_->errorString().toUtf8()));
-  }
+  soundPool_->play(path);
 }
-#endif
 
 void MainWindow::slotPlaySoundNewNews()
 {
@@ -6014,6 +6141,31 @@ void MainWindow::showNewsFiltersDlg(bool newFilter)
   newsFiltersDialog->exec();
 
   delete newsFiltersDialog;
+
+  mainApp->reloadUserFilters();
+}
+
+/** @brief Show progress of applying filters to stored news
+ *---------------------------------------------------------------------------*/
+void MainWindow::slotUserFilterProgress(int processed, int total)
+{
+  if (total <= 0) {
+    statusBar()->clearMessage();
+    return;
+  }
+  statusBar()->showMessage(tr("Applying filters: %1%").
+                           arg(qMin(100, processed * 100 / total)), 3000);
+}
+
+/** @brief Refresh news and counts of feed after filters are applied
+ *---------------------------------------------------------------------------*/
+void MainWindow::slotUserFilterFinished(int feedId)
+{
+  NewsTabWidget *widget = qobject_cast<NewsTabWidget*>(stackedWidget_->currentWidget());
+  if (widget && (widget->feedId_ == feedId))
+    slotUpdateNews(NewsTabWidget::RefreshAll);
+  slotUpdateStatus(feedId);
+  recountCategoryCounts();
 }
 // ----------------------------------------------------------------------------
 void MainWindow::showFilterRulesDlg()
@@ -6026,7 +6178,7 @@ void MainWindow::showFilterRulesDlg()
         this, -1, feedId);
 
   QModelIndex index = feedsModel_->indexById(feedId);
-  QString text = feedsModel_->dataField(index, "text").toString();
+  QString text = feedsModel_->dataField(index, FeedsModel::FieldText).toString();
   filterRulesDialog->filterName_->setText(QString("'%1'").arg(text));
 
   int result = filterRulesDialog->exec();
@@ -6194,6 +6346,7 @@ void MainWindow::setStyleApp(QAction *pAct)
   Settings settings;
 
   settings.setValue("Settings/styleApplication", pAct->objectName());
+  Settings::publishSnapshot();
 
   QString fileName(mainApp->resourcesDir());
   if (pAct->objectName() == "systemStyle_") {
@@ -6341,8 +6494,8 @@ void MainWindow::slotOpenFeedNewTab()
 
   foreach (QModelIndex indexProxy, indexList) {
     QModelIndex index = feedsProxyModel_->mapToSource(indexProxy);
-    creatFeedTab(feedsModel_->dataField(index, "id").toInt(),
-                 feedsModel_->dataField(index, "parentId").toInt());
+    creatFeedTab(feedsModel_->dataField(index, FeedsModel::FieldId).toInt(),
+                 feedsModel_->dataField(index, FeedsModel::FieldParentId).toInt());
   }
 }
 
@@ -6376,6 +6529,9 @@ void MainWindow::slotTabCurrentChanged(int index)
   if (tabBar_->closingTabState_ == TabBar::CloseTabOtherIndex) return;
 
   NewsTabWidget *widget = (NewsTabWidget*)stackedWidget_->widget(index);
+  if (currentNewsTab && (currentNewsTab != widget))
+    currentNewsTab->startIdle();
+  widget->wakeUp();
 
   if ((widget->type_ == NewsTabWidget::TabTypeFeed) || (widget->type_ >= NewsTabWidget::TabTypeWeb))
     categoriesTree_->setCurrentIndex(QModelIndex());
@@ -6509,6 +6665,10 @@ void MainWindow::setNewsLayout(QAction *action)
     layoutToggle_->setIcon(QIcon(":/images/layout_classic"));
   }
   currentNewsTab->setNewsLayout();
+
+  // Grouping of identical news by parse follows layout
+  Settings settings;
+  settings.setValue("Settings/newsLayout", newsLayout_);
 }
 
 void MainWindow::setNewsLayout()
@@ -6557,7 +6717,8 @@ QWebPage *MainWindow::createWebTab(QUrl url)
 void MainWindow::creatFeedTab(int feedId, int feedParId)
 {
   QSqlQuery q;
-  q.exec(QString("SELECT text, image, currentNews, xmlUrl FROM feeds WHERE id=='%1'").
+  q.exec(QString("SELECT text, (SELECT image FROM feedsIcons WHERE feedId=feeds.id), "
+                 "currentNews, xmlUrl FROM feeds WHERE id=='%1'").
          arg(feedId));
 
   if (q.next()) {
@@ -6587,7 +6748,7 @@ void MainWindow::creatFeedTab(int feedId, int feedParId)
     widget->setTextTab(q.value(0).toString());
 
     QString feedIdFilter;
-    if (feedsModel_->isFolder(feedsModel_->indexById(feedId))) {
+    if (!isFeed) {
       feedIdFilter = QString("(%1) AND ").arg(getIdFeedsString(feedId));
     } else {
       feedIdFilter = QString("feedId=%1 AND ").arg(feedId);
@@ -6606,9 +6767,9 @@ void MainWindow::creatFeedTab(int feedId, int feedParId)
     } else if (newsFilterGroup_->checkedAction()->objectName() == "filterNewsUnreadStar_") {
       feedIdFilter.append(QString("(read < 2 OR starred = 1) AND deleted = 0"));
     } else if (newsFilterGroup_->checkedAction()->objectName() == "filterNewsLastDay_") {
-      feedIdFilter.append(QString("(published >= datetime('now', '-1 day')) AND deleted = 0"));
+      feedIdFilter.append(QString("(published >= strftime('%Y-%m-%dT%H:%M:%S', 'now', '-1 day')) AND deleted = 0"));
     } else if (newsFilterGroup_->checkedAction()->objectName() == "filterNewsLastWeek_") {
-      feedIdFilter.append(QString("(published >= datetime('now', '-7 day')) AND deleted = 0"));
+      feedIdFilter.append(QString("(published >= strftime('%Y-%m-%dT%H:%M:%S', 'now', '-7 day')) AND deleted = 0"));
     }
     widget->newsModel_->setFilter(feedIdFilter);
 
@@ -6621,20 +6782,20 @@ void MainWindow::creatFeedTab(int feedId, int feedParId)
 
     // focus feed has displayed before
     int newsRow = -1;
-    int newsId = widget->newsModel_->index(newsRow, widget->newsModel_->fieldIndex("id")).data(Qt::EditRole).toInt();
+    int newsId = widget->newsModel_->index(newsRow, widget->newsModel_->fieldColumn(NewsModel::FieldId)).data(Qt::EditRole).toInt();
     if (openingFeedAction_ == 0) {
-      QModelIndex index = newsModel_->index(0, newsModel_->fieldIndex("id"));
+      QModelIndex index = newsModel_->index(0, newsModel_->fieldColumn(NewsModel::FieldId));
       QModelIndexList indexList = newsModel_->match(index, Qt::EditRole, newsId);
       if (indexList.count()) newsRow = indexList.first().row();
     } else if (openingFeedAction_ == 1) newsRow = 0;
 
-    widget->newsView_->setCurrentIndex(widget->newsModel_->index(newsRow, widget->newsModel_->fieldIndex("title")));
+    widget->newsView_->setCurrentIndex(widget->newsModel_->index(newsRow, widget->newsModel_->fieldColumn(NewsModel::FieldTitle)));
     if (newsRow == -1) widget->newsView_->verticalScrollBar()->setValue(newsRow);
 
     if ((openingFeedAction_ < 2) && openNewsWebViewOn_) {
-      widget->slotNewsViewSelected(widget->newsModel_->index(newsRow, widget->newsModel_->fieldIndex("title")));
+      widget->slotNewsViewSelected(widget->newsModel_->index(newsRow, widget->newsModel_->fieldColumn(NewsModel::FieldTitle)));
     } else {
-      widget->slotNewsViewSelected(widget->newsModel_->index(-1, widget->newsModel_->fieldIndex("title")));
+      widget->slotNewsViewSelected(widget->newsModel_->index(-1, widget->newsModel_->fieldColumn(NewsModel::FieldTitle)));
       QSqlQuery q;
       QString qStr = QString("UPDATE feeds SET currentNews='%1' WHERE id=='%2'").
           arg(newsId).arg(feedId);
@@ -6837,8 +6998,25 @@ void MainWindow::showNotification(bool bShowRecentNews/*=false*/)
     delete notificationWidget;
   }
 
-  notificationWidget = new NotificationWidget(curNews.idFeedList_, curNews.cntNewsList_,
-                                              idColorList_, colorList_, this);
+  // Data of new news was loaded by parse object with news
+  QList<NotificationFeedStruct> feedsList;
+  for (int i = 0; i < curNews.idFeedList_.count(); ++i) {
+    int feedId = curNews.idFeedList_.at(i);
+    QModelIndex index = feedsModel_->indexById(feedId);
+    if (!notificationData_.contains(feedId) ||
+        !feedsModel_->dataField(index, FeedsModel::FieldNewCount).toInt())
+      continue;
+    NotificationFeedStruct data = notificationData_.value(feedId);
+    data.newCount = curNews.cntNewsList_.at(i);
+    data.news = data.news.mid(0, data.newCount);
+    feedsList.append(data);
+  }
+  if (feedsList.isEmpty()) {
+    clearNotification();
+    return;
+  }
+
+  notificationWidget = new NotificationWidget(feedsList, idColorList_, colorList_, this);
 
   if (!bShowRecentNews)
   {
@@ -6882,6 +7060,7 @@ void MainWindow::clearNotification(bool bClearRecentNews/*=false*/)
 
     idColorList_.clear();
     colorList_.clear();
+    notificationData_.clear();
   }
 }
 
@@ -6894,6 +7073,11 @@ void MainWindow::slotAddColorList(int id, const QString &color)
   }
 }
 
+void MainWindow::slotNotificationData(const NotificationFeedStruct &data)
+{
+  notificationData_.insert(data.feedId, data);
+}
+
 /** @brief Show news on click in notification window
  *---------------------------------------------------------------------------*/
 void MainWindow::slotOpenNew(int feedId, int newsId)
@@ -6972,24 +7156,24 @@ void MainWindow::slotMarkReadNewsInNotification(int feedId, int newsId, int read
   if (currentNewsTab->type_ < NewsTabWidget::TabTypeWeb) {
     int cnt = newsModel_->rowCount();
     for (int i = 0; i < cnt; ++i) {
-      if (newsId == newsModel_->index(i, newsModel_->fieldIndex("id")).data().toInt()) {
+      if (newsId == newsModel_->index(i, newsModel_->fieldColumn(NewsModel::FieldId)).data().toInt()) {
         if (read == 1) {
-          if (newsModel_->index(i, newsModel_->fieldIndex("new")).data(Qt::EditRole).toInt() == 1) {
+          if (newsModel_->index(i, newsModel_->fieldColumn(NewsModel::FieldNew)).data(Qt::EditRole).toInt() == 1) {
             newsModel_->setData(
-                  newsModel_->index(i, newsModel_->fieldIndex("new")),
+                  newsModel_->index(i, newsModel_->fieldColumn(NewsModel::FieldNew)),
                   0);
             q.exec(QString("UPDATE news SET new=0 WHERE id=='%1'").arg(newsId));
           }
-          if (newsModel_->index(i, newsModel_->fieldIndex("read")).data(Qt::EditRole).toInt() == 0) {
+          if (newsModel_->index(i, newsModel_->fieldColumn(NewsModel::FieldRead)).data(Qt::EditRole).toInt() == 0) {
             newsModel_->setData(
-                  newsModel_->index(i, newsModel_->fieldIndex("read")),
+                  newsModel_->index(i, newsModel_->fieldColumn(NewsModel::FieldRead)),
                   1);
             q.exec(QString("UPDATE news SET read=1 WHERE id=='%1'").arg(newsId));
           }
         } else {
-          if (newsModel_->index(i, newsModel_->fieldIndex("read")).data(Qt::EditRole).toInt() != 0) {
+          if (newsModel_->index(i, newsModel_->fieldColumn(NewsModel::FieldRead)).data(Qt::EditRole).toInt() != 0) {
             newsModel_->setData(
-                  newsModel_->index(i, newsModel_->fieldIndex("read")),
+                  newsModel_->index(i, newsModel_->fieldColumn(NewsModel::FieldRead)),
                   0);
             q.exec(QString("UPDATE news SET read=0 WHERE id=='%1'").arg(newsId));
           }
@@ -7019,11 +7203,11 @@ void MainWindow::slotDeleteNewsInNotification(int feedId, int newsId)
 
   if (currentNewsTab->type_ < NewsTabWidget::TabTypeWeb) {
     for (int i = 0; i < newsModel_->rowCount(); ++i) {
-      if (newsId == newsModel_->index(i, newsModel_->fieldIndex("id")).data().toInt()) {
-        newsModel_->setData(newsModel_->index(i, newsModel_->fieldIndex("new")), 0);
-        newsModel_->setData(newsModel_->index(i, newsModel_->fieldIndex("read")), 2);
-        newsModel_->setData(newsModel_->index(i, newsModel_->fieldIndex("deleted")), 1);
-        newsModel_->setData(newsModel_->index(i, newsModel_->fieldIndex("deleteDate")),
+      if (newsId == newsModel_->index(i, newsModel_->fieldColumn(NewsModel::FieldId)).data().toInt()) {
+        newsModel_->setData(newsModel_->index(i, newsModel_->fieldColumn(NewsModel::FieldNew)), 0);
+        newsModel_->setData(newsModel_->index(i, newsModel_->fieldColumn(NewsModel::FieldRead)), 2);
+        newsModel_->setData(newsModel_->index(i, newsModel_->fieldColumn(NewsModel::FieldDeleted)), 1);
+        newsModel_->setData(newsModel_->index(i, newsModel_->fieldColumn(NewsModel::FieldDeleteDate)),
                             QDateTime::currentDateTime().toString(Qt::ISODate));
 
         newsModel_->submitAll();
@@ -7035,11 +7219,11 @@ void MainWindow::slotDeleteNewsInNotification(int feedId, int newsId)
 
         QModelIndex curIndex;
         if (i == newsModel_->rowCount())
-          curIndex = newsModel_->index(i-1, newsModel_->fieldIndex("title"));
+          curIndex = newsModel_->index(i-1, newsModel_->fieldColumn(NewsModel::FieldTitle));
         else if (i > newsModel_->rowCount())
-          curIndex = newsModel_->index(i-1, newsModel_->fieldIndex("title"));
+          curIndex = newsModel_->index(i-1, newsModel_->fieldColumn(NewsModel::FieldTitle));
         else
-          curIndex = newsModel_->index(i, newsModel_->fieldIndex("title"));
+          curIndex = newsModel_->index(i, newsModel_->fieldColumn(NewsModel::FieldTitle));
         newsView_->setCurrentIndex(curIndex);
         currentNewsTab->slotNewsViewSelected(curIndex);
         break;
@@ -7059,11 +7243,11 @@ void MainWindow::slotMarkAllReadNewsInNotification()
 
     if (currentNewsTab->type_ < NewsTabWidget::TabTypeWeb) {
       for (int i = 0; i < newsModel_->rowCount(); ++i) {
-        if (idNewsList.contains(newsModel_->index(i, newsModel_->fieldIndex("id")).data().toInt())) {
+        if (idNewsList.contains(newsModel_->index(i, newsModel_->fieldColumn(NewsModel::FieldId)).data().toInt())) {
           newsModel_->setData(
-                newsModel_->index(i, newsModel_->fieldIndex("new")), 0);
+                newsModel_->index(i, newsModel_->fieldColumn(NewsModel::FieldNew)), 0);
           newsModel_->setData(
-                newsModel_->index(i, newsModel_->fieldIndex("read")), 1);
+                newsModel_->index(i, newsModel_->fieldColumn(NewsModel::FieldRead)), 1);
         }
       }
       newsView_->viewport()->update();
@@ -7115,6 +7299,15 @@ void MainWindow::cleanUp()
   delete cleanUpWizard;
 }
 
+/** @brief Show time spent by update stages and slow feeds
+ *---------------------------------------------------------------------------*/
+void MainWindow::showPipelineMetrics()
+{
+  PipelineMetricsDialog *metricsDialog = new PipelineMetricsDialog(this);
+  metricsDialog->exec();
+  delete metricsDialog;
+}
+
 /** @brief Zooming in browser
  *---------------------------------------------------------------------------*/
 void MainWindow::browserZoom(QAction *action)
@@ -7237,29 +7430,28 @@ void MainWindow::slotMoveIndex(const QModelIndex &indexWhere, int how)
 {
   feedsView_->setCursor(Qt::WaitCursor);
 
+  // Model is changed after each move, so selected feeds are kept by id
+  QList<int> idWhatList;
   QModelIndexList indexList = feedsView_->selectionModel()->selectedRows(0);
-  for (int i = 0; i < indexList.count(); i++) {
-    QModelIndex indexWhat = feedsProxyModel_->mapToSource(indexList[i]);
-    int feedIdWhat = feedsModel_->idByIndex(indexWhat);
+  foreach (const QModelIndex &index, indexList) {
+    idWhatList.append(feedsModel_->idByIndex(feedsProxyModel_->mapToSource(index)));
+  }
+
+  QSqlDatabase db = QSqlDatabase::database();
+  db.transaction();
+  foreach (int feedIdWhat, idWhatList) {
+    QModelIndex indexWhat = feedsModel_->indexById(feedIdWhat);
     int feedParIdWhat = feedsModel_->paridByIndex(indexWhat);
     int feedIdWhere = feedsModel_->idByIndex(indexWhere);
     int feedParIdWhere = feedsModel_->paridByIndex(indexWhere);
 
     // Repair rowToParent
-    QSqlQuery q;
+    QSqlQuery q(db);
     if (how == 2) {
       // Move to another folder
-      QList<int> idList;
-      q.exec(QString("SELECT id FROM feeds WHERE parentId='%1' ORDER BY rowToParent").
-             arg(feedParIdWhat));
-      while (q.next()) {
-        if (feedIdWhat != q.value(0).toInt())
-          idList << q.value(0).toInt();
-      }
-      for (int i = 0; i < idList.count(); i++) {
-        q.exec(QString("UPDATE feeds SET rowToParent='%1' WHERE id=='%2'").
-               arg(i).arg(idList.at(i)));
-      }
+      QList<int> idList = feedsOrder(feedParIdWhat);
+      idList.removeAll(feedIdWhat);
+      saveFeedsOrder(feedParIdWhat, idList);
 
       int rowToParent = 0;
       q.exec(QString("SELECT count(id) FROM feeds WHERE parentId='%1'").
@@ -7274,71 +7466,90 @@ void MainWindow::slotMoveIndex(const QModelIndex &indexWhere, int how)
       recountFeedCategories(categoriesList);
     } else if (feedParIdWhat == feedParIdWhere) {
       // Move inside folder
-      QList<int> idList;
-      q.exec(QString("SELECT id FROM feeds WHERE parentId='%1' ORDER BY rowToParent").
-             arg(feedParIdWhat));
-      while (q.next()) {
-        idList << q.value(0).toInt();
-      }
+      QList<int> idList = feedsOrder(feedParIdWhat);
 
-      int rowWhat = feedsModel_->dataField(indexWhat, "rowToParent").toInt();
-      int rowWhere = feedsModel_->dataField(indexWhere, "rowToParent").toInt();
+      int rowWhat = feedsModel_->dataField(indexWhat, FeedsModel::FieldRowToParent).toInt();
+      int rowWhere = feedsModel_->dataField(indexWhere, FeedsModel::FieldRowToParent).toInt();
       if ((rowWhat < rowWhere) && (how != 1)) rowWhere--;
       else if (how == 1) rowWhere++;
       idList.insert(rowWhere, idList.takeAt(rowWhat));
 
-      for (int i = 0; i < idList.count(); i++) {
-        q.exec(QString("UPDATE feeds SET rowToParent='%1' WHERE id=='%2'").
-               arg(i).arg(idList.at(i)));
-      }
+      saveFeedsOrder(feedParIdWhat, idList);
     } else {
       // Move in another folder beside feeds
-      QList<int> idList;
-      q.exec(QString("SELECT id FROM feeds WHERE parentId='%1' ORDER BY rowToParent").
-             arg(feedParIdWhat));
-      while (q.next()) {
-        if (feedIdWhat != q.value(0).toInt())
-          idList << q.value(0).toInt();
-      }
-      for (int i = 0; i < idList.count(); i++) {
-        q.exec(QString("UPDATE feeds SET rowToParent='%1' WHERE id=='%2'").
-               arg(i).arg(idList.at(i)));
-      }
-
-      //
+      QList<int> idList = feedsOrder(feedParIdWhat);
+      idList.removeAll(feedIdWhat);
+      saveFeedsOrder(feedParIdWhat, idList);
 
-      idList.clear();
-      q.exec(QString("SELECT id FROM feeds WHERE parentId='%1' ORDER BY rowToParent").
-             arg(feedParIdWhere));
-      while (q.next()) {
-        idList << q.value(0).toInt();
-      }
+      idList = feedsOrder(feedParIdWhere);
 
-      int rowWhere = feedsModel_->dataField(indexWhere, "rowToParent").toInt();
+      int rowWhere = feedsModel_->dataField(indexWhere, FeedsModel::FieldRowToParent).toInt();
       if (how == 1) rowWhere++;
       idList.insert(rowWhere, feedIdWhat);
 
-      for (int i = 0; i < idList.count(); i++) {
-        q.exec(QString("UPDATE feeds SET rowToParent='%1' WHERE id=='%2'").
-               arg(i).arg(idList.at(i)));
-      }
-
       q.exec(QString("UPDATE feeds SET parentId='%1' WHERE id=='%2'").
              arg(feedParIdWhere).arg(feedIdWhat));
+      saveFeedsOrder(feedParIdWhere, idList);
 
       QList<int> categoriesList;
       categoriesList << feedParIdWhat << feedParIdWhere;
       recountFeedCategories(categoriesList);
     }
-  }
 
-  feedsView_->refresh();
+    q.exec(QString("SELECT parentId, rowToParent FROM feeds WHERE id=='%1'").
+           arg(feedIdWhat));
+    if (q.next())
+      feedsModel_->moveFeed(feedIdWhat, q.value(0).toInt(), q.value(1).toInt());
+  }
+  db.commit();
 
   feedsView_->setCurrentIndex(feedsProxyModel_->mapFromSource(feedIdOld_));
 
   feedsView_->setCursor(Qt::ArrowCursor);
 }
 
+/** @brief Children ids of folder \a parentId in stored order
+ *---------------------------------------------------------------------------*/
+QList<int> MainWindow::feedsOrder(int parentId)
+{
+  QList<int> idList;
+  QSqlQuery q;
+  q.setForwardOnly(true);
+  q.prepare("SELECT id FROM feeds WHERE parentId=? ORDER BY rowToParent");
+  q.addBindValue(parentId);
+  q.exec();
+  while (q.next()) {
+    idList << q.value(0).toInt();
+  }
+  return idList;
+}
+
+/** @brief Number children of folder \a parentId in order of \a idList
+ *
+ * Only feeds which position is changed are written, so moving a feed
+ * touches rows between its old and new place.
+ *---------------------------------------------------------------------------*/
+void MainWindow::saveFeedsOrder(int parentId, const QList<int> &idList)
+{
+  QHash<int,int> rows;
+  QSqlQuery q;
+  q.setForwardOnly(true);
+  q.prepare("SELECT id, rowToParent FROM feeds WHERE parentId=?");
+  q.addBindValue(parentId);
+  q.exec();
+  while (q.next()) {
+    rows.insert(q.value(0).toInt(), q.value(1).toInt());
+  }
+
+  q.prepare("UPDATE feeds SET rowToParent=? WHERE id=?");
+  for (int i = 0; i < idList.count(); i++) {
+    if (rows.value(idList.at(i), -1) == i) continue;
+    q.addBindValue(i);
+    q.addBindValue(idList.at(i));
+    q.exec();
+  }
+}
+
 /** @brief Process clicks in feeds tree
  * @param item Item that was clicked
  *---------------------------------------------------------------------------*/
@@ -7429,96 +7640,77 @@ void MainWindow::slotCategoriesClicked(QTreeWidgetItem *item, int, bool createTa
     case NewsTabWidget::TabTypeLabel:
       if (currentNewsTab->labelId_ != 0) {
         currentNewsTab->categoryFilterStr_ =
-            QString("feedId > 0 AND deleted = 0 AND label LIKE '%,%1,%'").
+            QString("feedId > 0 AND deleted = 0 AND "
+                    "id IN (SELECT newsId FROM newsLabels WHERE labelId=%1)").
             arg(currentNewsTab->labelId_);
       } else {
         currentNewsTab->categoryFilterStr_ =
-            QString("feedId > 0 AND deleted = 0 AND label!='' AND label!=','");
+            QString("feedId > 0 AND deleted = 0 AND id IN (SELECT newsId FROM newsLabels)");
       }
       break;
+    case NewsTabWidget::TabTypeSearch:
+      currentNewsTab->categoryFilterStr_ = "feedId > 0 AND deleted = 0";
+      break;
     }
     // ... add filter from "search"
     QString filterStr = currentNewsTab->categoryFilterStr_;
+    // Search over all feeds finds news of archive too
+    QString archiveFilterStr;
+    if (type == NewsTabWidget::TabTypeSearch)
+      archiveFilterStr = currentNewsTab->categoryFilterStr_;
     QString objectName = currentNewsTab->findText_->findGroup_->checkedAction()->objectName();
     if (objectName != "findInBrowserAct") {
-      QString findText = currentNewsTab->findText_->text();
-      if (!findText.isEmpty()) {
-        findText = findText.replace("'", "''").toUpper();
-        if (objectName == "findTitleAct") {
-          filterStr.append(
-                QString(" AND UPPER(title) LIKE '%%1%'").arg(findText));
-        } else if (objectName == "findAuthorAct") {
-          filterStr.append(
-                QString(" AND UPPER(author_name) LIKE '%%1%'").arg(findText));
-        } else if (objectName == "findCategoryAct") {
-          filterStr.append(
-                QString(" AND UPPER(category) LIKE '%%1%'").arg(findText));
-        } else if (objectName == "findContentAct") {
-          filterStr.append(
-                QString(" AND (UPPER(content) LIKE '%%1%' OR UPPER(description) LIKE '%%1%')").
-                arg(findText));
-        } else if (objectName == "findLinkAct") {
-          filterStr.append(
-                QString(" AND link_href LIKE '%%1%'").
-                arg(findText));
-        } else {
-          filterStr.append(
-                QString(" AND (UPPER(title) LIKE '%%1%' OR UPPER(author_name) LIKE '%%1%' "
-                        "OR UPPER(category) LIKE '%%1%' OR UPPER(content) LIKE '%%1%' "
-                        "OR UPPER(description) LIKE '%%1%')").
-                arg(findText));
-        }
-      }
+      filterStr.append(Database::findNewsFilter(objectName,
+                                                currentNewsTab->findText_->text()));
+      if (!archiveFilterStr.isEmpty())
+        archiveFilterStr.append(Database::findNewsFilter(objectName,
+                                                         currentNewsTab->findText_->text(), true));
     }
-    newsModel_->setFilter(filterStr);
+    newsModel_->setFilter(filterStr, archiveFilterStr);
 
-    if (newsModel_->rowCount() != 0) {
+    // Results over all feeds are paged in by the view while scrolling
+    if ((type != NewsTabWidget::TabTypeSearch) && (newsModel_->rowCount() != 0)) {
       while (newsModel_->canFetchMore())
         newsModel_->fetchMore();
     }
 
     if (type == NewsTabWidget::TabTypeDel){
-      currentNewsTab->newsHeader_->setSortIndicator(newsModel_->fieldIndex("deleteDate"),
+      currentNewsTab->newsHeader_->setSortIndicator(newsModel_->fieldColumn(NewsModel::FieldDeleteDate),
                                                     Qt::DescendingOrder);
-    } else {
-      if ((currentNewsTab->newsHeader_->sortIndicatorSection() == newsModel_->fieldIndex("read")) ||
-          currentNewsTab->newsHeader_->sortIndicatorSection() == newsModel_->fieldIndex("starred")) {
-        currentNewsTab->slotSort(currentNewsTab->newsHeader_->sortIndicatorSection(),
-                                 currentNewsTab->newsHeader_->sortIndicatorOrder());
-      }
     }
 
     currentNewsTab->loadNewspaper();
 
     // Search previous displayed news of the feed
     int newsRow = -1;
-    if (openingFeedAction_ == 0) {
+    if (type == NewsTabWidget::TabTypeSearch) {
+      if (openingFeedAction_ == 1) newsRow = 0;
+    } else if (openingFeedAction_ == 0) {
       int newsIdCur = item->text(3).toInt();
-      QModelIndex index = newsModel_->index(0, newsModel_->fieldIndex("id"));
+      QModelIndex index = newsModel_->index(0, newsModel_->fieldColumn(NewsModel::FieldId));
       QModelIndexList indexList = newsModel_->match(index, Qt::EditRole, newsIdCur);
 
       if (!indexList.isEmpty()) newsRow = indexList.first().row();
     } else if (openingFeedAction_ == 1) {
       newsRow = 0;
     } else if (openingFeedAction_ == 3) {
-      QModelIndex index = newsModel_->index(0, newsModel_->fieldIndex("read"));
-      QModelIndexList indexList;
-      if (newsView_->header()->sortIndicatorOrder() == Qt::DescendingOrder)
-        indexList = newsModel_->match(index, Qt::EditRole, 0, -1);
-      else
-        indexList = newsModel_->match(index, Qt::EditRole, 0);
-
-      if (!indexList.isEmpty()) newsRow = indexList.last().row();
+      const QVector<int> &unreadRows = newsModel_->unreadRows();
+      if (!unreadRows.isEmpty()) {
+        if (newsView_->header()->sortIndicatorOrder() == Qt::DescendingOrder)
+          newsRow = unreadRows.last();
+        else
+          newsRow = unreadRows.first();
+      }
     }
 
     // Display previous displayed news of the feed
-    newsView_->setCurrentIndex(newsModel_->index(newsRow, newsModel_->fieldIndex("title")));
+    newsView_->setCurrentIndex(newsModel_->index(newsRow, newsModel_->fieldColumn(NewsModel::FieldTitle)));
     if (newsRow == -1) newsView_->verticalScrollBar()->setValue(newsRow);
 
     if ((openingFeedAction_ != 2) && openNewsWebViewOn_) {
-      currentNewsTab->slotNewsViewSelected(newsModel_->index(newsRow, newsModel_->fieldIndex("title")));
+      currentNewsTab->slotNewsViewSelected(newsModel_->index(newsRow, newsModel_->fieldColumn(NewsModel::FieldTitle)));
     } else {
-      currentNewsTab->slotNewsViewSelected(newsModel_->index(-1, newsModel_->fieldIndex("title")));
+      currentNewsTab->slotNewsViewSelected(newsModel_->index(-1, newsModel_->fieldColumn(NewsModel::FieldTitle)));
     }
 
     if (createTab)
@@ -7527,6 +7719,11 @@ void MainWindow::slotCategoriesClicked(QTreeWidgetItem *item, int, bool createTa
     emit signalSetCurrentTab(indexTab, true);
   }
 
+  if (tabType == NewsTabWidget::TabTypeSearch) {
+    currentNewsTab->findText_->setFocus();
+    currentNewsTab->findText_->selectAll();
+  }
+
   int unreadCount = currentNewsTab->getUnreadCount(categoriesTree_->currentItem()->text(4));
   int allCount = currentNewsTab->newsModel_->rowCount();
   statusUnread_->setText(QString(" " + tr("Unread: %1") + " ").arg(unreadCount));
@@ -7634,7 +7831,7 @@ void MainWindow::getLabelNews()
   if (currentNewsTab->type_ >= NewsTabWidget::TabTypeWeb) return;
 
   QList<QModelIndex> indexes = newsView_->selectionModel()->selectedRows(
-        newsModel_->fieldIndex("label"));
+        newsModel_->fieldColumn(NewsModel::FieldLabel));
   if (!indexes.count()) return;
 
   if (indexes.count() == 1) {
@@ -7702,16 +7899,16 @@ void MainWindow::slotSavePageAs()
   if (currentNewsTab->type_ == NewsTabWidget::TabTypeDownloads) return;
 
   QString fileName = currentNewsTab->webView_->title();
-  if (newsLayout_ == 0) {
+  if (newsLayout_ != 1) {
     if (fileName == "news_descriptions") {
       int row = currentNewsTab->newsView_->currentIndex().row();
-      fileName = currentNewsTab->newsModel_->dataField(row, "title").toString();
+      fileName = currentNewsTab->newsModel_->dataField(row, NewsModel::FieldTitle).toString();
     }
   } else {
     if (currentNewsTab->type_ == NewsTabWidget::TabTypeFeed) {
       QModelIndex feedIndex = feedsView_->currentIndex();
       feedIndex = feedsProxyModel_->mapToSource(feedIndex);
-      fileName = feedsModel_->dataField(feedIndex, "text").toString();
+      fileName = feedsModel_->dataField(feedIndex, FeedsModel::FieldText).toString();
     } else {
       fileName = categoriesTree_->currentItem()->text(0);
     }
@@ -7761,7 +7958,7 @@ void MainWindow::restoreLastNews()
   q.exec("SELECT id, feedId FROM news WHERE deleted=1 AND deleteDate!='' ORDER BY deleteDate DESC");
   if (q.next()) {
     QModelIndex curIndex = newsView_->currentIndex();
-    int newsIdCur = newsModel_->index(curIndex.row(), newsModel_->fieldIndex("id")).data().toInt();
+    int newsIdCur = newsModel_->index(curIndex.row(), newsModel_->fieldColumn(NewsModel::FieldId)).data().toInt();
 
     int newsId = q.value(0).toInt();
     int feedId = q.value(1).toInt();
@@ -7775,11 +7972,11 @@ void MainWindow::restoreLastNews()
 
     currentNewsTab->loadNewspaper(NewsTabWidget::RefreshWithPos);
 
-    QModelIndex index = newsModel_->index(0, newsModel_->fieldIndex("id"));
+    QModelIndex index = newsModel_->index(0, newsModel_->fieldColumn(NewsModel::FieldId));
     QModelIndexList indexList = newsModel_->match(index, Qt::EditRole, newsIdCur);
     if (indexList.count()) {
       int newsRow = indexList.first().row();
-      newsView_->setCurrentIndex(newsModel_->index(newsRow, newsModel_->fieldIndex("title")));
+      newsView_->setCurrentIndex(newsModel_->index(newsRow, newsModel_->fieldColumn(NewsModel::FieldTitle)));
     }
     slotUpdateStatus(feedId);
     recountCategoryCounts();
@@ -7814,22 +8011,21 @@ void MainWindow::nextUnreadNews()
       slotFeedClicked(indexPrevUnread);
 
       if (tabBar_->currentIndex() != TAB_WIDGET_PERMANENT) {
-        QModelIndex index = newsModel_->index(0, newsModel_->fieldIndex("read"));
-        QModelIndexList indexList;
-        if ((newsView_->header()->sortIndicatorOrder() == Qt::DescendingOrder) &&
-            (openingFeedAction_ != 4))
-          indexList = newsModel_->match(index, Qt::EditRole, 0, -1);
-        else
-          indexList = newsModel_->match(index, Qt::EditRole, 0);
-
-        if (!indexList.isEmpty()) newsRow = indexList.last().row();
+        const QVector<int> &unreadRows = newsModel_->unreadRows();
+        if (!unreadRows.isEmpty()) {
+          if ((newsView_->header()->sortIndicatorOrder() == Qt::DescendingOrder) &&
+              (openingFeedAction_ != 4))
+            newsRow = unreadRows.last();
+          else
+            newsRow = unreadRows.first();
+        }
 
         // Focus feed news that displayed before
-        newsView_->setCurrentIndex(newsModel_->index(newsRow, newsModel_->fieldIndex("title")));
+        newsView_->setCurrentIndex(newsModel_->index(newsRow, newsModel_->fieldColumn(NewsModel::FieldTitle)));
         if (newsRow == -1) newsView_->verticalScrollBar()->setValue(newsRow);
 
         if (openNewsWebViewOn_) {
-          currentNewsTab->slotNewsViewSelected(newsModel_->index(newsRow, newsModel_->fieldIndex("title")));
+          currentNewsTab->slotNewsViewSelected(newsModel_->index(newsRow, newsModel_->fieldColumn(NewsModel::FieldTitle)));
         }
       }
 
@@ -7844,7 +8040,7 @@ void MainWindow::nextUnreadNews()
   if (newsRow > (value + pageStep/2))
     newsView_->verticalScrollBar()->setValue(newsRow - pageStep/2);
 
-  QModelIndex index = newsModel_->index(newsRow, newsModel_->fieldIndex("title"));
+  QModelIndex index = newsModel_->index(newsRow, newsModel_->fieldColumn(NewsModel::FieldTitle));
   newsView_->setCurrentIndex(index);
   currentNewsTab->slotNewsViewSelected(index);
 }
@@ -7880,7 +8076,7 @@ void MainWindow::prevUnreadNews()
   if (newsRow < (value + pageStep/2))
     newsView_->verticalScrollBar()->setValue(newsRow - pageStep/2);
 
-  QModelIndex index = newsModel_->index(newsRow, newsModel_->fieldIndex("title"));
+  QModelIndex index = newsModel_->index(newsRow, newsModel_->fieldColumn(NewsModel::FieldTitle));
   newsView_->setCurrentIndex(index);
   currentNewsTab->slotNewsViewSelected(index);
 }
@@ -7889,18 +8085,7 @@ void MainWindow::prevUnreadNews()
  *---------------------------------------------------------------------------*/
 QString MainWindow::getIdFeedsString(int idFolder, int idException)
 {
-  QList<int> idList = UpdateObject::getIdFeedsInList(db_, idFolder);
-  if (idList.count()) {
-    QString str;
-    foreach (int id, idList) {
-      if (id == idException) continue;
-      if (!str.isEmpty()) str.append(" OR ");
-      str.append(QString("feedId=%1").arg(id));
-    }
-    return str;
-  } else {
-    return QString("feedId=-1");
-  }
+  return UpdateObject::getIdFeedsString(idFolder, idException);
 }
 
 /** @brief Set application title
@@ -7999,37 +8184,36 @@ void MainWindow::sortedByTitleFeedsTree()
 {
   QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
 
+  QSqlDatabase db = QSqlDatabase::database();
+  db.transaction();
   QList<int> parentIdsPotential;
   parentIdsPotential << 0;
   while (!parentIdsPotential.empty()) {
     int parentId = parentIdsPotential.takeFirst();
 
     // Search children of parent <parentId>
+    // ... store folders in prospective parent list
+    QList<int> idList;
     QSqlQuery q;
+    q.setForwardOnly(true);
     q.prepare(QString("SELECT id, xmlUrl FROM feeds WHERE parentId=? ORDER BY text COLLATE LOCALE"));
     q.addBindValue(parentId);
     q.exec();
-
-    // assing each child his <rowToParent>
-    // ... store it in prospactive parent list
-    int rowToParent = 0;
     while (q.next()) {
-      int parentIdNew = q.value(0).toInt();
-      QString xmlUrl = q.value(1).toString();
-
-      QSqlQuery q2;
-      q2.prepare("UPDATE feeds SET rowToParent=? WHERE id=?");
-      q2.addBindValue(rowToParent);
-      q2.addBindValue(parentIdNew);
-      q2.exec();
+      idList << q.value(0).toInt();
+      if (q.value(1).toString().isEmpty())
+        parentIdsPotential << q.value(0).toInt();
+    }
 
-      if (xmlUrl.isEmpty())
-        parentIdsPotential << parentIdNew;
-      ++rowToParent;
+    // Assign each child his <rowToParent>, model rows are moved in place
+    saveFeedsOrder(parentId, idList);
+    for (int i = 0; i < idList.count(); ++i) {
+      feedsModel_->moveFeed(idList.at(i), parentId, i);
     }
   }
+  db.commit();
 
-  feedsModelReload();
+  feedsView_->setCurrentIndex(feedsProxyModel_->mapFromSource(feedIdOld_));
   QApplication::restoreOverrideCursor();
 }
 
@@ -8132,6 +8316,11 @@ void MainWindow::slotExpandFolder()
   feedsView_->setExpanded(index, !feedsView_->isExpanded(index));
 }
 // ----------------------------------------------------------------------------
+void MainWindow::showAdBlockDialog()
+{
+  AdBlockManager::instance()->showDialog();
+}
+// ----------------------------------------------------------------------------
 void MainWindow::showDownloadManager(bool activate)
 {
   int indexTab = -1;
@@ -8187,6 +8376,22 @@ void MainWindow::setStatusFeed(int feedId, QString status)
   }
 }
 
+/** @brief Set statuses of feeds collected during update
+ *
+ * Feeds tree is repainted once for all of them.
+ *---------------------------------------------------------------------------*/
+void MainWindow::setStatusFeeds(QList<int> feedIds, QStringList statuses)
+{
+  for (int i = 0; i < feedIds.count(); ++i) {
+    QModelIndex index = feedsModel_->indexById(feedIds.at(i));
+    if (index.isValid()) {
+      QModelIndex indexStatus = feedsModel_->indexSibling(index, "status");
+      feedsModel_->setData(indexStatus, statuses.at(i));
+    }
+  }
+  feedsView_->viewport()->update();
+}
+
 void MainWindow::addOurFeed()
 {
   if (mainApp->dbFileExists()) return;
@@ -8203,8 +8408,8 @@ void MainWindow::addOurFeed()
     xmlUrl = "https://quiterss.org/ru/rss.xml";
 
   QSqlQuery q;
-  q.prepare("INSERT INTO feeds(text, title, xmlUrl, htmlUrl, created, parentId, rowToParent, image) "
-            "VALUES(?, ?, ?, ?, ?, ?, ?, ?)");
+  q.prepare("INSERT INTO feeds(text, title, xmlUrl, htmlUrl, created, parentId, rowToParent) "
+            "VALUES(?, ?, ?, ?, ?, ?, ?)");
   q.addBindValue("QuiteRSS");
   q.addBindValue("QuiteRSS");
   q.addBindValue(xmlUrl);
@@ -8212,6 +8417,11 @@ void MainWindow::addOurFeed()
   q.addBindValue(QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
   q.addBindValue(0);
   q.addBindValue(0);
+  q.exec();
+  QVariant feedId = q.lastInsertId();
+
+  q.prepare("INSERT INTO feedsIcons(feedId, image) VALUES(?, ?)");
+  q.addBindValue(feedId);
   q.addBindValue(iconData.toBase64());
   q.exec();
 
@@ -8234,19 +8444,72 @@ void MainWindow::createBackup()
     QString backupFileName;
     QString timeStr(QDateTime::currentDateTime().toString("yyyy-MM-dd_hh-mm-ss"));
 
-    fileInfo.setFile(mainApp->dbFileName());
+    fileInfo.setFile(settings.fileName());
     backupFileName = QString("%1/%2_%3.bak").
         arg(backupDir).
         arg(fileInfo.fileName()).
         arg(timeStr);
-    QFile::copy(mainApp->dbFileName(), backupFileName);
+    QFile::copy(settings.fileName(), backupFileName);
+    removeOldBackups(backupDir, fileInfo.fileName());
 
-    fileInfo.setFile(settings.fileName());
+    if (backupRunning_) {
+      statusBar()->showMessage(tr("Backup of database is already in progress"), 3000);
+      return;
+    }
+
+    // Database is copied in own thread, feeds are updated meanwhile
+    fileInfo.setFile(mainApp->dbFileName());
     backupFileName = QString("%1/%2_%3.bak").
         arg(backupDir).
         arg(fileInfo.fileName()).
         arg(timeStr);
-    QFile::copy(settings.fileName(), backupFileName);
+    sqlite3 *memoryHandle = 0;
+    if (mainApp->storeDBMemory())
+      memoryHandle = Database::sqliteHandle(Database::connection());
+
+    backupThread_ = new QThread();
+    DatabaseBackup *databaseBackup = new DatabaseBackup(backupFileName, memoryHandle);
+    databaseBackup->moveToThread(backupThread_);
+    connect(backupThread_, SIGNAL(started()), databaseBackup, SLOT(run()));
+    connect(databaseBackup, SIGNAL(finished(bool,QString)),
+            this, SLOT(slotBackupFinished(bool,QString)));
+    connect(databaseBackup, SIGNAL(finished(bool,QString)), backupThread_, SLOT(quit()));
+    connect(backupThread_, SIGNAL(finished()), databaseBackup, SLOT(deleteLater()));
+    connect(backupThread_, SIGNAL(finished()), backupThread_, SLOT(deleteLater()));
+    backupRunning_ = true;
+    backupThread_->start(QThread::LowPriority);
+    statusBar()->showMessage(tr("Creating backup of database..."));
+  }
+}
+
+void MainWindow::slotBackupFinished(bool ok, const QString &fileName)
+{
+  backupRunning_ = false;
+  if (ok) {
+    QFileInfo fileInfo(mainApp->dbFileName());
+    removeOldBackups(QFileInfo(fileName).absolutePath(), fileInfo.fileName());
+    statusBar()->showMessage(tr("Backup of database created"), 3000);
+  } else {
+    statusBar()->showMessage(tr("Backup of database failed"), 3000);
+  }
+}
+
+/** @brief Keep only last backups of file in directory
+ *
+ * Number of kept backups is set by "Settings/backupCount", 0 keeps all.
+ *----------------------------------------------------------------------------*/
+void MainWindow::removeOldBackups(const QString &backupDir, const QString &fileName)
+{
+  Settings settings;
+  int backupCount = settings.value("Settings/backupCount", 10).toInt();
+  if (backupCount <= 0) return;
+
+  QDir dir(backupDir);
+  // Time in names sorts backups from old to new
+  QStringList backupList = dir.entryList(QStringList() << QString("%1_*.bak").arg(fileName),
+                                         QDir::Files, QDir::Name);
+  for (int i = 0; i < backupList.count() - backupCount; ++i) {
+    dir.remove(backupList.at(i));
   }
 }
 
@@ -20,14 +20,8 @@
 
 #ifdef HAVE_QT5
 #include <QtWidgets>
-#include <QMediaPlayer>
-#include <QMediaPlaylist>
 #else
 #include <QtGui>
-#ifdef HAVE_PHONON
-#include <phonon/audiooutput.h>
-#include <phonon/mediaobject.h>
-#endif
 #endif
 #include <QtSql>
 #include <QtWebKit>
@@ -35,8 +29,8 @@
 #include <QPrintDialog>
 #include <QPrintPreviewDialog>
 #include <QPrinter>
-#include <QSound>
 
+#include "asyncquery.h"
 #include "categoriestreewidget.h"
 #include "feedsmodel.h"
 #include "feedsview.h"
@@ -69,10 +63,14 @@ enum FeedReedType {
 };
 
 class AdBlockIcon;
+class SoundPool;
 
 class MainWindow : public QMainWindow
 {
   Q_OBJECT
+  // Scripted benchmark drives private actions and slots
+  friend class UiBenchmark;
+  friend class StressRun;
 public:
   explicit MainWindow(QWidget *parent = 0);
   ~MainWindow();
@@ -88,6 +86,7 @@ public:
 
   QString getIdFeedsString(int idFolder, int idException = -1);
   void recountCategoryCounts();
+  void adjustFeedCounts(int feedId, int unreadDelta, int newDelta);
 
   void setToolBarStyle(const QString &styleStr);
   void setToolBarIconSize(QToolBar *toolbar, const QString &iconSizeStr);
@@ -282,11 +281,13 @@ public slots:
   void deleteItemFeedsTree();
   void slotImportFeeds();
   void slotExportFeeds();
+  void slotExportNews();
   void slotFeedClicked(QModelIndex index);
   void slotFeedSelected(QModelIndex index, bool createTab = false);
   void setFeedsFilter(bool clicked = true);
   void slotGetFeed();
   void slotGetAllFeeds();
+  void slotGetAllFeedsStartUp();
   void slotStopUpdate();
   void showProgressBar(int addToMaximum);
   void slotSetValue(int value);
@@ -294,15 +295,18 @@ public slots:
   void slotCountsStatusBar(int unreadCount, int allCount);
   void slotPlaySound(const QString &path);
   void slotAddColorList(int id, const QString &color);
+  void slotNotificationData(const NotificationFeedStruct &data);
   void showOptionDlg(int index = -1);
   void slotPlaceToTray();
   void slotActivationTray(QSystemTrayIcon::ActivationReason reason);
   void slotTrayOpenNotifyTimer();
   void showWindows(bool trayClick = false);
   void quitApp();
-  void myEmptyWorkingSet();
+  void releaseMemory();
   void slotUpdateFeed(int feedId, bool changed, int newCount, bool finish);
+  void slotFeedsUpdated(QList<int> feedIds, QList<int> newCounts, bool finish);
   void slotFeedCountsUpdate(FeedCountStruct counts);
+  void slotFeedsCountsUpdate(QList<FeedCountStruct> countsList);
   void slotUpdateNews(int refresh);
   void slotUpdateStatus(int feedId, bool changed = true);
   void setNewsFilter(QAction*, bool clicked = true);
@@ -310,6 +314,7 @@ public slots:
   QWebPage *createWebTab(QUrl url = QUrl());
   void feedsModelReload(bool checkFilter = false);
   void setStatusFeed(int feedId, QString status);
+  void setStatusFeeds(QList<int> feedIds, QStringList statuses);
   void slotPrint(QWebFrame *frame = 0);
   void slotPrintPreview(QWebFrame* frame = 0);
 
@@ -317,11 +322,12 @@ signals:
   void signalQuitApp();
   void signalPlaceToTray();
   void signalGetFeedTimer(int feedId);
-  void signalGetAllFeedsTimer();
+  void signalGetAllFeedsTimer(int interval);
   void signalGetFeed(int feedId, QString feedUrl, QDateTime date, int auth);
   void signalGetFeedsFolder(QString query);
-  void signalGetAllFeeds();
+  void signalGetAllFeeds(int priority);
   void signalStopUpdate();
+  void signalNetworkSettingsChanged();
   void signalImportFeeds(QByteArray xmlData);
   void signalRequestUrl(int feedId, QString urlString,
                         QDateTime date, QString userInfo);
@@ -346,24 +352,17 @@ signals:
 private slots:
   void showMainMenu();
   void slotTimerLinkOpening();
+  void applyFeedCounts();
+  void slotHibernateTabs();
   void slotVisibledFeedsWidget();
   void updateIconToolBarNull(bool feedsWidgetVisible);
   void setFeedRead(int type, int feedId, FeedReedType feedReadType,
                    NewsTabWidget *widgetTab = 0, int idException = -1);
   void markFeedRead();
-  void slotRecountCategoryCounts(QList<int> deletedList, QList<int> starredList,
-                                 QList<int> readList, QStringList labelList);
+  void slotRecountCategoryCounts(CategoryCountStruct counts);
   void slotFeedsViewportUpdate();
   void slotPlaySoundNewNews();
 
-#ifdef HAVE_QT5
-  void mediaStatusChanged(QMediaPlayer::MediaStatus status);
-  void mediaError(QMediaPlayer::Error error);
-#endif
- #ifdef HAVE_PHONON
-  void mediaStateChanged(Phonon::State newstate, Phonon::State oldstate);
-#endif
-
   void slotShowAboutDlg();
 
   void showContextMenuFeed(const QPoint & pos);
@@ -375,9 +374,11 @@ private slots:
   void showFeedPropertiesDlg();
   void slotFeedMenuShow();
   void slotRefreshNewsView(int nextUnread = -1);
-  void slotIconFeedPreparing(QString feedUrl, QByteArray byteArray, QString format);
   void slotIconFeedUpdate(int feedId, QByteArray faviconData);
+  void slotIconsFeedUpdate(QList<int> feedIds, QList<QByteArray> faviconsData);
   void showNewsFiltersDlg(bool newFilter = false);
+  void slotUserFilterProgress(int processed, int total);
+  void slotUserFilterFinished(int feedId);
   void showFilterRulesDlg();
   void slotUpdateAppCheck();
   void slotNewVersion(const QString &newVersion);
@@ -492,14 +493,21 @@ private slots:
   void slotPrevFolder();
   void slotExpandFolder();
 
+  void slotFeedsLoaded();
+  void slotStartupTabsLoaded(AsyncQueryResult result);
+  void slotOpenStartupTab();
+
+  void showAdBlockDialog();
   void showDownloadManager(bool activate = true);
   void updateInfoDownloads(const QString &text);
 
   void cleanUp();
+  void showPipelineMetrics();
 
   void showSettingPageLabels();
 
   void createBackup();
+  void slotBackupFinished(bool ok, const QString &fileName);
 
 private:
   void closeEvent(QCloseEvent *event);
@@ -509,6 +517,7 @@ private:
   QNetworkProxy networkProxy_;
 
   void setProxy(const QNetworkProxy proxy);
+  void removeOldBackups(const QString &backupDir, const QString &fileName);
   void createFeedsWidget();
   void createNewsTab(int index);
   void createToolBarNull();
@@ -526,6 +535,8 @@ private:
   void loadSettingsFeeds();
   void retranslateStrings();
   void recountFeedCategories(const QList<int> &categoriesList);
+  QList<int> feedsOrder(int parentId);
+  void saveFeedsOrder(int parentId, const QList<int> &idList);
   void creatFeedTab(int feedId, int feedParId);
   void initUpdateFeeds();
   void addOurFeed();
@@ -554,6 +565,7 @@ private:
   QAction *deleteFeedAct_;
   QAction *importFeedsAct_;
   QAction *exportFeedsAct_;
+  QAction *exportNewsAct_;
   QAction *mainToolbarToggle_;
   QAction *feedsToolbarToggle_;
   QAction *toolBarLockAct_;
@@ -564,6 +576,7 @@ private:
   QAction *customizeNewsToolbarAct_;
   QAction *classicLayoutAct_;
   QAction *newspaperLayoutAct_;
+  QAction *clusteredLayoutAct_;
   QAction *layoutToggle_;
   QAction *systemStyle_;
   QAction *system2Style_;
@@ -578,6 +591,7 @@ private:
   QAction *rightBrowserPositionAct_;
   QAction *leftBrowserPositionAct_;
   QAction *showCleanUpWizardAct_;
+  QAction *showPipelineMetricsAct_;
   QAction *showDownloadManagerAct_;
   QAction *setNewsFiltersAct_;
   QAction *setFilterNewsAct_;
@@ -706,16 +720,7 @@ private:
   int openingFeedAction_;
   bool openNewsWebViewOn_;
 
-#ifdef HAVE_QT5
-  QMediaPlayer *mediaPlayer_;
-  QMediaPlaylist *playlist_;
-#else
-#ifdef HAVE_PHONON
-  Phonon::MediaObject *mediaPlayer_;
-  Phonon::AudioOutput *audioOutput_;
-#endif
-#endif
-
+  SoundPool *soundPool_;
   bool soundNewNews_;
   QString soundNotifyPath_;
   bool playSoundNewNews_;
@@ -749,6 +754,7 @@ private:
 
   QList<int> idColorList_;
   QStringList colorList_;
+  QHash<int, NotificationFeedStruct> notificationData_;
 
   QTimer timerTrayOpenNotify;
 
@@ -781,6 +787,23 @@ private:
   bool changeBehaviorActionNUN_;
 
   bool recountCategoryCountsOn_;
+  // Rendered tray icons by shown number, shown number and tooltip text.
+  // Number is null when icon is set without number
+  QCache<QString, QIcon> trayIcons_;
+  QString trayIconText_;
+  QString trayToolTip_;
+  bool backupRunning_;
+  // Thread of running backup, it is waited for on quit
+  QPointer<QThread> backupThread_;
+
+  // Restored on startup when feeds tree is loaded
+  int restoreFeedId_;
+  QList<QPair<int,int> > startupTabs_;
+
+  // Counts received from update thread, applied to feeds model by timer
+  QHash<int,FeedCountStruct> pendingFeedCounts_;
+  QTimer feedCountsTimer_;
+  QTimer hibernateTimer_;
 
   OptionsDialog *optionsDialog_;
 
@@ -0,0 +1,129 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "memoryaccounting.h"
+
+#include "logfile.h"
+#include "sqlcachedresult.h"
+
+#include <QFile>
+#include <QMutexLocker>
+#include <QStringList>
+#include <QVariant>
+#include <sqlite3.h>
+#if defined(Q_OS_LINUX)
+#include <unistd.h>
+#endif
+
+QMutex MemoryAccounting::mutex_;
+QHash<const void*, QPair<int, qint64> > MemoryAccounting::reports_;
+
+MemoryAccounting::MemoryAccounting()
+{
+}
+
+/** @brief Set current footprint of \a owner, replacing its previous report
+ *----------------------------------------------------------------------------*/
+void MemoryAccounting::report(Subsystem subsystem, const void *owner, qint64 bytes)
+{
+  QMutexLocker locker(&mutex_);
+  reports_.insert(owner, qMakePair(int(subsystem), bytes));
+}
+
+/** @brief Forget report of destroyed \a owner
+ *----------------------------------------------------------------------------*/
+void MemoryAccounting::remove(const void *owner)
+{
+  QMutexLocker locker(&mutex_);
+  reports_.remove(owner);
+}
+
+/** @brief Bytes used by each subsystem
+ *----------------------------------------------------------------------------*/
+QVector<qint64> MemoryAccounting::usage()
+{
+  QVector<qint64> bytes(SubsystemCount, 0);
+  {
+    QMutexLocker locker(&mutex_);
+    QHash<const void*, QPair<int, qint64> >::const_iterator it = reports_.constBegin();
+    for (; it != reports_.constEnd(); ++it)
+      bytes[it.value().first] += it.value().second;
+  }
+  bytes[QueryCache] += SqlCachedResult::cachedBytes();
+  bytes[LogQueue] += LogFile::queuedBytes();
+  bytes[Sqlite] += sqlite3_memory_used();
+  return bytes;
+}
+
+/** @brief Resident memory of whole process, -1 if not known on platform
+ *----------------------------------------------------------------------------*/
+qint64 MemoryAccounting::processUsage()
+{
+#if defined(Q_OS_LINUX)
+  QFile file("/proc/self/statm");
+  if (file.open(QIODevice::ReadOnly)) {
+    QList<QByteArray> pages = file.readAll().split(' ');
+    if (pages.count() > 1)
+      return pages.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+  }
+#endif
+  return -1;
+}
+
+QString MemoryAccounting::subsystemName(int subsystem)
+{
+  switch (subsystem) {
+  case WebPages:   return "webPages";
+  case QueryCache: return "queryCache";
+  case FeedsTree:  return "feedsTree";
+  case AdBlock:    return "adBlock";
+  case LogQueue:   return "logQueue";
+  case Sqlite:     return "sqlite";
+  case ParseQueue: return "parseQueue";
+  }
+  return QString();
+}
+
+/** @brief One line of usage in KB for log
+ *----------------------------------------------------------------------------*/
+QString MemoryAccounting::toString()
+{
+  QVector<qint64> bytes = usage();
+  qint64 total = 0;
+  QStringList values;
+  for (int i = 0; i < bytes.count(); ++i) {
+    total += bytes.at(i);
+    values.append(QString("%1=%2").arg(subsystemName(i)).arg(bytes.at(i) / 1024));
+  }
+  values.append(QString("total=%1").arg(total / 1024));
+  qint64 process = processUsage();
+  if (process >= 0)
+    values.append(QString("process=%1").arg(process / 1024));
+  return values.join(" ");
+}
+
+/** @brief Approximate size of \a value with its text or data
+ *----------------------------------------------------------------------------*/
+qint64 MemoryAccounting::variantBytes(const QVariant &value)
+{
+  qint64 bytes = sizeof(QVariant);
+  if (value.type() == QVariant::String)
+    bytes += value.toString().size() * sizeof(QChar);
+  else if (value.type() == QVariant::ByteArray)
+    bytes += value.toByteArray().size();
+  return bytes;
+}
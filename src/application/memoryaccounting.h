@@ -0,0 +1,67 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef MEMORYACCOUNTING_H
+#define MEMORYACCOUNTING_H
+
+#include <QHash>
+#include <QMutex>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+class QVariant;
+
+/** @brief Approximate memory footprint of subsystems
+ *
+ * Owners report their current estimate from any thread when it changes,
+ * values of the same subsystem are summed. Global caches are read when
+ * usage is requested.
+ *----------------------------------------------------------------------------*/
+class MemoryAccounting
+{
+public:
+  enum Subsystem {
+    WebPages = 0,   // pages loaded in browser of tabs
+    QueryCache,     // rows of queries cached by SQLite driver
+    FeedsTree,      // records of feeds tree
+    AdBlock,        // search trees and indexes of AdBlock rules
+    LogQueue,       // messages waiting for log writer
+    Sqlite,         // memory of SQLite library with its page cache
+    ParseQueue,     // received feeds waiting for parse and store
+    SubsystemCount
+  };
+
+  static void report(Subsystem subsystem, const void *owner, qint64 bytes);
+  static void remove(const void *owner);
+
+  static QVector<qint64> usage();
+  static qint64 processUsage();
+  static QString subsystemName(int subsystem);
+  static QString toString();
+
+  static qint64 variantBytes(const QVariant &value);
+
+private:
+  explicit MemoryAccounting();
+
+  static QMutex mutex_;
+  static QHash<const void*, QPair<int, qint64> > reports_;
+
+};
+
+#endif // MEMORYACCOUNTING_H
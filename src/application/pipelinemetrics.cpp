@@ -0,0 +1,358 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "pipelinemetrics.h"
+
+#include "sqlitedriver.h"
+
+#include <QMutexLocker>
+#include <QStringList>
+
+#include <algorithm>
+
+QMutex PipelineMetrics::mutex_;
+QVector<PipelineMetrics::Histogram> PipelineMetrics::histograms_(PipelineMetrics::StageCount);
+QHash<int, QVector<qint64> > PipelineMetrics::feedValues_;
+QHash<int, PipelineMetrics::FeedFailures> PipelineMetrics::failures_;
+QHash<QString, PipelineMetrics::Statement> PipelineMetrics::statements_;
+QVector<PipelineMetrics::Wakeups> PipelineMetrics::wakeups_(PipelineMetrics::WakeupCount);
+
+static bool feedValueMoreThan(const PipelineMetrics::FeedValue &v1,
+                              const PipelineMetrics::FeedValue &v2)
+{
+  return v1.second > v2.second;
+}
+
+static bool statementMoreThan(const PipelineMetrics::Statement &s1,
+                              const PipelineMetrics::Statement &s2)
+{
+  return s1.total > s2.total;
+}
+
+PipelineMetrics::PipelineMetrics()
+{
+}
+
+PipelineMetrics::Histogram::Histogram()
+  : count(0)
+  , sum(0)
+  , max(0)
+{
+  for (int i = 0; i < PIPELINE_BUCKETS; ++i)
+    buckets[i] = 0;
+}
+
+/** @brief Estimate value not exceeded by \a part of samples
+ *
+ * Result is upper bound of bucket, so it is exact to factor of two.
+ *----------------------------------------------------------------------------*/
+qint64 PipelineMetrics::Histogram::percentile(double part) const
+{
+  if (!count)
+    return 0;
+
+  qint64 target = qMax(qint64(1), qint64(part * count + 0.5));
+  qint64 cumulative = 0;
+  for (int i = 0; i < PIPELINE_BUCKETS; ++i) {
+    cumulative += buckets[i];
+    if (cumulative >= target) {
+      qint64 upper = i ? (Q_INT64_C(1) << i) - 1 : 0;
+      return qMin(upper, max);
+    }
+  }
+  return max;
+}
+
+/** @brief Add value of \a stage to its histogram and to feed values
+ *----------------------------------------------------------------------------*/
+void PipelineMetrics::record(Stage stage, qint64 value, int feedId)
+{
+  if ((stage < 0) || (stage >= StageCount))
+    return;
+  value = qMax(qint64(0), value);
+
+  int bucket = 0;
+  for (qint64 v = value; v && (bucket < PIPELINE_BUCKETS - 1); v >>= 1)
+    bucket++;
+
+  QMutexLocker locker(&mutex_);
+  Histogram &histogram = histograms_[stage];
+  histogram.count++;
+  histogram.sum += value;
+  histogram.max = qMax(histogram.max, value);
+  histogram.buckets[bucket]++;
+
+  if (feedId > 0) {
+    QVector<qint64> &values = feedValues_[feedId];
+    if (values.isEmpty())
+      values.fill(-1, StageCount);
+    values[stage] = value;
+  }
+}
+
+/** @brief Count failed requests of feed
+ *
+ * \a result is result of RequestFeed::getUrlDone(): negative on error,
+ * -3 on timeout.
+ *----------------------------------------------------------------------------*/
+void PipelineMetrics::recordRequest(int feedId, int result, const QString &error)
+{
+  QMutexLocker locker(&mutex_);
+  if (result >= 0) {
+    QHash<int, FeedFailures>::iterator it = failures_.find(feedId);
+    if (it != failures_.end())
+      it.value().consecutive = 0;
+    return;
+  }
+
+  FeedFailures &failures = failures_[feedId];
+  failures.count++;
+  failures.consecutive++;
+  if (result == -3)
+    failures.timeouts++;
+  failures.error = error;
+}
+
+/** @brief Add \a time (ms) of SQL statement to its statistics
+ *----------------------------------------------------------------------------*/
+void PipelineMetrics::recordStatement(const char *sql, qint64 time)
+{
+  QString key = SQLiteDriver::normalizeStatement(QString::fromUtf8(sql));
+
+  QMutexLocker locker(&mutex_);
+  QHash<QString, Statement>::iterator it = statements_.find(key);
+  if (it == statements_.end()) {
+    if (statements_.count() >= PIPELINE_MAX_STATEMENTS)
+      return;
+    it = statements_.insert(key, Statement());
+    it.value().sql = key;
+  }
+  Statement &statement = it.value();
+  statement.count++;
+  statement.total += time;
+  statement.max = qMax(statement.max, time);
+}
+
+/** @brief Count wakeup of update worker by \a source
+ *
+ * Wakeup is \a idle when worker found nothing to do, such wakeups keep
+ * process busy between updates.
+ *----------------------------------------------------------------------------*/
+void PipelineMetrics::recordWakeup(Wakeup source, bool idle)
+{
+  QMutexLocker locker(&mutex_);
+  Wakeups &wakeups = wakeups_[source];
+  wakeups.count++;
+  if (idle)
+    wakeups.idle++;
+}
+
+void PipelineMetrics::reset()
+{
+  QMutexLocker locker(&mutex_);
+  histograms_ = QVector<Histogram>(StageCount);
+  feedValues_.clear();
+  failures_.clear();
+  statements_.clear();
+  wakeups_ = QVector<Wakeups>(WakeupCount);
+}
+
+QString PipelineMetrics::stageName(int stage)
+{
+  switch (stage) {
+  case QueueWait: return "queueWait";
+  case Ttfb:      return "ttfb";
+  case Download:  return "download";
+  case Bytes:     return "bytes";
+  case Decode:    return "decode";
+  case Parse:     return "parse";
+  case Dedup:     return "dedup";
+  case Insert:    return "insert";
+  case Filter:    return "filter";
+  case Recount:   return "recount";
+  case Store:     return "store";
+  case UiApply:   return "uiApply";
+  }
+  return QString();
+}
+
+QString PipelineMetrics::wakeupName(int source)
+{
+  switch (source) {
+  case WakeFeedQueue:   return "feedQueue";
+  case WakeFeedTimeout: return "feedTimeout";
+  case WakeIconQueue:   return "iconQueue";
+  case WakeIconTimeout: return "iconTimeout";
+  case WakeParseQueue:  return "parseQueue";
+  }
+  return QString();
+}
+
+/** @brief Copy of histograms for display
+ *----------------------------------------------------------------------------*/
+QVector<PipelineMetrics::Histogram> PipelineMetrics::histograms()
+{
+  QMutexLocker locker(&mutex_);
+  return histograms_;
+}
+
+/** @brief Feeds with the largest sum of last values of \a stages
+ *----------------------------------------------------------------------------*/
+QList<PipelineMetrics::FeedValue> PipelineMetrics::topFeeds(const QList<Stage> &stages,
+                                                            int count)
+{
+  QList<FeedValue> feeds;
+  {
+    QMutexLocker locker(&mutex_);
+    QHash<int, QVector<qint64> >::const_iterator it = feedValues_.constBegin();
+    for (; it != feedValues_.constEnd(); ++it) {
+      qint64 sum = -1;
+      foreach (Stage stage, stages) {
+        qint64 value = it.value().at(stage);
+        if (value >= 0)
+          sum = qMax(qint64(0), sum) + value;
+      }
+      if (sum >= 0)
+        feeds.append(FeedValue(it.key(), sum));
+    }
+  }
+
+  std::sort(feeds.begin(), feeds.end(), feedValueMoreThan);
+  return feeds.mid(0, count);
+}
+
+/** @brief Cost of last update of feed: download, decode, parse and store
+ *
+ * Returns -1 if none of these stages is recorded for feed.
+ *----------------------------------------------------------------------------*/
+qint64 PipelineMetrics::feedCost(int feedId)
+{
+  static const Stage stages[] = { Download, Decode, Parse, Store };
+
+  QMutexLocker locker(&mutex_);
+  QHash<int, QVector<qint64> >::const_iterator it = feedValues_.constFind(feedId);
+  if (it == feedValues_.constEnd())
+    return -1;
+
+  qint64 sum = -1;
+  for (unsigned i = 0; i < sizeof(stages) / sizeof(stages[0]); ++i) {
+    qint64 value = it.value().at(stages[i]);
+    if (value >= 0)
+      sum = qMax(qint64(0), sum) + value;
+  }
+  return sum;
+}
+
+QHash<int, PipelineMetrics::FeedFailures> PipelineMetrics::failures()
+{
+  QMutexLocker locker(&mutex_);
+  return failures_;
+}
+
+/** @brief Statements with the largest total time
+ *----------------------------------------------------------------------------*/
+QList<PipelineMetrics::Statement> PipelineMetrics::slowStatements(int count)
+{
+  QList<Statement> statements;
+  {
+    QMutexLocker locker(&mutex_);
+    statements = statements_.values();
+  }
+
+  std::sort(statements.begin(), statements.end(), statementMoreThan);
+  return statements.mid(0, count);
+}
+
+QVector<PipelineMetrics::Wakeups> PipelineMetrics::wakeups()
+{
+  QMutexLocker locker(&mutex_);
+  return wakeups_;
+}
+
+QString PipelineMetrics::jsonString(const QString &text)
+{
+  QString result = text;
+  result.replace('\\', "\\\\").replace('"', "\\\"");
+  result.replace('\n', "\\n").replace('\t', "\\t");
+  return "\"" + result + "\"";
+}
+
+/** @brief Export histograms and last values of feeds as JSON
+ *----------------------------------------------------------------------------*/
+QString PipelineMetrics::toJson()
+{
+  QMutexLocker locker(&mutex_);
+
+  QStringList stages;
+  for (int i = 0; i < StageCount; ++i) {
+    const Histogram &histogram = histograms_.at(i);
+    QStringList buckets;
+    for (int j = 0; j < PIPELINE_BUCKETS; ++j)
+      buckets.append(QString::number(histogram.buckets[j]));
+    qint64 avg = histogram.count ? histogram.sum / histogram.count : 0;
+    stages.append(QString("    \"%1\": {\"count\": %2, \"sum\": %3, \"avg\": %4, "
+                          "\"p50\": %5, \"p90\": %6, \"p99\": %7, \"max\": %8,\n"
+                          "      \"buckets\": [%9]}").
+                  arg(stageName(i)).arg(histogram.count).arg(histogram.sum).arg(avg).
+                  arg(histogram.percentile(0.5)).arg(histogram.percentile(0.9)).
+                  arg(histogram.percentile(0.99)).arg(histogram.max).
+                  arg(buckets.join(", ")));
+  }
+
+  QStringList feeds;
+  QHash<int, QVector<qint64> >::const_iterator it = feedValues_.constBegin();
+  for (; it != feedValues_.constEnd(); ++it) {
+    QStringList values;
+    for (int i = 0; i < StageCount; ++i) {
+      if (it.value().at(i) >= 0)
+        values.append(QString("\"%1\": %2").arg(stageName(i)).arg(it.value().at(i)));
+    }
+    feeds.append(QString("    \"%1\": {%2}").arg(it.key()).arg(values.join(", ")));
+  }
+
+  QStringList failures;
+  QHash<int, FeedFailures>::const_iterator failure = failures_.constBegin();
+  for (; failure != failures_.constEnd(); ++failure) {
+    failures.append(QString("    \"%1\": {\"count\": %2, \"timeouts\": %3, "
+                            "\"consecutive\": %4, \"error\": %5}").
+                    arg(failure.key()).arg(failure.value().count).
+                    arg(failure.value().timeouts).arg(failure.value().consecutive).
+                    arg(jsonString(failure.value().error)));
+  }
+
+  QStringList statements;
+  foreach (const Statement &statement, statements_) {
+    statements.append(QString("    {\"count\": %1, \"total\": %2, \"max\": %3, \"sql\": %4}").
+                      arg(statement.count).arg(statement.total).arg(statement.max).
+                      arg(jsonString(statement.sql)));
+  }
+
+  QStringList wakeups;
+  for (int i = 0; i < WakeupCount; ++i) {
+    wakeups.append(QString("    \"%1\": {\"count\": %2, \"idle\": %3}").
+                   arg(wakeupName(i)).arg(wakeups_.at(i).count).arg(wakeups_.at(i).idle));
+  }
+
+  return QString("{\n  \"units\": {\"time\": \"ms\", \"bytes\": \"bytes\"},\n"
+                 "  \"stages\": {\n%1\n  },\n"
+                 "  \"feeds\": {\n%2\n  },\n"
+                 "  \"failures\": {\n%3\n  },\n"
+                 "  \"statements\": [\n%4\n  ],\n"
+                 "  \"wakeups\": {\n%5\n  }\n}\n").
+      arg(stages.join(",\n"), feeds.join(",\n"),
+          failures.join(",\n"), statements.join(",\n"), wakeups.join(",\n"));
+}
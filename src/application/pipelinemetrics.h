@@ -0,0 +1,136 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef PIPELINEMETRICS_H
+#define PIPELINEMETRICS_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+// Histogram buckets: bucket i holds values of bit length i
+#define PIPELINE_BUCKETS 40
+// Maximum number of different SQL statements kept in statistics
+#define PIPELINE_MAX_STATEMENTS 500
+
+/** @brief Latency histograms of feed update stages
+ *
+ * Stages are recorded from network, parse and database threads, so all
+ * access is serialized by mutex. Times are in milliseconds, Bytes stage
+ * holds size of reply.
+ *----------------------------------------------------------------------------*/
+class PipelineMetrics
+{
+public:
+  enum Stage {
+    QueueWait = 0,  // request waits in host queue
+    Ttfb,           // request sent till first data
+    Download,       // first data till reply finished
+    Bytes,          // size of received data, decoded size if Qt decodes it
+    Decode,         // conversion of data to unicode
+    Parse,          // reading xml into DOM
+    Dedup,          // search of duplicates and preparing news
+    Insert,         // insert of new news into base
+    Filter,         // user filters on new news
+    Recount,        // recount of feed and folders counters
+    Store,          // whole writing of feed into base
+    UiApply,        // apply of counters to feeds tree
+    StageCount
+  };
+
+  // Timers and queued calls which wake workers of update
+  enum Wakeup {
+    WakeFeedQueue = 0,  // dispatch of feeds request queues
+    WakeFeedTimeout,    // timer wheel of feeds requests
+    WakeIconQueue,      // dispatch of icons request queue
+    WakeIconTimeout,    // deadlines of icons requests
+    WakeParseQueue,     // dispatch of parsed feeds queue
+    WakeupCount
+  };
+
+  struct Wakeups {
+    Wakeups() : count(0), idle(0) {}
+
+    qint64 count;
+    qint64 idle;    // woken without work to do
+  };
+
+  struct Histogram {
+    Histogram();
+    qint64 percentile(double part) const;
+
+    qint64 count;
+    qint64 sum;
+    qint64 max;
+    qint64 buckets[PIPELINE_BUCKETS];
+  };
+
+  struct FeedFailures {
+    FeedFailures() : count(0), timeouts(0), consecutive(0) {}
+
+    int count;
+    int timeouts;
+    int consecutive;
+    QString error;
+  };
+
+  struct Statement {
+    Statement() : count(0), total(0), max(0) {}
+
+    QString sql;
+    qint64 count;
+    qint64 total;
+    qint64 max;
+  };
+
+  typedef QPair<int, qint64> FeedValue;
+
+  static void record(Stage stage, qint64 value, int feedId = 0);
+  static void recordRequest(int feedId, int result, const QString &error);
+  static void recordStatement(const char *sql, qint64 time);
+  static void recordWakeup(Wakeup source, bool idle);
+  static void reset();
+
+  static QString stageName(int stage);
+  static QString wakeupName(int source);
+  static QVector<Histogram> histograms();
+  static QList<FeedValue> topFeeds(const QList<Stage> &stages, int count);
+  static qint64 feedCost(int feedId);
+  static QHash<int, FeedFailures> failures();
+  static QList<Statement> slowStatements(int count);
+  static QVector<Wakeups> wakeups();
+  static QString toJson();
+
+private:
+  explicit PipelineMetrics();
+
+  static QString jsonString(const QString &text);
+
+  static QMutex mutex_;
+  static QVector<Histogram> histograms_;
+  // Last values of each stage per feed
+  static QHash<int, QVector<qint64> > feedValues_;
+  static QHash<int, FeedFailures> failures_;
+  static QHash<QString, Statement> statements_;
+  static QVector<Wakeups> wakeups_;
+
+};
+
+#endif // PIPELINEMETRICS_H
@@ -18,8 +18,15 @@
 #include "settings.h"
 
 #include <QCoreApplication>
+#include <QMutex>
+#include <QThread>
 
 QSettings *Settings::settings_ = 0;
+QSharedPointer<const SettingsSnapshot> Settings::snapshot_;
+bool Settings::snapshotStale_ = false;
+
+// Guards pointer of snapshot and its stale flag, not options inside it
+static QMutex snapshotMutex;
 
 Settings::Settings()
 {
@@ -31,6 +38,15 @@ Settings::~Settings()
 {
   if (!settings_->group().isEmpty())
     settings_->endGroup();
+
+  // Options written by workers are published by next writer of main thread
+  if (!qApp || (QThread::currentThread() != qApp->thread()))
+    return;
+  QMutexLocker locker(&snapshotMutex);
+  bool stale = snapshotStale_;
+  locker.unlock();
+  if (stale)
+    publishSnapshot();
 }
 
 void Settings::createSettings(const QString &fileName)
@@ -43,6 +59,7 @@ void Settings::createSettings(const QString &fileName)
                               QCoreApplication::organizationName(),
                               QCoreApplication::applicationName());
   }
+  publishSnapshot();
 }
 
 QSettings* Settings::getSettings()
@@ -73,6 +90,8 @@ void Settings::endGroup()
 void Settings::setValue(const QString &key, const QVariant &defaultValue)
 {
   settings_->setValue(key, defaultValue);
+  QMutexLocker locker(&snapshotMutex);
+  snapshotStale_ = true;
 }
 
 QVariant Settings::value(const QString &key, const QVariant &defaultValue)
@@ -84,3 +103,113 @@ bool Settings::contains(const QString &key)
 {
   return settings_->contains(key);
 }
+
+/** @brief Current snapshot of options, safe to use from any thread
+ *----------------------------------------------------------------------------*/
+QSharedPointer<const SettingsSnapshot> Settings::snapshot()
+{
+  QMutexLocker locker(&snapshotMutex);
+  return snapshot_;
+}
+
+/** @brief Read options from ini-file and replace snapshot
+ *
+ * Called in main thread on load and when Settings object which wrote
+ * options is destroyed. Callers which use new options at once, before
+ * their Settings object is destroyed, call it directly.
+ *----------------------------------------------------------------------------*/
+void Settings::publishSnapshot()
+{
+  {
+    // Options written after this are published again
+    QMutexLocker locker(&snapshotMutex);
+    snapshotStale_ = false;
+  }
+
+  // Keys are read from root, group of caller is restored
+  QString group = settings_->group();
+  while (!settings_->group().isEmpty())
+    settings_->endGroup();
+
+  SettingsSnapshot *snapshot = new SettingsSnapshot;
+
+  snapshot->synchronousDB = settings_->value("synchronousDB").toString();
+  snapshot->incrementalVacuum = settings_->value("incrementalVacuum", true).toBool();
+  snapshot->storageProfile = settings_->value("storageProfile", "balanced").toString();
+
+  snapshot->cleanupOnShutdown = settings_->value("Settings/cleanupOnShutdown", true).toBool();
+  snapshot->optimizeDB = settings_->value("Settings/optimizeDB", false).toBool();
+  readCleanUp(snapshot->shutdownCleanUp, "Settings");
+  readCleanUp(snapshot->wizardCleanUp, "CleanUpWizard");
+  snapshot->fullCleanUp = settings_->value("CleanUpWizard/fullCleanUp", false).toBool();
+
+  snapshot->styleApplication =
+      settings_->value("Settings/styleApplication", "defaultStyle_").toString();
+  snapshot->newsToolBarIconSize =
+      settings_->value("Settings/newsToolBarIconSize", "toolBarIconSmall_").toString();
+  snapshot->styleSheetNews = settings_->value("Settings/styleSheetNews").toString();
+  snapshot->showCloseButtonTab = settings_->value("Settings/showCloseButtonTab", true).toBool();
+  snapshot->newsToolBar = settings_->value(
+        "Settings/newsToolBar",
+        "markNewsRead,markAllNewsRead,Separator,markStarAct,"
+        "newsLabelAction,shareMenuAct,openInExternalBrowserAct,Separator,"
+        "nextUnreadNewsAct,prevUnreadNewsAct,Separator,"
+        "newsFilter,Separator,deleteNewsAct").toString();
+  snapshot->newsTabSplitterState = settings_->value("NewsTabSplitterState").toByteArray();
+
+  snapshot->timeoutRequest = settings_->value("Settings/timeoutRequest", 15).toInt();
+  snapshot->numberRequests = settings_->value("Settings/numberRequest", 10).toInt();
+  snapshot->numberRepeats = settings_->value("Settings/numberRepeats", 2).toInt();
+  snapshot->maxFeedSize = settings_->value("Settings/maxFeedSize", 20).toInt();
+  snapshot->http2Enabled = settings_->value("Settings/http2Enabled", false).toBool();
+
+  snapshot->parseThreads = settings_->value("Settings/parseThreads",
+                                            QThread::idealThreadCount()).toInt();
+  snapshot->saveDBMemFileInterval = settings_->value("Settings/saveDBMemFileInterval", 30).toInt();
+  snapshot->adaptiveUpdate = settings_->value("Settings/adaptiveUpdate", true).toBool();
+  snapshot->staggeredUpdate = settings_->value("Settings/staggeredUpdate", true).toBool();
+  snapshot->updateCostBudget = settings_->value("Settings/updateCostBudget", 30).toInt();
+  snapshot->cleanUpPending = settings_->value("Settings/cleanUpPending", false).toBool();
+  snapshot->webSubEnabled = settings_->value("Settings/webSubEnabled", false).toBool();
+  snapshot->webSubPort = settings_->value("Settings/webSubPort", 8089).toInt();
+  snapshot->webSubCallbackUrl = settings_->value("Settings/webSubCallbackUrl").toString();
+  snapshot->syncEnabled = settings_->value("Settings/syncEnabled", false).toBool();
+  snapshot->syncApiUrl = settings_->value("Settings/syncApiUrl").toString();
+  snapshot->syncUser = settings_->value("Settings/syncUser").toString();
+  snapshot->syncPassword = settings_->value("Settings/syncPassword").toString();
+  snapshot->syncInterval = settings_->value("Settings/syncInterval", 30).toInt();
+  snapshot->prefetchImages = settings_->value("Settings/prefetchImages", false).toBool();
+  snapshot->prefetchRequests = settings_->value("Settings/prefetchRequests", 2).toInt();
+  snapshot->prefetchBandwidth = settings_->value("Settings/prefetchBandwidth", 256).toInt();
+  snapshot->fetchArticles = settings_->value("Settings/fetchArticles", false).toBool();
+  snapshot->fetchArticlesRequests = settings_->value("Settings/fetchArticlesRequests", 2).toInt();
+
+  snapshot->autoLoadImages = settings_->value("Settings/autoLoadImages", true).toBool();
+  snapshot->showDescriptionNews = settings_->value("Settings/showDescriptionNews", true).toBool();
+  snapshot->showNotifyOn = settings_->value("Settings/showNotifyOn", true).toBool();
+  snapshot->markIdenticalNewsRead = settings_->value("Settings/markIdenticalNewsRead", true).toBool();
+  snapshot->newsLayout = settings_->value("Settings/newsLayout", 0).toInt();
+  snapshot->avoidOldNews = settings_->value("Settings/avoidOldNews", false).toBool();
+  snapshot->avoidedOldNewsDate = settings_->value("Settings/avoidedOldNewsDate").toDate();
+
+  if (!group.isEmpty())
+    settings_->beginGroup(group);
+
+  QSharedPointer<const SettingsSnapshot> published(snapshot);
+  QMutexLocker locker(&snapshotMutex);
+  snapshot_ = published;
+}
+
+void Settings::readCleanUp(SettingsSnapshot::CleanUp &cleanUp, const QString &group)
+{
+  QString prefix = group + "/";
+  cleanUp.dayCleanUpOn = settings_->value(prefix + "dayClearUpOn", true).toBool();
+  cleanUp.maxDayCleanUp = settings_->value(prefix + "maxDayClearUp", 30).toInt();
+  cleanUp.newsCleanUpOn = settings_->value(prefix + "newsClearUpOn", true).toBool();
+  cleanUp.maxNewsCleanUp = settings_->value(prefix + "maxNewsClearUp", 200).toInt();
+  cleanUp.readCleanUp = settings_->value(prefix + "readClearUp", false).toBool();
+  cleanUp.neverUnreadCleanUp = settings_->value(prefix + "neverUnreadClearUp", true).toBool();
+  cleanUp.neverStarCleanUp = settings_->value(prefix + "neverStarClearUp", true).toBool();
+  cleanUp.neverLabelCleanUp = settings_->value(prefix + "neverLabelClearUp", true).toBool();
+  cleanUp.cleanUpDeleted = settings_->value(prefix + "cleanUpDeleted", false).toBool();
+}
@@ -18,9 +18,90 @@
 #ifndef SETTINGS_H
 #define SETTINGS_H
 
+#include <QDate>
 #include <QSettings>
+#include <QSharedPointer>
 #include <QVariant>
 
+/** @brief Typed copy of options used on hot paths and in worker threads
+ *
+ * Snapshot is not changed after it is published, threads keep their copy
+ * while new options are applied. It is published again when Settings
+ * object which wrote options is destroyed in main thread.
+ *----------------------------------------------------------------------------*/
+struct SettingsSnapshot
+{
+  // Criteria of news cleanup
+  struct CleanUp {
+    bool dayCleanUpOn;
+    int maxDayCleanUp;
+    bool newsCleanUpOn;
+    int maxNewsCleanUp;
+    bool readCleanUp;
+    bool neverUnreadCleanUp;
+    bool neverStarCleanUp;
+    bool neverLabelCleanUp;
+    bool cleanUpDeleted;
+  };
+
+  // Storage
+  QString synchronousDB;              // empty for default of journal mode
+  bool incrementalVacuum;
+  QString storageProfile;
+
+  // Cleanup on shutdown and by wizard
+  bool cleanupOnShutdown;
+  bool optimizeDB;
+  CleanUp shutdownCleanUp;
+  CleanUp wizardCleanUp;
+  bool fullCleanUp;
+
+  // Requests of feeds
+  int timeoutRequest;                 // seconds
+  int numberRequests;
+  int numberRepeats;
+  int maxFeedSize;                    // MB
+  bool http2Enabled;
+
+  // Update of feeds
+  int parseThreads;
+  int saveDBMemFileInterval;          // minutes
+  bool adaptiveUpdate;
+  bool staggeredUpdate;
+  int updateCostBudget;               // seconds
+  bool cleanUpPending;
+  bool webSubEnabled;
+  int webSubPort;
+  QString webSubCallbackUrl;
+  bool syncEnabled;
+  QString syncApiUrl;
+  QString syncUser;
+  QString syncPassword;
+  int syncInterval;                   // minutes
+  bool prefetchImages;
+  int prefetchRequests;
+  int prefetchBandwidth;              // KB/s, 0 - unlimited
+  bool fetchArticles;
+  int fetchArticlesRequests;
+
+  // Parse of news
+  bool autoLoadImages;
+  bool showDescriptionNews;
+  bool showNotifyOn;
+  bool markIdenticalNewsRead;
+  int newsLayout;
+  bool avoidOldNews;
+  QDate avoidedOldNewsDate;
+
+  // News tabs
+  QString styleApplication;
+  QString newsToolBarIconSize;
+  QString styleSheetNews;
+  bool showCloseButtonTab;
+  QString newsToolBar;
+  QByteArray newsTabSplitterState;
+};
+
 class Settings
 {
 public:
@@ -39,8 +120,15 @@ public:
   QVariant value(const QString &key, const QVariant &defaultValue = QVariant());
   bool contains(const QString &key);
 
+  static QSharedPointer<const SettingsSnapshot> snapshot();
+  static void publishSnapshot();
+
 private:
+  static void readCleanUp(SettingsSnapshot::CleanUp &cleanUp, const QString &group);
+
   static QSettings* settings_;
+  static QSharedPointer<const SettingsSnapshot> snapshot_;
+  static bool snapshotStale_;
 
 };
 
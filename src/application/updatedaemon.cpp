@@ -0,0 +1,154 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "updatedaemon.h"
+
+#include "mainapplication.h"
+#include "requestfeed.h"
+#include "settings.h"
+#include "updatefeeds.h"
+
+#include <QDebug>
+#include <QSqlQuery>
+
+#if defined(Q_OS_UNIX)
+#include <signal.h>
+#endif
+
+// Time between cleanups of base (s)
+#define CLEANUP_INTERVAL (24*60*60)
+
+#if defined(Q_OS_UNIX)
+static volatile sig_atomic_t terminateRequested = 0;
+
+static void terminateHandler(int)
+{
+  terminateRequested = 1;
+}
+#endif
+
+UpdateDaemon::UpdateDaemon(QObject *parent)
+  : QObject(parent)
+  , updateIntervalSec_(0)
+  , updateTimeCount_(0)
+  , cleanUpTimeCount_(0)
+  , closing_(false)
+{
+  setObjectName("updateDaemon_");
+
+  timer_ = new QTimer(this);
+  connect(timer_, SIGNAL(timeout()), this, SLOT(slotTimer()));
+
+#if defined(Q_OS_UNIX)
+  // Service manager stops daemon by signal, data is saved as on exit
+  signal(SIGTERM, terminateHandler);
+  signal(SIGINT, terminateHandler);
+#endif
+}
+
+/** @brief Start schedule, update objects must be connected before
+ *---------------------------------------------------------------------------*/
+void UpdateDaemon::start()
+{
+  loadIntervals();
+  timer_->start(1000);
+
+  qWarning() << QString("Headless mode: update interval %1 s, %2 feeds with own interval").
+                arg(updateIntervalSec_).arg(updateFeedsIntervalSec_.count());
+  emit signalGetAllFeeds(RequestFeed::PriorityStartup);
+}
+
+/** @brief Read intervals of updates from settings and feeds table
+ *
+ * Daemon exists to keep base fresh, so global interval is used even if
+ * automatic update is switched off in options.
+ *---------------------------------------------------------------------------*/
+void UpdateDaemon::loadIntervals()
+{
+  Settings settings;
+  int updateInterval = settings.value("Settings/autoUpdatefeedsTime", 10).toInt();
+  int updateIntervalType = settings.value("Settings/autoUpdatefeedsInterval", 0).toInt();
+  if (updateIntervalType == 0)
+    updateInterval = updateInterval*60;
+  else if (updateIntervalType == 1)
+    updateInterval = updateInterval*60*60;
+  updateIntervalSec_ = qMax(60, updateInterval);
+
+  QSqlQuery q;
+  q.exec("SELECT id, updateInterval, updateIntervalType FROM feeds WHERE xmlUrl != '' AND updateIntervalEnable == 1");
+  while (q.next()) {
+    int updateInterval = q.value(1).toInt();
+    int updateIntervalType = q.value(2).toInt();
+    if (updateIntervalType == 0)
+      updateInterval = updateInterval*60;
+    else if (updateIntervalType == 1)
+      updateInterval = updateInterval*60*60;
+
+    updateFeedsIntervalSec_.insert(q.value(0).toInt(), updateInterval);
+    updateFeedsTimeCount_.insert(q.value(0).toInt(), 0);
+  }
+}
+
+void UpdateDaemon::slotTimer()
+{
+#if defined(Q_OS_UNIX)
+  if (terminateRequested) {
+    quitApp();
+    return;
+  }
+#endif
+
+  updateTimeCount_++;
+  if (updateTimeCount_ >= updateIntervalSec_) {
+    updateTimeCount_ = 0;
+
+    emit signalGetAllFeedsTimer(updateIntervalSec_);
+  }
+
+  QMap<int, int>::iterator it = updateFeedsTimeCount_.begin();
+  for (; it != updateFeedsTimeCount_.end(); ++it) {
+    it.value()++;
+    if (it.value() >= updateFeedsIntervalSec_.value(it.key())) {
+      it.value() = 0;
+
+      emit signalGetFeedTimer(it.key());
+    }
+  }
+
+  cleanUpTimeCount_++;
+  if (cleanUpTimeCount_ >= CLEANUP_INTERVAL) {
+    cleanUpTimeCount_ = 0;
+
+    emit signalCleanUp();
+  }
+}
+
+/** @brief Stop updates, save data and quit application
+ *---------------------------------------------------------------------------*/
+void UpdateDaemon::quitApp()
+{
+  if (closing_)
+    return;
+  closing_ = true;
+
+  qWarning() << "Headless mode: quit";
+  timer_->stop();
+  mainApp->setClosing();
+  emit signalStopUpdate();
+  mainApp->updateFeeds()->disconnectObjects();
+  emit signalQuitApp();
+}
@@ -0,0 +1,66 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef UPDATEDAEMON_H
+#define UPDATEDAEMON_H
+
+#include <QMap>
+#include <QObject>
+#include <QTimer>
+
+/** @brief Schedule of feed updates without main window
+ *
+ * Replaces main window for update objects in headless mode: feeds are
+ * updated on start, by global and own intervals of feeds, and base is
+ * cleaned up once in a while by criteria of cleanup on shutdown.
+ *----------------------------------------------------------------------------*/
+class UpdateDaemon : public QObject
+{
+  Q_OBJECT
+public:
+  explicit UpdateDaemon(QObject *parent = 0);
+
+  void start();
+
+public slots:
+  void quitApp();
+
+signals:
+  void signalStopUpdate();
+  void signalGetFeedTimer(int feedId);
+  void signalGetAllFeedsTimer(int updateInterval);
+  void signalGetAllFeeds(int priority);
+  void signalCleanUp();
+  void signalQuitApp();
+
+private slots:
+  void slotTimer();
+
+private:
+  void loadIntervals();
+
+  QTimer *timer_;
+  int updateIntervalSec_;
+  int updateTimeCount_;
+  int cleanUpTimeCount_;
+  QMap<int, int> updateFeedsIntervalSec_;
+  QMap<int, int> updateFeedsTimeCount_;
+  bool closing_;
+
+};
+
+#endif // UPDATEDAEMON_H
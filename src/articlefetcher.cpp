@@ -0,0 +1,368 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "articlefetcher.h"
+
+#include "mainapplication.h"
+#include "logfile.h"
+#include "sharednetworkcache.h"
+
+#include <QNetworkReply>
+#include <QStringList>
+#include <QTextCodec>
+#include <qwebkitversion.h>
+#include <qzregexp.h>
+
+// Maximum number of news waiting for request
+#define ARTICLE_QUEUE_MAX 500
+// Page is not loaded till end if it exceeds this size (bytes)
+#define ARTICLE_MAX_SIZE (2*1024*1024)
+// Time of request (ms) after which it is aborted
+#define ARTICLE_TIMEOUT 30000
+// Maximum number of followed redirects
+#define ARTICLE_MAX_REDIRECTS 5
+// Paragraphs with shorter text are not counted as text of article
+#define ARTICLE_MIN_PARAGRAPH 25
+// Text between paragraphs of one article is shorter than this
+#define ARTICLE_MAX_GAP 300
+// Article is not stored if its text is shorter
+#define ARTICLE_MIN_TEXT 250
+
+ArticleFetcher::ArticleFetcher(int maxRequests, QObject *parent)
+  : QObject(parent)
+  , maxRequests_(qMax(maxRequests, 1))
+{
+  setObjectName("articleFetcher_");
+
+  clock_.start();
+
+  networkManager_ = new NetworkManager(true, this);
+  networkManager_->setCache(new SharedNetworkCache(SharedNetworkCache::Prefetch));
+  // Pages are loaded in background, user is not asked about certificates
+  networkManager_->disconnect(mainApp->networkManager());
+  connect(networkManager_, SIGNAL(finished(QNetworkReply*)),
+          this, SLOT(finished(QNetworkReply*)));
+
+  timeout_ = new QTimer(this);
+  timeout_->setInterval(1000);
+  connect(timeout_, SIGNAL(timeout()), this, SLOT(slotRequestTimeout()));
+}
+
+void ArticleFetcher::disconnectObjects()
+{
+  disconnect(this);
+  networkManager_->disconnect(networkManager_);
+}
+
+/** @brief Put link of news in queue
+ *----------------------------------------------------------------------------*/
+void ArticleFetcher::fetchArticle(int newsId, const QString &link)
+{
+  if (queue_.count() >= ARTICLE_QUEUE_MAX)
+    return;
+
+  QueuedArticle article;
+  article.newsId = newsId;
+  article.url = QUrl::fromEncoded(link.toUtf8());
+  article.redirects = 0;
+  if (!article.url.scheme().startsWith("http"))
+    return;
+  queue_.enqueue(article);
+
+  if (!timeout_->isActive())
+    timeout_->start();
+  startRequests();
+}
+
+/** @brief Clear queue and abort requests in progress
+ *----------------------------------------------------------------------------*/
+void ArticleFetcher::stop()
+{
+  queue_.clear();
+  foreach (QNetworkReply *reply, replies_.keys())
+    reply->abort();
+}
+
+void ArticleFetcher::startRequests()
+{
+  while ((replies_.count() < maxRequests_) && !queue_.isEmpty()) {
+    QueuedArticle article = queue_.dequeue();
+
+    QNetworkRequest request(article.url);
+    QString userAgent = QString("Mozilla/5.0 (Windows NT 6.1) AppleWebKit/%1 (KHTML, like Gecko) Chrome/77.0.3865.120 Safari/%1").
+        arg(qWebKitVersion());
+    request.setRawHeader("User-Agent", userAgent.toUtf8());
+    request.setRawHeader("Accept", "text/html,application/xhtml+xml;q=0.9,*/*;q=0.5");
+
+    QNetworkReply *reply = networkManager_->get(request);
+    connect(reply, SIGNAL(readyRead()), this, SLOT(slotReadyRead()));
+    replies_.insert(reply, article);
+    started_.insert(reply, clock_.elapsed());
+  }
+}
+
+/** @brief Stop download of too large or not HTML pages
+ *----------------------------------------------------------------------------*/
+void ArticleFetcher::slotReadyRead()
+{
+  QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+  if (!reply)
+    return;
+
+  QString contentType = reply->header(QNetworkRequest::ContentTypeHeader).toString();
+  if ((!contentType.isEmpty() && !contentType.contains("html", Qt::CaseInsensitive)) ||
+      (reply->bytesAvailable() > ARTICLE_MAX_SIZE)) {
+    reply->abort();
+  }
+}
+
+void ArticleFetcher::finished(QNetworkReply *reply)
+{
+  QHash<QNetworkReply*, QueuedArticle>::iterator it = replies_.find(reply);
+  if (it == replies_.end()) {
+    reply->deleteLater();
+    return;
+  }
+  QueuedArticle article = it.value();
+  replies_.erase(it);
+  started_.remove(reply);
+
+  QUrl redirectionTarget = reply->attribute(QNetworkRequest::RedirectionTargetAttribute).toUrl();
+  if (reply->error() != QNetworkReply::NoError) {
+    LOG_DEBUG(LogFile::Fetch) << "Article request failed:" << article.url.toString()
+                              << reply->errorString();
+  } else if (redirectionTarget.isValid()) {
+    if (article.redirects < ARTICLE_MAX_REDIRECTS) {
+      article.url = article.url.resolved(redirectionTarget);
+      article.redirects++;
+      queue_.prepend(article);
+    }
+  } else {
+    QString contentType = reply->header(QNetworkRequest::ContentTypeHeader).toString();
+    QString html = extractArticle(decodePage(reply->readAll(), contentType), article.url);
+    if (!html.isEmpty())
+      emit signalArticleReady(article.newsId, html);
+    else
+      LOG_DEBUG(LogFile::Fetch) << "Article text not found:" << article.url.toString();
+  }
+  reply->deleteLater();
+
+  startRequests();
+}
+
+/** @brief Abort hung requests
+ *----------------------------------------------------------------------------*/
+void ArticleFetcher::slotRequestTimeout()
+{
+  qint64 now = clock_.elapsed();
+  QList<QNetworkReply*> hungReplies;
+  QHash<QNetworkReply*, qint64>::const_iterator it = started_.constBegin();
+  for (; it != started_.constEnd(); ++it) {
+    if (now - it.value() > ARTICLE_TIMEOUT)
+      hungReplies.append(it.key());
+  }
+  foreach (QNetworkReply *reply, hungReplies)
+    reply->abort();
+
+  if (replies_.isEmpty() && queue_.isEmpty())
+    timeout_->stop();
+}
+
+/** @brief Convert page to unicode using charset of reply or page
+ *----------------------------------------------------------------------------*/
+QString ArticleFetcher::decodePage(const QByteArray &data, const QString &contentType)
+{
+  QTextCodec *codec = 0;
+  int index = contentType.indexOf("charset=", 0, Qt::CaseInsensitive);
+  if (index >= 0) {
+    QString charset = contentType.mid(index + 8).section(';', 0, 0).trimmed();
+    charset.remove('"').remove('\'');
+    codec = QTextCodec::codecForName(charset.toLatin1());
+  }
+  if (!codec)
+    codec = QTextCodec::codecForHtml(data, QTextCodec::codecForName("UTF-8"));
+  return codec->toUnicode(data);
+}
+
+/** @brief Remove all elements with \a tag and their contents
+ *----------------------------------------------------------------------------*/
+void ArticleFetcher::removeElements(QString *page, const QString &tag)
+{
+  QString openTag = "<" + tag;
+  QString closeTag = "</" + tag + ">";
+  int pos = 0;
+  while ((pos = page->indexOf(openTag, pos, Qt::CaseInsensitive)) != -1) {
+    int next = pos + openTag.length();
+    // Other tag with the same prefix, e.g. <header> for <head
+    if ((next < page->length()) && page->at(next).isLetterOrNumber()) {
+      pos = next;
+      continue;
+    }
+    int end = page->indexOf(closeTag, next, Qt::CaseInsensitive);
+    if (end == -1) {
+      end = page->indexOf('>', next);
+      if (end == -1)
+        end = page->length() - 1;
+      page->remove(pos, end - pos + 1);
+    } else {
+      page->remove(pos, end - pos + closeTag.length());
+    }
+  }
+}
+
+/** @brief Make links and image sources of article absolute
+ *----------------------------------------------------------------------------*/
+QString ArticleFetcher::absoluteLinks(const QString &html, const QUrl &baseUrl)
+{
+  QzRegExp rx("(src|href)\\s*=\\s*(\"[^\"]*\"|'[^']*')", Qt::CaseInsensitive);
+  QString result;
+  int last = 0;
+  int pos = 0;
+  while ((pos = rx.indexIn(html, pos)) != -1) {
+    QString value = rx.cap(2);
+    value = value.mid(1, value.length() - 2).trimmed();
+    QString url = value.startsWith('#') ? value : baseUrl.resolved(QUrl(value)).toString();
+    url.replace('"', "%22");
+    result.append(html.mid(last, pos - last));
+    result.append(QString("%1=\"%2\"").arg(rx.cap(1).toLower(), url));
+    pos += rx.matchedLength();
+    last = pos;
+  }
+  result.append(html.mid(last));
+  return result;
+}
+
+/** @brief Find main text of page
+ *
+ * Page is cleaned of scripts, styles and navigation. Then paragraphs
+ * are joined into clusters, paragraphs of one cluster are separated by
+ * little text. Cluster of the longest text without links is article.
+ * Content of <article> element is searched first if page has it.
+ * @return HTML of article or empty string if article is not found
+ *----------------------------------------------------------------------------*/
+QString ArticleFetcher::extractArticle(const QString &html, const QUrl &pageUrl)
+{
+  QString page = html;
+
+  QUrl baseUrl = pageUrl;
+  QzRegExp baseRx("<base[^>]+href\\s*=\\s*['\"]([^'\"]+)['\"]", Qt::CaseInsensitive);
+  if (baseRx.indexIn(page) != -1)
+    baseUrl = pageUrl.resolved(QUrl(baseRx.cap(1)));
+
+  QString leadImage;
+  QzRegExp imageRx("<meta[^>]+property\\s*=\\s*['\"]og:image['\"][^>]+content\\s*=\\s*['\"]([^'\"]+)['\"]",
+                   Qt::CaseInsensitive);
+  if (imageRx.indexIn(page) != -1)
+    leadImage = baseUrl.resolved(QUrl(imageRx.cap(1))).toString();
+
+  int pos = 0;
+  while ((pos = page.indexOf("<!--", pos)) != -1) {
+    int end = page.indexOf("-->", pos + 4);
+    page.remove(pos, (end == -1) ? page.length() - pos : end - pos + 3);
+  }
+  QStringList tags;
+  tags << "head" << "script" << "style" << "noscript" << "iframe" << "form"
+       << "nav" << "header" << "footer" << "aside" << "button" << "select"
+       << "textarea" << "svg";
+  foreach (const QString &tag, tags)
+    removeElements(&page, tag);
+
+  // Main text is inside the longest <article>
+  int rangeStart = 0;
+  int rangeEnd = page.length();
+  int bestLength = 0;
+  pos = 0;
+  while ((pos = page.indexOf("<article", pos, Qt::CaseInsensitive)) != -1) {
+    int end = page.indexOf("</article>", pos, Qt::CaseInsensitive);
+    if (end == -1)
+      end = page.length();
+    if (end - pos > bestLength) {
+      bestLength = end - pos;
+      rangeStart = pos;
+      rangeEnd = end;
+    }
+    pos = end;
+  }
+
+  QzRegExp tagRx("<[^>]*>");
+  QzRegExp linkRx("<a\\s[^>]*>([^<]*)</a>", Qt::CaseInsensitive);
+
+  int clusterStart = -1;
+  int clusterEnd = -1;
+  int clusterScore = 0;
+  int bestStart = -1;
+  int bestEnd = -1;
+  int bestScore = 0;
+  pos = rangeStart;
+  while ((pos = page.indexOf("<p", pos, Qt::CaseInsensitive)) != -1) {
+    if (pos >= rangeEnd)
+      break;
+    int next = pos + 2;
+    if ((next < page.length()) && (page.at(next) != '>') && !page.at(next).isSpace()) {
+      pos = next;
+      continue;
+    }
+    int end = page.indexOf("</p>", next, Qt::CaseInsensitive);
+    int nextParagraph = page.indexOf("<p", next, Qt::CaseInsensitive);
+    if ((end == -1) || ((nextParagraph != -1) && (nextParagraph < end)))
+      end = (nextParagraph == -1) ? qMin(page.length(), rangeEnd) : nextParagraph;
+    else
+      end += 4;
+
+    QString paragraph = page.mid(pos, end - pos);
+    int linksLength = 0;
+    int linkPos = 0;
+    while ((linkPos = linkRx.indexIn(paragraph, linkPos)) != -1) {
+      linksLength += linkRx.cap(1).length();
+      linkPos += linkRx.matchedLength();
+    }
+    int textLength = paragraph.remove(tagRx).simplified().length();
+    int score = textLength - 2 * linksLength;
+
+    if (textLength >= ARTICLE_MIN_PARAGRAPH) {
+      bool joined = false;
+      if (clusterEnd != -1) {
+        QString gap = page.mid(clusterEnd, pos - clusterEnd);
+        joined = (gap.remove(tagRx).simplified().length() <= ARTICLE_MAX_GAP);
+      }
+      if (!joined) {
+        clusterStart = pos;
+        clusterScore = 0;
+      }
+      clusterEnd = end;
+      clusterScore += qMax(score, 0);
+      if (clusterScore > bestScore) {
+        bestScore = clusterScore;
+        bestStart = clusterStart;
+        bestEnd = clusterEnd;
+      }
+    }
+    pos = end;
+  }
+
+  if (bestScore < ARTICLE_MIN_TEXT)
+    return QString();
+
+  QString article = page.mid(bestStart, bestEnd - bestStart);
+  article.remove(QzRegExp("\\s(on\\w+|style|class|id)\\s*=\\s*(\"[^\"]*\"|'[^']*')",
+                          Qt::CaseInsensitive));
+  article.remove(QzRegExp("<input[^>]*>", Qt::CaseInsensitive));
+  article = absoluteLinks(article, baseUrl);
+  if (!leadImage.isEmpty() && !article.contains(leadImage))
+    article.prepend(QString("<p><img src=\"%1\"></p>").arg(leadImage));
+  return article;
+}
@@ -0,0 +1,80 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef ARTICLEFETCHER_H
+#define ARTICLEFETCHER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QQueue>
+#include <QTimer>
+#include <QUrl>
+
+#include "networkmanager.h"
+
+/** @brief Download pages of new news and extract their readable text
+ *
+ * Used for feeds showing page of news link instead of description.
+ * Extracted article is stored with news, so it is shown without loading
+ * of page and also offline.
+ *----------------------------------------------------------------------------*/
+class ArticleFetcher : public QObject
+{
+  Q_OBJECT
+public:
+  explicit ArticleFetcher(int maxRequests, QObject *parent = 0);
+
+  void disconnectObjects();
+
+  static QString extractArticle(const QString &html, const QUrl &pageUrl);
+
+public slots:
+  void fetchArticle(int newsId, const QString &link);
+  void stop();
+
+signals:
+  void signalArticleReady(int newsId, const QString &html);
+
+private slots:
+  void startRequests();
+  void slotReadyRead();
+  void finished(QNetworkReply *reply);
+  void slotRequestTimeout();
+
+private:
+  struct QueuedArticle {
+    int newsId;
+    QUrl url;
+    int redirects;
+  };
+
+  static QString decodePage(const QByteArray &data, const QString &contentType);
+  static void removeElements(QString *page, const QString &tag);
+  static QString absoluteLinks(const QString &html, const QUrl &baseUrl);
+
+  NetworkManager *networkManager_;
+  int maxRequests_;
+  QQueue<QueuedArticle> queue_;
+  QHash<QNetworkReply*, QueuedArticle> replies_;
+  QHash<QNetworkReply*, qint64> started_;
+  QElapsedTimer clock_;
+  QTimer *timeout_;
+
+};
+
+#endif // ARTICLEFETCHER_H
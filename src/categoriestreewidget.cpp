@@ -73,6 +73,12 @@ CategoriesTreeWidget::CategoriesTreeWidget(QWidget * parent)
   treeWidgetItem = new QTreeWidgetItem(treeItem);
   treeWidgetItem->setIcon(0, QIcon(":/images/label_3"));
   addTopLevelItem(treeWidgetItem);
+  QTreeWidgetItem *labelsTreeItem = treeWidgetItem;
+  treeItem.clear();
+  treeItem << tr("Search") << QString::number(NewsTabWidget::TabTypeSearch) << "-1";
+  treeWidgetItem = new QTreeWidgetItem(treeItem);
+  treeWidgetItem->setIcon(0, QIcon(":/images/findText"));
+  addTopLevelItem(treeWidgetItem);
 
   QSqlQuery q;
   q.exec("SELECT id, name, image, currentNews, num, color_bg, color_text FROM labels ORDER BY num");
@@ -93,7 +99,7 @@ CategoriesTreeWidget::CategoriesTreeWidget(QWidget * parent)
     childItem->setData(0, NumRole, q.value(4));
     childItem->setData(0, colorBgRole, q.value(5));
     childItem->setData(0, colorTextRole, q.value(6));
-    treeWidgetItem->addChild(childItem);
+    labelsTreeItem->addChild(childItem);
   }
 
   connect(this, SIGNAL(customContextMenuRequested(QPoint)),
@@ -135,10 +141,10 @@ void CategoriesTreeWidget::showContextMenuCategory(const QPoint &pos)
       itemClicked_ = itemAt(pos);
       QMenu menu;
       menu.addAction(tr("Open in New Tab"), this, SLOT(openCategoryNewTab()));
-      if (itemClicked_ == topLevelItem(2)) {
+      if (itemClicked_ == topLevelItem(DeletedItem)) {
         menu.addSeparator();
         menu.addAction(tr("Clear 'Deleted'"), this, SIGNAL(signalClearDeleted()));
-      } else {
+      } else if (itemClicked_ != topLevelItem(SearchItem)) {
         menu.addSeparator();
         menu.addAction(tr("Mark Read"), this, SLOT(slotMarkRead()));
       }
@@ -31,7 +31,7 @@ class CategoriesTreeWidget : public QTreeWidget
 public:
   explicit CategoriesTreeWidget(QWidget *parent = 0);
 
-  enum Items {UnreadItem, StarredItem, DeletedItem, LabelsItem};
+  enum Items {UnreadItem, StarredItem, DeletedItem, LabelsItem, SearchItem};
   enum LabelRole {ImageRole = Qt::UserRole+1, NumRole, colorBgRole, colorTextRole};
 
   QList<QTreeWidgetItem *> getLabelListItems() const {
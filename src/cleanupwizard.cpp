@@ -22,10 +22,29 @@
 #include "settings.h"
 #include "updatefeeds.h"
 
+// Delay of estimate after options are changed, ms
+#define ESTIMATE_DELAY 300
+
+/** @brief Size in KB, MB or GB
+ *----------------------------------------------------------------------------*/
+static QString sizeToString(qint64 size)
+{
+  double correctSize = size / 1024.0;
+  if (correctSize < 1000)
+    return QString::number(correctSize, 'f', 0) + " KB";
+  correctSize /= 1024;
+  if (correctSize < 1000)
+    return QString::number(correctSize, 'f', 1) + " MB";
+  correctSize /= 1024;
+  return QString::number(correctSize, 'f', 2) + " GB";
+}
+
 CleanUpWizard::CleanUpWizard(QWidget *parent)
   : QWizard(parent)
   , selectedPage_(true)
   , itemNotChecked_(false)
+  , estimateId_(0)
+  , pageSize_(4096)
 {
   setWindowFlags (windowFlags() & ~Qt::WindowContextHelpButtonHint);
   setWindowTitle(tr("Clean Up"));
@@ -34,6 +53,16 @@ CleanUpWizard::CleanUpWizard(QWidget *parent)
   setMinimumWidth(440);
   setMinimumHeight(380);
 
+  QSqlQuery q;
+  q.exec("PRAGMA page_size");
+  if (q.first() && (q.value(0).toInt() > 0))
+    pageSize_ = q.value(0).toInt();
+
+  estimateTimer_ = new QTimer(this);
+  estimateTimer_->setSingleShot(true);
+  estimateTimer_->setInterval(ESTIMATE_DELAY);
+  connect(estimateTimer_, SIGNAL(timeout()), this, SLOT(startEstimate()));
+
   addPage(createChooseFeedsPage());
   addPage(createCleanUpOptionsPage());
 
@@ -86,7 +115,8 @@ QWizardPage *CleanUpWizard::createChooseFeedsPage()
   parentIds.enqueue(0);
   while (!parentIds.empty()) {
     int parentId = parentIds.dequeue();
-    QString qStr = QString("SELECT text, id, image, xmlUrl FROM feeds WHERE parentId='%1' ORDER BY rowToParent").
+    QString qStr = QString("SELECT text, id, (SELECT image FROM feedsIcons WHERE feedId=feeds.id), xmlUrl "
+                           "FROM feeds WHERE parentId='%1' ORDER BY rowToParent").
         arg(parentId);
     q.exec(qStr);
     while (q.next()) {
@@ -191,6 +221,9 @@ QWizardPage *CleanUpWizard::createCleanUpOptionsPage()
   progressBar_->setMaximum(0);
   progressBar_->setVisible(false);
 
+  estimateLabel_ = new QLabel();
+  estimateLabel_->setWordWrap(true);
+
   Settings settings;
   settings.beginGroup("CleanUpWizard");
   maxDayCleanUp_->setValue(settings.value("maxDayClearUp", 30).toInt());
@@ -205,6 +238,18 @@ QWizardPage *CleanUpWizard::createCleanUpOptionsPage()
   fullCleanUp_->setChecked(settings.value("fullCleanUp", false).toBool());
   settings.endGroup();
 
+  // Estimate follows options
+  connect(dayCleanUpOn_, SIGNAL(toggled(bool)), estimateTimer_, SLOT(start()));
+  connect(maxDayCleanUp_, SIGNAL(valueChanged(int)), estimateTimer_, SLOT(start()));
+  connect(newsCleanUpOn_, SIGNAL(toggled(bool)), estimateTimer_, SLOT(start()));
+  connect(maxNewsCleanUp_, SIGNAL(valueChanged(int)), estimateTimer_, SLOT(start()));
+  connect(readCleanUp_, SIGNAL(toggled(bool)), estimateTimer_, SLOT(start()));
+  connect(neverUnreadCleanUp_, SIGNAL(toggled(bool)), estimateTimer_, SLOT(start()));
+  connect(neverStarCleanUp_, SIGNAL(toggled(bool)), estimateTimer_, SLOT(start()));
+  connect(neverLabelCleanUp_, SIGNAL(toggled(bool)), estimateTimer_, SLOT(start()));
+  connect(cleanUpDeleted_, SIGNAL(toggled(bool)), estimateTimer_, SLOT(start()));
+  connect(fullCleanUp_, SIGNAL(toggled(bool)), estimateTimer_, SLOT(start()));
+
   QVBoxLayout *layout = new QVBoxLayout(page);
   layout->addLayout(cleanUpFeedsLayout);
   layout->addSpacing(10);
@@ -213,6 +258,7 @@ QWizardPage *CleanUpWizard::createCleanUpOptionsPage()
   layout->addWidget(fullCleanUp_);
   layout->addLayout(fullCleanUpDescriptionLayout);
   layout->addStretch(1);
+  layout->addWidget(estimateLabel_);
   layout->addWidget(progressBar_);
 
   return page;
@@ -230,6 +276,8 @@ void CleanUpWizard::feedItemChanged(QTreeWidgetItem *item, int column)
 {
   if ((column != 0) || itemNotChecked_) return;
 
+  estimateTimer_->start();
+
   itemNotChecked_ = true;
   if (item->checkState(0) == Qt::Unchecked) {
     setCheckStateItem(item, Qt::Unchecked);
@@ -256,10 +304,127 @@ void CleanUpWizard::setCheckStateItem(QTreeWidgetItem *item, Qt::CheckState stat
 
 void CleanUpWizard::currentIdChanged(int idPage)
 {
-  if (idPage == 1)
+  if (idPage == 1) {
     selectedPage_ = false;
-  else
+    startEstimate();
+  } else {
     selectedPage_ = true;
+  }
+}
+
+/** @brief Ids of checked feeds and folders
+ *----------------------------------------------------------------------------*/
+QStringList CleanUpWizard::checkedFeeds() const
+{
+  QStringList feedsIdList;
+  QTreeWidgetItemIterator it(feedsTree_, QTreeWidgetItemIterator::Checked);
+  while (*it) {
+    if ((*it)->text(1) != "0")
+      feedsIdList << (*it)->text(1);
+    ++it;
+  }
+  return feedsIdList;
+}
+
+/** @brief Estimate news which clean up with current options deletes
+ *
+ * News of chosen feeds are counted by one aggregate query per feed in
+ * database thread, nothing is changed.
+ *----------------------------------------------------------------------------*/
+void CleanUpWizard::startEstimate()
+{
+  estimateTimer_->stop();
+
+  QStringList feedsIdList = checkedFeeds();
+  if (feedsIdList.isEmpty() && !cleanUpDeleted_->isChecked()) {
+    ++estimateId_;
+    estimateLabel_->setText(tr("No feeds are chosen"));
+    return;
+  }
+
+  QString candidateStr = UpdateObject::cleanUpCandidates(neverUnreadCleanUp_->isChecked(),
+                                                         neverStarCleanUp_->isChecked(),
+                                                         neverLabelCleanUp_->isChecked());
+  QString ageStr = "0";
+  if (dayCleanUpOn_->isChecked()) {
+    ageStr = QString("(received!='' AND received < '%1')").
+        arg(QDate::currentDate().addDays(-maxDayCleanUp_->value()).toString(Qt::ISODate));
+  }
+  QString readStr = "0";
+  if (readCleanUp_->isChecked())
+    readStr = fullCleanUp_->isChecked() ? "1" : "read!=0";
+
+  // Per feed: candidates, deleted by age, deleted as read, size of
+  // candidates and news count of feed for maximum number of news
+  QStringList selectList;
+  if (!feedsIdList.isEmpty()) {
+    selectList << QString("SELECT feedId, count(*), sum(%1 OR %2), "
+                          "sum(ifnull(length(description), 0) + ifnull(length(content), 0)), "
+                          "(SELECT undeleteCount FROM feedsState WHERE feedsState.feedId=news.feedId) "
+                          "FROM news WHERE feedId IN (%3) AND %4 GROUP BY feedId").
+                  arg(ageStr, readStr, feedsIdList.join(","), candidateStr);
+  }
+  // News in 'Deleted' are counted as one row of feed -1
+  if (cleanUpDeleted_->isChecked()) {
+    selectList << "SELECT -1, count(*), count(*), "
+                  "sum(ifnull(length(description), 0) + ifnull(length(content), 0)), 0 "
+                  "FROM news WHERE deleted==1";
+  }
+
+  QVariantList tag;
+  tag << newsCleanUpOn_->isChecked() << maxNewsCleanUp_->value();
+  estimateLabel_->setText(tr("Estimating..."));
+  estimateId_ = mainApp->asyncQuery()->exec(selectList.join(" UNION ALL "), QVariantList(),
+                                            this, "slotEstimateReady", tag);
+}
+
+/** @brief Show estimate of clean up
+ *
+ * Oldest news over maximum number are deleted in addition to news by age
+ * and read state, so number of them is limited by number of candidates.
+ * Size of deleted news is taken as average size of candidates of feed.
+ *----------------------------------------------------------------------------*/
+void CleanUpWizard::slotEstimateReady(AsyncQueryResult result)
+{
+  if (result.id != estimateId_) return;
+
+  if (!result.error.isEmpty()) {
+    estimateLabel_->setText(tr("Estimate failed"));
+    return;
+  }
+
+  bool newsCleanUpOn = result.tag.toList().at(0).toBool();
+  int maxNewsCleanUp = result.tag.toList().at(1).toInt();
+
+  QHash<QString,int> feedCounts;
+  int newsCount = 0;
+  qint64 bytes = 0;
+  foreach (const QVariantList &row, result.rows) {
+    int candidates = row.at(1).toInt();
+    int count = row.at(2).toInt();
+    if (newsCleanUpOn && (row.at(0).toInt() != -1))
+      count += qMax(0, row.at(4).toInt() - maxNewsCleanUp);
+    count = qMin(count, candidates);
+    if (!count) continue;
+
+    feedCounts.insert(row.at(0).toString(), count);
+    newsCount += count;
+    bytes += row.at(3).toLongLong() * count / candidates;
+  }
+
+  QTreeWidgetItemIterator it(feedsTree_);
+  while (*it) {
+    int count = feedCounts.value((*it)->text(1), 0);
+    if (count)
+      (*it)->setToolTip(0, tr("About %1 news to delete").arg(count));
+    else
+      (*it)->setToolTip(0, QString());
+    ++it;
+  }
+
+  estimateLabel_->setText(tr("About %1 news to delete, %2 (%3 pages of database)").
+                          arg(newsCount).arg(sizeToString(bytes)).
+                          arg((bytes + pageSize_ - 1) / pageSize_));
 }
 
 void CleanUpWizard::finishButtonClicked()
@@ -298,15 +463,24 @@ void CleanUpWizard::finishButtonClicked()
   settings.setValue("cleanUpDeleted", cleanUpDeleted_->isChecked());
   settings.setValue("fullCleanUp", fullCleanUp_->isChecked());
   settings.endGroup();
+  Settings::publishSnapshot();
 
   connect(this, SIGNAL(signalStartCleanUp(bool, QStringList, QList<int>)),
           mainApp->updateFeeds()->updateObject_, SLOT(startCleanUp(bool, QStringList, QList<int>)));
   connect(mainApp->updateFeeds()->updateObject_, SIGNAL(signalFinishCleanUp(int)),
           this, SLOT(finishCleanUp(int)));
+  connect(mainApp->updateFeeds()->updateObject_, SIGNAL(signalCleanUpProgress(int,int)),
+          this, SLOT(cleanUpProgress(int,int)));
 
   emit signalStartCleanUp(false, feedsIdList, foldersIdList);
 }
 
+void CleanUpWizard::cleanUpProgress(int value, int maximum)
+{
+  progressBar_->setMaximum(maximum);
+  progressBar_->setValue(value);
+}
+
 void CleanUpWizard::finishCleanUp(int countDeleted)
 {
   int feedId = -1;
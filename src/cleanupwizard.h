@@ -24,6 +24,8 @@
 #include <QtGui>
 #endif
 
+#include "asyncquery.h"
+
 class CleanUpWizard : public QWizard
 {
   Q_OBJECT
@@ -36,6 +38,7 @@ signals:
                           QList<int> foldersIdList);
 
 public slots:
+  void cleanUpProgress(int value, int maximum);
   void finishCleanUp(int countDeleted);
 
 protected:
@@ -47,10 +50,13 @@ private slots:
   void finishButtonClicked();
   void feedItemChanged(QTreeWidgetItem *item, int column);
   void setCheckStateItem(QTreeWidgetItem *item, Qt::CheckState state);
+  void startEstimate();
+  void slotEstimateReady(AsyncQueryResult result);
 
 private:
   QWizardPage *createChooseFeedsPage();
   QWizardPage *createCleanUpOptionsPage();
+  QStringList checkedFeeds() const;
 
   bool selectedPage_;
   bool itemNotChecked_;
@@ -66,6 +72,11 @@ private:
   QCheckBox *cleanUpDeleted_;
   QCheckBox *fullCleanUp_;
   QProgressBar *progressBar_;
+  QLabel *estimateLabel_;
+  QTimer *estimateTimer_;
+  int estimateId_;  // id of last estimate query, older results are dropped
+  int pageSize_;
+
 
 };
 
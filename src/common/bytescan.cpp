@@ -0,0 +1,163 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "bytescan.h"
+
+#include <QtGlobal>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define BYTESCAN_SSE2
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define BYTESCAN_NEON
+#endif
+
+#if defined(BYTESCAN_SSE2) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(BYTESCAN_SSE2)
+static inline int lowestBit(unsigned int mask)
+{
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return int(index);
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+/** @brief Find first byte equal to \a a or \a b
+ * @return \a end if there is none
+ *----------------------------------------------------------------------------*/
+const char *ByteScan::findEither(const char *begin, const char *end, char a, char b)
+{
+  const char *ch = begin;
+#if defined(BYTESCAN_SSE2)
+  const __m128i va = _mm_set1_epi8(a);
+  const __m128i vb = _mm_set1_epi8(b);
+  for (; end - ch >= 16; ch += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ch));
+    int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, va),
+                                              _mm_cmpeq_epi8(chunk, vb)));
+    if (mask)
+      return ch + lowestBit(unsigned(mask));
+  }
+#elif defined(BYTESCAN_NEON)
+  const uint8x16_t va = vdupq_n_u8(uchar(a));
+  const uint8x16_t vb = vdupq_n_u8(uchar(b));
+  for (; end - ch >= 16; ch += 16) {
+    uint8x16_t chunk = vld1q_u8(reinterpret_cast<const uint8_t *>(ch));
+    if (vmaxvq_u8(vorrq_u8(vceqq_u8(chunk, va), vceqq_u8(chunk, vb))))
+      break;
+  }
+#endif
+  for (; ch < end; ++ch) {
+    if ((*ch == a) || (*ch == b))
+      return ch;
+  }
+  return end;
+}
+
+/** @brief Check that data has only 7-bit characters
+ *----------------------------------------------------------------------------*/
+bool ByteScan::isAscii(const char *data, int size)
+{
+  const char *ch = data;
+  const char *end = data + size;
+#if defined(BYTESCAN_SSE2)
+  for (; end - ch >= 16; ch += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ch));
+    if (_mm_movemask_epi8(chunk))
+      return false;
+  }
+#elif defined(BYTESCAN_NEON)
+  for (; end - ch >= 16; ch += 16) {
+    if (vmaxvq_u8(vld1q_u8(reinterpret_cast<const uint8_t *>(ch))) & 0x80)
+      return false;
+  }
+#endif
+  for (; ch < end; ++ch) {
+    if (uchar(*ch) & 0x80)
+      return false;
+  }
+  return true;
+}
+
+/** @brief Check that data is well-formed UTF-8
+ *
+ * Runs of ASCII are skipped by blocks, multibyte sequences are checked
+ * one by one: overlong forms, surrogates and code points above U+10FFFF
+ * are rejected.
+ *----------------------------------------------------------------------------*/
+bool ByteScan::isUtf8(const char *data, int size)
+{
+  const uchar *ch = reinterpret_cast<const uchar *>(data);
+  const uchar *end = ch + size;
+  while (ch < end) {
+#if defined(BYTESCAN_SSE2)
+    while (end - ch >= 16) {
+      __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ch));
+      int mask = _mm_movemask_epi8(chunk);
+      if (mask) {
+        ch += lowestBit(unsigned(mask));
+        break;
+      }
+      ch += 16;
+    }
+#elif defined(BYTESCAN_NEON)
+    while ((end - ch >= 16) && !(vmaxvq_u8(vld1q_u8(ch)) & 0x80))
+      ch += 16;
+#endif
+    if (ch >= end)
+      break;
+    if (*ch < 0x80) {
+      ++ch;
+      continue;
+    }
+
+    int length;
+    uchar min = 0x80;
+    uchar max = 0xBF;
+    if ((*ch >= 0xC2) && (*ch <= 0xDF)) {
+      length = 2;
+    } else if ((*ch >= 0xE0) && (*ch <= 0xEF)) {
+      length = 3;
+      if (*ch == 0xE0) min = 0xA0;       // overlong
+      else if (*ch == 0xED) max = 0x9F;  // surrogates
+    } else if ((*ch >= 0xF0) && (*ch <= 0xF4)) {
+      length = 4;
+      if (*ch == 0xF0) min = 0x90;       // overlong
+      else if (*ch == 0xF4) max = 0x8F;  // above U+10FFFF
+    } else {
+      return false;
+    }
+    if (end - ch < length)
+      return false;
+    if ((ch[1] < min) || (ch[1] > max))
+      return false;
+    for (int i = 2; i < length; ++i) {
+      if ((ch[i] & 0xC0) != 0x80)
+        return false;
+    }
+    ch += length;
+  }
+  return true;
+}
@@ -22,6 +22,7 @@
 #if defined Q_OS_WIN
 #include <windows.h>
 #else
+#include <stdio.h>
 #include <time.h>
 #include <unistd.h>
 #endif
@@ -143,6 +144,26 @@ void Common::createFileBackup(const QString &oldFilename, const QString &oldVers
   QFile::copy(oldFilename, backupFilename);
 }
 
+/** @brief Replace file with new one in single step
+ *
+ * File is never left partially written, even if application is killed.
+ *----------------------------------------------------------------------------*/
+bool Common::replaceFile(const QString &newFilename, const QString &filename)
+{
+  QString targetFilename = QFile::symLinkTarget(filename);
+  if (targetFilename.isEmpty())
+    targetFilename = filename;
+
+#if defined Q_OS_WIN
+  return MoveFileExW((LPCWSTR)QDir::toNativeSeparators(newFilename).utf16(),
+                     (LPCWSTR)QDir::toNativeSeparators(targetFilename).utf16(),
+                     MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+  return ::rename(QFile::encodeName(newFilename).constData(),
+                  QFile::encodeName(targetFilename).constData()) == 0;
+#endif
+}
+
 QString Common::readAllFileContents(const QString &filename)
 {
   return QString::fromUtf8(readAllFileByteContents(filename));
@@ -161,6 +182,356 @@ QByteArray Common::readAllFileByteContents(const QString &filename)
   return QByteArray();
 }
 
+// Entities decoded by htmlToPlainText(), other named ones are kept as text
+static const struct {
+  const char *name;
+  ushort code;
+} kHtmlEntities[] = {
+  { "amp", '&' }, { "lt", '<' }, { "gt", '>' }, { "quot", '"' }, { "apos", '\'' },
+  { "nbsp", 0x00A0 }, { "ndash", 0x2013 }, { "mdash", 0x2014 }, { "hellip", 0x2026 },
+  { "lsquo", 0x2018 }, { "rsquo", 0x2019 }, { "ldquo", 0x201C }, { "rdquo", 0x201D },
+  { "laquo", 0x00AB }, { "raquo", 0x00BB }, { "bull", 0x2022 }, { "middot", 0x00B7 },
+  { "copy", 0x00A9 }, { "reg", 0x00AE }, { "trade", 0x2122 }, { "deg", 0x00B0 },
+  { "euro", 0x20AC }
+};
+
+// Tags which separate words in rendered text
+static const char *const kHtmlBreakTags[] = {
+  "br", "p", "div", "li", "ul", "ol", "dd", "dt", "tr", "td", "th", "table",
+  "h1", "h2", "h3", "h4", "h5", "h6", "hr", "pre", "blockquote"
+};
+
+// Tags whose content is not shown
+static const char *const kHtmlHiddenTags[] = { "script", "style", "head" };
+
+static bool isTagName(const QString &name, const char *const *names, int count)
+{
+  for (int i = 0; i < count; ++i) {
+    if (name == QLatin1String(names[i]))
+      return true;
+  }
+  return false;
+}
+
+/** @brief Decode entity at \a pos of \a html into \a decoded
+ * @return position after entity or -1 if it is not known
+ *----------------------------------------------------------------------------*/
+static int decodeHtmlEntity(const QString &html, int pos, QString *decoded)
+{
+  int end = html.indexOf(QLatin1Char(';'), pos + 1);
+  if ((end == -1) || (end - pos > 10))
+    return -1;
+
+  if (html.at(pos + 1) == QLatin1Char('#')) {
+    bool ok;
+    uint code;
+    if ((pos + 2 < end) && (html.at(pos + 2).toLower() == QLatin1Char('x')))
+      code = html.mid(pos + 3, end - pos - 3).toUInt(&ok, 16);
+    else
+      code = html.mid(pos + 2, end - pos - 2).toUInt(&ok, 10);
+    if (!ok || (code == 0) || (code > 0x10FFFF))
+      return -1;
+    if (code > 0xFFFF) {
+      decoded->append(QChar(QChar::highSurrogate(code)));
+      decoded->append(QChar(QChar::lowSurrogate(code)));
+    } else {
+      decoded->append(QChar(code));
+    }
+    return end + 1;
+  }
+
+  const QString name = html.mid(pos + 1, end - pos - 1);
+  for (uint i = 0; i < sizeof(kHtmlEntities) / sizeof(kHtmlEntities[0]); ++i) {
+    if (name == QLatin1String(kHtmlEntities[i].name)) {
+      decoded->append(QChar(kHtmlEntities[i].code));
+      return end + 1;
+    }
+  }
+  return -1;
+}
+
+/** @brief Skip tag, comment or hidden element at \a pos of \a html
+ * @return position after it or -1 if '<' does not start markup
+ *----------------------------------------------------------------------------*/
+static int skipHtmlTag(const QString &html, int pos, bool *wordBreak)
+{
+  const int length = html.length();
+  if (pos + 1 >= length)
+    return -1;
+
+  QChar ch = html.at(pos + 1);
+  if (ch == QLatin1Char('!')) {
+    if (html.midRef(pos, 4) == QLatin1String("<!--")) {
+      int end = html.indexOf(QLatin1String("-->"), pos + 4);
+      return (end == -1) ? length : end + 3;
+    }
+  } else if ((ch != QLatin1Char('?')) && (ch != QLatin1Char('/')) && !ch.isLetter()) {
+    return -1;
+  }
+
+  int nameStart = pos + 1;
+  if ((ch == QLatin1Char('/')) || (ch == QLatin1Char('!')) || (ch == QLatin1Char('?')))
+    ++nameStart;
+  int nameEnd = nameStart;
+  while ((nameEnd < length) && html.at(nameEnd).isLetterOrNumber())
+    ++nameEnd;
+  if ((ch == QLatin1Char('/')) && (nameEnd == nameStart))
+    return -1;
+
+  // Attribute values may contain '>'
+  int end = nameEnd;
+  QChar quote;
+  for (; end < length; ++end) {
+    QChar c = html.at(end);
+    if (!quote.isNull()) {
+      if (c == quote) quote = QChar();
+    } else if ((c == QLatin1Char('"')) || (c == QLatin1Char('\''))) {
+      quote = c;
+    } else if (c == QLatin1Char('>')) {
+      break;
+    }
+  }
+  if (end >= length)
+    return length;
+  ++end;
+
+  const QString name = html.mid(nameStart, nameEnd - nameStart).toLower();
+  if (isTagName(name, kHtmlBreakTags, sizeof(kHtmlBreakTags) / sizeof(kHtmlBreakTags[0]))) {
+    *wordBreak = true;
+  } else if ((ch != QLatin1Char('/')) &&
+             isTagName(name, kHtmlHiddenTags, sizeof(kHtmlHiddenTags) / sizeof(kHtmlHiddenTags[0]))) {
+    int close = html.indexOf(QLatin1String("</") + name, end, Qt::CaseInsensitive);
+    if (close == -1)
+      return length;
+    close = html.indexOf(QLatin1Char('>'), close);
+    *wordBreak = true;
+    return (close == -1) ? length : close + 1;
+  }
+  return end;
+}
+
+/** @brief Convert html to plain text in one pass
+ *
+ * Tags are dropped, entities decoded and whitespace collapsed as by
+ * QString::simplified(). Text longer than \a maxLength is cut at word and
+ * ended with ellipsis. Unlike QTextDocumentFragment no document is built,
+ * so it is cheap enough for every title and description of feed.
+ *----------------------------------------------------------------------------*/
+QString Common::htmlToPlainText(const QString &html, int maxLength)
+{
+  QString text;
+  if ((html.indexOf(QLatin1Char('<')) == -1) && (html.indexOf(QLatin1Char('&')) == -1)) {
+    text = html.simplified();
+  } else {
+    text.reserve(html.length());
+    const int length = html.length();
+    bool space = false;
+    QString decoded;
+    int pos = 0;
+    while (pos < length) {
+      if ((maxLength >= 0) && (text.length() > maxLength))
+        break;
+
+      QChar ch = html.at(pos);
+      if (ch == QLatin1Char('<')) {
+        bool wordBreak = false;
+        int end = skipHtmlTag(html, pos, &wordBreak);
+        if (end != -1) {
+          space = space || wordBreak;
+          pos = end;
+          continue;
+        }
+      } else if (ch == QLatin1Char('&')) {
+        decoded.clear();
+        int end = decodeHtmlEntity(html, pos, &decoded);
+        if (end != -1) {
+          foreach (const QChar &c, decoded) {
+            if (c.isSpace()) {
+              space = true;
+            } else {
+              if (space && !text.isEmpty())
+                text.append(QLatin1Char(' '));
+              space = false;
+              text.append(c);
+            }
+          }
+          pos = end;
+          continue;
+        }
+      }
+
+      if (ch.isSpace()) {
+        space = true;
+      } else {
+        if (space && !text.isEmpty())
+          text.append(QLatin1Char(' '));
+        space = false;
+        text.append(ch);
+      }
+      ++pos;
+    }
+  }
+
+  if ((maxLength >= 0) && (text.length() > maxLength)) {
+    int cut = text.lastIndexOf(QLatin1Char(' '), maxLength);
+    text.truncate((cut > maxLength / 2) ? cut : maxLength);
+    text.append(QChar(0x2026));
+  }
+  return text;
+}
+
+// FNV-1a, stable between runs unlike qHash() with seed
+static const quint64 kFnvOffset = Q_UINT64_C(14695981039346656037);
+static const quint64 kFnvPrime = Q_UINT64_C(1099511628211);
+
+static inline quint64 fnvAppend(quint64 hash, const QChar *data, int length)
+{
+  for (int i = 0; i < length; ++i) {
+    hash ^= data[i].unicode();
+    hash *= kFnvPrime;
+  }
+  return hash;
+}
+
+/** @brief Hash of one or two keys of news tagged with \a kind of keys
+ *
+ * Keys are hashed with their lengths, so pairs split at other place
+ * give other digest.
+ *----------------------------------------------------------------------------*/
+qint64 Common::keyDigest(int kind, const QString &key1, const QString &key2)
+{
+  quint64 hash = (kFnvOffset ^ quint64(kind)) * kFnvPrime;
+  hash = (hash ^ quint64(key1.length())) * kFnvPrime;
+  hash = fnvAppend(hash, key1.constData(), key1.length());
+  hash = (hash ^ quint64(key2.length())) * kFnvPrime;
+  hash = fnvAppend(hash, key2.constData(), key2.length());
+  return qint64(hash);
+}
+
+/** @brief Hash of raw data, e.g. feed payload to find it is unchanged
+ *----------------------------------------------------------------------------*/
+qint64 Common::dataDigest(const QByteArray &data)
+{
+  quint64 hash = kFnvOffset;
+  const uchar *bytes = reinterpret_cast<const uchar *>(data.constData());
+  for (int i = 0; i < data.size(); ++i) {
+    hash ^= bytes[i];
+    hash *= kFnvPrime;
+  }
+  return qint64(hash);
+}
+
+/** @brief Hash of title with case, punctuation and extra spaces dropped
+ * @return 0 for title without letters and digits
+ *----------------------------------------------------------------------------*/
+qint64 Common::titleFingerprint(const QString &title)
+{
+  QString normalized;
+  normalized.reserve(title.length());
+  bool space = false;
+  foreach (const QChar &c, title) {
+    if (c.isLetterOrNumber()) {
+      if (space && !normalized.isEmpty())
+        normalized.append(QLatin1Char(' '));
+      space = false;
+      normalized.append(c.toLower());
+    } else {
+      space = true;
+    }
+  }
+  if (normalized.isEmpty())
+    return 0;
+  quint64 hash = fnvAppend(kFnvOffset, normalized.constData(), normalized.length());
+  return hash ? qint64(hash) : 1;
+}
+
+// Texts with fewer words have no simhash
+#define SIMHASH_MIN_WORDS 8
+
+/** @brief SimHash of text by pairs of consecutive words
+ *
+ * Texts which differ in a few words get hashes differing in a few bits.
+ * @return 0 for short text
+ *----------------------------------------------------------------------------*/
+qint64 Common::simHash(const QString &text)
+{
+  int weights[64];
+  for (int i = 0; i < 64; ++i)
+    weights[i] = 0;
+
+  QString lower = text.toLower();
+  const QChar *data = lower.constData();
+  const int length = lower.length();
+  int prevStart = -1;
+  int prevLength = 0;
+  int words = 0;
+  int pos = 0;
+  while (pos < length) {
+    while ((pos < length) && !data[pos].isLetterOrNumber())
+      ++pos;
+    int start = pos;
+    while ((pos < length) && data[pos].isLetterOrNumber())
+      ++pos;
+    if (pos == start)
+      break;
+
+    if (prevStart != -1) {
+      quint64 hash = fnvAppend(kFnvOffset, data + prevStart, prevLength);
+      hash = fnvAppend(hash * kFnvPrime, data + start, pos - start);
+      for (int i = 0; i < 64; ++i)
+        weights[i] += ((hash >> i) & 1) ? 1 : -1;
+    }
+    prevStart = start;
+    prevLength = pos - start;
+    ++words;
+  }
+  if (words < SIMHASH_MIN_WORDS)
+    return 0;
+
+  quint64 hash = 0;
+  for (int i = 0; i < 64; ++i) {
+    if (weights[i] > 0)
+      hash |= Q_UINT64_C(1) << i;
+  }
+  return hash ? qint64(hash) : 1;
+}
+
+int Common::hammingDistance(qint64 hash1, qint64 hash2)
+{
+  quint64 bits = quint64(hash1 ^ hash2);
+  int count = 0;
+  while (bits) {
+    bits &= bits - 1;
+    ++count;
+  }
+  return count;
+}
+
+/** @brief Quoted JSON string of text, control characters are escaped
+ *----------------------------------------------------------------------------*/
+QString Common::jsonString(const QString &text)
+{
+  QString result;
+  result.reserve(text.size() + 2);
+  result.append('"');
+  for (int i = 0; i < text.size(); ++i) {
+    QChar ch = text.at(i);
+    if (ch == '"' || ch == '\\') {
+      result.append('\\').append(ch);
+    } else if (ch == '\n') {
+      result.append("\\n");
+    } else if (ch == '\t') {
+      result.append("\\t");
+    } else if (ch.unicode() < 0x20) {
+      result.append(QString("\\u%1").arg(ch.unicode(), 4, 16, QChar('0')));
+    } else {
+      result.append(ch);
+    }
+  }
+  result.append('"');
+  return result;
+}
+
 void Common::sleep(int ms)
 {
 #if defined(Q_OS_WIN)
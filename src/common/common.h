@@ -56,10 +56,19 @@ namespace Common
   QString filterCharsFromFilename(const QString &name);
   QString ensureUniqueFilename(const QString &name, const QString &appendFormat = QString("(%1)"));
   void createFileBackup(const QString &oldFilename, const QString &oldVersion);
+  bool replaceFile(const QString &newFilename, const QString &filename);
 
   QString readAllFileContents(const QString &filename);
   QByteArray readAllFileByteContents(const QString &filename);
 
+  QString htmlToPlainText(const QString &html, int maxLength = -1);
+  qint64 titleFingerprint(const QString &title);
+  qint64 simHash(const QString &text);
+  int hammingDistance(qint64 hash1, qint64 hash2);
+  qint64 keyDigest(int kind, const QString &key1, const QString &key2 = QString());
+  qint64 dataDigest(const QByteArray &data);
+  QString jsonString(const QString &text);
+
   void sleep(int ms);
 
   QString operatingSystem();
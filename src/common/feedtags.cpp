@@ -0,0 +1,140 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "feedtags.h"
+
+// Size of hash table, power of two
+#define TAG_TABLE_SIZE 64
+
+using namespace FeedTags;
+
+struct TagEntry {
+  const char *name;
+  Tag tag;
+};
+
+// Tags placed by tagHash(), names of all tags give different values
+static const TagEntry tagTable[TAG_TABLE_SIZE] = {
+  { 0, TagNone },
+  { "description", TagDescription },
+  { "summary", TagSummary },
+  { 0, TagNone },
+  { "comments", TagComments },
+  { "media:description", TagMediaDescription },
+  { "content", TagContent },
+  { 0, TagNone },
+  { 0, TagNone },
+  { 0, TagNone },
+  { 0, TagNone },
+  { "media:group", TagMediaGroup },
+  { 0, TagNone },
+  { 0, TagNone },
+  { 0, TagNone },
+  { 0, TagNone },
+  { "link", TagLink },
+  { "dc:creator", TagDcCreator },
+  { 0, TagNone },
+  { "dc:date", TagDcDate },
+  { "author", TagAuthor },
+  { "rss:title", TagRssTitle },
+  { 0, TagNone },
+  { 0, TagNone },
+  { 0, TagNone },
+  { 0, TagNone },
+  { 0, TagNone },
+  { "pubdate", TagPubDateLower },
+  { "rss:description", TagRssDescription },
+  { 0, TagNone },
+  { 0, TagNone },
+  { "media:thumbnail", TagMediaThumbnail },
+  { 0, TagNone },
+  { 0, TagNone },
+  { 0, TagNone },
+  { "title", TagTitle },
+  { 0, TagNone },
+  { 0, TagNone },
+  { "category", TagCategory },
+  { 0, TagNone },
+  { 0, TagNone },
+  { 0, TagNone },
+  { "uri", TagUri },
+  { 0, TagNone },
+  { "name", TagName },
+  { 0, TagNone },
+  { "id", TagId },
+  { "updated", TagUpdated },
+  { 0, TagNone },
+  { 0, TagNone },
+  { 0, TagNone },
+  { "rss:link", TagRssLink },
+  { "published", TagPublished },
+  { 0, TagNone },
+  { "content:encoded", TagContentEncoded },
+  { "email", TagEmail },
+  { 0, TagNone },
+  { "enclosure", TagEnclosure },
+  { "guid", TagGuid },
+  { "pubDate", TagPubDate },
+  { 0, TagNone },
+  { 0, TagNone },
+  { 0, TagNone },
+  { 0, TagNone }
+};
+
+/** @brief Hash of tag name by its length and three characters
+ *----------------------------------------------------------------------------*/
+static inline int tagHash(const QChar *name, int length)
+{
+  int middle = (length > 3) ? 3 : (length - 1);
+  return (length * 12 + name[0].unicode() * 6 + name[length - 1].unicode() * 7 +
+          name[middle].unicode()) & (TAG_TABLE_SIZE - 1);
+}
+
+/** @brief Tag of element with qualified \a name
+ *----------------------------------------------------------------------------*/
+FeedTags::Tag FeedTags::tag(const QString &name)
+{
+  int length = name.length();
+  if (length == 0)
+    return TagNone;
+
+  const TagEntry &entry = tagTable[tagHash(name.constData(), length)];
+  if (!entry.name || (name != QLatin1String(entry.name)))
+    return TagNone;
+  return entry.tag;
+}
+
+/** @brief Sort children of \a parent by tags in one pass
+ *
+ * Like namedItem(), first element of tag is kept. Categories and links
+ * are kept in order of document.
+ *----------------------------------------------------------------------------*/
+void FeedTags::collect(const QDomElement &parent, Children *children)
+{
+  for (QDomElement element = parent.firstChildElement(); !element.isNull();
+       element = element.nextSiblingElement()) {
+    Tag elementTag = tag(element.tagName());
+    if (elementTag == TagNone)
+      continue;
+    if (elementTag == TagCategory)
+      children->categories.append(element);
+    else if (elementTag == TagLink)
+      children->links.append(element);
+    if (children->first[elementTag].isNull())
+      children->first[elementTag] = element;
+  }
+}
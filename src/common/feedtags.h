@@ -0,0 +1,79 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef FEEDTAGS_H
+#define FEEDTAGS_H
+
+#include <QDomElement>
+#include <QList>
+
+/** @brief Known tags of feed items found in one pass over children
+ *
+ * Tag of element is looked up in table of perfect hash made for names of
+ * Atom, RSS, Dublin Core, media and content tags, so each child is
+ * compared with one name only.
+ *----------------------------------------------------------------------------*/
+namespace FeedTags
+{
+  enum Tag {
+    TagNone = 0,
+    TagId,
+    TagGuid,
+    TagTitle,
+    TagRssTitle,
+    TagPublished,
+    TagUpdated,
+    TagPubDate,
+    TagPubDateLower,
+    TagDcDate,
+    TagAuthor,
+    TagDcCreator,
+    TagName,
+    TagUri,
+    TagEmail,
+    TagSummary,
+    TagDescription,
+    TagRssDescription,
+    TagContent,
+    TagContentEncoded,
+    TagMediaGroup,
+    TagMediaDescription,
+    TagMediaThumbnail,
+    TagCategory,
+    TagComments,
+    TagEnclosure,
+    TagLink,
+    TagRssLink,
+    TagCount
+  };
+
+  Tag tag(const QString &name);
+
+  // Child elements of item: first one of each tag, all categories and links
+  struct Children {
+    QDomElement first[TagCount];
+    QList<QDomElement> categories;
+    QList<QDomElement> links;
+
+    const QDomElement &element(Tag tag) const { return first[tag]; }
+    QString text(Tag tag) const { return first[tag].text(); }
+  };
+
+  void collect(const QDomElement &parent, Children *children);
+}
+
+#endif // FEEDTAGS_H
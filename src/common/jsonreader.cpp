@@ -0,0 +1,280 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "jsonreader.h"
+
+JsonReader::JsonReader(const QString &text)
+  : begin_(text.constData())
+  , pos_(begin_)
+  , end_(begin_ + text.size())
+  , afterValue_(false)
+  , justOpened_(false)
+  , token_(NoToken)
+{
+  // Byte order mark left by decoder
+  if ((pos_ < end_) && (pos_->unicode() == 0xFEFF))
+    ++pos_;
+}
+
+/** @brief Read next token
+ *
+ * In object names and values come in turn: Name is followed by token of
+ * its value.
+ *----------------------------------------------------------------------------*/
+JsonReader::TokenType JsonReader::readNext()
+{
+  if ((token_ == Invalid) || (token_ == EndDocument))
+    return token_;
+
+  skipSpaces();
+  if (justOpened_) {
+    justOpened_ = false;
+    char container = stack_.last();
+    if ((pos_ < end_) && (*pos_ == QLatin1Char(container == '{' ? '}' : ']'))) {
+      ++pos_;
+      stack_.pop_back();
+      afterValue_ = true;
+      return token_ = (container == '{') ? EndObject : EndArray;
+    }
+    return (container == '{') ? readName() : readValue();
+  }
+
+  if (afterValue_) {
+    if (stack_.isEmpty()) {
+      if (pos_ < end_)
+        return setError("Extra data after document");
+      return token_ = EndDocument;
+    }
+    if (pos_ >= end_)
+      return setError("Unexpected end of data");
+
+    char container = stack_.last();
+    if (*pos_ == QLatin1Char(',')) {
+      ++pos_;
+      afterValue_ = false;
+      skipSpaces();
+      return (container == '{') ? readName() : readValue();
+    }
+    if (*pos_ == QLatin1Char(container == '{' ? '}' : ']')) {
+      ++pos_;
+      stack_.pop_back();
+      return token_ = (container == '{') ? EndObject : EndArray;
+    }
+    return setError("Expected ',' or end of container");
+  }
+
+  return readValue();
+}
+
+/** @brief Read value of current name or array item as text
+ * @return Text of string, number or boolean, empty for other values,
+ *   which are skipped
+ *----------------------------------------------------------------------------*/
+QString JsonReader::readText()
+{
+  switch (readNext()) {
+  case String:
+  case Number:
+  case Bool:
+    return text_;
+  case StartObject:
+  case StartArray:
+    skipCurrent();
+    break;
+  default:
+    break;
+  }
+  return QString();
+}
+
+/** @brief Read start of array, other values are skipped
+ * @return true if value is array
+ *----------------------------------------------------------------------------*/
+bool JsonReader::readStartArray()
+{
+  TokenType token = readNext();
+  if (token == StartObject)
+    skipCurrent();
+  return (token == StartArray);
+}
+
+/** @brief Skip next value with all its children
+ *----------------------------------------------------------------------------*/
+void JsonReader::skipValue()
+{
+  TokenType token = readNext();
+  if ((token == StartObject) || (token == StartArray))
+    skipCurrent();
+}
+
+/** @brief Skip the rest of container whose start is current token
+ *----------------------------------------------------------------------------*/
+void JsonReader::skipCurrent()
+{
+  leave(depth());
+}
+
+/** @brief Skip tokens until container of \a depth is closed
+ *
+ * Used after unexpected value inside of array or object, \a depth is
+ * depth() right after start of that container.
+ *----------------------------------------------------------------------------*/
+void JsonReader::leave(int depth)
+{
+  while (stack_.size() >= depth) {
+    TokenType token = readNext();
+    if ((token == Invalid) || (token == EndDocument))
+      return;
+  }
+}
+
+JsonReader::TokenType JsonReader::readName()
+{
+  if ((pos_ >= end_) || (*pos_ != QLatin1Char('"')))
+    return setError("Expected name");
+  if (!readString())
+    return token_;
+
+  skipSpaces();
+  if ((pos_ >= end_) || (*pos_ != QLatin1Char(':')))
+    return setError("Expected ':'");
+  ++pos_;
+  return token_ = Name;
+}
+
+JsonReader::TokenType JsonReader::readValue()
+{
+  if (pos_ >= end_)
+    return setError("Unexpected end of data");
+
+  ushort ch = pos_->unicode();
+  switch (ch) {
+  case '{':
+  case '[':
+    ++pos_;
+    stack_.append(char(ch));
+    justOpened_ = true;
+    afterValue_ = false;
+    return token_ = (ch == '{') ? StartObject : StartArray;
+  case '"':
+    if (!readString())
+      return token_;
+    afterValue_ = true;
+    return token_ = String;
+  default:
+    break;
+  }
+
+  const QChar *start = pos_;
+  if ((ch == '-') || ((ch >= '0') && (ch <= '9'))) {
+    while ((pos_ < end_) && ((pos_->unicode() == '-') || (pos_->unicode() == '+') ||
+                             (pos_->unicode() == '.') || (pos_->unicode() == 'e') ||
+                             (pos_->unicode() == 'E') ||
+                             ((pos_->unicode() >= '0') && (pos_->unicode() <= '9')))) {
+      ++pos_;
+    }
+    text_ = QString(start, int(pos_ - start));
+    afterValue_ = true;
+    return token_ = Number;
+  }
+
+  while ((pos_ < end_) && (pos_->unicode() >= 'a') && (pos_->unicode() <= 'z'))
+    ++pos_;
+  text_ = QString(start, int(pos_ - start));
+  afterValue_ = true;
+  if ((text_ == QLatin1String("true")) || (text_ == QLatin1String("false")))
+    return token_ = Bool;
+  if (text_ == QLatin1String("null")) {
+    text_.clear();
+    return token_ = Null;
+  }
+  return setError("Unexpected character");
+}
+
+/** @brief Read string at current position into text_
+ *----------------------------------------------------------------------------*/
+bool JsonReader::readString()
+{
+  const QChar *start = ++pos_;
+  while ((pos_ < end_) && (*pos_ != QLatin1Char('"')) && (*pos_ != QLatin1Char('\\')))
+    ++pos_;
+  if (pos_ >= end_) {
+    setError("Unterminated string");
+    return false;
+  }
+  text_ = QString(start, int(pos_ - start));
+  if (*pos_ == QLatin1Char('"')) {
+    ++pos_;
+    return true;
+  }
+
+  // Escaped characters
+  while (pos_ < end_) {
+    ushort ch = pos_->unicode();
+    if (ch == '"') {
+      ++pos_;
+      return true;
+    }
+    if (ch != '\\') {
+      text_.append(*pos_++);
+      continue;
+    }
+    if (end_ - pos_ < 2)
+      break;
+    ch = pos_[1].unicode();
+    pos_ += 2;
+    switch (ch) {
+    case 'b': text_.append(QLatin1Char('\b')); break;
+    case 'f': text_.append(QLatin1Char('\f')); break;
+    case 'n': text_.append(QLatin1Char('\n')); break;
+    case 'r': text_.append(QLatin1Char('\r')); break;
+    case 't': text_.append(QLatin1Char('\t')); break;
+    case 'u': {
+      bool ok = false;
+      ushort code = 0;
+      if (end_ - pos_ >= 4)
+        code = QString(pos_, 4).toUShort(&ok, 16);
+      if (!ok) {
+        setError("Invalid escape sequence");
+        return false;
+      }
+      text_.append(QChar(code));
+      pos_ += 4;
+    }
+      break;
+    default:
+      text_.append(QChar(ch));
+      break;
+    }
+  }
+  setError("Unterminated string");
+  return false;
+}
+
+JsonReader::TokenType JsonReader::setError(const QString &errorString)
+{
+  errorString_ = errorString;
+  return token_ = Invalid;
+}
+
+void JsonReader::skipSpaces()
+{
+  while ((pos_ < end_) && ((pos_->unicode() == ' ') || (pos_->unicode() == '\n') ||
+                           (pos_->unicode() == '\r') || (pos_->unicode() == '\t'))) {
+    ++pos_;
+  }
+}
@@ -0,0 +1,83 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef JSONREADER_H
+#define JSONREADER_H
+
+#include <QString>
+#include <QVector>
+
+/** @brief Pull reader of JSON text in the manner of QXmlStreamReader
+ *
+ * Tokens are read one by one without building a document, so large feeds
+ * are walked once and only needed values are copied. Strings without
+ * escapes are copied by one allocation.
+ *----------------------------------------------------------------------------*/
+class JsonReader
+{
+public:
+  enum TokenType {
+    NoToken,
+    Invalid,
+    StartObject,
+    EndObject,
+    StartArray,
+    EndArray,
+    Name,
+    String,
+    Number,
+    Bool,
+    Null,
+    EndDocument
+  };
+
+  explicit JsonReader(const QString &text);
+
+  TokenType readNext();
+  TokenType tokenType() const { return token_; }
+  const QString &text() const { return text_; }
+  QString readText();
+  bool readStartArray();
+  void skipValue();
+  void skipCurrent();
+  void leave(int depth);
+  int depth() const { return stack_.size(); }
+
+  bool hasError() const { return token_ == Invalid; }
+  QString errorString() const { return errorString_; }
+  int offset() const { return int(pos_ - begin_); }
+
+private:
+  TokenType readName();
+  TokenType readValue();
+  bool readString();
+  TokenType setError(const QString &errorString);
+  void skipSpaces();
+
+  const QChar *begin_;
+  const QChar *pos_;
+  const QChar *end_;
+  QVector<char> stack_;  // '{' or '[' of open containers
+  bool afterValue_;      // value or end of container is just read
+  bool justOpened_;      // start of container is just read
+  TokenType token_;
+  QString text_;
+  QString errorString_;
+
+};
+
+#endif // JSONREADER_H
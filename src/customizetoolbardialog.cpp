@@ -325,6 +325,7 @@ void CustomizeToolbarDialog::acceptDialog()
       settings.setValue("Settings/newsToolBarIconSize", str);
       mainWindow->setToolBarIconSize(widget->newsToolBar_, str);
     }
+    Settings::publishSnapshot();
   }
 
   accept();
@@ -0,0 +1,178 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "asyncquery.h"
+
+#include "database.h"
+#include "logfile.h"
+
+#include <QtSql>
+
+/** @brief Run statements in one transaction
+ *
+ * \a values are bound to first statement only, rows are returned for the
+ * last one. Transaction is rolled back if any statement fails.
+ *---------------------------------------------------------------------------*/
+void AsyncQueryWorker::run(int id, const QStringList &sqlList,
+                           const QVariantList &values, const QVariant &tag)
+{
+  AsyncQueryResult result;
+  result.id = id;
+  result.tag = tag;
+  result.numRowsAffected = 0;
+
+  QSqlDatabase db = Database::threadConnection();
+  QSqlQuery q(db);
+  q.setForwardOnly(true);
+
+  if (sqlList.count() > 1)
+    db.transaction();
+  for (int i = 0; i < sqlList.count(); ++i) {
+    bool ok;
+    if ((i == 0) && !values.isEmpty()) {
+      q.prepare(sqlList.at(i));
+      foreach (const QVariant &value, values) {
+        q.addBindValue(value);
+      }
+      ok = q.exec();
+    } else {
+      ok = q.exec(sqlList.at(i));
+    }
+    if (!ok) {
+      result.error = q.lastError().text();
+      qWarning() << __PRETTY_FUNCTION__ << __LINE__
+                 << "q.lastError(): " << result.error << sqlList.at(i);
+      break;
+    }
+    if (q.numRowsAffected() > 0)
+      result.numRowsAffected += q.numRowsAffected();
+  }
+  if (!result.error.isEmpty()) {
+    q.finish();
+    if (sqlList.count() > 1)
+      db.rollback();
+    result.numRowsAffected = 0;
+    emit finished(result);
+    return;
+  }
+  if (q.isSelect()) {
+    int columns = q.record().count();
+    while (q.next()) {
+      QVariantList row;
+      for (int column = 0; column < columns; ++column) {
+        row.append(q.value(column));
+      }
+      result.rows.append(row);
+    }
+  }
+  q.finish();
+  if (sqlList.count() > 1)
+    db.commit();
+
+  emit finished(result);
+}
+
+/** @brief Do nothing, called blocking to wait for queued statements
+ *---------------------------------------------------------------------------*/
+void AsyncQueryWorker::flush()
+{
+}
+
+//------------------------------------------------------------------------------
+AsyncQuery::AsyncQuery(QObject *parent)
+  : QObject(parent)
+  , lastId_(0)
+{
+  qRegisterMetaType<AsyncQueryResult>("AsyncQueryResult");
+
+  thread_ = new QThread();
+  thread_->setObjectName("asyncQueryThread_");
+  worker_ = new AsyncQueryWorker();
+  worker_->moveToThread(thread_);
+  connect(worker_, SIGNAL(finished(AsyncQueryResult)),
+          this, SLOT(slotFinished(AsyncQueryResult)));
+  thread_->start();
+}
+
+AsyncQuery::~AsyncQuery()
+{
+  flush();
+  thread_->quit();
+  thread_->wait();
+  delete worker_;
+  delete thread_;
+}
+
+/** @brief Queue statement \a sql with bound \a values
+ * @return Request identifier passed back in result
+ *---------------------------------------------------------------------------*/
+int AsyncQuery::exec(const QString &sql, const QVariantList &values,
+                     QObject *receiver, const char *member,
+                     const QVariant &tag)
+{
+  int id = ++lastId_;
+  if (receiver && member) {
+    Callback callback;
+    callback.receiver = receiver;
+    callback.member = member;
+    callbacks_.insert(id, callback);
+  }
+  QMetaObject::invokeMethod(worker_, "run", Qt::QueuedConnection,
+                            Q_ARG(int, id), Q_ARG(QStringList, QStringList() << sql),
+                            Q_ARG(QVariantList, values), Q_ARG(QVariant, tag));
+  return id;
+}
+
+/** @brief Queue statements \a sqlList to be run in one transaction
+ *---------------------------------------------------------------------------*/
+int AsyncQuery::exec(const QStringList &sqlList, QObject *receiver,
+                     const char *member, const QVariant &tag)
+{
+  int id = ++lastId_;
+  if (receiver && member) {
+    Callback callback;
+    callback.receiver = receiver;
+    callback.member = member;
+    callbacks_.insert(id, callback);
+  }
+  QMetaObject::invokeMethod(worker_, "run", Qt::QueuedConnection,
+                            Q_ARG(int, id), Q_ARG(QStringList, sqlList),
+                            Q_ARG(QVariantList, QVariantList()), Q_ARG(QVariant, tag));
+  return id;
+}
+
+/** @brief Wait until all queued statements are executed
+ *
+ * Called before memory base is saved on quit, so changes queued by GUI
+ * are not lost.
+ *---------------------------------------------------------------------------*/
+void AsyncQuery::flush()
+{
+  QMetaObject::invokeMethod(worker_, "flush", Qt::BlockingQueuedConnection);
+}
+
+// ----------------------------------------------------------------------------
+void AsyncQuery::slotFinished(AsyncQueryResult result)
+{
+  Callback callback = callbacks_.take(result.id);
+  LOG_DEBUG(LogFile::Sql) << "async query" << result.id << "rows:"
+                          << result.rows.count() << result.error;
+  if (!callback.receiver) return;
+
+  QMetaObject::invokeMethod(callback.receiver, callback.member.constData(),
+                            Q_ARG(AsyncQueryResult, result));
+}
@@ -0,0 +1,86 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef ASYNCQUERY_H
+#define ASYNCQUERY_H
+
+#include <QObject>
+#include <QPointer>
+#include <QStringList>
+#include <QThread>
+#include <QVariant>
+
+struct AsyncQueryResult {
+  int id;
+  QVariant tag;
+  QList<QVariantList> rows;
+  int numRowsAffected;
+  QString error;
+};
+
+/** @brief Execute queries of database thread
+ *---------------------------------------------------------------------------*/
+class AsyncQueryWorker : public QObject
+{
+  Q_OBJECT
+public slots:
+  void run(int id, const QStringList &sqlList, const QVariantList &values,
+           const QVariant &tag);
+  void flush();
+
+signals:
+  void finished(AsyncQueryResult result);
+
+};
+
+/** @brief Queries run out of GUI thread
+ *
+ * Statements are executed one by one in database thread by own connection,
+ * result is passed to slot \a member of \a receiver in GUI thread. Slot
+ * takes AsyncQueryResult and is not called if receiver is deleted.
+ *---------------------------------------------------------------------------*/
+class AsyncQuery : public QObject
+{
+  Q_OBJECT
+public:
+  explicit AsyncQuery(QObject *parent = 0);
+  ~AsyncQuery();
+
+  int exec(const QString &sql, const QVariantList &values = QVariantList(),
+           QObject *receiver = 0, const char *member = 0,
+           const QVariant &tag = QVariant());
+  int exec(const QStringList &sqlList, QObject *receiver = 0,
+           const char *member = 0, const QVariant &tag = QVariant());
+  void flush();
+
+private slots:
+  void slotFinished(AsyncQueryResult result);
+
+private:
+  struct Callback {
+    QPointer<QObject> receiver;
+    QByteArray member;
+  };
+
+  QThread *thread_;
+  AsyncQueryWorker *worker_;
+  int lastId_;
+  QHash<int, Callback> callbacks_;
+
+};
+
+#endif // ASYNCQUERY_H
@@ -18,15 +18,55 @@
 #include "database.h"
 
 #include "common.h"
+#include "logfile.h"
 #include "mainapplication.h"
 #include "mainwindow.h"
+#include "pipelinemetrics.h"
 #include "settings.h"
 #include "VersionNo.h"
 #include "sqlitedriver.h"
 
 #include <sqlite3.h>
+#include <algorithm>
 
-const int versionDB = 17;
+const int versionDB = 37;
+
+// Pages copied by one step of memory base backup
+#define DB_BACKUP_PAGES 1024
+// Pause between backup steps (ms)
+#define DB_BACKUP_SLEEP 10
+// Part of splash screen progress taken by loading of memory base (%)
+#define DB_LOAD_PROGRESS 30
+// Address space mapped beyond file size for mapped memory mode (bytes)
+#define DB_MAP_RESERVE (Q_INT64_C(256) * 1024 * 1024)
+// Wait for locked base file on backup (ms)
+#define DB_BACKUP_TIMEOUT 5000
+// Part of free pages in file, from which full vacuum is worth it
+#define DB_VACUUM_FREE_RATIO 0.25
+// Statements faster than this are not collected for performance report (ns)
+#define DB_SLOW_STATEMENT_TIME 1000000
+// News older than this are moved to archive base (days)
+#define DB_ARCHIVE_DAYS 180
+// Rows of each index read by ANALYZE, keeps first analyze of big base short
+#define DB_ANALYSIS_LIMIT 1000
+// Read connections have no dirty pages, so more of file is mapped (bytes)
+#define DB_READ_MMAP_SIZE (Q_INT64_C(256) * 1024 * 1024)
+
+int Database::savedChanges_ = -1;
+bool Database::ftsEnabled_ = false;
+bool Database::archiveAttached_ = false;
+QStringList Database::archiveColumns_;
+QMutex Database::connectionsMutex_;
+QHash<QString, QSqlDatabase> Database::connections_;
+QHash<QString, QThread *> Database::connectionThreads_;
+int Database::readCheckouts_[Database::ReadPurposeCount] = { 0 };
+int Database::readFallbacks_ = 0;
+
+static const char *readPurposeName(int purpose)
+{
+  static const char *names[] = { "newsContent", "counters", "newsList" };
+  return names[purpose];
+}
 
 const QString kCreateFeedsTableQuery(
     "CREATE TABLE feeds("
@@ -56,12 +96,12 @@ const QString kCreateFeedsTableQuery(
     "ttl integer, "              // Time in minutes the feed can be cached
     "skipHours varchar, "        // Tip for aggregators, not to update the feed (specify hours of the day that can be skipped)
     "skipDays varchar, "         // Tip for aggregators, not to update the feed (specify day of the week that can be skipped)
-    "image blob, "               // gif, jpeg, png picture, that can be associated with the feed
-    "unread integer, "           // number of unread news
-    "newCount integer, "         // number of new news
+    "image blob, "               // not used since version 33, see feedsIcons
+    "unread integer, "           // not used since version 33, see feedsState
+    "newCount integer, "         // not used since version 33, see feedsState
     "currentNews integer, "      // current displayed news
     "label varchar, "            // user purpose label(s)
-    "undeleteCount integer, "    // number of all news (not marked deleted)
+    "undeleteCount integer, "    // not used since version 33, see feedsState
     "tags varchar, "             // user purpose tags
     // --- Categories ---
     "hasChildren integer default 0, "  // Children presence. Default - none
@@ -83,7 +123,7 @@ const QString kCreateFeedsTableQuery(
     // --- Display ---
     "layout text, "      // news display layout
     "filter text, "      // news display filter
-    "groupBy int, "      // column number to sort by
+    "groupBy int, "      // column number to group by, reserved (not read)
     "displayNews int, "  // 0 - display content from news; 1 - download content from link
     "displayEmbeddedImages integer default 1, "  // display images embedded in news
     "loadTypes text, "                           // type of content to load ("images" or "images sounds" - images only or images and sound)
@@ -122,7 +162,11 @@ const QString kCreateFeedsTableQuery(
     // Version 17
     "SingleClickAction integer default 0, " // ENewsClickAction
     "DoubleClickAction integer default 0, " // ENewsClickAction
-    "MiddleClickAction integer default 0 "  // ENewsClickAction
+    "MiddleClickAction integer default 0, " // ENewsClickAction
+    // Version 18
+    "etag varchar, "                        // entity tag of the last received feed data
+    // Version 26
+    "downloadEnclosures integer default 0 " // download enclosures of new news
     ")");
 
 const QString kCreateNewsTableQuery(
@@ -162,7 +206,25 @@ const QString kCreateNewsTableQuery(
     "contributor varchar, "                // contributors (tabs separated)
     "rights varchar, "                     // copyrights
     "deleteDate varchar, "                 // news delete timestamp
-    "feedParentId integer default 0 "      // parent feed id from feed table
+    "feedParentId integer default 0, "     // parent feed id from feed table
+    // Version 27
+    "snippet varchar, "                    // beginning of description as plain text
+    // Version 28
+    "titleHash integer, "                  // hash of normalized title
+    "simhash integer, "                    // SimHash of description words
+    // Version 29
+    "clusterId integer, "                  // news id of first item of same story
+    "clusterSize integer default 0 "       // number of other items of story (on first item)
+    ")");
+
+// News bodies are kept apart from news table, so scanning news flags
+// does not read large overflow pages
+const QString kCreateNewsContentTable(
+    "CREATE TABLE IF NOT EXISTS newsContent("
+    "newsId integer primary key, "  // news id from news table
+    "description varchar, "         // brief description
+    "content varchar, "             // full content (atom)
+    "article varchar "              // readable text of news page
     ")");
 
 const QString kCreateFiltersTable(
@@ -203,6 +265,75 @@ const QString kCreateLabelsTable(
     "currentNews integer "      // current displayed news
     ")");
 
+// News labels are also kept in news.label as ",id1,id2," string, this
+// table is filled from it by triggers and is used to select news by label
+const QString kCreateNewsLabelsTable(
+    "CREATE TABLE IF NOT EXISTS newsLabels("
+    "newsId integer, "          // news id from news table
+    "labelId integer, "         // label id from labels table
+    "PRIMARY KEY (labelId, newsId)"
+    ") WITHOUT ROWID");
+
+const QString kCreateNewsFingerprintsTable(
+    "CREATE TABLE IF NOT EXISTS newsFingerprints("
+    "fingerprint integer, "     // band of news simhash with band number
+    "newsId integer, "          // news id from news table
+    "PRIMARY KEY (fingerprint, newsId)"
+    ") WITHOUT ROWID");
+
+// Digests of news keys of feed saved by parser, so keys of long feed
+// history are not read from news table on each update
+const QString kCreateNewsKeysTable(
+    "CREATE TABLE IF NOT EXISTS newsKeys("
+    "feedId integer primary key, "  // feed id from feeds table
+    "newsCount integer, "           // number of news of feed when saved
+    "maxNewsId integer, "           // last news id of feed when saved
+    "digests blob"                  // 64-bit digests of keys, big-endian
+    ")");
+
+const QString kCreateSyncItemsTable(
+    "CREATE TABLE IF NOT EXISTS syncItems("
+    "itemId varchar primary key, "  // item id of sync server, 16 hex digits
+    "feedId integer, "              // feed id from feeds table
+    "newsId integer default 0, "    // news id, -1 if item is duplicate of news
+    "read integer default 0, "      // read state known to server
+    "starred integer default 0"     // starred state known to server
+    ")");
+
+const QString kCreateNewsTombstonesTable(
+    "CREATE TABLE IF NOT EXISTS newsTombstones("
+    "feedId integer, "              // feed id from feeds table
+    "published varchar, "           // date of purged news, may be empty
+    "digests blob"                  // 64-bit digests of keys, big-endian
+    ")");
+
+const QString kCreateFeedsStateTable(
+    "CREATE TABLE IF NOT EXISTS feedsState("
+    "feedId integer primary key, "   // feed id from feeds table
+    "unread integer default 0, "     // number of unread news
+    "newCount integer default 0, "   // number of new news
+    "undeleteCount integer default 0"  // number of all news (not marked deleted)
+    ")");
+
+// Counters of categories "Starred", "Deleted" and of labels, kept by
+// triggers on news. Category is label id, or one of kCategory* below
+const QString kCreateCategoryCountsTable(
+    "CREATE TABLE IF NOT EXISTS categoryCounts("
+    "category integer primary key, "  // label id or category
+    "allCount integer default 0, "    // number of news, new news for totals
+    "unreadCount integer default 0"   // number of unread news
+    ")");
+const int kCategoryStarred = -1;
+const int kCategoryDeleted = -2;
+// Totals of all feeds shown in tray
+const int kCategoryTotal = -3;
+
+const QString kCreateFeedsIconsTable(
+    "CREATE TABLE IF NOT EXISTS feedsIcons("
+    "feedId integer primary key, "   // feed id from feeds table
+    "image blob"                     // gif, jpeg, png picture, that can be associated with the feed
+    ")");
+
 const QString kCreatePasswordsTable(
     "CREATE TABLE passwords("
     "id integer primary key, "
@@ -224,6 +355,11 @@ int Database::version()
 
 void Database::initialization()
 {
+  // Statements are traced from the first connection
+  Settings settings;
+  if (settings.value("traceSQL", false).toBool() || LogFile::isEnabled(LogFile::Sql))
+    SQLiteDriver::setTraceEnabled(true);
+
   prepareDatabase();
 
   SQLiteDriver *driver = new SQLiteDriver();
@@ -234,30 +370,107 @@ void Database::initialization()
     db.setDatabaseName(mainApp->dbFileName());
   if (db.open()) {
     setPragma(db);
+    setProfiler(db);
 
     if (mainApp->storeDBMemory()) {
       sqliteDBMemFile(db, false);
     }
+    // Base in memory has one connection, it moves news to archive too
+    attachArchive(db, mainApp->storeDBMemory());
+
+    // Triggers of full-text index use uncompress() of SQLiteDriver,
+    // so index is created by this connection
+    createNewsFts(db);
+
+    if (settings.value("checkQueryPlans", false).toBool())
+      checkQueryPlans(db);
   }
 }
 
 void Database::setPragma(QSqlDatabase &db)
 {
-  Settings settings;
+  QSharedPointer<const SettingsSnapshot> options = Settings::snapshot();
   QSqlQuery q(db);
   q.setForwardOnly(true);
   q.exec("PRAGMA encoding = \"UTF-8\"");
 
-  QString sync = settings.value("synchronousDB", "FULL").toString();
+  // In WAL mode data is synced on checkpoints only
+  QString sync = options->synchronousDB;
+  if (sync.isEmpty())
+    sync = mainApp->walDB() ? "NORMAL" : "FULL";
   q.exec(QString("PRAGMA synchronous = %1").arg(sync));
 //  q.exec("PRAGMA journal_mode = MEMORY");
 //  q.exec("PRAGMA temp_store = MEMORY");
 
   q.exec("PRAGMA page_size = 4096");
-  q.exec("PRAGMA cache_size = 16384");
+  // Applied to new base at once, to existing base on next full vacuum
+  q.exec(QString("PRAGMA auto_vacuum = %1").
+         arg(options->incrementalVacuum ? "INCREMENTAL" : "NONE"));
+
+  // Storage tuning profile: "lowMemory", "balanced" or "throughput"
+  const QString &profile = options->storageProfile;
+  int cacheSize = 16384;              // pages
+  qint64 mmapSize = 64 * 1024 * 1024;
+  int tempStore = 0;                  // default
+  qint64 journalSizeLimit = 16 * 1024 * 1024;
+  if (profile == "lowMemory") {
+    cacheSize = 2048;
+    mmapSize = 0;
+    tempStore = 1;                    // file
+    journalSizeLimit = 1024 * 1024;
+  } else if (profile == "throughput") {
+    cacheSize = 65536;
+    mmapSize = Q_INT64_C(1024) * 1024 * 1024;
+    tempStore = 2;                    // memory
+    journalSizeLimit = 64 * 1024 * 1024;
+  }
+  // Mapped memory mode keeps whole file mapped and hot pages cached
+  if (mainApp->mapDBMemory()) {
+    qint64 fileSize = QFileInfo(mainApp->dbFileName()).size();
+    mmapSize = qMax(mmapSize, fileSize + DB_MAP_RESERVE);
+    cacheSize = qMax(cacheSize, 65536);
+    tempStore = 2;
+  }
+  q.exec(QString("PRAGMA cache_size = %1").arg(cacheSize));
+  q.exec(QString("PRAGMA mmap_size = %1").arg(mmapSize));
+  q.exec(QString("PRAGMA temp_store = %1").arg(tempStore));
+  q.exec(QString("PRAGMA journal_size_limit = %1").arg(journalSizeLimit));
+
+  // Journal mode is stored in file, so it is switched back when WAL is disabled
+  if (db.databaseName() != ":memory:") {
+    q.exec(QString("PRAGMA journal_mode = %1").arg(mainApp->walDB() ? "WAL" : "DELETE"));
+  }
   q.finish();
 }
 
+/** @brief Storage settings of connection for diagnostics
+ *----------------------------------------------------------------------------*/
+QStringList Database::storageInfo(const QString &connectionName)
+{
+  QStringList info;
+  info.append(QString("profile = %1").arg(Settings::snapshot()->storageProfile));
+
+  QSqlQuery q(connection(connectionName));
+  q.setForwardOnly(true);
+  QStringList pragmas;
+  pragmas << "journal_mode" << "synchronous" << "page_size" << "cache_size"
+          << "mmap_size" << "temp_store" << "journal_size_limit"
+          << "auto_vacuum" << "page_count" << "freelist_count";
+  foreach (const QString &pragma, pragmas) {
+    if (q.exec(QString("PRAGMA %1").arg(pragma)) && q.first())
+      info.append(QString("%1 = %2").arg(pragma).arg(q.value(0).toString()));
+  }
+  // Results of idle maintenance
+  QSqlDatabase db = connection(connectionName);
+  QString value = infoValue(db, "plannerOptimized");
+  info.append(QString("optimize = %1").arg(value.isEmpty() ? "never" : value));
+  value = infoValue(db, "quickCheck");
+  info.append(QString("quick_check = %1").arg(value.isEmpty() ? "never" : value));
+  if (connectionName.isEmpty())
+    info.append(readPoolInfo());
+  return info;
+}
+
 void Database::prepareDatabase()
 {
   {
@@ -325,6 +538,99 @@ void Database::prepareDatabase()
           q.exec("ALTER table feeds ADD COLUMN DoubleClickAction integer default 0");
           q.exec("ALTER table feeds ADD COLUMN MiddleClickAction integer default 0");
         }
+        if (dbVersion < 18) {
+          q.exec("ALTER TABLE feeds ADD COLUMN etag varchar");
+        }
+        if (dbVersion < 19) {
+          q.exec("CREATE INDEX IF NOT EXISTS feedCounts ON news(feedId, deleted, read, new)");
+        }
+        if (dbVersion < 21) {
+          createIndexes(db);
+        }
+        if (dbVersion < 22) {
+          q.exec("DROP INDEX IF EXISTS newsTitle");
+          createIndexes(db);
+          db.transaction();
+          createNewsContent(db);
+          q.exec("INSERT OR IGNORE INTO newsContent(newsId, description, content) "
+                 "SELECT id, description, content FROM news "
+                 "WHERE description IS NOT NULL OR content IS NOT NULL");
+          q.exec("UPDATE news SET description=NULL, content=NULL");
+          db.commit();
+        }
+        if (dbVersion < 23) {
+          db.transaction();
+          createNewsLabels(db);
+          q.exec("INSERT OR IGNORE INTO newsLabels(newsId, labelId) "
+                 "SELECT news.id, labels.id FROM news, labels "
+                 "WHERE news.label LIKE '%,' || labels.id || ',%'");
+          db.commit();
+        }
+        if (dbVersion < 24) {
+          createIndexes(db);
+        }
+        if (dbVersion < 25) {
+          q.exec("ALTER TABLE newsContent ADD COLUMN article varchar");
+          // Index is not updated when article is stored
+          q.exec("DROP TRIGGER IF EXISTS newsFtsUpdate");
+        }
+        if (dbVersion < 26) {
+          q.exec("ALTER TABLE feeds ADD COLUMN downloadEnclosures integer default 0");
+        }
+        if (dbVersion < 27) {
+          q.exec("ALTER TABLE news ADD COLUMN snippet varchar");
+        }
+        if (dbVersion < 28) {
+          q.exec("ALTER TABLE news ADD COLUMN titleHash integer");
+          q.exec("ALTER TABLE news ADD COLUMN simhash integer");
+          createIndexes(db);
+          createNewsFingerprints(db);
+        }
+        if (dbVersion < 29) {
+          q.exec("ALTER TABLE news ADD COLUMN clusterId integer");
+          q.exec("ALTER TABLE news ADD COLUMN clusterSize integer default 0");
+          createIndexes(db);
+        }
+        if (dbVersion < 30) {
+          createNewsKeys(db);
+        }
+        if (dbVersion < 31) {
+          createSyncItems(db);
+        }
+        if (dbVersion < 32) {
+          createNewsTombstones(db);
+        }
+        if (dbVersion < 33) {
+          db.transaction();
+          createFeedsState(db);
+          q.exec("INSERT OR IGNORE INTO feedsState(feedId, unread, newCount, undeleteCount) "
+                 "SELECT id, ifnull(unread, 0), ifnull(newCount, 0), ifnull(undeleteCount, 0) "
+                 "FROM feeds");
+          q.exec("INSERT OR IGNORE INTO feedsIcons(feedId, image) "
+                 "SELECT id, image FROM feeds WHERE image IS NOT NULL");
+          q.exec("UPDATE feeds SET image=NULL, unread=NULL, newCount=NULL, undeleteCount=NULL");
+          db.commit();
+        }
+        if (dbVersion < 34) {
+          db.transaction();
+          createCategoryCounts(db);
+          recountCategoryCounts(db);
+          db.commit();
+        }
+        if ((dbVersion >= 34) && (dbVersion < 35)) {
+          db.transaction();
+          q.exec("DROP TRIGGER IF EXISTS categoryCountsUpdate");
+          createCategoryCounts(db);
+          recountCategoryCounts(db);
+          db.commit();
+        }
+        if (dbVersion < 36) {
+          createIndexes(db);
+        }
+        if (dbVersion < 37) {
+          q.exec("DROP INDEX IF EXISTS newsTitle");
+          createIndexes(db);
+        }
 
         // Update appVersion anyway
         if (appVersion.isEmpty()) {
@@ -351,21 +657,533 @@ void Database::prepareDatabase()
       }
 
       q.finish();
+      prepareArchive(db);
       db.close();
     }
   }
   QSqlDatabase::removeDatabase("initialization");
 }
 
+/** @brief Create indexes for news list, categories, counters and clean up
+ *----------------------------------------------------------------------------*/
+void Database::createIndexes(QSqlDatabase &db)
+{
+  // News list of feed sorted by date, title, author or received date.
+  // Sorting by read state uses index feedCounts
+  db.exec("CREATE INDEX IF NOT EXISTS newsFeedPublished ON news(feedId, deleted, published)");
+  db.exec("CREATE INDEX IF NOT EXISTS newsFeedTitle ON news(feedId, deleted, title)");
+  db.exec("CREATE INDEX IF NOT EXISTS newsFeedAuthor ON news(feedId, deleted, author_name)");
+  db.exec("CREATE INDEX IF NOT EXISTS newsFeedReceived ON news(feedId, deleted, received)");
+  // Categories "Unread", "Starred" and "Deleted"
+  db.exec("CREATE INDEX IF NOT EXISTS newsDeletedRead ON news(deleted, read)");
+  db.exec("CREATE INDEX IF NOT EXISTS newsDeletedStarred ON news(deleted, starred)");
+  db.exec("CREATE INDEX IF NOT EXISTS newsDeletedDate ON news(deleted, deleteDate)");
+  // Partial indexes hold only news of category, so its list and marking
+  // news of it read do not walk all news. Conditions are written as in
+  // filters of categories, otherwise SQLite does not use them
+  db.exec("CREATE INDEX IF NOT EXISTS newsUnreadPublished ON news(published) "
+          "WHERE deleted = 0 AND read < 2");
+  db.exec("CREATE INDEX IF NOT EXISTS newsStarredPublished ON news(published) "
+          "WHERE deleted = 0 AND starred = 1");
+  db.exec("CREATE INDEX IF NOT EXISTS newsDeletedOnly ON news(deleteDate) "
+          "WHERE deleted = 1");
+  // Folders counters
+  db.exec("CREATE INDEX IF NOT EXISTS feedsParentId ON feeds(parentId)");
+  // Identical news in other feeds. Collation NOCASE is not used because
+  // SQLiteDriver replaces it, built-in lower() is the same in both drivers
+  db.exec("CREATE INDEX IF NOT EXISTS newsTitleLower ON news(lower(title))");
+  // Same story with changed case or punctuation
+  db.exec("CREATE INDEX IF NOT EXISTS newsTitleHash ON news(titleHash)");
+  // Members of story in clustered news layout
+  db.exec("CREATE INDEX IF NOT EXISTS newsClusterId ON news(clusterId)");
+}
+
+/** @brief Create table of news bodies
+ *
+ * Bodies are removed with news by triggers, so code that deletes or
+ * purges news does not need to know about the table.
+ *----------------------------------------------------------------------------*/
+void Database::createNewsContent(QSqlDatabase &db)
+{
+  db.exec(kCreateNewsContentTable);
+  db.exec("CREATE TRIGGER IF NOT EXISTS newsContentDelete AFTER DELETE ON news "
+          "BEGIN DELETE FROM newsContent WHERE newsId=old.id; END");
+  db.exec("CREATE TRIGGER IF NOT EXISTS newsContentPurge AFTER UPDATE OF deleted ON news "
+          "WHEN new.deleted>=2 "
+          "BEGIN DELETE FROM newsContent WHERE newsId=new.id; END");
+}
+
+/** @brief Create table of saved digests of news keys
+ *----------------------------------------------------------------------------*/
+void Database::createNewsKeys(QSqlDatabase &db)
+{
+  db.exec(kCreateNewsKeysTable);
+  db.exec("CREATE TRIGGER IF NOT EXISTS newsKeysDelete AFTER DELETE ON feeds "
+          "BEGIN DELETE FROM newsKeys WHERE feedId=old.id; END");
+}
+
+/** @brief Create tables of feed counters and icons
+ *
+ * Counters are updated after every change of news and icons are big, so
+ * both are kept out of wide rows of feeds table. Rows of counters are
+ * added and both removed with feeds by triggers.
+ *----------------------------------------------------------------------------*/
+void Database::createFeedsState(QSqlDatabase &db)
+{
+  db.exec(kCreateFeedsStateTable);
+  db.exec(kCreateFeedsIconsTable);
+  db.exec("CREATE TRIGGER IF NOT EXISTS feedsStateInsert AFTER INSERT ON feeds "
+          "BEGIN INSERT OR IGNORE INTO feedsState(feedId) VALUES(new.id); END");
+  db.exec("CREATE TRIGGER IF NOT EXISTS feedsStateDelete AFTER DELETE ON feeds "
+          "BEGIN DELETE FROM feedsState WHERE feedId=old.id; "
+          "DELETE FROM feedsIcons WHERE feedId=old.id; END");
+}
+
+/** @brief Change counters of categories by contribution of \a row
+ *
+ * \a row is "old" or "new" row of trigger, \a sign is "+" or "-".
+ *----------------------------------------------------------------------------*/
+static QString categoryCountsChange(const QString &row, const QString &sign)
+{
+  return QString(
+        "UPDATE categoryCounts SET allCount=allCount%2 1, unreadCount=unreadCount%2 (%1.read IS 0) "
+        "WHERE category=%3 AND %1.deleted==0 AND %1.starred==1; "
+        "UPDATE categoryCounts SET allCount=allCount%2 1 "
+        "WHERE category=%4 AND %1.deleted==1; "
+        "UPDATE categoryCounts SET allCount=allCount%2 1, unreadCount=unreadCount%2 (%1.read IS 0) "
+        "WHERE category>0 AND %1.deleted==0 AND %1.label LIKE '%,' || category || ',%'; "
+        "UPDATE categoryCounts SET allCount=allCount%2 (%1.new IS 1), unreadCount=unreadCount%2 (%1.read IS 0) "
+        "WHERE category=%5 AND %1.deleted==0; ").
+      arg(row, sign, QString::number(kCategoryStarred), QString::number(kCategoryDeleted),
+          QString::number(kCategoryTotal));
+}
+
+/** @brief Create table of categories counters and triggers keeping it
+ *
+ * Counters are changed by each written news, so categories tree does not
+ * count news of whole base.
+ *----------------------------------------------------------------------------*/
+void Database::createCategoryCounts(QSqlDatabase &db)
+{
+  db.exec(kCreateCategoryCountsTable);
+  db.exec("CREATE TRIGGER IF NOT EXISTS categoryCountsInsert AFTER INSERT ON news "
+          "WHEN new.deleted < 2 "
+          "BEGIN " + categoryCountsChange("new", "+") + "END");
+  db.exec("CREATE TRIGGER IF NOT EXISTS categoryCountsDelete AFTER DELETE ON news "
+          "WHEN old.deleted < 2 "
+          "BEGIN " + categoryCountsChange("old", "-") + "END");
+  db.exec("CREATE TRIGGER IF NOT EXISTS categoryCountsUpdate "
+          "AFTER UPDATE OF deleted, starred, read, new, label ON news "
+          "WHEN (old.deleted < 2 OR new.deleted < 2) AND "
+          "(old.deleted IS NOT new.deleted OR old.starred IS NOT new.starred OR "
+          "old.read IS NOT new.read OR old.new IS NOT new.new OR "
+          "old.label IS NOT new.label) "
+          "BEGIN " + categoryCountsChange("old", "-") +
+          categoryCountsChange("new", "+") + "END");
+  db.exec("CREATE TRIGGER IF NOT EXISTS categoryCountsLabelInsert AFTER INSERT ON labels "
+          "BEGIN INSERT OR IGNORE INTO categoryCounts(category) VALUES(new.id); END");
+  db.exec("CREATE TRIGGER IF NOT EXISTS categoryCountsLabelDelete AFTER DELETE ON labels "
+          "BEGIN DELETE FROM categoryCounts WHERE category=old.id; END");
+
+  QSqlQuery q(db);
+  q.exec(QString("INSERT OR IGNORE INTO categoryCounts(category) VALUES(%1)").arg(kCategoryStarred));
+  q.exec(QString("INSERT OR IGNORE INTO categoryCounts(category) VALUES(%1)").arg(kCategoryDeleted));
+  q.exec(QString("INSERT OR IGNORE INTO categoryCounts(category) VALUES(%1)").arg(kCategoryTotal));
+  q.exec("INSERT OR IGNORE INTO categoryCounts(category) SELECT id FROM labels");
+}
+
+/** @brief Count news of all categories again
+ *----------------------------------------------------------------------------*/
+void Database::recountCategoryCounts(QSqlDatabase &db)
+{
+  QSqlQuery q(db);
+  q.exec(QString("UPDATE categoryCounts SET "
+                 "allCount=(SELECT count(*) FROM news WHERE deleted==0 AND starred==1), "
+                 "unreadCount=(SELECT count(*) FROM news WHERE deleted==0 AND starred==1 AND read==0) "
+                 "WHERE category=%1").arg(kCategoryStarred));
+  q.exec(QString("UPDATE categoryCounts SET "
+                 "allCount=(SELECT count(*) FROM news WHERE deleted==1), unreadCount=0 "
+                 "WHERE category=%1").arg(kCategoryDeleted));
+  q.exec(QString("UPDATE categoryCounts SET "
+                 "allCount=(SELECT count(*) FROM news WHERE deleted==0 AND new==1), "
+                 "unreadCount=(SELECT count(*) FROM news WHERE deleted==0 AND read==0) "
+                 "WHERE category=%1").arg(kCategoryTotal));
+  q.exec("UPDATE categoryCounts SET "
+         "allCount=(SELECT count(*) FROM newsLabels JOIN news ON news.id=newsLabels.newsId "
+         "WHERE labelId=category AND deleted==0), "
+         "unreadCount=(SELECT count(*) FROM newsLabels JOIN news ON news.id=newsLabels.newsId "
+         "WHERE labelId=category AND deleted==0 AND read==0) "
+         "WHERE category>0");
+}
+
+/** @brief Create table of items of sync server
+ *----------------------------------------------------------------------------*/
+void Database::createSyncItems(QSqlDatabase &db)
+{
+  db.exec(kCreateSyncItemsTable);
+  db.exec("CREATE INDEX IF NOT EXISTS syncItemsFeedId ON syncItems(feedId)");
+  db.exec("CREATE TRIGGER IF NOT EXISTS syncItemsDelete AFTER DELETE ON feeds "
+          "BEGIN DELETE FROM syncItems WHERE feedId=old.id; END");
+}
+
+/** @brief Create table of keys of news purged by clean up
+ *
+ * Purged news are known as duplicates by digests of their keys, their rows
+ * are deleted from news table.
+ *----------------------------------------------------------------------------*/
+void Database::createNewsTombstones(QSqlDatabase &db)
+{
+  db.exec(kCreateNewsTombstonesTable);
+  db.exec("CREATE INDEX IF NOT EXISTS newsTombstonesFeedId ON newsTombstones(feedId)");
+  db.exec("CREATE TRIGGER IF NOT EXISTS newsTombstonesDelete AFTER DELETE ON feeds "
+          "BEGIN DELETE FROM newsTombstones WHERE feedId=old.id; END");
+}
+
+QString Database::archiveFileName()
+{
+  return QFileInfo(mainApp->dbFileName()).absolutePath() + "/archive.db";
+}
+
+/** @brief Create archive base or add new columns of news to it
+ *
+ * Archive is enabled by "Settings/archiveEnabled". Its tables are created
+ * by the same statements as tables of main base.
+ *----------------------------------------------------------------------------*/
+void Database::prepareArchive(QSqlDatabase &db)
+{
+  Settings settings;
+  archiveColumns_.clear();
+  if (!settings.value("Settings/archiveEnabled", false).toBool())
+    return;
+
+  QSqlQuery q(db);
+  q.setForwardOnly(true);
+  q.prepare("ATTACH DATABASE ? AS archive");
+  q.addBindValue(archiveFileName());
+  if (!q.exec()) {
+    qWarning() << "Cannot attach archive:" << q.lastError().text();
+    return;
+  }
+
+  QString createNews = kCreateNewsTableQuery;
+  createNews.replace("CREATE TABLE news(", "CREATE TABLE IF NOT EXISTS archive.news(");
+  q.exec(createNews);
+  QString createContent = kCreateNewsContentTable;
+  createContent.replace(" newsContent(", " archive.newsContent(");
+  q.exec(createContent);
+  q.exec("CREATE INDEX IF NOT EXISTS archive.newsFeedId ON news(feedId)");
+
+  QStringList archiveColumns;
+  q.exec("PRAGMA archive.table_info(news)");
+  while (q.next()) {
+    archiveColumns.append(q.value(1).toString());
+  }
+  QStringList columns;
+  QStringList types;
+  q.exec("PRAGMA main.table_info(news)");
+  while (q.next()) {
+    columns.append(q.value(1).toString());
+    types.append(q.value(2).toString());
+  }
+  for (int i = 0; i < columns.count(); ++i) {
+    if (!archiveColumns.contains(columns.at(i)))
+      q.exec(QString("ALTER TABLE archive.news ADD COLUMN %1 %2").arg(columns.at(i), types.at(i)));
+  }
+
+  q.finish();
+  db.exec("DETACH DATABASE archive");
+  archiveColumns_ = columns;
+}
+
+/** @brief Attach archive base to connection
+ *
+ * Connections of GUI read archive only, so it is attached read-only.
+ *----------------------------------------------------------------------------*/
+void Database::attachArchive(QSqlDatabase &db, bool writable)
+{
+  if (archiveColumns_.isEmpty())
+    return;
+
+  QString uri = QString::fromLatin1(QUrl::fromLocalFile(archiveFileName()).toEncoded());
+  if (!writable)
+    uri.append("?mode=ro");
+
+  QSqlQuery q(db);
+  q.prepare("ATTACH DATABASE ? AS archive");
+  q.addBindValue(uri);
+  if (q.exec())
+    archiveAttached_ = true;
+  else
+    qWarning() << "Cannot attach archive:" << q.lastError().text();
+}
+
+/** @brief Move one chunk of old or purged news to archive base
+ *
+ * Read news without star and labels received more than "Settings/archiveDays"
+ * ago are moved, news purged by clean up are compacted to tombstones. The
+ * last news is never moved, so its id is not given to new news again.
+ * @param feedIds Feeds whose counters are changed
+ * @return true if more news remain to be moved
+ *----------------------------------------------------------------------------*/
+bool Database::archiveNews(QSqlDatabase &db, int count, QSet<int> *feedIds)
+{
+  if (!archiveAttached_)
+    return false;
+
+  Settings settings;
+  int archiveDays = settings.value("Settings/archiveDays", DB_ARCHIVE_DAYS).toInt();
+  QString dateStr = QDate::currentDate().addDays(-archiveDays).toString(Qt::ISODate);
+
+  QSqlQuery q(db);
+  q.setForwardOnly(true);
+  q.prepare("SELECT id, feedId FROM main.news WHERE id < (SELECT max(id) FROM main.news) AND "
+            "deleted=0 AND read>0 AND starred=0 AND "
+            "(label='' OR label=',' OR label IS NULL) AND received!='' AND received<? "
+            "LIMIT ?");
+  q.addBindValue(dateStr);
+  q.addBindValue(count);
+  q.exec();
+  QStringList idList;
+  QSet<int> changedFeeds;
+  while (q.next()) {
+    idList.append(q.value(0).toString());
+    changedFeeds.insert(q.value(1).toInt());
+  }
+  if (idList.isEmpty())
+    return false;
+
+  QString idStr = idList.join(",");
+  QString columnsStr = archiveColumns_.join(", ");
+  bool ok = db.transaction();
+  ok = ok && q.exec(QString("INSERT OR REPLACE INTO archive.news(%1) SELECT %1 FROM main.news "
+                            "WHERE id IN (%2)").arg(columnsStr, idStr));
+  ok = ok && q.exec(QString("INSERT OR REPLACE INTO archive.newsContent "
+                            "SELECT newsId, description, content, article FROM main.newsContent "
+                            "WHERE newsId IN (%1)").arg(idStr));
+  ok = ok && q.exec(QString("DELETE FROM main.news WHERE id IN (%1)").arg(idStr));
+  if (!ok) {
+    qWarning() << "Cannot move news to archive:" << q.lastError().text();
+    db.rollback();
+    return false;
+  }
+  db.commit();
+  *feedIds += changedFeeds;
+
+  LOG_DEBUG(LogFile::Sql) << "News moved to archive:" << idList.count();
+  return idList.count() == count;
+}
+
+/** @brief Create table of simhash bands for search of similar news
+ *----------------------------------------------------------------------------*/
+void Database::createNewsFingerprints(QSqlDatabase &db)
+{
+  db.exec(kCreateNewsFingerprintsTable);
+  db.exec("CREATE INDEX IF NOT EXISTS newsFingerprintsNewsId ON newsFingerprints(newsId)");
+  db.exec("CREATE TRIGGER IF NOT EXISTS newsFingerprintsDelete AFTER DELETE ON news "
+          "BEGIN DELETE FROM newsFingerprints WHERE newsId=old.id; END");
+  db.exec("CREATE TRIGGER IF NOT EXISTS newsFingerprintsPurge AFTER UPDATE OF deleted ON news "
+          "WHEN new.deleted>=2 "
+          "BEGIN DELETE FROM newsFingerprints WHERE newsId=new.id; END");
+}
+
+void Database::createNewsLabels(QSqlDatabase &db)
+{
+  db.exec(kCreateNewsLabelsTable);
+  db.exec("CREATE INDEX IF NOT EXISTS newsLabelsNewsId ON newsLabels(newsId)");
+  db.exec("CREATE TRIGGER IF NOT EXISTS newsLabelsInsert AFTER INSERT ON news "
+          "WHEN new.label LIKE '%,_%' "
+          "BEGIN INSERT OR IGNORE INTO newsLabels(newsId, labelId) "
+          "SELECT new.id, id FROM labels WHERE new.label LIKE '%,' || id || ',%'; END");
+  db.exec("CREATE TRIGGER IF NOT EXISTS newsLabelsUpdate AFTER UPDATE OF label ON news "
+          "BEGIN DELETE FROM newsLabels WHERE newsId=old.id; "
+          "INSERT OR IGNORE INTO newsLabels(newsId, labelId) "
+          "SELECT new.id, id FROM labels WHERE new.label LIKE '%,' || id || ',%'; END");
+  db.exec("CREATE TRIGGER IF NOT EXISTS newsLabelsDelete AFTER DELETE ON news "
+          "BEGIN DELETE FROM newsLabels WHERE newsId=old.id; END");
+  db.exec("CREATE TRIGGER IF NOT EXISTS labelsDelete AFTER DELETE ON labels "
+          "BEGIN DELETE FROM newsLabels WHERE labelId=old.id; END");
+}
+
+/** @brief Create full-text index of news
+ *
+ * Index is filled from newsContent by triggers, news title, author and
+ * category are taken when content row is inserted. Enabled by
+ * "fullTextSearch" key in settings file, index is dropped when disabled.
+ *----------------------------------------------------------------------------*/
+void Database::createNewsFts(QSqlDatabase &db)
+{
+  Settings settings;
+  QSqlQuery q(db);
+  q.setForwardOnly(true);
+  ftsEnabled_ = false;
+
+  if (!settings.value("fullTextSearch", true).toBool()) {
+    q.exec("DROP TRIGGER IF EXISTS newsFtsInsert");
+    q.exec("DROP TRIGGER IF EXISTS newsFtsUpdate");
+    q.exec("DROP TRIGGER IF EXISTS newsFtsDelete");
+    q.exec("DROP TABLE IF EXISTS newsFts");
+    return;
+  }
+
+  q.exec("SELECT 1 FROM sqlite_master WHERE type='table' AND name='newsFts'");
+  bool exists = q.next();
+  q.finish();
+  if (!exists) {
+    db.transaction();
+    if (!q.exec("CREATE VIRTUAL TABLE newsFts USING fts5(title, author, category, content)")) {
+      qWarning() << "Full-text search is not available:" << q.lastError().text();
+      db.rollback();
+      return;
+    }
+    qWarning() << "Creating full-text index";
+    q.exec("INSERT INTO newsFts(rowid, title, author, category, content) "
+           "SELECT news.id, news.title, news.author_name, news.category, "
+           "ifnull(uncompress(newsContent.description), '') || ' ' || "
+           "ifnull(uncompress(newsContent.content), '') "
+           "FROM news JOIN newsContent ON newsContent.newsId=news.id "
+           "WHERE news.deleted < 2");
+    db.commit();
+  }
+
+  QString insertStr("INSERT INTO newsFts(rowid, title, author, category, content) "
+                    "SELECT id, title, author_name, category, "
+                    "ifnull(uncompress(new.description), '') || ' ' || "
+                    "ifnull(uncompress(new.content), '') "
+                    "FROM news WHERE id=new.newsId; ");
+  db.exec("CREATE TRIGGER IF NOT EXISTS newsFtsInsert AFTER INSERT ON newsContent "
+          "BEGIN " + insertStr + "END");
+  db.exec("CREATE TRIGGER IF NOT EXISTS newsFtsUpdate "
+          "AFTER UPDATE OF description, content ON newsContent "
+          "BEGIN DELETE FROM newsFts WHERE rowid=old.newsId; " + insertStr + "END");
+  db.exec("CREATE TRIGGER IF NOT EXISTS newsFtsDelete AFTER DELETE ON newsContent "
+          "BEGIN DELETE FROM newsFts WHERE rowid=old.newsId; END");
+  ftsEnabled_ = true;
+}
+
+/** @brief Return condition for news filter to find text
+ *
+ * Full-text index is used if available: every word of text is found
+ * as word prefix. Otherwise text is found as substring.
+ * Archive has no full-text index, its news are found as substring.
+ * @param findMode Object name of find action
+ * @param text Text to find
+ * @param archive Condition is for news of archive base
+ * @return Condition with leading " AND " or empty string
+ *----------------------------------------------------------------------------*/
+QString Database::findNewsFilter(const QString &findMode, const QString &text,
+                                 bool archive)
+{
+  if (text.isEmpty())
+    return QString();
+
+  if (findMode == "findLinkAct") {
+    QString findText = text;
+    findText.replace("'", "''");
+    return QString(" AND link_href LIKE '%%1%'").arg(findText);
+  }
+
+  if (ftsEnabled_ && !archive) {
+    QString column;
+    if (findMode == "findTitleAct")
+      column = "title : ";
+    else if (findMode == "findAuthorAct")
+      column = "author : ";
+    else if (findMode == "findCategoryAct")
+      column = "category : ";
+    else if (findMode == "findContentAct")
+      column = "content : ";
+
+    QStringList terms;
+    foreach (QString word, text.split(QRegExp("\\s+"), QString::SkipEmptyParts)) {
+      word.replace("\"", "\"\"");
+      terms.append(QString("%1\"%2\"*").arg(column).arg(word));
+    }
+    if (terms.isEmpty())
+      return QString();
+    QString matchStr = terms.join(" AND ");
+    matchStr.replace("'", "''");
+    return QString(" AND id IN (SELECT rowid FROM newsFts WHERE newsFts MATCH '%1')").
+        arg(matchStr);
+  }
+
+  QString findText = text;
+  findText = findText.replace("'", "''").toUpper();
+  QString contentStr = QString("id IN (SELECT newsId FROM %1 "
+                               "WHERE UPPER(uncompress(content)) LIKE '%%2%' "
+                               "OR UPPER(uncompress(description)) LIKE '%%2%')").
+      arg(archive ? "archive.newsContent" : "newsContent", findText);
+  if (findMode == "findTitleAct") {
+    return QString(" AND UPPER(title) LIKE '%%1%'").arg(findText);
+  } else if (findMode == "findAuthorAct") {
+    return QString(" AND UPPER(author_name) LIKE '%%1%'").arg(findText);
+  } else if (findMode == "findCategoryAct") {
+    return QString(" AND UPPER(category) LIKE '%%1%'").arg(findText);
+  } else if (findMode == "findContentAct") {
+    return QString(" AND %1").arg(contentStr);
+  }
+  return QString(" AND (UPPER(title) LIKE '%%1%' OR UPPER(author_name) LIKE '%%1%' "
+                 "OR UPPER(category) LIKE '%%1%' OR %2)").arg(findText, contentStr);
+}
+
+/** @brief Log hot queries which are executed without index
+ *
+ * Enabled by "checkQueryPlans" key in settings file.
+ *----------------------------------------------------------------------------*/
+void Database::checkQueryPlans(QSqlDatabase &db)
+{
+  QStringList queries;
+  queries << "SELECT count(id), sum(CASE WHEN read==0 THEN 1 ELSE 0 END), "
+             "sum(CASE WHEN new==1 THEN 1 ELSE 0 END) FROM news WHERE feedId=1 AND deleted==0"
+          << "SELECT guid, title, published, link_href FROM news WHERE feedId=1"
+          << "SELECT * FROM news WHERE feedId=1 AND deleted = 0 ORDER BY published DESC"
+          << "SELECT * FROM news WHERE feedId=1 AND new = 1 AND deleted = 0"
+          << "SELECT id, received FROM news WHERE feedId=1 AND deleted == 0"
+          << "DELETE FROM news WHERE feedId=1 AND deleted >= 2"
+          << "SELECT * FROM news WHERE feedId > 0 AND deleted = 0 AND read < 2"
+          << "SELECT * FROM news WHERE feedId > 0 AND deleted = 0 AND starred = 1"
+          << "SELECT * FROM news WHERE feedId > 0 AND deleted = 1"
+          << "SELECT * FROM news WHERE feedId > 0 AND deleted = 0 AND "
+             "id IN (SELECT newsId FROM newsLabels WHERE labelId=1)"
+          << "SELECT id, feedId FROM news WHERE deleted=1 AND deleteDate!='' ORDER BY deleteDate DESC"
+          << "SELECT sum(feedsState.unread), sum(feedsState.newCount), "
+             "sum(feedsState.undeleteCount), max(updated) "
+             "FROM feeds JOIN feedsState ON feedsState.feedId=feeds.id WHERE parentId=1";
+
+  QSqlQuery q(db);
+  q.setForwardOnly(true);
+  foreach (const QString &query, queries) {
+    QStringList plan;
+    q.exec("EXPLAIN QUERY PLAN " + query);
+    while (q.next()) {
+      plan.append(q.value(3).toString());
+    }
+    bool isScan = false;
+    foreach (const QString &detail, plan) {
+      if (detail.startsWith("SCAN") && !detail.contains("INDEX"))
+        isScan = true;
+    }
+    if (isScan)
+      qWarning() << "Query without index:" << query << plan;
+    else
+      qDebug() << "Query plan:" << query << plan;
+  }
+  q.finish();
+}
+
 void Database::createTables(QSqlDatabase &db)
 {
   db.transaction();
 
   db.exec(kCreateFeedsTableQuery);
   db.exec(kAddColumnsFeedsTableQuery);
+  createFeedsState(db);
   db.exec(kCreateNewsTableQuery);
   // Create index for feedId field
   db.exec("CREATE INDEX feedId ON news(feedId)");
+  // Create covering index for feed counters
+  db.exec("CREATE INDEX feedCounts ON news(feedId, deleted, read, new)");
+  createIndexes(db);
+  createNewsContent(db);
 
   // Create extra feeds table just in case
   db.exec("CREATE TABLE feeds_ex(id integer primary key, "
@@ -392,6 +1210,12 @@ void Database::createTables(QSqlDatabase &db)
           ")");
   // Create labels table
   db.exec(kCreateLabelsTable);
+  createNewsLabels(db);
+  createNewsFingerprints(db);
+  createNewsKeys(db);
+  createSyncItems(db);
+  createNewsTombstones(db);
+  createCategoryCounts(db);
   // Create password table
   db.exec(kCreatePasswordsTable);
   //
@@ -442,18 +1266,131 @@ QSqlDatabase Database::connection(const QString &connectionName)
     db = QSqlDatabase::database();
   }
   else {
-    db = QSqlDatabase::database(connectionName, true);
+    // Connection is owned by thread created it until it is passed to
+    // other thread by setConnectionThread()
+    QMutexLocker locker(&connectionsMutex_);
+    db = connections_.value(connectionName);
     if (!db.isValid()) {
       SQLiteDriver *driver = new SQLiteDriver();
       db = QSqlDatabase::addDatabase(driver, connectionName);
       db.setDatabaseName(mainApp->dbFileName());
       db.open();
       setPragma(db);
+      setProfiler(db);
+      // News are moved to archive by update thread only
+      attachArchive(db, connectionName == "secondConnection");
+      connections_.insert(connectionName, db);
+      connectionThreads_.insert(connectionName, QThread::currentThread());
     }
   }
   return db;
 }
 
+/** @brief Get connection of calling thread
+ *
+ * Main thread uses default connection, worker threads get own connection
+ * on first call, so statements of different threads never share one.
+ *---------------------------------------------------------------------------*/
+QSqlDatabase Database::threadConnection()
+{
+  if (mainApp->storeDBMemory() || (QThread::currentThread() == qApp->thread()))
+    return QSqlDatabase::database();
+
+  QString connectionName;
+  {
+    QMutexLocker locker(&connectionsMutex_);
+    connectionName = connectionThreads_.key(QThread::currentThread());
+  }
+  if (connectionName.isEmpty()) {
+    connectionName = QString("threadConnection_%1").
+        arg(quintptr(QThread::currentThread()), 0, 16);
+  }
+  return connection(connectionName);
+}
+
+/** @brief Pass connection created for worker object to its thread
+ *---------------------------------------------------------------------------*/
+void Database::setConnectionThread(const QString &connectionName, QThread *thread)
+{
+  QMutexLocker locker(&connectionsMutex_);
+  if (connections_.contains(connectionName))
+    connectionThreads_.insert(connectionName, thread);
+}
+
+/** @brief Get read-only connection of GUI thread for \a purpose
+ *
+ * In WAL mode every purpose has own connection, which reads a snapshot
+ * of committed data. So long read does not wait for commits of update
+ * threads and does not hold default connection, which writes. Without
+ * WAL readers would lock writers, and memory base has one connection,
+ * so connection of thread is given then.
+ *---------------------------------------------------------------------------*/
+QSqlDatabase Database::readConnection(ReadPurpose purpose)
+{
+  if (mainApp->storeDBMemory() || !mainApp->walDB() ||
+      (QThread::currentThread() != qApp->thread())) {
+    QMutexLocker locker(&connectionsMutex_);
+    readFallbacks_++;
+    locker.unlock();
+    return threadConnection();
+  }
+
+  QString connectionName = QString("readConnection_%1").arg(readPurposeName(purpose));
+  QMutexLocker locker(&connectionsMutex_);
+  readCheckouts_[purpose]++;
+  QSqlDatabase db = connections_.value(connectionName);
+  if (!db.isValid()) {
+    SQLiteDriver *driver = new SQLiteDriver();
+    db = QSqlDatabase::addDatabase(driver, connectionName);
+    db.setDatabaseName(mainApp->dbFileName());
+    db.open();
+    setPragma(db);
+    setProfiler(db);
+    attachArchive(db, false);
+
+    QSqlQuery q(db);
+    if (Settings::snapshot()->storageProfile != "lowMemory") {
+      qint64 mmapSize = 0;
+      if (q.exec("PRAGMA mmap_size") && q.first())
+        mmapSize = q.value(0).toLongLong();
+      q.exec(QString("PRAGMA mmap_size = %1").arg(qMax(mmapSize, DB_READ_MMAP_SIZE)));
+    }
+    q.exec("PRAGMA query_only = 1");
+    q.finish();
+
+    connections_.insert(connectionName, db);
+    connectionThreads_.insert(connectionName, QThread::currentThread());
+  }
+  return db;
+}
+
+/** @brief Checkouts of read connections for diagnostics
+ *---------------------------------------------------------------------------*/
+QStringList Database::readPoolInfo()
+{
+  QMutexLocker locker(&connectionsMutex_);
+  QStringList info;
+  for (int i = 0; i < ReadPurposeCount; ++i) {
+    info.append(QString("read %1 = %2 checkouts").
+                arg(readPurposeName(i)).arg(readCheckouts_[i]));
+  }
+  info.append(QString("read shared = %1 checkouts").arg(readFallbacks_));
+  return info;
+}
+
+/** @brief Check that \a db is used by thread owning it
+ *
+ * In memory mode all threads share default connection, so check passes.
+ *---------------------------------------------------------------------------*/
+bool Database::isConnectionThread(const QSqlDatabase &db)
+{
+  if (mainApp->storeDBMemory()) return true;
+
+  QMutexLocker locker(&connectionsMutex_);
+  QThread *thread = connectionThreads_.value(db.connectionName(), qApp->thread());
+  return (thread == QThread::currentThread());
+}
+
 void Database::sqliteDBMemFile(QSqlDatabase &db, bool save)
 {
   if (save) qWarning() << "sqliteDBMemFile(): from memory to file...";
@@ -471,9 +1408,24 @@ void Database::sqliteDBMemFile(QSqlDatabase &db, bool save)
       sqlite3 *pTo;             /* Database to copy to (pFile or pInMemory) */
       sqlite3 *pFrom;           /* Database to copy from (pFile or pInMemory) */
 
+      // Nothing to save if base was not modified since last save
+      int totalChanges = sqlite3_total_changes(pInMemory);
+      if (save && (totalChanges == savedChanges_)) {
+        qWarning() << "sqliteDBMemFile(): no changes";
+        return;
+      }
+
+      // Memory base is saved to temporary file which then replaces base file,
+      // so base file is never left half written
+      QString fileName = mainApp->dbFileName();
+      if (save) {
+        fileName.append(".tmp");
+        QFile::remove(fileName);
+      }
+
       /* Open the database file identified by zFilename. Exit early if this fails
       ** for any reason. */
-      rc = sqlite3_open(mainApp->dbFileName().toUtf8().data(), &pFile);
+      rc = sqlite3_open(fileName.toUtf8().data(), &pFile);
       if (rc == SQLITE_OK) {
         /* If this is a 'load' operation (isSave==0), then data is copied
         ** from the database file just opened to database pInMemory.
@@ -498,21 +1450,25 @@ void Database::sqliteDBMemFile(QSqlDatabase &db, bool save)
 
         pBackup = sqlite3_backup_init(pTo, "main", pFrom, "main");
 
-        /* Each iteration of this loop copies 5 database pages from database
-        ** pDb to the backup database. If the return value of backup_step()
-        ** indicates that there are still further pages to copy, sleep for
-        ** 250 ms before repeating. */
+        /* Each iteration of this loop copies DB_BACKUP_PAGES pages. On save
+        ** connection is released between steps, so other threads are not
+        ** blocked while whole base is copied. Load is done on startup before
+        ** base is used, so it runs without pauses and shows progress. */
         do {
-          rc = sqlite3_backup_step(pBackup, 10000);
+          rc = sqlite3_backup_step(pBackup, DB_BACKUP_PAGES);
 
+          int remaining = sqlite3_backup_remaining(pBackup);
+          int pagecount = sqlite3_backup_pagecount(pBackup);
           if (!mainApp->isNoDebugOutput()) {
-            int remaining = sqlite3_backup_remaining(pBackup);
-            int pagecount = sqlite3_backup_pagecount(pBackup);
             qDebug() << rc << "backup" << pagecount << "remain" << remaining;
           }
 
-          if ((rc == SQLITE_OK) || (rc == SQLITE_BUSY) || (rc == SQLITE_LOCKED))
-            sqlite3_sleep(100);
+          if (!save) {
+            if (pagecount > 0)
+              mainApp->setProgressSplashScreen(DB_LOAD_PROGRESS * qint64(pagecount - remaining) / pagecount);
+          } else if ((rc == SQLITE_OK) || (rc == SQLITE_BUSY) || (rc == SQLITE_LOCKED)) {
+            sqlite3_sleep(DB_BACKUP_SLEEP);
+          }
         } while ((rc == SQLITE_OK) || (rc == SQLITE_BUSY) || (rc == SQLITE_LOCKED));
 
         /* Release resources allocated by backup_init(). */
@@ -527,6 +1483,17 @@ void Database::sqliteDBMemFile(QSqlDatabase &db, bool save)
       /* Close the database connection opened on database file zFilename
       ** and return the result of this function. */
       (void)sqlite3_close(pFile);
+
+      if (rc == SQLITE_DONE) {
+        if (save && !Common::replaceFile(fileName, mainApp->dbFileName())) {
+          qCritical() << "sqliteDBMemFile(): failed to replace base file";
+          QFile::remove(fileName);
+        } else {
+          savedChanges_ = totalChanges;
+        }
+      } else if (save) {
+        QFile::remove(fileName);
+      }
     }
   }
   qWarning() << "sqliteDBMemFile(): finished!";
@@ -539,8 +1506,311 @@ void Database::setVacuum()
     dbFile.setDatabaseName(mainApp->dbFileName());
     dbFile.open();
     setPragma(dbFile);
-    dbFile.exec("VACUUM");
+    if (vacuumNeeded(dbFile))
+      dbFile.exec("VACUUM");
     dbFile.close();
   }
   QSqlDatabase::removeDatabase("vacuum");
 }
+
+/** @brief Return part of free pages in database file
+ *----------------------------------------------------------------------------*/
+double Database::freePagesRatio(QSqlDatabase &db)
+{
+  QSqlQuery q(db);
+  q.setForwardOnly(true);
+  int pageCount = 0;
+  int freeCount = 0;
+  if (q.exec("PRAGMA page_count") && q.next())
+    pageCount = q.value(0).toInt();
+  if (q.exec("PRAGMA freelist_count") && q.next())
+    freeCount = q.value(0).toInt();
+  if (pageCount <= 0)
+    return 0;
+  return (double)freeCount / pageCount;
+}
+
+/** @brief Check whether full vacuum is worth it
+ *
+ * Full vacuum is needed to switch auto_vacuum mode of existing base
+ * or if many pages of file are free.
+ *----------------------------------------------------------------------------*/
+bool Database::vacuumNeeded(QSqlDatabase &db)
+{
+  int autoVacuum = Settings::snapshot()->incrementalVacuum ? 2 : 0;
+
+  QSqlQuery q(db);
+  q.setForwardOnly(true);
+  if (q.exec("PRAGMA auto_vacuum") && q.next() && (q.value(0).toInt() != autoVacuum))
+    return true;
+  q.finish();
+
+  return freePagesRatio(db) >= DB_VACUUM_FREE_RATIO;
+}
+
+/** @brief Return up to pages free pages of file to file system
+ *
+ * Works for base with auto_vacuum = INCREMENTAL only.
+ * @return true if free pages remain
+ *----------------------------------------------------------------------------*/
+bool Database::incrementalVacuum(QSqlDatabase &db, int pages)
+{
+  QSqlQuery q(db);
+  q.setForwardOnly(true);
+  if (!q.exec("PRAGMA auto_vacuum") || !q.next() || (q.value(0).toInt() != 2))
+    return false;
+
+  int freeCount = 0;
+  if (q.exec("PRAGMA freelist_count") && q.next())
+    freeCount = q.value(0).toInt();
+  if (freeCount <= 0)
+    return false;
+
+  q.exec(QString("PRAGMA incremental_vacuum(%1)").arg(pages));
+  q.finish();
+  return freeCount > pages;
+}
+
+/** @brief Value of \a name from table info, empty if it is not set
+ *----------------------------------------------------------------------------*/
+QString Database::infoValue(QSqlDatabase &db, const QString &name)
+{
+  QSqlQuery q(db);
+  q.setForwardOnly(true);
+  q.prepare("SELECT value FROM info WHERE name=?");
+  q.addBindValue(name);
+  if (q.exec() && q.next())
+    return q.value(0).toString();
+  return QString();
+}
+
+// ----------------------------------------------------------------------------
+void Database::setInfoValue(QSqlDatabase &db, const QString &name, const QString &value)
+{
+  QSqlQuery q(db);
+  q.prepare("UPDATE info SET value=? WHERE name=?");
+  q.addBindValue(value);
+  q.addBindValue(name);
+  if (q.exec() && (q.numRowsAffected() > 0))
+    return;
+  q.prepare("INSERT INTO info(name, value) VALUES (?, ?)");
+  q.addBindValue(name);
+  q.addBindValue(value);
+  q.exec();
+}
+
+/** @brief Update statistics of query planner
+ *
+ * Base without statistics is analyzed once with limited number of rows
+ * per index, then PRAGMA optimize analyzes only tables which statistics
+ * became out of date. Result is kept in table info for storageInfo().
+ * @return time of optimization (ms)
+ *----------------------------------------------------------------------------*/
+qint64 Database::optimizePlanner(QSqlDatabase &db)
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  QSqlQuery q(db);
+  q.setForwardOnly(true);
+  q.exec("PRAGMA analysis_limit=" + QString::number(DB_ANALYSIS_LIMIT));
+  q.exec("SELECT name FROM sqlite_master WHERE type='table' AND name='sqlite_stat1'");
+  bool analyzed = q.next();
+  bool ok = q.exec(analyzed ? "PRAGMA optimize" : "ANALYZE");
+  if (!ok) {
+    qWarning() << __PRETTY_FUNCTION__ << __LINE__
+               << "q.lastError(): " << q.lastError().text();
+  }
+  q.finish();
+
+  qint64 elapsed = timer.elapsed();
+  setInfoValue(db, "plannerOptimized",
+               QString("%1, %2 ms%3").arg(QDateTime::currentDateTime().toString(Qt::ISODate)).
+               arg(elapsed).arg(ok ? "" : ", failed"));
+  LOG_DEBUG(LogFile::Sql) << "planner optimized:" << elapsed << "ms";
+  return elapsed;
+}
+
+/** @brief Tables checked one by one by quickCheck()
+ *
+ * SQLite before 3.33 checks whole base only, then one empty name is
+ * returned.
+ *----------------------------------------------------------------------------*/
+QStringList Database::quickCheckTables(QSqlDatabase &db)
+{
+  QStringList tables;
+  if (sqlite3_libversion_number() < 3033000) {
+    tables.append(QString());
+    return tables;
+  }
+
+  QSqlQuery q(db);
+  q.setForwardOnly(true);
+  q.exec("SELECT name FROM sqlite_master WHERE type='table' AND name NOT LIKE 'sqlite_%'");
+  while (q.next()) {
+    tables.append(q.value(0).toString());
+  }
+  return tables;
+}
+
+/** @brief Quick check of one \a table and its indexes, whole base if it is empty
+ * @return errors found, empty if table is ok
+ *----------------------------------------------------------------------------*/
+QStringList Database::quickCheck(QSqlDatabase &db, const QString &table)
+{
+  QStringList errors;
+  QSqlQuery q(db);
+  q.setForwardOnly(true);
+  QString qStr = "PRAGMA quick_check";
+  if (!table.isEmpty())
+    qStr.append(QString("(\"%1\")").arg(table));
+  if (!q.exec(qStr)) {
+    errors.append(q.lastError().text());
+    return errors;
+  }
+  while (q.next()) {
+    QString result = q.value(0).toString();
+    if (result != "ok")
+      errors.append(result);
+  }
+  return errors;
+}
+
+static bool traceMoreThan(const SQLiteStatementTrace &t1, const SQLiteStatementTrace &t2)
+{
+  return (t1.prepareTime + t1.stepTime) > (t2.prepareTime + t2.stepTime);
+}
+
+/** @brief Write statistics of traced statements to log
+ *
+ * Statements are listed from the longest total time.
+ *----------------------------------------------------------------------------*/
+void Database::dumpStatementTrace()
+{
+  if (!SQLiteDriver::isTraceEnabled())
+    return;
+
+  QList<SQLiteStatementTrace> statements = SQLiteDriver::traceStatements();
+  std::sort(statements.begin(), statements.end(), traceMoreThan);
+
+  qWarning() << "SQL trace: prepares, prepare us, executions, step us, rows, full scans, full scan steps";
+  foreach (const SQLiteStatementTrace &trace, statements) {
+    qWarning() << trace.prepareCount << trace.prepareTime << trace.execCount
+               << trace.stepTime << trace.rows << trace.fullScanCount
+               << trace.fullScanSteps << trace.sql;
+  }
+}
+
+static void profileStatement(void *, const char *sql, sqlite3_uint64 time)
+{
+  if (time >= DB_SLOW_STATEMENT_TIME)
+    PipelineMetrics::recordStatement(sql, qint64(time / 1000000));
+}
+
+/** @brief Collect slow statements of connection for performance report
+ *
+ * Only connections of SQLiteDriver are profiled: QSQLITE plugin can be
+ * linked with other SQLite library.
+ *----------------------------------------------------------------------------*/
+void Database::setProfiler(QSqlDatabase &db)
+{
+  if (!qobject_cast<SQLiteDriver *>(db.driver()))
+    return;
+
+  sqlite3 *handle = sqliteHandle(db);
+  if (handle)
+    sqlite3_profile(handle, profileStatement, 0);
+}
+
+sqlite3 *Database::sqliteHandle(const QSqlDatabase &db)
+{
+  QVariant v = db.driver()->handle();
+  if (v.isValid() && qstrcmp(v.typeName(),"sqlite3*") == 0)
+    return *static_cast<sqlite3 **>(v.data());
+  return 0;
+}
+
+/** @brief Free page cache of all connections not used by transactions
+ *----------------------------------------------------------------------------*/
+void Database::releaseMemory()
+{
+#if SQLITE_VERSION_NUMBER >= 3007010
+  QMutexLocker locker(&connectionsMutex_);
+  foreach (const QSqlDatabase &db, connections_) {
+    sqlite3 *handle = sqliteHandle(db);
+    if (handle)
+      sqlite3_db_release_memory(handle);
+  }
+#endif
+}
+
+/** @brief Copy database to fileName
+ *
+ * Can be called from any thread. Base file is copied by own connection
+ * with VACUUM INTO in one read transaction, so in WAL mode feeds are
+ * updated meanwhile. Memory base is copied from memoryHandle by steps of
+ * backup API, modifications made by that connection go to copy as well.
+ * @return true if copy is complete
+ *----------------------------------------------------------------------------*/
+bool Database::backupDatabase(const QString &fileName, sqlite3 *memoryHandle)
+{
+  QFile::remove(fileName);
+
+  int rc;
+#if SQLITE_VERSION_NUMBER >= 3027000
+  if (!memoryHandle) {
+    sqlite3 *pFile;
+    rc = sqlite3_open_v2(mainApp->dbFileName().toUtf8().data(), &pFile,
+                         SQLITE_OPEN_READONLY, 0);
+    if (rc == SQLITE_OK) {
+      sqlite3_busy_timeout(pFile, DB_BACKUP_TIMEOUT);
+      char *sql = sqlite3_mprintf("VACUUM INTO %Q", fileName.toUtf8().data());
+      rc = sqlite3_exec(pFile, sql, 0, 0, 0);
+      sqlite3_free(sql);
+    }
+    (void)sqlite3_close(pFile);
+    if (rc != SQLITE_OK) {
+      qCritical() << "backupDatabase(): return code =" << rc;
+      QFile::remove(fileName);
+    }
+    return rc == SQLITE_OK;
+  }
+#endif
+
+  sqlite3 *pFrom = memoryHandle;
+  sqlite3 *pSource = 0;
+  if (!pFrom) {
+    rc = sqlite3_open_v2(mainApp->dbFileName().toUtf8().data(), &pSource,
+                         SQLITE_OPEN_READONLY, 0);
+    if (rc != SQLITE_OK) {
+      (void)sqlite3_close(pSource);
+      return false;
+    }
+    pFrom = pSource;
+  }
+
+  sqlite3 *pTo;
+  rc = sqlite3_open(fileName.toUtf8().data(), &pTo);
+  if (rc == SQLITE_OK) {
+    sqlite3_backup *pBackup = sqlite3_backup_init(pTo, "main", pFrom, "main");
+    if (pBackup) {
+      do {
+        rc = sqlite3_backup_step(pBackup, DB_BACKUP_PAGES);
+        if ((rc == SQLITE_OK) || (rc == SQLITE_BUSY) || (rc == SQLITE_LOCKED))
+          sqlite3_sleep(DB_BACKUP_SLEEP);
+      } while ((rc == SQLITE_OK) || (rc == SQLITE_BUSY) || (rc == SQLITE_LOCKED));
+      (void)sqlite3_backup_finish(pBackup);
+    } else {
+      rc = sqlite3_errcode(pTo);
+    }
+  }
+  (void)sqlite3_close(pTo);
+  if (pSource)
+    (void)sqlite3_close(pSource);
+
+  if (rc != SQLITE_DONE) {
+    qCritical() << "backupDatabase(): return code =" << rc;
+    QFile::remove(fileName);
+  }
+  return rc == SQLITE_DONE;
+}
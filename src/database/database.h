@@ -21,26 +21,84 @@
 #include <QtCore>
 #include <QtSql>
 
+struct sqlite3;
+
 class Database : public QObject
 {
   Q_OBJECT
 public:
+  // Readers of GUI thread which get own read-only connection
+  enum ReadPurpose {
+    ReadNewsContent,  // news bodies for browser and newspaper
+    ReadCounters,     // unread counters of feeds for local API
+    ReadNewsList,     // news lists for local API
+    ReadPurposeCount
+  };
+
   static int version();
   static void initialization();
   static QSqlDatabase connection(const QString &connectionName = QString());
+  static QSqlDatabase threadConnection();
+  static void setConnectionThread(const QString &connectionName, QThread *thread);
+  static bool isConnectionThread(const QSqlDatabase &db);
+  static QSqlDatabase readConnection(ReadPurpose purpose);
+  static QStringList readPoolInfo();
   static void sqliteDBMemFile(QSqlDatabase &db, bool save = true);
   static void setVacuum();
+  static QStringList storageInfo(const QString &connectionName = QString());
+  static double freePagesRatio(QSqlDatabase &db);
+  static bool vacuumNeeded(QSqlDatabase &db);
+  static bool incrementalVacuum(QSqlDatabase &db, int pages);
+  static QString infoValue(QSqlDatabase &db, const QString &name);
+  static void setInfoValue(QSqlDatabase &db, const QString &name, const QString &value);
+  static qint64 optimizePlanner(QSqlDatabase &db);
+  static QStringList quickCheckTables(QSqlDatabase &db);
+  static QStringList quickCheck(QSqlDatabase &db, const QString &table);
+  static sqlite3 *sqliteHandle(const QSqlDatabase &db);
+  static void releaseMemory();
+  static bool backupDatabase(const QString &fileName, sqlite3 *memoryHandle = 0);
+  static QString findNewsFilter(const QString &findMode, const QString &text,
+                                bool archive = false);
+  static bool archiveAttached() { return archiveAttached_; }
+  static bool archiveNews(QSqlDatabase &db, int count, QSet<int> *feedIds);
+  static void dumpStatementTrace();
+  static void recountCategoryCounts(QSqlDatabase &db);
 
 private:
   static void setPragma(QSqlDatabase &db);
+  static void setProfiler(QSqlDatabase &db);
   static void createTables(QSqlDatabase &db);
+  static void createIndexes(QSqlDatabase &db);
+  static void createNewsContent(QSqlDatabase &db);
+  static void createNewsLabels(QSqlDatabase &db);
+  static void createNewsFingerprints(QSqlDatabase &db);
+  static void createNewsKeys(QSqlDatabase &db);
+  static void createFeedsState(QSqlDatabase &db);
+  static void createSyncItems(QSqlDatabase &db);
+  static void createNewsTombstones(QSqlDatabase &db);
+  static void createCategoryCounts(QSqlDatabase &db);
+  static QString archiveFileName();
+  static void prepareArchive(QSqlDatabase &db);
+  static void attachArchive(QSqlDatabase &db, bool writable);
+  static void createNewsFts(QSqlDatabase &db);
+  static void checkQueryPlans(QSqlDatabase &db);
   static void prepareDatabase();
   static void createLabels(QSqlDatabase &db);
   static void addColumnsToFeedsTables(QSqlDatabase &db);
 
+  static int savedChanges_;
+  static bool ftsEnabled_;
+  static bool archiveAttached_;
+  static QStringList archiveColumns_;
+  static QMutex connectionsMutex_;
+  static QHash<QString, QSqlDatabase> connections_;
+  static QHash<QString, QThread *> connectionThreads_;
+  static int readCheckouts_[ReadPurposeCount];
+  static int readFallbacks_;
+
   static QStringList tablesList() {
     QStringList tables;
-    tables << "feeds" << "news" << "feeds_ex"
+    tables << "feeds" << "news" << "newsContent" << "feeds_ex"
            << "news_ex" << "filters" << "filterConditions"
            << "filterActions" << "filters_ex" << "labels"
            << "passwords" << "info";
@@ -0,0 +1,50 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef DATABASEBACKUP_H
+#define DATABASEBACKUP_H
+
+#include <QObject>
+#include <QString>
+
+struct sqlite3;
+
+/** @brief Copy of database made in own thread
+ *
+ * Object is moved to backup thread, run() is called on thread start.
+ * Base file is copied by its own connection, memory base by its handle
+ * in small steps, so application keeps working with base meanwhile.
+ *----------------------------------------------------------------------------*/
+class DatabaseBackup : public QObject
+{
+  Q_OBJECT
+public:
+  DatabaseBackup(const QString &fileName, sqlite3 *memoryHandle = 0);
+
+public slots:
+  void run();
+
+signals:
+  void finished(bool ok, const QString &fileName);
+
+private:
+  QString fileName_;
+  sqlite3 *memoryHandle_;
+
+};
+
+#endif // DATABASEBACKUP_H
@@ -0,0 +1,297 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "databasegenerator.h"
+
+#include <stdio.h>
+
+// Sizes used when they are not given on command line
+#define GENERATOR_FEEDS_DEFAULT 10000
+#define GENERATOR_NEWS_DEFAULT  1000000
+// One folder per this number of feeds, every folder has up to
+// GENERATOR_FOLDER_CHILDREN subfolders, so tree gets deeper with size
+#define GENERATOR_FEEDS_PER_FOLDER 50
+#define GENERATOR_FOLDER_CHILDREN  4
+#define GENERATOR_FILTERS 50
+// News are committed in batches to keep journal small
+#define GENERATOR_BATCH 10000
+// Dates of news are spread over this number of days back
+#define GENERATOR_DAYS 730
+// Seed of random numbers, bases of equal size are equal
+#define GENERATOR_SEED 2011
+
+static const char *kWords[] = {
+  "linux", "release", "update", "security", "kernel", "browser", "review",
+  "market", "energy", "space", "mission", "science", "study", "climate",
+  "election", "policy", "city", "music", "festival", "film", "game",
+  "player", "season", "team", "report", "data", "network", "cloud",
+  "phone", "camera", "battery", "design", "open", "source", "project",
+  "community", "developer", "library", "version", "bug", "fix", "feature",
+  "interview", "history", "travel", "food", "health", "research", "world",
+  "local", "weather", "storm", "river", "mountain", "garden", "school",
+  "book", "author", "art", "museum", "bank", "price", "company", "startup"
+};
+
+DatabaseGenerator::DatabaseGenerator(int feedsCount, int newsCount)
+  : db_(QSqlDatabase::database())
+  , feedsCount_(feedsCount > 0 ? feedsCount : GENERATOR_FEEDS_DEFAULT)
+  , newsCount_(newsCount > 0 ? newsCount : GENERATOR_NEWS_DEFAULT)
+{
+  qsrand(GENERATOR_SEED);
+}
+
+/** @brief Generate whole base
+ * @return exit code of application
+ *----------------------------------------------------------------------------*/
+int DatabaseGenerator::run()
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  // Base is useless until it is generated completely
+  db_.exec("PRAGMA synchronous = OFF");
+
+  QSqlQuery q(db_);
+  q.exec("SELECT id FROM labels ORDER BY num");
+  while (q.next())
+    labelIds_.append(q.value(0).toInt());
+  q.exec("SELECT count(id) FROM feeds");
+  if (q.first() && q.value(0).toInt()) {
+    fprintf(stderr, "Base %s is not empty\n", qPrintable(db_.databaseName()));
+    return 1;
+  }
+
+  printf("Generating %d feeds, %d news into %s\n", feedsCount_, newsCount_,
+         qPrintable(db_.databaseName()));
+  fflush(stdout);
+
+  createFolders();
+  createFeeds();
+  createNews();
+  createFilters();
+  updateCounts();
+
+  printf("Generated in %.1f s\n", timer.elapsed() / 1000.0);
+  fflush(stdout);
+  return 0;
+}
+
+/** @brief Create tree of folders
+ *
+ * Folder i is child of folder (i-1)/GENERATOR_FOLDER_CHILDREN, parents are
+ * always created before their children.
+ *----------------------------------------------------------------------------*/
+void DatabaseGenerator::createFolders()
+{
+  int foldersCount = qMax(1, feedsCount_ / GENERATOR_FEEDS_PER_FOLDER);
+  QString created = QLocale::c().toString(QDateTime::currentDateTimeUtc(), "yyyy-MM-ddTHH:mm:ss");
+  QHash<int, int> childrenCount;
+
+  db_.transaction();
+  QSqlQuery q(db_);
+  q.prepare("INSERT INTO feeds(text, created, parentId, rowToParent) "
+            "VALUES (?, ?, ?, ?)");
+  for (int i = 0; i < foldersCount; ++i) {
+    int parentId = i ? folderIds_.at((i - 1) / GENERATOR_FOLDER_CHILDREN) : 0;
+    q.addBindValue(QString("Folder %1 %2").arg(i + 1).arg(randomWords(1)));
+    q.addBindValue(created);
+    q.addBindValue(parentId);
+    q.addBindValue(childrenCount[parentId]++);
+    q.exec();
+    folderIds_.append(q.lastInsertId().toInt());
+  }
+  db_.commit();
+}
+
+void DatabaseGenerator::createFeeds()
+{
+  QString created = QLocale::c().toString(QDateTime::currentDateTimeUtc(), "yyyy-MM-ddTHH:mm:ss");
+  QHash<int, int> childrenCount;
+
+  db_.transaction();
+  QSqlQuery q(db_);
+  q.prepare("INSERT INTO feeds(text, title, xmlUrl, htmlUrl, created, updated, "
+            "parentId, rowToParent) VALUES (?, ?, ?, ?, ?, ?, ?, ?)");
+  for (int i = 0; i < feedsCount_; ++i) {
+    int parentId = folderIds_.at(random(folderIds_.count()));
+    QString title = QString("%1 %2").arg(randomWords(2)).arg(i + 1);
+    q.addBindValue(title);
+    q.addBindValue(title);
+    q.addBindValue(QString("http://feed%1.example.com/rss.xml").arg(i + 1));
+    q.addBindValue(QString("http://feed%1.example.com/").arg(i + 1));
+    q.addBindValue(created);
+    q.addBindValue(created);
+    q.addBindValue(parentId);
+    q.addBindValue(childrenCount[parentId]++);
+    q.exec();
+    feedIds_.append(q.lastInsertId().toInt());
+    feedParentIds_.append(parentId);
+  }
+  db_.commit();
+}
+
+/** @brief Create news with few large and many small feeds
+ *
+ * Feed index is feedsCount*r^3 for uniform r, so first feed gets about 5%
+ * of news for 10000 feeds. Flags are set in proportions of typical base:
+ * most news are read, some deleted, few starred or labeled.
+ *----------------------------------------------------------------------------*/
+void DatabaseGenerator::createNews()
+{
+  QDateTime now = QDateTime::currentDateTimeUtc();
+  QSqlQuery q(db_);
+  QSqlQuery qContent(db_);
+
+  db_.transaction();
+  q.prepare("INSERT INTO news(feedId, feedParentId, guid, title, author_name, "
+            "published, received, link_href, category, new, read, starred, "
+            "deleted, deleteDate, label) "
+            "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, 0, ?, ?, ?, ?, ?)");
+  qContent.prepare("INSERT INTO newsContent(newsId, description, content) "
+                   "VALUES (?, ?, '')");
+  for (int i = 0; i < newsCount_; ++i) {
+    double r = random(1000000) / 1000000.0;
+    int index = qMin(feedsCount_ - 1, int(feedsCount_ * r * r * r));
+    QDateTime published = now.addSecs(-int(random(GENERATOR_DAYS * 24 * 3600)));
+    QString publishedStr = QLocale::c().toString(published, "yyyy-MM-ddTHH:mm:ss");
+    bool deleted = random(100) < 5;
+    QString label;
+    if (!labelIds_.isEmpty() && (random(100) < 2))
+      label = QString(",%1,").arg(labelIds_.at(random(labelIds_.count())));
+
+    q.addBindValue(feedIds_.at(index));
+    q.addBindValue(feedParentIds_.at(index));
+    q.addBindValue(QString("news-%1").arg(i + 1));
+    q.addBindValue(randomWords(4 + random(6)));
+    q.addBindValue(randomWords(2));
+    q.addBindValue(publishedStr);
+    q.addBindValue(QLocale::c().toString(published.addSecs(int(random(3600))), "yyyy-MM-ddTHH:mm:ss"));
+    q.addBindValue(QString("http://feed%1.example.com/news/%2.html").arg(index + 1).arg(i + 1));
+    q.addBindValue(randomWords(1));
+    q.addBindValue(random(100) < 70 ? 2 : 0);
+    q.addBindValue(random(100) < 1 ? 1 : 0);
+    q.addBindValue(deleted ? 1 : 0);
+    q.addBindValue(deleted ? publishedStr : QString(""));
+    q.addBindValue(label);
+    q.exec();
+
+    qContent.addBindValue(q.lastInsertId());
+    qContent.addBindValue(QString("<p>%1.</p><p>%2.</p>").
+                          arg(randomWords(20 + random(80))).arg(randomWords(10 + random(40))));
+    qContent.exec();
+
+    if (((i + 1) % GENERATOR_BATCH == 0) || (i + 1 == newsCount_)) {
+      db_.commit();
+      db_.transaction();
+      printf("\rNews: %d/%d", i + 1, newsCount_);
+      fflush(stdout);
+    }
+  }
+  db_.commit();
+  printf("\n");
+}
+
+void DatabaseGenerator::createFilters()
+{
+  db_.transaction();
+  QSqlQuery q(db_);
+  for (int i = 0; i < GENERATOR_FILTERS; ++i) {
+    // Every filter is applied to about 1% of feeds
+    QString feeds(",");
+    for (int j = 0; j < qMax(1, feedsCount_ / 100); ++j)
+      feeds.append(QString("%1,").arg(feedIds_.at(random(feedIds_.count()))));
+
+    q.prepare("INSERT INTO filters(name, type, feeds, enable) VALUES (?, ?, ?, 1)");
+    q.addBindValue(QString("Filter %1").arg(i + 1));
+    q.addBindValue(1 + random(2));  // match all or any condition
+    q.addBindValue(feeds);
+    q.exec();
+    int filterId = q.lastInsertId().toInt();
+    q.exec(QString("UPDATE filters SET num='%1' WHERE id=='%1'").arg(filterId));
+
+    int conditionsCount = 1 + random(3);
+    for (int j = 0; j < conditionsCount; ++j) {
+      q.prepare("INSERT INTO filterConditions(idFilter, field, condition, content) "
+                "VALUES (?, 0, 0, ?)");  // title contains
+      q.addBindValue(filterId);
+      q.addBindValue(randomWords(1));
+      q.exec();
+    }
+
+    int action = random(3);
+    q.prepare("INSERT INTO filterActions(idFilter, action, params) VALUES (?, ?, ?)");
+    q.addBindValue(filterId);
+    if ((action == 2) && !labelIds_.isEmpty()) {
+      q.addBindValue(3);  // add label
+      q.addBindValue(labelIds_.at(random(labelIds_.count())));
+    } else {
+      q.addBindValue(action ? 1 : 0);  // add star or mark read
+      q.addBindValue(0);
+    }
+    q.exec();
+  }
+  db_.commit();
+}
+
+/** @brief Set counters of feeds and folders as recount would do
+ *----------------------------------------------------------------------------*/
+void DatabaseGenerator::updateCounts()
+{
+  db_.transaction();
+  QSqlQuery q(db_);
+  q.exec("UPDATE feedsState SET "
+         "undeleteCount=(SELECT count(id) FROM news WHERE news.feedId=feedsState.feedId AND deleted==0), "
+         "unread=(SELECT count(id) FROM news WHERE news.feedId=feedsState.feedId AND deleted==0 AND read==0), "
+         "newCount=0 WHERE feedId IN (SELECT id FROM feeds WHERE xmlUrl!='')");
+
+  // Children folders have bigger index, so they are counted first
+  q.prepare("UPDATE feedsState SET "
+            "undeleteCount=(SELECT ifnull(sum(s.undeleteCount), 0) FROM feedsState AS s "
+            "WHERE s.feedId IN (SELECT id FROM feeds WHERE parentId=?)), "
+            "unread=(SELECT ifnull(sum(s.unread), 0) FROM feedsState AS s "
+            "WHERE s.feedId IN (SELECT id FROM feeds WHERE parentId=?)), "
+            "newCount=0 WHERE feedId=?");
+  for (int i = folderIds_.count() - 1; i >= 0; --i) {
+    q.addBindValue(folderIds_.at(i));
+    q.addBindValue(folderIds_.at(i));
+    q.addBindValue(folderIds_.at(i));
+    q.exec();
+  }
+  db_.commit();
+}
+
+QString DatabaseGenerator::randomWords(int count)
+{
+  const int wordsCount = sizeof(kWords) / sizeof(kWords[0]);
+  QString text;
+  for (int i = 0; i < count; ++i) {
+    if (i)
+      text.append(' ');
+    text.append(QLatin1String(kWords[random(wordsCount)]));
+  }
+  return text;
+}
+
+/** @brief Random number in range [0, max)
+ *
+ * RAND_MAX may be 32767, so two numbers are combined for big ranges.
+ *----------------------------------------------------------------------------*/
+quint32 DatabaseGenerator::random(quint32 max)
+{
+  quint32 value = (quint32(qrand() & 0x7fff) << 15) | quint32(qrand() & 0x7fff);
+  return max ? value % max : 0;
+}
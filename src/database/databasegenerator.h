@@ -0,0 +1,57 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef DATABASEGENERATOR_H
+#define DATABASEGENERATOR_H
+
+#include <QtSql>
+#include <QList>
+#include <QString>
+
+/** @brief Fill empty base with synthetic feeds, news, labels and filters
+ *
+ * Numbers are random with fixed seed, so bases made with the same sizes
+ * are equal and timings measured on them can be compared.
+ *----------------------------------------------------------------------------*/
+class DatabaseGenerator
+{
+public:
+  DatabaseGenerator(int feedsCount, int newsCount);
+
+  int run();
+
+private:
+  void createFolders();
+  void createFeeds();
+  void createNews();
+  void createFilters();
+  void updateCounts();
+
+  static QString randomWords(int count);
+  static quint32 random(quint32 max);
+
+  QSqlDatabase db_;
+  int feedsCount_;
+  int newsCount_;
+  QList<int> folderIds_;
+  QList<int> feedIds_;
+  QList<int> feedParentIds_;
+  QList<int> labelIds_;
+
+};
+
+#endif // DATABASEGENERATOR_H
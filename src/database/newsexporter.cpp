@@ -0,0 +1,259 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "newsexporter.h"
+
+#include "common.h"
+
+#include <QTextStream>
+#include <QXmlStreamWriter>
+#if QT_VERSION < 0x050000
+#include <QTextDocument>
+#endif
+
+// Columns of news read by export query
+enum NewsColumn {
+  ColumnId,
+  ColumnGuid,
+  ColumnTitle,
+  ColumnPublished,
+  ColumnLink,
+  ColumnAuthor,
+  ColumnCategory,
+  ColumnStarred,
+  ColumnRead,
+  ColumnDescription,
+  ColumnContent,
+  ColumnFeedTitle
+};
+
+NewsExporter::NewsExporter(const QSqlDatabase &db)
+  : db_(db)
+  , count_(0)
+{
+}
+
+/** @brief Write feeds tree as OPML document
+ *----------------------------------------------------------------------------*/
+bool NewsExporter::exportFeeds(QIODevice *device)
+{
+  count_ = 0;
+  QXmlStreamWriter xml(device);
+  xml.setAutoFormatting(true);
+  xml.writeStartDocument();
+  xml.writeStartElement("opml");
+  xml.writeAttribute("version", "2.0");
+  xml.writeStartElement("head");
+  xml.writeTextElement("title", "QuiteRSS");
+  xml.writeTextElement("dateModified", QDateTime::currentDateTime().toString());
+  xml.writeEndElement(); // </head>
+
+  xml.writeStartElement("body");
+  writeFolder(xml, 0);
+  xml.writeEndElement(); // </body>
+
+  xml.writeEndElement(); // </opml>
+  xml.writeEndDocument();
+  return !xml.hasError();
+}
+
+/** @brief Write children of folder in order of feeds tree
+ *
+ * Only one query per level of tree is open.
+ *----------------------------------------------------------------------------*/
+void NewsExporter::writeFolder(QXmlStreamWriter &xml, int parentId)
+{
+  QSqlQuery q(db_);
+  q.setForwardOnly(true);
+  q.prepare("SELECT id, text, xmlUrl, htmlUrl FROM feeds WHERE parentId=? ORDER BY rowToParent");
+  q.addBindValue(parentId);
+  q.exec();
+  while (q.next()) {
+    if (q.value(2).toString().isEmpty()) {
+      xml.writeStartElement("outline");  // Folder starts
+      xml.writeAttribute("text", q.value(1).toString());
+      writeFolder(xml, q.value(0).toInt());
+      xml.writeEndElement();  // "outline" - folder finishes
+    } else {
+      xml.writeEmptyElement("outline");
+      xml.writeAttribute("text",    q.value(1).toString());
+      xml.writeAttribute("type",    "rss");
+      xml.writeAttribute("htmlUrl", q.value(3).toString());
+      xml.writeAttribute("xmlUrl",  q.value(2).toString());
+      count_++;
+    }
+  }
+}
+
+/** @brief Write news which pass filter of news list
+ * @param filter Condition on columns of news table
+ *----------------------------------------------------------------------------*/
+bool NewsExporter::exportNews(QIODevice *device, Format format, const QString &filter)
+{
+  count_ = 0;
+  QSqlQuery q(db_);
+  q.setForwardOnly(true);
+  QString qStr = QString("SELECT id, guid, title, published, link_href, author_name, category, "
+                         "starred, read, "
+                         "(SELECT uncompress(description) FROM newsContent WHERE newsId=news.id), "
+                         "(SELECT uncompress(content) FROM newsContent WHERE newsId=news.id), "
+                         "(SELECT text FROM feeds WHERE feeds.id=news.feedId) "
+                         "FROM news WHERE %1 ORDER BY published").
+      arg(filter.isEmpty() ? QString("deleted=0") : filter);
+  if (!q.exec(qStr)) {
+    qWarning() << "Export of news:" << q.lastError().text();
+    return false;
+  }
+
+  QTextStream stream(device);
+  stream.setCodec("UTF-8");
+
+  if (format == FormatJson) {
+    stream << "{\n\"version\": \"https://jsonfeed.org/version/1.1\",\n"
+           << "\"title\": \"QuiteRSS\",\n\"items\": [\n";
+  } else if (format == FormatHtml) {
+    stream << "<!DOCTYPE html>\n<html><head><meta charset=\"utf-8\"/>"
+           << "<title>QuiteRSS</title></head><body>\n";
+  }
+
+  while (q.next()) {
+    switch (format) {
+    case FormatJson:
+      if (count_)
+        stream << ",\n";
+      writeJsonNews(stream, q);
+      break;
+    case FormatMbox:
+      writeMboxNews(stream, q);
+      break;
+    case FormatHtml:
+      writeHtmlNews(stream, q);
+      break;
+    }
+    count_++;
+  }
+
+  if (format == FormatJson)
+    stream << "\n]\n}\n";
+  else if (format == FormatHtml)
+    stream << "</body></html>\n";
+
+  stream.flush();
+  return stream.status() == QTextStream::Ok;
+}
+
+void NewsExporter::writeJsonNews(QTextStream &stream, const QSqlQuery &q)
+{
+  QString content = q.value(ColumnContent).toString();
+  if (content.isEmpty())
+    content = q.value(ColumnDescription).toString();
+  QString published = q.value(ColumnPublished).toString();
+  if (!published.isEmpty() && !published.endsWith('Z'))
+    published.append('Z');
+
+  stream << "{\"id\": " << Common::jsonString(q.value(ColumnGuid).toString().isEmpty() ?
+                                              q.value(ColumnId).toString() :
+                                              q.value(ColumnGuid).toString())
+         << ", \"url\": " << Common::jsonString(q.value(ColumnLink).toString())
+         << ", \"title\": " << Common::jsonString(q.value(ColumnTitle).toString());
+  if (!published.isEmpty())
+    stream << ", \"date_published\": " << Common::jsonString(published);
+  if (!q.value(ColumnAuthor).toString().isEmpty())
+    stream << ", \"authors\": [{\"name\": " << Common::jsonString(q.value(ColumnAuthor).toString()) << "}]";
+  if (!q.value(ColumnCategory).toString().isEmpty()) {
+    QStringList tags;
+    foreach (const QString &tag, q.value(ColumnCategory).toString().split(',', QString::SkipEmptyParts))
+      tags.append(Common::jsonString(tag.trimmed()));
+    stream << ", \"tags\": [" << tags.join(", ") << "]";
+  }
+  stream << ", \"content_html\": " << Common::jsonString(content)
+         << ", \"_quiterss\": {\"feed\": " << Common::jsonString(q.value(ColumnFeedTitle).toString())
+         << ", \"starred\": " << (q.value(ColumnStarred).toInt() ? "true" : "false")
+         << ", \"read\": " << (q.value(ColumnRead).toInt() ? "true" : "false")
+         << "}}";
+}
+
+/** @brief Write news as message of mboxrd file
+ *
+ * Lines of body starting with "From " are quoted by '>'.
+ *----------------------------------------------------------------------------*/
+void NewsExporter::writeMboxNews(QTextStream &stream, const QSqlQuery &q)
+{
+  QString content = q.value(ColumnContent).toString();
+  if (content.isEmpty())
+    content = q.value(ColumnDescription).toString();
+  content.replace("\r\n", "\n");
+  content.replace(QRegExp("(^|\n)(>*From )"), "\\1>\\2");
+
+  QDateTime published = QDateTime::fromString(q.value(ColumnPublished).toString(), Qt::ISODate);
+  published.setTimeSpec(Qt::UTC);
+  if (!published.isValid())
+    published = QDateTime::currentDateTimeUtc();
+  QLocale c = QLocale::c();
+
+  QString author = q.value(ColumnAuthor).toString().simplified();
+  if (author.isEmpty())
+    author = q.value(ColumnFeedTitle).toString().simplified();
+
+  stream << "From quiterss@localhost " << c.toString(published, "ddd MMM dd HH:mm:ss yyyy") << "\n"
+         << "From: " << mimeWord(author) << " <quiterss@localhost>\n"
+         << "Subject: " << mimeWord(q.value(ColumnTitle).toString().simplified()) << "\n"
+         << "Date: " << c.toString(published, "ddd, dd MMM yyyy HH:mm:ss") << " +0000\n"
+         << "Message-ID: <" << q.value(ColumnId).toString() << ".news@quiterss>\n"
+         << "X-Feed: " << mimeWord(q.value(ColumnFeedTitle).toString().simplified()) << "\n";
+  if (!q.value(ColumnLink).toString().isEmpty())
+    stream << "X-Link: " << q.value(ColumnLink).toString().simplified() << "\n";
+  stream << "MIME-Version: 1.0\n"
+         << "Content-Type: text/html; charset=UTF-8\n"
+         << "Content-Transfer-Encoding: 8bit\n\n"
+         << content << "\n\n";
+}
+
+void NewsExporter::writeHtmlNews(QTextStream &stream, const QSqlQuery &q)
+{
+  QString content = q.value(ColumnContent).toString();
+  if (content.isEmpty())
+    content = q.value(ColumnDescription).toString();
+
+  stream << "<article><h2><a href=\"" << htmlEscaped(q.value(ColumnLink).toString()) << "\">"
+         << htmlEscaped(q.value(ColumnTitle).toString()) << "</a></h2>\n<p><small>"
+         << htmlEscaped(q.value(ColumnFeedTitle).toString()) << " | "
+         << htmlEscaped(q.value(ColumnPublished).toString());
+  if (!q.value(ColumnAuthor).toString().isEmpty())
+    stream << " | " << htmlEscaped(q.value(ColumnAuthor).toString());
+  stream << "</small></p>\n<div>" << content << "</div></article>\n<hr/>\n";
+}
+
+QString NewsExporter::htmlEscaped(const QString &text)
+{
+#if QT_VERSION >= 0x050000
+  return text.toHtmlEscaped();
+#else
+  return Qt::escape(text);
+#endif
+}
+
+/** @brief Header text encoded by RFC 2047 if it is not ASCII
+ *----------------------------------------------------------------------------*/
+QString NewsExporter::mimeWord(const QString &text)
+{
+  for (int i = 0; i < text.size(); ++i) {
+    if (text.at(i).unicode() > 0x7e)
+      return "=?UTF-8?B?" + QString::fromLatin1(text.toUtf8().toBase64()) + "?=";
+  }
+  return text;
+}
@@ -0,0 +1,60 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef NEWSEXPORTER_H
+#define NEWSEXPORTER_H
+
+#include <QtSql>
+
+class QIODevice;
+class QTextStream;
+class QXmlStreamWriter;
+
+/** @brief Export of feeds and news straight from base
+ *
+ * Rows are read by forward-only query and written to device one by one,
+ * so memory does not grow with number of exported news.
+ *----------------------------------------------------------------------------*/
+class NewsExporter
+{
+public:
+  enum Format {
+    FormatJson,   // JSON Feed 1.1
+    FormatMbox,   // mboxrd, one message per news
+    FormatHtml
+  };
+
+  explicit NewsExporter(const QSqlDatabase &db);
+
+  bool exportFeeds(QIODevice *device);
+  bool exportNews(QIODevice *device, Format format, const QString &filter);
+  qint64 count() const { return count_; }
+
+private:
+  void writeFolder(QXmlStreamWriter &xml, int parentId);
+  void writeJsonNews(QTextStream &stream, const QSqlQuery &q);
+  void writeMboxNews(QTextStream &stream, const QSqlQuery &q);
+  void writeHtmlNews(QTextStream &stream, const QSqlQuery &q);
+  static QString htmlEscaped(const QString &text);
+  static QString mimeWord(const QString &text);
+
+  QSqlDatabase db_;
+  qint64 count_;
+
+};
+
+#endif // NEWSEXPORTER_H
@@ -0,0 +1,84 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "querycache.h"
+
+#include "database.h"
+
+#include <QDebug>
+
+QueryCache::QueryCache(const QSqlDatabase &db)
+  : db_(db)
+{
+}
+
+void QueryCache::setDatabase(const QSqlDatabase &db)
+{
+  clear();
+  db_ = db;
+}
+
+/** @brief Return prepared query for \a sql
+ *
+ * Returned query shares statement with cache, values are bound to it
+ * before each exec().
+ *----------------------------------------------------------------------------*/
+QSqlQuery QueryCache::query(const QString &sql)
+{
+  Q_ASSERT_X(Database::isConnectionThread(db_), "QueryCache::query",
+             "connection is used by thread not owning it");
+
+  QHash<QString, QSqlQuery>::iterator it = queries_.find(sql);
+  if (it != queries_.end()) {
+    it.value().finish();
+    return it.value();
+  }
+
+  QSqlQuery q(db_);
+  q.setForwardOnly(true);
+  if (!q.prepare(sql)) {
+    qWarning() << __PRETTY_FUNCTION__ << __LINE__
+               << "q.lastError(): " << q.lastError().text() << sql;
+    return q;
+  }
+  queries_.insert(sql, q);
+  return q;
+}
+
+/** @brief Return prepared statement for \a sql read by typed columns
+ *
+ * Statement is reset, so values are bound to it before each next().
+ *----------------------------------------------------------------------------*/
+SQLiteStatement *QueryCache::statement(const QString &sql)
+{
+  Q_ASSERT_X(Database::isConnectionThread(db_), "QueryCache::statement",
+             "connection is used by thread not owning it");
+
+  QSharedPointer<SQLiteStatement> &statement = statements_[sql];
+  if (statement)
+    statement->reset();
+  else
+    statement = QSharedPointer<SQLiteStatement>(
+          new SQLiteStatement(Database::sqliteHandle(db_), sql));
+  return statement.data();
+}
+
+void QueryCache::clear()
+{
+  queries_.clear();
+  statements_.clear();
+}
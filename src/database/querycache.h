@@ -0,0 +1,49 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef QUERYCACHE_H
+#define QUERYCACHE_H
+
+#include <QHash>
+#include <QSharedPointer>
+#include <QtSql>
+
+#include "sqlitestatement.h"
+
+/** @brief Cache of prepared queries for one database connection
+ *
+ * Query is prepared on first use and then only executed with new bound
+ * values, so SQLite does not parse and plan the statement again.
+ *----------------------------------------------------------------------------*/
+class QueryCache
+{
+public:
+  explicit QueryCache(const QSqlDatabase &db = QSqlDatabase());
+
+  void setDatabase(const QSqlDatabase &db);
+  QSqlQuery query(const QString &sql);
+  SQLiteStatement *statement(const QString &sql);
+  void clear();
+
+private:
+  QSqlDatabase db_;
+  QHash<QString, QSqlQuery> queries_;
+  QHash<QString, QSharedPointer<SQLiteStatement> > statements_;
+
+};
+
+#endif // QUERYCACHE_H
@@ -36,12 +36,29 @@
 
 #include "mainapplication.h"
 #include "networkmanager.h"
+#include "logfile.h"
 #include "webpage.h"
+#include "settings.h"
 
 #if defined(Q_OS_WIN)
 #include <qt_windows.h>
 #endif
 
+// Suffix of file keeping state of unfinished download
+#define DOWNLOAD_STATE_SUFFIX ".qrsdownload"
+// Files smaller than this are downloaded by one connection (bytes)
+#define DOWNLOAD_SEGMENT_MIN_SIZE (4*1024*1024)
+// Maximum number of connections of one download
+#define DOWNLOAD_SEGMENTS_MAX 8
+// Failed segment is requested again this number of times
+#define DOWNLOAD_SEGMENT_RETRIES 3
+// Bandwidth budget is given to download with this interval (ms)
+#define DOWNLOAD_THROTTLE_INTERVAL 100
+// Interval of updating text with size, speed and remaining time (ms)
+#define DOWNLOAD_INFO_INTERVAL 1000
+// Speed is counted from data received during this time (ms)
+#define DOWNLOAD_SPEED_WINDOW 5000
+
 DownloadItem::DownloadItem(QListWidgetItem *item,
                            QNetworkReply *reply,
                            const QString &fileName,
@@ -52,23 +69,40 @@ DownloadItem::DownloadItem(QListWidgetItem *item,
   , ftpDownloader_(0)
   , fileName_(fileName)
   , downloadUrl_(reply->url())
+  , request_(reply->request())
   , downloading_(false)
   , openAfterFinish_(openAfterDownload)
   , downloadStopped_(false)
+  , queued_(false)
+  , resumable_(false)
+  , curSpeed_(0)
   , received_(0)
+  , startReceived_(0)
   , total_(0)
+  , budget_(0)
+  , progressValue_(-1)
+  , infoTime_(0)
 {
   downloadTimer_.start();
 
-  if (QFile::exists(fileName)) {
-    QFile::remove(fileName);
+  outputFile_.setFileName(fileName);
+
+  // Unfinished download of the same link is continued
+  if (!loadState()) {
+    if (QFile::exists(fileName)) {
+      QFile::remove(fileName);
+    }
+    QFile::remove(stateFileName(fileName));
+    qint64 total = reply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+    if (total > 0) total_ = total;
   }
   qApp->processEvents();
 
-  outputFile_.setFileName(fileName);
-
-  qint64 total = reply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
-  if (total > 0) total_ = total;
+  Settings settings;
+  maxSegments_ = qBound(1, settings.value("Settings/downloadSegments", 4).toInt(),
+                        DOWNLOAD_SEGMENTS_MAX);
+  // Bandwidth in KB/s, 0 - unlimited
+  bandwidth_ = qMax(0, settings.value("Settings/downloadBandwidth", 0).toInt()) * 1024;
 
   fileNameLabel_ = new QLabel();
   fileNameLabel_->setStyleSheet("background: none;");
@@ -110,7 +144,10 @@ DownloadItem::DownloadItem(QListWidgetItem *item,
   setContextMenuPolicy(Qt::CustomContextMenu);
   connect(this, SIGNAL(customContextMenuRequested(QPoint)),
           this, SLOT(customContextMenuRequested(QPoint)));
-  connect(&updateInfoTimer_, SIGNAL(timeout()), this, SLOT(updateInfo()));
+  connect(&stateTimer_, SIGNAL(timeout()), this, SLOT(saveProgressState()));
+
+  throttleTimer_.setInterval(DOWNLOAD_THROTTLE_INTERVAL);
+  connect(&throttleTimer_, SIGNAL(timeout()), this, SLOT(throttle()));
 }
 
 DownloadItem::~DownloadItem()
@@ -120,40 +157,67 @@ DownloadItem::~DownloadItem()
 
 void DownloadItem::startDownloading()
 {
-  QUrl locationHeader = reply_->header(QNetworkRequest::LocationHeader).toUrl();
+  if (reply_) {
+    QUrl locationHeader = reply_->header(QNetworkRequest::LocationHeader).toUrl();
 
-  bool hasFtpUrlInHeader = locationHeader.isValid() && (locationHeader.scheme() == "ftp");
-  if (reply_->url().scheme() == "ftp" || hasFtpUrlInHeader) {
-    QUrl url = hasFtpUrlInHeader ? locationHeader : reply_->url();
-    reply_->abort();
-    reply_->deleteLater();
-    reply_ = 0;
+    bool hasFtpUrlInHeader = locationHeader.isValid() && (locationHeader.scheme() == "ftp");
+    if (reply_->url().scheme() == "ftp" || hasFtpUrlInHeader) {
+      QUrl url = hasFtpUrlInHeader ? locationHeader : reply_->url();
+      reply_->abort();
+      reply_->deleteLater();
+      reply_ = 0;
 
-    startDownloadingFromFtp(url);
-    return;
-  } else if (locationHeader.isValid()) {
-    reply_->abort();
-    reply_->deleteLater();
-
-    reply_ = mainApp->networkManager()->get(QNetworkRequest(locationHeader));
+      startDownloadingFromFtp(url);
+      return;
+    } else if (locationHeader.isValid()) {
+      request_.setUrl(reply_->url().resolved(locationHeader));
+      dropReply(reply_);
+      reply_ = 0;
+    }
   }
 
-  reply_->setParent(this);
-  connect(reply_, SIGNAL(readyRead()), this, SLOT(readyRead()));
-  connect(reply_, SIGNAL(downloadProgress(qint64,qint64)), this, SLOT(downloadProgress(qint64,qint64)));
-  connect(reply_, SIGNAL(error(QNetworkReply::NetworkError)), this, SLOT(error()));
-  connect(reply_, SIGNAL(metaDataChanged()), this, SLOT(metaDataChanged()));
-  connect(reply_, SIGNAL(finished()), this, SLOT(finished()));
+  if (!outputFile_.isOpen() && !outputFile_.open(QIODevice::ReadWrite)) {
+    stop(false);
+    downloadInfo_->setText(tr("Error: Cannot write to file!"));
+    return;
+  }
 
+  queued_ = false;
   downloading_ = true;
-  updateInfoTimer_.start(1000);
-  readyRead();
-  QTimer::singleShot(200, this, SLOT(updateDownload()));
-
-  if (reply_->error() != QNetworkReply::NoError) {
-    stop(false);
-    error();
+  downloadStopped_ = false;
+  startReceived_ = received_;
+  downloadTimer_.start();
+  speedSamples_.clear();
+  infoTime_ = 0;
+  stateTimer_.start(1000);
+  if (bandwidth_ > 0) {
+    budget_ = bandwidth_ * DOWNLOAD_THROTTLE_INTERVAL / 1000;
+    throttleTimer_.start();
+  }
+
+  if (segments_.isEmpty()) {
+    Segment segment = {0, -1, 0, 0, reply_};
+    segments_.append(segment);
+    if (reply_) {
+      setupReply(reply_);
+      if (reply_->attribute(QNetworkRequest::HttpStatusCodeAttribute).isValid())
+        segmentMetaDataChanged(reply_);
+    } else {
+      startSegment(0);
+    }
+  } else {
+    // Saved segments are continued, data received before is kept
+    if (reply_)
+      dropReply(reply_);
+    for (int i = 0; i < segments_.count(); ++i) {
+      if (!isSegmentDone(segments_.at(i)))
+        startSegment(i);
+    }
   }
+  reply_ = 0;
+
+  for (int i = 0; i < segments_.count(); ++i)
+    readSegment(i);
 }
 
 void DownloadItem::startDownloadingFromFtp(const QUrl &url)
@@ -174,7 +238,10 @@ void DownloadItem::startDownloadingFromFtp(const QUrl &url)
 
   ftpDownloader_->download(url, &outputFile_);
   downloading_ = true;
-  updateInfoTimer_.start(1000);
+  downloadTimer_.start();
+  speedSamples_.clear();
+  infoTime_ = 0;
+  stateTimer_.start(1000);
 
   QTimer::singleShot(200, this, SLOT(updateDownload()));
 
@@ -183,57 +250,396 @@ void DownloadItem::startDownloadingFromFtp(const QUrl &url)
   }
 }
 
+/** @brief Wait for free slot of download manager
+ *----------------------------------------------------------------------------*/
+void DownloadItem::setQueued()
+{
+  queued_ = true;
+  if (reply_) {
+    // Link is requested again when download is started
+    dropReply(reply_);
+    reply_ = 0;
+  }
+  downloadInfo_->setText(tr("Waiting for other downloads"));
+}
+
+/** @brief Request bytes of segment which are not received yet
+ *----------------------------------------------------------------------------*/
+void DownloadItem::startSegment(int index)
+{
+  Segment &segment = segments_[index];
+  QNetworkRequest request(request_);
+  qint64 from = segment.start + segment.received;
+  if ((from > 0) || (segment.end >= 0)) {
+    QByteArray range = "bytes=" + QByteArray::number(from) + "-";
+    if (segment.end >= 0)
+      range.append(QByteArray::number(segment.end));
+    request.setRawHeader("Range", range);
+    // Whole file is sent by server if it was changed
+    if (!validator_.isEmpty())
+      request.setRawHeader("If-Range", validator_);
+  }
+  request.setAttribute(QNetworkRequest::CacheLoadControlAttribute,
+                       QNetworkRequest::AlwaysNetwork);
+  request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
+
+  segment.reply = mainApp->networkManager()->get(request);
+  setupReply(segment.reply);
+}
+
+void DownloadItem::setupReply(QNetworkReply *reply)
+{
+  reply->setParent(this);
+  reply->setProperty("downloadReply", QVariant(true));
+  if (bandwidth_ > 0)
+    reply->setReadBufferSize(qMax(bandwidth_, qint64(16*1024)));
+  connect(reply, SIGNAL(readyRead()), this, SLOT(segmentReadyRead()));
+  connect(reply, SIGNAL(metaDataChanged()), this, SLOT(metaDataChanged()));
+  connect(reply, SIGNAL(finished()), this, SLOT(segmentFinished()));
+}
+
+/** @brief Abort reply without calling slots of download
+ *----------------------------------------------------------------------------*/
+void DownloadItem::dropReply(QNetworkReply *reply)
+{
+  reply->disconnect(this);
+  reply->abort();
+  reply->deleteLater();
+}
+
+int DownloadItem::segmentIndex(QNetworkReply *reply) const
+{
+  for (int i = 0; i < segments_.count(); ++i) {
+    if (segments_.at(i).reply == reply)
+      return i;
+  }
+  return -1;
+}
+
+bool DownloadItem::isSegmentDone(const Segment &segment) const
+{
+  return (segment.end >= 0) && (segment.start + segment.received > segment.end);
+}
+
+void DownloadItem::abortSegments()
+{
+  for (int i = 0; i < segments_.count(); ++i) {
+    if (segments_.at(i).reply) {
+      dropReply(segments_.at(i).reply);
+      segments_[i].reply = 0;
+    }
+  }
+}
+
 void DownloadItem::readyRead()
 {
-  if (!outputFile_.isOpen() && !outputFile_.open(QIODevice::WriteOnly)) {
-    stop(false);
-    downloadInfo_->setText(tr("Error: Cannot write to file!"));
+  for (int i = 0; i < segments_.count(); ++i)
+    readSegment(i);
+}
+
+void DownloadItem::segmentReadyRead()
+{
+  int index = segmentIndex(qobject_cast<QNetworkReply*>(sender()));
+  if (index >= 0)
+    readSegment(index);
+}
+
+/** @brief Write received data of segment into its place of file
+ *----------------------------------------------------------------------------*/
+void DownloadItem::readSegment(int index)
+{
+  if (!downloading_ || (index >= segments_.count()))
     return;
+  Segment &segment = segments_[index];
+  QNetworkReply *reply = segment.reply;
+  if (!reply)
+    return;
+
+  qint64 size = reply->bytesAvailable();
+  if (segment.end >= 0)
+    size = qMin(size, segment.end - segment.start - segment.received + 1);
+  if (bandwidth_ > 0)
+    size = qMin(size, budget_);
+  if (size > 0) {
+    QByteArray data = reply->read(size);
+    if (!outputFile_.seek(segment.start + segment.received) ||
+        (outputFile_.write(data) != data.size())) {
+      stop(false);
+      downloadInfo_->setText(tr("Error: Cannot write to file!"));
+      return;
+    }
+    segment.received += data.size();
+    received_ += data.size();
+    budget_ -= data.size();
+  }
+
+  if (isSegmentDone(segment) || (reply->isFinished() && !reply->bytesAvailable()))
+    completeSegment(index);
+}
+
+void DownloadItem::completeSegment(int index)
+{
+  Segment &segment = segments_[index];
+  QNetworkReply *reply = segment.reply;
+  segment.reply = 0;
+
+  int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+  QNetworkReply::NetworkError replyError = reply->error();
+  QString errorString = reply->errorString();
+  dropReply(reply);
+
+  if (!isSegmentDone(segment)) {
+    if ((segment.end < 0) && (replyError == QNetworkReply::NoError)) {
+      // Size of file was unknown, it is all data
+      segment.end = segment.start + segment.received - 1;
+      total_ = received_;
+    } else {
+      if ((replyError == QNetworkReply::NoError) || (status >= 400) ||
+          (segment.retries >= DOWNLOAD_SEGMENT_RETRIES) || !resumable_) {
+        stop(false);
+        if (replyError == QNetworkReply::NoError)
+          errorString = tr("Connection closed");
+        downloadInfo_->setText(tr("Error: ") + errorString);
+        return;
+      }
+      segment.retries++;
+      LOG_DEBUG(LogFile::Fetch) << "Download segment retry:" << downloadUrl_.toString()
+                                  << segment.start + segment.received << errorString;
+      startSegment(index);
+      return;
+    }
+  }
+
+  for (int i = 0; i < segments_.count(); ++i) {
+    if (!isSegmentDone(segments_.at(i)))
+      return;
   }
-  outputFile_.write(reply_->readAll());
+  finished();
+}
+
+void DownloadItem::segmentFinished()
+{
+  int index = segmentIndex(qobject_cast<QNetworkReply*>(sender()));
+  if (index >= 0)
+    readSegment(index);
+}
+
+/** @brief Give bandwidth budget for the next interval
+ *----------------------------------------------------------------------------*/
+void DownloadItem::throttle()
+{
+  budget_ = bandwidth_ * DOWNLOAD_THROTTLE_INTERVAL / 1000;
+  for (int i = 0; (i < segments_.count()) && (budget_ > 0); ++i)
+    readSegment(i);
 }
 
 void DownloadItem::downloadProgress(qint64 received, qint64 total)
 {
-  qint64 currentValue = 0;
-  qint64 totalValue = 0;
-  if (total > 0) {
-    currentValue = received * 100 / total;
-    totalValue = 100;
+  if (total > 0)
     total_ = total;
-  }
-  progressBar_->setValue(currentValue);
-  progressBar_->setMaximum(totalValue);
-  curSpeed_ = received * 1000.0 / downloadTimer_.elapsed();
   received_ = received;
 
-  if (reply_->isFinished())
+  if (ftpDownloader_ && ftpDownloader_->isFinished())
     finished();
 }
 
+/** @brief Show received data, manager calls it for all items at once
+ *
+ * Data only changes counters, so widgets are repainted at rate of manager
+ * however often data comes. Text is updated once per DOWNLOAD_INFO_INTERVAL.
+ *----------------------------------------------------------------------------*/
+void DownloadItem::updateDisplay()
+{
+  if (!downloading_)
+    return;
+
+  int now = downloadTimer_.elapsed();
+  speedSamples_.enqueue(qMakePair(now, received_));
+  while ((speedSamples_.count() > 2) &&
+         (speedSamples_.at(1).first <= now - DOWNLOAD_SPEED_WINDOW)) {
+    speedSamples_.dequeue();
+  }
+  int window = now - speedSamples_.head().first;
+  if (window > 0)
+    curSpeed_ = (received_ - speedSamples_.head().second) * 1000.0 / window;
+
+  int value = (total_ > 0) ? int(received_ * 100 / total_) : 0;
+  if (value != progressValue_) {
+    progressValue_ = value;
+    progressBar_->setMaximum((total_ > 0) ? 100 : 0);
+    progressBar_->setValue(value);
+  }
+
+  if (now - infoTime_ >= DOWNLOAD_INFO_INTERVAL) {
+    infoTime_ = now;
+    updateInfo();
+  }
+}
+
 void DownloadItem::metaDataChanged()
 {
-  QUrl locationHeader = reply_->header(QNetworkRequest::LocationHeader).toUrl();
+  QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+  if (reply && (segmentIndex(reply) >= 0))
+    segmentMetaDataChanged(reply);
+}
+
+/** @brief Check response of segment request and split download
+ *----------------------------------------------------------------------------*/
+void DownloadItem::segmentMetaDataChanged(QNetworkReply *reply)
+{
+  int index = segmentIndex(reply);
+  QUrl locationHeader = reply->header(QNetworkRequest::LocationHeader).toUrl();
   if (locationHeader.isValid()) {
-    reply_->close();
-    reply_->deleteLater();
+    request_.setUrl(reply->url().resolved(locationHeader));
+    dropReply(reply);
+    segments_[index].reply = 0;
+    startSegment(index);
+    return;
+  }
+
+  int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+  if (status == 206) {
+    if (total_ <= 0) {
+      QByteArray contentRange = reply->rawHeader("Content-Range");
+      total_ = contentRange.mid(contentRange.indexOf('/') + 1).toLongLong();
+    }
+    return;
+  }
+  if (status != 200)
+    return;
 
-    reply_ = mainApp->networkManager()->get(QNetworkRequest(locationHeader));
-    startDownloading();
+  if (!reply->request().hasRawHeader("Range")) {
+    // Reply of the whole file is checked once
+    if (segments_.at(index).end >= 0)
+      return;
+  } else {
+    // Server ignores ranges or file was changed, all is loaded again
+    for (int i = 0; i < segments_.count(); ++i) {
+      if (segments_.at(i).reply && (segments_.at(i).reply != reply))
+        dropReply(segments_.at(i).reply);
+    }
+    segments_.clear();
+    Segment segment = {0, -1, 0, 0, reply};
+    segments_.append(segment);
+    outputFile_.resize(0);
+    received_ = 0;
+    startReceived_ = 0;
+    index = 0;
   }
+
+  qint64 total = reply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+  if (total > 0)
+    total_ = total;
+  validator_ = reply->rawHeader("ETag");
+  if (validator_.isEmpty() || validator_.startsWith("W/"))
+    validator_ = reply->rawHeader("Last-Modified");
+  resumable_ = (total_ > 0) &&
+      (reply->rawHeader("Accept-Ranges").trimmed().toLower() == "bytes");
+  if (!resumable_)
+    return;
+
+  segments_[index].end = total_ - 1;
+  int count = int(qMin(qint64(maxSegments_), total_ / DOWNLOAD_SEGMENT_MIN_SIZE));
+  if (count > 1)
+    splitDownload(count);
+  saveState();
+}
+
+/** @brief Divide file into parts loaded by parallel requests
+ *
+ * First part is read from reply of the whole file, the rest is requested
+ * with Range header.
+ *----------------------------------------------------------------------------*/
+void DownloadItem::splitDownload(int count)
+{
+  qint64 size = total_ / count;
+  outputFile_.resize(total_);
+  segments_[0].end = size - 1;
+  for (int i = 1; i < count; ++i) {
+    Segment segment = {i * size, (i == count - 1) ? total_ - 1 : (i + 1) * size - 1,
+                       0, 0, 0};
+    segments_.append(segment);
+    startSegment(i);
+  }
+  LOG_DEBUG(LogFile::Fetch) << "Download split:" << downloadUrl_.toString() << count;
+}
+
+QString DownloadItem::stateFileName(const QString &fileName)
+{
+  return fileName + DOWNLOAD_STATE_SUFFIX;
+}
+
+/** @brief Check if file is unfinished download of url
+ *----------------------------------------------------------------------------*/
+bool DownloadItem::hasState(const QString &fileName, const QUrl &url)
+{
+  if (!QFile::exists(fileName) || !QFile::exists(stateFileName(fileName)))
+    return false;
+  QSettings state(stateFileName(fileName), QSettings::IniFormat);
+  return (state.value("url").toString() == url.toString());
+}
+
+bool DownloadItem::loadState()
+{
+  if (!hasState(fileName_, downloadUrl_))
+    return false;
+
+  QSettings state(stateFileName(fileName_), QSettings::IniFormat);
+  total_ = state.value("total").toLongLong();
+  validator_ = state.value("validator").toByteArray();
+  request_.setUrl(QUrl::fromEncoded(state.value("location").toByteArray()));
+  segments_.clear();
+  received_ = 0;
+  foreach (const QString &value, state.value("segments").toStringList()) {
+    QStringList fields = value.split(':');
+    if (fields.count() != 3)
+      continue;
+    Segment segment = {fields.at(0).toLongLong(), fields.at(1).toLongLong(),
+                       fields.at(2).toLongLong(), 0, 0};
+    segments_.append(segment);
+    received_ += segment.received;
+  }
+  resumable_ = (total_ > 0) && !segments_.isEmpty();
+  if (!resumable_)
+    segments_.clear();
+  return resumable_;
+}
+
+/** @brief Save received parts, download is continued from them
+ *----------------------------------------------------------------------------*/
+void DownloadItem::saveState()
+{
+  if (!resumable_ || segments_.isEmpty())
+    return;
+
+  // State does not tell about data not written yet
+  outputFile_.flush();
+
+  QStringList segments;
+  foreach (const Segment &segment, segments_) {
+    segments.append(QString("%1:%2:%3").arg(segment.start).arg(segment.end).
+                    arg(segment.received));
+  }
+  QSettings state(stateFileName(fileName_), QSettings::IniFormat);
+  state.setValue("url", downloadUrl_.toString());
+  state.setValue("location", request_.url().toEncoded());
+  state.setValue("total", total_);
+  state.setValue("validator", validator_);
+  state.setValue("segments", segments);
 }
 
 void DownloadItem::error()
 {
-  if (reply_ && reply_->error() != QNetworkReply::NoError) {
+  if (ftpDownloader_ && ftpDownloader_->error() != QFtp::NoError) {
     stop(false);
-    downloadInfo_->setText(tr("Error: ") + reply_->errorString());
+    downloadInfo_->setText(tr("Error: ") + ftpDownloader_->errorString());
   }
 }
 
 void DownloadItem::finished()
 {
-  updateInfoTimer_.stop();
+  stateTimer_.stop();
+  throttleTimer_.stop();
 
   QString host = downloadUrl_.host();
   QString fileSize = fileSizeToString(total_);
@@ -246,8 +652,10 @@ void DownloadItem::finished()
   progressFrame_->hide();
   item_->setSizeHint(sizeHint());
   outputFile_.close();
+  QFile::remove(stateFileName(fileName_));
 
-  reply_->deleteLater();
+  abortSegments();
+  segments_.clear();
 
   downloading_ = false;
 
@@ -307,24 +715,29 @@ QString DownloadItem::currentSpeedToString(double speed)
 
 void DownloadItem::updateInfo()
 {
-  int estimatedTime = ((total_ - received_) / 1024) / (curSpeed_ / 1024);
   QString speed = currentSpeedToString(curSpeed_);
-
-  QTime time;
-  time = time.addSecs(estimatedTime);
-  QString remTime = remaingTimeToString(time);
-  remTime_ = time;
-
   QString curSize = fileSizeToString(received_);
   QString fileSize = fileSizeToString(total_);
 
   if (fileSize == tr("Unknown size")) {
     downloadInfo_->setText(tr("%2 - unknown size (%3)").arg(curSize, speed));
+  } else if (curSpeed_ <= 0) {
+    downloadInfo_->setText(tr("Remaining time unavailable"));
   } else {
+    QTime time;
+    time = time.addSecs(int((total_ - received_) / curSpeed_));
+    remTime_ = time;
+    QString remTime = remaingTimeToString(time);
     downloadInfo_->setText(tr("Remaining %1 - %2 of %3 (%4)").arg(remTime, curSize, fileSize, speed));
   }
 }
 
+void DownloadItem::saveProgressState()
+{
+  if (downloading_)
+    saveState();
+}
+
 void DownloadItem::stop(bool askForDeleteFile)
 {
   if (downloadStopped_)
@@ -334,10 +747,17 @@ void DownloadItem::stop(bool askForDeleteFile)
   QString host = downloadUrl_.host();
 
   openAfterFinish_ = false;
-  updateInfoTimer_.stop();
-  reply_->abort();
-  reply_->deleteLater();
+  stateTimer_.stop();
+  throttleTimer_.stop();
+  if (reply_) {
+    dropReply(reply_);
+    reply_ = 0;
+  }
+  if (ftpDownloader_)
+    ftpDownloader_->abort();
+  abortSegments();
 
+  saveState();
   outputFile_.close();
   QString outputfile = QFileInfo(outputFile_).absoluteFilePath();
   downloadInfo_->setText(tr("Cancelled - %1").arg(host));
@@ -356,10 +776,27 @@ void DownloadItem::stop(bool askForDeleteFile)
                               QMessageBox::Yes | QMessageBox::No);
     if (button == QMessageBox::Yes) {
       QFile::remove(outputfile);
+      QFile::remove(stateFileName(fileName_));
+      segments_.clear();
+      received_ = 0;
+      resumable_ = false;
     }
   }
 }
 
+/** @brief Continue stopped or failed download from received data
+ *----------------------------------------------------------------------------*/
+void DownloadItem::resume()
+{
+  if (downloading_ || queued_)
+    return;
+
+  progressFrame_->show();
+  item_->setSizeHint(sizeHint());
+  downloadInfo_->setText(tr("Remaining time unavailable"));
+  emit resumeRequested(this);
+}
+
 /*virtual*/ void DownloadItem::mouseDoubleClickEvent(QMouseEvent* event)
 {
   openFile();
@@ -376,6 +813,8 @@ void DownloadItem::customContextMenuRequested(const QPoint &pos)
   menu.addAction(tr("Copy Download Link"), this, SLOT(copyDownloadLink()));
   menu.addSeparator();
   menu.addAction(tr("Cancel Downloading"), this, SLOT(stop()))->setEnabled(downloading_);
+  menu.addAction(tr("Resume Downloading"), this, SLOT(resume()))->
+      setEnabled(!downloading_ && !queued_ && resumable_ && !segments_.isEmpty());
   menu.addAction(tr("Remove"), this, SLOT(clear()))->setEnabled(!downloading_);
 
   if (downloading_ || downloadInfo_->text().startsWith(tr("Cancelled")) || downloadInfo_->text().startsWith(tr("Error"))) {
@@ -42,6 +42,7 @@
 #include <QtGui>
 #include <QFtp>
 #endif
+#include <QQueue>
 #include <QTimer>
 #include <QNetworkReply>
 #include <QAuthenticator>
@@ -59,14 +60,20 @@ public:
 
   void startDownloading();
   void startDownloadingFromFtp(const QUrl &url);
+  void setQueued();
+  void updateDisplay();
   bool isDownloading() { return downloading_; }
+  bool isQueued() { return queued_; }
+  qint64 bytesReceived() { return received_; }
   QTime remainingTime() { return remTime_; }
   static QString remaingTimeToString(QTime time);
   static QString currentSpeedToString(double speed);
+  static bool hasState(const QString &fileName, const QUrl &url);
 
 signals:
   void deleteItem(DownloadItem*);
   void downloadFinished(bool success);
+  void resumeRequested(DownloadItem*);
 
 protected:
   virtual void mouseDoubleClickEvent(QMouseEvent*);
@@ -74,12 +81,16 @@ protected:
 private slots:
   void finished();
   void metaDataChanged();
-  void updateInfo();
+  void saveProgressState();
   void downloadProgress(qint64 received, qint64 total);
   void stop(bool askForDeleteFile = true);
+  void resume();
   void openFile();
   void openFolder();
   void readyRead();
+  void segmentReadyRead();
+  void segmentFinished();
+  void throttle();
   void error();
   void updateDownload();
   void customContextMenuRequested(const QPoint &pos);
@@ -88,7 +99,30 @@ private slots:
   void copyDownloadLink();
 
 private:
+  /** @brief Part of file loaded by one request */
+  struct Segment {
+    qint64 start;
+    qint64 end;       // last byte, -1 if size of file is unknown
+    qint64 received;
+    int retries;
+    QNetworkReply *reply;
+  };
+
   QString fileSizeToString(qint64 size);
+  void setupReply(QNetworkReply *reply);
+  void dropReply(QNetworkReply *reply);
+  void startSegment(int index);
+  void readSegment(int index);
+  void completeSegment(int index);
+  int segmentIndex(QNetworkReply *reply) const;
+  bool isSegmentDone(const Segment &segment) const;
+  void abortSegments();
+  void segmentMetaDataChanged(QNetworkReply *reply);
+  void splitDownload(int count);
+  void updateInfo();
+  static QString stateFileName(const QString &fileName);
+  bool loadState();
+  void saveState();
 
   QListWidgetItem *item_;
   QNetworkReply *reply_;
@@ -96,16 +130,30 @@ private:
   QString fileName_;
   QTime downloadTimer_;
   QTime remTime_;
-  QTimer updateInfoTimer_;
+  QTimer stateTimer_;
+  QTimer throttleTimer_;
   QFile outputFile_;
   QUrl downloadUrl_;
+  QNetworkRequest request_;
+  QList<Segment> segments_;
+  QByteArray validator_;
+  int maxSegments_;
+  qint64 bandwidth_;
 
   bool downloading_;
   bool openAfterFinish_;
   bool downloadStopped_;
+  bool queued_;
+  bool resumable_;
   double curSpeed_;
   qint64 received_;
+  qint64 startReceived_;
   qint64 total_;
+  qint64 budget_;
+  // Received bytes by time of download (ms) during speed window
+  QQueue<QPair<int, qint64> > speedSamples_;
+  int progressValue_;
+  int infoTime_;
 
   QLabel *fileNameLabel_;
   QProgressBar *progressBar_;
@@ -26,6 +26,11 @@
 
 #include <qzregexp.h>
 
+// Interval of checking time windows and budget of enclosures (ms)
+#define ENCLOSURE_SCHEDULE_INTERVAL 60000
+// Interval of showing progress of all downloads at once (ms)
+#define DOWNLOAD_PROGRESS_INTERVAL 250
+
 DownloadManager::DownloadManager(QWidget *parent)
   : QWidget(parent)
 {
@@ -66,6 +71,15 @@ DownloadManager::DownloadManager(QWidget *parent)
 
   updateInfoTimer_.start(2000);
 
+  progressTimer_.setInterval(DOWNLOAD_PROGRESS_INTERVAL);
+  connect(&progressTimer_, SIGNAL(timeout()), this, SLOT(updateProgress()));
+
+  Settings settings;
+  maxDownloads_ = qMax(1, settings.value("Settings/maxDownloads", 3).toInt());
+
+  scheduleTimer_.setInterval(ENCLOSURE_SCHEDULE_INTERVAL);
+  connect(&scheduleTimer_, SIGNAL(timeout()), this, SLOT(scheduleEnclosures()));
+
   hide();
 }
 
@@ -86,10 +100,13 @@ void DownloadManager::handleUnsupportedContent(QNetworkReply* reply, bool askDow
   if (askDownloadLocation || !QFile::exists(downloadLocation))
     downloadLocation = settings.value("Settings/curDownloadLocation", downloadLocation).toString();
 
-  QString fileName(getFileName(reply));
-  fileName = Common::ensureUniqueFilename(downloadLocation + "/" + fileName);
+  QString fileName = downloadLocation + "/" + getFileName(reply);
+  // Unfinished download of the same link is continued in its file
+  bool resume = DownloadItem::hasState(fileName, reply->url());
+  if (!resume)
+    fileName = Common::ensureUniqueFilename(fileName);
   QFileInfo fileInfo(fileName);
-  if (askDownloadLocation || fileInfo.exists() ||
+  if (askDownloadLocation || (!resume && fileInfo.exists()) ||
       !QFile::exists(downloadLocation)) {
     QString filter = QString(tr("File %1 (*.%2)") + ";;" + tr("All Files (*.*)")).
         arg(fileInfo.suffix().toUpper()).
@@ -183,19 +200,77 @@ void DownloadManager::startExternalApp(const QString &executable, const QUrl &ur
 void DownloadManager::itemCreated(QListWidgetItem* item, DownloadItem* downItem)
 {
   connect(downItem, SIGNAL(deleteItem(DownloadItem*)), this, SLOT(deleteItem(DownloadItem*)));
+  connect(downItem, SIGNAL(resumeRequested(DownloadItem*)), this, SLOT(startDownload(DownloadItem*)));
+  connect(downItem, SIGNAL(downloadFinished(bool)), this, SLOT(startQueued()),
+          Qt::QueuedConnection);
 
   listWidget_->setItemWidget(item, downItem);
   item->setSizeHint(downItem->sizeHint());
   downItem->show();
 
   emit signalShowDownloads(false);
-  downItem->startDownloading();
+  startDownload(downItem);
   updateInfo();
 }
 
+/** @brief Start download or put it in queue if too many are active
+ *----------------------------------------------------------------------------*/
+void DownloadManager::startDownload(DownloadItem* item)
+{
+  if (activeDownloads() < maxDownloads_) {
+    item->startDownloading();
+    if (!progressTimer_.isActive())
+      progressTimer_.start();
+  } else {
+    item->setQueued();
+    queue_.append(item);
+  }
+}
+
+void DownloadManager::startQueued()
+{
+  while (!queue_.isEmpty() && (activeDownloads() < maxDownloads_)) {
+    queue_.takeFirst()->startDownloading();
+    if (!progressTimer_.isActive())
+      progressTimer_.start();
+  }
+}
+
+/** @brief Show progress of all running downloads
+ *
+ * Items are updated together, so their changes are repainted in one pass
+ * of list. Timer runs only while something is downloaded.
+ *----------------------------------------------------------------------------*/
+void DownloadManager::updateProgress()
+{
+  bool downloading = false;
+  for (int i = 0; i < listWidget_->count(); i++) {
+    DownloadItem* downItem = qobject_cast<DownloadItem*>(listWidget_->itemWidget(listWidget_->item(i)));
+    if (downItem && downItem->isDownloading()) {
+      downItem->updateDisplay();
+      downloading = true;
+    }
+  }
+  if (!downloading)
+    progressTimer_.stop();
+}
+
+int DownloadManager::activeDownloads()
+{
+  int count = 0;
+  for (int i = 0; i < listWidget_->count(); i++) {
+    DownloadItem* downItem = qobject_cast<DownloadItem*>(listWidget_->itemWidget(listWidget_->item(i)));
+    if (downItem && downItem->isDownloading())
+      count++;
+  }
+  return count;
+}
+
 void DownloadManager::deleteItem(DownloadItem* item)
 {
   if (item && !item->isDownloading()) {
+    queue_.removeAll(item);
+    enclosureItems_.remove(item);
     delete item;
   }
 }
@@ -212,6 +287,8 @@ void DownloadManager::clearList()
       continue;
     }
     items.append(downItem);
+    queue_.removeAll(downItem);
+    enclosureItems_.remove(downItem);
   }
   qDeleteAll(items);
 }
@@ -251,6 +328,155 @@ void DownloadManager::ftpAuthentication(const QUrl &url, QAuthenticator *auth)
   delete authenticationDialog;
 }
 
+/** @brief Put enclosure of new news in queue of automatic downloads
+ *
+ * Enclosure is skipped if the same url is in queue or was downloaded
+ * from other feed, or its file is already in download folder.
+ *----------------------------------------------------------------------------*/
+void DownloadManager::addEnclosure(int feedId, const QString &url,
+                                   const QString &type, qint64 length)
+{
+  Settings settings;
+  QStringList types = settings.value("Settings/enclosureTypes", "audio,video").toString().
+      split(",", QString::SkipEmptyParts);
+  bool typeFound = types.isEmpty();
+  foreach (const QString &prefix, types) {
+    if (type.startsWith(prefix.trimmed(), Qt::CaseInsensitive)) {
+      typeFound = true;
+      break;
+    }
+  }
+  if (!typeFound || enclosureUrls_.contains(url))
+    return;
+  enclosureUrls_.insert(url);
+
+  QUrl enclosureUrl = QUrl::fromEncoded(url.toUtf8());
+  QString fileName = enclosureLocation() + "/" + QFileInfo(enclosureUrl.path()).fileName();
+  if (QFile::exists(fileName) && !DownloadItem::hasState(fileName, enclosureUrl))
+    return;
+
+  QueuedEnclosure enclosure;
+  enclosure.feedId = feedId;
+  enclosure.url = url;
+  enclosure.length = qMax(length, qint64(0));
+  enclosureQueue_.append(enclosure);
+  scheduleEnclosures();
+}
+
+/** @brief Start queued enclosures allowed by time windows and daily budget
+ *
+ * Time windows are set as "HH:mm-HH:mm" list separated by commas, the
+ * budget is in MB per day. Size of enclosure given by feed is reserved
+ * on start, and corrected by received size on finish.
+ *----------------------------------------------------------------------------*/
+void DownloadManager::scheduleEnclosures()
+{
+  if (enclosureQueue_.isEmpty()) {
+    scheduleTimer_.stop();
+    return;
+  }
+  if (!scheduleTimer_.isActive())
+    scheduleTimer_.start();
+
+  Settings settings;
+  if (!isEnclosureTime(settings.value("Settings/enclosureTimeWindows").toString()))
+    return;
+
+  int maxEnclosures = qMax(1, settings.value("Settings/enclosureDownloads", 1).toInt());
+  qint64 dailyLimit = settings.value("Settings/enclosureDailyLimit", 0).toLongLong() * 1024 * 1024;
+  QString today = QDate::currentDate().toString(Qt::ISODate);
+  if (settings.value("Settings/enclosureBudgetDate").toString() != today) {
+    settings.setValue("Settings/enclosureBudgetDate", today);
+    settings.setValue("Settings/enclosureBudgetUsed", 0);
+  }
+  qint64 used = settings.value("Settings/enclosureBudgetUsed", 0).toLongLong();
+
+  while (!enclosureQueue_.isEmpty() && (enclosureItems_.count() < maxEnclosures)) {
+    if (dailyLimit > 0) {
+      if (enclosureQueue_.first().length > dailyLimit) {
+        // Enclosure is larger than budget of whole day
+        enclosureQueue_.removeFirst();
+        continue;
+      }
+      if (used + enclosureQueue_.first().length > dailyLimit)
+        break;
+      if (used >= dailyLimit)
+        break;
+    }
+    QueuedEnclosure enclosure = enclosureQueue_.takeFirst();
+    used += enclosure.length;
+    startEnclosure(enclosure, enclosure.length);
+  }
+
+  settings.setValue("Settings/enclosureBudgetUsed", used);
+}
+
+void DownloadManager::startEnclosure(const QueuedEnclosure &enclosure, qint64 reserved)
+{
+  QUrl url = QUrl::fromEncoded(enclosure.url.toUtf8());
+  QNetworkReply *reply = mainApp->networkManager()->get(QNetworkRequest(url));
+
+  QString fileName = enclosureLocation() + "/" + getFileName(reply);
+  if (!DownloadItem::hasState(fileName, url))
+    fileName = Common::ensureUniqueFilename(fileName);
+
+  reply->setProperty("downloadReply", QVariant(true));
+  QListWidgetItem *item = new QListWidgetItem(listWidget_);
+  DownloadItem *downItem = new DownloadItem(item, reply, fileName, false);
+  enclosureItems_.insert(downItem, reserved);
+  connect(downItem, SIGNAL(downloadFinished(bool)), this, SLOT(enclosureFinished()));
+  emit signalItemCreated(item, downItem);
+}
+
+void DownloadManager::enclosureFinished()
+{
+  DownloadItem *item = qobject_cast<DownloadItem*>(sender());
+  if (!item || !enclosureItems_.contains(item))
+    return;
+
+  qint64 reserved = enclosureItems_.take(item);
+  Settings settings;
+  if (settings.value("Settings/enclosureBudgetDate").toString() ==
+      QDate::currentDate().toString(Qt::ISODate)) {
+    qint64 used = settings.value("Settings/enclosureBudgetUsed", 0).toLongLong();
+    settings.setValue("Settings/enclosureBudgetUsed",
+                      qMax(qint64(0), used + item->bytesReceived() - reserved));
+  }
+
+  scheduleEnclosures();
+}
+
+QString DownloadManager::enclosureLocation()
+{
+  Settings settings;
+  // Headless daemon has no main window, location is read from settings
+  QString downloadLocation = mainApp->mainWindow() ?
+        mainApp->mainWindow()->downloadLocation_ :
+        settings.value("Settings/downloadLocation", "").toString();
+  if (!QFile::exists(downloadLocation)) {
+    downloadLocation = settings.value("Settings/curDownloadLocation", downloadLocation).toString();
+  }
+  return downloadLocation;
+}
+
+bool DownloadManager::isEnclosureTime(const QString &windows)
+{
+  if (windows.trimmed().isEmpty())
+    return true;
+
+  QTime now = QTime::currentTime();
+  foreach (const QString &window, windows.split(",", QString::SkipEmptyParts)) {
+    QTime from = QTime::fromString(window.section('-', 0, 0).trimmed(), "H:mm");
+    QTime to = QTime::fromString(window.section('-', 1, 1).trimmed(), "H:mm");
+    if (!from.isValid() || !to.isValid())
+      continue;
+    // Window can pass over midnight
+    if ((from <= to) ? ((now >= from) && (now < to)) : ((now >= from) || (now < to)))
+      return true;
+  }
+  return false;
+}
+
 void DownloadManager::retranslateStrings()
 {
   listClaerAct_->setText(tr("Clear"));
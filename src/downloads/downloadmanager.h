@@ -42,6 +42,7 @@ public:
 
 public slots:
   void ftpAuthentication(const QUrl &url, QAuthenticator *auth);
+  void addEnclosure(int feedId, const QString &url, const QString &type, qint64 length);
 
 signals:
   void signalItemCreated(QListWidgetItem* item, DownloadItem* downItem);
@@ -54,11 +55,35 @@ private slots:
   void clearList();
   void deleteItem(DownloadItem* item);
   void updateInfo();
+  void updateProgress();
+  void startDownload(DownloadItem* item);
+  void startQueued();
+  void scheduleEnclosures();
+  void enclosureFinished();
 
 private:
+  struct QueuedEnclosure {
+    int feedId;
+    QString url;
+    qint64 length;
+  };
+
+  int activeDownloads();
+  QString enclosureLocation();
+  bool isEnclosureTime(const QString &windows);
+  void startEnclosure(const QueuedEnclosure &enclosure, qint64 reserved);
+
   QListWidget *listWidget_;
   QAction *listClaerAct_;
   QTimer updateInfoTimer_;
+  QTimer progressTimer_;
+  QList<DownloadItem*> queue_;
+  int maxDownloads_;
+
+  QList<QueuedEnclosure> enclosureQueue_;
+  QSet<QString> enclosureUrls_;
+  QHash<DownloadItem*, qint64> enclosureItems_;
+  QTimer scheduleTimer_;
 
 };
 
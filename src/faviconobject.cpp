@@ -18,8 +18,13 @@
 #include "faviconobject.h"
 #include "VersionNo.h"
 #include "mainapplication.h"
+#include "pipelinemetrics.h"
+#include "settings.h"
+#include "sharednetworkcache.h"
 
+#include <QBuffer>
 #include <QDebug>
+#include <QImage>
 #include <QtSql>
 #ifdef HAVE_QT5
 #include <QWebPage>
@@ -29,28 +34,98 @@
 #include <qzregexp.h>
 
 #define REPLY_MAX_COUNT 4
-#define REQUEST_TIMEOUT 30
+// Time (ms) request may go without headers or data from server
+#define REQUEST_TIMEOUT 30000
+
+// Format of file with cached icons of sites
+#define ICON_CACHE_FILE "favicons.dat"
+#define ICON_CACHE_MAGIC 0x51524943  // "QRIC"
+#define ICON_CACHE_VERSION 1
+// Time in seconds icon is used without revalidation, if server doesn't set it
+#define ICON_DEFAULT_AGE (7 * 24 * 60 * 60)
+#define ICON_MIN_AGE (24 * 60 * 60)
+#define ICON_MAX_AGE (30 * 24 * 60 * 60)
+// Delay before cache is written after change (msec)
+#define ICON_CACHE_SAVE_DELAY 10000
+// Bytes of page read when its head does not end earlier
+#define PAGE_HEAD_MAX_SIZE 65536
+// Size of icon stored for feed
+#define FEED_ICON_SIZE 16
+// Icons decoded from data of sites, feeds of one site share them
+#define PREPARED_ICONS_CACHE_SIZE 100
+
+/** @brief Get URL of site for which icon is requested
+ *----------------------------------------------------------------------------*/
+static QUrl siteUrl(const QString &urlString, const QString &feedUrl)
+{
+  QUrl url = QUrl::fromEncoded(urlString.toUtf8());
+  url.setUrl(QString("%1://%2").arg(url.scheme()).arg(url.host()));
+  if (!url.isValid()) {
+    url = QUrl::fromEncoded(feedUrl.toUtf8());
+    url.setUrl(QString("%1://%2").arg(url.scheme()).arg(url.host()));
+  }
+  return url;
+}
+
+/** @brief Decode icon and scale it to size of feed icon
+ *
+ * QImage is used, so icons are decoded in thread of favicons and main
+ * window gets data ready to store and show.
+ * @return data of icon in ICO format, empty if \a data is not an image
+ *----------------------------------------------------------------------------*/
+static QByteArray decodeIcon(const QByteArray &data, const QString &format)
+{
+  QImage image;
+  if (!image.loadFromData(data) && !image.loadFromData(data, format.toUtf8().data()))
+    return QByteArray();
+
+  image = image.scaled(FEED_ICON_SIZE, FEED_ICON_SIZE, Qt::IgnoreAspectRatio,
+                       Qt::SmoothTransformation);
+  QByteArray faviconData;
+  QBuffer buffer(&faviconData);
+  buffer.open(QIODevice::WriteOnly);
+  if (!image.save(&buffer, "ICO"))
+    return QByteArray();
+  return faviconData;
+}
 
 FaviconObject::FaviconObject(QObject *parent)
   : QObject(parent)
+  , dispatchPending_(false)
+  , lastToken_(0)
+  , iconCacheChanged_(false)
 {
   setObjectName("faviconObject_");
+  preparedIcons_.setMaxCost(PREPARED_ICONS_CACHE_SIZE);
 
+  clock_.start();
   timeout_ = new QTimer(this);
   timeout_->setInterval(1000);
   connect(timeout_, SIGNAL(timeout()), this, SLOT(slotRequestTimeout()));
 
-  getUrlTimer_ = new QTimer(this);
-  getUrlTimer_->setSingleShot(true);
-  getUrlTimer_->setInterval(20);
-  connect(getUrlTimer_, SIGNAL(timeout()), this, SLOT(getQueuedUrl()));
-
   connect(this, SIGNAL(signalGet(QUrl,QString,int)),
           SLOT(slotGet(QUrl,QString,int)));
 
+  saveCacheTimer_ = new QTimer(this);
+  saveCacheTimer_->setSingleShot(true);
+  saveCacheTimer_->setInterval(ICON_CACHE_SAVE_DELAY);
+  connect(saveCacheTimer_, SIGNAL(timeout()), this, SLOT(saveIconCache()));
+
   networkManager_ = new NetworkManager(true, this);
+  networkManager_->setCache(new SharedNetworkCache(SharedNetworkCache::Favicons));
   connect(networkManager_, SIGNAL(finished(QNetworkReply*)),
           this, SLOT(finished(QNetworkReply*)));
+
+  // Service is asked for icon by host, e.g. "https://icons.duckduckgo.com/ip3/%1.ico"
+  Settings settings;
+  iconService_ = settings.value("Settings/faviconService", QString()).toString();
+
+  loadIconCache();
+}
+
+FaviconObject::~FaviconObject()
+{
+  saveIconCache();
 }
 
 void FaviconObject::disconnectObjects()
@@ -63,85 +138,273 @@ void FaviconObject::disconnectObjects()
  *----------------------------------------------------------------------------*/
 void FaviconObject::requestUrl(QString urlString, QString feedUrl)
 {
-  if (!timeout_->isActive())
-    timeout_->start();
-
   urlsQueue_.enqueue(urlString);
   feedsQueue_.enqueue(feedUrl);
-
-  if (!getUrlTimer_->isActive())
-    getUrlTimer_->start();
+  scheduleQueuedUrl();
 }
 
-/** @brief Process request queue by timer
+/** @brief Process request queue once control returns to event loop
  *----------------------------------------------------------------------------*/
-void FaviconObject::getQueuedUrl()
+void FaviconObject::scheduleQueuedUrl()
 {
-  if (currentFeeds_.size() >= REPLY_MAX_COUNT) {
-    getUrlTimer_->start();
+  if (dispatchPending_)
     return;
-  }
 
-  if (!urlsQueue_.isEmpty()) {
-    getUrlTimer_->start();
+  dispatchPending_ = true;
+  QMetaObject::invokeMethod(this, "getQueuedUrl", Qt::QueuedConnection);
+}
 
-    QString feedUrl = feedsQueue_.head();
+/** @brief Process request queue while free slots remain
+ *
+ * Queue is processed again when request is finished, so busy slots and
+ * sites are not polled.
+ *----------------------------------------------------------------------------*/
+void FaviconObject::getQueuedUrl()
+{
+  dispatchPending_ = false;
+  int queuedCount = urlsQueue_.count();
 
-    if (hostList_.contains(QUrl(feedUrl).host())) {
-      foreach (QString url, currentFeeds_) {
-        if (QUrl(url).host() == QUrl(feedUrl).host()) {
-          return;
+  while (!urlsQueue_.isEmpty() &&
+         (currentFeeds_.size() + pendingGets_.size() < REPLY_MAX_COUNT)) {
+    // Take first request which site is not requested now, so feeds
+    // of the same site get icon from cache after first of them
+    int index = -1;
+    QUrl url;
+    for (int i = 0; i < urlsQueue_.count(); ++i) {
+      const QString &feedUrl = feedsQueue_.at(i);
+      url = siteUrl(urlsQueue_.at(i), feedUrl);
+      if (isHostRequested(url.host()))
+        continue;
+
+      bool hostBusy = false;
+      if (hostList_.contains(QUrl(feedUrl).host())) {
+        foreach (QString currentUrl, currentFeeds_) {
+          if (QUrl(currentUrl).host() == QUrl(feedUrl).host()) {
+            hostBusy = true;
+            break;
+          }
         }
       }
+      if (!hostBusy) {
+        index = i;
+        break;
+      }
     }
+    if (index < 0)
+      break;
 
-    QString urlString = urlsQueue_.dequeue();
-    feedUrl = feedsQueue_.dequeue();
+    urlsQueue_.removeAt(index);
+    QString feedUrl = feedsQueue_.takeAt(index);
+    feedHosts_.insert(feedUrl, url.host());
 
-    QUrl url = QUrl::fromEncoded(urlString.toUtf8());
-    url.setUrl(QString("%1://%2").arg(url.scheme()).arg(url.host()));
-    if (!url.isValid()) {
-      url = QUrl::fromEncoded(feedUrl.toUtf8());
-      url.setUrl(QString("%1://%2").arg(url.scheme()).arg(url.host()));
+    QHash<QString, CachedIcon>::const_iterator it = iconCache_.constFind(url.host());
+    if (it != iconCache_.constEnd()) {
+      if (it->expires > QDateTime::currentDateTimeUtc()) {
+        iconReceived(feedUrl, it->data, it->format);
+        continue;
+      }
+      if (!it->iconUrl.isEmpty()) {
+        // Revalidate stale icon with conditional request
+        emit signalGet(QUrl(it->iconUrl), feedUrl, 1);
+        continue;
+      }
     }
-    emit signalGet(url, feedUrl, 0);
+
+    probeSites_.insert(feedUrl, url);
+    emit signalGet(QUrl(QString("%1://%2/favicon.ico").arg(url.scheme()).arg(url.host())),
+                   feedUrl, StageFavicon);
   }
+
+  PipelineMetrics::recordWakeup(PipelineMetrics::WakeIconQueue,
+                                urlsQueue_.count() == queuedCount);
 }
 
-/** @brief Prepare and send network request to receive all data
+/** @brief Check if request for icon of site is in progress
+ *----------------------------------------------------------------------------*/
+bool FaviconObject::isHostRequested(const QString &host) const
+{
+  foreach (const QString &feedUrl, currentFeeds_) {
+    if (feedHosts_.value(feedUrl) == host)
+      return true;
+  }
+  foreach (const PendingGet &get, pendingGets_) {
+    if (feedHosts_.value(get.feedUrl) == host)
+      return true;
+  }
+  return false;
+}
+
+/** @brief Queue network request in icon lane of feeds scheduler
+ *
+ * Request is sent when scheduler gives slot, so icons wait for feeds and
+ * follow limits of their hosts.
  *----------------------------------------------------------------------------*/
 void FaviconObject::slotGet(const QUrl &getUrl, const QString &feedUrl, const int &cnt)
 {
+  PendingGet get;
+  get.url = getUrl;
+  get.feedUrl = feedUrl;
+  get.cnt = cnt;
+
+  // Tokens are negative in scheduler
+  if (--lastToken_ >= 0)
+    lastToken_ = -1;
+  pendingGets_.insert(lastToken_, get);
+  emit signalRequestSlot(lastToken_, getUrl.host());
+}
+
+void FaviconObject::slotIconSlot(int token)
+{
+  QHash<int, PendingGet>::iterator it = pendingGets_.find(token);
+  if (it == pendingGets_.end()) {
+    emit signalReleaseSlot(token);
+    return;
+  }
+  PendingGet get = it.value();
+  pendingGets_.erase(it);
+  startGet(get, token);
+}
+
+/** @brief Prepare and send network request to receive all data
+ *----------------------------------------------------------------------------*/
+void FaviconObject::startGet(const PendingGet &get, int token)
+{
+  const QUrl &getUrl = get.url;
+  const QString &feedUrl = get.feedUrl;
+  int cnt = get.cnt;
+
   QNetworkRequest request(getUrl);
   QString userAgent = QString("Mozilla/5.0 (Windows NT 6.1) AppleWebKit/%1 (KHTML, like Gecko) Chrome/77.0.3865.120 Safari/%1").
       arg(qWebKitVersion());
   request.setRawHeader("User-Agent", userAgent.toUtf8());
 
+  QHash<QString, CachedIcon>::const_iterator it = iconCache_.constFind(feedHosts_.value(feedUrl));
+  if ((it != iconCache_.constEnd()) && (it->iconUrl == getUrl.toString())) {
+    // Icon is revalidated with own validators, reply must not be replaced by cache
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+    if (!it->etag.isEmpty())
+      request.setRawHeader("If-None-Match", it->etag.toLatin1());
+    if (it->lastModified.isValid()) {
+      QString modifiedSince = QLocale::c().toString(it->lastModified, "ddd, dd MMM yyyy HH:mm:ss 'GMT'");
+      request.setRawHeader("If-Modified-Since", modifiedSince.toLatin1());
+    }
+  }
+
   currentUrls_.append(getUrl);
   currentFeeds_.append(feedUrl);
   currentCntRequests_.append(cnt);
-  currentTime_.append(REQUEST_TIMEOUT);
+  currentDeadlines_.append(clock_.elapsed() + REQUEST_TIMEOUT);
+  if (!timeout_->isActive())
+    timeout_->start();
 
   QNetworkReply *reply = networkManager_->get(request);
   reply->setProperty("feedReply", QVariant(true));
+  reply->setProperty("slotToken", token);
+  connect(reply, SIGNAL(metaDataChanged()), this, SLOT(slotReplyProgress()));
+  connect(reply, SIGNAL(downloadProgress(qint64,qint64)), this, SLOT(slotReplyProgress()));
+  if ((cnt == StagePage) || (cnt == StagePageRetry))
+    connect(reply, SIGNAL(readyRead()), this, SLOT(slotPageDataRead()));
   requestUrl_.append(reply->url());
   networkReply_.append(reply);
 }
 
+/** @brief Move deadline of request which received headers or data
+ *----------------------------------------------------------------------------*/
+void FaviconObject::slotReplyProgress()
+{
+  QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+  if (!reply) return;
+
+  int index = currentUrls_.indexOf(reply->url());
+  if (index >= 0)
+    currentDeadlines_.replace(index, clock_.elapsed() + REQUEST_TIMEOUT);
+}
+
+/** @brief Stop reading page when its head is received
+ *
+ * Icon links are searched only in head, rest of page is not downloaded.
+ *----------------------------------------------------------------------------*/
+void FaviconObject::slotPageDataRead()
+{
+  QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+  if (!reply || (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() != 200))
+    return;
+
+  const QByteArray data = reply->peek(reply->bytesAvailable()).toLower();
+  if ((data.size() < PAGE_HEAD_MAX_SIZE) &&
+      (data.indexOf("</head") == -1) && (data.indexOf("<body") == -1))
+    return;
+
+  disconnect(reply, SIGNAL(readyRead()), this, SLOT(slotPageDataRead()));
+  reply->setProperty("pageHead", reply->readAll());
+  reply->abort();
+}
+
+/** @brief Finish request for /favicon.ico or icon service
+ *
+ * Next stage is tried when reply is not an image: icon service if it is
+ * set, then links in head of site page.
+ *----------------------------------------------------------------------------*/
+void FaviconObject::finishedProbe(QNetworkReply *reply, const QUrl &url,
+                                  const QString &feedUrl, int stage)
+{
+  if ((reply->error() == QNetworkReply::NoError) || (reply->error() == QNetworkReply::UnknownContentError)) {
+    QUrl redirectionTarget = reply->attribute(QNetworkRequest::RedirectionTargetAttribute).toUrl();
+    if (redirectionTarget.isValid()) {
+      if (stage == StageFavicon) {
+        emit signalGet(url.resolved(redirectionTarget), feedUrl, StageFaviconRedirected);
+        return;
+      }
+    } else {
+      QByteArray data = reply->readAll();
+      QFileInfo info(url.path());
+      if (!data.isEmpty() && !preparedIcon(data, info.suffix()).isEmpty()) {
+        probeSites_.remove(feedUrl);
+        cacheIcon(feedUrl, url, reply, data, info.suffix());
+        iconReceived(feedUrl, data, info.suffix());
+        return;
+      }
+    }
+  }
+
+  const QUrl site = probeSites_.value(feedUrl);
+  if ((stage != StageIconService) && !iconService_.isEmpty()) {
+    emit signalGet(QUrl(iconService_.arg(site.host())), feedUrl, StageIconService);
+    return;
+  }
+
+  probeSites_.remove(feedUrl);
+  probedFeeds_.insert(feedUrl);
+  emit signalGet(site, feedUrl, StagePage);
+}
+
 /** @brief Finish network request processing
  *----------------------------------------------------------------------------*/
 void FaviconObject::finished(QNetworkReply *reply)
 {
   int currentReplyIndex = currentUrls_.indexOf(reply->url());
   if (currentReplyIndex >= 0) {
-    currentTime_.removeAt(currentReplyIndex);
+    currentDeadlines_.removeAt(currentReplyIndex);
     QUrl url = currentUrls_.takeAt(currentReplyIndex);
     QString feedUrl = currentFeeds_.takeAt(currentReplyIndex);
     int cntRequests = currentCntRequests_.takeAt(currentReplyIndex);
+    // Page aborted after its head was read
+    QByteArray pageHead = reply->property("pageHead").toByteArray();
 
-    if ((reply->error() == QNetworkReply::NoError) || (reply->error() == QNetworkReply::UnknownContentError)) {
+    if (cntRequests >= StageFavicon) {
+      finishedProbe(reply, url, feedUrl, cntRequests);
+    } else if ((reply->error() == QNetworkReply::NoError) ||
+               (reply->error() == QNetworkReply::UnknownContentError) || !pageHead.isNull()) {
+      int httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
       QUrl redirectionTarget = reply->attribute(QNetworkRequest::RedirectionTargetAttribute).toUrl();
-      if (redirectionTarget.isValid()) {
+      QHash<QString, CachedIcon>::iterator cachedIcon = iconCache_.find(feedHosts_.value(feedUrl));
+      if ((httpStatus == 304) && (cachedIcon != iconCache_.end())) {
+        // Cached icon is not modified
+        cachedIcon->expires = iconExpires(reply);
+        iconCacheChanged_ = true;
+        saveCacheTimer_->start();
+        iconReceived(feedUrl, cachedIcon->data, cachedIcon->format);
+      } else if (redirectionTarget.isValid()) {
         if ((cntRequests == 0) || (cntRequests == 1) || (cntRequests == 3)) {
           if (redirectionTarget.host().isNull()) {
             if (redirectionTarget.toString().left(1) == "/")
@@ -152,7 +415,9 @@ void FaviconObject::finished(QNetworkReply *reply)
           emit signalGet(redirectionTarget, feedUrl, cntRequests+2);
         }
       } else {
-        QByteArray data = reply->readAll();
+        QByteArray data = pageHead.isNull() ? reply->readAll() : pageHead;
+        // /favicon.ico is not requested again after page
+        bool probed = (cntRequests == 0 || cntRequests == 2) && probedFeeds_.remove(feedUrl);
         if (!data.isNull()) {
           if ((cntRequests == 0) || (cntRequests == 2)) {
             QString linkFavicon;
@@ -189,18 +454,18 @@ void FaviconObject::finished(QNetworkReply *reply)
                 }
               }
             }
-            if (linkFavicon.isEmpty()) {
+            if (linkFavicon.isEmpty() && !probed) {
               if ((cntRequests == 0) || (cntRequests == 2)) {
                 QString link = QString("%1://%2/favicon.ico").arg(url.scheme()).arg(url.host());
                 emit signalGet(link, feedUrl, cntRequests+1);
               }
             }
           } else {
-            // Emit receiced data in main thread
             QFileInfo info(url.path());
-            emit signalIconRecived(feedUrl, data, info.suffix());
+            cacheIcon(feedUrl, url, reply, data, info.suffix());
+            iconReceived(feedUrl, data, info.suffix());
           }
-        } else {
+        } else if (!probed) {
           if ((cntRequests == 0) || (cntRequests == 2)) {
             QString link = QString("%1://%2/favicon.ico").arg(url.scheme()).arg(url.host());
             emit signalGet(link, feedUrl, cntRequests+1);
@@ -229,34 +494,205 @@ void FaviconObject::finished(QNetworkReply *reply)
     requestUrl_.removeAt(replyIndex);
     networkReply_.removeAt(replyIndex);
   }
+  releaseSlot(reply);
   reply->abort();
   reply->deleteLater();
 }
 
+/** @brief Give slot of \a reply back to feeds scheduler
+ *
+ * Requests waiting for free slot or for site of this request are
+ * processed then.
+ *----------------------------------------------------------------------------*/
+void FaviconObject::releaseSlot(QNetworkReply *reply)
+{
+  if (!urlsQueue_.isEmpty())
+    scheduleQueuedUrl();
+
+  QVariant token = reply->property("slotToken");
+  if (!token.isValid())
+    return;
+  reply->setProperty("slotToken", QVariant());
+  emit signalReleaseSlot(token.toInt());
+}
+
 /** @brief Timeout to delete requests without answer from server
  *----------------------------------------------------------------------------*/
 void FaviconObject::slotRequestTimeout()
 {
-  for (int i = currentTime_.count() - 1; i >= 0; i--) {
-    int time = currentTime_.at(i) - 1;
-    if (time <= 0) {
+  // Timer is started again by startGet()
+  if (currentDeadlines_.isEmpty()) {
+    timeout_->stop();
+    PipelineMetrics::recordWakeup(PipelineMetrics::WakeIconTimeout, true);
+    return;
+  }
+
+  int activeCount = currentDeadlines_.count();
+  qint64 now = clock_.elapsed();
+  for (int i = currentDeadlines_.count() - 1; i >= 0; i--) {
+    if (now >= currentDeadlines_.at(i)) {
       QUrl url = currentUrls_.takeAt(i);
       QString feedUrl = currentFeeds_.takeAt(i);
       int cntRequests = currentCntRequests_.takeAt(i);
-      currentTime_.removeAt(i);
+      currentDeadlines_.removeAt(i);
 
       int replyIndex = requestUrl_.indexOf(url);
       if (replyIndex >= 0) {
         requestUrl_.removeAt(replyIndex);
         QNetworkReply *reply = networkReply_.takeAt(replyIndex);
+        releaseSlot(reply);
         reply->deleteLater();
 
-        if (cntRequests == 0) {
+        if (cntRequests >= StageFavicon) {
+          probedFeeds_.insert(feedUrl);
+          emit signalGet(probeSites_.take(feedUrl), feedUrl, StagePage);
+        } else if (cntRequests == 0) {
           emit signalGet(url, feedUrl, 2);
+        } else {
+          probedFeeds_.remove(feedUrl);
         }
       }
-    } else {
-      currentTime_.replace(i, time);
     }
   }
+
+  PipelineMetrics::recordWakeup(PipelineMetrics::WakeIconTimeout,
+                                currentDeadlines_.count() == activeCount);
+}
+
+/** @brief Remember received icon for all feeds of site
+ *----------------------------------------------------------------------------*/
+void FaviconObject::cacheIcon(const QString &feedUrl, const QUrl &url, QNetworkReply *reply,
+                              const QByteArray &data, const QString &format)
+{
+  const QString host = feedHosts_.value(feedUrl);
+  if (host.isEmpty())
+    return;
+
+  // Don't keep error pages instead of icons
+  if (preparedIcon(data, format).isEmpty())
+    return;
+
+  CachedIcon icon;
+  icon.iconUrl = url.toString();
+  icon.data = data;
+  icon.format = format;
+  icon.etag = QString::fromLatin1(reply->rawHeader("ETag"));
+  QDateTime lastModified = reply->header(QNetworkRequest::LastModifiedHeader).toDateTime();
+  if (lastModified.isValid())
+    icon.lastModified = lastModified.toUTC();
+  icon.expires = iconExpires(reply);
+
+  iconCache_.insert(host, icon);
+  iconCacheChanged_ = true;
+  saveCacheTimer_->start();
+}
+
+/** @brief Icon of feed made from \a data of site icon
+ *
+ * Feeds of one site get the same data, it is decoded once.
+ *----------------------------------------------------------------------------*/
+QByteArray FaviconObject::preparedIcon(const QByteArray &data, const QString &format)
+{
+  QByteArray *faviconData = preparedIcons_.object(data);
+  if (faviconData)
+    return *faviconData;
+
+  QByteArray result = decodeIcon(data, format);
+  preparedIcons_.insert(data, new QByteArray(result));
+  return result;
+}
+
+/** @brief Send icon of feed to be stored, if \a data is an image
+ *----------------------------------------------------------------------------*/
+void FaviconObject::iconReceived(const QString &feedUrl, const QByteArray &data,
+                                 const QString &format)
+{
+  QByteArray faviconData = preparedIcon(data, format);
+  if (!faviconData.isEmpty())
+    emit signalIconReady(feedUrl, faviconData);
+}
+
+/** @brief Get time until icon can be used without revalidation
+ *----------------------------------------------------------------------------*/
+QDateTime FaviconObject::iconExpires(QNetworkReply *reply) const
+{
+  int age = ICON_DEFAULT_AGE;
+
+  QzRegExp rx("max-age=(\\d+)", Qt::CaseInsensitive);
+  if (rx.indexIn(QString::fromLatin1(reply->rawHeader("Cache-Control"))) > -1) {
+    age = rx.cap(1).toInt();
+  } else if (reply->hasRawHeader("Expires")) {
+    QString expiresStr = QString::fromLatin1(reply->rawHeader("Expires"));
+    QDateTime expires = QLocale::c().toDateTime(expiresStr, "ddd, dd MMM yyyy HH:mm:ss 'GMT'");
+    if (expires.isValid()) {
+      expires.setTimeSpec(Qt::UTC);
+      age = QDateTime::currentDateTimeUtc().secsTo(expires);
+    }
+  }
+
+  age = qBound(ICON_MIN_AGE, age, ICON_MAX_AGE);
+  return QDateTime::currentDateTimeUtc().addSecs(age);
+}
+
+/** @brief Load cached icons of sites
+ *----------------------------------------------------------------------------*/
+void FaviconObject::loadIconCache()
+{
+  QFile file(mainApp->dataDir() + "/" + ICON_CACHE_FILE);
+  if (!file.open(QFile::ReadOnly))
+    return;
+
+  QDataStream stream(&file);
+  stream.setVersion(QDataStream::Qt_4_6);
+
+  quint32 magic;
+  quint32 version;
+  qint32 count;
+  stream >> magic >> version >> count;
+  if ((stream.status() != QDataStream::Ok) || (magic != ICON_CACHE_MAGIC) ||
+      (version != ICON_CACHE_VERSION)) {
+    return;
+  }
+
+  for (int i = 0; i < count; ++i) {
+    QString host;
+    CachedIcon icon;
+    stream >> host >> icon.iconUrl >> icon.data >> icon.format >> icon.etag
+           >> icon.lastModified >> icon.expires;
+    if (stream.status() != QDataStream::Ok) {
+      qWarning() << "Invalid icon cache file" << file.fileName();
+      iconCache_.clear();
+      return;
+    }
+    icon.lastModified.setTimeSpec(Qt::UTC);
+    icon.expires.setTimeSpec(Qt::UTC);
+    iconCache_.insert(host, icon);
+  }
+}
+
+/** @brief Write cached icons of sites to file
+ *----------------------------------------------------------------------------*/
+void FaviconObject::saveIconCache()
+{
+  if (!iconCacheChanged_)
+    return;
+
+  QFile file(mainApp->dataDir() + "/" + ICON_CACHE_FILE);
+  if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+    qWarning() << "Unable to write icon cache file" << file.fileName();
+    return;
+  }
+
+  QDataStream stream(&file);
+  stream.setVersion(QDataStream::Qt_4_6);
+  stream << quint32(ICON_CACHE_MAGIC) << quint32(ICON_CACHE_VERSION)
+         << qint32(iconCache_.count());
+
+  QHash<QString, CachedIcon>::const_iterator it = iconCache_.constBegin();
+  for (; it != iconCache_.constEnd(); ++it) {
+    stream << it.key() << it->iconUrl << it->data << it->format << it->etag
+           << it->lastModified << it->expires;
+  }
+
+  iconCacheChanged_ = false;
 }
@@ -18,9 +18,13 @@
 #ifndef FAVICONOBJECT_H
 #define FAVICONOBJECT_H
 
+#include <QCache>
 #include <QDateTime>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QObject>
 #include <QQueue>
+#include <QSet>
 #include <QNetworkReply>
 #include <QTimer>
 
@@ -32,39 +36,103 @@ class FaviconObject : public QObject
 
 public:
   explicit FaviconObject(QObject *parent = 0);
+  ~FaviconObject();
 
   void disconnectObjects();
 
 public slots:
   void requestUrl(QString urlString, QString feedUrl);
   void slotGet(const QUrl &getUrl, const QString &feedUrl, const int &cnt);
+  void slotIconSlot(int token);
 
 signals:
   void startTimer();
   void signalGet(const QUrl &getUrl, const QString &feedUrl, const int &cnt);
-  void signalIconRecived(QString feedUrl, QByteArray byteArray, QString format);
+  void signalIconReady(QString feedUrl, QByteArray faviconData);
+  void signalRequestSlot(int token, QString host);
+  void signalReleaseSlot(int token);
 
 private slots:
   void getQueuedUrl();
   void finished(QNetworkReply *reply);
   void slotRequestTimeout();
+  void saveIconCache();
+  void slotPageDataRead();
+  void slotReplyProgress();
 
 private:
+  // Stages of icon discovery, passed as cnt of request. Pages are read
+  // only when /favicon.ico and icon service give no icon.
+  enum DiscoveryStage {
+    StagePage = 0,
+    StagePageIcon = 1,
+    StagePageRetry = 2,
+    StagePageRetryIcon = 3,
+    StageFavicon = 4,
+    StageFaviconRedirected = 5,
+    StageIconService = 6
+  };
+
+  // Request waiting for slot of feeds scheduler
+  struct PendingGet {
+    QUrl url;
+    QString feedUrl;
+    int cnt;
+  };
+
+  // Icon of site shared by all its feeds
+  struct CachedIcon {
+    QString iconUrl;
+    QByteArray data;
+    QString format;
+    QString etag;
+    QDateTime lastModified;
+    QDateTime expires;
+  };
+
+  void scheduleQueuedUrl();
+  bool isHostRequested(const QString &host) const;
+  void startGet(const PendingGet &get, int token);
+  void releaseSlot(QNetworkReply *reply);
+  void loadIconCache();
+  void cacheIcon(const QString &feedUrl, const QUrl &url, QNetworkReply *reply,
+                 const QByteArray &data, const QString &format);
+  QByteArray preparedIcon(const QByteArray &data, const QString &format);
+  void iconReceived(const QString &feedUrl, const QByteArray &data,
+                    const QString &format);
+  QDateTime iconExpires(QNetworkReply *reply) const;
+  void finishedProbe(QNetworkReply *reply, const QUrl &url, const QString &feedUrl,
+                     int stage);
+
   NetworkManager *networkManager_;
 
   QQueue<QString> urlsQueue_;
   QQueue<QString> feedsQueue_;
 
   QTimer *timeout_;
-  QTimer *getUrlTimer_;
+  bool dispatchPending_;
   QList<QUrl> currentUrls_;
   QList<QString> currentFeeds_;
   QList<int> currentCntRequests_;
-  QList<int> currentTime_;
+  // Request is aborted when deadline passes, headers and data move it
+  QList<qint64> currentDeadlines_;
+  QElapsedTimer clock_;
   QList<QUrl> requestUrl_;
   QList<QNetworkReply*> networkReply_;
   QList<QString> hostList_;
 
+  QHash<int, PendingGet> pendingGets_;
+  int lastToken_;
+
+  QHash<QString, CachedIcon> iconCache_;
+  QHash<QString, QString> feedHosts_;
+  QHash<QString, QUrl> probeSites_;
+  QSet<QString> probedFeeds_;
+  QString iconService_;
+  QTimer *saveCacheTimer_;
+  bool iconCacheChanged_;
+  QCache<QByteArray, QByteArray> preparedIcons_;
+
 };
 
 #endif // FAVICONOBJECT_H
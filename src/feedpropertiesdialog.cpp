@@ -114,9 +114,14 @@ QWidget *FeedPropertiesDialog::createGeneralTab()
   connect(disableUpdate_, SIGNAL(toggled(bool)),
           updateIntervalType_, SLOT(setDisabled(bool)));
 
+  costDemotion_ = new QCheckBox(tr("Update less often when update is expensive for its new news"));
+  connect(disableUpdate_, SIGNAL(toggled(bool)),
+          costDemotion_, SLOT(setDisabled(bool)));
+
   starredOn_ = new QCheckBox(tr("Starred"));
   displayOnStartup = new QCheckBox(tr("Display in new tab on startup"));
   duplicateNewsMode_ = new QCheckBox(tr("Automatically delete duplicate news"));
+  downloadEnclosures_ = new QCheckBox(tr("Automatically download enclosures of new news"));
 
   QHBoxLayout *layoutGeneralHomepage = new QHBoxLayout();
   labelHomepage = new QLabel();
@@ -155,10 +160,12 @@ QWidget *FeedPropertiesDialog::createGeneralTab()
   tabLayout->addSpacing(15);
   tabLayout->addWidget(disableUpdate_);
   tabLayout->addLayout(updateFeedsLayout);
+  tabLayout->addWidget(costDemotion_);
   tabLayout->addSpacing(15);
   tabLayout->addWidget(starredOn_);
   tabLayout->addWidget(displayOnStartup);
   tabLayout->addWidget(duplicateNewsMode_);
+  tabLayout->addWidget(downloadEnclosures_);
   tabLayout->addSpacing(15);
   tabLayout->addWidget(addSingleNewsAnyDateOn_);
   tabLayout->addWidget(avoidedOldSingleNewsDateOn_);
@@ -186,6 +193,8 @@ QWidget *FeedPropertiesDialog::createGeneralTab()
     labelHomepage->hide();
     starredOn_->hide();
     duplicateNewsMode_->hide();
+    downloadEnclosures_->hide();
+    costDemotion_->hide();
     addSingleNewsAnyDateOn_->hide();
     avoidedOldSingleNewsDateOn_->hide();
     avoidedOldSingleNewsDate_->hide();
@@ -400,10 +409,12 @@ QWidget *FeedPropertiesDialog::createStatusTab()
   updateInterval_->setValue(feedProperties.general.updateInterval);
   updateIntervalType_->setCurrentIndex(feedProperties.general.intervalType + 1);
   disableUpdate_->setChecked(feedProperties.general.disableUpdate);
+  costDemotion_->setChecked(feedProperties.general.costDemotion);
 
   displayOnStartup->setChecked(feedProperties.general.displayOnStartup);
   starredOn_->setChecked(feedProperties.general.starred);
   duplicateNewsMode_->setChecked(feedProperties.general.duplicateNewsMode);
+  downloadEnclosures_->setChecked(feedProperties.general.downloadEnclosures);
 
   addSingleNewsAnyDateOn_->setChecked(feedProperties.general.addSingleNewsAnyDateOn);
   avoidedOldSingleNewsDateOn_->setChecked(feedProperties.general.avoidedOldSingleNewsDateOn);
@@ -459,7 +470,10 @@ QWidget *FeedPropertiesDialog::createStatusTab()
                       arg(tr("new")).
                       arg(feedProperties.status.unreadCount).
                       arg(tr("unread")));
-  feedsCount_->setText(QString("%1").arg(feedProperties.status.feedsCount));
+  if (feedProperties.status.feedsCount < 0)
+    feedsCount_->setText("...");
+  else
+    feedsCount_->setText(QString("%1").arg(feedProperties.status.feedsCount));
 }
 //------------------------------------------------------------------------------
 void FeedPropertiesDialog::setDefaultTitle()
@@ -540,6 +554,7 @@ FEED_PROPERTIES FeedPropertiesDialog::getFeedProperties()
   feedProperties.general.updateEnable = updateEnable_->isChecked();
   feedProperties.general.updateInterval = updateInterval_->value();
   feedProperties.general.intervalType = updateIntervalType_->currentIndex() - 1;
+  feedProperties.general.costDemotion = costDemotion_->isChecked();
 
   feedProperties.general.displayOnStartup = displayOnStartup->isChecked();
   feedProperties.general.starred = starredOn_->isChecked();
@@ -547,6 +562,7 @@ FEED_PROPERTIES FeedPropertiesDialog::getFeedProperties()
   feedProperties.display.javaScriptEnable = javaScriptEnable_->checkState();
   feedProperties.display.displayNews = !showDescriptionNews_->isChecked();
   feedProperties.general.duplicateNewsMode = duplicateNewsMode_->isChecked();
+  feedProperties.general.downloadEnclosures = downloadEnclosures_->isChecked();
   feedProperties.display.layoutDirection = layoutDirection_->isChecked();
   feedProperties.general.addSingleNewsAnyDateOn = addSingleNewsAnyDateOn_->isChecked();
   feedProperties.general.avoidedOldSingleNewsDateOn = avoidedOldSingleNewsDateOn_->isChecked();
@@ -576,6 +592,15 @@ void FeedPropertiesDialog::setFeedProperties(FEED_PROPERTIES properties)
 {
   feedProperties = properties;
 }
+/** @brief Show number of feeds of folder counted in update thread
+ *----------------------------------------------------------------------------*/
+void FeedPropertiesDialog::slotFeedsCount(int folderId, int count)
+{
+  if (folderId != feedProperties.status.feedId) return;
+
+  feedProperties.status.feedsCount = count;
+  feedsCount_->setText(QString("%1").arg(count));
+}
 //------------------------------------------------------------------------------
 void FeedPropertiesDialog::slotCurrentColumnChanged(QTreeWidgetItem *current,
                                                     QTreeWidgetItem *)
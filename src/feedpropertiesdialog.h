@@ -39,8 +39,10 @@ typedef struct {
     int displayOnStartup; //!< Flag to display feed on startup in sepatare tab
     bool starred; //!< Starred feed (favourite)
     bool duplicateNewsMode; //!< Automatically delete news duplicates
+    bool downloadEnclosures; //!< Download enclosures of new news
     bool avoidedOldSingleNewsDateOn; //!< Avoid adding news before this date into the database
     bool addSingleNewsAnyDateOn; //!< Add news with any date into the database
+    bool costDemotion; //!< Feed may be updated less often when its update is expensive
     QDate avoidedOldSingleNewsDate; //!< Date to avoid
   } general;
 
@@ -112,7 +114,8 @@ typedef struct {
     int undeleteCount; //!< Number of all news
     int newCount; //!< Number of new news
     int unreadCount; //!< Number of unread news
-    int feedsCount; //!< Number of feeds
+    int feedsCount; //!< Number of feeds, -1 until counted
+    int feedId; //!< Id of feed or folder
   } status;
 
 } FEED_PROPERTIES;
@@ -129,6 +132,7 @@ public:
 
 public slots:
   void slotFaviconUpdate(const QString &feedUrl, const QByteArray &faviconData);
+  void slotFeedsCount(int folderId, int count);
 
 signals:
   void signalLoadIcon(const QString &urlString, const QString &feedUrl);
@@ -164,6 +168,8 @@ private:
   QCheckBox *displayOnStartup;
   QCheckBox *starredOn_;
   QCheckBox *duplicateNewsMode_;
+  QCheckBox *downloadEnclosures_;
+  QCheckBox *costDemotion_;
   QCheckBox *addSingleNewsAnyDateOn_;
   QGroupBox *avoidedOldSingleNewsDateOn_;
   QCalendarWidget *avoidedOldSingleNewsDate_;
@@ -17,38 +17,56 @@
 * ============================================================ */
 #include "feedsmodel.h"
 #include "feedsproxymodel.h"
+#include "memoryaccounting.h"
 
 #include <QtCore>
 #include <QPainter>
+#include <QPixmapCache>
+#include <QStyle>
+#include <QSqlQuery>
+
+// Count of feeds added to tree in one pass of progressive loading
+#define FEEDS_LOAD_BATCH 200
 
 FeedsModel::FeedsModel(QObject *parent)
   : QAbstractItemModel(parent)
   , defaultIconFeeds_(false)
   , view_(0)
   , rootParentId_(0)
+  , columnCount_(0)
 {
   setObjectName("FeedsModel");
 
-  refresh();
+  connect(&loadTimer_, SIGNAL(timeout()), this, SLOT(loadPendingFeeds()));
+
+  // Tree is shown with top level items, others are added by event loop
+  refresh(true);
 }
 
 FeedsModel::~FeedsModel()
 {
   clear();
+  MemoryAccounting::remove(this);
 }
 
 void FeedsModel::clear()
 {
-  id2RowList_.clear();
-  parid2RowList_.clear();
+  childrenList_.clear();
   columnsList_.clear();
+  columnNames_.clear();
 
   qDeleteAll(userDataList_);
   userDataList_.clear();
 }
 
-void FeedsModel::refresh()
+/** @brief Load feeds and folders from DB
+ * @param progressive Load top level items only, add others from event loop
+ *---------------------------------------------------------------------------*/
+void FeedsModel::refresh(bool progressive)
 {
+  loadTimer_.stop();
+  pendingFolders_.clear();
+
 #ifdef HAVE_QT5
   beginResetModel();
   clear();
@@ -58,71 +76,412 @@ void FeedsModel::refresh()
   clear();
 #endif
 
-  queryModel_.setQuery("SELECT * FROM feeds ORDER BY parentId, rowToParent");
+  if (progressive) {
+    queryModel_.setQuery(QString("%1 WHERE parentId=%2 ORDER BY rowToParent").
+                         arg(selectFeeds()).arg(rootParentId_));
+  } else {
+    queryModel_.setQuery(selectFeeds() + " ORDER BY parentId, rowToParent");
+  }
   while (queryModel_.canFetchMore())
     queryModel_.fetchMore();
 
-  indexId_ = queryModel_.record().indexOf("id");
-  indexParid_ = queryModel_.record().indexOf("parentId");
-  for (int i = 0; i < queryModel_.record().count(); i++) {
+  QSqlRecord fieldsRecord = queryModel_.record();
+  columnCount_ = fieldsRecord.count();
+  for (int i = 0; i < columnCount_; i++) {
+    columnNames_[fieldsRecord.fieldName(i)] = i;
+  }
+  indexId_ = fieldsRecord.indexOf("id");
+  indexParid_ = fieldsRecord.indexOf("parentId");
+  indexRowToParent_ = fieldsRecord.indexOf("rowToParent");
+  indexText_ = fieldsRecord.indexOf("text");
+  indexXmlUrl_ = fieldsRecord.indexOf("xmlUrl");
+  indexUnread_ = fieldsRecord.indexOf("unread");
+  indexNewCount_ = fieldsRecord.indexOf("newCount");
+  indexUndeleteCount_ = fieldsRecord.indexOf("undeleteCount");
+  indexStatus_ = fieldsRecord.indexOf("status");
+  indexDisableUpdate_ = fieldsRecord.indexOf("disableUpdate");
+  indexUpdated_ = fieldsRecord.indexOf("updated");
+  indexImage_ = fieldsRecord.indexOf("image");
+  for (int i = 0; i < columnCount_; i++) {
     columnsList_[i] = i;
   }
-  columnsList_[0] = queryModel_.record().indexOf("text");
-  columnsList_[queryModel_.record().indexOf("text")] = 0;
+  columnsList_[0] = indexText_;
+  columnsList_[indexText_] = 0;
+  columnId_ = indexColumnOf(indexId_);
+  columnText_ = indexColumnOf(indexText_);
+  columnUnread_ = indexColumnOf(indexUnread_);
+  columnUndeleteCount_ = indexColumnOf(indexUndeleteCount_);
+  columnUpdated_ = indexColumnOf(indexUpdated_);
 
   for (int i = 0; i < queryModel_.rowCount(); i++) {
-    int id = queryModel_.record(i).value(indexId_).toInt();
-    id2RowList_[id] = i;
-    int parid = queryModel_.record(i).value(indexParid_).toInt();
-    parid2RowList_[i] = parid;
-    userDataList_[id] = new UserData(id, parid, queryModel_.record(i));
+    QSqlRecord record = queryModel_.record(i);
+    int id = record.value(indexId_).toInt();
+    int parid = record.value(indexParid_).toInt();
+    UserData *userData = new UserData(id, parid, record);
+    updateUserData(userData);
+    userDataList_[id] = userData;
+
+    QVector<UserData*> &children = childrenList_[parid];
+    userData->row = children.count();
+    children.append(userData);
+
+    if (progressive && userData->folder)
+      pendingFolders_.enqueue(id);
   }
+
+  if (!pendingFolders_.isEmpty())
+    loadTimer_.start(0);
 }
 
-UserData * FeedsModel::userDataById(int id) const
+/** @brief Add next part of feeds not loaded by progressive refresh()
+ *
+ *  Children are requested with offset of already loaded ones, so counters
+ *  are actual at insertion and feeds added by insertNewFeeds() are skipped
+ *---------------------------------------------------------------------------*/
+void FeedsModel::loadPendingFeeds()
 {
-  return userDataList_.value(id, 0);
+  QSqlQuery q;
+  q.prepare(selectFeeds() + " WHERE parentId=? ORDER BY rowToParent LIMIT ? OFFSET ?");
+
+  int count = 0;
+  while (!pendingFolders_.isEmpty() && (count < FEEDS_LOAD_BATCH)) {
+    int parid = pendingFolders_.head();
+    // Could be removed while loading
+    if (!userDataById(parid)) {
+      pendingFolders_.dequeue();
+      continue;
+    }
+
+    QVector<UserData*> &children = childrenList_[parid];
+    int limit = FEEDS_LOAD_BATCH - count;
+    q.addBindValue(parid);
+    q.addBindValue(limit);
+    q.addBindValue(children.count());
+    q.exec();
+
+    QList<UserData*> userDataList;
+    int rows = 0;
+    while (q.next()) {
+      ++rows;
+      QSqlRecord record = q.record();
+      int id = record.value(indexId_).toInt();
+      if (userDataList_.contains(id)) continue;
+
+      UserData *userData = new UserData(id, parid, record);
+      updateUserData(userData);
+      userDataList.append(userData);
+    }
+    q.finish();
+
+    // Nothing new means order of children was changed while loading
+    if ((rows < limit) || userDataList.isEmpty())
+      pendingFolders_.dequeue();
+    count += rows;
+    if (userDataList.isEmpty())
+      continue;
+
+    beginInsertRows(indexById(parid), children.count(),
+                    children.count() + userDataList.count() - 1);
+    foreach (UserData *userData, userDataList) {
+      userData->row = children.count();
+      children.append(userData);
+      userDataList_[userData->id] = userData;
+      if (userData->folder)
+        pendingFolders_.enqueue(userData->id);
+    }
+    endInsertRows();
+  }
+
+  emit signalFeedsInserted();
+
+  if (pendingFolders_.isEmpty()) {
+    loadTimer_.stop();
+    reportMemory();
+    emit signalFeedsLoaded();
+  }
+}
+
+/** @brief Query of feed records with counters and icon
+ *
+ *  Counters and icon are kept in own tables, their values replace unused
+ *  columns of feeds table, so order of columns is not changed.
+ *---------------------------------------------------------------------------*/
+QString FeedsModel::selectFeeds()
+{
+  if (selectFeeds_.isEmpty()) {
+    QSqlRecord record = QSqlDatabase::database().record("feeds");
+    QStringList columns;
+    for (int i = 0; i < record.count(); ++i) {
+      QString name = record.fieldName(i);
+      if ((name == "unread") || (name == "newCount") || (name == "undeleteCount"))
+        columns.append(QString("feedsState.%1 AS %1").arg(name));
+      else if (name == "image")
+        columns.append("feedsIcons.image AS image");
+      else
+        columns.append("feeds." + name);
+    }
+    selectFeeds_ = QString("SELECT %1 FROM feeds "
+                           "LEFT JOIN feedsState ON feedsState.feedId=feeds.id "
+                           "LEFT JOIN feedsIcons ON feedsIcons.feedId=feeds.id").
+        arg(columns.join(", "));
+  }
+  return selectFeeds_;
+}
+
+/** @brief Add to model feeds and folders inserted in DB after refresh()
+ *
+ *  Parent folder is always inserted before its children.
+ *---------------------------------------------------------------------------*/
+void FeedsModel::insertNewFeeds()
+{
+  QList<QSqlRecord> recordList;
+  QSqlQuery q;
+  q.exec("SELECT id FROM feeds");
+  QSqlQuery q1;
+  q1.prepare(selectFeeds() + " WHERE id=?");
+  while (q.next()) {
+    int id = q.value(0).toInt();
+    if (userDataList_.contains(id)) continue;
+
+    q1.addBindValue(id);
+    q1.exec();
+    if (q1.next())
+      recordList.append(q1.record());
+    q1.finish();
+  }
+
+  bool inserted = true;
+  while (inserted && !recordList.isEmpty()) {
+    inserted = false;
+    for (int i = 0; i < recordList.count(); ++i) {
+      int parid = recordList.at(i).value(indexParid_).toInt();
+      if ((parid == rootParentId_) || userDataList_.contains(parid)) {
+        insertFeed(recordList.takeAt(i--));
+        inserted = true;
+      }
+    }
+  }
+  reportMemory();
+}
+
+void FeedsModel::insertFeed(const QSqlRecord &record)
+{
+  int id = record.value(indexId_).toInt();
+  int parid = record.value(indexParid_).toInt();
+  UserData *userData = new UserData(id, parid, record);
+  updateUserData(userData);
+
+  int row = qBound(0, record.value(indexRowToParent_).toInt(),
+                   childrenList_.value(parid).count());
+  beginInsertRows(indexById(parid), row, row);
+  userDataList_[id] = userData;
+  childrenList_[parid].insert(row, userData);
+  updateRows(parid);
+  endInsertRows();
+}
+
+/** @brief Remove feeds and folders with all their children from model
+ *---------------------------------------------------------------------------*/
+void FeedsModel::removeFeeds(const QList<int> &idList)
+{
+  foreach (int id, idList) {
+    // Could be already removed with parent folder
+    UserData *userData = userDataById(id);
+    if (!userData) continue;
+
+    int parid = userData->parid;
+    beginRemoveRows(indexById(parid), userData->row, userData->row);
+    childrenList_[parid].remove(userData->row);
+    deleteUserData(userData);
+    updateRows(parid);
+    endRemoveRows();
+  }
+  reportMemory();
+}
+
+/** @brief Report approximate memory of records of all feeds and folders
+ *---------------------------------------------------------------------------*/
+void FeedsModel::reportMemory() const
+{
+  qint64 bytes = 0;
+  foreach (const UserData *userData, userDataList_) {
+    bytes += sizeof(UserData) + (userData->findText.size() + userData->findUrl.size() +
+                                 userData->iconKey.size()) * sizeof(QChar);
+    for (int i = 0; i < userData->record.count(); ++i)
+      bytes += MemoryAccounting::variantBytes(userData->record.value(i));
+  }
+  MemoryAccounting::report(MemoryAccounting::FeedsTree, this, bytes);
+}
+
+void FeedsModel::deleteUserData(UserData *userData)
+{
+  foreach (UserData *childData, childrenList_.take(userData->id)) {
+    deleteUserData(childData);
+  }
+  userDataList_.remove(userData->id);
+  delete userData;
+}
+
+/** @brief Move feed or folder to position inside folder
+ * @param id Feed Id
+ * @param parid Id of destination folder
+ * @param row Position in destination folder
+ *---------------------------------------------------------------------------*/
+void FeedsModel::moveFeed(int id, int parid, int row)
+{
+  UserData *userData = userDataById(id);
+  if (!userData) return;
+
+  int oldParid = userData->parid;
+  int oldRow = userData->row;
+  int count = childrenList_.value(parid).count();
+  if (oldParid == parid) count--;
+  row = qBound(0, row, count);
+  if ((oldParid == parid) && (oldRow == row)) return;
+
+  int destRow = ((oldParid == parid) && (row > oldRow)) ? row + 1 : row;
+  if (!beginMoveRows(indexById(oldParid), oldRow, oldRow, indexById(parid), destRow))
+    return;
+
+  childrenList_[oldParid].remove(oldRow);
+  childrenList_[parid].insert(row, userData);
+  userData->parid = parid;
+  userData->record.setValue(indexParid_, parid);
+  updateRows(oldParid);
+  if (oldParid != parid)
+    updateRows(parid);
+  endMoveRows();
+}
+
+/** @brief Renumber rows of folder children after insert, remove or move
+ *---------------------------------------------------------------------------*/
+void FeedsModel::updateRows(int parid)
+{
+  QHash<int,QVector<UserData*> >::iterator iter = childrenList_.find(parid);
+  if (iter == childrenList_.end())
+    return;
+
+  QVector<UserData*> &children = iter.value();
+  for (int i = 0; i < children.count(); ++i) {
+    children[i]->row = i;
+    children[i]->record.setValue(indexRowToParent_, i);
+  }
+}
+
+/** @brief Take values used while painting from feed record
+ *---------------------------------------------------------------------------*/
+void FeedsModel::updateUserData(UserData *userData) const
+{
+  const QSqlRecord &record = userData->record;
+  userData->findText = record.value(indexText_).toString().toLower();
+  userData->findUrl = record.value(indexXmlUrl_).toString().toLower();
+  userData->unread = record.value(indexUnread_).toInt();
+  userData->newCount = record.value(indexNewCount_).toInt();
+  userData->undeleteCount = record.value(indexUndeleteCount_).toInt();
+  userData->status = record.value(indexStatus_).toString().section(" ", 0, 0).toInt();
+  userData->disableUpdate = record.value(indexDisableUpdate_).toBool();
+  userData->folder = userData->findUrl.isEmpty();
+
+  QString strDate = record.value(indexUpdated_).toString();
+  if (!strDate.isEmpty()) {
+    QDateTime dt = QDateTime::fromString(strDate, Qt::ISODate);
+    dt.setTimeSpec(Qt::UTC);
+    userData->updated = dt.toLocalTime();
+  } else {
+    userData->updated = QDateTime();
+  }
 }
 
-int FeedsModel::rowById(int id) const
+/** @brief Feed icon with bullet of update status
+ *
+ *  Icon is decoded and scaled to size of view icons once and kept in
+ *  QPixmapCache by feed id, image hash and status
+ *---------------------------------------------------------------------------*/
+QPixmap FeedsModel::feedIcon(UserData *userData) const
 {
-  return id2RowList_.value(id, -1);
+  QByteArray byteArray;
+  if (!defaultIconFeeds_)
+    byteArray = userData->record.value(indexImage_).toByteArray();
+
+  QSize iconSize;
+  if (view_) {
+    iconSize = view_->iconSize();
+    if (!iconSize.isValid()) {
+      int size = view_->style()->pixelMetric(QStyle::PM_SmallIconSize, 0, view_);
+      iconSize = QSize(size, size);
+    }
+  }
+
+  QString key = QString("feedIcon_%1_%2_%3_%4x%5").arg(userData->id).
+      arg(qHash(byteArray)).arg(userData->status).
+      arg(iconSize.width()).arg(iconSize.height());
+  userData->iconKey = key;
+
+  QPixmap pixmap;
+  if (QPixmapCache::find(key, &pixmap))
+    return pixmap;
+
+  QImage resultImage;
+  if (!byteArray.isNull())
+    resultImage.loadFromData(QByteArray::fromBase64(byteArray));
+  if (resultImage.isNull())
+    resultImage.load(":/images/feed");
+  if (iconSize.isValid() && ((resultImage.width() > iconSize.width()) ||
+                             (resultImage.height() > iconSize.height()))) {
+    resultImage = resultImage.scaled(iconSize, Qt::KeepAspectRatio,
+                                     Qt::SmoothTransformation);
+  }
+
+  if (userData->status != 0) {
+    QImage image;
+    if (userData->status < 0)
+      image.load(":/images/bulletError");
+    else if (userData->status == 1)
+      image.load(":/images/bulletUpdate");
+    else if (userData->status == 2)
+      image.load(":/images/bulletDemoted");
+    resultImage = resultImage.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    QPainter resultPainter(&resultImage);
+    resultPainter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+    resultPainter.drawImage(0, 0, image);
+    resultPainter.end();
+  }
+
+  pixmap = QPixmap::fromImage(resultImage);
+  QPixmapCache::insert(key, pixmap);
+  return pixmap;
 }
 
-int FeedsModel::rowByParid(int parid) const
+UserData * FeedsModel::userDataById(int id) const
 {
-  return parid2RowList_.key(parid, -1);
+  return userDataList_.value(id, 0);
 }
 
 int FeedsModel::rowCount(const QModelIndex &parent) const
 {
-  if (parent.isValid())
-    return parid2RowList_.keys(idByIndex(parent)).count();
-  else
-    return parid2RowList_.keys(rootParentId_).count();
+  int parid = parent.isValid() ? idByIndex(parent) : rootParentId_;
+  QHash<int,QVector<UserData*> >::const_iterator iter = childrenList_.constFind(parid);
+  if (iter == childrenList_.constEnd())
+    return 0;
+  return iter.value().count();
 }
 
 int FeedsModel::columnCount(const QModelIndex&) const
 {
-  return queryModel_.record().count();
+  return columnCount_;
 }
 
 QModelIndex FeedsModel::index(int row, int column, const QModelIndex &parent) const
 {
-  if (row == -1)
+  if ((row < 0) || (column < 0))
     return QModelIndex();
 
-  int id = 0;
-  if (parent.isValid())
-    id = id2RowList_.key(row + rowByParid(idByIndex(parent)), 0);
-  else
-    id = id2RowList_.key(row, 0);
-
-  UserData *userData = userDataById(id);
-  if (userData)
-    return createIndex(row, column, userData);
-  else
+  int parid = parent.isValid() ? idByIndex(parent) : rootParentId_;
+  QHash<int,QVector<UserData*> >::const_iterator iter = childrenList_.constFind(parid);
+  if ((iter == childrenList_.constEnd()) || (row >= iter.value().count()))
     return QModelIndex();
+
+  return createIndex(row, column, iter.value().at(row));
 }
 
 QModelIndex FeedsModel::parent(const QModelIndex &index) const
@@ -135,48 +494,40 @@ QModelIndex FeedsModel::parent(const QModelIndex &index) const
     return QModelIndex();
 
   UserData *userData = userDataById(parid);
-  if (userData) {
-    int row = rowById(parid) - rowByParid(userData->parid);
-    return createIndex(row, 0, userData);
-  } else {
+  if (userData)
+    return createIndex(userData->row, 0, userData);
+  else
     return QModelIndex();
-  }
 }
 
 QVariant FeedsModel::data(const QModelIndex &index, int role) const
 {
+  if (!index.isValid())
+    return QVariant();
+  UserData *userData = static_cast<UserData*>(index.internalPointer());
+
   if (role == Qt::FontRole) {
     QFont font = font_;
-    if (indexColumnOf("text") == index.column()) {
-      if (0 < indexSibling(index, "unread").data(Qt::EditRole).toInt())
+    if (columnText_ == index.column()) {
+      if (0 < userData->unread)
         font.setBold(true);
     }
     return font;
   } else if (role == Qt::DisplayRole){
-    if (indexColumnOf("unread") == index.column()) {
-      int unread = indexSibling(index, "unread").data(Qt::EditRole).toInt();
-      if (0 == unread) {
+    if (columnUnread_ == index.column()) {
+      if (0 == userData->unread) {
         return QVariant();
       } else {
-        QString qStr = QString("(%1)").arg(unread);
+        QString qStr = QString("(%1)").arg(userData->unread);
         return qStr;
       }
-    } else if (indexColumnOf("undeleteCount") == index.column()) {
-      QString qStr = QString("(%1)").
-          arg(indexSibling(index, "undeleteCount").data(Qt::EditRole).toInt());
+    } else if (columnUndeleteCount_ == index.column()) {
+      QString qStr = QString("(%1)").arg(userData->undeleteCount);
       return qStr;
-    } else if (indexColumnOf("updated") == index.column()) {
-      QDateTime dtLocal;
-      QString strDate = indexSibling(index, "updated").data(Qt::EditRole).toString();
-
-      if (!strDate.isNull()) {
-        QDateTime dtLocalTime = QDateTime::currentDateTime();
-        QDateTime dtUTC = QDateTime(dtLocalTime.date(), dtLocalTime.time(), Qt::UTC);
-        int nTimeShift = dtLocalTime.secsTo(dtUTC);
-
-        QDateTime dt = QDateTime::fromString(strDate, Qt::ISODate);
-        dtLocal = dt.addSecs(nTimeShift);
+    } else if (columnUpdated_ == index.column()) {
+      const QDateTime &dtLocal = userData->updated;
 
+      if (dtLocal.isValid()) {
         QString strResult;
         if (QDateTime::currentDateTime().date() <= dtLocal.date())
           strResult = dtLocal.toString(formatTime_);
@@ -188,24 +539,21 @@ QVariant FeedsModel::data(const QModelIndex &index, int role) const
       }
     }
   } else if (role == Qt::TextColorRole) {
-    if (indexColumnOf("unread") == index.column()) {
+    if (columnUnread_ == index.column()) {
       return QColor(countNewsUnreadColor_);
     }
 
     QModelIndex currentIndex = ((FeedsProxyModel*)view_->model())->mapToSource(view_->currentIndex());
-    if ((index.row() == currentIndex.row()) && (index.parent() == currentIndex.parent()) &&
+    if ((currentIndex.internalPointer() == userData) &&
         view_->selectionModel()->selectedRows(0).count()) {
       return QColor(focusedFeedTextColor_);
     }
 
-    if (indexColumnOf("text") == index.column()) {
-      if (indexSibling(index, "newCount").data(Qt::EditRole).toInt() > 0) {
+    if (columnText_ == index.column()) {
+      if (userData->newCount > 0) {
         return QColor(feedWithNewNewsColor_);
       }
-    }
-
-    if (indexColumnOf("text") == index.column()) {
-      if (indexSibling(index, "disableUpdate").data(Qt::EditRole).toBool()) {
+      if (userData->disableUpdate) {
         return QColor(feedDisabledUpdateColor_);
       }
     }
@@ -213,66 +561,31 @@ QVariant FeedsModel::data(const QModelIndex &index, int role) const
     return QColor(textColor_);
   } else if (role == Qt::BackgroundRole) {
     QModelIndex currentIndex = ((FeedsProxyModel*)view_->model())->mapToSource(view_->currentIndex());
-    if ((index.row() == currentIndex.row()) && (index.parent() == currentIndex.parent()) &&
+    if ((currentIndex.internalPointer() == userData) &&
         view_->selectionModel()->selectedRows(0).count()) {
       if (!focusedFeedBGColor_.isEmpty())
         return QColor(focusedFeedBGColor_);
     }
   } else if (role == Qt::DecorationRole) {
-    if (indexColumnOf("text") == index.column()) {
-      if (isFolder(index)) {
+    if (columnText_ == index.column()) {
+      if (userData->folder) {
         return QPixmap(":/images/folder");
       } else {
-        if (!defaultIconFeeds_) {
-          QByteArray byteArray = indexSibling(index, "image").data(Qt::EditRole).toByteArray();
-          if (!byteArray.isNull()) {
-            QImage resultImage;
-            if (resultImage.loadFromData(QByteArray::fromBase64(byteArray))) {
-              QString strStatus = indexSibling(index, "status").data(Qt::EditRole).toString();
-              if (strStatus.section(" ", 0, 0).toInt() != 0) {
-                QImage image;
-                if (strStatus.section(" ", 0, 0).toInt() < 0)
-                  image.load(":/images/bulletError");
-                else if (strStatus.section(" ", 0, 0).toInt() == 1)
-                  image.load(":/images/bulletUpdate");
-                QPainter resultPainter(&resultImage);
-                resultPainter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-                resultPainter.drawImage(0, 0, image);
-                resultPainter.end();
-              }
-              return resultImage;
-            }
-          }
-        }
-        QImage resultImage(":/images/feed");
-        QString strStatus = indexSibling(index, "status").data(Qt::EditRole).toString();
-        if (strStatus.section(" ", 0, 0).toInt() != 0) {
-          QImage image;
-          if (strStatus.section(" ", 0, 0).toInt() < 0)
-            image.load(":/images/bulletError");
-          else if (strStatus.section(" ", 0, 0).toInt() == 1)
-            image.load(":/images/bulletUpdate");
-
-          QPainter resultPainter(&resultImage);
-          resultPainter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-          resultPainter.drawImage(0, 0, image);
-          resultPainter.end();
-        }
-        return resultImage;
+        return feedIcon(userData);
       }
     }
   } else if (role == Qt::TextAlignmentRole) {
-    if (indexColumnOf("id") == index.column()) {
+    if (columnId_ == index.column()) {
       int flag = Qt::AlignRight|Qt::AlignVCenter;
       return flag;
     }
   } else if (role == Qt::ToolTipRole) {
-    if (indexColumnOf("text") == index.column()) {
-      QString title = index.data(Qt::EditRole).toString();
+    if (columnText_ == index.column()) {
+      QString title = userData->record.value(indexText_).toString();
       QRect rectText = view_->visualRect(index);
       int width = rectText.width() - 16 - 12;
       QFont font = font_;
-      if (0 < indexSibling(index, "unread").data(Qt::EditRole).toInt())
+      if (0 < userData->unread)
         font.setBold(true);
       QFontMetrics fontMetrics(font);
 
@@ -285,8 +598,7 @@ QVariant FeedsModel::data(const QModelIndex &index, int role) const
   if (!((role == Qt::EditRole) || (role == Qt::DisplayRole)))
     return QVariant();
 
-  QSqlRecord record = static_cast<UserData*>(index.internalPointer())->record;
-  return record.value(indexColumnOf(index.column()));
+  return userData->record.value(indexColumnOf(index.column()));
 }
 
 bool FeedsModel::setData(const QModelIndex &index, const QVariant &value, int)
@@ -294,11 +606,40 @@ bool FeedsModel::setData(const QModelIndex &index, const QVariant &value, int)
   if (!index.isValid())
     return false;
 
-  QSqlRecord *record = &static_cast<UserData*>(index.internalPointer())->record;
-  record->setValue(indexColumnOf(index.column()), value);
+  UserData *userData = static_cast<UserData*>(index.internalPointer());
+  int column = indexColumnOf(index.column());
+  if (((column == indexUnread_) || (column == indexNewCount_)) &&
+      (userData->record.value(column) != value)) {
+    changedCounts_.insert(userData->id);
+  }
+  userData->record.setValue(column, value);
+  updateUserData(userData);
+  if (column == indexImage_) {
+    // Icon with old image is not needed anymore
+    QPixmapCache::remove(userData->iconKey);
+    userData->iconKey.clear();
+  }
   return true;
 }
 
+/** @brief Notify about feeds which counters were changed since last call
+ *
+ * Counters are set without dataChanged() to repaint view once, so rows of
+ * changed feeds are reported here for filter of proxy model.
+ *----------------------------------------------------------------------------*/
+void FeedsModel::emitCountsChanged()
+{
+  if (changedCounts_.isEmpty()) return;
+
+  foreach (int id, changedCounts_) {
+    QModelIndex index = indexById(id);
+    if (!index.isValid()) continue;
+    emit dataChanged(index, createIndex(index.row(), columnCount() - 1,
+                                        index.internalPointer()));
+  }
+  changedCounts_.clear();
+}
+
 Qt::ItemFlags FeedsModel::flags(const QModelIndex &index) const
 {
   Qt::ItemFlags defaultFlags = QAbstractItemModel::flags(index);
@@ -316,14 +657,10 @@ Qt::DropActions FeedsModel::supportedDropActions() const
 
 QModelIndex FeedsModel::indexById(int id) const
 {
-  QModelIndex parentIndex = QModelIndex();
   UserData *userData = userDataById(id);
-  if (userData)
-    parentIndex = indexById(userData->parid);
-  for (int i = 0; i < rowCount(parentIndex); i++) {
-    if (idByIndex(index(i, 0, parentIndex)) == id)
-      return index(i,0,parentIndex);
-  }
+  if (userData && ((userData->parid == rootParentId_) ||
+                   userDataList_.contains(userData->parid)))
+    return createIndex(userData->row, 0, userData);
   return QModelIndex();
 }
 
@@ -348,7 +685,42 @@ int FeedsModel::indexColumnOf(int column) const
 
 int FeedsModel::indexColumnOf(const QString &name) const
 {
-  return indexColumnOf(queryModel_.record().indexOf(name));
+  return indexColumnOf(columnNames_.value(name, -1));
+}
+
+/** @brief Find feeds by title or link
+ *
+ *  Single pass over feeds with lowercase title and link prepared in refresh()
+ * @param findAct Find mode ("findLinkAct" for link, title otherwise)
+ * @param findText Text to find
+ * @return Identifiers of matched feeds and their parent folders
+ *---------------------------------------------------------------------------*/
+QSet<int> FeedsModel::findFeeds(const QString &findAct, const QString &findText) const
+{
+  QSet<int> idList;
+  if (findText.isEmpty())
+    return idList;
+
+  QString text = findText.toLower();
+  bool findLink = (findAct == "findLinkAct");
+  QHash<int,UserData*>::const_iterator iter = userDataList_.constBegin();
+  for (; iter != userDataList_.constEnd(); ++iter) {
+    UserData *userData = iter.value();
+    if (userData->findUrl.isEmpty())
+      continue;
+    if (!(findLink ? userData->findUrl : userData->findText).contains(text))
+      continue;
+
+    idList.insert(userData->id);
+    int parid = userData->parid;
+    while ((parid != rootParentId_) && !idList.contains(parid)) {
+      idList.insert(parid);
+      UserData *parentData = userDataById(parid);
+      if (!parentData) break;
+      parid = parentData->parid;
+    }
+  }
+  return idList;
 }
 
 void FeedsModel::setView(QTreeView *view)
@@ -361,6 +733,37 @@ QVariant FeedsModel::dataField(const QModelIndex &index, const QString &fieldNam
   return indexSibling(index, fieldName).data(Qt::EditRole);
 }
 
+/** @brief Value of feed field read from record of item
+ *
+ *  Column is not looked up by name, so it is cheap in paint and news loops
+ *---------------------------------------------------------------------------*/
+QVariant FeedsModel::dataField(const QModelIndex &index, Field field) const
+{
+  if (!index.isValid())
+    return QVariant();
+  return static_cast<UserData*>(index.internalPointer())->record.value(recordIndex(field));
+}
+
+// ----------------------------------------------------------------------------
+int FeedsModel::recordIndex(Field field) const
+{
+  switch (field) {
+  case FieldId:            return indexId_;
+  case FieldParentId:      return indexParid_;
+  case FieldRowToParent:   return indexRowToParent_;
+  case FieldText:          return indexText_;
+  case FieldXmlUrl:        return indexXmlUrl_;
+  case FieldUnread:        return indexUnread_;
+  case FieldNewCount:      return indexNewCount_;
+  case FieldUndeleteCount: return indexUndeleteCount_;
+  case FieldStatus:        return indexStatus_;
+  case FieldDisableUpdate: return indexDisableUpdate_;
+  case FieldUpdated:       return indexUpdated_;
+  case FieldImage:         return indexImage_;
+  }
+  return -1;
+}
+
 /** @brief Check if item is folder
  *
  *  If xmlUrl field is empty, than item is considered folder
@@ -371,10 +774,14 @@ QVariant FeedsModel::dataField(const QModelIndex &index, const QString &fieldNam
  *---------------------------------------------------------------------------*/
 bool FeedsModel::isFolder(const QModelIndex &index) const
 {
-  return indexSibling(index, "xmlUrl").data(Qt::EditRole).toString().isEmpty();
+  if (!index.isValid())
+    return true;
+  return static_cast<UserData*>(index.internalPointer())->folder;
 }
 
 QModelIndex FeedsModel::indexSibling(const QModelIndex &index, const QString &fieldName) const
 {
-  return this->index(index.row(), indexColumnOf(fieldName), index.parent());
+  if (!index.isValid())
+    return QModelIndex();
+  return createIndex(index.row(), indexColumnOf(fieldName), index.internalPointer());
 }
@@ -18,34 +18,76 @@
 #ifndef FEEDSMODEL_H
 #define FEEDSMODEL_H
 
+#include <QDateTime>
+#include <QImage>
+#include <QQueue>
+#include <QSet>
 #include <QSqlRecord>
 #include <QSqlQueryModel>
+#include <QTimer>
 #include <QTreeView>
 
 struct UserData
 {
   UserData(int id, int parid, const QSqlRecord &record)
     : id(id)
-    , parid(parid),
-      record(record) {
+    , parid(parid)
+    , row(0),
+      record(record)
+    , unread(0)
+    , newCount(0)
+    , undeleteCount(0)
+    , status(0)
+    , disableUpdate(false)
+    , folder(false) {
   }
   ~UserData() {
   }
   int id;
   int parid;
+  int row;  // row inside parent folder
   QSqlRecord record;
+  QString findText;
+  QString findUrl;
+
+  // Values painted in feeds tree, taken from record by updateUserData()
+  int unread;
+  int newCount;
+  int undeleteCount;
+  int status;
+  bool disableUpdate;
+  bool folder;
+  QDateTime updated;  // local time of last update, invalid if never updated
+  QString iconKey;  // key of decoded icon in QPixmapCache, set on first paint
 };
 
 class FeedsModel : public QAbstractItemModel
 {
   Q_OBJECT
 public:
+  // Fields of feed which record columns are kept after refresh()
+  enum Field {
+    FieldId,
+    FieldParentId,
+    FieldRowToParent,
+    FieldText,
+    FieldXmlUrl,
+    FieldUnread,
+    FieldNewCount,
+    FieldUndeleteCount,
+    FieldStatus,
+    FieldDisableUpdate,
+    FieldUpdated,
+    FieldImage
+  };
+
   explicit FeedsModel(QObject *parent = 0);
   ~FeedsModel();
 
   void setView(QTreeView *view);
 
   QVariant dataField(const QModelIndex &index, const QString &fieldName) const;
+  QVariant dataField(const QModelIndex &index, Field field) const;
   bool isFolder(const QModelIndex &index) const;
   QModelIndex indexSibling(const QModelIndex &index, const QString &fieldName) const;
 
@@ -55,6 +97,7 @@ public:
   QModelIndex parent(const QModelIndex &index) const;
   QVariant data(const QModelIndex &index, int role) const;
   bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole);
+  void emitCountsChanged();
   Qt::ItemFlags flags(const QModelIndex &index) const;
   Qt::DropActions supportedDropActions() const;
 
@@ -65,6 +108,9 @@ public:
   int indexColumnOf(int column) const;
   int indexColumnOf(const QString &name) const;
 
+  QSet<int> findFeeds(const QString &findAct, const QString &findText) const;
+  bool isLoading() const { return loadTimer_.isActive(); }
+
   QFont font_;
   QString formatDate_;
   QString formatTime_;
@@ -77,25 +123,62 @@ public:
   QString focusedFeedBGColor_;
   QString feedDisabledUpdateColor_;
 
+signals:
+  void signalFeedsInserted();
+  void signalFeedsLoaded();
+
 public slots:
-  void refresh();
+  void refresh(bool progressive = false);
+  void insertNewFeeds();
+  void removeFeeds(const QList<int> &idList);
+  void moveFeed(int id, int parid, int row);
+
+private slots:
+  void loadPendingFeeds();
 
 private:
   void clear();
-  int rowById(int id) const;
-  int rowByParid(int parid) const;
   UserData * userDataById(int id) const;
+  void insertFeed(const QSqlRecord &record);
+  void updateUserData(UserData *userData) const;
+  QPixmap feedIcon(UserData *userData) const;
+  void deleteUserData(UserData *userData);
+  void updateRows(int parid);
+  int recordIndex(Field field) const;
+  QString selectFeeds();
+  void reportMemory() const;
 
   QTreeView *view_;
   QSqlQueryModel queryModel_;
+  QString selectFeeds_;
+  QTimer loadTimer_;
+  QQueue<int> pendingFolders_;  // folders which children are not loaded yet
   int rootParentId_;
   int indexId_;
   int indexParid_;
-
-  QMap<int,int> id2RowList_;
-  QMap<int,int> parid2RowList_;
-  QMap<int,UserData*> userDataList_;
+  int indexRowToParent_;
+  int indexText_;
+  int indexXmlUrl_;
+  int indexUnread_;
+  int indexNewCount_;
+  int indexUndeleteCount_;
+  int indexStatus_;
+  int indexDisableUpdate_;
+  int indexUpdated_;
+  int indexImage_;
+  int columnId_;
+  int columnText_;
+  int columnUnread_;
+  int columnUndeleteCount_;
+  int columnUpdated_;
+
+  // Feeds by id and children of each folder in rowToParent order
+  QHash<int,UserData*> userDataList_;
+  QHash<int,QVector<UserData*> > childrenList_;
+  QSet<int> changedCounts_;  // feeds which unread or new counters were set
   QHash<int,int> columnsList_;
+  QHash<QString,int> columnNames_;
+  int columnCount_;
 
 
 };
@@ -6,6 +6,8 @@ FeedsProxyModel::FeedsProxyModel(QObject *parent)
   , filterAct_("filterFeedsAll_")
 {
   setObjectName("FeedsProxyModel");
+  // Rows follow counters reported by FeedsModel::emitCountsChanged()
+  setDynamicSortFilter(true);
 }
 
 FeedsProxyModel::~FeedsProxyModel()
@@ -15,6 +17,7 @@ FeedsProxyModel::~FeedsProxyModel()
 
 void FeedsProxyModel::reset()
 {
+  findIdList_ = ((FeedsModel*)sourceModel())->findFeeds(findAct_, findText_);
 #ifdef HAVE_QT5
   QSortFilterProxyModel::beginResetModel();
   QSortFilterProxyModel::endResetModel();
@@ -23,18 +26,28 @@ void FeedsProxyModel::reset()
 #endif
 }
 
-void FeedsProxyModel::setFilter(const QString &filterAct, const QList<int> &idList,
+/** @brief Set filter of feeds
+ *
+ * Counters of feeds in new and unread filters are followed by changed rows
+ * only, so whole tree is filtered again only when filter is changed.
+ * @return true if filter was changed
+ *----------------------------------------------------------------------------*/
+bool FeedsProxyModel::setFilter(const QString &filterAct, const QList<int> &idList,
                                 const QString &findAct, const QString &findText)
 {
-  if ((filterAct_ != filterAct) || (filterAct != "filterFeedsAll_") ||
-      (findAct_ != findAct) || (findText_ != findText) || (idList_ != idList)) {
-    filterAct_ = filterAct;
-    findAct_ = findAct;
-    findText_ = findText;
-    idList_ = idList;
-
-    invalidateFilter();
+  if ((filterAct_ == filterAct) && (findAct_ == findAct) && (findText_ == findText) &&
+      (idList_.toSet() == idList.toSet())) {
+    return false;
   }
+
+  filterAct_ = filterAct;
+  findAct_ = findAct;
+  findText_ = findText;
+  idList_ = idList;
+  findIdList_ = ((FeedsModel*)sourceModel())->findFeeds(findAct_, findText_);
+
+  invalidateFilter();
+  return true;
 }
 
 bool FeedsProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
@@ -61,15 +74,8 @@ bool FeedsProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceP
   }
 
   if (accept && !findText_.isEmpty()) {
-    index = sourceModel()->index(sourceRow, ((FeedsModel*)sourceModel())->indexColumnOf("xmlUrl"), sourceParent);
-    if (!sourceModel()->data(index, Qt::EditRole).toString().isEmpty()) {
-      if (findAct_ == "findLinkAct") {
-        accept = sourceModel()->data(index, Qt::EditRole).toString().contains(findText_, Qt::CaseInsensitive);
-      } else {
-        index = sourceModel()->index(sourceRow, ((FeedsModel*)sourceModel())->indexColumnOf("text"), sourceParent);
-        accept = sourceModel()->data(index, Qt::EditRole).toString().contains(findText_, Qt::CaseInsensitive);
-      }
-    }
+    index = sourceModel()->index(sourceRow, 0, sourceParent);
+    accept = findIdList_.contains(((FeedsModel*)sourceModel())->idByIndex(index));
   }
 
   return accept;
@@ -1,6 +1,7 @@
 #ifndef FEEDSPROXYMODEL_H
 #define FEEDSPROXYMODEL_H
 
+#include <QSet>
 #include <QSortFilterProxyModel>
 
 class FeedsProxyModel : public QSortFilterProxyModel
@@ -11,8 +12,8 @@ public:
   ~FeedsProxyModel();
 
   void reset();
-  void setFilter(const QString &filterAct, const QList<int> &idList,
-                 const QString &findAct, const QString &findText);
+  bool setFilter(const QString &filterAct, const QList<int> &idList,
+                const QString &findAct, const QString &findText);
   QModelIndex mapFromSource(const QModelIndex & sourceIndex) const;
   QModelIndex mapFromSource(int id) const;
   QModelIndex index(int row, int column, const QModelIndex & parent = QModelIndex()) const;
@@ -24,6 +25,7 @@ private:
   QList<int> idList_;
   QString findAct_;
   QString findText_;
+  QSet<int> findIdList_;
 
 };
 
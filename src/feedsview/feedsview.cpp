@@ -63,6 +63,11 @@ FeedsView::FeedsView(QWidget * parent)
 void FeedsView::setSourceModel(FeedsModel *sourceModel)
 {
   sourceModel_ = sourceModel;
+  // Folders added by progressive loading are expanded as saved
+  connect(sourceModel_, SIGNAL(signalFeedsInserted()), this, SLOT(restoreExpanded()));
+  // and folders shown again by filter of counters
+  connect(model(), SIGNAL(rowsInserted(QModelIndex,int,int)),
+          this, SLOT(slotRowsInserted(QModelIndex,int,int)));
 
   QSqlQuery q;
   q.exec("SELECT id FROM feeds WHERE f_Expanded=1 AND (xmlUrl='' OR xmlUrl IS NULL)");
@@ -105,6 +110,18 @@ void FeedsView::restoreExpanded()
   }
 }
 
+/** @brief Expand saved folders among rows inserted by proxy model
+ *----------------------------------------------------------------------------*/
+void FeedsView::slotRowsInserted(const QModelIndex &parent, int first, int last)
+{
+  for (int row = first; row <= last; ++row) {
+    QModelIndex index = model()->index(row, 0, parent);
+    int feedId = sourceModel_->idByIndex(((FeedsProxyModel*)model())->mapToSource(index));
+    if (expandedList.contains(feedId) && !isExpanded(index))
+      setExpanded(index, true);
+  }
+}
+
 /** @brief Process item expanding
  *----------------------------------------------------------------------------*/
 void FeedsView::slotExpanded(const QModelIndex &index)
@@ -181,7 +198,7 @@ QModelIndex FeedsView::indexNextUnread(const QModelIndex &indexCur, int nextCond
     // find next
     QModelIndex index = indexNext(indexCur);
     while (index.isValid()) {
-      int feedUnreadCount = sourceModel_->dataField(((FeedsProxyModel*)model())->mapToSource(index), "unread").toInt();
+      int feedUnreadCount = sourceModel_->dataField(((FeedsProxyModel*)model())->mapToSource(index), FeedsModel::FieldUnread).toInt();
       if (0 < feedUnreadCount)
         return index;  // ok
 
@@ -193,7 +210,7 @@ QModelIndex FeedsView::indexNextUnread(const QModelIndex &indexCur, int nextCond
     // find previous
     QModelIndex index = indexPrevious(indexCur);
     while (index.isValid()) {
-      int feedUnreadCount = sourceModel_->dataField(((FeedsProxyModel*)model())->mapToSource(index), "unread").toInt();
+      int feedUnreadCount = sourceModel_->dataField(((FeedsProxyModel*)model())->mapToSource(index), FeedsModel::FieldUnread).toInt();
       if (0 < feedUnreadCount)
         return index;  // ok
 
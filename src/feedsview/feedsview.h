@@ -84,6 +84,7 @@ protected:
 private slots:
   void slotExpanded(const QModelIndex&index);
   void slotCollapsed(const QModelIndex&index);
+  void slotRowsInserted(const QModelIndex &parent, int first, int last);
 
 private:
   FeedsModel *sourceModel_;
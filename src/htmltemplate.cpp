@@ -0,0 +1,122 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "htmltemplate.h"
+
+#include <QtAlgorithms>
+
+HtmlTemplate::HtmlTemplate()
+  : literalsSize_(0)
+{
+}
+
+HtmlTemplate::HtmlTemplate(const QString &text)
+  : literalsSize_(0)
+{
+  setText(text);
+}
+
+/** @brief Split \a text into literal parts and placeholders
+ *----------------------------------------------------------------------------*/
+void HtmlTemplate::setText(const QString &text)
+{
+  literals_.clear();
+  slots_.clear();
+  numbers_.clear();
+  literalsSize_ = 0;
+
+  int start = 0;
+  int pos = 0;
+  const int length = text.length();
+  while ((pos = text.indexOf(QLatin1Char('%'), pos)) != -1) {
+    int end = pos + 1;
+    int number = 0;
+    while ((end < length) && (end - pos <= 2) && text.at(end).isDigit()) {
+      number = number * 10 + text.at(end).digitValue();
+      ++end;
+    }
+    if (number < 1) {
+      ++pos;
+      continue;
+    }
+    literals_.append(text.mid(start, pos - start));
+    numbers_.append(number);
+    start = pos = end;
+  }
+  literals_.append(text.mid(start));
+
+  // Values are given in ascending order of placeholder numbers
+  QList<int> sorted = numbers_;
+  qSort(sorted);
+  QList<int> distinct;
+  foreach (int number, sorted) {
+    if (distinct.isEmpty() || (distinct.last() != number))
+      distinct.append(number);
+  }
+  foreach (int number, numbers_)
+    slots_.append(distinct.indexOf(number));
+
+  foreach (const QString &literal, literals_)
+    literalsSize_ += literal.length();
+}
+
+/** @brief Build text with \a count \a values put in place of placeholders
+ *----------------------------------------------------------------------------*/
+QString HtmlTemplate::render(const QString *values, int count) const
+{
+  if (literals_.isEmpty())
+    return QString();
+
+  int size = literalsSize_;
+  for (int i = 0; i < slots_.count(); ++i) {
+    int slot = slots_.at(i);
+    size += (slot < count) ? values[slot].length() : 3;
+  }
+
+  QString result;
+  result.reserve(size);
+  result.append(literals_.at(0));
+  for (int i = 0; i < slots_.count(); ++i) {
+    int slot = slots_.at(i);
+    if (slot < count) {
+      result.append(values[slot]);
+    } else {
+      result.append(QLatin1Char('%'));
+      result.append(QString::number(numbers_.at(i)));
+    }
+    result.append(literals_.at(i + 1));
+  }
+  return result;
+}
+
+QString HtmlTemplate::render(const QString &a1) const
+{
+  return render(&a1, 1);
+}
+
+QString HtmlTemplate::render(const QString &a1, const QString &a2) const
+{
+  const QString values[] = { a1, a2 };
+  return render(values, 2);
+}
+
+QString HtmlTemplate::render(const QString &a1, const QString &a2,
+                             const QString &a3) const
+{
+  const QString values[] = { a1, a2, a3 };
+  return render(values, 3);
+}
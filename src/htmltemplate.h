@@ -0,0 +1,53 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef HTMLTEMPLATE_H
+#define HTMLTEMPLATE_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+/** @brief Html template split once into text parts and placeholders
+ *
+ * Placeholders %1..%99 are replaced as by QString::arg() with several
+ * arguments: lowest number gets first value. Result is built in one
+ * allocation and values are not searched for placeholders.
+ *----------------------------------------------------------------------------*/
+class HtmlTemplate
+{
+public:
+  HtmlTemplate();
+  explicit HtmlTemplate(const QString &text);
+
+  void setText(const QString &text);
+  bool isEmpty() const { return literals_.isEmpty(); }
+  QString render(const QString *values, int count) const;
+  QString render(const QString &a1) const;
+  QString render(const QString &a1, const QString &a2) const;
+  QString render(const QString &a1, const QString &a2, const QString &a3) const;
+
+private:
+  // literals_ has one part more than slots_
+  QStringList literals_;
+  QList<int> slots_;      // index of value for each placeholder
+  QList<int> numbers_;    // number of placeholder, kept if value is missing
+  int literalsSize_;
+
+};
+
+#endif // HTMLTEMPLATE_H
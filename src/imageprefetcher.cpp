@@ -0,0 +1,182 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "imageprefetcher.h"
+
+#include "mainapplication.h"
+#include "logfile.h"
+#include "sharednetworkcache.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QNetworkReply>
+#include <qwebkitversion.h>
+
+// Maximum number of images waiting for request
+#define PREFETCH_QUEUE_MAX 1000
+// Image is not loaded till end if it exceeds this size (bytes)
+#define PREFETCH_MAX_SIZE (5*1024*1024)
+// Time of request (ms) after which it is aborted
+#define PREFETCH_TIMEOUT 30000
+// Number of URLs remembered as prefetched, set is cleared when it is full
+#define PREFETCH_KNOWN_MAX 20000
+
+static QMutex prefetchedMutex;
+static QSet<QString> prefetchedUrls;
+
+ImagePrefetcher::ImagePrefetcher(int maxRequests, int maxBandwidth, QObject *parent)
+  : QObject(parent)
+  , maxRequests_(qMax(maxRequests, 1))
+  , maxBandwidth_(maxBandwidth)
+  , bytesInTick_(0)
+{
+  setObjectName("imagePrefetcher_");
+
+  clock_.start();
+
+  networkManager_ = new NetworkManager(true, this);
+  networkManager_->setCache(new SharedNetworkCache(SharedNetworkCache::Prefetch));
+  // Background requests do not ask user about certificates and passwords
+  networkManager_->disconnect(mainApp->networkManager());
+  connect(networkManager_, SIGNAL(finished(QNetworkReply*)),
+          this, SLOT(finished(QNetworkReply*)));
+
+  tickTimer_ = new QTimer(this);
+  tickTimer_->setInterval(1000);
+  connect(tickTimer_, SIGNAL(timeout()), this, SLOT(slotTick()));
+}
+
+void ImagePrefetcher::disconnectObjects()
+{
+  disconnect(this);
+  networkManager_->disconnect(networkManager_);
+}
+
+/** @brief Check if browser can take image from cache without check of server
+ *----------------------------------------------------------------------------*/
+bool ImagePrefetcher::isPrefetched(const QUrl &url)
+{
+  QMutexLocker locker(&prefetchedMutex);
+  return prefetchedUrls.contains(url.toString());
+}
+
+/** @brief Put image URLs in queue
+ *----------------------------------------------------------------------------*/
+void ImagePrefetcher::prefetch(const QStringList &urls)
+{
+  foreach (const QString &url, urls) {
+    if (queue_.count() >= PREFETCH_QUEUE_MAX)
+      break;
+    if (queued_.contains(url) || isPrefetched(QUrl(url)))
+      continue;
+    queue_.enqueue(url);
+    queued_.insert(url);
+  }
+
+  if (!tickTimer_->isActive())
+    tickTimer_->start();
+  startRequests();
+}
+
+/** @brief Clear queue and abort requests in progress
+ *----------------------------------------------------------------------------*/
+void ImagePrefetcher::stop()
+{
+  queue_.clear();
+  queued_.clear();
+  foreach (QNetworkReply *reply, replies_.keys())
+    reply->abort();
+}
+
+void ImagePrefetcher::startRequests()
+{
+  while ((replies_.count() < maxRequests_) && !queue_.isEmpty()) {
+    // Bandwidth of this second is used up, next requests wait for tick
+    if ((maxBandwidth_ > 0) && (bytesInTick_ >= maxBandwidth_ * 1024))
+      return;
+
+    QString url = queue_.dequeue();
+    queued_.remove(url);
+
+    QNetworkRequest request(QUrl::fromEncoded(url.toUtf8()));
+    QString userAgent = QString("Mozilla/5.0 (Windows NT 6.1) AppleWebKit/%1 (KHTML, like Gecko) Chrome/77.0.3865.120 Safari/%1").
+        arg(qWebKitVersion());
+    request.setRawHeader("User-Agent", userAgent.toUtf8());
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferCache);
+
+    QNetworkReply *reply = networkManager_->get(request);
+    connect(reply, SIGNAL(readyRead()), this, SLOT(slotReadyRead()));
+    replies_.insert(reply, clock_.elapsed());
+  }
+}
+
+/** @brief Drop received data, it is kept by cache
+ *----------------------------------------------------------------------------*/
+void ImagePrefetcher::slotReadyRead()
+{
+  QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+  if (!reply)
+    return;
+
+  qint64 size = reply->readAll().size();
+  bytesInTick_ += size;
+  qint64 total = reply->property("prefetchSize").toLongLong() + size;
+  reply->setProperty("prefetchSize", total);
+  if (total > PREFETCH_MAX_SIZE)
+    reply->abort();
+}
+
+void ImagePrefetcher::finished(QNetworkReply *reply)
+{
+  replies_.remove(reply);
+
+  if (reply->error() == QNetworkReply::NoError) {
+    QMutexLocker locker(&prefetchedMutex);
+    if (prefetchedUrls.count() >= PREFETCH_KNOWN_MAX)
+      prefetchedUrls.clear();
+    prefetchedUrls.insert(reply->request().url().toString());
+  } else {
+    LOG_DEBUG(LogFile::Fetch) << "Prefetch failed:" << reply->request().url().toString()
+                              << reply->errorString();
+  }
+  reply->deleteLater();
+
+  startRequests();
+}
+
+/** @brief Renew bandwidth budget and abort hung requests
+ *----------------------------------------------------------------------------*/
+void ImagePrefetcher::slotTick()
+{
+  bytesInTick_ = 0;
+
+  qint64 now = clock_.elapsed();
+  QList<QNetworkReply*> hungReplies;
+  QHash<QNetworkReply*, qint64>::const_iterator it = replies_.constBegin();
+  for (; it != replies_.constEnd(); ++it) {
+    if (now - it.value() > PREFETCH_TIMEOUT)
+      hungReplies.append(it.key());
+  }
+  // Aborted reply is removed from replies_ by finished()
+  foreach (QNetworkReply *reply, hungReplies)
+    reply->abort();
+
+  if (replies_.isEmpty() && queue_.isEmpty())
+    tickTimer_->stop();
+  else
+    startRequests();
+}
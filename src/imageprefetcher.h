@@ -0,0 +1,73 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef IMAGEPREFETCHER_H
+#define IMAGEPREFETCHER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QQueue>
+#include <QSet>
+#include <QStringList>
+#include <QTimer>
+#include <QUrl>
+
+#include "networkmanager.h"
+
+/** @brief Load images of new news into disk cache
+ *
+ * Images found by ParseObject are requested in background with few
+ * parallel requests and limited bandwidth. Browser loads prefetched
+ * images from cache without check of server, so news is shown at once
+ * even without network.
+ *----------------------------------------------------------------------------*/
+class ImagePrefetcher : public QObject
+{
+  Q_OBJECT
+public:
+  explicit ImagePrefetcher(int maxRequests, int maxBandwidth, QObject *parent = 0);
+
+  void disconnectObjects();
+
+  static bool isPrefetched(const QUrl &url);
+
+public slots:
+  void prefetch(const QStringList &urls);
+  void stop();
+
+private slots:
+  void startRequests();
+  void slotReadyRead();
+  void finished(QNetworkReply *reply);
+  void slotTick();
+
+private:
+  NetworkManager *networkManager_;
+  int maxRequests_;
+  int maxBandwidth_;
+  QQueue<QString> queue_;
+  QSet<QString> queued_;
+  // Active replies and their start time
+  QHash<QNetworkReply*, qint64> replies_;
+  QElapsedTimer clock_;
+  QTimer *tickTimer_;
+  qint64 bytesInTick_;
+
+};
+
+#endif // IMAGEPREFETCHER_H
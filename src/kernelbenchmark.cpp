@@ -0,0 +1,291 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "kernelbenchmark.h"
+
+#include "adblockmatcher.h"
+#include "adblockrule.h"
+#include "common.h"
+#include "parseobject.h"
+#include "parseworker.h"
+#include "requestfeed.h"
+
+#include <QNetworkRequest>
+#include <stdio.h>
+
+// Time (ms) every function is called for, over whole corpus each time
+#define KERNEL_BENCH_TIME 1000
+
+KernelBenchmark::KernelBenchmark(const QString &corpusPath)
+  : corpusPath_(corpusPath)
+  , feedsSize_(0)
+{
+}
+
+/** @brief Run all benchmarks there is corpus for
+ * @return exit code of application
+ *----------------------------------------------------------------------------*/
+int KernelBenchmark::run()
+{
+  QDir feedsDir(corpusPath_ % "/feeds");
+  foreach (const QString &fileName, feedsDir.entryList(QDir::Files, QDir::Name)) {
+    QFile file(feedsDir.absoluteFilePath(fileName));
+    if (!file.open(QIODevice::ReadOnly))
+      continue;
+    QByteArray data = file.readAll();
+    file.close();
+    if (data.isEmpty())
+      continue;
+    feedsSize_ += data.size();
+    feeds_.append(data);
+  }
+
+  printf("Corpus: %s\n", qPrintable(QDir(corpusPath_).absolutePath()));
+  printf("%-22s %10s %12s %10s  %s\n", "function", "calls", "ns/call", "MB/s", "");
+
+  benchAdBlock();
+  benchDates();
+  benchEncoding();
+  benchSanitizer();
+  benchPlainText();
+
+  fflush(stdout);
+  return 0;
+}
+
+/** @brief Matching of network requests by the rules of list
+ *
+ * Rules are checked as AdBlockMatcher::matchRules() does, cache of
+ * decisions of AdBlockMatcher::match() is left out as it hides the cost
+ * of matching for repeated URLs.
+ *----------------------------------------------------------------------------*/
+void KernelBenchmark::benchAdBlock()
+{
+  QStringList filters = readLines(corpusPath_ % "/easylist.txt");
+  QStringList urls = readLines(corpusPath_ % "/urls.txt");
+  if (filters.isEmpty() || urls.isEmpty()) {
+    printf("%-22s skipped, no easylist.txt or urls.txt\n", "adblock");
+    return;
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+  QVector<AdBlockRule*> rules;
+  foreach (const QString &filter, filters) {
+    // Header of list, e.g. "[Adblock Plus 2.0]"
+    if (filter.startsWith(QLatin1Char('[')))
+      continue;
+    rules.append(new AdBlockRule(filter, 0));
+  }
+  AdBlockMatcherData *data = AdBlockMatcher::createData(rules);
+  printResult("adblock build", 1, timer.nsecsElapsed(), 0,
+              QString("%1 rules").arg(rules.count()));
+
+  // Request strings are prepared as AdBlockManager::block() does
+  QList<QNetworkRequest> requests;
+  QStringList urlStrings;
+  QStringList domains;
+  foreach (const QString &urlStr, urls) {
+    QUrl url(urlStr);
+    requests.append(QNetworkRequest(url));
+    urlStrings.append(url.toEncoded().toLower());
+    domains.append(url.host().toLower());
+  }
+
+  qint64 calls = 0;
+  int passes = 0;
+  int blocked = 0;
+  timer.start();
+  do {
+    for (int i = 0; i < requests.count(); ++i) {
+      const AdBlockRequestInfo request(requests.at(i), domains.at(i), urlStrings.at(i));
+      if (data->networkExceptionTree.find(request, domains.at(i), urlStrings.at(i)) ||
+          data->networkExceptionIndex.find(request, domains.at(i), urlStrings.at(i)))
+        continue;
+      if (data->networkBlockTree.find(request, domains.at(i), urlStrings.at(i)) ||
+          data->networkBlockIndex.find(request, domains.at(i), urlStrings.at(i)))
+        ++blocked;
+    }
+    calls += requests.count();
+    ++passes;
+  } while (timer.elapsed() < KERNEL_BENCH_TIME);
+  printResult("adblock match", calls, timer.nsecsElapsed(), 0,
+              QString("%1 of %2 blocked").arg(blocked / passes).arg(requests.count()));
+
+  QList<AdBlockRequestInfo> infos;
+  for (int i = 0; i < requests.count(); ++i)
+    infos.append(AdBlockRequestInfo(requests.at(i), domains.at(i), urlStrings.at(i)));
+
+  calls = 0;
+  timer.start();
+  do {
+    for (int i = 0; i < infos.count(); ++i)
+      data->networkBlockTree.find(infos.at(i), domains.at(i), urlStrings.at(i));
+    calls += infos.count();
+  } while (timer.elapsed() < KERNEL_BENCH_TIME);
+  printResult("adblock tree find", calls, timer.nsecsElapsed());
+
+  delete data;
+  qDeleteAll(rules);
+}
+
+void KernelBenchmark::benchDates()
+{
+  QStringList dates = readLines(corpusPath_ % "/dates.txt");
+  if (dates.isEmpty()) {
+    printf("%-22s skipped, no dates.txt\n", "parseDate");
+    return;
+  }
+
+  ParseObject parseObject;
+  qint64 calls = 0;
+  int passes = 0;
+  int failed = 0;
+  QElapsedTimer timer;
+  timer.start();
+  do {
+    foreach (const QString &date, dates) {
+      if (parseObject.parseDate(date, QString()).isEmpty())
+        ++failed;
+    }
+    calls += dates.count();
+    ++passes;
+  } while (timer.elapsed() < KERNEL_BENCH_TIME);
+  printResult("parseDate", calls, timer.nsecsElapsed(), 0,
+              QString("%1 of %2 not parsed").arg(failed / passes).arg(dates.count()));
+
+  calls = 0;
+  passes = 0;
+  int fast = 0;
+  QDateTime dateTime;
+  timer.start();
+  do {
+    foreach (const QString &date, dates) {
+      if (parseObject.parseDateFast(date, &dateTime))
+        ++fast;
+    }
+    calls += dates.count();
+    ++passes;
+  } while (timer.elapsed() < KERNEL_BENCH_TIME);
+  printResult("parseDateFast", calls, timer.nsecsElapsed(), 0,
+              QString("%1 of %2 parsed").arg(fast / passes).arg(dates.count()));
+}
+
+void KernelBenchmark::benchEncoding()
+{
+  if (feeds_.isEmpty()) {
+    printf("%-22s skipped, no files in feeds/\n", "convertData");
+    return;
+  }
+
+  ParseWorker parseWorker;
+  qint64 calls = 0;
+  qint64 bytes = 0;
+  QElapsedTimer timer;
+  timer.start();
+  do {
+    foreach (const QByteArray &data, feeds_)
+      parseWorker.convertData(data, QString(), 0);
+    calls += feeds_.count();
+    bytes += feedsSize_;
+  } while (timer.elapsed() < KERNEL_BENCH_TIME);
+  printResult("convertData", calls, timer.nsecsElapsed(), bytes);
+}
+
+void KernelBenchmark::benchSanitizer()
+{
+  if (feeds_.isEmpty()) {
+    printf("%-22s skipped, no files in feeds/\n", "sanitizeData");
+    return;
+  }
+
+  qint64 calls = 0;
+  qint64 bytes = 0;
+  QElapsedTimer timer;
+  timer.start();
+  do {
+    foreach (const QByteArray &data, feeds_)
+      RequestFeed::sanitizeData(data);
+    calls += feeds_.count();
+    bytes += feedsSize_;
+  } while (timer.elapsed() < KERNEL_BENCH_TIME);
+  printResult("sanitizeData", calls, timer.nsecsElapsed(), bytes);
+}
+
+/** @brief Plain text of item titles and descriptions as parse workers make it
+ *----------------------------------------------------------------------------*/
+void KernelBenchmark::benchPlainText()
+{
+  QStringList texts;
+  qint64 textsSize = 0;
+  foreach (const QByteArray &data, feeds_) {
+    QXmlStreamReader xml(data);
+    while (!xml.atEnd()) {
+      if (xml.readNext() != QXmlStreamReader::StartElement)
+        continue;
+      QStringRef name = xml.qualifiedName();
+      if ((name == "title") || (name == "description") || (name == "summary") ||
+          (name == "content") || (name == "content:encoded")) {
+        QString text = xml.readElementText(QXmlStreamReader::SkipChildElements);
+        textsSize += text.size() * sizeof(QChar);
+        texts.append(text);
+      }
+    }
+  }
+  if (texts.isEmpty()) {
+    printf("%-22s skipped, no item texts in feeds/\n", "htmlToPlainText");
+    return;
+  }
+
+  qint64 calls = 0;
+  qint64 bytes = 0;
+  QElapsedTimer timer;
+  timer.start();
+  do {
+    foreach (const QString &text, texts)
+      Common::htmlToPlainText(text);
+    calls += texts.count();
+    bytes += textsSize;
+  } while (timer.elapsed() < KERNEL_BENCH_TIME);
+  printResult("htmlToPlainText", calls, timer.nsecsElapsed(), bytes);
+}
+
+void KernelBenchmark::printResult(const QString &name, qint64 calls, qint64 nsecs,
+                                  qint64 bytes, const QString &info)
+{
+  double mbPerSecond = bytes ? (bytes / (1024.0 * 1024.0)) / (nsecs / 1e9) : 0;
+  printf("%-22s %10lld %12.1f %10.2f  %s\n", qPrintable(name), calls,
+         double(nsecs) / qMax(qint64(1), calls), mbPerSecond, qPrintable(info));
+  fflush(stdout);
+}
+
+QStringList KernelBenchmark::readLines(const QString &fileName)
+{
+  QStringList lines;
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    return lines;
+
+  QTextStream stream(&file);
+  stream.setCodec("UTF-8");
+  while (!stream.atEnd()) {
+    QString line = stream.readLine().trimmed();
+    if (!line.isEmpty())
+      lines.append(line);
+  }
+  return lines;
+}
@@ -0,0 +1,56 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef KERNELBENCHMARK_H
+#define KERNELBENCHMARK_H
+
+#include <QByteArray>
+#include <QList>
+#include <QStringList>
+
+/** @brief Micro-benchmarks of hot functions over recorded corpus
+ *
+ * Corpus directory contains easylist.txt (AdBlock list), urls.txt (one
+ * request URL per line), dates.txt (one date string per line) and feeds/
+ * (saved feed files). Missing parts are skipped. Every function is called
+ * over whole corpus again and again for KERNEL_BENCH_TIME, as QBENCHMARK
+ * does, and time of one call is printed.
+ *----------------------------------------------------------------------------*/
+class KernelBenchmark
+{
+public:
+  explicit KernelBenchmark(const QString &corpusPath);
+
+  int run();
+
+private:
+  void benchAdBlock();
+  void benchDates();
+  void benchEncoding();
+  void benchSanitizer();
+  void benchPlainText();
+  void printResult(const QString &name, qint64 calls, qint64 nsecs,
+                   qint64 bytes = 0, const QString &info = QString());
+  static QStringList readLines(const QString &fileName);
+
+  QString corpusPath_;
+  QList<QByteArray> feeds_;
+  qint64 feedsSize_;
+
+};
+
+#endif // KERNELBENCHMARK_H
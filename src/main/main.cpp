@@ -37,6 +37,14 @@ int main(int argc, char **argv)
   qputenv("QT_DEVICE_PIXEL_RATIO", "auto");
 #endif
 
+#if defined(HAVE_QT5)
+  // Headless daemon has to start on server without display
+  for (int i = 1; i < argc; ++i) {
+    if (!qstrcmp(argv[i], "--headless") && qgetenv("QT_QPA_PLATFORM").isEmpty())
+      qputenv("QT_QPA_PLATFORM", "offscreen");
+  }
+#endif
+
   MainApplication app(argc, argv);
 
   if (app.isClosing())
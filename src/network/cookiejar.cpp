@@ -20,9 +20,43 @@
 #include "mainapplication.h"
 #include "settings.h"
 
-#include <QNetworkCookie>
 #include <QDateTime>
+#include <QDebug>
 #include <QDir>
+#include <QHostAddress>
+#include <QMutexLocker>
+#include <QUrl>
+
+#include <algorithm>
+
+// Marks file of cookies stored by fields instead of raw form
+#define COOKIES_FORMAT_FIELDS -1
+
+static bool sameIdentifier(const QNetworkCookie &cookie1, const QNetworkCookie &cookie2)
+{
+  return (cookie1.name() == cookie2.name()) &&
+      (cookie1.domain() == cookie2.domain()) &&
+      (cookie1.path() == cookie2.path());
+}
+
+static bool isExpired(const QNetworkCookie &cookie, const QDateTime &now)
+{
+  return !cookie.isSessionCookie() && (cookie.expirationDate() < now);
+}
+
+// Cookies with longer paths are sent first
+static bool pathLongerThan(const QNetworkCookie &cookie1, const QNetworkCookie &cookie2)
+{
+  return cookie1.path().length() > cookie2.path().length();
+}
+
+static bool isParentPath(const QString &path, const QString &reference)
+{
+  if (!path.startsWith(reference))
+    return false;
+  return (path.length() == reference.length()) || reference.endsWith('/') ||
+      (path.at(reference.length()) == '/');
+}
 
 CookieJar::CookieJar(QObject *parent)
   : QNetworkCookieJar(parent)
@@ -30,7 +64,7 @@ CookieJar::CookieJar(QObject *parent)
   loadCookies();
 }
 
-/** @brief Load cookies from file
+/** @brief Load cookies from file and apply journal of last session
  *----------------------------------------------------------------------------*/
 void CookieJar::loadCookies()
 {
@@ -39,36 +73,50 @@ void CookieJar::loadCookies()
 
   if (useCookies_ != SaveCookies) return;
 
-  if (!QFile::exists(mainApp->dataDir() + "/cookies.dat")) {
-    return;
-  }
+  QMutexLocker locker(&mutex_);
+  cookies_.clear();
 
   QDateTime now = QDateTime::currentDateTime();
 
-  QList<QNetworkCookie> loadedCookies;
   QFile file(mainApp->dataDir() + "/cookies.dat");
-  file.open(QIODevice::ReadOnly);
-  QDataStream stream(&file);
-  int count;
-
-  stream >> count;
-  for (int i = 0; i < count; i++) {
-    QByteArray rawForm;
-    stream >> rawForm;
-    const QList<QNetworkCookie> &cookieList = QNetworkCookie::parseCookies(rawForm);
-    if (cookieList.isEmpty()) {
-      continue;
-    }
+  if (file.open(QIODevice::ReadOnly)) {
+    QDataStream stream(&file);
+    int count;
 
-    const QNetworkCookie &cookie = cookieList.at(0);
-    if (cookie.expirationDate() < now) {
-      continue;
+    stream >> count;
+    if (count == COOKIES_FORMAT_FIELDS) {
+      stream.setVersion(QDataStream::Qt_4_6);
+      stream >> count;
+      for (int i = 0; (i < count) && (stream.status() == QDataStream::Ok); i++) {
+        QNetworkCookie cookie = readCookie(stream);
+        if ((stream.status() == QDataStream::Ok) && !isExpired(cookie, now))
+          insertCookie(cookie);
+      }
+    } else {
+      // Raw cookies saved by previous versions
+      for (int i = 0; i < count; i++) {
+        QByteArray rawForm;
+        stream >> rawForm;
+        const QList<QNetworkCookie> &cookieList = QNetworkCookie::parseCookies(rawForm);
+        if (cookieList.isEmpty()) {
+          continue;
+        }
+
+        const QNetworkCookie &cookie = cookieList.at(0);
+        if (cookie.expirationDate() < now) {
+          continue;
+        }
+        insertCookie(cookie);
+      }
     }
-    loadedCookies.append(cookie);
+    file.close();
   }
 
-  file.close();
-  setAllCookies(loadedCookies);
+  if (QFile::exists(mainApp->dataDir() + "/cookies.journal")) {
+    readJournal();
+    writeCookies();
+    removeJournal();
+  }
 }
 
 /** @brief Save cookies to file
@@ -80,52 +128,290 @@ void CookieJar::saveCookies()
 
   if (useCookies_ != SaveCookies) return;
 
-  QList<QNetworkCookie> allCookies = getAllCookies();
+  QMutexLocker locker(&mutex_);
+  writeCookies();
+  removeJournal();
+}
+
+/** @brief Write all persistent cookies into file
+ *----------------------------------------------------------------------------*/
+void CookieJar::writeCookies()
+{
+  QDateTime now = QDateTime::currentDateTime();
+  QList<QNetworkCookie> cookieList;
+  QHash<QString, QList<QNetworkCookie> >::const_iterator it = cookies_.constBegin();
+  for (; it != cookies_.constEnd(); ++it) {
+    foreach (const QNetworkCookie &cookie, it.value()) {
+      if (!cookie.isSessionCookie() && !isExpired(cookie, now))
+        cookieList.append(cookie);
+    }
+  }
 
   QFile file(mainApp->dataDir() + "/cookies.dat");
-  file.open(QIODevice::WriteOnly);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    qWarning() << "Cannot write cookies:" << file.errorString();
+    return;
+  }
   QDataStream stream(&file);
-  int count = allCookies.count();
 
-  stream << count;
-  for (int i = 0; i < count; i++) {
-    const QNetworkCookie &cookie = allCookies.at(i);
+  stream << (int)COOKIES_FORMAT_FIELDS;
+  stream.setVersion(QDataStream::Qt_4_6);
+  stream << cookieList.count();
+  foreach (const QNetworkCookie &cookie, cookieList)
+    writeCookie(stream, cookie);
+
+  file.close();
+}
 
-    if (cookie.isSessionCookie()) {
+/** @brief Apply changes of cookies, which were made after last save
+ *----------------------------------------------------------------------------*/
+void CookieJar::readJournal()
+{
+  QFile file(mainApp->dataDir() + "/cookies.journal");
+  if (!file.open(QIODevice::ReadOnly))
+    return;
+
+  QDataStream stream(&file);
+  stream.setVersion(QDataStream::Qt_4_6);
+  while (!stream.atEnd()) {
+    quint8 operation;
+    stream >> operation;
+    if (operation == JournalClear) {
+      cookies_.clear();
       continue;
     }
-    stream << cookie.toRawForm();
-  }
 
+    QNetworkCookie cookie = readCookie(stream);
+    // Last record may be cut by crash
+    if (stream.status() != QDataStream::Ok)
+      break;
+
+    if (operation == JournalInsert) {
+      insertCookie(cookie);
+    } else {
+      QHash<QString, QList<QNetworkCookie> >::iterator it = cookies_.find(cookie.domain());
+      if (it == cookies_.end())
+        continue;
+      for (int i = it.value().count() - 1; i >= 0; --i) {
+        if (sameIdentifier(it.value().at(i), cookie))
+          it.value().removeAt(i);
+      }
+      if (it.value().isEmpty())
+        cookies_.erase(it);
+    }
+  }
   file.close();
 }
 
+/** @brief Append change of persistent cookie to journal
+ *----------------------------------------------------------------------------*/
+void CookieJar::writeJournal(JournalOperation operation, const QNetworkCookie &cookie)
+{
+  if (!journal_.isOpen()) {
+    journal_.setFileName(mainApp->dataDir() + "/cookies.journal");
+    if (!journal_.open(QIODevice::WriteOnly | QIODevice::Append)) {
+      qWarning() << "Cannot write cookies journal:" << journal_.errorString();
+      return;
+    }
+  }
+
+  QDataStream stream(&journal_);
+  stream.setVersion(QDataStream::Qt_4_6);
+  stream << (quint8)operation;
+  if (operation != JournalClear)
+    writeCookie(stream, cookie);
+  journal_.flush();
+}
+
+void CookieJar::removeJournal()
+{
+  journal_.close();
+  QFile::remove(mainApp->dataDir() + "/cookies.journal");
+}
+
+void CookieJar::writeCookie(QDataStream &stream, const QNetworkCookie &cookie)
+{
+  stream << cookie.name() << cookie.value() << cookie.domain() << cookie.path()
+         << cookie.expirationDate() << cookie.isSecure() << cookie.isHttpOnly();
+}
+
+QNetworkCookie CookieJar::readCookie(QDataStream &stream)
+{
+  QByteArray name;
+  QByteArray value;
+  QString domain;
+  QString path;
+  QDateTime expirationDate;
+  bool secure;
+  bool httpOnly;
+  stream >> name >> value >> domain >> path >> expirationDate >> secure >> httpOnly;
+
+  QNetworkCookie cookie(name, value);
+  cookie.setDomain(domain);
+  cookie.setPath(path);
+  cookie.setExpirationDate(expirationDate);
+  cookie.setSecure(secure);
+  cookie.setHttpOnly(httpOnly);
+  return cookie;
+}
+
+/** @brief Store cookie replacing cookie with same name, domain and path
+ * @param persistentRemoved set if persistent cookie was replaced or deleted
+ * @return false if cookie is expired and only deletes previous one
+ *----------------------------------------------------------------------------*/
+bool CookieJar::insertCookie(const QNetworkCookie &cookie, bool *persistentRemoved)
+{
+  QList<QNetworkCookie> &cookieList = cookies_[cookie.domain()];
+  for (int i = cookieList.count() - 1; i >= 0; --i) {
+    if (sameIdentifier(cookieList.at(i), cookie)) {
+      if (persistentRemoved && !cookieList.at(i).isSessionCookie())
+        *persistentRemoved = true;
+      cookieList.removeAt(i);
+    }
+  }
+
+  if (isExpired(cookie, QDateTime::currentDateTime())) {
+    if (cookieList.isEmpty())
+      cookies_.remove(cookie.domain());
+    return false;
+  }
+  cookieList.append(cookie);
+  return true;
+}
+
+/** @brief Find cookies of host and its parent domains
+ *----------------------------------------------------------------------------*/
+QList<QNetworkCookie> CookieJar::cookiesForUrl(const QUrl &url) const
+{
+  QList<QNetworkCookie> result;
+  if (!url.isValid())
+    return result;
+
+  QString host = url.host().toLower();
+  QString path = url.path();
+  if (path.isEmpty())
+    path = "/";
+  bool encrypted = (url.scheme().toLower() == "https");
+  QDateTime now = QDateTime::currentDateTime();
+
+  // Host-only cookies and domain cookies of host and each parent domain
+  QStringList domains;
+  domains.append(host);
+  QString parent = host;
+  while (!parent.isEmpty()) {
+    domains.append("." + parent);
+    int index = parent.indexOf('.');
+    if (index < 0)
+      break;
+    parent = parent.mid(index + 1);
+  }
+
+  QMutexLocker locker(&mutex_);
+  foreach (const QString &domain, domains) {
+    QHash<QString, QList<QNetworkCookie> >::iterator it = cookies_.find(domain);
+    if (it == cookies_.end())
+      continue;
+
+    QList<QNetworkCookie> &cookieList = it.value();
+    for (int i = cookieList.count() - 1; i >= 0; --i) {
+      const QNetworkCookie &cookie = cookieList.at(i);
+      if (isExpired(cookie, now)) {
+        cookieList.removeAt(i);
+        continue;
+      }
+      if (cookie.isSecure() && !encrypted)
+        continue;
+      if (!isParentPath(path, cookie.path()))
+        continue;
+      result.append(cookie);
+    }
+    if (cookieList.isEmpty())
+      cookies_.erase(it);
+  }
+  locker.unlock();
+
+  std::stable_sort(result.begin(), result.end(), pathLongerThan);
+  return result;
+}
+
 bool CookieJar::setCookiesFromUrl(const QList<QNetworkCookie> &cookieList, const QUrl &url)
 {
   if (useCookies_ == BlockCookies)
     return false;
-  return QNetworkCookieJar::setCookiesFromUrl(cookieList, url);
+
+  QString host = url.host().toLower();
+  QString defaultPath = url.path();
+  defaultPath.truncate(defaultPath.lastIndexOf('/') + 1);
+  if (defaultPath.isEmpty())
+    defaultPath = "/";
+
+  bool added = false;
+  QMutexLocker locker(&mutex_);
+  foreach (QNetworkCookie cookie, cookieList) {
+    if (cookie.path().isEmpty())
+      cookie.setPath(defaultPath);
+
+    QString domain = cookie.domain().toLower();
+    if (domain.isEmpty()) {
+      domain = host;
+    } else if (QHostAddress(domain).isNull()) {
+      if (!domain.startsWith('.'))
+        domain.prepend('.');
+      // Domain must be parent of host and not top-level domain
+      if ((host != domain.mid(1)) && !host.endsWith(domain))
+        continue;
+      if (!domain.mid(1).contains('.'))
+        continue;
+    } else if (domain != host) {
+      continue;
+    }
+    cookie.setDomain(domain);
+
+    bool persistentRemoved = false;
+    bool stored = insertCookie(cookie, &persistentRemoved);
+    if (stored)
+      added = true;
+
+    if (useCookies_ == SaveCookies) {
+      if (stored && !cookie.isSessionCookie())
+        writeJournal(JournalInsert, cookie);
+      else if (persistentRemoved)
+        writeJournal(JournalRemove, cookie);
+    }
+  }
+  return added;
 }
 
 /** @brief Clear all cookies
  *----------------------------------------------------------------------------*/
 void CookieJar::clearCookies()
 {
-  setAllCookies(QList<QNetworkCookie>());
+  QMutexLocker locker(&mutex_);
+  cookies_.clear();
+  if (useCookies_ == SaveCookies)
+    writeJournal(JournalClear);
 }
 
 /** @brief Retrive all cookies
  *----------------------------------------------------------------------------*/
 QList<QNetworkCookie> CookieJar::getAllCookies()
 {
-  return QNetworkCookieJar::allCookies();
+  QMutexLocker locker(&mutex_);
+  QList<QNetworkCookie> result;
+  QHash<QString, QList<QNetworkCookie> >::const_iterator it = cookies_.constBegin();
+  for (; it != cookies_.constEnd(); ++it)
+    result.append(it.value());
+  return result;
 }
 
 /** @brief Setup cookies from list
  *----------------------------------------------------------------------------*/
 void CookieJar::setAllCookies(const QList<QNetworkCookie> &cookieList)
 {
-  QNetworkCookieJar::setAllCookies(cookieList);
+  QMutexLocker locker(&mutex_);
+  cookies_.clear();
+  foreach (const QNetworkCookie &cookie, cookieList)
+    insertCookie(cookie);
 }
 
 UseCookies CookieJar::useCookies() const
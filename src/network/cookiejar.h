@@ -19,7 +19,10 @@
 #define COOKIEJAR_H
 
 #include <QFile>
+#include <QHash>
+#include <QMutex>
 #include <QStringList>
+#include <QNetworkCookie>
 #include <QNetworkCookieJar>
 
 enum UseCookies {
@@ -28,12 +31,21 @@ enum UseCookies {
   DeleteCookiesOnClose
 };
 
+/** @brief Cookie storage indexed by domain
+ *
+ * Cookies are kept in hash by domain, so cookies for request are searched
+ * only among cookies of the host and its parent domains. Changes of
+ * persistent cookies are appended to journal, whole file is rewritten
+ * only on load and exit. Jar is shared between network threads, so access
+ * is serialized by mutex.
+ *----------------------------------------------------------------------------*/
 class CookieJar : public QNetworkCookieJar
 {
   Q_OBJECT
 public:
   explicit CookieJar(QObject *parent);
 
+  QList<QNetworkCookie> cookiesForUrl(const QUrl &url) const;
   bool setCookiesFromUrl(const QList<QNetworkCookie> &cookieList, const QUrl &url);
 
   QList<QNetworkCookie> getAllCookies();
@@ -49,7 +61,25 @@ public slots:
   void clearCookies();
 
 private:
+  enum JournalOperation {
+    JournalInsert,
+    JournalRemove,
+    JournalClear
+  };
+
+  bool insertCookie(const QNetworkCookie &cookie, bool *persistentRemoved = 0);
+  void writeJournal(JournalOperation operation, const QNetworkCookie &cookie = QNetworkCookie());
+  void readJournal();
+  void writeCookies();
+  void removeJournal();
+  static void writeCookie(QDataStream &stream, const QNetworkCookie &cookie);
+  static QNetworkCookie readCookie(QDataStream &stream);
+
   UseCookies useCookies_;
+  mutable QMutex mutex_;
+  // Cookies by domain, domain cookies have leading dot
+  mutable QHash<QString, QList<QNetworkCookie> > cookies_;
+  QFile journal_;
 
 };
 
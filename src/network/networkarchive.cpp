@@ -0,0 +1,403 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "networkarchive.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QMutexLocker>
+#include <QSslError>
+
+// Identifies file of archive and version of its format
+#define ARCHIVE_MAGIC 0x51524e41
+#define ARCHIVE_VERSION 1
+// Interval between chunks of body paced by bandwidth (msec)
+#define REPLAY_CHUNK_INTERVAL 50
+
+static QDataStream &operator<<(QDataStream &out, const NetworkArchive::Entry &entry)
+{
+  out << qint32(entry.operation) << entry.url << qint32(entry.status)
+      << entry.reason << entry.redirection << qint32(entry.headers.count());
+  for (int i = 0; i < entry.headers.count(); ++i)
+    out << entry.headers.at(i).first << entry.headers.at(i).second;
+  out << qCompress(entry.body) << qint32(entry.responseTime) << qint32(entry.duration)
+      << qint32(entry.error) << entry.errorString;
+  return out;
+}
+
+static QDataStream &operator>>(QDataStream &in, NetworkArchive::Entry &entry)
+{
+  qint32 operation, status, headersCount, responseTime, duration, error;
+  QByteArray body;
+  in >> operation >> entry.url >> status >> entry.reason >> entry.redirection >> headersCount;
+  entry.headers.clear();
+  for (int i = 0; (i < headersCount) && (in.status() == QDataStream::Ok); ++i) {
+    QPair<QByteArray, QByteArray> header;
+    in >> header.first >> header.second;
+    entry.headers.append(header);
+  }
+  in >> body >> responseTime >> duration >> error >> entry.errorString;
+  entry.operation = operation;
+  entry.status = status;
+  entry.body = qUncompress(body);
+  entry.responseTime = responseTime;
+  entry.duration = duration;
+  entry.error = error;
+  return in;
+}
+
+/** @brief Open archive for \a mode
+ * @param latency Time to headers of replayed reply (msec), -1 for recorded
+ * @param bandwidth Replayed bytes per second, 0 for recorded timing
+ *----------------------------------------------------------------------------*/
+NetworkArchive::NetworkArchive(Mode mode, const QString &fileName,
+                               int latency, int bandwidth)
+  : mode_(mode)
+  , file_(fileName)
+  , latency_(latency)
+  , bandwidth_(bandwidth)
+  , count_(0)
+{
+  if (mode_ == Record) {
+    if (!file_.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+      qWarning() << "Network archive not created:" << fileName << file_.errorString();
+      return;
+    }
+    QDataStream out(&file_);
+    out.setVersion(QDataStream::Qt_4_6);
+    out << quint32(ARCHIVE_MAGIC) << quint32(ARCHIVE_VERSION);
+    file_.flush();
+  } else if (!load()) {
+    qWarning() << "Network archive not loaded:" << fileName;
+  }
+}
+
+NetworkArchive::~NetworkArchive()
+{
+  if (mode_ == Record)
+    qWarning() << "Network archive recorded:" << file_.fileName() << count_;
+  file_.close();
+}
+
+bool NetworkArchive::load()
+{
+  if (!file_.open(QIODevice::ReadOnly))
+    return false;
+
+  QDataStream in(&file_);
+  in.setVersion(QDataStream::Qt_4_6);
+  quint32 magic, version;
+  in >> magic >> version;
+  if ((magic != ARCHIVE_MAGIC) || (version != ARCHIVE_VERSION)) {
+    file_.close();
+    return false;
+  }
+
+  while (!in.atEnd()) {
+    Entry entry;
+    in >> entry;
+    if (in.status() != QDataStream::Ok) {
+      qWarning() << "Network archive is truncated:" << file_.fileName() << count_;
+      break;
+    }
+    entries_[key(entry.operation, entry.url)].append(entry);
+    count_++;
+  }
+  qWarning() << "Network archive loaded:" << file_.fileName() << count_;
+  return true;
+}
+
+QString NetworkArchive::key(int operation, const QString &url)
+{
+  return QString::number(operation) + QLatin1Char(' ') + url;
+}
+
+/** @brief Return reply passing \a reply through to archive it at finish
+ *----------------------------------------------------------------------------*/
+QNetworkReply *NetworkArchive::record(QNetworkReply *reply, QObject *parent)
+{
+  return new RecordNetworkReply(reply, this, parent);
+}
+
+/** @brief Return reply served from archive instead of network
+ *
+ * URL missing in archive gets error same as unknown host.
+ *----------------------------------------------------------------------------*/
+QNetworkReply *NetworkArchive::replay(QNetworkAccessManager::Operation op,
+                                      const QNetworkRequest &request, QObject *parent)
+{
+  Entry entry;
+  {
+    QMutexLocker locker(&mutex_);
+    QHash<QString, QList<Entry> >::iterator it =
+        entries_.find(key(op, request.url().toString()));
+    if (it != entries_.end()) {
+      entry = (it.value().count() > 1) ? it.value().takeFirst() : it.value().first();
+    } else {
+      entry.error = QNetworkReply::HostNotFoundError;
+      entry.errorString = QString("Not in network archive: %1").arg(request.url().toString());
+      entry.responseTime = qMax(latency_, 0);
+      entry.duration = entry.responseTime;
+    }
+  }
+  return new ReplayNetworkReply(entry, op, request, latency_, bandwidth_, parent);
+}
+
+void NetworkArchive::append(const Entry &entry)
+{
+  QMutexLocker locker(&mutex_);
+  if (!file_.isOpen()) return;
+
+  QDataStream out(&file_);
+  out.setVersion(QDataStream::Qt_4_6);
+  out << entry;
+  // Archive stays usable when application is killed in the middle of refresh
+  file_.flush();
+  count_++;
+}
+
+//------------------------------------------------------------------------------
+RecordNetworkReply::RecordNetworkReply(QNetworkReply *reply, NetworkArchive *archive,
+                                       QObject *parent)
+  : QNetworkReply(parent)
+  , reply_(reply)
+  , archive_(archive)
+{
+  clock_.start();
+  reply_->setParent(this);
+  setRequest(reply_->request());
+  setUrl(reply_->url());
+  setOperation(reply_->operation());
+  entry_.operation = reply_->operation();
+  entry_.url = reply_->request().url().toString();
+  entry_.responseTime = -1;
+  open(QIODevice::ReadOnly);
+
+  connect(reply_, SIGNAL(metaDataChanged()), this, SLOT(slotMetaDataChanged()));
+  connect(reply_, SIGNAL(readyRead()), this, SLOT(slotReadyRead()));
+  connect(reply_, SIGNAL(finished()), this, SLOT(slotFinished()));
+  connect(reply_, SIGNAL(downloadProgress(qint64,qint64)),
+          this, SIGNAL(downloadProgress(qint64,qint64)));
+  connect(reply_, SIGNAL(uploadProgress(qint64,qint64)),
+          this, SIGNAL(uploadProgress(qint64,qint64)));
+  connect(reply_, SIGNAL(sslErrors(QList<QSslError>)),
+          this, SIGNAL(sslErrors(QList<QSslError>)));
+#if QT_VERSION >= 0x050100
+  connect(reply_, SIGNAL(encrypted()), this, SIGNAL(encrypted()));
+#endif
+}
+
+void RecordNetworkReply::abort()
+{
+  reply_->abort();
+}
+
+qint64 RecordNetworkReply::bytesAvailable() const
+{
+  return buffer_.size() + QNetworkReply::bytesAvailable();
+}
+
+void RecordNetworkReply::ignoreSslErrors()
+{
+  reply_->ignoreSslErrors();
+}
+
+void RecordNetworkReply::ignoreSslErrorsImplementation(const QList<QSslError> &errors)
+{
+  reply_->ignoreSslErrors(errors);
+}
+
+#if QT_VERSION >= 0x050000
+void RecordNetworkReply::sslConfigurationImplementation(QSslConfiguration &configuration) const
+{
+  configuration = reply_->sslConfiguration();
+}
+#endif
+
+qint64 RecordNetworkReply::readData(char *data, qint64 maxSize)
+{
+  if (buffer_.isEmpty())
+    return isFinished() ? -1 : 0;
+
+  int size = int(qMin(maxSize, qint64(buffer_.size())));
+  memcpy(data, buffer_.constData(), size);
+  buffer_.remove(0, size);
+  return size;
+}
+
+void RecordNetworkReply::copyMetaData()
+{
+  foreach (const QByteArray &name, reply_->rawHeaderList())
+    setRawHeader(name, reply_->rawHeader(name));
+  setAttribute(QNetworkRequest::HttpStatusCodeAttribute,
+               reply_->attribute(QNetworkRequest::HttpStatusCodeAttribute));
+  setAttribute(QNetworkRequest::HttpReasonPhraseAttribute,
+               reply_->attribute(QNetworkRequest::HttpReasonPhraseAttribute));
+  setAttribute(QNetworkRequest::RedirectionTargetAttribute,
+               reply_->attribute(QNetworkRequest::RedirectionTargetAttribute));
+  setAttribute(QNetworkRequest::SourceIsFromCacheAttribute,
+               reply_->attribute(QNetworkRequest::SourceIsFromCacheAttribute));
+#if QT_VERSION >= 0x050900
+  setAttribute(QNetworkRequest::HTTP2WasUsedAttribute,
+               reply_->attribute(QNetworkRequest::HTTP2WasUsedAttribute));
+#endif
+}
+
+void RecordNetworkReply::slotMetaDataChanged()
+{
+  if (entry_.responseTime < 0)
+    entry_.responseTime = int(clock_.elapsed());
+  copyMetaData();
+  emit metaDataChanged();
+}
+
+void RecordNetworkReply::slotReadyRead()
+{
+  QByteArray data = reply_->readAll();
+  if (data.isEmpty()) return;
+
+  buffer_.append(data);
+  entry_.body.append(data);
+  emit readyRead();
+}
+
+void RecordNetworkReply::slotFinished()
+{
+  slotReadyRead();
+  copyMetaData();
+  if (reply_->error() != QNetworkReply::NoError)
+    setError(reply_->error(), reply_->errorString());
+
+  entry_.status = reply_->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+  entry_.reason = reply_->attribute(QNetworkRequest::HttpReasonPhraseAttribute).toByteArray();
+  entry_.redirection = reply_->attribute(QNetworkRequest::RedirectionTargetAttribute).toUrl().toString();
+  entry_.headers = reply_->rawHeaderPairs();
+  entry_.duration = int(clock_.elapsed());
+  if (entry_.responseTime < 0)
+    entry_.responseTime = entry_.duration;
+  entry_.error = reply_->error();
+  entry_.errorString = reply_->errorString();
+  // Canceled replies depend on consumer, not on server
+  if (entry_.error != QNetworkReply::OperationCanceledError)
+    archive_->append(entry_);
+  entry_.body.clear();
+
+  setFinished(true);
+  if (error() != QNetworkReply::NoError)
+    emit error(error());
+  emit finished();
+}
+
+//------------------------------------------------------------------------------
+ReplayNetworkReply::ReplayNetworkReply(const NetworkArchive::Entry &entry,
+                                       QNetworkAccessManager::Operation op,
+                                       const QNetworkRequest &request,
+                                       int latency, int bandwidth, QObject *parent)
+  : QNetworkReply(parent)
+  , entry_(entry)
+  , bandwidth_(bandwidth)
+  , shaped_((latency >= 0) || (bandwidth > 0))
+  , headersSent_(false)
+  , available_(0)
+  , offset_(0)
+{
+  clock_.start();
+  setRequest(request);
+  setUrl(request.url());
+  setOperation(op);
+  open(QIODevice::ReadOnly);
+
+  timer_.setSingleShot(true);
+  connect(&timer_, SIGNAL(timeout()), this, SLOT(slotTimeout()));
+  timer_.start((latency >= 0) ? latency : entry_.responseTime);
+}
+
+void ReplayNetworkReply::abort()
+{
+  if (isFinished()) return;
+
+  entry_.error = QNetworkReply::OperationCanceledError;
+  entry_.errorString = QString("Operation canceled");
+  finish();
+}
+
+qint64 ReplayNetworkReply::bytesAvailable() const
+{
+  return (available_ - offset_) + QNetworkReply::bytesAvailable();
+}
+
+qint64 ReplayNetworkReply::readData(char *data, qint64 maxSize)
+{
+  if (offset_ >= available_)
+    return isFinished() ? -1 : 0;
+
+  int size = int(qMin(maxSize, qint64(available_ - offset_)));
+  memcpy(data, entry_.body.constData() + offset_, size);
+  offset_ += size;
+  return size;
+}
+
+/** @brief Send headers, next chunk of body or finish, as time has come
+ *----------------------------------------------------------------------------*/
+void ReplayNetworkReply::slotTimeout()
+{
+  if (!headersSent_ && entry_.status) {
+    headersSent_ = true;
+    for (int i = 0; i < entry_.headers.count(); ++i)
+      setRawHeader(entry_.headers.at(i).first, entry_.headers.at(i).second);
+    setAttribute(QNetworkRequest::HttpStatusCodeAttribute, entry_.status);
+    setAttribute(QNetworkRequest::HttpReasonPhraseAttribute, entry_.reason);
+    if (!entry_.redirection.isEmpty())
+      setAttribute(QNetworkRequest::RedirectionTargetAttribute, QUrl(entry_.redirection));
+    emit metaDataChanged();
+    if (isFinished()) return;
+  }
+
+  int chunk = entry_.body.size() - available_;
+  if (bandwidth_ > 0)
+    chunk = qMin(chunk, qMax(1, int(qint64(bandwidth_) * REPLAY_CHUNK_INTERVAL / 1000)));
+  if (chunk > 0) {
+    available_ += chunk;
+    emit downloadProgress(available_, entry_.body.size());
+    emit readyRead();
+    // Consumer may abort reply on data it has read
+    if (isFinished()) return;
+  }
+
+  if (available_ < entry_.body.size()) {
+    timer_.start(REPLAY_CHUNK_INTERVAL);
+    return;
+  }
+
+  qint64 remaining = shaped_ ? 0 : entry_.duration - clock_.elapsed();
+  if (remaining > 0) {
+    timer_.start(int(remaining));
+    return;
+  }
+  finish();
+}
+
+void ReplayNetworkReply::finish()
+{
+  timer_.stop();
+  setFinished(true);
+  if (entry_.error != QNetworkReply::NoError) {
+    setError(QNetworkReply::NetworkError(entry_.error), entry_.errorString);
+    emit error(error());
+  }
+  emit finished();
+}
@@ -0,0 +1,160 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef NETWORKARCHIVE_H
+#define NETWORKARCHIVE_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QPair>
+#include <QTimer>
+
+/** @brief File of HTTP responses recorded by feed fetching and replayed back
+ *
+ * In record mode the replies of feed manager are passed through and every
+ * finished one is appended with its timing. In replay mode no network is
+ * used: replies are served from file in recorded order for each URL, with
+ * recorded timing or with fixed latency and bandwidth.
+ *----------------------------------------------------------------------------*/
+class NetworkArchive
+{
+public:
+  enum Mode { Record, Replay };
+
+  struct Entry {
+    Entry() : operation(0), status(0), responseTime(0), duration(0), error(0) {}
+    int operation;
+    QString url;
+    int status;
+    QByteArray reason;
+    QString redirection;
+    QList<QPair<QByteArray, QByteArray> > headers;
+    QByteArray body;
+    // Time from request to headers and to end of reply (msec)
+    int responseTime;
+    int duration;
+    int error;
+    QString errorString;
+  };
+
+  NetworkArchive(Mode mode, const QString &fileName,
+                 int latency = -1, int bandwidth = 0);
+  ~NetworkArchive();
+
+  bool isOpen() const { return file_.isOpen(); }
+  Mode mode() const { return mode_; }
+  int count() const { return count_; }
+
+  QNetworkReply *record(QNetworkReply *reply, QObject *parent);
+  QNetworkReply *replay(QNetworkAccessManager::Operation op,
+                        const QNetworkRequest &request, QObject *parent);
+  void append(const Entry &entry);
+
+private:
+  bool load();
+  static QString key(int operation, const QString &url);
+
+  Mode mode_;
+  QFile file_;
+  int latency_;
+  int bandwidth_;
+  int count_;
+  QMutex mutex_;
+  // Recorded replies of each URL, last one is served again when more
+  // requests come than were recorded
+  QHash<QString, QList<Entry> > entries_;
+
+};
+
+/** @brief Reply of network passed through to consumer and archived at finish
+ *----------------------------------------------------------------------------*/
+class RecordNetworkReply : public QNetworkReply
+{
+  Q_OBJECT
+public:
+  RecordNetworkReply(QNetworkReply *reply, NetworkArchive *archive, QObject *parent = 0);
+
+  void abort();
+  qint64 bytesAvailable() const;
+
+public slots:
+  void ignoreSslErrors();
+
+protected:
+  qint64 readData(char *data, qint64 maxSize);
+  void ignoreSslErrorsImplementation(const QList<QSslError> &errors);
+#if QT_VERSION >= 0x050000
+  void sslConfigurationImplementation(QSslConfiguration &configuration) const;
+#endif
+
+private slots:
+  void slotMetaDataChanged();
+  void slotReadyRead();
+  void slotFinished();
+
+private:
+  void copyMetaData();
+
+  QNetworkReply *reply_;
+  NetworkArchive *archive_;
+  NetworkArchive::Entry entry_;
+  QElapsedTimer clock_;
+  QByteArray buffer_;
+
+};
+
+/** @brief Reply served from archive
+ *----------------------------------------------------------------------------*/
+class ReplayNetworkReply : public QNetworkReply
+{
+  Q_OBJECT
+public:
+  ReplayNetworkReply(const NetworkArchive::Entry &entry,
+                     QNetworkAccessManager::Operation op, const QNetworkRequest &request,
+                     int latency, int bandwidth, QObject *parent = 0);
+
+  void abort();
+  qint64 bytesAvailable() const;
+
+protected:
+  qint64 readData(char *data, qint64 maxSize);
+
+private slots:
+  void slotTimeout();
+
+private:
+  void finish();
+
+  NetworkArchive::Entry entry_;
+  int bandwidth_;
+  bool shaped_;
+  bool headersSent_;
+  // Bytes of body already given to consumer and already read by it
+  int available_;
+  int offset_;
+  QElapsedTimer clock_;
+  QTimer timer_;
+
+};
+
+#endif // NETWORKARCHIVE_H
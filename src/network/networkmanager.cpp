@@ -22,14 +22,34 @@
 #include "settings.h"
 #include "authenticationdialog.h"
 #include "adblockmanager.h"
+#include "networkarchive.h"
 #include "webpage.h"
 #include "sslerrordialog.h"
-#include "cabundleupdater.h"
+#include "thumbnailreply.h"
 
+#include <QNetworkProxy>
 #include <QNetworkReply>
 #include <QSslSocket>
+#include <QWebFrame>
 #include <QDebug>
 
+// Time while resolved host is kept in Qt host cache (sec)
+#define DNS_CACHE_TIME 60
+// Time until failed host is resolved again (sec)
+#define DNS_FAILED_TIME 300
+// Bytes of page searched for RSS links
+#define FEED_LINKS_SCAN_SIZE 16384
+// Number of pages with remembered RSS links
+#define FEED_LINKS_CACHE_SIZE 500
+// Number of hosts with remembered TLS session ticket
+#define SESSION_TICKETS_CACHE_SIZE 1000
+
+QMutex NetworkManager::sslMutex_;
+QSslConfiguration NetworkManager::sslConfiguration_;
+QCache<QString, QByteArray> NetworkManager::sessionTickets_(SESSION_TICKETS_CACHE_SIZE);
+qint64 NetworkManager::handshakes_ = 0;
+qint64 NetworkManager::ticketHandshakes_ = 0;
+
 static QString fileNameForCert(const QSslCertificate &cert)
 {
   QString certFileName = SslErrorDialog::certificateItemText(cert);
@@ -48,6 +68,8 @@ NetworkManager::NetworkManager(bool isThread, QObject* parent)
   : QNetworkAccessManager(parent)
   , ignoreAllWarnings_(false)
   , adblockManager_(0)
+  , archive_(0)
+  , feedLinksCache_(FEED_LINKS_CACHE_SIZE)
 {
   setCookieJar(mainApp->cookieJar());
   // CookieJar is shared between NetworkManagers
@@ -78,6 +100,13 @@ NetworkManager::NetworkManager(bool isThread, QObject* parent)
 
     loadSettings();
   }
+
+#if QT_VERSION >= 0x050200
+  connect(this, SIGNAL(encrypted(QNetworkReply*)),
+          SLOT(slotEncrypted(QNetworkReply*)));
+  connect(this, SIGNAL(finished(QNetworkReply*)),
+          SLOT(slotSaveSessionTicket(QNetworkReply*)));
+#endif
 }
 
 NetworkManager::~NetworkManager()
@@ -161,10 +190,95 @@ void NetworkManager::loadCertificates()
   localCerts_ = QSslCertificate::fromPath(mainApp->dataDir() + "/certificates/*.crt", QSsl::Pem, QRegExp::Wildcard);
 #endif
 
-  QSslSocket::setDefaultCaCertificates(caCerts_ + localCerts_);
+  setSharedCertificates(caCerts_ + localCerts_);
+}
 
-#if defined(Q_OS_WIN) || defined(Q_OS_OS2)
-  new CaBundleUpdater(this, this);
+/** @brief Set CA certificates used by all managers
+ *
+ * Certificates are put in new shared configuration, so requests already
+ * created in other threads keep previous one.
+ *----------------------------------------------------------------------------*/
+void NetworkManager::setSharedCertificates(const QList<QSslCertificate> &certs)
+{
+  QSslSocket::setDefaultCaCertificates(certs);
+
+  QSslConfiguration configuration = QSslConfiguration::defaultConfiguration();
+  configuration.setCaCertificates(certs);
+#if QT_VERSION >= 0x050200
+  configuration.setSslOption(QSsl::SslOptionDisableSessionTickets, false);
+  configuration.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+#endif
+
+  QMutexLocker locker(&sslMutex_);
+  sslConfiguration_ = configuration;
+}
+
+/** @brief Shared configuration with last session ticket of \a host
+ *----------------------------------------------------------------------------*/
+QSslConfiguration NetworkManager::sslConfiguration(const QString &host)
+{
+  QMutexLocker locker(&sslMutex_);
+  // Certificates are not loaded yet
+  if (sslConfiguration_.isNull())
+    return QSslConfiguration::defaultConfiguration();
+
+  QSslConfiguration configuration = sslConfiguration_;
+#if QT_VERSION >= 0x050200
+  QByteArray *ticket = sessionTickets_.object(host);
+  if (ticket)
+    configuration.setSessionTicket(*ticket);
+#else
+  Q_UNUSED(host)
+#endif
+  return configuration;
+}
+
+/** @brief Number of TLS handshakes, of them with offered session ticket
+ *  and number of hosts with remembered ticket
+ *----------------------------------------------------------------------------*/
+void NetworkManager::tlsStatistics(qint64 *handshakes, qint64 *withTicket, int *hosts)
+{
+  QMutexLocker locker(&sslMutex_);
+  *handshakes = handshakes_;
+  *withTicket = ticketHandshakes_;
+  *hosts = sessionTickets_.count();
+}
+
+/** @brief Count new encrypted connection
+ *----------------------------------------------------------------------------*/
+void NetworkManager::slotEncrypted(QNetworkReply *reply)
+{
+#if QT_VERSION >= 0x050200
+  bool ticket = !reply->request().sslConfiguration().sessionTicket().isEmpty();
+  QMutexLocker locker(&sslMutex_);
+  handshakes_++;
+  if (ticket)
+    ticketHandshakes_++;
+#else
+  Q_UNUSED(reply)
+#endif
+}
+
+/** @brief Remember session ticket of finished reply for its host
+ *
+ * Server may send ticket after handshake, so it is taken at the end.
+ *----------------------------------------------------------------------------*/
+void NetworkManager::slotSaveSessionTicket(QNetworkReply *reply)
+{
+#if QT_VERSION >= 0x050200
+  if (reply->url().scheme() != QLatin1String("https"))
+    return;
+
+  QByteArray ticket = reply->sslConfiguration().sessionTicket();
+  if (ticket.isEmpty())
+    return;
+
+  QMutexLocker locker(&sslMutex_);
+  QByteArray *cached = sessionTickets_.object(reply->url().host());
+  if (!cached || (*cached != ticket))
+    sessionTickets_.insert(reply->url().host(), new QByteArray(ticket));
+#else
+  Q_UNUSED(reply)
 #endif
 }
 
@@ -307,6 +421,10 @@ QNetworkReply *NetworkManager::createRequest(QNetworkAccessManager::Operation op
 
     // Adblock
     if (op == QNetworkAccessManager::GetOperation) {
+      // Images of newspaper layout are served downscaled
+      if (ThumbnailReply::isThumbnailUrl(request.url()))
+        return new ThumbnailReply(request, this, this);
+
       if (!adblockManager_) {
         adblockManager_ = AdBlockManager::instance();
       }
@@ -315,10 +433,85 @@ QNetworkReply *NetworkManager::createRequest(QNetworkAccessManager::Operation op
       if (reply) {
         return reply;
       }
+
+      // Scanned before page reads the data, as connected first
+      QWebFrame *frame = qobject_cast<QWebFrame*>(request.originatingObject());
+      if (frame && !frame->parentFrame() &&
+          !feedLinksCache_.contains(request.url().toString(QUrl::RemoveFragment))) {
+        reply = QNetworkAccessManager::createRequest(op, request, outgoingData);
+        connect(reply, SIGNAL(readyRead()), this, SLOT(slotScanFeedLinks()));
+        return reply;
+      }
     }
   }
 
-  return QNetworkAccessManager::createRequest(op, request, outgoingData);
+  if (archive_ && (archive_->mode() == NetworkArchive::Replay))
+    return archive_->replay(op, request, this);
+
+  QNetworkReply *reply;
+  if (request.url().scheme() == QLatin1String("https")) {
+    QNetworkRequest sslRequest(request);
+    sslRequest.setSslConfiguration(sslConfiguration(request.url().host()));
+    reply = QNetworkAccessManager::createRequest(op, sslRequest, outgoingData);
+  } else {
+    reply = QNetworkAccessManager::createRequest(op, request, outgoingData);
+  }
+
+  if (archive_)
+    return archive_->record(reply, this);
+  return reply;
+}
+
+/** @brief Look for RSS links in head of page in first received data
+ *
+ * Data is only peeked, so page still reads it all.
+ *----------------------------------------------------------------------------*/
+void NetworkManager::slotScanFeedLinks()
+{
+  QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+  if (!reply) return;
+  disconnect(reply, SIGNAL(readyRead()), this, SLOT(slotScanFeedLinks()));
+
+  if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() != 200)
+    return;
+  if (!reply->header(QNetworkRequest::ContentTypeHeader).toString().contains("html", Qt::CaseInsensitive))
+    return;
+
+  const QByteArray data = reply->peek(FEED_LINKS_SCAN_SIZE).toLower();
+  int headEnd = data.indexOf("</head");
+  if (headEnd == -1)
+    headEnd = data.indexOf("<body");
+
+  bool hasFeed = false;
+  int pos = 0;
+  while ((pos = data.indexOf("<link", pos)) != -1) {
+    if ((headEnd != -1) && (pos > headEnd))
+      break;
+    int end = data.indexOf('>', pos);
+    if (end == -1)
+      break;
+    if (data.mid(pos, end - pos).contains("application/rss+xml")) {
+      hasFeed = true;
+      break;
+    }
+    pos = end;
+  }
+
+  // Without end of head other links may follow in next data
+  if (hasFeed || (headEnd != -1))
+    feedLinksCache_.insert(reply->url().toString(QUrl::RemoveFragment), new bool(hasFeed));
+}
+
+/** @brief Get result of scan for RSS links of page \a url
+ * @return false if page was not scanned
+ *----------------------------------------------------------------------------*/
+bool NetworkManager::findFeedLinks(const QUrl &url, bool *hasFeed) const
+{
+  bool *found = feedLinksCache_.object(url.toString(QUrl::RemoveFragment));
+  if (!found)
+    return false;
+  *hasFeed = *found;
+  return true;
 }
 
 void NetworkManager::addRejectedCerts(const QList<QSslCertificate> &certs)
@@ -346,7 +539,9 @@ bool NetworkManager::containsRejectedCerts(const QList<QSslCertificate> &certs)
 void NetworkManager::addLocalCertificate(const QSslCertificate &cert)
 {
   localCerts_.append(cert);
-  QSslSocket::addDefaultCaCertificate(cert);
+  QList<QSslCertificate> certs = QSslSocket::defaultCaCertificates();
+  certs.append(cert);
+  setSharedCertificates(certs);
 
   QDir dir(mainApp->dataDir());
   if (!dir.exists("certificates")) {
@@ -372,7 +567,7 @@ void NetworkManager::removeLocalCertificate(const QSslCertificate &cert)
 
   QList<QSslCertificate> certs = QSslSocket::defaultCaCertificates();
   certs.removeOne(cert);
-  QSslSocket::setDefaultCaCertificates(certs);
+  setSharedCertificates(certs);
 
   // Delete cert file from profile
   bool deleted = false;
@@ -400,3 +595,50 @@ void NetworkManager::removeLocalCertificate(const QSslCertificate &cert)
     qWarning() << "NetworkManager::removeLocalCertificate cannot remove certificate";
   }
 }
+
+/** @brief Resolve host in advance
+ *
+ * Lookup is done in Qt thread pool, so hosts of queued feeds are resolved
+ * in parallel. Result is stored in Qt host cache which is used when reply
+ * connects to host later, so request does not wait for system resolver.
+ *----------------------------------------------------------------------------*/
+void NetworkManager::resolveHost(const QString &host)
+{
+  if (host.isEmpty()) return;
+  // Replayed replies need no hosts
+  if (archive_ && (archive_->mode() == NetworkArchive::Replay)) return;
+
+#ifndef QT_NO_NETWORKPROXY
+  // Host is resolved by proxy
+  QNetworkProxy::ProxyType proxyType = proxy().type();
+  if (proxyType == QNetworkProxy::DefaultProxy)
+    proxyType = QNetworkProxy::applicationProxy().type();
+  if ((proxyType == QNetworkProxy::HttpProxy) ||
+      (proxyType == QNetworkProxy::Socks5Proxy))
+    return;
+#endif
+
+  QDateTime currentTime = QDateTime::currentDateTimeUtc();
+  QHash<QString, QDateTime>::iterator it = resolvedHosts_.find(host);
+  if ((it != resolvedHosts_.end()) && (it.value() > currentTime)) return;
+  // Lookup is in progress
+  if (it != resolvedHosts_.end() && it.value().isNull()) return;
+
+  resolvedHosts_.insert(host, QDateTime());
+  int lookupId = QHostInfo::lookupHost(host, this, SLOT(slotHostResolved(QHostInfo)));
+  hostLookups_.insert(lookupId, host);
+}
+
+void NetworkManager::slotHostResolved(const QHostInfo &hostInfo)
+{
+  QString host = hostLookups_.take(hostInfo.lookupId());
+  if (host.isEmpty()) return;
+
+  QDateTime currentTime = QDateTime::currentDateTimeUtc();
+  if (hostInfo.error() == QHostInfo::NoError) {
+    resolvedHosts_.insert(host, currentTime.addSecs(DNS_CACHE_TIME));
+  } else {
+    qWarning() << "Resolve host error:" << host << hostInfo.errorString();
+    resolvedHosts_.insert(host, currentTime.addSecs(DNS_FAILED_TIME));
+  }
+}
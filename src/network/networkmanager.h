@@ -18,11 +18,18 @@
 #ifndef NETWORKMANAGER_H
 #define NETWORKMANAGER_H
 
+#include <QCache>
+#include <QDateTime>
+#include <QHash>
+#include <QHostInfo>
+#include <QMutex>
 #include <QNetworkAccessManager>
+#include <QSslConfiguration>
 #include <QSslError>
 #include <QStringList>
 
 class AdBlockManager;
+class NetworkArchive;
 
 class NetworkManager : public QNetworkAccessManager
 {
@@ -37,17 +44,28 @@ public:
 
   void loadSettings();
   void loadCertificates();
+  void resolveHost(const QString &host);
+  bool findFeedLinks(const QUrl &url, bool *hasFeed) const;
+  void setArchive(NetworkArchive *archive) { archive_ = archive; }
+
+  static QSslConfiguration sslConfiguration(const QString &host);
+  static void tlsStatistics(qint64 *handshakes, qint64 *withTicket, int *hosts);
 
 private slots:
   void slotAuthentication(QNetworkReply *reply, QAuthenticator *auth);
   void slotProxyAuthentication(const QNetworkProxy &proxy, QAuthenticator *auth);
   void slotSslError(QNetworkReply *reply, QList<QSslError> errors);
+  void slotHostResolved(const QHostInfo &hostInfo);
+  void slotScanFeedLinks();
+  void slotEncrypted(QNetworkReply *reply);
+  void slotSaveSessionTicket(QNetworkReply *reply);
 
 private:
   void addRejectedCerts(const QList<QSslCertificate> &certs);
   bool containsRejectedCerts(const QList<QSslCertificate> &certs);
   void addLocalCertificate(const QSslCertificate &cert);
   void removeLocalCertificate(const QSslCertificate &cert);
+  static void setSharedCertificates(const QList<QSslCertificate> &certs);
 
   QStringList certPaths_;
   QList<QSslCertificate> caCerts_;
@@ -57,6 +75,22 @@ private:
   QList<QSslCertificate> rejectedSslCerts_;
 
   AdBlockManager *adblockManager_;
+  // Records replies or serves them instead of network, if set
+  NetworkArchive *archive_;
+
+  QHash<QString, QDateTime> resolvedHosts_;
+  QHash<int, QString> hostLookups_;
+  // Pages with known answer if they have RSS link in head
+  QCache<QString, bool> feedLinksCache_;
+
+  // Configuration with loaded certificates shared by managers of all
+  // threads, it is replaced as whole when certificates change
+  static QMutex sslMutex_;
+  static QSslConfiguration sslConfiguration_;
+  // Last TLS session ticket of host to resume next connection
+  static QCache<QString, QByteArray> sessionTickets_;
+  static qint64 handshakes_;
+  static qint64 ticketHandshakes_;
 
 };
 
@@ -0,0 +1,271 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "sharednetworkcache.h"
+
+#include <QDateTime>
+#include <QDirIterator>
+#include <QMultiMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QNetworkDiskCache>
+
+// Cache is cut to this percentage of maximum size when it is exceeded
+#define CACHE_EVICTION_GOAL 90
+
+namespace {
+
+/** @brief Disk cache evicting least recently used entries
+ *
+ * QNetworkDiskCache removes oldest files first, here entries which were
+ * read recently are kept. Times of use are known only for current session,
+ * for other entries time of writing is used.
+ *----------------------------------------------------------------------------*/
+class CacheStore : public QNetworkDiskCache
+{
+public:
+  CacheStore()
+    : QNetworkDiskCache(0)
+    , evictions(0)
+  {
+  }
+
+  static QString urlKey(const QUrl &url)
+  {
+    return url.toString(QUrl::RemoveFragment);
+  }
+
+  void touch(const QUrl &url)
+  {
+    lastUse.insert(urlKey(url), QDateTime::currentMSecsSinceEpoch());
+  }
+
+  QHash<QString, qint64> lastUse;
+  qint64 evictions;
+
+protected:
+  qint64 expire();
+
+};
+
+/** @brief Calculate size of cache and remove entries exceeding maximum size
+ *----------------------------------------------------------------------------*/
+qint64 CacheStore::expire()
+{
+  if (cacheDirectory().isEmpty())
+    return 0;
+
+  QStringList files;
+  QList<qint64> sizes;
+  QList<qint64> times;
+  qint64 totalSize = 0;
+  QDirIterator it(cacheDirectory(), QDir::Files | QDir::NoDotAndDotDot,
+                  QDirIterator::Subdirectories);
+  while (it.hasNext()) {
+    QString path = it.next();
+    QFileInfo info = it.fileInfo();
+    // Files of unfinished replies
+    if (!info.fileName().endsWith(".d") || path.contains("/prepared/"))
+      continue;
+    files.append(path);
+    sizes.append(info.size());
+    times.append(info.lastModified().toMSecsSinceEpoch());
+    totalSize += info.size();
+  }
+
+  if (totalSize <= maximumCacheSize())
+    return totalSize;
+
+  QMultiMap<qint64, int> cacheItems;
+  for (int i = 0; i < files.count(); ++i) {
+    qint64 time = times.at(i);
+    if (!lastUse.isEmpty()) {
+      QHash<QString, qint64>::const_iterator used =
+          lastUse.constFind(urlKey(fileMetaData(files.at(i)).url()));
+      if (used != lastUse.constEnd())
+        time = qMax(time, used.value());
+    }
+    cacheItems.insert(time, i);
+  }
+
+  qint64 goal = maximumCacheSize() * CACHE_EVICTION_GOAL / 100;
+  QMultiMap<qint64, int>::const_iterator item = cacheItems.constBegin();
+  for (; (item != cacheItems.constEnd()) && (totalSize > goal); ++item) {
+    int index = item.value();
+    if (QFile::remove(files.at(index))) {
+      totalSize -= sizes.at(index);
+      evictions++;
+    }
+  }
+  return totalSize;
+}
+
+QMutex cacheMutex;
+// Store is used by network threads till exit, so it is never deleted
+CacheStore *store = 0;
+bool enabled = false;
+QVector<SharedNetworkCache::Statistics> cacheStatistics(SharedNetworkCache::SourceCount);
+
+} // namespace
+
+SharedNetworkCache::Statistics::Statistics()
+  : hits(0)
+  , misses(0)
+  , bytesRead(0)
+  , inserts(0)
+  , bytesWritten(0)
+{
+}
+
+SharedNetworkCache::SharedNetworkCache(Source source, QObject *parent)
+  : QAbstractNetworkCache(parent)
+  , source_(source)
+{
+}
+
+QNetworkCacheMetaData SharedNetworkCache::metaData(const QUrl &url)
+{
+  QMutexLocker locker(&cacheMutex);
+  if (!enabled)
+    return QNetworkCacheMetaData();
+
+  QNetworkCacheMetaData metaData = store->metaData(url);
+  if (!metaData.isValid())
+    cacheStatistics[source_].misses++;
+  return metaData;
+}
+
+void SharedNetworkCache::updateMetaData(const QNetworkCacheMetaData &metaData)
+{
+  QMutexLocker locker(&cacheMutex);
+  if (enabled)
+    store->updateMetaData(metaData);
+}
+
+QIODevice *SharedNetworkCache::data(const QUrl &url)
+{
+  QMutexLocker locker(&cacheMutex);
+  if (!enabled)
+    return 0;
+
+  QIODevice *device = store->data(url);
+  if (device) {
+    cacheStatistics[source_].hits++;
+    cacheStatistics[source_].bytesRead += device->size();
+    store->touch(url);
+  }
+  return device;
+}
+
+bool SharedNetworkCache::remove(const QUrl &url)
+{
+  QMutexLocker locker(&cacheMutex);
+  if (!store)
+    return false;
+  store->lastUse.remove(CacheStore::urlKey(url));
+  return store->remove(url);
+}
+
+qint64 SharedNetworkCache::cacheSize() const
+{
+  return diskUsage();
+}
+
+QIODevice *SharedNetworkCache::prepare(const QNetworkCacheMetaData &metaData)
+{
+  QMutexLocker locker(&cacheMutex);
+  if (!enabled)
+    return 0;
+  return store->prepare(metaData);
+}
+
+void SharedNetworkCache::insert(QIODevice *device)
+{
+  QMutexLocker locker(&cacheMutex);
+  if (!store)
+    return;
+  cacheStatistics[source_].inserts++;
+  cacheStatistics[source_].bytesWritten += device->size();
+  store->insert(device);
+}
+
+void SharedNetworkCache::clear()
+{
+  QMutexLocker locker(&cacheMutex);
+  if (!store)
+    return;
+  store->lastUse.clear();
+  store->clear();
+}
+
+/** @brief Enable cache and set its place and size
+ *----------------------------------------------------------------------------*/
+void SharedNetworkCache::setCacheDirectory(const QString &directory, qint64 maximumSize)
+{
+  QMutexLocker locker(&cacheMutex);
+  if (!store)
+    store = new CacheStore();
+  store->setMaximumCacheSize(maximumSize);
+  if (store->cacheDirectory() != directory)
+    store->setCacheDirectory(directory);
+  enabled = true;
+}
+
+/** @brief Stop use of cache and remove its entries
+ *----------------------------------------------------------------------------*/
+void SharedNetworkCache::disable()
+{
+  QMutexLocker locker(&cacheMutex);
+  enabled = false;
+  if (store) {
+    store->setMaximumCacheSize(0);
+    store->lastUse.clear();
+    store->clear();
+  }
+}
+
+QVector<SharedNetworkCache::Statistics> SharedNetworkCache::statistics()
+{
+  QMutexLocker locker(&cacheMutex);
+  return cacheStatistics;
+}
+
+qint64 SharedNetworkCache::evictions()
+{
+  QMutexLocker locker(&cacheMutex);
+  return store ? store->evictions : 0;
+}
+
+qint64 SharedNetworkCache::diskUsage()
+{
+  QMutexLocker locker(&cacheMutex);
+  return enabled ? store->cacheSize() : 0;
+}
+
+qint64 SharedNetworkCache::maximumCacheSize()
+{
+  QMutexLocker locker(&cacheMutex);
+  return enabled ? store->maximumCacheSize() : 0;
+}
+
+void SharedNetworkCache::resetStatistics()
+{
+  QMutexLocker locker(&cacheMutex);
+  cacheStatistics = QVector<Statistics>(SourceCount);
+  if (store)
+    store->evictions = 0;
+}
@@ -0,0 +1,79 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef SHAREDNETWORKCACHE_H
+#define SHAREDNETWORKCACHE_H
+
+#include <QAbstractNetworkCache>
+#include <QVector>
+
+/** @brief Front-end of disk cache shared between network managers
+ *
+ * Every NetworkManager owns its own front-end, while entries are kept in
+ * one QNetworkDiskCache, so data loaded by background threads is reused
+ * by browser. Access to disk cache is serialized by mutex. Entries are
+ * evicted by time of last use, hits and misses are counted by source.
+ *----------------------------------------------------------------------------*/
+class SharedNetworkCache : public QAbstractNetworkCache
+{
+  Q_OBJECT
+public:
+  enum Source {
+    Browser = 0,
+    Feeds,
+    Favicons,
+    Prefetch,
+    SourceCount
+  };
+
+  struct Statistics {
+    Statistics();
+    qint64 hits;
+    qint64 misses;
+    qint64 bytesRead;
+    qint64 inserts;
+    qint64 bytesWritten;
+  };
+
+  explicit SharedNetworkCache(Source source, QObject *parent = 0);
+
+  QNetworkCacheMetaData metaData(const QUrl &url);
+  void updateMetaData(const QNetworkCacheMetaData &metaData);
+  QIODevice *data(const QUrl &url);
+  bool remove(const QUrl &url);
+  qint64 cacheSize() const;
+  QIODevice *prepare(const QNetworkCacheMetaData &metaData);
+  void insert(QIODevice *device);
+
+  static void setCacheDirectory(const QString &directory, qint64 maximumSize);
+  static void disable();
+
+  static QVector<Statistics> statistics();
+  static qint64 evictions();
+  static qint64 diskUsage();
+  static qint64 maximumCacheSize();
+  static void resetStatistics();
+
+public slots:
+  void clear();
+
+private:
+  Source source_;
+
+};
+
+#endif // SHAREDNETWORKCACHE_H
@@ -0,0 +1,245 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "thumbnailreply.h"
+
+#include "mainapplication.h"
+
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QImageReader>
+#include <QTimer>
+#if QT_VERSION >= 0x050000
+#include <QUrlQuery>
+#endif
+#include <qzregexp.h>
+
+// Width of thumbnails is rounded up, so resize of view uses the same files
+#define THUMBNAIL_WIDTH_STEP 128
+#define THUMBNAIL_MAX_WIDTH 2048
+#define THUMBNAIL_QUALITY 85
+// Oldest thumbnails are removed above this size once per run
+#define THUMBNAIL_CACHE_SIZE (50*1024*1024)
+
+static bool cachePruned = false;
+
+ThumbnailReply::ThumbnailReply(const QNetworkRequest &request,
+                               QNetworkAccessManager *manager, QObject *parent)
+  : QNetworkReply(parent)
+  , width_(0)
+  , offset_(0)
+{
+  setRequest(request);
+  setUrl(request.url());
+  setOperation(QNetworkAccessManager::GetOperation);
+  open(QIODevice::ReadOnly);
+
+#if QT_VERSION >= 0x050000
+  QUrlQuery query(request.url());
+  width_ = query.queryItemValue("width").toInt();
+  source_ = QUrl::fromEncoded(query.queryItemValue("url", QUrl::FullyDecoded).toUtf8());
+#else
+  width_ = request.url().queryItemValue("width").toInt();
+  source_ = QUrl::fromEncoded(request.url().queryItemValue("url").toUtf8());
+#endif
+  width_ = qBound(THUMBNAIL_WIDTH_STEP, width_, THUMBNAIL_MAX_WIDTH);
+
+  if (!source_.isValid() || !source_.scheme().startsWith("http")) {
+    setError(QNetworkReply::ProtocolInvalidOperationError, "Invalid image URL");
+    QTimer::singleShot(0, this, SLOT(finish()));
+    return;
+  }
+
+  QByteArray key = source_.toEncoded() + ' ' + QByteArray::number(width_);
+  cacheFile_ = cacheDirPath() + "/" +
+      QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex();
+
+  QFile file(cacheFile_);
+  if (file.open(QFile::ReadOnly)) {
+    content_ = file.readAll();
+    QTimer::singleShot(0, this, SLOT(finish()));
+    return;
+  }
+
+  QNetworkRequest sourceRequest(source_);
+  sourceRequest.setRawHeader("User-Agent", request.rawHeader("User-Agent"));
+  sourceRequest.setAttribute(QNetworkRequest::CacheLoadControlAttribute,
+                             QNetworkRequest::PreferCache);
+  sourceReply_ = manager->get(sourceRequest);
+  connect(sourceReply_, SIGNAL(finished()), this, SLOT(slotSourceFinished()));
+}
+
+bool ThumbnailReply::isThumbnailUrl(const QUrl &url)
+{
+  return (url.scheme() == QLatin1String("quiterss")) &&
+      (url.host() == QLatin1String("thumbnail.ui"));
+}
+
+/** @brief Replace absolute image URLs of \a html by thumbnails of \a width
+ *----------------------------------------------------------------------------*/
+QString ThumbnailReply::rewriteImages(const QString &html, int width)
+{
+  width = ((width + THUMBNAIL_WIDTH_STEP - 1) / THUMBNAIL_WIDTH_STEP) * THUMBNAIL_WIDTH_STEP;
+
+  QString result;
+  QzRegExp reg("(<img[^>]+src\\s*=\\s*)([\"'])(https?://[^\"']+)\\2", Qt::CaseInsensitive);
+  int last = 0;
+  int pos = 0;
+  while ((pos = reg.indexIn(html, pos)) != -1) {
+    QString source = reg.cap(3);
+    source.replace("&amp;", "&");
+    result.append(html.mid(last, pos - last));
+    result.append(reg.cap(1) + reg.cap(2));
+    result.append(QString("quiterss://thumbnail.ui/?width=%1&amp;url=%2").
+                  arg(width).arg(QString::fromLatin1(QUrl::toPercentEncoding(source))));
+    result.append(reg.cap(2));
+    pos += reg.matchedLength();
+    last = pos;
+  }
+  if (!last)
+    return html;
+  result.append(html.mid(last));
+  return result;
+}
+
+void ThumbnailReply::abort()
+{
+  if (isFinished()) return;
+
+  if (sourceReply_) {
+    sourceReply_->disconnect(this);
+    sourceReply_->abort();
+  }
+  setError(QNetworkReply::OperationCanceledError, "Operation canceled");
+  finish();
+}
+
+qint64 ThumbnailReply::bytesAvailable() const
+{
+  return (content_.size() - offset_) + QNetworkReply::bytesAvailable();
+}
+
+qint64 ThumbnailReply::readData(char *data, qint64 maxSize)
+{
+  if (offset_ >= content_.size())
+    return -1;
+
+  int size = int(qMin(maxSize, qint64(content_.size() - offset_)));
+  memcpy(data, content_.constData() + offset_, size);
+  offset_ += size;
+  return size;
+}
+
+void ThumbnailReply::slotSourceFinished()
+{
+  if (isFinished()) return;
+
+  QNetworkReply *reply = sourceReply_;
+  reply->deleteLater();
+  if (reply->error() != QNetworkReply::NoError) {
+    setError(reply->error(), reply->errorString());
+    finish();
+    return;
+  }
+
+  QByteArray data = reply->readAll();
+  content_ = scaledImage(data, width_);
+  if (content_.isEmpty()) {
+    content_ = data;
+    setHeader(QNetworkRequest::ContentTypeHeader,
+              reply->header(QNetworkRequest::ContentTypeHeader));
+  } else {
+    if (!cachePruned) {
+      cachePruned = true;
+      pruneCache();
+    }
+    QFile file(cacheFile_);
+    if (file.open(QFile::WriteOnly))
+      file.write(content_);
+  }
+  finish();
+}
+
+void ThumbnailReply::finish()
+{
+  if (isFinished()) return;
+
+  if (error() == QNetworkReply::NoError) {
+    if (!header(QNetworkRequest::ContentTypeHeader).isValid()) {
+      setHeader(QNetworkRequest::ContentTypeHeader,
+                content_.startsWith("\x89PNG") ? QString("image/png") : QString("image/jpeg"));
+    }
+    setHeader(QNetworkRequest::ContentLengthHeader, content_.size());
+    setAttribute(QNetworkRequest::HttpStatusCodeAttribute, 200);
+    emit metaDataChanged();
+    if (!content_.isEmpty()) {
+      emit downloadProgress(content_.size(), content_.size());
+      emit readyRead();
+    }
+  } else {
+    emit error(error());
+  }
+  setFinished(true);
+  emit finished();
+}
+
+QString ThumbnailReply::cacheDirPath()
+{
+  QString path = mainApp->absolutePath(mainApp->cacheDefaultDir()) + "/thumbnails";
+  QDir().mkpath(path);
+  return path;
+}
+
+/** @brief Remove oldest thumbnails while cache is above its size
+ *----------------------------------------------------------------------------*/
+void ThumbnailReply::pruneCache()
+{
+  QDir dir(cacheDirPath());
+  QFileInfoList files = dir.entryInfoList(QDir::Files, QDir::Time);
+  qint64 size = 0;
+  foreach (const QFileInfo &info, files) {
+    size += info.size();
+    if (size > THUMBNAIL_CACHE_SIZE)
+      QFile::remove(info.absoluteFilePath());
+  }
+}
+
+/** @brief Decode image directly at \a width, as JPEG or PNG with alpha
+ * @return empty array if image is kept as it is
+ *----------------------------------------------------------------------------*/
+QByteArray ThumbnailReply::scaledImage(const QByteArray &data, int width)
+{
+  QBuffer buffer;
+  buffer.setData(data);
+  buffer.open(QIODevice::ReadOnly);
+  QImageReader reader(&buffer);
+  QSize size = reader.size();
+  if (!size.isValid() || (size.width() <= width) || reader.supportsAnimation())
+    return QByteArray();
+
+  reader.setScaledSize(QSize(width, qMax(1, int(qint64(size.height()) * width / size.width()))));
+  QImage image = reader.read();
+  if (image.isNull())
+    return QByteArray();
+
+  QBuffer output;
+  output.open(QIODevice::WriteOnly);
+  if (!image.save(&output, image.hasAlphaChannel() ? "PNG" : "JPG", THUMBNAIL_QUALITY))
+    return QByteArray();
+  return output.data();
+}
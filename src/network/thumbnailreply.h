@@ -0,0 +1,66 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef THUMBNAILREPLY_H
+#define THUMBNAILREPLY_H
+
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QPointer>
+
+/** @brief Downscaled image for newspaper layout, kept in disk cache
+ *
+ * Newspaper page asks images through quiterss://thumbnail.ui URLs with
+ * width of column. Original image is loaded through manager, decoded
+ * directly at that width and saved, so page does not keep full images.
+ * Images already narrower than column and animations are given as is.
+ *----------------------------------------------------------------------------*/
+class ThumbnailReply : public QNetworkReply
+{
+  Q_OBJECT
+public:
+  ThumbnailReply(const QNetworkRequest &request, QNetworkAccessManager *manager,
+                 QObject *parent = 0);
+
+  static bool isThumbnailUrl(const QUrl &url);
+  static QString rewriteImages(const QString &html, int width);
+
+  void abort();
+  qint64 bytesAvailable() const;
+
+protected:
+  qint64 readData(char *data, qint64 maxSize);
+
+private slots:
+  void slotSourceFinished();
+  void finish();
+
+private:
+  static QString cacheDirPath();
+  static void pruneCache();
+  static QByteArray scaledImage(const QByteArray &data, int width);
+
+  QUrl source_;
+  int width_;
+  QString cacheFile_;
+  QPointer<QNetworkReply> sourceReply_;
+  QByteArray content_;
+  int offset_;
+
+};
+
+#endif // THUMBNAILREPLY_H
@@ -0,0 +1,379 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "websubclient.h"
+
+#include "database.h"
+#include "logfile.h"
+#include "networkmanager.h"
+
+#include <QDebug>
+#include <QHostInfo>
+#include <QNetworkReply>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QUuid>
+#if QT_VERSION >= 0x050000
+#include <QUrlQuery>
+#endif
+#if QT_VERSION >= 0x050100
+#include <QMessageAuthenticationCode>
+#endif
+#if QT_VERSION >= 0x050A00
+#include <QRandomGenerator>
+#endif
+
+// Requested subscription lease (sec)
+#define WEBSUB_LEASE 604800
+// Subscription is renewed when lease expires sooner (sec)
+#define WEBSUB_RENEW 86400
+// Pending subscription request is repeated after (sec)
+#define WEBSUB_PENDING 3600
+// Maximum size of request to callback
+#define WEBSUB_REQUEST_MAX 20971520
+
+WebSubClient::WebSubClient(int port, const QString &callbackUrl, QObject *parent)
+  : QObject(parent)
+  , port_(port)
+  , callbackUrl_(callbackUrl)
+  , server_(NULL)
+{
+  setObjectName("webSubClient_");
+
+  if (callbackUrl_.isEmpty())
+    callbackUrl_ = QString("http://localhost:%1").arg(port_);
+  while (callbackUrl_.endsWith('/'))
+    callbackUrl_.chop(1);
+
+  db_ = Database::connection("secondConnection");
+
+  networkManager_ = new NetworkManager(true, this);
+  connect(networkManager_, SIGNAL(finished(QNetworkReply*)),
+          this, SLOT(slotSubscribeFinished(QNetworkReply*)));
+}
+
+void WebSubClient::disconnectObjects()
+{
+  disconnect(this);
+  networkManager_->disconnect(networkManager_);
+}
+
+/** @brief Start callback server in thread of object
+ *
+ * Server listens only on address of callback host, not on all interfaces.
+ *----------------------------------------------------------------------------*/
+void WebSubClient::start()
+{
+  if (server_) return;
+
+  QString host = QUrl(callbackUrl_).host();
+  QHostAddress address;
+  if (host.isEmpty() || (host == "localhost")) {
+    address = QHostAddress::LocalHost;
+  } else if (!address.setAddress(host)) {
+    QHostInfo hostInfo = QHostInfo::fromName(host);
+    if (hostInfo.addresses().isEmpty()) {
+      qWarning() << "WebSub: cannot resolve callback host" << host << hostInfo.errorString();
+      return;
+    }
+    address = hostInfo.addresses().first();
+  }
+
+  server_ = new QTcpServer(this);
+  connect(server_, SIGNAL(newConnection()), this, SLOT(slotNewConnection()));
+  if (!server_->listen(address, port_)) {
+    qWarning() << "WebSub: cannot listen" << address.toString() << port_
+               << server_->errorString();
+  }
+}
+
+/** @brief Random secret of subscription, hex digits of 128 bits
+ *----------------------------------------------------------------------------*/
+QString WebSubClient::createSecret()
+{
+#if QT_VERSION >= 0x050A00
+  QByteArray secret(16, Qt::Uninitialized);
+  QRandomGenerator::system()->fillRange(reinterpret_cast<quint32 *>(secret.data()),
+                                        secret.size() / int(sizeof(quint32)));
+  return QString::fromLatin1(secret.toHex());
+#else
+  // Version 4 UUID is made from random bytes of system
+  return QUuid::createUuid().toString().remove(QRegExp("[{}-]"));
+#endif
+}
+
+QString WebSubClient::feedValue(int feedId, const QString &name)
+{
+  QSqlQuery q(db_);
+  q.prepare("SELECT value FROM feeds_ex WHERE feedId=? AND name=?");
+  q.addBindValue(feedId);
+  q.addBindValue(name);
+  q.exec();
+  if (q.first())
+    return q.value(0).toString();
+  return QString();
+}
+
+void WebSubClient::setFeedValue(int feedId, const QString &name, const QString &value)
+{
+  QSqlQuery q(db_);
+  q.prepare("DELETE FROM feeds_ex WHERE feedId=? AND name=?");
+  q.addBindValue(feedId);
+  q.addBindValue(name);
+  q.exec();
+  if (value.isEmpty()) return;
+
+  q.prepare("INSERT INTO feeds_ex(feedId, name, value) VALUES (?, ?, ?)");
+  q.addBindValue(feedId);
+  q.addBindValue(name);
+  q.addBindValue(value);
+  q.exec();
+}
+
+/** @brief Subscribe feed to its hub if there is no valid subscription
+ *----------------------------------------------------------------------------*/
+void WebSubClient::slotHubFound(int feedId, QString hubUrl, QString topicUrl)
+{
+  QDateTime currentTime = QDateTime::currentDateTimeUtc();
+
+  QDateTime lease = QDateTime::fromString(feedValue(feedId, "websubLease"), Qt::ISODate);
+  lease.setTimeSpec(Qt::UTC);
+  if ((feedValue(feedId, "websubHub") == hubUrl) && lease.isValid() &&
+      (currentTime.secsTo(lease) > WEBSUB_RENEW))
+    return;
+
+  QDateTime pending = QDateTime::fromString(feedValue(feedId, "websubPending"), Qt::ISODate);
+  pending.setTimeSpec(Qt::UTC);
+  if (pending.isValid() && (pending.secsTo(currentTime) < WEBSUB_PENDING))
+    return;
+
+  QString secret = createSecret();
+
+  db_.transaction();
+  setFeedValue(feedId, "websubHub", hubUrl);
+  setFeedValue(feedId, "websubTopic", topicUrl);
+  setFeedValue(feedId, "websubSecret", secret);
+  setFeedValue(feedId, "websubPending", currentTime.toString(Qt::ISODate));
+  db_.commit();
+
+  QByteArray body;
+  body.append("hub.mode=subscribe");
+  body.append("&hub.topic=" + QUrl::toPercentEncoding(topicUrl));
+  body.append("&hub.callback=" + QUrl::toPercentEncoding(QString("%1/websub/%2").
+                                                          arg(callbackUrl_).arg(feedId)));
+  body.append("&hub.lease_seconds=" + QByteArray::number(WEBSUB_LEASE));
+  body.append("&hub.secret=" + secret.toLatin1());
+
+  QNetworkRequest request(QUrl::fromEncoded(hubUrl.toUtf8()));
+  request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
+  QNetworkReply *reply = networkManager_->post(request, body);
+  reply->setProperty("feedId", feedId);
+
+  LOG_DEBUG(LogFile::WebSub) << "WebSub: subscribe" << feedId << topicUrl << hubUrl;
+}
+
+void WebSubClient::slotSubscribeFinished(QNetworkReply *reply)
+{
+  int httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+  if ((reply->error() != QNetworkReply::NoError) || (httpStatus / 100 != 2)) {
+    qWarning() << "WebSub: subscription error" << reply->property("feedId").toInt()
+               << httpStatus << reply->errorString();
+  }
+  reply->deleteLater();
+}
+
+void WebSubClient::slotNewConnection()
+{
+  while (server_->hasPendingConnections()) {
+    QTcpSocket *socket = server_->nextPendingConnection();
+    connect(socket, SIGNAL(readyRead()), this, SLOT(slotReadyRead()));
+    connect(socket, SIGNAL(disconnected()), this, SLOT(slotDisconnected()));
+    requests_.insert(socket, QByteArray());
+  }
+}
+
+void WebSubClient::slotDisconnected()
+{
+  QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+  if (!socket) return;
+
+  requests_.remove(socket);
+  socket->deleteLater();
+}
+
+/** @brief Collect request to callback until it is complete
+ *----------------------------------------------------------------------------*/
+void WebSubClient::slotReadyRead()
+{
+  QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+  if (!socket || !requests_.contains(socket)) return;
+
+  QByteArray &request = requests_[socket];
+  request.append(socket->readAll());
+  if (request.size() > WEBSUB_REQUEST_MAX) {
+    requests_.remove(socket);
+    sendResponse(socket, 413);
+    return;
+  }
+
+  int headerEnd = request.indexOf("\r\n\r\n");
+  if (headerEnd == -1) return;
+
+  int contentLength = 0;
+  QList<QByteArray> lines = request.left(headerEnd).split('\n');
+  for (int i = 1; i < lines.count(); ++i) {
+    QByteArray line = lines.at(i).trimmed();
+    if (line.toLower().startsWith("content-length:"))
+      contentLength = line.mid(15).trimmed().toInt();
+  }
+  if (request.size() < headerEnd + 4 + contentLength) return;
+
+  QByteArray completeRequest = requests_.take(socket);
+  processRequest(socket, completeRequest);
+}
+
+/** @brief Answer hub verification or pass pushed content to parser
+ *----------------------------------------------------------------------------*/
+void WebSubClient::processRequest(QTcpSocket *socket, const QByteArray &request)
+{
+  int headerEnd = request.indexOf("\r\n\r\n");
+  QList<QByteArray> lines = request.left(headerEnd).split('\n');
+  QList<QByteArray> requestLine = lines.value(0).trimmed().split(' ');
+  QByteArray method = requestLine.value(0);
+  QUrl url = QUrl::fromEncoded(requestLine.value(1));
+
+  QHash<QByteArray, QByteArray> headers;
+  for (int i = 1; i < lines.count(); ++i) {
+    QByteArray line = lines.at(i).trimmed();
+    int pos = line.indexOf(':');
+    if (pos > 0)
+      headers.insert(line.left(pos).trimmed().toLower(), line.mid(pos + 1).trimmed());
+  }
+
+  QStringList path = url.path().split('/', QString::SkipEmptyParts);
+  bool ok = false;
+  int feedId = path.value(1).toInt(&ok);
+  QString topicUrl;
+  if ((path.count() == 2) && (path.at(0) == "websub") && ok)
+    topicUrl = feedValue(feedId, "websubTopic");
+  if (topicUrl.isEmpty()) {
+    sendResponse(socket, 404);
+    return;
+  }
+
+  if (method == "GET") {
+#if QT_VERSION >= 0x050000
+    QUrlQuery query(url);
+    QString mode = query.queryItemValue("hub.mode", QUrl::FullyDecoded);
+    QString topic = query.queryItemValue("hub.topic", QUrl::FullyDecoded);
+    QString challenge = query.queryItemValue("hub.challenge", QUrl::FullyDecoded);
+    int leaseSeconds = query.queryItemValue("hub.lease_seconds").toInt();
+#else
+    QString mode = url.queryItemValue("hub.mode");
+    QString topic = url.queryItemValue("hub.topic");
+    QString challenge = url.queryItemValue("hub.challenge");
+    int leaseSeconds = url.queryItemValue("hub.lease_seconds").toInt();
+#endif
+    if (topic != topicUrl) {
+      sendResponse(socket, 404);
+      return;
+    }
+
+    // Only subscription requested by client is confirmed
+    QDateTime pending = QDateTime::fromString(feedValue(feedId, "websubPending"), Qt::ISODate);
+    pending.setTimeSpec(Qt::UTC);
+    bool isPending = pending.isValid() && !feedValue(feedId, "websubHub").isEmpty() &&
+        (pending.secsTo(QDateTime::currentDateTimeUtc()) < WEBSUB_PENDING);
+    if ((mode != "denied") && ((mode != "subscribe") || !isPending)) {
+      qWarning() << "WebSub: unexpected verification" << mode << feedId;
+      sendResponse(socket, 404);
+      return;
+    }
+
+    db_.transaction();
+    setFeedValue(feedId, "websubPending", QString());
+    if (mode == "subscribe") {
+      if (leaseSeconds <= 0)
+        leaseSeconds = WEBSUB_LEASE;
+      QDateTime lease = QDateTime::currentDateTimeUtc().addSecs(leaseSeconds);
+      setFeedValue(feedId, "websubLease", lease.toString(Qt::ISODate));
+      LOG_DEBUG(LogFile::WebSub) << "WebSub: subscribed" << feedId << topicUrl << leaseSeconds;
+    } else {
+      setFeedValue(feedId, "websubLease", QString());
+      LOG_DEBUG(LogFile::WebSub) << "WebSub:" << mode << feedId << topicUrl;
+    }
+    db_.commit();
+
+    sendResponse(socket, 200, challenge.toUtf8());
+  } else if (method == "POST") {
+#if QT_VERSION >= 0x050100
+    QByteArray body = request.mid(headerEnd + 4);
+    sendResponse(socket, 200);
+
+    // Content from hub is signed with subscription secret, unsigned
+    // content is dropped
+    QString secret = feedValue(feedId, "websubSecret");
+    QByteArray signature = headers.value("x-hub-signature");
+    QCryptographicHash::Algorithm algorithm = QCryptographicHash::Sha1;
+    if (signature.startsWith("sha256="))
+      algorithm = QCryptographicHash::Sha256;
+    QByteArray digest = signature.mid(signature.indexOf('=') + 1).toLower();
+    QByteArray expected = QMessageAuthenticationCode::hash(body, secret.toLatin1(),
+                                                           algorithm).toHex();
+    if (secret.isEmpty() || (digest != expected)) {
+      qWarning() << "WebSub: wrong signature of content" << feedId;
+      return;
+    }
+#else
+    // Signature of content can not be checked
+    sendResponse(socket, 405);
+    return;
+#endif
+
+    QString codecName;
+    QByteArray contentType = headers.value("content-type");
+    int pos = contentType.toLower().indexOf("charset=");
+    if (pos != -1)
+      codecName = contentType.mid(pos + 8).trimmed();
+
+    QDateTime currentTime = QDateTime::currentDateTimeUtc();
+    LOG_DEBUG(LogFile::WebSub) << "WebSub: content received" << feedId << body.size();
+    emit xmlReadyParse(body, feedId, QDateTime(currentTime.date(), currentTime.time()),
+                       codecName, QString());
+  } else {
+    sendResponse(socket, 405);
+  }
+}
+
+void WebSubClient::sendResponse(QTcpSocket *socket, int status, const QByteArray &body)
+{
+  QByteArray statusText;
+  switch (status) {
+  case 200: statusText = "OK"; break;
+  case 404: statusText = "Not Found"; break;
+  case 405: statusText = "Method Not Allowed"; break;
+  case 413: statusText = "Payload Too Large"; break;
+  }
+
+  QByteArray response = "HTTP/1.1 " + QByteArray::number(status) + " " + statusText + "\r\n";
+  response.append("Content-Type: text/plain\r\n");
+  response.append("Content-Length: " + QByteArray::number(body.size()) + "\r\n");
+  response.append("Connection: close\r\n\r\n");
+  response.append(body);
+  socket->write(response);
+  socket->disconnectFromHost();
+}
@@ -0,0 +1,75 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef WEBSUBCLIENT_H
+#define WEBSUBCLIENT_H
+
+#include <QDateTime>
+#include <QHash>
+#include <QObject>
+#include <QtSql>
+
+class QNetworkReply;
+class QTcpServer;
+class QTcpSocket;
+class NetworkManager;
+
+/** @brief WebSub (PubSubHubbub) subscriber
+ *
+ * Subscribes feeds which advertise hub, answers hub verification requests
+ * and passes pushed content to parser. Subscription state is kept in
+ * feeds_ex table, feeds with valid lease are not updated by timer.
+ *----------------------------------------------------------------------------*/
+class WebSubClient : public QObject
+{
+  Q_OBJECT
+public:
+  explicit WebSubClient(int port, const QString &callbackUrl, QObject *parent = 0);
+
+  void disconnectObjects();
+
+public slots:
+  void start();
+  void slotHubFound(int feedId, QString hubUrl, QString topicUrl);
+
+signals:
+  void xmlReadyParse(QByteArray data, int feedId,
+                     QDateTime dtReply, QString codecName, QString etag);
+
+private slots:
+  void slotNewConnection();
+  void slotReadyRead();
+  void slotDisconnected();
+  void slotSubscribeFinished(QNetworkReply *reply);
+
+private:
+  static QString createSecret();
+  QString feedValue(int feedId, const QString &name);
+  void setFeedValue(int feedId, const QString &name, const QString &value);
+  void processRequest(QTcpSocket *socket, const QByteArray &request);
+  void sendResponse(QTcpSocket *socket, int status, const QByteArray &body = QByteArray());
+
+  int port_;
+  QString callbackUrl_;
+  QSqlDatabase db_;
+  QTcpServer *server_;
+  NetworkManager *networkManager_;
+  QHash<QTcpSocket*, QByteArray> requests_;
+
+};
+
+#endif // WEBSUBCLIENT_H
@@ -0,0 +1,325 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "filtermatcher.h"
+
+#include <QQueue>
+
+FilterMatcher::FilterMatcher()
+{
+  clear();
+}
+
+void FilterMatcher::clear()
+{
+  filters_.clear();
+  keywords_.clear();
+  regExps_.clear();
+  hits_.clear();
+  nodes_.clear();
+  Node root;
+  root.fail = 0;
+  root.keyword = -1;
+  root.output = 0;
+  nodes_.append(root);
+  for (int i = 0; i < FieldCount; ++i)
+    scanFields_[i] = false;
+  scanStamp_ = 0;
+}
+
+/** @brief Add filter, its index is used by addCondition() and matches()
+ * @param type - 0 for all news, 1 for all conditions, 2 for any condition
+ *----------------------------------------------------------------------------*/
+int FilterMatcher::addFilter(int type)
+{
+  Filter filter;
+  filter.type = type;
+  filters_.append(filter);
+  return filters_.count() - 1;
+}
+
+/** @brief Add condition of filterConditions table to filter
+ * @return false if condition can be checked by SQL only
+ *----------------------------------------------------------------------------*/
+bool FilterMatcher::addCondition(int filter, int field, int condition, const QString &content)
+{
+  Condition item;
+  item.field = field;
+  item.negate = false;
+  item.index = -1;
+
+  // Comparison as in filter dialog for title:
+  // 0 - contains, 1 - doesn't contain, 2 - is, 3 - isn't,
+  // 4 - begins with, 5 - ends with, 6 - regExp
+  int compare = -1;
+  switch (field) {
+  case FieldTitle:
+  case FieldCategory:
+  case FieldLink:
+    if ((condition >= 0) && (condition <= 6))
+      compare = condition;
+    break;
+  case FieldAuthor:
+    if ((condition >= 0) && (condition <= 3))
+      compare = condition;
+    else if (condition == 4)
+      compare = 6;
+    break;
+  case FieldDescription:
+  case FieldNews:
+    if ((condition == 0) || (condition == 1))
+      compare = condition;
+    else if (condition == 2)
+      compare = 6;
+    break;
+  case FieldStatus:
+    item.kind = KindStatus;
+    item.negate = (condition != 0);
+    item.index = content.toInt();
+    if ((item.index < 0) || (item.index > 2))
+      return false;
+    filters_[filter].conditions.append(item);
+    return true;
+  }
+  if (compare == -1)
+    return false;
+
+  item.negate = (compare == 1) || (compare == 3);
+  bool isWildcard = content.contains('%') || content.contains('_');
+  if (compare == 6) {
+    item.kind = KindRegExp;
+    item.index = regExps_.count();
+    regExps_.append(QzRegExp(content, Qt::CaseInsensitive));
+  } else if (isWildcard) {
+    // Pattern of LIKE is turned into regular expression
+    QString pattern;
+    foreach (const QChar &c, content) {
+      if (c == '%')
+        pattern.append("[\\s\\S]*");
+      else if (c == '_')
+        pattern.append("[\\s\\S]");
+      else
+        pattern.append(QzRegExp::escape(QString(c)));
+    }
+    if ((compare == 2) || (compare == 3) || (compare == 4))
+      pattern.prepend('^');
+    if ((compare == 2) || (compare == 3) || (compare == 5))
+      pattern.append('$');
+    item.kind = KindRegExp;
+    item.index = regExps_.count();
+    regExps_.append(QzRegExp(pattern, Qt::CaseInsensitive));
+  } else {
+    item.text = content.toUpper();
+    if (compare <= 1) {
+      item.kind = KindContains;
+      item.index = keywordIndex(item.text);
+    } else if (compare <= 3) {
+      item.kind = KindEquals;
+    } else if (compare == 4) {
+      item.kind = KindBeginsWith;
+    } else {
+      item.kind = KindEndsWith;
+    }
+  }
+
+  if (field == FieldNews) {
+    scanFields_[FieldTitle] = true;
+    scanFields_[FieldDescription] = true;
+  } else {
+    scanFields_[field] = true;
+  }
+  filters_[filter].conditions.append(item);
+  return true;
+}
+
+/** @brief Index of keyword in automaton, -1 for empty keyword
+ *----------------------------------------------------------------------------*/
+int FilterMatcher::keywordIndex(const QString &keyword)
+{
+  if (keyword.isEmpty())
+    return -1;
+
+  QHash<QString, int>::const_iterator it = keywords_.constFind(keyword);
+  if (it != keywords_.constEnd())
+    return it.value();
+
+  int index = keywords_.count();
+  keywords_.insert(keyword, index);
+  addKeywordNode(keyword, index);
+  return index;
+}
+
+void FilterMatcher::addKeywordNode(const QString &keyword, int index)
+{
+  int state = 0;
+  foreach (const QChar &c, keyword) {
+    int next = nodes_.at(state).next.value(c.unicode(), 0);
+    if (!next) {
+      Node node;
+      node.fail = 0;
+      node.keyword = -1;
+      node.output = 0;
+      next = nodes_.count();
+      nodes_.append(node);
+      nodes_[state].next.insert(c.unicode(), next);
+    }
+    state = next;
+  }
+  nodes_[state].keyword = index;
+}
+
+/** @brief Build fail links of automaton after all filters are added
+ *----------------------------------------------------------------------------*/
+void FilterMatcher::compile()
+{
+  QQueue<int> queue;
+  QHash<ushort, int>::const_iterator it = nodes_.at(0).next.constBegin();
+  for (; it != nodes_.at(0).next.constEnd(); ++it) {
+    nodes_[it.value()].fail = 0;
+    nodes_[it.value()].output = 0;
+    queue.enqueue(it.value());
+  }
+
+  while (!queue.isEmpty()) {
+    int state = queue.dequeue();
+    QHash<ushort, int>::const_iterator child = nodes_.at(state).next.constBegin();
+    for (; child != nodes_.at(state).next.constEnd(); ++child) {
+      int fail = nodes_.at(state).fail;
+      while (fail && !nodes_.at(fail).next.contains(child.key()))
+        fail = nodes_.at(fail).fail;
+      fail = nodes_.at(fail).next.value(child.key(), 0);
+
+      Node &node = nodes_[child.value()];
+      node.fail = fail;
+      node.output = (nodes_.at(fail).keyword >= 0) ? fail : nodes_.at(fail).output;
+      queue.enqueue(child.value());
+    }
+  }
+
+  hits_.fill(0, keywords_.count() * FieldCount);
+  scanStamp_ = 0;
+}
+
+const QString &FilterMatcher::fieldText(int field, const Item &item)
+{
+  switch (field) {
+  case FieldDescription: return item.description;
+  case FieldAuthor: return item.author;
+  case FieldCategory: return item.category;
+  case FieldLink: return item.link;
+  default: return item.title;
+  }
+}
+
+/** @brief Find keywords in fields of news, called before matches()
+ *----------------------------------------------------------------------------*/
+void FilterMatcher::scan(const Item &item)
+{
+  ++scanStamp_;
+  for (int field = 0; field < FieldCount; ++field) {
+    if (!scanFields_[field] || (field == FieldStatus) || (field == FieldNews))
+      continue;
+    const QString &text = fieldText(field, item);
+    upperText_[field] = text.toUpper();
+    if (!keywords_.isEmpty())
+      scanField(field, upperText_[field]);
+  }
+}
+
+void FilterMatcher::scanField(int field, const QString &text)
+{
+  int state = 0;
+  const QChar *data = text.constData();
+  for (int i = 0; i < text.size(); ++i) {
+    ushort c = data[i].unicode();
+    QHash<ushort, int>::const_iterator it = nodes_.at(state).next.constFind(c);
+    while (state && (it == nodes_.at(state).next.constEnd())) {
+      state = nodes_.at(state).fail;
+      it = nodes_.at(state).next.constFind(c);
+    }
+    state = (it != nodes_.at(state).next.constEnd()) ? it.value() : 0;
+
+    int node = (nodes_.at(state).keyword >= 0) ? state : nodes_.at(state).output;
+    for (; node > 0; node = nodes_.at(node).output)
+      hits_[nodes_.at(node).keyword * FieldCount + field] = scanStamp_;
+  }
+}
+
+/** @brief Check condition on one text field, NULL value never matches
+ *----------------------------------------------------------------------------*/
+bool FilterMatcher::fieldMatches(int field, const Condition &condition, const Item &item) const
+{
+  const QString &text = fieldText(field, item);
+  if (text.isNull())
+    return false;
+
+  bool matched = false;
+  switch (condition.kind) {
+  case KindContains:
+    matched = (condition.index < 0) ||
+        (hits_.at(condition.index * FieldCount + field) == scanStamp_);
+    break;
+  case KindEquals:
+    matched = (upperText_[field] == condition.text);
+    break;
+  case KindBeginsWith:
+    matched = upperText_[field].startsWith(condition.text);
+    break;
+  case KindEndsWith:
+    matched = upperText_[field].endsWith(condition.text);
+    break;
+  case KindRegExp:
+    matched = (regExps_.at(condition.index).indexIn(text) > -1);
+    break;
+  case KindStatus:
+    break;
+  }
+  return matched != condition.negate;
+}
+
+/** @brief Check filter on news scanned last
+ *----------------------------------------------------------------------------*/
+bool FilterMatcher::matches(int filter, const Item &item) const
+{
+  const Filter &current = filters_.at(filter);
+  if (current.type == 0)
+    return true;
+  if (current.conditions.isEmpty())
+    return false;
+
+  bool isAll = (current.type == 1);
+  foreach (const Condition &condition, current.conditions) {
+    bool matched;
+    if (condition.kind == KindStatus) {
+      switch (condition.index) {
+      case 0: matched = item.isNew; break;
+      case 1: matched = item.isRead; break;
+      default: matched = item.isStarred;
+      }
+      matched = (matched != condition.negate);
+    } else if (condition.field == FieldNews) {
+      matched = fieldMatches(FieldTitle, condition, item) ||
+          fieldMatches(FieldDescription, condition, item);
+    } else {
+      matched = fieldMatches(condition.field, condition, item);
+    }
+
+    if (matched != isAll)
+      return matched;
+  }
+  return isAll;
+}
@@ -0,0 +1,119 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef FILTERMATCHER_H
+#define FILTERMATCHER_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QVector>
+#include <qzregexp.h>
+
+/** @brief Conditions of user filters checked on news before they are stored
+ *
+ * Keywords of all filters are found in one pass over each field by
+ * Aho-Corasick automaton, regular expressions are compiled once.
+ * Results are the same as of SQL conditions built by ParseObject.
+ *----------------------------------------------------------------------------*/
+class FilterMatcher
+{
+public:
+  //! Fields of filterConditions table
+  enum Field {
+    FieldTitle = 0,
+    FieldDescription,
+    FieldAuthor,
+    FieldCategory,
+    FieldStatus,
+    FieldLink,
+    FieldNews,
+    FieldCount
+  };
+
+  //! News checked by filters, null strings are NULL values of base
+  struct Item {
+    QString title;
+    QString description;
+    QString author;
+    QString category;
+    QString link;
+    bool isNew;
+    bool isRead;
+    bool isStarred;
+  };
+
+  FilterMatcher();
+
+  void clear();
+  int addFilter(int type);
+  bool addCondition(int filter, int field, int condition, const QString &content);
+  void compile();
+
+  void scan(const Item &item);
+  bool matches(int filter, const Item &item) const;
+
+private:
+  enum Kind {
+    KindContains,
+    KindEquals,
+    KindBeginsWith,
+    KindEndsWith,
+    KindRegExp,
+    KindStatus
+  };
+
+  struct Condition {
+    int field;
+    Kind kind;
+    bool negate;
+    int index;          // keyword, regexp or status
+    QString text;       // upper case text of comparison
+  };
+
+  struct Filter {
+    int type;           // 0 - all news, 1 - all conditions, 2 - any condition
+    QList<Condition> conditions;
+  };
+
+  struct Node {
+    QHash<ushort, int> next;
+    int fail;
+    int keyword;        // keyword ending in node or -1
+    int output;         // nearest node on fail links with keyword
+  };
+
+  int keywordIndex(const QString &keyword);
+  void addKeywordNode(const QString &keyword, int index);
+  void scanField(int field, const QString &text);
+  bool fieldMatches(int field, const Condition &condition, const Item &item) const;
+  static const QString &fieldText(int field, const Item &item);
+
+  QList<Filter> filters_;
+  QHash<QString, int> keywords_;
+  QVector<Node> nodes_;
+  QList<QzRegExp> regExps_;
+  bool scanFields_[FieldCount];
+
+  // Keyword found in field if its stamp is equal to scanStamp_
+  QVector<int> hits_;
+  QString upperText_[FieldCount];
+  int scanStamp_;
+
+};
+
+#endif // FILTERMATCHER_H
@@ -369,13 +369,9 @@ void NewsFiltersDialog::slotCurrentItemChanged(QTreeWidgetItem *current,
 
 void NewsFiltersDialog::applyFilter()
 {
-  QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
-
   int filterRow = filtersTree_->currentIndex().row();
   int filterId = filtersTree_->topLevelItem(filterRow)->text(0).toInt();
-  int feedId = -1;
 
-  MainWindow *mainWindow = mainApp->mainWindow();
   QSqlQuery q;
   QString qStr = QString("SELECT feeds FROM filters WHERE id='%1'").
       arg(filterId);
@@ -385,17 +381,8 @@ void NewsFiltersDialog::applyFilter()
     q.finish();
     foreach (QString strIdFeed, strIdFeeds) {
       mainApp->runUserFilter(strIdFeed.toInt(), filterId);
-      NewsTabWidget *widget = qobject_cast<NewsTabWidget*>(mainWindow->stackedWidget_->currentWidget());
-      if (widget->feedId_ == strIdFeed.toInt()) feedId = strIdFeed.toInt();
     }
   }
-
-  if (feedId != -1)
-    mainWindow->slotUpdateNews(NewsTabWidget::RefreshAll);
-  mainWindow->slotUpdateStatus(feedId);
-  mainWindow->recountCategoryCounts();
-
-  QApplication::restoreOverrideCursor();
 }
 
 void NewsFiltersDialog::slotItemChanged(QTreeWidgetItem *item, int column)
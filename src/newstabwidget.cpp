@@ -18,8 +18,11 @@
 #include "newstabwidget.h"
 
 #include "mainapplication.h"
+#include "database.h"
 #include "adblockicon.h"
+#include "memoryaccounting.h"
 #include "settings.h"
+#include "thumbnailreply.h"
 #include "webpage.h"
 
 #if defined(Q_OS_WIN)
@@ -27,6 +30,57 @@
 #endif
 #include <qzregexp.h>
 
+// Pause after last key press in find field before news are filtered (ms)
+#define FIND_TEXT_DELAY 300
+// Pause after moving through news list with keys before news is displayed (ms)
+#define NEWS_SELECT_DELAY 100
+// Pause after news is displayed before neighbouring news are prepared (ms)
+#define NEWS_PRERENDER_DELAY 500
+// Number of news which HTML is kept for quick display
+#define NEWS_HTML_CACHE_SIZE 16
+// Number of news added to newspaper layout at once
+#define NEWSPAPER_PAGE_SIZE 30
+// Number of news ids listed in one statement
+#define NEWS_IDS_PER_QUERY 1000
+
+// Html templates and news style sheet shared by all tabs
+struct NewsTemplates {
+  bool loaded;
+  HtmlTemplate newspaperHeadHtml;
+  HtmlTemplate newspaperHtml;
+  HtmlTemplate newspaperHtmlRtl;
+  HtmlTemplate htmlString;
+  HtmlTemplate htmlRtlString;
+  HtmlTemplate audioPlayerHtml;
+  HtmlTemplate videoPlayerHtml;
+  // Style sheet is formatted again only when its file or settings change
+  QString cssKey;
+  HtmlTemplate cssString;
+};
+
+static NewsTemplates newsTemplates;
+
+/** @brief Statements applying \a sql to news \a ids
+ *
+ * \a sql has %1 in place of list of ids. Long lists are split, so size of
+ * statement stays within limits of SQLite.
+ *----------------------------------------------------------------------------*/
+static QStringList newsIdsQueries(const QString &sql, const QStringList &ids)
+{
+  QStringList sqlList;
+  for (int i = 0; i < ids.count(); i += NEWS_IDS_PER_QUERY) {
+    sqlList.append(sql.arg(QStringList(ids.mid(i, NEWS_IDS_PER_QUERY)).join(",")));
+  }
+  return sqlList;
+}
+
+static QString readHtmlResource(const QString &fileName)
+{
+  QFile file(fileName);
+  file.open(QFile::ReadOnly);
+  return QString::fromUtf8(file.readAll());
+}
+
 NewsTabWidget::NewsTabWidget(QWidget *parent, TabType type, int feedId, int feedParId)
   : QWidget(parent)
   , type_(type)
@@ -34,6 +88,13 @@ NewsTabWidget::NewsTabWidget(QWidget *parent, TabType type, int feedId, int feed
   , feedParId_(feedParId)
   , currentNewsIdOld(-1)
   , autoLoadImages_(true)
+  , webViewReleased_(false)
+  , hibernated_(false)
+  , hibernatedNewsId_(0)
+  , hibernatedScroll_(0)
+  , newspaperRow_(0)
+  , newspaperRowCount_(0)
+  , newspaperLtr_(true)
 {
   mainWindow_ = mainApp->mainWindow();
   db_ = QSqlDatabase::database();
@@ -41,6 +102,8 @@ NewsTabWidget::NewsTabWidget(QWidget *parent, TabType type, int feedId, int feed
   feedsModel_ = mainWindow_->feedsModel_;
   feedsProxyModel_ = mainWindow_->feedsProxyModel_;
 
+  idleTime_.start();
+
   newsIconTitle_ = new QLabel();
   newsIconMovie_ = new QMovie(":/images/loading");
   newsIconTitle_->setMovie(newsIconMovie_);
@@ -74,9 +137,7 @@ NewsTabWidget::NewsTabWidget(QWidget *parent, TabType type, int feedId, int feed
   newsTitleLabel_->setLayout(newsTitleLayout);
   newsTitleLabel_->setVisible(false);
 
-  Settings settings;
-  bool showCloseButtonTab = settings.value("Settings/showCloseButtonTab", true).toBool();
-  if (!showCloseButtonTab) {
+  if (!Settings::snapshot()->showCloseButtonTab) {
     closeButton_->hide();
     newsTitleLabel_->setFixedWidth(MAX_TAB_WIDTH-15);
   } else {
@@ -143,6 +204,7 @@ NewsTabWidget::NewsTabWidget(QWidget *parent, TabType type, int feedId, int feed
 
 NewsTabWidget::~NewsTabWidget()
 {
+  MemoryAccounting::remove(this);
   if (type_ == TabTypeDownloads) {
     mainApp->downloadManager()->hide();
     mainApp->downloadManager()->setParent(mainWindow_);
@@ -179,12 +241,7 @@ void NewsTabWidget::createNewsList()
   newsToolBar_->setObjectName("newsToolBar");
   newsToolBar_->setStyleSheet("QToolBar { border: none; padding: 0px; }");
 
-  Settings settings;
-  QString actionListStr = "markNewsRead,markAllNewsRead,Separator,markStarAct,"
-                          "newsLabelAction,shareMenuAct,openInExternalBrowserAct,Separator,"
-                          "nextUnreadNewsAct,prevUnreadNewsAct,Separator,"
-                          "newsFilter,Separator,deleteNewsAct";
-  QString str = settings.value("Settings/newsToolBar", actionListStr).toString();
+  QString str = Settings::snapshot()->newsToolBar;
 
   foreach (QString actionStr, str.split(",", QString::SkipEmptyParts)) {
     if (actionStr == "Separator") {
@@ -237,27 +294,22 @@ void NewsTabWidget::createNewsList()
 
   markNewsReadTimer_ = new QTimer(this);
 
-  QFile htmlFile;
-  htmlFile.setFileName(":/html/newspaper_head");
-  htmlFile.open(QFile::ReadOnly);
-  newspaperHeadHtml_ = QString::fromUtf8(htmlFile.readAll());
-  htmlFile.close();
-  htmlFile.setFileName(":/html/newspaper_description");
-  htmlFile.open(QFile::ReadOnly);
-  newspaperHtml_ = QString::fromUtf8(htmlFile.readAll());
-  htmlFile.close();
-  htmlFile.setFileName(":/html/newspaper_description_rtl");
-  htmlFile.open(QFile::ReadOnly);
-  newspaperHtmlRtl_ = QString::fromUtf8(htmlFile.readAll());
-  htmlFile.close();
-  htmlFile.setFileName(":/html/description");
-  htmlFile.open(QFile::ReadOnly);
-  htmlString_ = QString::fromUtf8(htmlFile.readAll());
-  htmlFile.close();
-  htmlFile.setFileName(":/html/description_rtl");
-  htmlFile.open(QFile::ReadOnly);
-  htmlRtlString_ = QString::fromUtf8(htmlFile.readAll());
-  htmlFile.close();
+  findTextTimer_ = new QTimer(this);
+  findTextTimer_->setSingleShot(true);
+
+  newsSelectTimer_ = new QTimer(this);
+  newsSelectTimer_->setSingleShot(true);
+
+  prerenderTimer_ = new QTimer(this);
+  prerenderTimer_->setSingleShot(true);
+  htmlCache_.setMaxCost(NEWS_HTML_CACHE_SIZE);
+
+  loadTemplates();
+  newspaperHeadHtml_ = newsTemplates.newspaperHeadHtml;
+  newspaperHtml_ = newsTemplates.newspaperHtml;
+  newspaperHtmlRtl_ = newsTemplates.newspaperHtmlRtl;
+  htmlString_ = newsTemplates.htmlString;
+  htmlRtlString_ = newsTemplates.htmlRtlString;
 
   connect(newsView_, SIGNAL(pressed(QModelIndex)),
           this, SLOT(slotNewsViewClicked(QModelIndex)));
@@ -285,14 +337,21 @@ void NewsTabWidget::createNewsList()
           this, SLOT(slotNewslLabelClicked(QModelIndex)));
   connect(markNewsReadTimer_, SIGNAL(timeout()),
           this, SLOT(slotMarkReadTimeout()));
+  connect(newsSelectTimer_, SIGNAL(timeout()),
+          this, SLOT(slotNewsSelectTimeout()));
+  connect(prerenderTimer_, SIGNAL(timeout()),
+          this, SLOT(slotPrerenderNews()));
+  connect(newsModel_, SIGNAL(modelReset()),
+          this, SLOT(slotClearHtmlCache()));
+  connect(newsModel_, SIGNAL(dataChanged(QModelIndex,QModelIndex)),
+          this, SLOT(slotNewsDataChanged(QModelIndex,QModelIndex)));
   connect(newsView_, SIGNAL(customContextMenuRequested(QPoint)),
           this, SLOT(showContextMenuNews(const QPoint &)));
 
-  connect(newsModel_, SIGNAL(signalSort(int,int)),
-          this, SLOT(slotSort(int,int)));
-
   connect(findText_, SIGNAL(textChanged(QString)),
-          this, SLOT(slotFindText(QString)));
+          this, SLOT(slotFindTextChanged(QString)));
+  connect(findTextTimer_, SIGNAL(timeout()),
+          this, SLOT(slotSelectFind()));
   connect(findText_, SIGNAL(signalSelectFind()),
           this, SLOT(slotSelectFind()));
   connect(findText_, SIGNAL(returnPressed()),
@@ -328,9 +387,50 @@ void NewsTabWidget::showContextMenuNews(const QPoint &pos)
   menu.addAction(mainWindow_->deleteNewsAct_);
   menu.addAction(mainWindow_->deleteAllNewsAct_);
 
+  qlonglong clusterId = 0;
+  if (newsModel_->isClustered())
+    clusterId = newsModel_->clusterId(newsView_->currentIndex().row());
+  if (clusterId) {
+    menu.addSeparator();
+    QAction *clusterAct = menu.addAction(newsModel_->isClusterExpanded(clusterId) ?
+                                           tr("Collapse Story") : tr("Expand Story"));
+    clusterAct->setData(clusterId);
+    connect(clusterAct, SIGNAL(triggered()), this, SLOT(slotToggleCluster()));
+  }
+
   menu.exec(newsView_->viewport()->mapToGlobal(pos));
 }
 
+/** @brief Show or hide other items of story in clustered layout
+ *----------------------------------------------------------------------------*/
+void NewsTabWidget::slotToggleCluster()
+{
+  QAction *action = qobject_cast<QAction*>(sender());
+  if (!action) return;
+
+  int newsId = currentNewsId();
+  newsModel_->toggleCluster(action->data().toLongLong());
+  refreshNewsList(newsId);
+}
+
+/** @brief Select news list again and restore current news
+ *----------------------------------------------------------------------------*/
+void NewsTabWidget::refreshNewsList(int newsId)
+{
+  int scroll = newsView_->verticalScrollBar()->value();
+  newsModel_->select();
+  while (newsModel_->canFetchMore())
+    newsModel_->fetchMore();
+
+  QModelIndex index = newsModel_->index(0, newsModel_->fieldColumn(NewsModel::FieldId));
+  QModelIndexList indexList = newsModel_->match(index, Qt::EditRole, newsId);
+  if (indexList.count()) {
+    newsView_->setCurrentIndex(newsModel_->index(indexList.first().row(),
+                                                 newsModel_->fieldColumn(NewsModel::FieldTitle)));
+  }
+  newsView_->verticalScrollBar()->setValue(scroll);
+}
+
 /** @brief Create web-widget and control panel
  *----------------------------------------------------------------------------*/
 void NewsTabWidget::createWebWidget()
@@ -429,6 +529,8 @@ void NewsTabWidget::createWebWidget()
   connect(webView_, SIGNAL(loadStarted()), this, SLOT(slotLoadStarted()));
   connect(webView_, SIGNAL(loadFinished(bool)), this, SLOT(slotLoadFinished(bool)));
   connect(webView_, SIGNAL(linkClicked(QUrl)), this, SLOT(slotLinkClicked(QUrl)));
+  connect(webView_->page(), SIGNAL(scrollRequested(int,int,QRect)),
+          this, SLOT(slotNewspaperScrolled()));
   connect(webView_->page(), SIGNAL(linkHovered(QString,QString,QString)),
           this, SLOT(slotLinkHovered(QString,QString,QString)));
   connect(webView_, SIGNAL(loadProgress(int)), this, SLOT(slotSetValue(int)), Qt::QueuedConnection);
@@ -460,21 +562,34 @@ void NewsTabWidget::createWebWidget()
  *----------------------------------------------------------------------------*/
 void NewsTabWidget::setSettings(bool init, bool newTab)
 {
-  Settings settings;
-
   if (type_ == TabTypeDownloads) return;
 
-  QString style = settings.value("Settings/styleApplication", "defaultStyle_").toString();
-  if (style == "darkStyle_")
+  htmlCache_.clear();
+
+  // Page was dropped while window was hidden in tray
+  if (webViewReleased_) {
+    webViewReleased_ = false;
+    if (type_ == TabTypeWeb) {
+      if (releasedUrl_.isValid())
+        webView_->load(releasedUrl_);
+      releasedUrl_ = QUrl();
+    } else if (mainWindow_->newsLayout_ == 1) {
+      loadNewspaper(RefreshAll);
+    } else {
+      updateWebView(newsView_->currentIndex());
+    }
+  }
+
+  QSharedPointer<const SettingsSnapshot> options = Settings::snapshot();
+  if (options->styleApplication == "darkStyle_")
     newsIconMovie_->setFileName(":/images/loading_dark");
   else
     newsIconMovie_->setFileName(":/images/loading");
 
   if (newTab) {
     if (type_ < TabTypeWeb) {
-      newsTabWidgetSplitter_->restoreState(settings.value("NewsTabSplitterState").toByteArray());
-      QString iconStr = settings.value("Settings/newsToolBarIconSize", "toolBarIconSmall_").toString();
-      mainWindow_->setToolBarIconSize(newsToolBar_, iconStr);
+      newsTabWidgetSplitter_->restoreState(options->newsTabSplitterState);
+      mainWindow_->setToolBarIconSize(newsToolBar_, options->newsToolBarIconSize);
 
       newsView_->setFont(
             QFont(mainWindow_->newsListFontFamily_, mainWindow_->newsListFontSize_));
@@ -489,38 +604,12 @@ void NewsTabWidget::setSettings(bool init, bool newTab)
       newsModel_->focusedNewsTextColor_ = mainWindow_->focusedNewsTextColor_;
       newsModel_->focusedNewsBGColor_ = mainWindow_->focusedNewsBGColor_;
 
-      QString styleSheetNews = settings.value("Settings/styleSheetNews",
-                                              mainApp->styleSheetNewsDefaultFile()).toString();
-      QFile file(styleSheetNews);
-      if (!file.open(QFile::ReadOnly)) {
-        file.setFileName(":/style/newsStyle");
-        file.open(QFile::ReadOnly);
-      }
-      cssString_ = QString::fromUtf8(file.readAll()).
-          arg(mainWindow_->newsTextFontFamily_).
-          arg(mainWindow_->newsTextFontSize_).
-          arg(mainWindow_->newsTitleFontFamily_).
-          arg(mainWindow_->newsTitleFontSize_).
-          arg(0).
-          arg(qApp->palette().color(QPalette::Dark).name()). // color separator
-          arg(mainWindow_->newsBackgroundColor_). // news background
-          arg(mainWindow_->newsTitleBackgroundColor_). // title background
-          arg(mainWindow_->linkColor_). // link color
-          arg(mainWindow_->titleColor_). // title color
-          arg(mainWindow_->dateColor_). // date color
-          arg(mainWindow_->authorColor_). // author color
-          arg(mainWindow_->newsTextColor_); // text color
-      file.close();
-
-      file.setFileName(":/html/audioplayer");
-      file.open(QFile::ReadOnly);
-      audioPlayerHtml_ = QString::fromUtf8(file.readAll());
-      file.close();
-
-      file.setFileName(":/html/videoplayer");
-      file.open(QFile::ReadOnly);
-      videoPlayerHtml_ = QString::fromUtf8(file.readAll());
-      file.close();
+      QString styleSheetNews = options->styleSheetNews;
+      if (styleSheetNews.isEmpty())
+        styleSheetNews = mainApp->styleSheetNewsDefaultFile();
+      cssString_ = newsCssString(styleSheetNews);
+      audioPlayerHtml_ = newsTemplates.audioPlayerHtml;
+      videoPlayerHtml_ = newsTemplates.videoPlayerHtml;
     }
 
     if (mainWindow_->externalBrowserOn_ <= 0) {
@@ -532,8 +621,6 @@ void NewsTabWidget::setSettings(bool init, bool newTab)
     webView_->page()->action(QWebPage::Back)->setShortcut(mainWindow_->backWebPageAct_->shortcut());
     webView_->page()->action(QWebPage::Forward)->setShortcut(mainWindow_->forwardWebPageAct_->shortcut());
     webView_->page()->action(QWebPage::Reload)->setShortcut(mainWindow_->reloadWebPageAct_->shortcut());
-
-    QWebSettings::setObjectCacheCapacities(0, 0, 0);
   }
 
   QModelIndex feedIndex = feedsModel_->indexById(feedId_);
@@ -586,6 +673,7 @@ void NewsTabWidget::setSettings(bool init, bool newTab)
     palette.setColor(QPalette::AlternateBase, mainWindow_->alternatingRowColors_);
     newsView_->setPalette(palette);
 
+    newsModel_->setClustered(mainWindow_->newsLayout_ == 2);
     if (!newTab)
       newsModel_->setFilter("feedId=-1");
     newsHeader_->setColumns(feedIndex);
@@ -652,6 +740,7 @@ void NewsTabWidget::setAutoLoadImages(bool apply)
   }
 
   if (apply) {
+    htmlCache_.clear();
     webView_->settings()->setAttribute(QWebSettings::AutoLoadImages, autoLoadImages_);
     if (autoLoadImages_) {
       if ((webView_->title() == "news_descriptions") &&
@@ -680,12 +769,13 @@ void NewsTabWidget::slotNewsViewClicked(QModelIndex index)
 // ----------------------------------------------------------------------------
 void NewsTabWidget::slotNewsViewSelected(QModelIndex index, bool clicked)
 {
+  newsSelectTimer_->stop();
   if (mainWindow_->newsLayout_ == 1) return;
 
-  int newsId = newsModel_->dataField(index.row(), "id").toInt();
+  int newsId = newsModel_->dataField(index.row(), NewsModel::FieldId).toInt();
   if (mainWindow_->markNewsReadOn_ && mainWindow_->markPrevNewsRead_ &&
       (newsId != currentNewsIdOld)) {
-    QModelIndex startIndex = newsModel_->index(0, newsModel_->fieldIndex("id"));
+    QModelIndex startIndex = newsModel_->index(0, newsModel_->fieldColumn(NewsModel::FieldId));
     QModelIndexList indexList = newsModel_->match(startIndex, Qt::EditRole, currentNewsIdOld);
     if (!indexList.isEmpty()) {
       slotSetItemRead(indexList.first(), 1);
@@ -699,7 +789,7 @@ void NewsTabWidget::slotNewsViewSelected(QModelIndex index, bool clicked)
   }
 
   if (!((newsId == currentNewsIdOld) &&
-        newsModel_->dataField(index.row(), "read").toInt() >= 1) ||
+        newsModel_->dataField(index.row(), NewsModel::FieldRead).toInt() >= 1) ||
       clicked) {
     markNewsReadTimer_->stop();
     if (mainWindow_->markNewsReadOn_ && mainWindow_->markCurNewsRead_) {
@@ -733,6 +823,16 @@ void NewsTabWidget::slotNewsViewSelected(QModelIndex index, bool clicked)
   currentNewsIdOld = newsId;
 }
 
+/** @brief Display current news after moving through news list with keys
+ *
+ * News passed while key is held are not displayed and not marked read,
+ * only news user stops on is.
+ *----------------------------------------------------------------------------*/
+void NewsTabWidget::slotNewsSelectTimeout()
+{
+  slotNewsViewSelected(newsView_->currentIndex());
+}
+
 // ----------------------------------------------------------------------------
 void NewsTabWidget::slotNewsViewDoubleClicked(QModelIndex index)
 {
@@ -776,7 +876,7 @@ void NewsTabWidget::slotNewsUpPressed(QModelIndex index)
       row = newsView_->currentIndex().row() - 1;
     if (row < 0)
       return;
-    index = newsModel_->index(row, newsModel_->fieldIndex("title"));
+    index = newsModel_->index(row, newsModel_->fieldColumn(NewsModel::FieldTitle));
     newsView_->setCurrentIndex(index);
   } else {
     row = index.row();
@@ -787,7 +887,7 @@ void NewsTabWidget::slotNewsUpPressed(QModelIndex index)
   if (row < (value + pageStep/2))
     newsView_->verticalScrollBar()->setValue(row - pageStep/2);
 
-  slotNewsViewSelected(index);
+  newsSelectTimer_->start(NEWS_SELECT_DELAY);
 }
 
 /** @brief Process pressing DOWN-key
@@ -804,7 +904,7 @@ void NewsTabWidget::slotNewsDownPressed(QModelIndex index)
       row = newsView_->currentIndex().row() + 1;
     if (row >= newsModel_->rowCount())
       return;
-    index = newsModel_->index(row, newsModel_->fieldIndex("title"));
+    index = newsModel_->index(row, newsModel_->fieldColumn(NewsModel::FieldTitle));
     newsView_->setCurrentIndex(index);
   } else {
     row = index.row();
@@ -814,21 +914,21 @@ void NewsTabWidget::slotNewsDownPressed(QModelIndex index)
   int pageStep = newsView_->verticalScrollBar()->pageStep();
   if (row > (value + pageStep/2))
     newsView_->verticalScrollBar()->setValue(row - pageStep/2);
-  slotNewsViewSelected(index);
+  newsSelectTimer_->start(NEWS_SELECT_DELAY);
 }
 
 /** @brief Process pressing HOME-key
  *----------------------------------------------------------------------------*/
-void NewsTabWidget::slotNewsHomePressed(QModelIndex index)
+void NewsTabWidget::slotNewsHomePressed(QModelIndex/* index*/)
 {
-  slotNewsViewSelected(index);
+  newsSelectTimer_->start(NEWS_SELECT_DELAY);
 }
 
 /** @brief Process pressing END-key
  *----------------------------------------------------------------------------*/
-void NewsTabWidget::slotNewsEndPressed(QModelIndex index)
+void NewsTabWidget::slotNewsEndPressed(QModelIndex/* index*/)
 {
-  slotNewsViewSelected(index);
+  newsSelectTimer_->start(NEWS_SELECT_DELAY);
 }
 
 /** @brief Process pressing PageUp-key
@@ -843,11 +943,11 @@ void NewsTabWidget::slotNewsPageUpPressed(QModelIndex index)
       row = newsView_->currentIndex().row() - newsView_->verticalScrollBar()->pageStep();
     if (row < 0)
       row = 0;
-    index = newsModel_->index(row, newsModel_->fieldIndex("title"));
+    index = newsModel_->index(row, newsModel_->fieldColumn(NewsModel::FieldTitle));
     newsView_->setCurrentIndex(index);
   }
 
-  slotNewsViewSelected(index);
+  newsSelectTimer_->start(NEWS_SELECT_DELAY);
 }
 
 /** @brief Process pressing PageDown-key
@@ -862,11 +962,11 @@ void NewsTabWidget::slotNewsPageDownPressed(QModelIndex index)
       row = newsView_->currentIndex().row() + newsView_->verticalScrollBar()->pageStep();
     if (row >= newsModel_->rowCount())
       row = newsModel_->rowCount()-1;
-    index = newsModel_->index(row, newsModel_->fieldIndex("title"));
+    index = newsModel_->index(row, newsModel_->fieldColumn(NewsModel::FieldTitle));
     newsView_->setCurrentIndex(index);
   }
 
-  slotNewsViewSelected(index);
+  newsSelectTimer_->start(NEWS_SELECT_DELAY);
 }
 
 /** @brief Mark news Read
@@ -876,38 +976,40 @@ void NewsTabWidget::slotSetItemRead(QModelIndex index, int read)
   markNewsReadTimer_->stop();
   if (!index.isValid() || (newsModel_->rowCount() == 0)) return;
 
-  bool changed = false;
-  int newsId = newsModel_->dataField(index.row(), "id").toInt();
+  int newsId = newsModel_->dataField(index.row(), NewsModel::FieldId).toInt();
+  int feedId = newsModel_->dataField(index.row(), NewsModel::FieldFeedId).toInt();
+  int unreadDelta = 0;
+  int newDelta = 0;
 
+  // Model and counters are changed at once, DB is written in batch
   if (read == 1) {
-    if (newsModel_->dataField(index.row(), "new").toInt() == 1) {
+    if (newsModel_->dataField(index.row(), NewsModel::FieldNew).toInt() == 1) {
       newsModel_->setData(
-            newsModel_->index(index.row(), newsModel_->fieldIndex("new")),
+            newsModel_->index(index.row(), newsModel_->fieldColumn(NewsModel::FieldNew)),
             0);
-      mainApp->sqlQueryExec(QString("UPDATE news SET new=0 WHERE id=='%1'").arg(newsId));
+      mainApp->setNewsState(newsId, feedId, "new", 0);
+      newDelta = -1;
     }
-    if (newsModel_->dataField(index.row(), "read").toInt() == 0) {
+    if (newsModel_->dataField(index.row(), NewsModel::FieldRead).toInt() == 0) {
       newsModel_->setData(
-            newsModel_->index(index.row(), newsModel_->fieldIndex("read")),
+            newsModel_->index(index.row(), newsModel_->fieldColumn(NewsModel::FieldRead)),
             1);
-      mainApp->sqlQueryExec(QString("UPDATE news SET read=1 WHERE id=='%1'").arg(newsId));
-      changed = true;
+      mainApp->setNewsState(newsId, feedId, "read", 1);
+      unreadDelta = -1;
     }
   } else {
-    if (newsModel_->dataField(index.row(), "read").toInt() != 0) {
+    if (newsModel_->dataField(index.row(), NewsModel::FieldRead).toInt() != 0) {
       newsModel_->setData(
-            newsModel_->index(index.row(), newsModel_->fieldIndex("read")),
+            newsModel_->index(index.row(), newsModel_->fieldColumn(NewsModel::FieldRead)),
             0);
-      mainApp->sqlQueryExec(QString("UPDATE news SET read=0 WHERE id=='%1'").arg(newsId));
-      changed = true;
+      mainApp->setNewsState(newsId, feedId, "read", 0);
+      unreadDelta = 1;
     }
   }
 
-  if (changed) {
+  if (unreadDelta || newDelta) {
     newsView_->viewport()->update();
-    int feedId = newsModel_->dataField(index.row(), "feedId").toInt();
-    mainWindow_->slotUpdateStatus(feedId);
-    mainWindow_->recountCategoryCounts();
+    mainWindow_->adjustFeedCounts(feedId, unreadDelta, newDelta);
   }
 }
 
@@ -919,10 +1021,8 @@ void NewsTabWidget::slotSetItemStar(QModelIndex index, int starred)
 
   newsModel_->setData(index, starred);
 
-  int newsId = newsModel_->dataField(index.row(), "id").toInt();
-  mainApp->sqlQueryExec(QString("UPDATE news SET starred='%1' WHERE id=='%2'").
-                        arg(starred).arg(newsId));
-  mainWindow_->recountCategoryCounts();
+  int newsId = newsModel_->dataField(index.row(), NewsModel::FieldId).toInt();
+  mainApp->setNewsState(newsId, 0, "starred", starred);
 }
 
 void NewsTabWidget::slotMarkReadTimeout()
@@ -945,46 +1045,46 @@ void NewsTabWidget::markNewsRead()
 
   if (cnt == 1) {
     curIndex = indexes.at(0);
-    if (newsModel_->dataField(curIndex.row(), "read").toInt() == 0) {
+    if (newsModel_->dataField(curIndex.row(), NewsModel::FieldRead).toInt() == 0) {
       slotSetItemRead(curIndex, 1);
     } else {
       slotSetItemRead(curIndex, 0);
     }
   } else {
-    QStringList feedIdList;
-
     bool markRead = false;
     for (int i = cnt-1; i >= 0; --i) {
       curIndex = indexes.at(i);
-      if (newsModel_->dataField(curIndex.row(), "read").toInt() == 0) {
+      if (newsModel_->dataField(curIndex.row(), NewsModel::FieldRead).toInt() == 0) {
         markRead = true;
         break;
       }
     }
 
-    db_.transaction();
-    QSqlQuery q;
     for (int i = cnt-1; i >= 0; --i) {
       curIndex = indexes.at(i);
+      int newsId = newsModel_->dataField(curIndex.row(), NewsModel::FieldId).toInt();
+      int feedId = newsModel_->dataField(curIndex.row(), NewsModel::FieldFeedId).toInt();
+      int unreadDelta = 0;
+      int newDelta = 0;
+      if (newsModel_->dataField(curIndex.row(), NewsModel::FieldNew).toInt() == 1)
+        newDelta = -1;
+      if (markRead && (newsModel_->dataField(curIndex.row(), NewsModel::FieldRead).toInt() == 0))
+        unreadDelta = -1;
+      else if (!markRead && (newsModel_->dataField(curIndex.row(), NewsModel::FieldRead).toInt() != 0))
+        unreadDelta = 1;
+
       newsModel_->setData(
-            newsModel_->index(curIndex.row(), newsModel_->fieldIndex("new")),
+            newsModel_->index(curIndex.row(), newsModel_->fieldColumn(NewsModel::FieldNew)),
             0);
       newsModel_->setData(
-            newsModel_->index(curIndex.row(), newsModel_->fieldIndex("read")),
+            newsModel_->index(curIndex.row(), newsModel_->fieldColumn(NewsModel::FieldRead)),
             markRead);
 
-      int newsId = newsModel_->dataField(curIndex.row(), "id").toInt();
-      q.exec(QString("UPDATE news SET new=0, read='%1' WHERE id=='%2'").
-             arg(markRead).arg(newsId));
-      QString feedId = newsModel_->dataField(curIndex.row(), "feedId").toString();
-      if (!feedIdList.contains(feedId)) feedIdList.append(feedId);
-    }
-    db_.commit();
-
-    foreach (QString feedId, feedIdList) {
-      mainWindow_->slotUpdateStatus(feedId.toInt());
+      mainApp->setNewsState(newsId, feedId, "new", 0);
+      mainApp->setNewsState(newsId, feedId, "read", int(markRead));
+      if (unreadDelta || newDelta)
+        mainWindow_->adjustFeedCounts(feedId, unreadDelta, newDelta);
     }
-    mainWindow_->recountCategoryCounts();
     newsView_->viewport()->update();
   }
 }
@@ -1001,16 +1101,24 @@ void NewsTabWidget::markAllNewsRead()
 
   QStringList feedIdList;
 
-  db_.transaction();
-  QSqlQuery q;
+  // News model is reselected below, so queued changes are written first
+  mainApp->flushNewsState();
+
+  QStringList idList;
   for (int i = cnt-1; i >= 0; --i) {
-    int newsId = newsModel_->dataField(i, "id").toInt();
-    q.exec(QString("UPDATE news SET read=1 WHERE id=='%1' AND read=0").arg(newsId));
-    q.exec(QString("UPDATE news SET new=0 WHERE id=='%1' AND new=1").arg(newsId));
+    idList.append(newsModel_->dataField(i, NewsModel::FieldId).toString());
 
-    QString feedId = newsModel_->dataField(i, "feedId").toString();
+    QString feedId = newsModel_->dataField(i, NewsModel::FieldFeedId).toString();
     if (!feedIdList.contains(feedId)) feedIdList.append(feedId);
   }
+
+  db_.transaction();
+  QSqlQuery q(db_);
+  foreach (const QString &sql, newsIdsQueries(
+             "UPDATE news SET read=MAX(read, 1), new=0 WHERE id IN (%1) AND (read=0 OR new=1)",
+             idList)) {
+    q.exec(sql);
+  }
   db_.commit();
 
   int currentRow = newsView_->currentIndex().row();
@@ -1022,7 +1130,7 @@ void NewsTabWidget::markAllNewsRead()
 
   loadNewspaper(RefreshWithPos);
 
-  newsView_->setCurrentIndex(newsModel_->index(currentRow, newsModel_->fieldIndex("title")));
+  newsView_->setCurrentIndex(newsModel_->index(currentRow, newsModel_->fieldColumn(NewsModel::FieldTitle)));
 
   foreach (QString feedId, feedIdList) {
     mainWindow_->slotUpdateStatus(feedId.toInt());
@@ -1038,7 +1146,7 @@ void NewsTabWidget::markNewsStar()
 
   QModelIndex curIndex;
   QList<QModelIndex> indexes = newsView_->selectionModel()->selectedRows(
-        newsModel_->fieldIndex("starred"));
+        newsModel_->fieldColumn(NewsModel::FieldStarred));
 
   int cnt = indexes.count();
   if (cnt == 0) return;
@@ -1060,19 +1168,13 @@ void NewsTabWidget::markNewsStar()
       }
     }
 
-    db_.transaction();
     for (int i = cnt-1; i >= 0; --i) {
       curIndex = indexes.at(i);
       newsModel_->setData(curIndex, markStar);
 
-      int newsId = newsModel_->dataField(curIndex.row(), "id").toInt();
-      QSqlQuery q;
-      q.exec(QString("UPDATE news SET starred='%1' WHERE id=='%2'").
-             arg(markStar).arg(newsId));
+      int newsId = newsModel_->dataField(curIndex.row(), NewsModel::FieldId).toInt();
+      mainApp->setNewsState(newsId, 0, "starred", int(markStar));
     }
-    db_.commit();
-
-    mainWindow_->recountCategoryCounts();
   }
 }
 
@@ -1083,88 +1185,107 @@ void NewsTabWidget::deleteNews()
   if (type_ >= TabTypeWeb) return;
 
   QModelIndex curIndex;
-  QList<QModelIndex> indexes = newsView_->selectionModel()->selectedRows(newsModel_->fieldIndex("deleted"));
+  QList<QModelIndex> indexes = newsView_->selectionModel()->selectedRows(newsModel_->fieldColumn(NewsModel::FieldDeleted));
 
   int cnt = indexes.count();
   if (cnt == 0) return;
 
   QStringList feedIdList;
+  QStringList idList;
+  QVariantList rows;
 
   if (type_ != TabTypeDel) {
     if (cnt == 1) {
       curIndex = indexes.at(0);
-      if (newsModel_->dataField(curIndex.row(), "starred").toInt() &&
+      if (newsModel_->dataField(curIndex.row(), NewsModel::FieldStarred).toInt() &&
           mainWindow_->notDeleteStarred_)
         return;
-      QString labelStr = newsModel_->dataField(curIndex.row(), "label").toString();
+      QString labelStr = newsModel_->dataField(curIndex.row(), NewsModel::FieldLabel).toString();
       if (!(labelStr.isEmpty() || (labelStr == ",")) && mainWindow_->notDeleteLabeled_)
         return;
 
       slotSetItemRead(curIndex, 1);
 
       newsModel_->setData(curIndex, 1);
-      newsModel_->setData(newsModel_->index(curIndex.row(), newsModel_->fieldIndex("deleteDate")),
+      newsModel_->setData(newsModel_->index(curIndex.row(), newsModel_->fieldColumn(NewsModel::FieldDeleteDate)),
                           QDateTime::currentDateTime().toString(Qt::ISODate));
 
-      QString feedId = newsModel_->dataField(curIndex.row(), "feedId").toString();
+      QString feedId = newsModel_->dataField(curIndex.row(), NewsModel::FieldFeedId).toString();
       if (!feedIdList.contains(feedId)) feedIdList.append(feedId);
 
       newsModel_->submitAll();
     } else {
-      db_.transaction();
-      QSqlQuery q;
       for (int i = cnt-1; i >= 0; --i) {
         curIndex = indexes.at(i);
-        if (newsModel_->dataField(curIndex.row(), "starred").toInt() &&
+        if (newsModel_->dataField(curIndex.row(), NewsModel::FieldStarred).toInt() &&
             mainWindow_->notDeleteStarred_)
           continue;
-        QString labelStr = newsModel_->dataField(curIndex.row(), "label").toString();
+        QString labelStr = newsModel_->dataField(curIndex.row(), NewsModel::FieldLabel).toString();
         if (!(labelStr.isEmpty() || (labelStr == ",")) && mainWindow_->notDeleteLabeled_)
           continue;
 
-        int newsId = newsModel_->dataField(curIndex.row(), "id").toInt();
-        q.exec(QString("UPDATE news SET new=0, read=2, deleted=1, deleteDate='%1' WHERE id=='%2'").
-               arg(QDateTime::currentDateTime().toString(Qt::ISODate)).
-               arg(newsId));
+        idList.append(newsModel_->dataField(curIndex.row(), NewsModel::FieldId).toString());
+        rows.append(curIndex.row());
 
-        QString feedId = newsModel_->dataField(curIndex.row(), "feedId").toString();
+        QString feedId = newsModel_->dataField(curIndex.row(), NewsModel::FieldFeedId).toString();
         if (!feedIdList.contains(feedId)) feedIdList.append(feedId);
       }
-      db_.commit();
-
-      newsModel_->select();
     }
   }
   else {
-    db_.transaction();
-    QSqlQuery q;
     for (int i = cnt-1; i >= 0; --i) {
       curIndex = indexes.at(i);
 
-      int newsId = newsModel_->dataField(curIndex.row(), "id").toInt();
-      q.exec(QString("UPDATE news SET description='', content='', received='', "
-                     "author_name='', author_uri='', author_email='', "
-                     "category='', new='', read='', starred='', label='', "
-                     "deleteDate='', feedParentId='', deleted=2 WHERE id=='%1'").
-             arg(newsId));
+      idList.append(newsModel_->dataField(curIndex.row(), NewsModel::FieldId).toString());
+      rows.append(curIndex.row());
 
-      QString feedId = newsModel_->dataField(curIndex.row(), "feedId").toString();
+      QString feedId = newsModel_->dataField(curIndex.row(), NewsModel::FieldFeedId).toString();
       if (!feedIdList.contains(feedId)) feedIdList.append(feedId);
     }
-    db_.commit();
+  }
 
-    newsModel_->select();
+  QVariantList tag;
+  tag << curIndex.row() << feedIdList;
+
+  // Many news are written by database thread, rows are hidden in list
+  // at once instead of reselecting it
+  if (!idList.isEmpty()) {
+    QString sql;
+    if (type_ != TabTypeDel) {
+      sql = QString("UPDATE news SET new=0, read=2, deleted=1, deleteDate='%1' WHERE id IN (%2)").
+          arg(QDateTime::currentDateTime().toString(Qt::ISODate), "%1");
+    } else {
+      sql = "UPDATE news SET description='', content='', received='', "
+          "author_name='', author_uri='', author_email='', "
+          "category='', new='', read='', starred='', label='', "
+          "deleteDate='', feedParentId='', deleted=2 WHERE id IN (%1)";
+    }
+    hideNewsRows(rows, (type_ != TabTypeDel) ? 1 : 2);
+    mainApp->asyncQuery()->exec(newsIdsQueries(sql, idList), this, "slotNewsDeleted", tag);
+    return;
   }
 
-  while (newsModel_->canFetchMore())
-    newsModel_->fetchMore();
+  AsyncQueryResult result;
+  result.id = 0;
+  result.tag = tag;
+  slotNewsDeleted(result);
+}
 
-  if (curIndex.row() == newsModel_->rowCount())
-    curIndex = newsModel_->index(curIndex.row()-1, newsModel_->fieldIndex("title"));
-  else if (curIndex.row() > newsModel_->rowCount())
-    curIndex = newsModel_->index(newsModel_->rowCount()-1, newsModel_->fieldIndex("title"));
-  else
-    curIndex = newsModel_->index(curIndex.row(), newsModel_->fieldIndex("title"));
+/** @brief Select news near removed rows after news are deleted
+ *----------------------------------------------------------------------------*/
+void NewsTabWidget::slotNewsDeleted(AsyncQueryResult result)
+{
+  int row = result.tag.toList().at(0).toInt();
+  QStringList feedIdList = result.tag.toList().at(1).toStringList();
+
+  // Hidden rows may not match base if writing failed
+  if (!result.error.isEmpty()) {
+    newsModel_->select();
+    while (newsModel_->canFetchMore())
+      newsModel_->fetchMore();
+  }
+
+  QModelIndex curIndex = visibleNewsIndex(row);
   newsView_->setCurrentIndex(curIndex);
   slotNewsViewSelected(curIndex);
 
@@ -1184,42 +1305,45 @@ void NewsTabWidget::deleteAllNewsList()
   if (cnt == 0) return;
 
   QStringList feedIdList;
+  QStringList idList;
 
-  db_.transaction();
-  QSqlQuery q;
   for (int i = cnt-1; i >= 0; --i) {
-    int newsId = newsModel_->dataField(i, "id").toInt();
-
     if (type_ != TabTypeDel) {
-      if (newsModel_->dataField(i, "starred").toInt() &&
+      if (newsModel_->dataField(i, NewsModel::FieldStarred).toInt() &&
           mainWindow_->notDeleteStarred_)
         continue;
-      QString labelStr = newsModel_->dataField(i, "label").toString();
+      QString labelStr = newsModel_->dataField(i, NewsModel::FieldLabel).toString();
       if (!(labelStr.isEmpty() || (labelStr == ",")) && mainWindow_->notDeleteLabeled_)
         continue;
-
-      q.exec(QString("UPDATE news SET new=0, read=2, deleted=1, deleteDate='%1' WHERE id=='%2'").
-             arg(QDateTime::currentDateTime().toString(Qt::ISODate)).
-             arg(newsId));
-    }
-    else {
-      q.exec(QString("UPDATE news SET description='', content='', received='', "
-                     "author_name='', author_uri='', author_email='', "
-                     "category='', new='', read='', starred='', label='', "
-                     "deleteDate='', feedParentId='', deleted=2 WHERE id=='%1'").
-             arg(newsId));
     }
+    idList.append(newsModel_->dataField(i, NewsModel::FieldId).toString());
 
-    QString feedId = newsModel_->dataField(i, "feedId").toString();
+    QString feedId = newsModel_->dataField(i, NewsModel::FieldFeedId).toString();
     if (!feedIdList.contains(feedId)) feedIdList.append(feedId);
   }
-  db_.commit();
+  if (idList.isEmpty()) return;
 
+  QString sql;
+  if (type_ != TabTypeDel) {
+    sql = QString("UPDATE news SET new=0, read=2, deleted=1, deleteDate='%1' WHERE id IN (%2)").
+        arg(QDateTime::currentDateTime().toString(Qt::ISODate), "%1");
+  } else {
+    sql = "UPDATE news SET description='', content='', received='', "
+        "author_name='', author_uri='', author_email='', "
+        "category='', new='', read='', starred='', label='', "
+        "deleteDate='', feedParentId='', deleted=2 WHERE id IN (%1)";
+  }
+  mainApp->asyncQuery()->exec(newsIdsQueries(sql, idList), this, "slotAllNewsDeleted", feedIdList);
+}
+
+// ----------------------------------------------------------------------------
+void NewsTabWidget::slotAllNewsDeleted(AsyncQueryResult result)
+{
   newsModel_->select();
 
   slotNewsViewSelected(QModelIndex());
 
-  foreach (QString feedId, feedIdList) {
+  foreach (QString feedId, result.tag.toStringList()) {
     mainWindow_->slotUpdateStatus(feedId.toInt());
   }
   mainWindow_->recountCategoryCounts();
@@ -1232,7 +1356,7 @@ void NewsTabWidget::restoreNews()
   if (type_ >= TabTypeWeb) return;
 
   QModelIndex curIndex;
-  QList<QModelIndex> indexes = newsView_->selectionModel()->selectedRows(newsModel_->fieldIndex("deleted"));
+  QList<QModelIndex> indexes = newsView_->selectionModel()->selectedRows(newsModel_->fieldColumn(NewsModel::FieldDeleted));
 
   int cnt = indexes.count();
   if (cnt == 0) return;
@@ -1242,43 +1366,57 @@ void NewsTabWidget::restoreNews()
   if (cnt == 1) {
     curIndex = indexes.at(0);
     newsModel_->setData(curIndex, 0);
-    newsModel_->setData(newsModel_->index(curIndex.row(), newsModel_->fieldIndex("deleteDate")), "");
+    newsModel_->setData(newsModel_->index(curIndex.row(), newsModel_->fieldColumn(NewsModel::FieldDeleteDate)), "");
     newsModel_->submitAll();
 
-    QString feedId = newsModel_->dataField(curIndex.row(), "feedId").toString();
+    QString feedId = newsModel_->dataField(curIndex.row(), NewsModel::FieldFeedId).toString();
     if (!feedIdList.contains(feedId)) feedIdList.append(feedId);
   } else {
-    db_.transaction();
-    QSqlQuery q;
+    QStringList idList;
+    QVariantList rows;
     for (int i = cnt-1; i >= 0; --i) {
       curIndex = indexes.at(i);
-      int newsId = newsModel_->dataField(curIndex.row(), "id").toInt();
-      q.exec(QString("UPDATE news SET deleted=0, deleteDate='' WHERE id=='%1'").
-             arg(newsId));
+      idList.append(newsModel_->dataField(curIndex.row(), NewsModel::FieldId).toString());
+      rows.append(curIndex.row());
 
-      QString feedId = newsModel_->dataField(curIndex.row(), "feedId").toString();
+      QString feedId = newsModel_->dataField(curIndex.row(), NewsModel::FieldFeedId).toString();
       if (!feedIdList.contains(feedId)) feedIdList.append(feedId);
     }
-    db_.commit();
 
-    newsModel_->select();
+    QVariantList tag;
+    tag << curIndex.row() << feedIdList;
+    hideNewsRows(rows, 0);
+    mainApp->asyncQuery()->exec(
+          newsIdsQueries("UPDATE news SET deleted=0, deleteDate='' WHERE id IN (%1)", idList),
+          this, "slotNewsRestored", tag);
+    return;
   }
 
-  while (newsModel_->canFetchMore())
-    newsModel_->fetchMore();
+  AsyncQueryResult result;
+  result.id = 0;
+  result.tag = QVariantList() << curIndex.row() << feedIdList;
+  slotNewsRestored(result);
+}
+
+/** @brief Select news near removed rows after news are restored
+ *----------------------------------------------------------------------------*/
+void NewsTabWidget::slotNewsRestored(AsyncQueryResult result)
+{
+  int row = result.tag.toList().at(0).toInt();
+  QStringList feedIdList = result.tag.toList().at(1).toStringList();
+
+  if (!result.error.isEmpty()) {
+    newsModel_->select();
+    while (newsModel_->canFetchMore())
+      newsModel_->fetchMore();
+  }
 
   loadNewspaper(RefreshWithPos);
 
-  if (curIndex.row() == newsModel_->rowCount())
-    curIndex = newsModel_->index(curIndex.row()-1, newsModel_->fieldIndex("title"));
-  else if (curIndex.row() > newsModel_->rowCount())
-    curIndex = newsModel_->index(newsModel_->rowCount()-1, newsModel_->fieldIndex("title"));
-  else
-    curIndex = newsModel_->index(curIndex.row(), newsModel_->fieldIndex("title"));
+  QModelIndex curIndex = visibleNewsIndex(row);
   newsView_->setCurrentIndex(curIndex);
   slotNewsViewSelected(curIndex);
   mainWindow_->slotUpdateStatus(feedId_);
-  mainWindow_->recountCategoryCounts();
 
   foreach (QString feedId, feedIdList) {
     mainWindow_->slotUpdateStatus(feedId.toInt());
@@ -1286,6 +1424,42 @@ void NewsTabWidget::restoreNews()
   mainWindow_->recountCategoryCounts();
 }
 
+/** @brief Remove rows of news from list without reselecting model
+ * @param deleted New value of "deleted" field kept in model cache
+ *
+ * Rows are hidden until list is selected again.
+ *----------------------------------------------------------------------------*/
+void NewsTabWidget::hideNewsRows(const QVariantList &rows, int deleted)
+{
+  int columnDeleted = newsModel_->fieldColumn(NewsModel::FieldDeleted);
+  int columnRead = newsModel_->fieldColumn(NewsModel::FieldRead);
+  int columnNew = newsModel_->fieldColumn(NewsModel::FieldNew);
+  foreach (const QVariant &row, rows) {
+    newsModel_->setData(newsModel_->index(row.toInt(), columnDeleted), deleted);
+    if (deleted) {
+      newsModel_->setData(newsModel_->index(row.toInt(), columnRead), 2);
+      newsModel_->setData(newsModel_->index(row.toInt(), columnNew), 0);
+    }
+    newsView_->setRowHidden(row.toInt(), QModelIndex(), true);
+  }
+}
+
+/** @brief Visible row at \a row or nearest before it
+ *----------------------------------------------------------------------------*/
+QModelIndex NewsTabWidget::visibleNewsIndex(int row)
+{
+  int columnTitle = newsModel_->fieldColumn(NewsModel::FieldTitle);
+  for (int i = row; i < newsModel_->rowCount(); ++i) {
+    if (!newsView_->isRowHidden(i, QModelIndex()))
+      return newsModel_->index(i, columnTitle);
+  }
+  for (int i = qMin(row, newsModel_->rowCount()) - 1; i >= 0; --i) {
+    if (!newsView_->isRowHidden(i, QModelIndex()))
+      return newsModel_->index(i, columnTitle);
+  }
+  return QModelIndex();
+}
+
 /** @brief Copy news link
  *----------------------------------------------------------------------------*/
 void NewsTabWidget::slotCopyLinkNews()
@@ -1307,32 +1481,6 @@ void NewsTabWidget::slotCopyLinkNews()
   clipboard->setText(copyStr);
 }
 
-/** @brief Sort news by Star or Read column
- *----------------------------------------------------------------------------*/
-void NewsTabWidget::slotSort(int column, int/* order*/)
-{
-  QString strId;
-  if (feedsModel_->isFolder(feedsModel_->indexById(feedId_))) {
-    strId = QString("(%1)").arg(mainWindow_->getIdFeedsString(feedId_));
-  } else {
-    strId = QString("feedId='%1'").arg(feedId_);
-  }
-
-  QString qStr;
-  if (column == newsModel_->fieldIndex("read")) {
-    qStr = QString("UPDATE news SET rights=read WHERE %1").arg(strId);
-  }
-  else if (column == newsModel_->fieldIndex("starred")) {
-    qStr = QString("UPDATE news SET rights=starred WHERE %1").arg(strId);
-  }
-  else if (column == newsModel_->fieldIndex("rights")) {
-    qStr = QString("UPDATE news SET rights = (SELECT text from feeds where id = news.feedId) WHERE %1").arg(strId);
-  }
-
-  QSqlQuery q;
-  q.exec(qStr);
-}
-
 /** @brief Load/Update browser contents
  *----------------------------------------------------------------------------*/
 void NewsTabWidget::updateWebView(QModelIndex index)
@@ -1342,21 +1490,22 @@ void NewsTabWidget::updateWebView(QModelIndex index)
     return;
   }
 
-  QString newsId = newsModel_->dataField(index.row(), "id").toString();
   linkNewsString_ = getLinkNews(index.row());
-  QString linkString = linkNewsString_;
-  QUrl newsUrl = QUrl::fromEncoded(linkString.toUtf8());
+  QUrl newsUrl = QUrl::fromEncoded(linkNewsString_.toUtf8());
 
   bool showDescriptionNews_ = mainWindow_->showDescriptionNews_;
   QModelIndex currentIndex = feedsProxyModel_->mapToSource(feedsView_->currentIndex());
   QVariant displayNews = feedsModel_->dataField(currentIndex, "displayNews");
-  QString feedId = newsModel_->dataField(index.row(), "feedId").toString();
-  QModelIndex feedIndex = feedsModel_->indexById(feedId.toInt());
 
   if (!displayNews.toString().isEmpty())
     showDescriptionNews_ = !displayNews.toInt();
 
-  if (!showDescriptionNews_) {
+  // Stored article is shown instead of page when it was fetched
+  if (!showDescriptionNews_ && (mainWindow_->externalBrowserOn_ <= 0) &&
+      hasArticle(index.row())) {
+    setWebToolbarVisible(false, false);
+    emit signalSetHtmlWebView(cachedNewsHtml(index.row()));
+  } else if (!showDescriptionNews_) {
     if (mainWindow_->externalBrowserOn_ <= 0) {
       locationBar_->setText(newsUrl.toString());
       setWebToolbarVisible(true, false);
@@ -1370,199 +1519,421 @@ void NewsTabWidget::updateWebView(QModelIndex index)
   } else {
     setWebToolbarVisible(false, false);
 
-    QString htmlStr;
-    QString content = newsModel_->dataField(index.row(), "content").toString();
-    if (!content.contains(QzRegExp("<html(.*)</html>", Qt::CaseInsensitive))) {
-      QString description = newsModel_->dataField(index.row(), "description").toString();
-      if (content.isEmpty() || (description.length() > content.length())) {
-        content = description;
-      }
+    emit signalSetHtmlWebView(cachedNewsHtml(index.row()));
+    prerenderTimer_->start(NEWS_PRERENDER_DELAY);
+  }
+}
 
-      QString titleString = newsModel_->dataField(index.row(), "title").toString();
-      if (!linkString.isEmpty()) {
-        titleString = QString("<a href='%1' class='unread'>%2</a>").
-            arg(linkString, titleString);
-      }
+/** @brief Build HTML of news description for web view
+ *----------------------------------------------------------------------------*/
+QString NewsTabWidget::newsHtml(int row)
+{
+  QString newsId = newsModel_->dataField(row, NewsModel::FieldId).toString();
+  QString linkString = getLinkNews(row);
+  QUrl newsUrl = QUrl::fromEncoded(linkString.toUtf8());
+  QString feedId = newsModel_->dataField(row, NewsModel::FieldFeedId).toString();
+  QModelIndex feedIndex = feedsModel_->indexById(feedId.toInt());
 
-      QDateTime dtLocal;
-      QString dateString = newsModel_->dataField(index.row(), "published").toString();
-      if (!dateString.isNull()) {
-        QDateTime dtLocalTime = QDateTime::currentDateTime();
-        QDateTime dtUTC = QDateTime(dtLocalTime.date(), dtLocalTime.time(), Qt::UTC);
-        int nTimeShift = dtLocalTime.secsTo(dtUTC);
+  QString htmlStr;
+  QString description;
+  QString article;
+  QString content = getNewsContent(row, &description, &article);
+  if (!article.isEmpty()) {
+    bool showDescriptionNews = mainWindow_->showDescriptionNews_;
+    QVariant displayNews = feedsModel_->dataField(feedIndex, "displayNews");
+    if (!displayNews.toString().isEmpty())
+      showDescriptionNews = !displayNews.toInt();
+    if (!showDescriptionNews) {
+      content = article;
+      description.clear();
+    }
+  }
+  if (!content.contains(QzRegExp("<html(.*)</html>", Qt::CaseInsensitive))) {
+    if (content.isEmpty() || (description.length() > content.length())) {
+      content = description;
+    }
 
-        QDateTime dt = QDateTime::fromString(dateString, Qt::ISODate);
-        dtLocal = dt.addSecs(nTimeShift);
-      } else {
-        dtLocal = QDateTime::fromString(
-              newsModel_->dataField(index.row(), "received").toString(),
-              Qt::ISODate);
-      }
-      if (QDateTime::currentDateTime().date() <= dtLocal.date())
-        dateString = dtLocal.toString(mainWindow_->formatTime_);
-      else
-        dateString = dtLocal.toString(mainWindow_->formatDate_ + " " + mainWindow_->formatTime_);
-
-      // Create author panel from news author
-      QString authorString;
-      QString authorName = newsModel_->dataField(index.row(), "author_name").toString();
-      QString authorEmail = newsModel_->dataField(index.row(), "author_email").toString();
-      QString authorUri = newsModel_->dataField(index.row(), "author_uri").toString();
-
-      QzRegExp reg("(^\\S+@\\S+\\.\\S+)", Qt::CaseInsensitive);
-      int pos = reg.indexIn(authorName);
-      if (pos > -1) {
-        authorName.replace(reg.cap(1), QString(" <a href='mailto:%1'>%1</a>").arg(reg.cap(1)));
-      }
+    QString titleString = newsModel_->dataField(row, NewsModel::FieldTitle).toString();
+    if (!linkString.isEmpty()) {
+      titleString = QString("<a href='%1' class='unread'>%2</a>").
+          arg(linkString, titleString);
+    }
+
+    QDateTime dtLocal;
+    QString dateString = newsModel_->dataField(row, NewsModel::FieldPublished).toString();
+    if (!dateString.isNull()) {
+      QDateTime dtLocalTime = QDateTime::currentDateTime();
+      QDateTime dtUTC = QDateTime(dtLocalTime.date(), dtLocalTime.time(), Qt::UTC);
+      int nTimeShift = dtLocalTime.secsTo(dtUTC);
+
+      QDateTime dt = QDateTime::fromString(dateString, Qt::ISODate);
+      dtLocal = dt.addSecs(nTimeShift);
+    } else {
+      dtLocal = QDateTime::fromString(
+            newsModel_->dataField(row, NewsModel::FieldReceived).toString(),
+            Qt::ISODate);
+    }
+    if (QDateTime::currentDateTime().date() <= dtLocal.date())
+      dateString = dtLocal.toString(mainWindow_->formatTime_);
+    else
+      dateString = dtLocal.toString(mainWindow_->formatDate_ + " " + mainWindow_->formatTime_);
+
+    // Create author panel from news author
+    QString authorString;
+    QString authorName = newsModel_->dataField(row, NewsModel::FieldAuthorName).toString();
+    QString authorEmail = newsModel_->dataField(row, NewsModel::FieldAuthorEmail).toString();
+    QString authorUri = newsModel_->dataField(row, NewsModel::FieldAuthorUri).toString();
+
+    QzRegExp reg("(^\\S+@\\S+\\.\\S+)", Qt::CaseInsensitive);
+    int pos = reg.indexIn(authorName);
+    if (pos > -1) {
+      authorName.replace(reg.cap(1), QString(" <a href='mailto:%1'>%1</a>").arg(reg.cap(1)));
+    }
+
+    authorString = authorName;
+
+    if (!authorEmail.isEmpty())
+      authorString.append(QString(" <a href='mailto:%1'>e-mail</a>").arg(authorEmail));
+    if (!authorUri.isEmpty())
+      authorString.append(QString(" <a href='%1'>page</a>"). arg(authorUri));
+
+    // If news author is absent, create author panel from feed author
+    // @note(arhohryakov:2012.01.03) Author is got from current feed, because
+    //   news is belong to it
+    if (authorString.isEmpty()) {
+      authorName  = feedsModel_->dataField(feedIndex, "author_name").toString();
+      authorEmail = feedsModel_->dataField(feedIndex, "author_email").toString();
+      authorUri   = feedsModel_->dataField(feedIndex, "author_uri").toString();
 
       authorString = authorName;
 
       if (!authorEmail.isEmpty())
         authorString.append(QString(" <a href='mailto:%1'>e-mail</a>").arg(authorEmail));
       if (!authorUri.isEmpty())
-        authorString.append(QString(" <a href='%1'>page</a>"). arg(authorUri));
-
-      // If news author is absent, create author panel from feed author
-      // @note(arhohryakov:2012.01.03) Author is got from current feed, because
-      //   news is belong to it
-      if (authorString.isEmpty()) {
-        authorName  = feedsModel_->dataField(feedIndex, "author_name").toString();
-        authorEmail = feedsModel_->dataField(feedIndex, "author_email").toString();
-        authorUri   = feedsModel_->dataField(feedIndex, "author_uri").toString();
-
-        authorString = authorName;
-
-        if (!authorEmail.isEmpty())
-          authorString.append(QString(" <a href='mailto:%1'>e-mail</a>").arg(authorEmail));
-        if (!authorUri.isEmpty())
-          authorString.append(QString(" <a href='%1'>page</a>").arg(authorUri));
-      }
+        authorString.append(QString(" <a href='%1'>page</a>").arg(authorUri));
+    }
 
-      QString commentsStr;
-      QString commentsUrl = newsModel_->dataField(index.row(), "comments").toString();
+    QString commentsStr;
+    QString commentsUrl = newsModel_->dataField(row, NewsModel::FieldComments).toString();
 
-      if (!commentsUrl.isEmpty())
-      {
-        commentsStr = QString("<a href=\"%1\"> %2</a>").arg(commentsUrl, tr("Comments"));
-      }
+    if (!commentsUrl.isEmpty())
+    {
+      commentsStr = QString("<a href=\"%1\"> %2</a>").arg(commentsUrl, tr("Comments"));
+    }
+
+    QString category = newsModel_->dataField(row, NewsModel::FieldCategory).toString();
 
-      QString category = newsModel_->dataField(index.row(), "category").toString();
+    if (!authorString.isEmpty())
+    {
+      authorString = QString(tr("Author: %1")).arg(authorString);
 
-      if (!authorString.isEmpty())
+      if (!commentsStr.isEmpty())
       {
-        authorString = QString(tr("Author: %1")).arg(authorString);
+        authorString.append(QString(" | %1").arg(commentsStr));
+      }
+      if (!category.isEmpty())
+      {
+        authorString.append(QString(" | %1").arg(category));
+      }
+    }
+    else
+    {
+      if (!commentsStr.isEmpty())
+      {
+        authorString.append(commentsStr);
+      }
 
+      if (!category.isEmpty())
+      {
         if (!commentsStr.isEmpty())
         {
-          authorString.append(QString(" | %1").arg(commentsStr));
+          authorString.append(QString(" | %1").arg(category));
         }
-        if (!category.isEmpty())
+        else
         {
-          authorString.append(QString(" | %1").arg(category));
+          authorString.append(category);
+        }
+      }
+    }
+
+    QString labelsString = getHtmlLabels(row);
+
+    authorString.append(QString("<table class=\"labels\" id=\"labels%1\"><tr>%2</tr></table>").
+                        arg(newsId).arg(labelsString));
+
+    QString enclosureStr;
+    QString enclosureUrl = newsModel_->dataField(row, NewsModel::FieldEnclosureUrl).toString();
+
+    if (!enclosureUrl.isEmpty())
+    {
+      QString type = newsModel_->dataField(row, NewsModel::FieldEnclosureType).toString();
+
+      if (type.contains("image"))
+      {
+        if (!content.contains(enclosureUrl) && autoLoadImages_)
+        {
+          enclosureStr = QString("<IMG SRC=\"%1\" class=\"enclosureImg\"><p>").arg(enclosureUrl);
         }
       }
       else
       {
-        if (!commentsStr.isEmpty())
+        if (type.contains("audio"))
         {
-          authorString.append(commentsStr);
+          type = tr("audio");
+          enclosureStr = audioPlayerHtml_.render(enclosureUrl);
+          enclosureStr.append("<p>");
         }
-
-        if (!category.isEmpty())
+        else if (type.contains("video"))
         {
-          if (!commentsStr.isEmpty())
-          {
-            authorString.append(QString(" | %1").arg(category));
-          }
-          else
-          {
-            authorString.append(category);
-          }
+          type = tr("video");
+          enclosureStr = videoPlayerHtml_.render(enclosureUrl);
+          enclosureStr.append("<p>");
         }
+        else
+        {
+          type = tr("media");
+        }
+
+        enclosureStr.append(QString("<a href=\"%1\" class=\"enclosure\"> %2 %3 </a><p>").
+                            arg(enclosureUrl, tr("Link to"), type));
       }
+    }
 
-      QString labelsString = getHtmlLabels(index.row());
+    content = enclosureStr + content;
 
-      authorString.append(QString("<table class=\"labels\" id=\"labels%1\"><tr>%2</tr></table>").
-                          arg(newsId).arg(labelsString));
+    bool ltr = !feedsModel_->dataField(feedIndex, "layoutDirection").toInt();
+    QString cssStr = cssString_.render(
+          ltr ? "left" : "right",   // text-align
+          ltr ? "ltr" : "rtl",      // direction
+          ltr ? "right" : "left");  // "Date" text-align
 
-      QString enclosureStr;
-      QString enclosureUrl = newsModel_->dataField(index.row(), "enclosure_url").toString();
+    if (!autoLoadImages_) {
+      QzRegExp reg("<img[^>]+>", Qt::CaseInsensitive);
+      content = content.remove(reg);
+    }
 
-      if (!enclosureUrl.isEmpty())
-      {
-        QString type = newsModel_->dataField(index.row(), "enclosure_type").toString();
+    QUrl url;
+    url.setScheme(newsUrl.scheme());
+    url.setHost(newsUrl.host());
+    if (url.host().indexOf('.') == -1) {
+      QUrl hostUrl = feedsModel_->dataField(feedIndex, "htmlUrl").toString();
+      url.setHost(hostUrl.host());
+    }
 
-        if (type.contains("image"))
-        {
-          if (!content.contains(enclosureUrl) && autoLoadImages_)
-          {
-            enclosureStr = QString("<IMG SRC=\"%1\" class=\"enclosureImg\"><p>").arg(enclosureUrl);
-          }
-        }
-        else
-        {
-          if (type.contains("audio"))
-          {
-            type = tr("audio");
-            enclosureStr = audioPlayerHtml_.arg(enclosureUrl);
-            enclosureStr.append("<p>");
-          }
-          else if (type.contains("video"))
-          {
-            type = tr("video");
-            enclosureStr = videoPlayerHtml_.arg(enclosureUrl);
-            enclosureStr.append("<p>");
-          }
-          else
-          {
-            type = tr("media");
-          }
+    const QString values[] = { cssStr, titleString, dateString, authorString,
+                               content, url.toString() };
+    if (ltr)
+      htmlStr = htmlString_.render(values, 6);
+    else
+      htmlStr = htmlRtlString_.render(values, 6);
+  } else {
+    if (!autoLoadImages_) {
+      content = content.remove(QzRegExp("<img[^>]+>", Qt::CaseInsensitive));
+    }
 
-          enclosureStr.append(QString("<a href=\"%1\" class=\"enclosure\"> %2 %3 </a><p>").
-                              arg(enclosureUrl, tr("Link to"), type));
-        }
-      }
+    htmlStr = content;
+  }
 
-      content = enclosureStr + content;
+  htmlStr = htmlStr.replace("src=\"//", "src=\"http://");
+  return htmlStr;
+}
 
-      bool ltr = !feedsModel_->dataField(feedIndex, "layoutDirection").toInt();
-      QString cssStr = cssString_.
-          arg(ltr ? "left" : "right").  // text-align
-          arg(ltr ? "ltr" : "rtl").    // direction
-          arg(ltr ? "right" : "left");  // "Date" text-align
+/** @brief HTML of news description, built once and kept in cache
+ *
+ * Cache is cleared when news list is selected again, loading of images
+ * or settings are changed. Edited news are removed from it.
+ *----------------------------------------------------------------------------*/
+QString NewsTabWidget::cachedNewsHtml(int row)
+{
+  int newsId = newsModel_->dataField(row, NewsModel::FieldId).toInt();
+  QString *html = htmlCache_.object(newsId);
+  if (html)
+    return *html;
 
-      if (!autoLoadImages_) {
-        QzRegExp reg("<img[^>]+>", Qt::CaseInsensitive);
-        content = content.remove(reg);
-      }
+  QString htmlStr = newsHtml(row);
+  htmlCache_.insert(newsId, new QString(htmlStr));
+  return htmlStr;
+}
 
-      QUrl url;
-      url.setScheme(newsUrl.scheme());
-      url.setHost(newsUrl.host());
-      if (url.host().indexOf('.') == -1) {
-        QUrl hostUrl = feedsModel_->dataField(feedIndex, "htmlUrl").toString();
-        url.setHost(hostUrl.host());
-      }
+/** @brief Build HTML of neighbouring and next unread news in advance
+ *----------------------------------------------------------------------------*/
+void NewsTabWidget::slotPrerenderNews()
+{
+  if (mainWindow_->newsLayout_ == 1) return;
 
-      if (ltr)
-        htmlStr = htmlString_.arg(cssStr, titleString, dateString, authorString, content, url.toString());
-      else
-        htmlStr = htmlRtlString_.arg(cssStr, titleString, dateString, authorString, content, url.toString());
-    } else {
-      if (!autoLoadImages_) {
-        content = content.remove(QzRegExp("<img[^>]+>", Qt::CaseInsensitive));
-      }
+  int row = newsView_->currentIndex().row();
+  if (row < 0) return;
+
+  QList<int> rowList;
+  rowList << row + 1 << row - 1 << findUnreadNews(true);
+  foreach (int prerenderRow, rowList) {
+    if ((prerenderRow >= 0) && (prerenderRow < newsModel_->rowCount()) &&
+        (prerenderRow != row))
+      cachedNewsHtml(prerenderRow);
+  }
+}
+
+void NewsTabWidget::slotClearHtmlCache()
+{
+  htmlCache_.clear();
+}
+
+/** @brief Read html templates once for all tabs
+ *----------------------------------------------------------------------------*/
+void NewsTabWidget::loadTemplates()
+{
+  if (newsTemplates.loaded) return;
+
+  newsTemplates.newspaperHeadHtml.setText(readHtmlResource(":/html/newspaper_head"));
+  newsTemplates.newspaperHtml.setText(readHtmlResource(":/html/newspaper_description"));
+  newsTemplates.newspaperHtmlRtl.setText(readHtmlResource(":/html/newspaper_description_rtl"));
+  newsTemplates.htmlString.setText(readHtmlResource(":/html/description"));
+  newsTemplates.htmlRtlString.setText(readHtmlResource(":/html/description_rtl"));
+  newsTemplates.audioPlayerHtml.setText(readHtmlResource(":/html/audioplayer"));
+  newsTemplates.videoPlayerHtml.setText(readHtmlResource(":/html/videoplayer"));
+
+  QWebSettings::setObjectCacheCapacities(0, 0, 0);
+  newsTemplates.loaded = true;
+}
+
+/** @brief Get news style sheet formatted with fonts and colors of settings
+ *
+ * Style sheet is shared by all tabs. File is read again only if its path,
+ * modification time or one of settings used in it has changed.
+ *----------------------------------------------------------------------------*/
+HtmlTemplate NewsTabWidget::newsCssString(const QString &styleSheetNews)
+{
+  QFileInfo fileInfo(styleSheetNews);
+  QStringList keyList;
+  keyList << styleSheetNews << QString::number(fileInfo.lastModified().toTime_t())
+          << mainWindow_->newsTextFontFamily_ << QString::number(mainWindow_->newsTextFontSize_)
+          << mainWindow_->newsTitleFontFamily_ << QString::number(mainWindow_->newsTitleFontSize_)
+          << qApp->palette().color(QPalette::Dark).name()
+          << mainWindow_->newsBackgroundColor_ << mainWindow_->newsTitleBackgroundColor_
+          << mainWindow_->linkColor_ << mainWindow_->titleColor_
+          << mainWindow_->dateColor_ << mainWindow_->authorColor_
+          << mainWindow_->newsTextColor_;
+  QString cssKey = keyList.join("\n");
+  if (cssKey == newsTemplates.cssKey)
+    return newsTemplates.cssString;
+
+  QFile file(styleSheetNews);
+  if (!file.open(QFile::ReadOnly)) {
+    file.setFileName(":/style/newsStyle");
+    file.open(QFile::ReadOnly);
+  }
+  newsTemplates.cssString.setText(QString::fromUtf8(file.readAll()).
+      arg(mainWindow_->newsTextFontFamily_).
+      arg(mainWindow_->newsTextFontSize_).
+      arg(mainWindow_->newsTitleFontFamily_).
+      arg(mainWindow_->newsTitleFontSize_).
+      arg(0).
+      arg(qApp->palette().color(QPalette::Dark).name()). // color separator
+      arg(mainWindow_->newsBackgroundColor_). // news background
+      arg(mainWindow_->newsTitleBackgroundColor_). // title background
+      arg(mainWindow_->linkColor_). // link color
+      arg(mainWindow_->titleColor_). // title color
+      arg(mainWindow_->dateColor_). // date color
+      arg(mainWindow_->authorColor_). // author color
+      arg(mainWindow_->newsTextColor_)); // text color
+  file.close();
+  newsTemplates.cssKey = cssKey;
+  return newsTemplates.cssString;
+}
+
+/** @brief Free news list and page of tab which was not shown for long time
+ *
+ * Filter, current news and scroll position are kept; rows of model are
+ * loaded again by wakeUp() when tab becomes current.
+ *----------------------------------------------------------------------------*/
+void NewsTabWidget::hibernate()
+{
+  if (hibernated_ || (type_ == TabTypeDownloads)) return;
+
+  if (type_ < TabTypeWeb) {
+    hibernatedFilter_ = newsModel_->filter();
+    hibernatedNewsId_ = currentNewsId();
+    hibernatedScroll_ = newsView_->verticalScrollBar()->value();
+    newsModel_->setFilter("0");
+    newsModel_->select();
+  }
+  releaseMemory(true);
+  hibernated_ = true;
+}
+
+/** @brief Get id of current news, kept one for hibernated tab
+ *----------------------------------------------------------------------------*/
+int NewsTabWidget::currentNewsId()
+{
+  if (hibernated_)
+    return hibernatedNewsId_;
+  return newsModel_->index(newsView_->currentIndex().row(),
+                           newsModel_->fieldColumn(NewsModel::FieldId)).data(Qt::EditRole).toInt();
+}
 
-      htmlStr = content;
+/** @brief Restore news list of hibernated tab
+ *----------------------------------------------------------------------------*/
+void NewsTabWidget::wakeUp()
+{
+  if (!hibernated_) return;
+  hibernated_ = false;
+
+  if (type_ < TabTypeWeb) {
+    newsModel_->setFilter(hibernatedFilter_);
+    newsModel_->select();
+    while (newsModel_->canFetchMore())
+      newsModel_->fetchMore();
+
+    QModelIndex index = newsModel_->index(0, newsModel_->fieldColumn(NewsModel::FieldId));
+    QModelIndexList indexList = newsModel_->match(index, Qt::EditRole, hibernatedNewsId_);
+    if (indexList.count()) {
+      newsView_->setCurrentIndex(newsModel_->index(indexList.first().row(),
+                                                   newsModel_->fieldColumn(NewsModel::FieldTitle)));
     }
+    newsView_->verticalScrollBar()->setValue(hibernatedScroll_);
+    hibernatedFilter_.clear();
+  }
+}
+
+/** @brief Free caches of tab while window is hidden
+ *
+ * If \a releaseWebView is set page of browser is dropped too. It is loaded
+ * again by setSettings() when tab becomes current.
+ *----------------------------------------------------------------------------*/
+void NewsTabWidget::releaseMemory(bool releaseWebView)
+{
+  if (type_ == TabTypeDownloads) return;
 
-    htmlStr = htmlStr.replace("src=\"//", "src=\"http://");
+  htmlCache_.clear();
+  if (type_ < TabTypeWeb)
+    newsModel_->releaseMemory();
 
-    emit signalSetHtmlWebView(htmlStr);
+  if (releaseWebView && !webViewReleased_) {
+    if (type_ == TabTypeWeb)
+      releasedUrl_ = webView_->url();
+    webView_->stop();
+    webView_->history()->clear();
+    webView_->setHtml("");
+    webViewReleased_ = true;
   }
 }
 
+/** @brief Remove edited news from HTML cache
+ *----------------------------------------------------------------------------*/
+void NewsTabWidget::slotNewsDataChanged(const QModelIndex &topLeft,
+                                        const QModelIndex &bottomRight)
+{
+  for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+    htmlCache_.remove(newsModel_->dataField(row, NewsModel::FieldId).toInt());
+  }
+}
+
+/** @brief Load news list into newspaper layout
+ *
+ * Only first NEWSPAPER_PAGE_SIZE news are put into document, next ones are
+ * appended when document is scrolled near to its end. Ids of news in
+ * document are kept, so inserting new news does not search document.
+ *----------------------------------------------------------------------------*/
 void NewsTabWidget::loadNewspaper(int refresh)
 {
   if (mainWindow_->newsLayout_ != 1) return;
@@ -1578,272 +1949,321 @@ void NewsTabWidget::loadNewspaper(int refresh)
   }
   webView_->settings()->setAttribute(QWebSettings::AutoLoadImages, true);
 
-  QString htmlStr;
   QUrl hostUrl;
-  bool ltr = true;
+  newspaperLtr_ = true;
 
   if (type_ == TabTypeFeed) {
     QModelIndex feedIndex = feedsProxyModel_->mapToSource(feedsView_->currentIndex());
     hostUrl = feedsModel_->dataField(feedIndex, "htmlUrl").toString();
-    ltr = !feedsModel_->dataField(feedIndex, "layoutDirection").toInt();
+    newspaperLtr_ = !feedsModel_->dataField(feedIndex, "layoutDirection").toInt();
   }
 
   if ((refresh == RefreshAll) || (refresh == RefreshWithPos)) {
-    QString cssStr = cssString_.
-        arg(ltr ? "left" : "right"). // text-align
-        arg(ltr ? "ltr" : "rtl"). // direction
-        arg(ltr ? "right" : "left"); // "Date" text-align
-    htmlStr = newspaperHeadHtml_.arg(cssStr, hostUrl.toString());
+    bool ltr = newspaperLtr_;
+    QString cssStr = cssString_.render(
+          ltr ? "left" : "right",   // text-align
+          ltr ? "ltr" : "rtl",      // direction
+          ltr ? "right" : "left");  // "Date" text-align
+    QString htmlStr = newspaperHeadHtml_.render(cssStr, hostUrl.toString());
 
     webView_->setHtml(htmlStr);
-  }
 
-  int idx = -1;
-  if ((refresh == RefreshInsert) && (sortOrder == Qt::DescendingOrder))
-    idx = newsModel_->rowCount();
-  while (1) {
-    if ((refresh == RefreshInsert) && (sortOrder == Qt::DescendingOrder)) {
-      idx--;
-      if (idx < 0)
-        break;
+    // Load as many news as before, so scroll position can be restored
+    int count = NEWSPAPER_PAGE_SIZE;
+    if (refresh == RefreshWithPos)
+      count = qMax(count, newspaperRow_);
+    newspaperIds_.clear();
+    newspaperRow_ = 0;
+    appendNewspaperItems(count);
+  } else {
+    // Add news missing among loaded ones. New news are at the top
+    // with descending sort and at the end with ascending one
+    QStringList htmlList;
+    int rowLast = qMin(newsModel_->rowCount(), newspaperRow_ +
+                       qMax(0, newsModel_->rowCount() - newspaperRowCount_));
+    for (int row = 0; row < rowLast; ++row) {
+      int newsId = newsModel_->dataField(row, NewsModel::FieldId).toInt();
+      if (newspaperIds_.contains(newsId))
+        continue;
+      newspaperIds_.insert(newsId);
+      htmlList.append(newspaperItemHtml(row));
+    }
+    newspaperRow_ = rowLast;
+    newspaperRowCount_ = newsModel_->rowCount();
+
+    QWebElement document = webView_->page()->mainFrame()->documentElement();
+    QWebElement element = document.findFirst("body");
+    if (sortOrder == Qt::DescendingOrder) {
+      for (int i = htmlList.count() - 1; i >= 0; --i)
+        element.prependInside(htmlList.at(i));
     } else {
-      idx++;
-      if (idx >= newsModel_->rowCount())
-        break;
+      foreach (const QString &htmlStr, htmlList)
+        element.appendInside(htmlStr);
     }
+  }
 
-    QModelIndex index = newsModel_->index(idx, newsModel_->fieldIndex("id"));
-    QString newsId = newsModel_->dataField(index.row(), "id").toString();
+  webView_->settings()->setAttribute(QWebSettings::AutoLoadImages, autoLoadImages_);
+  if ((refresh == RefreshInsert) && (sortOrder == Qt::DescendingOrder))
+    scrollBarValue += webView_->page()->mainFrame()->contentsSize().height() - height;
+  if (refresh != RefreshAll)
+    webView_->page()->mainFrame()->setScrollBarValue(Qt::Vertical, scrollBarValue);
 
-    if (refresh == RefreshInsert) {
-      QWebElement document = webView_->page()->mainFrame()->documentElement();
-      QWebElement element = document.findFirst(QString("div[id=newsItem%1]").arg(newsId));
-      if (!element.isNull()) {
-        continue;
-      }
-    }
+  webView_->setUpdatesEnabled(true);
 
-    linkNewsString_ = getLinkNews(index.row());
-    QString linkString = linkNewsString_;
+  slotNewspaperScrolled();
+}
 
-    QString content = newsModel_->dataField(index.row(), "content").toString();
-    if (!content.contains(QzRegExp("<html(.*)</html>", Qt::CaseInsensitive))) {
-      QString description = newsModel_->dataField(index.row(), "description").toString();
-      if (content.isEmpty() || (description.length() > content.length())) {
-        content = description;
-      }
+/** @brief Append next news of model to newspaper document
+ *----------------------------------------------------------------------------*/
+void NewsTabWidget::appendNewspaperItems(int count)
+{
+  webView_->settings()->setAttribute(QWebSettings::AutoLoadImages, true);
+
+  QWebElement document = webView_->page()->mainFrame()->documentElement();
+  QWebElement element = document.findFirst("body");
+  int added = 0;
+  for (; (newspaperRow_ < newsModel_->rowCount()) && (added < count); ++newspaperRow_) {
+    int newsId = newsModel_->dataField(newspaperRow_, NewsModel::FieldId).toInt();
+    if (newspaperIds_.contains(newsId))
+      continue;
+    newspaperIds_.insert(newsId);
+    element.appendInside(newspaperItemHtml(newspaperRow_));
+    added++;
+  }
+  newspaperRowCount_ = newsModel_->rowCount();
 
-      //      QTextDocumentFragment textDocument = QTextDocumentFragment::fromHtml(content);
-      //      content = textDocument.toPlainText();
-      //      content = webView_->fontMetrics().elidedText(
-      //            content, Qt::ElideRight, 1500);
+  webView_->settings()->setAttribute(QWebSettings::AutoLoadImages, autoLoadImages_);
+}
 
-      QString feedId = newsModel_->dataField(index.row(), "feedId").toString();
-      QModelIndex feedIndex = feedsModel_->indexById(feedId.toInt());
+/** @brief Load next news when newspaper is scrolled near to its end
+ *----------------------------------------------------------------------------*/
+void NewsTabWidget::slotNewspaperScrolled()
+{
+  if ((mainWindow_->newsLayout_ != 1) || (type_ >= TabTypeWeb)) return;
+  if (newspaperRow_ >= newsModel_->rowCount()) return;
 
-      QString iconStr = "qrc:/images/bulletRead";
-      QString titleStyle = "read";
-      if (newsModel_->dataField(index.row(), "new").toInt() == 1) {
-        iconStr = "qrc:/images/bulletNew";
-        titleStyle = "unread";
-      } else if (newsModel_->dataField(index.row(), "read").toInt() == 0) {
-        iconStr = "qrc:/images/bulletUnread";
-        titleStyle = "unread";
-      }
-      QString readImg = QString("<a href=\"quiterss://read.action.ui?#%1\" title='%3'>"
-                                "<img class='quiterss-img' id=\"readAction%1\" src=\"%2\"/></a>").
-          arg(newsId).arg(iconStr).arg(tr("Mark Read/Unread"));
-
-      QString feedImg;
-      QByteArray byteArray = feedsModel_->dataField(feedIndex, "image").toByteArray();
-      if (!byteArray.isEmpty())
-        feedImg = QString("<img class='quiterss-img' src=\"data:image/png;base64,") % byteArray % "\"/>";
-      else
-        feedImg = QString("<img class='quiterss-img' src=\"qrc:/images/feed\"/>");
+  QWebFrame *frame = webView_->page()->mainFrame();
+  int viewHeight = frame->geometry().height();
+  int rest = frame->contentsSize().height() - viewHeight -
+      frame->scrollBarValue(Qt::Vertical);
+  if (rest < viewHeight)
+    appendNewspaperItems(NEWSPAPER_PAGE_SIZE);
+}
 
-      QString titleString = newsModel_->dataField(index.row(), "title").toString();
-      if (!linkString.isEmpty()) {
-        titleString = QString("<a href='%1' class='%2' id='title%3'>%4</a>").
-            arg(linkString, titleStyle, newsId, titleString);
-      }
+/** @brief Build HTML of one news for newspaper layout
+ *----------------------------------------------------------------------------*/
+QString NewsTabWidget::newspaperItemHtml(int row)
+{
+  QString newsId = newsModel_->dataField(row, NewsModel::FieldId).toString();
+  QString linkString = getLinkNews(row);
 
-      QDateTime dtLocal;
-      QString dateString = newsModel_->dataField(index.row(), "published").toString();
-      if (!dateString.isNull()) {
-        QDateTime dtLocalTime = QDateTime::currentDateTime();
-        QDateTime dtUTC = QDateTime(dtLocalTime.date(), dtLocalTime.time(), Qt::UTC);
-        int nTimeShift = dtLocalTime.secsTo(dtUTC);
+  QString htmlStr;
 
-        QDateTime dt = QDateTime::fromString(dateString, Qt::ISODate);
-        dtLocal = dt.addSecs(nTimeShift);
-      } else {
-        dtLocal = QDateTime::fromString(
-              newsModel_->dataField(index.row(), "received").toString(),
-              Qt::ISODate);
-      }
-      if (QDateTime::currentDateTime().date() <= dtLocal.date())
-        dateString = dtLocal.toString(mainWindow_->formatTime_);
-      else
-        dateString = dtLocal.toString(mainWindow_->formatDate_ + " " + mainWindow_->formatTime_);
-
-      // Create author panel from news author
-      QString authorString;
-      QString authorName = newsModel_->dataField(index.row(), "author_name").toString();
-      QString authorEmail = newsModel_->dataField(index.row(), "author_email").toString();
-      QString authorUri = newsModel_->dataField(index.row(), "author_uri").toString();
-
-      QzRegExp reg("(^\\S+@\\S+\\.\\S+)", Qt::CaseInsensitive);
-      int pos = reg.indexIn(authorName);
-      if (pos > -1) {
-        authorName.replace(reg.cap(1), QString(" <a href='mailto:%1'>%1</a>").arg(reg.cap(1)));
-      }
-      authorString = authorName;
+  QString description;
+  QString content = getNewsContent(row, &description);
+  if (!content.contains(QzRegExp("<html(.*)</html>", Qt::CaseInsensitive))) {
+    if (content.isEmpty() || (description.length() > content.length())) {
+      content = description;
+    }
+
+    //      QTextDocumentFragment textDocument = QTextDocumentFragment::fromHtml(content);
+    //      content = textDocument.toPlainText();
+    //      content = webView_->fontMetrics().elidedText(
+    //            content, Qt::ElideRight, 1500);
+
+    QString feedId = newsModel_->dataField(row, NewsModel::FieldFeedId).toString();
+    QModelIndex feedIndex = feedsModel_->indexById(feedId.toInt());
+
+    QString iconStr = "qrc:/images/bulletRead";
+    QString titleStyle = "read";
+    if (newsModel_->dataField(row, NewsModel::FieldNew).toInt() == 1) {
+      iconStr = "qrc:/images/bulletNew";
+      titleStyle = "unread";
+    } else if (newsModel_->dataField(row, NewsModel::FieldRead).toInt() == 0) {
+      iconStr = "qrc:/images/bulletUnread";
+      titleStyle = "unread";
+    }
+    QString readImg = QString("<a href=\"quiterss://read.action.ui?#%1\" title='%3'>"
+                              "<img class='quiterss-img' id=\"readAction%1\" src=\"%2\"/></a>").
+        arg(newsId).arg(iconStr).arg(tr("Mark Read/Unread"));
+
+    QString feedImg;
+    QByteArray byteArray = feedsModel_->dataField(feedIndex, FeedsModel::FieldImage).toByteArray();
+    if (!byteArray.isEmpty())
+      feedImg = QString("<img class='quiterss-img' src=\"data:image/png;base64,") % byteArray % "\"/>";
+    else
+      feedImg = QString("<img class='quiterss-img' src=\"qrc:/images/feed\"/>");
+
+    QString titleString = newsModel_->dataField(row, NewsModel::FieldTitle).toString();
+    if (!linkString.isEmpty()) {
+      titleString = QString("<a href='%1' class='%2' id='title%3'>%4</a>").
+          arg(linkString, titleStyle, newsId, titleString);
+    }
+
+    QDateTime dtLocal;
+    QString dateString = newsModel_->dataField(row, NewsModel::FieldPublished).toString();
+    if (!dateString.isNull()) {
+      QDateTime dtLocalTime = QDateTime::currentDateTime();
+      QDateTime dtUTC = QDateTime(dtLocalTime.date(), dtLocalTime.time(), Qt::UTC);
+      int nTimeShift = dtLocalTime.secsTo(dtUTC);
 
+      QDateTime dt = QDateTime::fromString(dateString, Qt::ISODate);
+      dtLocal = dt.addSecs(nTimeShift);
+    } else {
+      dtLocal = QDateTime::fromString(
+            newsModel_->dataField(row, NewsModel::FieldReceived).toString(),
+            Qt::ISODate);
+    }
+    if (QDateTime::currentDateTime().date() <= dtLocal.date())
+      dateString = dtLocal.toString(mainWindow_->formatTime_);
+    else
+      dateString = dtLocal.toString(mainWindow_->formatDate_ + " " + mainWindow_->formatTime_);
+
+    // Create author panel from news author
+    QString authorString;
+    QString authorName = newsModel_->dataField(row, NewsModel::FieldAuthorName).toString();
+    QString authorEmail = newsModel_->dataField(row, NewsModel::FieldAuthorEmail).toString();
+    QString authorUri = newsModel_->dataField(row, NewsModel::FieldAuthorUri).toString();
+
+    QzRegExp reg("(^\\S+@\\S+\\.\\S+)", Qt::CaseInsensitive);
+    int pos = reg.indexIn(authorName);
+    if (pos > -1) {
+      authorName.replace(reg.cap(1), QString(" <a href='mailto:%1'>%1</a>").arg(reg.cap(1)));
+    }
+    authorString = authorName;
+
+    if (!authorEmail.isEmpty())
+      authorString.append(QString(" <a href='mailto:%1'>e-mail</a>").arg(authorEmail));
+    if (!authorUri.isEmpty())
+      authorString.append(QString(" <a href='%1'>page</a>"). arg(authorUri));
+
+    // If news author is absent, create author panel from feed author
+    // @note(arhohryakov:2012.01.03) Author is got from current feed, because
+    //   news is belong to it
+    if (authorString.isEmpty()) {
+      authorName  = feedsModel_->dataField(feedIndex, "author_name").toString();
+      authorEmail = feedsModel_->dataField(feedIndex, "author_email").toString();
+      authorUri   = feedsModel_->dataField(feedIndex, "author_uri").toString();
+
+      authorString = authorName;
       if (!authorEmail.isEmpty())
         authorString.append(QString(" <a href='mailto:%1'>e-mail</a>").arg(authorEmail));
       if (!authorUri.isEmpty())
-        authorString.append(QString(" <a href='%1'>page</a>"). arg(authorUri));
-
-      // If news author is absent, create author panel from feed author
-      // @note(arhohryakov:2012.01.03) Author is got from current feed, because
-      //   news is belong to it
-      if (authorString.isEmpty()) {
-        authorName  = feedsModel_->dataField(feedIndex, "author_name").toString();
-        authorEmail = feedsModel_->dataField(feedIndex, "author_email").toString();
-        authorUri   = feedsModel_->dataField(feedIndex, "author_uri").toString();
-
-        authorString = authorName;
-        if (!authorEmail.isEmpty())
-          authorString.append(QString(" <a href='mailto:%1'>e-mail</a>").arg(authorEmail));
-        if (!authorUri.isEmpty())
-          authorString.append(QString(" <a href='%1'>page</a>").arg(authorUri));
-      }
+        authorString.append(QString(" <a href='%1'>page</a>").arg(authorUri));
+    }
 
-      QString commentsStr;
-      QString commentsUrl = newsModel_->dataField(index.row(), "comments").toString();
-      if (!commentsUrl.isEmpty()) {
-        commentsStr = QString("<a href=\"%1\"> %2</a>").arg(commentsUrl, tr("Comments"));
-      }
+    QString commentsStr;
+    QString commentsUrl = newsModel_->dataField(row, NewsModel::FieldComments).toString();
+    if (!commentsUrl.isEmpty()) {
+      commentsStr = QString("<a href=\"%1\"> %2</a>").arg(commentsUrl, tr("Comments"));
+    }
 
-      QString category = newsModel_->dataField(index.row(), "category").toString();
+    QString category = newsModel_->dataField(row, NewsModel::FieldCategory).toString();
 
-      if (!authorString.isEmpty()) {
-        authorString = QString(tr("Author: %1")).arg(authorString);
+    if (!authorString.isEmpty()) {
+      authorString = QString(tr("Author: %1")).arg(authorString);
+      if (!commentsStr.isEmpty())
+        authorString.append(QString(" | %1").arg(commentsStr));
+      if (!category.isEmpty())
+        authorString.append(QString(" | %1").arg(category));
+    } else {
+      if (!commentsStr.isEmpty())
+        authorString.append(commentsStr);
+      if (!category.isEmpty()) {
         if (!commentsStr.isEmpty())
-          authorString.append(QString(" | %1").arg(commentsStr));
-        if (!category.isEmpty())
           authorString.append(QString(" | %1").arg(category));
-      } else {
-        if (!commentsStr.isEmpty())
-          authorString.append(commentsStr);
-        if (!category.isEmpty()) {
-          if (!commentsStr.isEmpty())
-            authorString.append(QString(" | %1").arg(category));
-          else
-            authorString.append(category);
-        }
+        else
+          authorString.append(category);
       }
+    }
 
-      QString labelsString = getHtmlLabels(index.row());
-      authorString.append(QString("<table class=\"labels\" id=\"labels%1\"><tr>%2</tr></table>").
-                          arg(newsId).arg(labelsString));
-
-      QString enclosureStr;
-      QString enclosureUrl = newsModel_->dataField(index.row(), "enclosure_url").toString();
-      if (!enclosureUrl.isEmpty()) {
-        QString type = newsModel_->dataField(index.row(), "enclosure_type").toString();
-        if (type.contains("image")) {
-          if (!content.contains(enclosureUrl) && autoLoadImages_) {
-            enclosureStr = QString("<IMG SRC=\"%1\" class=\"enclosureImg\"><p>").
-                arg(enclosureUrl);
-          }
-        } else {
-          if (type.contains("audio")) {
-            type = tr("audio");
-            enclosureStr = audioPlayerHtml_.arg(enclosureUrl);
-            enclosureStr.append("<p>");
-          }
-          else if (type.contains("video")) {
-            type = tr("video");
-            enclosureStr = videoPlayerHtml_.arg(enclosureUrl);
-            enclosureStr.append("<p>");
-          }
-          else type = tr("media");
-
-          enclosureStr.append(QString("<a href=\"%1\" class=\"enclosure\"> %2 %3 </a><p>").
-                              arg(enclosureUrl, tr("Link to"), type));
+    QString labelsString = getHtmlLabels(row);
+    authorString.append(QString("<table class=\"labels\" id=\"labels%1\"><tr>%2</tr></table>").
+                        arg(newsId).arg(labelsString));
+
+    QString enclosureStr;
+    QString enclosureUrl = newsModel_->dataField(row, NewsModel::FieldEnclosureUrl).toString();
+    if (!enclosureUrl.isEmpty()) {
+      QString type = newsModel_->dataField(row, NewsModel::FieldEnclosureType).toString();
+      if (type.contains("image")) {
+        if (!content.contains(enclosureUrl) && autoLoadImages_) {
+          enclosureStr = QString("<IMG SRC=\"%1\" class=\"enclosureImg\"><p>").
+              arg(enclosureUrl);
         }
-      }
-
-      content = enclosureStr + content;
+      } else {
+        if (type.contains("audio")) {
+          type = tr("audio");
+          enclosureStr = audioPlayerHtml_.render(enclosureUrl);
+          enclosureStr.append("<p>");
+        }
+        else if (type.contains("video")) {
+          type = tr("video");
+          enclosureStr = videoPlayerHtml_.render(enclosureUrl);
+          enclosureStr.append("<p>");
+        }
+        else type = tr("media");
 
-      if (!autoLoadImages_) {
-        QzRegExp reg("<img[^>]+>", Qt::CaseInsensitive);
-        content = content.remove(reg);
+        enclosureStr.append(QString("<a href=\"%1\" class=\"enclosure\"> %2 %3 </a><p>").
+                            arg(enclosureUrl, tr("Link to"), type));
       }
+    }
 
-      iconStr = "qrc:/images/starOff";
-      if (newsModel_->dataField(index.row(), "starred").toInt() == 1) {
-        iconStr = "qrc:/images/starOn";
-      }
-      QString starAction = QString("<div class=\"star-action\">"
-                                   "<a href=\"quiterss://star.action.ui?#%1\" title='%3'>"
-                                   "<img class='quiterss-img' id=\"starAction%1\" src=\"%2\"/></a></div>").
-          arg(newsId).arg(iconStr).arg(tr("Mark News Star"));
-      QString labelsMenu = QString("<div class=\"labels-menu\">"
-                                   "<a href=\"quiterss://labels.menu.ui?#%1\" title='%2'>"
-                                   "<img class='quiterss-img' id=\"labelsMenu%1\" src=\"qrc:/images/label_5\"/></a></div>").
-          arg(newsId).arg(tr("Label"));
-      QString shareMenu = QString("<div class=\"share-menu\">"
-                                  "<a href=\"quiterss://share.menu.ui?#%1\" title='%2'>"
-                                  "<img class='quiterss-img' id=\"shareMenu%1\" src=\"qrc:/images/images/share.png\"/></a></div>").
-          arg(newsId).arg(tr("Share"));
-      QString openBrowserAction = QString("<div class=\"open-browser\">"
-                                          "<a href=\"quiterss://open.browser.ui?#%1\" title='%2'>"
-                                          "<img class='quiterss-img' id=\"openBrowser%1\" src=\"qrc:/images/openBrowser\"'/></a></div>").
-          arg(newsId).arg(tr("Open News in External Browser"));
-      QString deleteAction = QString("<div class=\"delete-action\">"
-                                     "<a href=\"quiterss://delete.action.ui?#%1\" title='%2'>"
-                                     "<img class='quiterss-img' id=\"deleteAction%1\" src=\"qrc:/images/delete\"/></a></div>").
-          arg(newsId).arg(tr("Delete"));
-      QString actionNews = starAction % labelsMenu % shareMenu % openBrowserAction %
-          deleteAction;
-
-      QString border = "1";
-      if (idx + 1 == newsModel_->rowCount())
-        border = "0";
-      if (ltr) {
-        htmlStr = newspaperHtml_.arg(newsId, border, readImg, feedImg, titleString,
-                                     dateString, authorString, content, actionNews);
-      } else {
-        htmlStr = newspaperHtmlRtl_.arg(newsId, border, readImg, feedImg, titleString,
-                                        dateString, authorString, content, actionNews);
-      }
+    content = enclosureStr + content;
+
+    if (!autoLoadImages_) {
+      QzRegExp reg("<img[^>]+>", Qt::CaseInsensitive);
+      content = content.remove(reg);
     } else {
-      if (!autoLoadImages_) {
-        content = content.remove(QzRegExp("<img[^>]+>", Qt::CaseInsensitive));
-      }
-      htmlStr = content;
+      // Full images are loaded only when news is opened
+      content = ThumbnailReply::rewriteImages(content, webView_->width());
     }
 
-    htmlStr = htmlStr.replace("src=\"//", "src=\"http://");
-
-    QWebElement document = webView_->page()->mainFrame()->documentElement();
-    QWebElement element = document.findFirst("body");
-    if ((refresh == RefreshInsert) && (sortOrder == Qt::DescendingOrder))
-      element.prependInside(htmlStr);
-    else
-      element.appendInside(htmlStr);
-    qApp->processEvents();
+    iconStr = "qrc:/images/starOff";
+    if (newsModel_->dataField(row, NewsModel::FieldStarred).toInt() == 1) {
+      iconStr = "qrc:/images/starOn";
+    }
+    QString starAction = QString("<div class=\"star-action\">"
+                                 "<a href=\"quiterss://star.action.ui?#%1\" title='%3'>"
+                                 "<img class='quiterss-img' id=\"starAction%1\" src=\"%2\"/></a></div>").
+        arg(newsId).arg(iconStr).arg(tr("Mark News Star"));
+    QString labelsMenu = QString("<div class=\"labels-menu\">"
+                                 "<a href=\"quiterss://labels.menu.ui?#%1\" title='%2'>"
+                                 "<img class='quiterss-img' id=\"labelsMenu%1\" src=\"qrc:/images/label_5\"/></a></div>").
+        arg(newsId).arg(tr("Label"));
+    QString shareMenu = QString("<div class=\"share-menu\">"
+                                "<a href=\"quiterss://share.menu.ui?#%1\" title='%2'>"
+                                "<img class='quiterss-img' id=\"shareMenu%1\" src=\"qrc:/images/images/share.png\"/></a></div>").
+        arg(newsId).arg(tr("Share"));
+    QString openBrowserAction = QString("<div class=\"open-browser\">"
+                                        "<a href=\"quiterss://open.browser.ui?#%1\" title='%2'>"
+                                        "<img class='quiterss-img' id=\"openBrowser%1\" src=\"qrc:/images/openBrowser\"'/></a></div>").
+        arg(newsId).arg(tr("Open News in External Browser"));
+    QString deleteAction = QString("<div class=\"delete-action\">"
+                                   "<a href=\"quiterss://delete.action.ui?#%1\" title='%2'>"
+                                   "<img class='quiterss-img' id=\"deleteAction%1\" src=\"qrc:/images/delete\"/></a></div>").
+        arg(newsId).arg(tr("Delete"));
+    QString actionNews = starAction % labelsMenu % shareMenu % openBrowserAction %
+        deleteAction;
+
+    QString border = "1";
+    if (row + 1 == newsModel_->rowCount())
+      border = "0";
+    const QString values[] = { newsId, border, readImg, feedImg, titleString,
+                               dateString, authorString, content, actionNews };
+    if (newspaperLtr_) {
+      htmlStr = newspaperHtml_.render(values, 9);
+    } else {
+      htmlStr = newspaperHtmlRtl_.render(values, 9);
+    }
+  } else {
+    if (!autoLoadImages_) {
+      content = content.remove(QzRegExp("<img[^>]+>", Qt::CaseInsensitive));
+    }
+    htmlStr = content;
   }
 
-  webView_->settings()->setAttribute(QWebSettings::AutoLoadImages, autoLoadImages_);
-  if ((refresh == RefreshInsert) && (sortOrder == Qt::DescendingOrder))
-    scrollBarValue += webView_->page()->mainFrame()->contentsSize().height() - height;
-  if (refresh != RefreshAll)
-    webView_->page()->mainFrame()->setScrollBarValue(Qt::Vertical, scrollBarValue);
-
-  webView_->setUpdatesEnabled(true);
+  htmlStr = htmlStr.replace("src=\"//", "src=\"http://");
+  return htmlStr;
 }
 
 /** @brief Asynchorous update web view
@@ -1878,7 +2298,7 @@ void NewsTabWidget::slotLinkClicked(QUrl url)
   if (type_ != TabTypeWeb) {
     if ((url.host().isEmpty() || (QUrl(url).host().indexOf('.') == -1)) && newsView_->currentIndex().isValid()) {
       int row = newsView_->currentIndex().row();
-      int feedId = newsModel_->dataField(row, "feedId").toInt();
+      int feedId = newsModel_->dataField(row, NewsModel::FieldFeedId).toInt();
       QModelIndex feedIndex = feedsModel_->indexById(feedId);
       QUrl hostUrl = feedsModel_->dataField(feedIndex, "htmlUrl").toString();
 
@@ -1955,6 +2375,8 @@ void NewsTabWidget::slotLoadFinished(bool)
   }
 
   webViewProgress_->hide();
+  // Received size of page with its images stands for memory held by WebKit
+  MemoryAccounting::report(MemoryAccounting::WebPages, this, webView_->page()->totalBytes());
 }
 
 void NewsTabWidget::slotUrlEnter()
@@ -2028,23 +2450,23 @@ void NewsTabWidget::openInExternalBrowserNews()
     for (int i = cnt-1; i >= 0; --i) {
       QSqlQuery q;
       QModelIndex curIndex = indexes.at(i);
-      if (newsModel_->dataField(curIndex.row(), "read").toInt() == 0) {
+      if (newsModel_->dataField(curIndex.row(), NewsModel::FieldRead).toInt() == 0) {
         newsModel_->setData(
-              newsModel_->index(curIndex.row(), newsModel_->fieldIndex("new")),
+              newsModel_->index(curIndex.row(), newsModel_->fieldColumn(NewsModel::FieldNew)),
               0);
         newsModel_->setData(
-              newsModel_->index(curIndex.row(), newsModel_->fieldIndex("read")),
+              newsModel_->index(curIndex.row(), newsModel_->fieldColumn(NewsModel::FieldRead)),
               1);
 
-        int newsId = newsModel_->dataField(curIndex.row(), "id").toInt();
+        int newsId = newsModel_->dataField(curIndex.row(), NewsModel::FieldId).toInt();
         q.exec(QString("UPDATE news SET new=0, read=1 WHERE id=='%2'").arg(newsId));
-        QString feedId = newsModel_->dataField(curIndex.row(), "feedId").toString();
+        QString feedId = newsModel_->dataField(curIndex.row(), NewsModel::FieldFeedId).toString();
         if (!feedIdList.contains(feedId)) feedIdList.append(feedId);
       }
 
       QUrl url = QUrl::fromEncoded(getLinkNews(indexes.at(i).row()).toUtf8());
       if (url.host().isEmpty() || (QUrl(url).host().indexOf('.') == -1)) {
-        QString feedId = newsModel_->dataField(indexes.at(i).row(), "feedId").toString();
+        QString feedId = newsModel_->dataField(indexes.at(i).row(), NewsModel::FieldFeedId).toString();
         QModelIndex feedIndex = feedsModel_->indexById(feedId.toInt());
         QUrl hostUrl = feedsModel_->dataField(feedIndex, "htmlUrl").toString();
 
@@ -2078,6 +2500,14 @@ void NewsTabWidget::setNewsLayout()
     break;
   default:
     newsWidget_->setVisible(true);
+    bool clustered = (mainWindow_->newsLayout_ == 2);
+    if (clustered != newsModel_->isClustered()) {
+      int newsId = currentNewsId();
+      newsModel_->setClustered(clustered);
+      newsModel_->setFilter(newsModel_->filter());
+      if (!hibernated_)
+        refreshNewsList(newsId);
+    }
     updateWebView(newsView_->currentIndex());
   }
 }
@@ -2151,7 +2581,7 @@ void NewsTabWidget::openNewsNewTab()
 
     QUrl url = QUrl::fromEncoded(getLinkNews(row).toUtf8());
     if (url.host().isEmpty() || (QUrl(url).host().indexOf('.') == -1)) {
-      int feedId = newsModel_->dataField(row, "feedId").toInt();
+      int feedId = newsModel_->dataField(row, NewsModel::FieldFeedId).toInt();
       QModelIndex feedIndex = feedsModel_->indexById(feedId);
       QUrl hostUrl = feedsModel_->dataField(feedIndex, "htmlUrl").toString();
 
@@ -2219,16 +2649,32 @@ bool NewsTabWidget::openUrl(const QUrl &url)
   return QDesktopServices::openUrl(url);
 }
 //----------------------------------------------------------------------------
+/** @brief Filter news on text change after typing pauses
+ *
+ * Finding in browser and clearing text are applied at once.
+ *----------------------------------------------------------------------------*/
+void NewsTabWidget::slotFindTextChanged(const QString &text)
+{
+  QString objectName = findText_->findGroup_->checkedAction()->objectName();
+  if ((objectName == "findInBrowserAct") || text.isEmpty())
+    slotFindText(text);
+  else
+    findTextTimer_->start(FIND_TEXT_DELAY);
+}
+//----------------------------------------------------------------------------
 void NewsTabWidget::slotFindText(const QString &text)
 {
+  findTextTimer_->stop();
+
   QString objectName = findText_->findGroup_->checkedAction()->objectName();
   if (objectName == "findInBrowserAct") {
     webView_->findText("", QWebPage::HighlightAllOccurrences);
     webView_->findText(text, QWebPage::HighlightAllOccurrences);
   } else {
-    int newsId = newsModel_->dataField(newsView_->currentIndex().row(), "id").toInt();
+    int newsId = newsModel_->dataField(newsView_->currentIndex().row(), NewsModel::FieldId).toInt();
 
     QString filterStr;
+    QString archiveFilterStr;
     switch (type_) {
     case TabTypeUnread:
     case TabTypeStar:
@@ -2236,46 +2682,27 @@ void NewsTabWidget::slotFindText(const QString &text)
     case TabTypeLabel:
       filterStr = categoryFilterStr_;
       break;
+    case TabTypeSearch:
+      filterStr = categoryFilterStr_;
+      archiveFilterStr = categoryFilterStr_;
+      break;
     default:
       filterStr = mainWindow_->newsFilterStr;
+      if (mainWindow_->newsFilterGroup_->checkedAction()->objectName() == "filterNewsAll_")
+        archiveFilterStr = mainWindow_->newsFilterStr;
     }
 
-    if (!text.isEmpty()) {
-      QString findText = text;
-      findText = findText.replace("'", "''").toUpper();
-      if (objectName == "findTitleAct") {
-        filterStr.append(
-              QString(" AND UPPER(title) LIKE '%%1%'").arg(findText));
-      } else if (objectName == "findAuthorAct") {
-        filterStr.append(
-              QString(" AND UPPER(author_name) LIKE '%%1%'").arg(findText));
-      } else if (objectName == "findCategoryAct") {
-        filterStr.append(
-              QString(" AND UPPER(category) LIKE '%%1%'").arg(findText));
-      } else if (objectName == "findContentAct") {
-        filterStr.append(
-              QString(" AND (UPPER(content) LIKE '%%1%' OR UPPER(description) LIKE '%%1%')").
-              arg(findText));
-      } else if (objectName == "findLinkAct") {
-        filterStr.append(
-              QString(" AND link_href LIKE '%%1%'").
-              arg(findText));
-      } else {
-        filterStr.append(
-              QString(" AND (UPPER(title) LIKE '%%1%' OR UPPER(author_name) LIKE '%%1%' "
-                      "OR UPPER(category) LIKE '%%1%' OR UPPER(content) LIKE '%%1%' "
-                      "OR UPPER(description) LIKE '%%1%')").
-              arg(findText));
-      }
-    }
+    filterStr.append(Database::findNewsFilter(objectName, text));
+    if (!archiveFilterStr.isEmpty())
+      archiveFilterStr.append(Database::findNewsFilter(objectName, text, true));
 
-    newsModel_->setFilter(filterStr);
+    newsModel_->setFilter(filterStr, archiveFilterStr);
 
-    QModelIndex index = newsModel_->index(0, newsModel_->fieldIndex("id"));
+    QModelIndex index = newsModel_->index(0, newsModel_->fieldColumn(NewsModel::FieldId));
     QModelIndexList indexList = newsModel_->match(index, Qt::EditRole, newsId);
     if (indexList.count()) {
       int newsRow = indexList.first().row();
-      newsView_->setCurrentIndex(newsModel_->index(newsRow, newsModel_->fieldIndex("title")));
+      newsView_->setCurrentIndex(newsModel_->index(newsRow, newsModel_->fieldColumn(NewsModel::FieldTitle)));
     } else {
       currentNewsIdOld = newsId;
       hideWebContent();
@@ -2364,7 +2791,7 @@ void NewsTabWidget::openUrlInExternalBrowser()
   if (type_ != TabTypeWeb) {
     if (linkUrl_.host().isEmpty() && newsView_->currentIndex().isValid()) {
       int row = newsView_->currentIndex().row();
-      int feedId = newsModel_->dataField(row, "feedId").toInt();
+      int feedId = newsModel_->dataField(row, NewsModel::FieldFeedId).toInt();
       QModelIndex feedIndex = feedsModel_->indexById(feedId);
       QUrl hostUrl = feedsModel_->dataField(feedIndex, "htmlUrl").toString();
 
@@ -2390,7 +2817,7 @@ void NewsTabWidget::setLabelNews(int labelId)
   if (type_ >= TabTypeWeb) return;
 
   QList<QModelIndex> indexes = newsView_->selectionModel()->selectedRows(
-        newsModel_->fieldIndex("label"));
+        newsModel_->fieldColumn(NewsModel::FieldLabel));
 
   int cnt = indexes.count();
   if (cnt == 0) return;
@@ -2407,7 +2834,7 @@ void NewsTabWidget::setLabelNews(int labelId)
     }
     newsModel_->setData(index, strIdLabels);
 
-    int newsId = newsModel_->dataField(index.row(), "id").toInt();
+    int newsId = newsModel_->dataField(index.row(), NewsModel::FieldId).toInt();
 
     if ((newsId == currentNewsIdOld) &&
         (webView_->title() == "news_descriptions")) {
@@ -2423,9 +2850,7 @@ void NewsTabWidget::setLabelNews(int labelId)
       }
     }
 
-    QSqlQuery q;
-    q.exec(QString("UPDATE news SET label='%1' WHERE id=='%2'").
-           arg(strIdLabels).arg(newsId));
+    mainApp->setNewsState(newsId, 0, "label", strIdLabels);
     if (newsId != currentNewsIdOld) {
       newsView_->selectionModel()->select(
             index, QItemSelectionModel::Deselect|QItemSelectionModel::Rows);
@@ -2441,7 +2866,6 @@ void NewsTabWidget::setLabelNews(int labelId)
       }
     }
 
-    db_.transaction();
     for (int i = cnt-1; i >= 0; --i) {
       QModelIndex index = indexes.at(i);
       QString strIdLabels = index.data(Qt::EditRole).toString();
@@ -2455,7 +2879,7 @@ void NewsTabWidget::setLabelNews(int labelId)
       }
       newsModel_->setData(index, strIdLabels);
 
-      int newsId = newsModel_->dataField(index.row(), "id").toInt();
+      int newsId = newsModel_->dataField(index.row(), NewsModel::FieldId).toInt();
 
       if ((newsId == currentNewsIdOld) &&
           (webView_->title() == "news_descriptions")) {
@@ -2469,18 +2893,14 @@ void NewsTabWidget::setLabelNews(int labelId)
         }
       }
 
-      QSqlQuery q;
-      q.exec(QString("UPDATE news SET label='%1' WHERE id=='%2'").
-             arg(strIdLabels).arg(newsId));
+      mainApp->setNewsState(newsId, 0, "label", strIdLabels);
       if (newsId != currentNewsIdOld) {
         newsView_->selectionModel()->select(
               index, QItemSelectionModel::Deselect|QItemSelectionModel::Rows);
       }
     }
-    db_.commit();
   }
   newsView_->viewport()->update();
-  mainWindow_->recountCategoryCounts();
 }
 
 void NewsTabWidget::slotNewslLabelClicked(QModelIndex index)
@@ -2532,25 +2952,7 @@ void NewsTabWidget::increaseNewsList()
  *----------------------------------------------------------------------------*/
 int NewsTabWidget::findUnreadNews(bool next)
 {
-  int newsRow = -1;
-
-  int newsRowCur = newsView_->currentIndex().row();
-  QModelIndex index;
-  QModelIndexList indexList;
-  if (next) {
-    index = newsModel_->index(newsRowCur+1, newsModel_->fieldIndex("read"));
-    indexList = newsModel_->match(index, Qt::EditRole, 0);
-    if (indexList.isEmpty()) {
-      index = newsModel_->index(0, newsModel_->fieldIndex("read"));
-      indexList = newsModel_->match(index, Qt::EditRole, 0);
-    }
-  } else {
-    index = newsModel_->index(newsRowCur, newsModel_->fieldIndex("read"));
-    indexList = newsModel_->match(index, Qt::EditRole, 0, -1);
-  }
-  if (!indexList.isEmpty()) newsRow = indexList.last().row();
-
-  return newsRow;
+  return newsModel_->unreadRow(newsView_->currentIndex().row(), next);
 }
 
 /** @brief Set tab title
@@ -2589,11 +2991,11 @@ void NewsTabWidget::slotShareNews(QAction *action)
     QString linkString;
     QString content;
     if (type_ < TabTypeWeb) {
-      title = newsModel_->dataField(indexes.at(i).row(), "title").toString();
+      title = newsModel_->dataField(indexes.at(i).row(), NewsModel::FieldTitle).toString();
       linkString = getLinkNews(indexes.at(i).row());
 
-      content = newsModel_->dataField(indexes.at(i).row(), "content").toString();
-      QString description = newsModel_->dataField(indexes.at(i).row(), "description").toString();
+      QString description;
+      content = getNewsContent(indexes.at(i).row(), &description);
       if (content.isEmpty() || (description.length() > content.length())) {
         content = description;
       }
@@ -2794,9 +3196,9 @@ int NewsTabWidget::getUnreadCount(QString countString)
 
 QString NewsTabWidget::getLinkNews(int row)
 {
-  QString linkString = newsModel_->dataField(row, "link_href").toString();
+  QString linkString = newsModel_->dataField(row, NewsModel::FieldLinkHref).toString();
   if (linkString.isEmpty())
-    linkString = newsModel_->dataField(row, "link_alternate").toString();
+    linkString = newsModel_->dataField(row, NewsModel::FieldLinkAlternate).toString();
   return linkString.simplified();
 }
 
@@ -2808,18 +3210,59 @@ void NewsTabWidget::savePageAsDescript()
   if (!curIndex.isValid()) return;
 
   QString html = webView_->page()->currentFrame()->toHtml().replace("'", "''");
-  newsModel_->setData(
-        newsModel_->index(curIndex.row(), newsModel_->fieldIndex("content")),
-        html);
-  int newsId = newsModel_->dataField(curIndex.row(), "id").toInt();
-  QString qStr = QString("UPDATE news SET content='%1' WHERE id=='%2'").
+  int newsId = newsModel_->dataField(curIndex.row(), NewsModel::FieldId).toInt();
+  QString qStr = QString("INSERT OR IGNORE INTO newsContent(newsId) VALUES(%1)").arg(newsId);
+  mainApp->sqlQueryExec(qStr);
+  qStr = QString("UPDATE newsContent SET content='%1' WHERE newsId=='%2'").
       arg(html).arg(newsId);
   mainApp->sqlQueryExec(qStr);
 }
 
+/** @brief Load news body, which is not part of news model
+ * @param row - row of news in model
+ * @param description - news description, if needed
+ * @param article - article fetched from news link, if needed
+ * @return news content
+ *----------------------------------------------------------------------------*/
+QString NewsTabWidget::getNewsContent(int row, QString *description, QString *article)
+{
+  QSqlQuery q(Database::readConnection(Database::ReadNewsContent));
+  q.setForwardOnly(true);
+  q.prepare("SELECT uncompress(description), uncompress(content), uncompress(article) "
+            "FROM newsContent WHERE newsId=?");
+  q.addBindValue(newsModel_->dataField(row, NewsModel::FieldId));
+  q.exec();
+  if (!q.next()) {
+    if (!Database::archiveAttached()) return QString();
+    q.prepare("SELECT uncompress(description), uncompress(content), uncompress(article) "
+              "FROM archive.newsContent WHERE newsId=?");
+    q.addBindValue(newsModel_->dataField(row, NewsModel::FieldId));
+    q.exec();
+    if (!q.next()) return QString();
+  }
+
+  if (description)
+    *description = q.value(0).toString();
+  if (article)
+    *article = q.value(2).toString();
+  return q.value(1).toString();
+}
+
+/** @brief Check if article of news was fetched from news link
+ *----------------------------------------------------------------------------*/
+bool NewsTabWidget::hasArticle(int row)
+{
+  QSqlQuery q(Database::readConnection(Database::ReadNewsContent));
+  q.setForwardOnly(true);
+  q.prepare("SELECT 1 FROM newsContent WHERE newsId=? AND article IS NOT NULL");
+  q.addBindValue(newsModel_->dataField(row, NewsModel::FieldId));
+  q.exec();
+  return q.next();
+}
+
 QString NewsTabWidget::getHtmlLabels(int row)
 {
-  QStringList strLabelIdList = newsModel_->dataField(row, "label").toString().
+  QStringList strLabelIdList = newsModel_->dataField(row, NewsModel::FieldLabel).toString().
       split(",", QString::SkipEmptyParts);
   QString labelsString;
   QList<QTreeWidgetItem *> labelListItems = mainWindow_->categoriesTree_->getLabelListItems();
@@ -2840,13 +3283,13 @@ QString NewsTabWidget::getHtmlLabels(int row)
 void NewsTabWidget::actionNewspaper(QUrl url)
 {
   QString newsId = url.fragment();
-  QModelIndex startIndex = newsModel_->index(0, newsModel_->fieldIndex("id"));
+  QModelIndex startIndex = newsModel_->index(0, newsModel_->fieldColumn(NewsModel::FieldId));
   QModelIndexList indexList = newsModel_->match(startIndex, Qt::EditRole, newsId);
   if (!indexList.isEmpty()) {
     QString iconStr;
     if (url.host() == "read.action.ui") {
       QString titleStyle;
-      if (newsModel_->dataField(indexList.first().row(), "read").toInt() == 0) {
+      if (newsModel_->dataField(indexList.first().row(), NewsModel::FieldRead).toInt() == 0) {
         slotSetItemRead(indexList.first(), 1);
         iconStr = "qrc:/images/bulletRead";
         titleStyle = "read";
@@ -2869,11 +3312,11 @@ void NewsTabWidget::actionNewspaper(QUrl url)
       }
     } else if (url.host() == "star.action.ui") {
       int row = indexList.first().row();
-      if (newsModel_->dataField(row, "starred").toInt() == 0) {
-        slotSetItemStar(newsModel_->index(row, newsModel_->fieldIndex("starred")), 1);
+      if (newsModel_->dataField(row, NewsModel::FieldStarred).toInt() == 0) {
+        slotSetItemStar(newsModel_->index(row, newsModel_->fieldColumn(NewsModel::FieldStarred)), 1);
         iconStr = "qrc:/images/starOn";
       } else {
-        slotSetItemStar(newsModel_->index(row, newsModel_->fieldIndex("starred")), 0);
+        slotSetItemStar(newsModel_->index(row, newsModel_->fieldColumn(NewsModel::FieldStarred)), 0);
         iconStr = "qrc:/images/starOff";
       }
       QWebElement document = webView_->page()->mainFrame()->documentElement();
@@ -2901,7 +3344,7 @@ void NewsTabWidget::actionNewspaper(QUrl url)
     } else if (url.host() == "open.browser.ui") {
       QUrl url = QUrl::fromEncoded(getLinkNews(indexList.first().row()).toUtf8());
       if (url.host().isEmpty() || (QUrl(url).host().indexOf('.') == -1)) {
-        QString feedId = newsModel_->dataField(indexList.first().row(), "feedId").toString();
+        QString feedId = newsModel_->dataField(indexList.first().row(), NewsModel::FieldFeedId).toString();
         QModelIndex feedIndex = feedsModel_->indexById(feedId.toInt());
         QUrl hostUrl = feedsModel_->dataField(feedIndex, "htmlUrl").toString();
 
@@ -26,10 +26,12 @@
 #include <QtSql>
 #include <QtWebKit>
 
+#include "asyncquery.h"
 #include "feedsproxymodel.h"
 #include "feedsmodel.h"
 #include "feedsview.h"
 #include "findtext.h"
+#include "htmltemplate.h"
 #include "lineedit.h"
 #include "locationbar.h"
 #include "newsheader.h"
@@ -56,6 +58,7 @@ public:
     TabTypeStar,
     TabTypeDel,
     TabTypeLabel,
+    TabTypeSearch,
     TabTypeWeb,
     TabTypeDownloads
   };
@@ -102,6 +105,13 @@ public:
   int findUnreadNews(bool next);
 
   void setTextTab(const QString &text);
+  void releaseMemory(bool releaseWebView);
+  void hibernate();
+  void wakeUp();
+  void startIdle() { idleTime_.start(); }
+  qint64 idleTime() const { return idleTime_.isValid() ? idleTime_.elapsed() : 0; }
+  bool isHibernated() const { return hibernated_; }
+  int currentNewsId();
 
   void slotShareNews(QAction *action);
 
@@ -153,7 +163,6 @@ public slots:
   void slotNewsEndPressed(QModelIndex index=QModelIndex());
   void slotNewsPageUpPressed(QModelIndex index=QModelIndex());
   void slotNewsPageDownPressed(QModelIndex index=QModelIndex());
-  void slotSort(int column, int order);
 
 signals:
   void signalSetHtmlWebView(const QString &html = "", const QUrl &baseUrl = QUrl());
@@ -162,9 +171,15 @@ signals:
 
 private slots:
   void showContextMenuNews(const QPoint &pos);
+  void slotToggleCluster();
   void slotSetItemRead(QModelIndex index, int read);
   void slotSetItemStar(QModelIndex index, int starred);
   void slotMarkReadTimeout();
+  void slotNewsSelectTimeout();
+  void slotNewspaperScrolled();
+  void slotPrerenderNews();
+  void slotClearHtmlCache();
+  void slotNewsDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
 
   void slotSetHtmlWebView(const QString &html);
   void webHomePage();
@@ -184,6 +199,7 @@ private slots:
   void openLink();
   void openLinkInNewTab();
 
+  void slotFindTextChanged(const QString& text);
   void slotFindText(const QString& text);
   void slotSelectFind();
 
@@ -191,11 +207,26 @@ private slots:
 
   void slotNewslLabelClicked(QModelIndex index);
 
+  void slotNewsDeleted(AsyncQueryResult result);
+  void slotAllNewsDeleted(AsyncQueryResult result);
+  void slotNewsRestored(AsyncQueryResult result);
+
 private:
   void createNewsList();
   void createWebWidget();
+  static void loadTemplates();
+  HtmlTemplate newsCssString(const QString &styleSheetNews);
   QString getHtmlLabels(int row);
+  QString getNewsContent(int row, QString *description = 0, QString *article = 0);
+  bool hasArticle(int row);
+  QString newsHtml(int row);
+  QString cachedNewsHtml(int row);
+  QString newspaperItemHtml(int row);
+  void appendNewspaperItems(int count);
   void actionNewspaper(QUrl url);
+  void refreshNewsList(int newsId);
+  void hideNewsRows(const QVariantList &rows, int deleted);
+  QModelIndex visibleNewsIndex(int row);
 
   MainWindow *mainWindow_;
   QSqlDatabase db_;
@@ -214,6 +245,18 @@ private:
   QAction *urlExternalBrowserAct_;
 
   QTimer *markNewsReadTimer_;
+  QTimer *findTextTimer_;
+  QTimer *newsSelectTimer_;
+  QTimer *prerenderTimer_;
+  QCache<int,QString> htmlCache_;
+  bool webViewReleased_;
+  QUrl releasedUrl_;
+  // State of news list kept while tab is hibernated
+  QElapsedTimer idleTime_;
+  bool hibernated_;
+  QString hibernatedFilter_;
+  int hibernatedNewsId_;
+  int hibernatedScroll_;
 
   int webDefaultFontSize_;
   int webDefaultFixedFontSize_;
@@ -224,14 +267,18 @@ private:
   QWidget *newsPanelWidget_;
   bool webToolbarShow_;
 
-  QString newspaperHeadHtml_;
-  QString newspaperHtml_;
-  QString newspaperHtmlRtl_;
-  QString htmlString_;
-  QString htmlRtlString_;
-  QString cssString_;
-  QString audioPlayerHtml_;
-  QString videoPlayerHtml_;
+  HtmlTemplate newspaperHeadHtml_;
+  HtmlTemplate newspaperHtml_;
+  HtmlTemplate newspaperHtmlRtl_;
+  QSet<int> newspaperIds_;  // news in newspaper document
+  int newspaperRow_;        // next row of model to add to newspaper
+  int newspaperRowCount_;   // rows in model when newspaper was updated
+  bool newspaperLtr_;
+  HtmlTemplate htmlString_;
+  HtmlTemplate htmlRtlString_;
+  HtmlTemplate cssString_;
+  HtmlTemplate audioPlayerHtml_;
+  HtmlTemplate videoPlayerHtml_;
 
 };
 
@@ -17,154 +17,160 @@
 * ============================================================ */
 #include "newsmodel.h"
 
+#include "database.h"
 #include "mainapplication.h"
+#include "sqlitedriver.h"
+
+#include <algorithm>
+
+// Label list items tracked by bits of labelBits()
+#define LABEL_BITS_MAX 64
+
+// Names of news fields in order of NewsModel::Field
+static const char *fieldNames[NewsModel::FieldCount] = {
+  "id", "feedId", "title", "published", "received", "read", "new",
+  "starred", "label", "deleted", "deleteDate", "author_name",
+  "author_email", "author_uri", "category", "comments", "enclosure_url",
+  "enclosure_type", "link_href", "link_alternate"
+};
 
 NewsModel::NewsModel(QObject *parent, QTreeView *view)
   : QSqlTableModel(parent)
   , simplifiedDateTime_(true)
   , view_(view)
+  , labelBitsCount_(0)
+  , sortColumn_(-1)
+  , sortOrder_(Qt::AscendingOrder)
+  , clustered_(false)
+  , maxNewsId_(0)
+  , mergedCount_(0)
+  , result_(NULL)
+  , reselectPending_(false)
+  , unreadRowsCount_(-1)
+  , columnFeedId_(-1)
+  , columnTitle_(-1)
+  , columnPublished_(-1)
+  , columnReceived_(-1)
+  , columnRead_(-1)
+  , columnNew_(-1)
+  , columnStarred_(-1)
+  , columnLabel_(-1)
+  , columnRights_(-1)
+  , columnLinkHref_(-1)
+  , columnLinkAlternate_(-1)
+  , columnSnippet_(-1)
+  , columnClusterId_(-1)
+  , columnClusterSize_(-1)
 {
+  for (int i = 0; i < FieldCount; ++i)
+    fieldColumns_[i] = -1;
   setEditStrategy(QSqlTableModel::OnManualSubmit);
 }
 
 QVariant NewsModel::data(const QModelIndex &index, int role) const
 {
+  // Rows of list are not the same as read first, they are shown again
+  if (result_ && !reselectPending_ && result_->rowsChanged()) {
+    reselectPending_ = true;
+    QMetaObject::invokeMethod(const_cast<NewsModel*>(this), "reselect", Qt::QueuedConnection);
+  }
+
   if (index.row() > (view_->verticalScrollBar()->value() + view_->verticalScrollBar()->pageStep()))
     return QSqlTableModel::data(index, role);
 
   MainWindow *mainWindow = mainApp->mainWindow();
 
   if (role == Qt::DecorationRole) {
-    if (QSqlTableModel::fieldIndex("read") == index.column()) {
+    if (columnRead_ == index.column()) {
       QPixmap icon;
-      if (1 == QSqlTableModel::index(index.row(), fieldIndex("new")).data(Qt::EditRole).toInt())
+      if (1 == QSqlTableModel::index(index.row(), columnNew_).data(Qt::EditRole).toInt())
         icon.load(":/images/bulletNew");
       else if (0 == index.data(Qt::EditRole).toInt())
         icon.load(":/images/bulletUnread");
       else icon.load(":/images/bulletRead");
       return icon;
-    } else if (QSqlTableModel::fieldIndex("starred") == index.column()) {
+    } else if (columnStarred_ == index.column()) {
       QPixmap icon;
       if (0 == index.data(Qt::EditRole).toInt())
         icon.load(":/images/starOff");
       else icon.load(":/images/starOn");
       return icon;
-    } else if (QSqlTableModel::fieldIndex("feedId") == index.column()) {
-      QPixmap icon;
-      int feedId = QSqlTableModel::index(index.row(), fieldIndex("feedId")).data(Qt::EditRole).toInt();
-      QModelIndex feedIndex = mainWindow->feedsModel_->indexById(feedId);
-      bool isFeed = (feedIndex.isValid() && mainWindow->feedsModel_->isFolder(feedIndex)) ? false : true;
-
-      if (feedIndex.isValid()) {
-        QByteArray byteArray = mainWindow->feedsModel_->dataField(feedIndex, "image").toByteArray();
-        if (!byteArray.isNull()) {
-          icon.loadFromData(QByteArray::fromBase64(byteArray));
-        } else if (isFeed) {
-          icon.load(":/images/feed");
-        } else {
-          icon.load(":/images/folder");
-        }
-      }
-
-      return icon;
-    } else if (QSqlTableModel::fieldIndex("label") == index.column()) {
+    } else if (columnFeedId_ == index.column()) {
+      return feedIcon(index.data(Qt::EditRole).toInt());
+    } else if (columnLabel_ == index.column()) {
       QIcon icon;
-      QString strIdLabels = index.data(Qt::EditRole).toString();
-      QList<QTreeWidgetItem *> labelListItems = mainApp->mainWindow()->
-          categoriesTree_->getLabelListItems();
-      foreach (QTreeWidgetItem *item, labelListItems) {
-        if (strIdLabels.contains(QString(",%1,").arg(item->text(2)))) {
-          icon = item->icon(0);
-          break;
-        }
+      int labelIndex = rowData(index.row()).labelIndex;
+      if (labelIndex != -1) {
+        icon = mainWindow->categoriesTree_->getLabelListItems().at(labelIndex)->icon(0);
       }
       return icon;
     }
   } else if (role == Qt::ToolTipRole) {
-    if (QSqlTableModel::fieldIndex("feedId") == index.column()) {
-      int feedId = QSqlTableModel::index(index.row(), fieldIndex("feedId")).data(Qt::EditRole).toInt();
+    if (columnFeedId_ == index.column()) {
+      int feedId = index.data(Qt::EditRole).toInt();
       QModelIndex feedIndex = mainWindow->feedsModel_->indexById(feedId);
-      return mainWindow->feedsModel_->dataField(feedIndex, "text").toString();
-    } else if (QSqlTableModel::fieldIndex("title") == index.column()) {
+      return mainWindow->feedsModel_->dataField(feedIndex, FeedsModel::FieldText).toString();
+    } else if (columnTitle_ == index.column()) {
       QString title = index.data(Qt::EditRole).toString();
+      // Preview is made by parse worker, description is not read here
+      QString snippet;
+      if (columnSnippet_ != -1)
+        snippet = QSqlTableModel::index(index.row(), columnSnippet_).data(Qt::EditRole).toString();
+      if (!snippet.isEmpty()) {
+#if QT_VERSION >= 0x050000
+        return QString("<b>%1</b><br>%2").arg(title.toHtmlEscaped(), snippet.toHtmlEscaped());
+#else
+        return QString("<b>%1</b><br>%2").arg(Qt::escape(title), Qt::escape(snippet));
+#endif
+      }
       if ((view_->header()->sectionSize(index.column()) - 14) < view_->header()->fontMetrics().width(title))
         return title;
     }
     return QString("");
   } else if (role == Qt::DisplayRole) {
-    if (QSqlTableModel::fieldIndex("read") == index.column()) {
+    if (columnRead_ == index.column()) {
       return QVariant();
-    } else if (QSqlTableModel::fieldIndex("starred") == index.column()) {
+    } else if (columnStarred_ == index.column()) {
       return QVariant();
-    } else if (QSqlTableModel::fieldIndex("feedId") == index.column()) {
+    } else if (columnFeedId_ == index.column()) {
       return QVariant();
-    } else if (QSqlTableModel::fieldIndex("rights") == index.column()) {
-      int feedId = QSqlTableModel::index(index.row(), fieldIndex("feedId")).data(Qt::EditRole).toInt();
+    } else if (columnRights_ == index.column()) {
+      int feedId = QSqlTableModel::index(index.row(), columnFeedId_).data(Qt::EditRole).toInt();
       QModelIndex feedIndex = mainWindow->feedsModel_->indexById(feedId);
-      return mainWindow->feedsModel_->dataField(feedIndex, "text").toString();
-    } else if (QSqlTableModel::fieldIndex("published") == index.column()) {
-      QDateTime dtLocal;
-      QString strDate = index.data(Qt::EditRole).toString();
-
-      if (!strDate.isNull()) {
-        QDateTime dtLocalTime = QDateTime::currentDateTime();
-        QDateTime dtUTC = QDateTime(dtLocalTime.date(), dtLocalTime.time(), Qt::UTC);
-        int nTimeShift = dtLocalTime.secsTo(dtUTC);
-
-        QDateTime dt = QDateTime::fromString(strDate, Qt::ISODate);
-        dtLocal = dt.addSecs(nTimeShift);
-      } else {
-        dtLocal = QDateTime::fromString(
-              QSqlTableModel::index(index.row(), fieldIndex("received")).data(Qt::EditRole).toString(),
-              Qt::ISODate);
-      }
-      if (simplifiedDateTime_) {
-        if (QDateTime::currentDateTime().date() <= dtLocal.date())
-          return dtLocal.toString(formatTime_);
-        else
-          return dtLocal.toString(formatDate_);
-      } else {
-        return dtLocal.toString(formatDate_ + " " + formatTime_);
-      }
-    } else if (QSqlTableModel::fieldIndex("received") == index.column()) {
-      QDateTime dateTime = QDateTime::fromString(
-            index.data(Qt::EditRole).toString(),
-            Qt::ISODate);
-      if (simplifiedDateTime_) {
-        if (QDateTime::currentDateTime().date() == dateTime.date()) {
-          return dateTime.toString(formatTime_);
-        } else return dateTime.toString(formatDate_);
-      } else {
-        return dateTime.toString(formatDate_ + " " + formatTime_);
-      }
-    } else if (QSqlTableModel::fieldIndex("label") == index.column()) {
-      QStringList nameLabelList;
-      QString strIdLabels = index.data(Qt::EditRole).toString();
-      QList<QTreeWidgetItem *> labelListItems = mainApp->mainWindow()->
-          categoriesTree_->getLabelListItems();
-      foreach (QTreeWidgetItem *item, labelListItems) {
-        if (strIdLabels.contains(QString(",%1,").arg(item->text(2)))) {
-          nameLabelList << item->text(0);
-        }
-      }
-      return nameLabelList.join(", ");
-    } else if (QSqlTableModel::fieldIndex("link_href") == index.column()) {
+      return mainWindow->feedsModel_->dataField(feedIndex, FeedsModel::FieldText).toString();
+    } else if (columnPublished_ == index.column()) {
+      return rowData(index.row()).published;
+    } else if (columnReceived_ == index.column()) {
+      return rowData(index.row()).received;
+    } else if (columnLabel_ == index.column()) {
+      return rowData(index.row()).labelNames;
+    } else if (columnLinkHref_ == index.column()) {
       QString linkStr = index.data(Qt::EditRole).toString();
       if (linkStr.isEmpty()) {
-        linkStr = QSqlTableModel::index(index.row(), fieldIndex("link_alternate")).
+        linkStr = QSqlTableModel::index(index.row(), columnLinkAlternate_).
             data(Qt::EditRole).toString();
       }
       linkStr = linkStr.simplified();
       linkStr = linkStr.remove("http://");
       linkStr = linkStr.remove("https://");
       return linkStr;
-    } else if (QSqlTableModel::fieldIndex("title") == index.column()) {
-      if (index.data(Qt::EditRole).toString().isEmpty())
-        return tr("(no title)");
+    } else if (columnTitle_ == index.column()) {
+      QString title = index.data(Qt::EditRole).toString();
+      if (title.isEmpty())
+        title = tr("(no title)");
+      if (clustered_) {
+        int clusterSize = QSqlTableModel::index(index.row(), columnClusterSize_).data(Qt::EditRole).toInt();
+        if (clusterSize > 0)
+          return QString("%1 (+%2)").arg(title).arg(clusterSize);
+        qlonglong id = QSqlTableModel::index(index.row(), columnClusterId_).data(Qt::EditRole).toLongLong();
+        if (id && expandedClusters_.contains(id))
+          return QString::fromUtf8("\xe2\x86\xb3 ") + title;
+      }
+      return title;
     }
   } else if (role == Qt::FontRole) {
     QFont font = view_->font();
-    if (0 == QSqlTableModel::index(index.row(), fieldIndex("read")).data(Qt::EditRole).toInt())
+    if (0 == QSqlTableModel::index(index.row(), columnRead_).data(Qt::EditRole).toInt())
       font.setBold(true);
     return font;
   } else if (role == Qt::BackgroundRole) {
@@ -173,42 +179,30 @@ QVariant NewsModel::data(const QModelIndex &index, int role) const
         return QColor(focusedNewsBGColor_);
     }
 
-    if (QSqlTableModel::index(index.row(), fieldIndex("label")).data(Qt::EditRole).isValid()) {
-      QString strIdLabels = QSqlTableModel::index(index.row(), fieldIndex("label")).data(Qt::EditRole).toString();
-      QList<QTreeWidgetItem *> labelListItems = mainApp->mainWindow()->
-          categoriesTree_->getLabelListItems();
-      foreach (QTreeWidgetItem *item, labelListItems) {
-        if (strIdLabels.contains(QString(",%1,").arg(item->text(2)))) {
-          QString strColor = item->data(0, CategoriesTreeWidget::colorBgRole).toString();
-          if (!strColor.isEmpty())
-            return QColor(strColor);
-          break;
-        }
-      }
+    int labelIndex = rowData(index.row()).labelIndex;
+    if (labelIndex != -1) {
+      QString strColor = mainWindow->categoriesTree_->getLabelListItems().at(labelIndex)->
+          data(0, CategoriesTreeWidget::colorBgRole).toString();
+      if (!strColor.isEmpty())
+        return QColor(strColor);
     }
   } else if (role == Qt::TextColorRole) {
     if (index.row() == view_->currentIndex().row()) {
       return QColor(focusedNewsTextColor_);
     }
 
-    if (QSqlTableModel::index(index.row(), fieldIndex("label")).data(Qt::EditRole).isValid()) {
-      QString strIdLabels = QSqlTableModel::index(index.row(), fieldIndex("label")).data(Qt::EditRole).toString();
-      QList<QTreeWidgetItem *> labelListItems = mainApp->mainWindow()->
-          categoriesTree_->getLabelListItems();
-      foreach (QTreeWidgetItem *item, labelListItems) {
-        if (strIdLabels.contains(QString(",%1,").arg(item->text(2)))) {
-          QString strColor = item->data(0, CategoriesTreeWidget::colorTextRole).toString();
-          if (!strColor.isEmpty())
-            return QColor(strColor);
-          break;
-        }
-      }
+    int labelIndex = rowData(index.row()).labelIndex;
+    if (labelIndex != -1) {
+      QString strColor = mainWindow->categoriesTree_->getLabelListItems().at(labelIndex)->
+          data(0, CategoriesTreeWidget::colorTextRole).toString();
+      if (!strColor.isEmpty())
+        return QColor(strColor);
     }
 
-    if (1 == QSqlTableModel::index(index.row(), fieldIndex("new")).data(Qt::EditRole).toInt())
+    if (1 == QSqlTableModel::index(index.row(), columnNew_).data(Qt::EditRole).toInt())
       return QColor(newNewsTextColor_);
 
-    if (0 == QSqlTableModel::index(index.row(), fieldIndex("read")).data(Qt::EditRole).toInt())
+    if (0 == QSqlTableModel::index(index.row(), columnRead_).data(Qt::EditRole).toInt())
       return QColor(unreadNewsTextColor_);
 
     return QColor(textColor_);
@@ -243,6 +237,18 @@ QVariant NewsModel::data(const QModelIndex &index, int role) const
 
 /*virtual*/ bool NewsModel::setData(const QModelIndex &index, const QVariant &value, int role)
 {
+  rowDataCache_.remove(index.row());
+  editedRows_.insert(index.row());
+  if ((index.column() == columnRead_) && (unreadRowsCount_ == rowCount())) {
+    // Rows do not move, so index of unread rows is kept in order
+    QVector<int>::iterator it = qLowerBound(unreadRows_.begin(), unreadRows_.end(), index.row());
+    bool listed = (it != unreadRows_.end()) && (*it == index.row());
+    if (value.toInt() == 0) {
+      if (!listed) unreadRows_.insert(it, index.row());
+    } else if (listed) {
+      unreadRows_.erase(it);
+    }
+  }
   return QSqlTableModel::setData(index, value, role);
 }
 
@@ -250,11 +256,8 @@ QVariant NewsModel::data(const QModelIndex &index, int role) const
 {
   int newsId = index(view_->currentIndex().row(), fieldIndex("id")).data().toInt();
 
-  if ((column == fieldIndex("read")) || (column == fieldIndex("starred")) ||
-      (column == fieldIndex("rights"))) {
-    emit signalSort(column, order);
-    column = fieldIndex("rights");
-  }
+  sortColumn_ = column;
+  sortOrder_ = order;
   QSqlTableModel::sort(column, order);
 
   while (canFetchMore())
@@ -270,6 +273,46 @@ QVariant NewsModel::data(const QModelIndex &index, int role) const
   }
 }
 
+/** @brief Order of news list
+ *
+ * Column "Feed Title" shows feed name instead of stored value, so it is
+ * sorted by name of feed from table feeds. Other columns are sorted by
+ * stored value, which can use indexes of table news.
+ *----------------------------------------------------------------------------*/
+/*virtual*/ QString NewsModel::orderByClause() const
+{
+  // Ties are ordered by id so mergeNews() can count rows before a news
+  QString order = (sortOrder_ == Qt::AscendingOrder) ? "ASC" : "DESC";
+  if ((sortColumn_ != -1) && (sortColumn_ == columnRights_)) {
+    return QString("ORDER BY (SELECT text FROM feeds WHERE feeds.id=news.feedId) %1, news.id %1").
+        arg(order);
+  }
+  QString clause = QSqlTableModel::orderByClause();
+  if (!clause.isEmpty())
+    clause.append(QString(", news.id %1").arg(order));
+  return clause;
+}
+
+/** @brief Select of news list with news of archive base
+ *
+ * Archive news are joined by subquery named as table, so order clause is
+ * the same for both.
+ *----------------------------------------------------------------------------*/
+/*virtual*/ QString NewsModel::selectStatement() const
+{
+  if (archiveFilter_.isEmpty() || !Database::archiveAttached())
+    return QSqlTableModel::selectStatement();
+
+  QSqlRecord rec = database().record(tableName());
+  QStringList columns;
+  for (int i = 0; i < rec.count(); ++i)
+    columns.append(rec.fieldName(i));
+  QString columnsStr = columns.join(", ");
+  return QString("SELECT * FROM (SELECT %1 FROM main.news WHERE %2 "
+                 "UNION ALL SELECT %1 FROM archive.news WHERE %3) AS news %4").
+      arg(columnsStr, QSqlTableModel::filter(), archiveFilter_, orderByClause());
+}
+
 /*virtual*/ QModelIndexList NewsModel::match(
     const QModelIndex &start, int role, const QVariant &value, int hits,
     Qt::MatchFlags flags) const
@@ -277,19 +320,271 @@ QVariant NewsModel::data(const QModelIndex &index, int role) const
   return QSqlTableModel::match(start, role, value, hits, flags);
 }
 
+/** @brief Rows of unread news in ascending order
+ *
+ * Built once for fetched rows and kept by setData() of read state, so
+ * navigation to unread news does not scan list.
+ *----------------------------------------------------------------------------*/
+const QVector<int> &NewsModel::unreadRows() const
+{
+  if (unreadRowsCount_ != rowCount()) {
+    unreadRows_.clear();
+    unreadRowsCount_ = rowCount();
+    for (int row = 0; row < unreadRowsCount_; ++row) {
+      if (dataField(row, FieldRead).toInt() == 0)
+        unreadRows_.append(row);
+    }
+  }
+  return unreadRows_;
+}
+
+/** @brief Row of unread news next to or before \a row
+ *
+ * Search wraps around the list like match(): next one after last unread
+ * is the first unread, previous one before first unread is the last one.
+ * @return row of unread news or -1 if all news are read
+ *----------------------------------------------------------------------------*/
+int NewsModel::unreadRow(int row, bool next) const
+{
+  const QVector<int> &rows = unreadRows();
+  if (rows.isEmpty())
+    return -1;
+
+  if (next) {
+    QVector<int>::const_iterator it = qUpperBound(rows.constBegin(), rows.constEnd(), row);
+    return (it != rows.constEnd()) ? *it : rows.first();
+  }
+
+  QVector<int>::const_iterator it = qLowerBound(rows.constBegin(), rows.constEnd(), row);
+  return (it != rows.constBegin()) ? *(it - 1) : rows.last();
+}
+
 // ----------------------------------------------------------------------------
 QVariant NewsModel::dataField(int row, const QString &fieldName) const
 {
   return index(row, fieldIndex(fieldName)).data(Qt::EditRole);
 }
 
+/** @brief Value of news field by column mapped in setTable()
+ *
+ * No lookup of column by name, used in loops over news rows.
+ *----------------------------------------------------------------------------*/
+QVariant NewsModel::dataField(int row, Field field) const
+{
+  return QSqlTableModel::data(QSqlTableModel::index(row, fieldColumns_[field]), Qt::EditRole);
+}
+
+/** @brief Bits of label list items set in news label string
+ *
+ * Bit i is set if label string contains id of item i. Computed once per
+ * distinct label string until model is selected again.
+ *----------------------------------------------------------------------------*/
+quint64 NewsModel::labelBits(const QString &strIdLabels,
+                             const QList<QTreeWidgetItem *> &labelListItems) const
+{
+  if (strIdLabels.isEmpty() || (strIdLabels == ","))
+    return 0;
+
+  if (labelBitsCount_ != labelListItems.count()) {
+    labelBitsCache_.clear();
+    labelBitsCount_ = labelListItems.count();
+  }
+
+  QHash<QString,quint64>::const_iterator it = labelBitsCache_.constFind(strIdLabels);
+  if (it != labelBitsCache_.constEnd())
+    return it.value();
+
+  quint64 bits = 0;
+  for (int i = 0; (i < labelListItems.count()) && (i < LABEL_BITS_MAX); ++i) {
+    if (strIdLabels.contains(QString(",%1,").arg(labelListItems.at(i)->text(2))))
+      bits |= Q_UINT64_C(1) << i;
+  }
+  labelBitsCache_.insert(strIdLabels, bits);
+  return bits;
+}
+
+bool NewsModel::hasLabel(quint64 bits, const QString &strIdLabels,
+                         const QList<QTreeWidgetItem *> &labelListItems, int i) const
+{
+  if (i < LABEL_BITS_MAX)
+    return bits & (Q_UINT64_C(1) << i);
+  return strIdLabels.contains(QString(",%1,").arg(labelListItems.at(i)->text(2)));
+}
+
+/** @brief Display values of row: labels and formatted dates
+ *
+ * Computed on first paint of row and kept until model is selected again
+ * or row is changed by setData().
+ *----------------------------------------------------------------------------*/
+const NewsRowData &NewsModel::rowData(int row) const
+{
+  QHash<int,NewsRowData>::const_iterator it = rowDataCache_.constFind(row);
+  if (it != rowDataCache_.constEnd())
+    return it.value();
+
+  NewsRowData rowData;
+  rowData.labelIndex = -1;
+
+  QString strIdLabels = QSqlTableModel::index(row, columnLabel_).data(Qt::EditRole).toString();
+  QList<QTreeWidgetItem *> labelListItems = mainApp->mainWindow()->
+      categoriesTree_->getLabelListItems();
+  quint64 bits = labelBits(strIdLabels, labelListItems);
+  if (!strIdLabels.isEmpty()) {
+    QStringList nameLabelList;
+    for (int i = 0; i < labelListItems.count(); ++i) {
+      if (hasLabel(bits, strIdLabels, labelListItems, i)) {
+        if (rowData.labelIndex == -1)
+          rowData.labelIndex = i;
+        nameLabelList << labelListItems.at(i)->text(0);
+      }
+    }
+    rowData.labelNames = nameLabelList.join(", ");
+  }
+
+  QDateTime dtLocal;
+  QString strDate = QSqlTableModel::index(row, columnPublished_).data(Qt::EditRole).toString();
+  QString strReceived = QSqlTableModel::index(row, columnReceived_).data(Qt::EditRole).toString();
+  if (!strDate.isNull()) {
+    QDateTime dtLocalTime = QDateTime::currentDateTime();
+    QDateTime dtUTC = QDateTime(dtLocalTime.date(), dtLocalTime.time(), Qt::UTC);
+    int nTimeShift = dtLocalTime.secsTo(dtUTC);
+
+    QDateTime dt = QDateTime::fromString(strDate, Qt::ISODate);
+    dtLocal = dt.addSecs(nTimeShift);
+  } else {
+    dtLocal = QDateTime::fromString(strReceived, Qt::ISODate);
+  }
+  QDateTime dateTime = QDateTime::fromString(strReceived, Qt::ISODate);
+  if (simplifiedDateTime_) {
+    QDate currentDate = QDate::currentDate();
+    if (currentDate <= dtLocal.date())
+      rowData.published = dtLocal.toString(formatTime_);
+    else
+      rowData.published = dtLocal.toString(formatDate_);
+    if (currentDate == dateTime.date())
+      rowData.received = dateTime.toString(formatTime_);
+    else
+      rowData.received = dateTime.toString(formatDate_);
+  } else {
+    rowData.published = dtLocal.toString(formatDate_ + " " + formatTime_);
+    rowData.received = dateTime.toString(formatDate_ + " " + formatTime_);
+  }
+
+  return rowDataCache_.insert(row, rowData).value();
+}
+
+/** @brief Icon of feed or folder decoded once per select
+ *----------------------------------------------------------------------------*/
+QPixmap NewsModel::feedIcon(int feedId) const
+{
+  QHash<int,QPixmap>::const_iterator it = feedIconCache_.constFind(feedId);
+  if (it != feedIconCache_.constEnd())
+    return it.value();
+
+  MainWindow *mainWindow = mainApp->mainWindow();
+  QPixmap icon;
+  QModelIndex feedIndex = mainWindow->feedsModel_->indexById(feedId);
+  if (feedIndex.isValid()) {
+    QByteArray byteArray = mainWindow->feedsModel_->dataField(feedIndex, FeedsModel::FieldImage).toByteArray();
+    if (!byteArray.isNull()) {
+      icon.loadFromData(QByteArray::fromBase64(byteArray));
+    } else if (!mainWindow->feedsModel_->isFolder(feedIndex)) {
+      icon.load(":/images/feed");
+    } else {
+      icon.load(":/images/folder");
+    }
+  }
+  feedIconCache_.insert(feedId, icon);
+  return icon;
+}
+
+void NewsModel::clearCache()
+{
+  labelBitsCache_.clear();
+  rowDataCache_.clear();
+  feedIconCache_.clear();
+  unreadRows_.clear();
+  unreadRowsCount_ = -1;
+}
+
+void NewsModel::setTable(const QString &tableName)
+{
+  QSqlTableModel::setTable(tableName);
+  // Query of model is cleared
+  result_ = NULL;
+
+  columnFeedId_ = fieldIndex("feedId");
+  columnTitle_ = fieldIndex("title");
+  columnPublished_ = fieldIndex("published");
+  columnReceived_ = fieldIndex("received");
+  columnRead_ = fieldIndex("read");
+  columnNew_ = fieldIndex("new");
+  columnStarred_ = fieldIndex("starred");
+  columnLabel_ = fieldIndex("label");
+  columnRights_ = fieldIndex("rights");
+  columnLinkHref_ = fieldIndex("link_href");
+  columnLinkAlternate_ = fieldIndex("link_alternate");
+  columnSnippet_ = fieldIndex("snippet");
+  columnClusterId_ = fieldIndex("clusterId");
+  columnClusterSize_ = fieldIndex("clusterSize");
+  for (int i = 0; i < FieldCount; ++i)
+    fieldColumns_[i] = fieldIndex(QLatin1String(fieldNames[i]));
+  clearCache();
+}
+
 void NewsModel::setFilter(const QString &filter)
+{
+  setFilter(filter, QString());
+}
+
+/** @brief Set filter of news list
+ *
+ * In clustered layout other items of story are hidden while first item
+ * of story passes the same filter, unless story is expanded.
+ * @param archiveFilter Filter of news of archive base, which are added
+ *   to list if it is not empty
+ *----------------------------------------------------------------------------*/
+void NewsModel::setFilter(const QString &filter, const QString &archiveFilter)
 {
   QPalette palette = view_->palette();
   palette.setColor(QPalette::AlternateBase, mainApp->mainWindow()->alternatingRowColors_);
   view_->setPalette(palette);
 
-  QSqlTableModel::setFilter(filter);
+  clearCache();
+  baseFilter_ = filter;
+  archiveFilter_ = archiveFilter;
+  if (!clustered_ || filter.isEmpty() || (columnClusterId_ == -1)) {
+    QSqlTableModel::setFilter(filter);
+    return;
+  }
+
+  QStringList expanded;
+  foreach (qlonglong id, expandedClusters_)
+    expanded.append(QString::number(id));
+  QString clusterFilter = "clusterId IS NULL";
+  if (!expanded.isEmpty())
+    clusterFilter.append(QString(" OR clusterId IN (%1)").arg(expanded.join(",")));
+  clusterFilter.append(QString(" OR clusterId NOT IN (SELECT id FROM news WHERE %1)").arg(filter));
+  QSqlTableModel::setFilter(QString("(%1) AND (%2)").arg(filter, clusterFilter));
+}
+
+/** @brief Id of story of news in row
+ * @return id of first news of story, 0 if news is not in story
+ *----------------------------------------------------------------------------*/
+qlonglong NewsModel::clusterId(int row) const
+{
+  if (columnClusterId_ == -1)
+    return 0;
+  if (QSqlTableModel::index(row, columnClusterSize_).data(Qt::EditRole).toInt() > 0)
+    return QSqlTableModel::index(row, fieldColumns_[FieldId]).data(Qt::EditRole).toLongLong();
+  return QSqlTableModel::index(row, columnClusterId_).data(Qt::EditRole).toLongLong();
+}
+
+void NewsModel::toggleCluster(qlonglong clusterId)
+{
+  if (!expandedClusters_.remove(clusterId))
+    expandedClusters_.insert(clusterId);
+  setFilter(baseFilter_, archiveFilter_);
 }
 
 bool NewsModel::select()
@@ -298,5 +593,188 @@ bool NewsModel::select()
   palette.setColor(QPalette::AlternateBase, mainApp->mainWindow()->alternatingRowColors_);
   view_->setPalette(palette);
 
-  return QSqlTableModel::select();
+  clearCache();
+  mergedCount_ = 0;
+  editedRows_.clear();
+  bool result = QSqlTableModel::select();
+  result_ = dynamic_cast<SQLiteResult*>(const_cast<QSqlResult*>(query().result()));
+  reselectPending_ = false;
+  maxNewsId_ = maxNewsId();
+  return result;
+}
+
+/** @brief Select list again after its rows changed in base
+ *
+ * Rows read again after rewind of list query do not match rows read
+ * first, so model rows point at other news. Current news is kept.
+ *----------------------------------------------------------------------------*/
+void NewsModel::reselect()
+{
+  int newsId = dataField(view_->currentIndex().row(), FieldId).toInt();
+
+  select();
+  while (canFetchMore())
+    fetchMore();
+
+  QModelIndexList indexList = match(index(0, fieldColumns_[FieldId]), Qt::EditRole, newsId);
+  if (indexList.count()) {
+    QModelIndex current = index(indexList.first().row(), columnTitle_);
+    view_->setCurrentIndex(current);
+    view_->scrollTo(current);
+  }
+}
+
+/** @brief Greatest id of news in base
+ *----------------------------------------------------------------------------*/
+qlonglong NewsModel::maxNewsId() const
+{
+  QSqlQuery q(database());
+  q.exec("SELECT max(id) FROM main.news");
+  if (q.first())
+    return q.value(0).toLongLong();
+  return 0;
+}
+
+/** @brief Row where news is inserted into list
+ *
+ * Row is number of news of list which go before it in order of list,
+ * counted by base. Order of list ends with id, so rows with equal value
+ * of sort column have fixed order too.
+ *----------------------------------------------------------------------------*/
+int NewsModel::mergeRow(const QVariant &value, qlonglong newsId, qlonglong maxNewsId) const
+{
+  QString column = database().driver()->escapeIdentifier(
+        record().fieldName(sortColumn_), QSqlDriver::FieldName);
+  // NULL goes first in ascending order of SQLite
+  QString before;
+  if (sortOrder_ == Qt::AscendingOrder) {
+    before = QString("%1<? OR (%1 IS ? AND id<?) OR (%1 IS NULL AND ? IS NOT NULL)").arg(column);
+  } else {
+    before = QString("%1>? OR (%1 IS ? AND id>?) OR (%1 IS NOT NULL AND ? IS NULL)").arg(column);
+  }
+  QString qStr = QString("SELECT count(*) FROM main.news WHERE id<=? AND (%1)").arg(before);
+  if (!QSqlTableModel::filter().isEmpty())
+    qStr.append(QString(" AND (%1)").arg(QSqlTableModel::filter()));
+
+  QSqlQuery q(database());
+  q.setForwardOnly(true);
+  q.prepare(qStr);
+  q.addBindValue(maxNewsId);
+  q.addBindValue(value);
+  q.addBindValue(value);
+  q.addBindValue(newsId);
+  q.addBindValue(value);
+  if (!q.exec() || !q.next()) {
+    qWarning() << __PRETTY_FUNCTION__ << __LINE__
+               << "q.lastError(): " << q.lastError().text();
+    return -1;
+  }
+  return q.value(0).toInt();
+}
+
+/*virtual*/ int NewsModel::rowCount(const QModelIndex &parent) const
+{
+  if (parent.isValid())
+    return 0;
+  return QSqlTableModel::rowCount(parent) + mergedCount_;
+}
+
+/** @brief Insert news added to base since last select
+ *
+ * Result of list query is stepped again from first row, so it holds new
+ * news at their rows, and rows are inserted into model for them. Selection
+ * and scroll position of list are kept without reset of model. Values
+ * changed in cache of model and not written yet are moved to their rows.
+ * @return false if list must be selected again
+ *----------------------------------------------------------------------------*/
+bool NewsModel::mergeNews()
+{
+#if QT_VERSION < 0x050000
+  // Filled rows of model of Qt 4 can not be changed without reset
+  return false;
+#else
+  // Story of clustered list or order by feed name can change for old rows
+  if (clustered_ || (sortColumn_ == -1) || (sortColumn_ == columnRights_) ||
+      canFetchMore() || !archiveFilter_.isEmpty())
+    return false;
+
+  if (!result_)
+    return false;
+
+  qlonglong maxNewsId = maxNewsId();
+  if (maxNewsId <= maxNewsId_)
+    return true;
+
+  QString qStr = QString("SELECT id, %1 FROM main.news WHERE id>? AND id<=?").
+      arg(database().driver()->escapeIdentifier(record().fieldName(sortColumn_),
+                                                QSqlDriver::FieldName));
+  if (!QSqlTableModel::filter().isEmpty())
+    qStr.append(QString(" AND (%1)").arg(QSqlTableModel::filter()));
+
+  QSqlQuery q(database());
+  q.setForwardOnly(true);
+  q.prepare(qStr);
+  q.addBindValue(maxNewsId_);
+  q.addBindValue(maxNewsId);
+  if (!q.exec()) {
+    qWarning() << __PRETTY_FUNCTION__ << __LINE__
+               << "q.lastError(): " << q.lastError().text();
+    return false;
+  }
+  QList<int> rows;
+  while (q.next()) {
+    int row = mergeRow(q.value(1), q.value(0).toLongLong(), maxNewsId);
+    if (row < 0)
+      return false;
+    rows.append(row);
+  }
+  maxNewsId_ = maxNewsId;
+  if (rows.isEmpty())
+    return true;
+  std::sort(rows.begin(), rows.end());
+
+  // News added by other update after max(id) is read are not counted
+  if (!result_->refresh() || (query().size() != rowCount() + rows.count()))
+    return false;
+
+  // First visible news stays at top, unless list is scrolled to top
+  QPersistentModelIndex topIndex;
+  if (view_->verticalScrollBar()->value() > 0)
+    topIndex = view_->indexAt(QPoint(0, 0));
+
+  // Cache of model is kept by row, its changes are set again after insert
+  QList<QPair<int, QSqlRecord> > edits;
+  if (isDirty()) {
+    QList<int> editedRows = editedRows_.values();
+    std::sort(editedRows.begin(), editedRows.end());
+    foreach (int row, editedRows)
+      edits.append(qMakePair(row, QSqlTableModel::record(row)));
+    revertAll();
+  }
+  editedRows_.clear();
+  rowDataCache_.clear();
+
+  foreach (int row, rows) {
+    beginInsertRows(QModelIndex(), row, row);
+    mergedCount_++;
+    endInsertRows();
+  }
+
+  for (int i = 0; i < edits.count(); ++i) {
+    int row = edits.at(i).first;
+    foreach (int insertedRow, rows) {
+      if (insertedRow <= row)
+        row++;
+    }
+    const QSqlRecord &rec = edits.at(i).second;
+    for (int column = 0; column < rec.count(); ++column) {
+      if (rec.isGenerated(column))
+        setData(index(row, column), rec.value(column));
+    }
+  }
+
+  if (topIndex.isValid())
+    view_->scrollTo(topIndex, QAbstractItemView::PositionAtTop);
+  return true;
+#endif
 }
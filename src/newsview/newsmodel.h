@@ -25,23 +25,74 @@
 #endif
 #include <QtSql>
 
+class SQLiteResult;
+
+// Display values of news row computed once per select
+struct NewsRowData {
+  int labelIndex;      // first label item of news in categories tree, -1 if none
+  QString labelNames;
+  QString published;
+  QString received;
+};
+
 class NewsModel : public QSqlTableModel
 {
   Q_OBJECT
 public:
+  // Fields of news read by list and news view, columns are mapped once
+  // when table is set
+  enum Field {
+    FieldId,
+    FieldFeedId,
+    FieldTitle,
+    FieldPublished,
+    FieldReceived,
+    FieldRead,
+    FieldNew,
+    FieldStarred,
+    FieldLabel,
+    FieldDeleted,
+    FieldDeleteDate,
+    FieldAuthorName,
+    FieldAuthorEmail,
+    FieldAuthorUri,
+    FieldCategory,
+    FieldComments,
+    FieldEnclosureUrl,
+    FieldEnclosureType,
+    FieldLinkHref,
+    FieldLinkAlternate,
+    FieldCount
+  };
+
   NewsModel(QObject *parent, QTreeView *view);
   virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
   virtual QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
   virtual bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole);
+  virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
   virtual void sort(int column, Qt::SortOrder order);
   virtual QModelIndexList match(
       const QModelIndex &start, int role, const QVariant &value, int hits = 1,
       Qt::MatchFlags flags =
       Qt::MatchFlags(Qt::MatchExactly|Qt::MatchWrap)
       ) const;
+  const QVector<int> &unreadRows() const;
+  int unreadRow(int row, bool next) const;
   QVariant dataField(int row, const QString &fieldName) const;
+  QVariant dataField(int row, Field field) const;
+  int fieldColumn(Field field) const { return fieldColumns_[field]; }
+  void setTable(const QString &tableName);
   void setFilter(const QString &filter);
+  void setFilter(const QString &filter, const QString &archiveFilter);
+  QString filter() const { return baseFilter_; }
   bool select();
+  bool mergeNews();
+  void setClustered(bool clustered) { clustered_ = clustered; }
+  bool isClustered() const { return clustered_; }
+  qlonglong clusterId(int row) const;
+  bool isClusterExpanded(qlonglong clusterId) const { return expandedClusters_.contains(clusterId); }
+  void toggleCluster(qlonglong clusterId);
+  void releaseMemory() { clearCache(); }
 
   QString formatDate_;
   QString formatTime_;
@@ -52,11 +103,63 @@ public:
   QString focusedNewsTextColor_;
   QString focusedNewsBGColor_;
 
-signals:
-  void signalSort(int column, int order);
+protected:
+  virtual QString orderByClause() const;
+  virtual QString selectStatement() const;
+
+private slots:
+  void reselect();
 
 private:
+  quint64 labelBits(const QString &strIdLabels,
+                    const QList<QTreeWidgetItem *> &labelListItems) const;
+  bool hasLabel(quint64 bits, const QString &strIdLabels,
+                const QList<QTreeWidgetItem *> &labelListItems, int i) const;
+  const NewsRowData &rowData(int row) const;
+  QPixmap feedIcon(int feedId) const;
+  void clearCache();
+  qlonglong maxNewsId() const;
+  int mergeRow(const QVariant &value, qlonglong newsId, qlonglong maxNewsId) const;
+
   QTreeView *view_;
+  mutable QHash<QString,quint64> labelBitsCache_;
+  mutable int labelBitsCount_;
+  mutable QHash<int,NewsRowData> rowDataCache_;
+  mutable QHash<int,QPixmap> feedIconCache_;
+  int sortColumn_;
+  Qt::SortOrder sortOrder_;
+  bool clustered_;
+  QSet<qlonglong> expandedClusters_;
+  QString baseFilter_;
+  QString archiveFilter_;
+  // News with greater id are not in list, they are added by mergeNews()
+  qlonglong maxNewsId_;
+  // Rows inserted by mergeNews() after rows of last select
+  int mergedCount_;
+  // Rows changed by setData() since last select
+  QSet<int> editedRows_;
+  // Result of list query, its rows are checked when they are read again
+  SQLiteResult *result_;
+  mutable bool reselectPending_;
+  // Unread rows of first unreadRowsCount_ rows, built again if count changes
+  mutable QVector<int> unreadRows_;
+  mutable int unreadRowsCount_;
+
+  int columnFeedId_;
+  int columnTitle_;
+  int columnPublished_;
+  int columnReceived_;
+  int columnRead_;
+  int columnNew_;
+  int columnStarred_;
+  int columnLabel_;
+  int columnRights_;
+  int columnLinkHref_;
+  int columnLinkAlternate_;
+  int columnSnippet_;
+  int columnClusterId_;
+  int columnClusterSize_;
+  int fieldColumns_[FieldCount];
 
 };
 
@@ -69,12 +69,15 @@ NewsItem::~NewsItem()
 
 }
 
-void NewsItem::setText(const QString &text)
+void NewsItem::setText(const QString &text, const QString &snippet)
 {
   QString titleStr = textLabel_->fontMetrics().elidedText(
         text, Qt::ElideRight, textLabel_->sizeHint().width());
   textLabel_->setText(titleStr);
-  textLabel_->setToolTip(text);
+  if (snippet.isEmpty())
+    textLabel_->setToolTip(text);
+  else
+    textLabel_->setToolTip(text % "\n\n" % snippet);
 }
 
 void NewsItem::setFontText(const QFont & font)
@@ -113,16 +116,7 @@ void NewsItem::openExternalBrowser()
   textLabel_->setFont(font);
   emit signalMarkRead(feedId_, newsId_, read_);
 
-  QString linkString;
-  QSqlQuery q;
-  q.exec(QString("SELECT link_href, link_alternate FROM news WHERE id=='%1'").arg(newsId_));
-  if (q.next()) {
-    linkString = q.value(0).toString();
-    if (linkString.isEmpty()) {
-      linkString = q.value(1).toString();
-    }
-  }
-  emit signalOpenExternalBrowser(linkString.simplified());
+  emit signalOpenExternalBrowser(link_.simplified());
 }
 
 void NewsItem::markRead()
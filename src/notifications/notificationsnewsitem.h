@@ -34,7 +34,8 @@ public:
   NewsItem(int idFeed, int idNews, int width, QWidget * parent = 0);
   ~NewsItem();
 
-  void setText(const QString &text);
+  void setText(const QString &text, const QString &snippet = QString());
+  void setLink(const QString &link) { link_ = link; }
   void setFontText(const QFont & font);
   void setColorText(const QString &color, const QString &linkColor);
 
@@ -61,6 +62,7 @@ private:
   int feedId_;
   int newsId_;
   bool read_;
+  QString link_;
 
   QLabel *textLabel_;
 
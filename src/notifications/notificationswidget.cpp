@@ -22,14 +22,15 @@
 #include "notificationsnewsitem.h"
 #include "optionsdialog.h"
 
-NotificationWidget::NotificationWidget(QList<int> idFeedList,
-                                       QList<int> cntNewNewsList,
+NotificationWidget::NotificationWidget(const QList<NotificationFeedStruct> &feeds,
                                        QList<int> idColorList,
                                        QStringList colorList,
                                        QWidget *parentWidget,
                                        QWidget *parent)
   : QWidget(parent)
-  , idFeedList_(idFeedList)
+  , feeds_(feeds)
+  , idColorList_(idColorList)
+  , colorList_(colorList)
   , cntAllNews_(0)
   , cntReadNews_(0)
 {
@@ -46,38 +47,32 @@ NotificationWidget::NotificationWidget(QList<int> idFeedList,
   setAttribute(Qt::WA_AlwaysShowToolTips);
 
   int numberItems;
-  int widthList;
-  QString fontFamily;
-  int fontSize;
-  QString textColor;
   QString backgroundColor;
-  QString linkColor;
-  bool showTitlesFeedsNotify;
-  bool showIconFeedNotify;
   bool showButtonMarkAllNotify;
-  bool showButtonMarkReadNotify;
-  bool showButtonExBrowserNotify;
-  bool showButtonDeleteNotify;
 
-  if (idFeedList.count()) {
+  foreach (const NotificationFeedStruct &feed, feeds)
+    idFeedList_.append(feed.feedId);
+
+  bool mainWindowNotify = !feeds.isEmpty();
+  if (mainWindowNotify) {
     screen_ = mainApp->mainWindow()->screenNotify_;
     position_ = mainApp->mainWindow()->positionNotify_;
     transparency_ = mainApp->mainWindow()->transparencyNotify_;
     timeShowNews_ = mainApp->mainWindow()->timeShowNewsNotify_;
     numberItems = mainApp->mainWindow()->countShowNewsNotify_;
-    widthList = mainApp->mainWindow()->widthTitleNewsNotify_;
-    fontFamily = mainApp->mainWindow()->notificationFontFamily_;
-    fontSize = mainApp->mainWindow()->notificationFontSize_;
-    textColor = mainApp->mainWindow()->notifierTextColor_;
+    widthList_ = mainApp->mainWindow()->widthTitleNewsNotify_;
+    fontFamily_ = mainApp->mainWindow()->notificationFontFamily_;
+    fontSize_ = mainApp->mainWindow()->notificationFontSize_;
+    textColor_ = mainApp->mainWindow()->notifierTextColor_;
     backgroundColor = mainApp->mainWindow()->notifierBackgroundColor_;
-    linkColor = mainApp->mainWindow()->linkColor_;
+    linkColor_ = mainApp->mainWindow()->linkColor_;
 
-    showTitlesFeedsNotify = mainApp->mainWindow()->showTitlesFeedsNotify_;
-    showIconFeedNotify = mainApp->mainWindow()->showIconFeedNotify_;
+    showTitlesFeedsNotify_ = mainApp->mainWindow()->showTitlesFeedsNotify_;
+    showIconFeedNotify_ = mainApp->mainWindow()->showIconFeedNotify_;
     showButtonMarkAllNotify = mainApp->mainWindow()->showButtonMarkAllNotify_;
-    showButtonMarkReadNotify = mainApp->mainWindow()->showButtonMarkReadNotify_;
-    showButtonExBrowserNotify = mainApp->mainWindow()->showButtonExBrowserNotify_;
-    showButtonDeleteNotify = mainApp->mainWindow()->showButtonDeleteNotify_;
+    showButtonMarkReadNotify_ = mainApp->mainWindow()->showButtonMarkReadNotify_;
+    showButtonExBrowserNotify_ = mainApp->mainWindow()->showButtonExBrowserNotify_;
+    showButtonDeleteNotify_ = mainApp->mainWindow()->showButtonDeleteNotify_;
     closeNotify_ = mainApp->mainWindow()->closeNotify_;
   } else {
     OptionsDialog *options = qobject_cast<OptionsDialog*>(parentWidget);
@@ -86,24 +81,20 @@ NotificationWidget::NotificationWidget(QList<int> idFeedList,
     transparency_ = options->transparencyNotify_->value();
     timeShowNews_ = options->timeShowNewsNotify_->value();
     numberItems = options->countShowNewsNotify_->value();
-    widthList = options->widthTitleNewsNotify_->value();
-    fontFamily = options->fontsTree_->topLevelItem(4)->text(2).section(", ", 0, 0);
-    fontSize = options->fontsTree_->topLevelItem(4)->text(2).section(", ", 1).toInt();
-    textColor = options->colorsTree_->topLevelItem(21)->text(1);
+    widthList_ = options->widthTitleNewsNotify_->value();
+    fontFamily_ = options->fontsTree_->topLevelItem(4)->text(2).section(", ", 0, 0);
+    fontSize_ = options->fontsTree_->topLevelItem(4)->text(2).section(", ", 1).toInt();
+    textColor_ = options->colorsTree_->topLevelItem(21)->text(1);
     backgroundColor = options->colorsTree_->topLevelItem(22)->text(1);
-    linkColor = options->colorsTree_->topLevelItem(6)->text(1);
+    linkColor_ = options->colorsTree_->topLevelItem(6)->text(1);
 
-    showTitlesFeedsNotify = options->showTitlesFeedsNotify_->isChecked();
-    showIconFeedNotify = options->showIconFeedNotify_->isChecked();
+    showTitlesFeedsNotify_ = options->showTitlesFeedsNotify_->isChecked();
+    showIconFeedNotify_ = options->showIconFeedNotify_->isChecked();
     showButtonMarkAllNotify = options->showButtonMarkAllNotify_->isChecked();
-    showButtonMarkReadNotify = options->showButtonMarkReadNotify_->isChecked();
-    showButtonExBrowserNotify = options->showButtonExBrowserNotify_->isChecked();
-    showButtonDeleteNotify = options->showButtonDeleteNotify_->isChecked();
+    showButtonMarkReadNotify_ = options->showButtonMarkReadNotify_->isChecked();
+    showButtonExBrowserNotify_ = options->showButtonExBrowserNotify_->isChecked();
+    showButtonDeleteNotify_ = options->showButtonDeleteNotify_->isChecked();
     closeNotify_ = options->closeNotify_->isChecked();
-
-    for (int i = 0; i < 10; i++) {
-      cntNewNewsList << 9;
-    }
   }
 
   if (screen_ == -1) {
@@ -214,164 +205,73 @@ NotificationWidget::NotificationWidget(QList<int> idFeedList,
 
   setLayout(layout);
 
-  addPage(false);
-
-  if (!idFeedList.isEmpty()) {
-    int countItems = 0;
-    for (int i = 0; i < idFeedList.count(); i++) {
-      QSqlQuery q;
-      QString qStr;
-      QString titleFeed;
-      QPixmap icon;
-      int idFeed = idFeedList[i];
-      int cntNews;
-
-      qStr = QString("SELECT text, image, newCount FROM feeds WHERE id=='%1'").
-          arg(idFeed);
-      q.exec(qStr);
-      if (q.next()) {
-        cntNews = q.value(2).toInt();
-        if (!cntNews)
-          continue;
-
-        titleFeed = q.value(0).toString();
-        QByteArray byteArray = q.value(1).toByteArray();
-        if (!byteArray.isNull()) {
-          icon.loadFromData(QByteArray::fromBase64(byteArray));
-        } else {
-          icon.load(":/images/feed");
-        }
-      } else {
-        continue;
+  // Review
+  if (!mainWindowNotify) {
+    for (int i = 0; i < 10; i++) {
+      NotificationFeedStruct feed;
+      feed.feedId = 0;
+      feed.title = QString("Title Feed %1").arg(i+1);
+      feed.newCount = 9;
+      for (int y = 0; y < feed.newCount; y++) {
+        NotificationNewsStruct news;
+        news.newsId = 0;
+        news.title = "Test News Test News Test News Test News Test News";
+        feed.news.append(news);
       }
-      cntAllNews_ = cntAllNews_ + cntNewNewsList[i];
+      feeds_.append(feed);
+    }
+  }
 
-      if (showTitlesFeedsNotify) {
-        if (countItems >= (numberItems - 1)) {
+  // Items of pages are only counted, widgets are created on showing page
+  int countItems = 0;
+  pageRows_.append(QList<QPair<int, int> >());
+  for (int i = 0; i < feeds_.count(); i++) {
+    const NotificationFeedStruct &feed = feeds_.at(i);
+    if (feed.icon.isNull())
+      icons_.append(QPixmap(":/images/feed"));
+    else
+      icons_.append(QPixmap::fromImage(feed.icon));
+    cntAllNews_ = cntAllNews_ + feed.newCount;
+
+    if (showTitlesFeedsNotify_) {
+      if (countItems >= (numberItems - 1)) {
+        countItems = 1;
+        pageRows_.append(QList<QPair<int, int> >());
+      } else countItems++;
+      pageRows_.last().append(qMakePair(i, -1));
+    }
+
+    for (int y = 0; y < feed.news.count(); y++) {
+      if (countItems >= numberItems) {
+        pageRows_.append(QList<QPair<int, int> >());
+        if (showTitlesFeedsNotify_) {
+          countItems = 2;
+          pageRows_.last().append(qMakePair(i, -1));
+        } else {
           countItems = 1;
-          addPage();
-        } else countItems++;
-
-        FeedItem *feedItem = new FeedItem(widthList, this);
-        feedItem->setIcon(icon);
-        feedItem->setFontTitle(QFont(fontFamily, fontSize, -1, true));
-        feedItem->setColorText(textColor);
-        feedItem->setTitle(titleFeed, cntNewNewsList[i]);
-        pageLayout_->addWidget(feedItem);
-      }
+        }
+      } else countItems++;
 
-      int cntNewNews = 0;
-
-      qStr = QString("SELECT id, title FROM news WHERE new=1 AND feedId=='%1' ORDER BY received DESC").
-          arg(idFeed);
-      q.exec(qStr);
-      while (q.next()) {
-        if (cntNewNews >= cntNewNewsList[i]) break;
-        else cntNewNews++;
-
-        if (countItems >= numberItems) {
-          addPage();
-          if (showTitlesFeedsNotify) {
-            countItems = 2;
-
-            FeedItem *feedItem = new FeedItem(widthList, this);
-            feedItem->setIcon(icon);
-            feedItem->setFontTitle(QFont(fontFamily, fontSize, -1, true));
-            feedItem->setColorText(textColor);
-            feedItem->setTitle(titleFeed, cntNewNewsList[i]);
-            pageLayout_->addWidget(feedItem);
-          } else {
-            countItems = 1;
-          }
-        } else countItems++;
-
-        int idNews = q.value(0).toInt();
-        idNewsList_.append(idNews);
-        NewsItem *newsItem = new NewsItem(idFeed, idNews, widthList, this);
-        newsItem->setFontText(QFont(fontFamily, fontSize, QFont::Bold));
-        newsItem->setText(q.value(1).toString());
-        int index = idColorList.indexOf(idNews);
-        if (index != -1)
-          newsItem->setColorText(colorList.at(index), linkColor);
-        else
-          newsItem->setColorText(textColor, linkColor);
-        newsItem->iconLabel_->setPixmap(icon);
-        newsItem->iconLabel_->setToolTip(titleFeed);
-        newsItem->readButton_->setVisible(showButtonMarkReadNotify);
-        newsItem->iconLabel_->setVisible(showIconFeedNotify);
-        newsItem->openExternalBrowserButton_->setVisible(showButtonExBrowserNotify);
-        newsItem->deleteButton_->setVisible(showButtonDeleteNotify);
-        pageLayout_->addWidget(newsItem);
-
-        connect(newsItem, SIGNAL(signalMarkRead(int, int, int)),
-                this, SLOT(slotMarkRead(int, int, int)));
-        connect(newsItem, SIGNAL(signalTitleClicked(int, int)),
-                this, SLOT(slotOpenNew(int, int)));
-        connect(newsItem, SIGNAL(signalOpenExternalBrowser(QUrl)),
-                this, SIGNAL(signalOpenExternalBrowser(QUrl)));
-        connect(newsItem, SIGNAL(signalDeleteNews(int,int)),
-                this, SLOT(slotDeleteNews(int, int)));
-      }
+      pageRows_.last().append(qMakePair(i, y));
+      if (feed.feedId)
+        idNewsList_.append(feed.news.at(y).newsId);
     }
   }
-  // Review
-  else {
-    int countItems = 0;
-    for (int i = 0; i < 10; i++) {
-      if (showTitlesFeedsNotify) {
-        if (countItems >= (numberItems - 1)) {
-          countItems = 1;
-          addPage();
-        } else countItems++;
-
-        FeedItem *feedItem = new FeedItem(widthList, this);
-        feedItem->setIcon(QPixmap(":/images/feed"));
-        feedItem->setFontTitle(QFont(fontFamily, fontSize, -1, true));
-        feedItem->setColorText(textColor);
-        feedItem->setTitle(QString("Title Feed %1").arg(i+1), 9);
-        pageLayout_->addWidget(feedItem);
-      }
 
-      for (int y = 0; y < cntNewNewsList.at(i); y++) {
-        if (countItems >= numberItems) {
-          addPage();
-          if (showTitlesFeedsNotify) {
-            countItems = 2;
-
-            FeedItem *feedItem = new FeedItem(widthList, this);
-            feedItem->setIcon(QPixmap(":/images/feed"));
-            feedItem->setFontTitle(QFont(fontFamily, fontSize, -1, true));
-            feedItem->setColorText(textColor);
-            feedItem->setTitle(QString("Title Feed %1").arg(i+1), 9);
-            pageLayout_->addWidget(feedItem);
-          } else {
-            countItems = 1;
-          }
-        } else countItems++;
-
-        NewsItem *newsItem = new NewsItem(0, 0, widthList, this);
-        newsItem->setFontText(QFont(fontFamily, fontSize, QFont::Bold));
-        newsItem->setColorText(textColor, linkColor);
-        newsItem->setText("Test News Test News Test News Test News Test News");
-        newsItem->iconLabel_->setPixmap(QPixmap(":/images/feed"));
-        newsItem->iconLabel_->setToolTip(QString("Title Feed %1").arg(i+1));
-        newsItem->readButton_->setVisible(showButtonMarkReadNotify);
-        newsItem->iconLabel_->setVisible(showIconFeedNotify);
-        newsItem->openExternalBrowserButton_->setVisible(showButtonExBrowserNotify);
-        newsItem->deleteButton_->setVisible(showButtonDeleteNotify);
-        pageLayout_->addWidget(newsItem);
-      }
-    }
-    foreach (int cntNews, cntNewNewsList) {
-      cntAllNews_ = cntAllNews_ + cntNews;
-    }
+  for (int i = 0; i < pageRows_.count(); i++) {
+    QVBoxLayout *pageLayout = new QVBoxLayout();
+    pageLayout->setMargin(5);
+    pageLayout->setSpacing(0);
+    QWidget *pageWidget = new QWidget(this);
+    pageWidget->setLayout(pageLayout);
+    stackedWidget_->addWidget(pageWidget);
   }
+  pageFilled_.fill(false, pageRows_.count());
+  fillPage(0);
 
   textTitle_->setText(QString(tr("Incoming News: %1")).arg(cntAllNews_));
-  if ((cntAllNews_ + idFeedList.count()) > numberItems) nextButton_->setEnabled(true);
-  else nextButton_->setEnabled(false);
+  nextButton_->setEnabled(stackedWidget_->count() > 1);
 
-  pageLayout_->addStretch();
   numPage_->setText(QString(tr("Page %1 of %2").arg("1").arg(stackedWidget_->count())));
 
   showTimer_ = new QTimer(this);
@@ -443,20 +343,62 @@ void NotificationWidget::leaveEvent(QEvent*)
     showTimer_->start(timeShowNews_*1000);
 }
 
-void NotificationWidget::addPage(bool next)
+/** @brief Create items of page when it is shown first time
+ *----------------------------------------------------------------------------*/
+void NotificationWidget::fillPage(int page)
 {
-  if (next) pageLayout_->addStretch();
-
-  pageLayout_ = new QVBoxLayout();
-  pageLayout_->setMargin(5);
-  pageLayout_->setSpacing(0);
-  QWidget *pageWidget = new QWidget(this);
-  pageWidget->setLayout(pageLayout_);
-  stackedWidget_->addWidget(pageWidget);
+  if ((page >= pageFilled_.count()) || pageFilled_.at(page))
+    return;
+  pageFilled_[page] = true;
+
+  QVBoxLayout *pageLayout = qobject_cast<QVBoxLayout*>(stackedWidget_->widget(page)->layout());
+  foreach (const QPair<int, int> &row, pageRows_.at(page)) {
+    const NotificationFeedStruct &feed = feeds_.at(row.first);
+    if (row.second < 0) {
+      FeedItem *feedItem = new FeedItem(widthList_, this);
+      feedItem->setIcon(icons_.at(row.first));
+      feedItem->setFontTitle(QFont(fontFamily_, fontSize_, -1, true));
+      feedItem->setColorText(textColor_);
+      feedItem->setTitle(feed.title, feed.newCount);
+      pageLayout->addWidget(feedItem);
+      continue;
+    }
+
+    const NotificationNewsStruct &news = feed.news.at(row.second);
+    NewsItem *newsItem = new NewsItem(feed.feedId, news.newsId, widthList_, this);
+    newsItem->setFontText(QFont(fontFamily_, fontSize_, QFont::Bold));
+    newsItem->setText(news.title, news.snippet);
+    newsItem->setLink(news.link);
+    int index = feed.feedId ? idColorList_.indexOf(news.newsId) : -1;
+    if (index != -1)
+      newsItem->setColorText(colorList_.at(index), linkColor_);
+    else
+      newsItem->setColorText(textColor_, linkColor_);
+    newsItem->iconLabel_->setPixmap(icons_.at(row.first));
+    newsItem->iconLabel_->setToolTip(feed.title);
+    newsItem->readButton_->setVisible(showButtonMarkReadNotify_);
+    newsItem->iconLabel_->setVisible(showIconFeedNotify_);
+    newsItem->openExternalBrowserButton_->setVisible(showButtonExBrowserNotify_);
+    newsItem->deleteButton_->setVisible(showButtonDeleteNotify_);
+    pageLayout->addWidget(newsItem);
+
+    if (!feed.feedId)
+      continue;
+    connect(newsItem, SIGNAL(signalMarkRead(int, int, int)),
+            this, SLOT(slotMarkRead(int, int, int)));
+    connect(newsItem, SIGNAL(signalTitleClicked(int, int)),
+            this, SLOT(slotOpenNew(int, int)));
+    connect(newsItem, SIGNAL(signalOpenExternalBrowser(QUrl)),
+            this, SIGNAL(signalOpenExternalBrowser(QUrl)));
+    connect(newsItem, SIGNAL(signalDeleteNews(int,int)),
+            this, SLOT(slotDeleteNews(int, int)));
+  }
+  pageLayout->addStretch();
 }
 
 void NotificationWidget::nextPage()
 {
+  fillPage(stackedWidget_->currentIndex()+1);
   stackedWidget_->setCurrentIndex(stackedWidget_->currentIndex()+1);
   if (stackedWidget_->currentIndex()+1 == stackedWidget_->count())
     nextButton_->setEnabled(false);
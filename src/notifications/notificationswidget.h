@@ -26,13 +26,13 @@
 #include <QtSql>
 
 #include "toolbutton.h"
+#include "parseobject.h"
 
 class NotificationWidget : public QWidget
 {
   Q_OBJECT
 public:
-  NotificationWidget(QList<int> idFeedList,
-                     QList<int> cntNewNewsList,
+  NotificationWidget(const QList<NotificationFeedStruct> &feeds,
                      QList<int> idColorList,
                      QStringList colorList,
                      QWidget *parentWidget,
@@ -66,17 +66,23 @@ private slots:
   void slotMarkAllRead();
 
 private:
-  void addPage(bool next = true);
+  void fillPage(int page);
 
   QLabel *iconTitle_;
   QLabel *textTitle_;
   QToolButton *closeButton_;
   QStackedWidget *stackedWidget_;
-  QVBoxLayout *pageLayout_;
   QLabel *numPage_;
   ToolButton *prevButton_;
   ToolButton *nextButton_;
 
+  QList<NotificationFeedStruct> feeds_;
+  QList<QPixmap> icons_;
+  QList<QList<QPair<int, int> > > pageRows_;  // feed and news index, news -1 for feed title
+  QVector<bool> pageFilled_;
+  QList<int> idColorList_;
+  QStringList colorList_;
+
   QList<int> idFeedList_;
   QList<int> idNewsList_;
   QTimer *showTimer_;
@@ -88,6 +94,17 @@ private:
   int cntReadNews_;
   bool closeNotify_;
 
+  int widthList_;
+  QString fontFamily_;
+  int fontSize_;
+  QString textColor_;
+  QString linkColor_;
+  bool showTitlesFeedsNotify_;
+  bool showIconFeedNotify_;
+  bool showButtonMarkReadNotify_;
+  bool showButtonExBrowserNotify_;
+  bool showButtonDeleteNotify_;
+
 };
 
 #endif // NOTIFICATIONSWIDGET_H
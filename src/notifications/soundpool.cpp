@@ -0,0 +1,166 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "soundpool.h"
+
+#include "mainapplication.h"
+#include "settings.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QProcess>
+#include <QSound>
+#include <QTextCodec>
+#include <QTimer>
+#include <QUrl>
+
+// The same sound requested within this time is played once (ms)
+#define SOUND_COALESCE_INTERVAL 2000
+// Sounds are decoded after startup, they are not needed before (ms)
+#define SOUND_PRELOAD_DELAY 5000
+
+SoundPool::SoundPool(QObject *parent)
+  : QObject(parent)
+#if !defined(HAVE_QT5) && defined(HAVE_PHONON)
+  , mediaPlayer_(0)
+  , audioOutput_(0)
+#endif
+{
+  Settings settings;
+  useMediaPlayer_ = settings.value("Settings/useMediaPlayer", true).toBool();
+  clock_.start();
+}
+
+/** @brief Decode sound before it is played first time
+ *----------------------------------------------------------------------------*/
+void SoundPool::preload(const QString &path)
+{
+#ifdef HAVE_QT5
+  if (!useMediaPlayer_ || preloadPaths_.contains(path))
+    return;
+  if (preloadPaths_.isEmpty())
+    QTimer::singleShot(SOUND_PRELOAD_DELAY, this, SLOT(slotPreload()));
+  preloadPaths_.append(path);
+#else
+  Q_UNUSED(path);
+#endif
+}
+
+#ifdef HAVE_QT5
+void SoundPool::slotPreload()
+{
+  foreach (const QString &path, preloadPaths_) {
+    QString soundPath = mainApp->absolutePath(path);
+    if (QFile::exists(soundPath))
+      effect(soundPath);
+  }
+  preloadPaths_.clear();
+}
+#endif
+
+void SoundPool::play(const QString &path)
+{
+  QString soundPath = mainApp->absolutePath(path);
+
+  qint64 now = clock_.elapsed();
+  QHash<QString, qint64>::iterator it = playTimes_.find(soundPath);
+  if ((it != playTimes_.end()) && (now - it.value() < SOUND_COALESCE_INTERVAL))
+    return;
+
+  if (!QFile::exists(soundPath)) {
+    qWarning() << QString("Error playing sound: %1").arg(soundPath);
+    return;
+  }
+  playTimes_.insert(soundPath, now);
+
+  bool playing = false;
+  if (useMediaPlayer_) {
+#ifdef HAVE_QT5
+    QSoundEffect *soundEffect = effect(soundPath);
+    if (soundEffect->status() != QSoundEffect::Error) {
+      // Effect still loading is played when ready
+      soundEffect->play();
+      playing = true;
+    }
+#else
+#ifdef HAVE_PHONON
+    if (mediaPlayer_ == 0) {
+      mediaPlayer_ = new Phonon::MediaObject(this);
+      audioOutput_ = new Phonon::AudioOutput(Phonon::MusicCategory, this);
+      Phonon::createPath(mediaPlayer_, audioOutput_);
+      connect(mediaPlayer_, SIGNAL(stateChanged(Phonon::State,Phonon::State)),
+              this, SLOT(mediaStateChanged(Phonon::State,Phonon::State)));
+    }
+
+    if (mediaPlayer_->state() == Phonon::ErrorState)
+      mediaPlayer_->clear();
+
+    if ((mediaPlayer_->state() != Phonon::PausedState) &&
+        (mediaPlayer_->state() != Phonon::StoppedState)) {
+      mediaPlayer_->enqueue(soundPath);
+    }
+    else {
+      mediaPlayer_->setCurrentSource(soundPath);
+    }
+    mediaPlayer_->play();
+
+    playing = true;
+#endif
+#endif
+  }
+
+  if (!playing) {
+#if defined(Q_OS_WIN) || defined(Q_OS_OS2)
+    QSound::play(soundPath);
+#else
+    QProcess::startDetached(QString("play %1").arg(soundPath));
+#endif
+  }
+}
+
+#ifdef HAVE_QT5
+QSoundEffect *SoundPool::effect(const QString &soundPath)
+{
+  QSoundEffect *soundEffect = effects_.value(soundPath, 0);
+  if (!soundEffect) {
+    soundEffect = new QSoundEffect(this);
+    connect(soundEffect, SIGNAL(statusChanged()), this, SLOT(slotStatusChanged()));
+    soundEffect->setSource(QUrl::fromLocalFile(soundPath));
+    effects_.insert(soundPath, soundEffect);
+  }
+  return soundEffect;
+}
+
+void SoundPool::slotStatusChanged()
+{
+  QSoundEffect *soundEffect = qobject_cast<QSoundEffect*>(sender());
+  if (soundEffect && (soundEffect->status() == QSoundEffect::Error))
+    qCritical() << QString("Error Media: cannot load %1").arg(soundEffect->source().toLocalFile());
+}
+#endif
+
+#ifdef HAVE_PHONON
+void SoundPool::mediaStateChanged(Phonon::State newstate, Phonon::State)
+{
+  if (newstate == Phonon::ErrorState) {
+    QTextCodec *codec = QTextCodec::codecForLocale();
+    qCritical() << QString("Error Phonon: %1 - %2").
+                   arg(mediaPlayer_->errorType()).
+                   arg(codec->toUnicode(mediaPlayer_->errorString().toUtf8()));
+  }
+}
+#endif
@@ -0,0 +1,76 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef SOUNDPOOL_H
+#define SOUNDPOOL_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QStringList>
+#ifdef HAVE_QT5
+#include <QSoundEffect>
+#else
+#ifdef HAVE_PHONON
+#include <phonon/audiooutput.h>
+#include <phonon/mediaobject.h>
+#endif
+#endif
+
+/** @brief Sounds of notifications and filters kept ready to play
+ *
+ * With Qt5 every sound file is decoded once into its own effect, which
+ * is triggered at once. Sound requested again shortly after it was played
+ * is not repeated, so many filters playing it during refresh sound once.
+ *----------------------------------------------------------------------------*/
+class SoundPool : public QObject
+{
+  Q_OBJECT
+public:
+  explicit SoundPool(QObject *parent = 0);
+
+  void preload(const QString &path);
+  void play(const QString &path);
+
+private slots:
+#ifdef HAVE_QT5
+  void slotStatusChanged();
+  void slotPreload();
+#endif
+#ifdef HAVE_PHONON
+  void mediaStateChanged(Phonon::State newstate, Phonon::State oldstate);
+#endif
+
+private:
+  bool useMediaPlayer_;
+  QElapsedTimer clock_;
+  // Time of last playing by absolute path of sound
+  QHash<QString, qint64> playTimes_;
+#ifdef HAVE_QT5
+  QSoundEffect *effect(const QString &soundPath);
+  QHash<QString, QSoundEffect*> effects_;
+  QStringList preloadPaths_;
+#else
+#ifdef HAVE_PHONON
+  Phonon::MediaObject *mediaPlayer_;
+  Phonon::AudioOutput *audioOutput_;
+#endif
+#endif
+
+};
+
+#endif // SOUNDPOOL_H
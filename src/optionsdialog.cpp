@@ -397,9 +397,7 @@ void OptionsDialog::createTraySystemWidget()
   trayLayout->addWidget(singleClickTray_);
   trayLayout->addWidget(clearStatusNew_);
 #endif
-#if defined(Q_OS_WIN)
   trayLayout->addWidget(emptyWorking_);
-#endif
   trayLayout->addStretch(1);
 
   QVBoxLayout *boxTrayLayout = new QVBoxLayout();
@@ -709,11 +707,7 @@ void OptionsDialog::createBrowserWidget()
   QWidget *click2FlashWidget_ = new QWidget(this);
   click2FlashWidget_->setLayout(click2FlashLayout);
 
-  c2fEnabled_->setChecked(mainApp->c2fIsEnabled());
-  foreach(const QString & site, mainApp->c2fGetWhitelist()) {
-    QTreeWidgetItem* item = new QTreeWidgetItem(c2fWhitelist_);
-    item->setText(0, site);
-  }
+  loadWhitelist();
 
   //! tab "Downloads"
   downloadLocationEdit_ = new LineEdit();
@@ -1297,20 +1291,6 @@ void OptionsDialog::createPasswordsWidget()
   strTreeItem << "Id" << tr("Site") << tr("User") << tr("Password");
   passTree_->setHeaderLabels(strTreeItem);
 
-  QSqlQuery q;
-  q.exec("SELECT id, server, username, password FROM passwords");
-  while (q.next()) {
-    QString id = q.value(0).toString();
-    QString server = q.value(1).toString();
-    QString user = q.value(2).toString();
-    QString pass = QString::fromUtf8(QByteArray::fromBase64(q.value(3).toByteArray()));
-
-    strTreeItem.clear();
-    strTreeItem << id << server << user << pass;
-    QTreeWidgetItem *treeWidgetItem = new QTreeWidgetItem(strTreeItem);
-    passTree_->addTopLevelItem(treeWidgetItem);
-  }
-
   QPushButton *deletePass = new QPushButton(tr("Delete"));
   connect(deletePass, SIGNAL(clicked()), this, SLOT(slotDeletePass()));
   QPushButton *deleteAllPass = new QPushButton(tr("Delete All"));
@@ -1331,6 +1311,8 @@ void OptionsDialog::createPasswordsWidget()
 
   passwordsWidget_ = new QWidget();
   passwordsWidget_->setLayout(passLayout);
+
+  loadPassOk_ = false;
 }
 
 /** @brief Create widget "Language"
@@ -1924,6 +1906,8 @@ void OptionsDialog::slotCategoriesItemClicked(QTreeWidgetItem* item, int)
     loadLabels();
   } else if (item->data(1, Qt::DisplayRole).toString() == tr("Notifications")) {
     loadNotifier();
+  } else if (item->data(1, Qt::DisplayRole).toString() == tr("Passwords")) {
+    loadPasswords();
   }
 }
 //----------------------------------------------------------------------------
@@ -2313,6 +2297,15 @@ void OptionsDialog::selectionBrowser()
     otherExternalBrowserEdit_->setText(fileName);
 }
 //----------------------------------------------------------------------------
+void OptionsDialog::loadWhitelist()
+{
+  c2fEnabled_->setChecked(mainApp->c2fIsEnabled());
+  foreach(const QString & site, mainApp->c2fGetWhitelist()) {
+    QTreeWidgetItem* item = new QTreeWidgetItem(c2fWhitelist_);
+    item->setText(0, site);
+  }
+}
+//----------------------------------------------------------------------------
 void OptionsDialog::applyWhitelist()
 {
   mainApp->c2fSetEnabled(c2fEnabled_->isChecked());
@@ -2382,6 +2375,36 @@ void OptionsDialog::setCheckStateItem(QTreeWidgetItem *item, Qt::CheckState stat
     setCheckStateItem(childItem, state);
   }
 }
+
+/** @brief Prepare dialog kept between openings to be shown again
+ *
+ *  Pages filled from database are reloaded when selected next time,
+ *  values of other pages are set by MainWindow before showing
+ *----------------------------------------------------------------------------*/
+void OptionsDialog::reloadPages()
+{
+  labelsTree_->clear();
+  idLabels_.clear();
+  loadLabelsOk_ = false;
+
+  itemNotChecked_ = true;
+  QTreeWidgetItem *allFeedsItem = feedsTreeNotify_->topLevelItem(0);
+  qDeleteAll(allFeedsItem->takeChildren());
+  allFeedsItem->setCheckState(0, Qt::Checked);
+  itemNotChecked_ = false;
+  loadNotifierOk_ = false;
+
+  passTree_->clear();
+  passTree_->hideColumn(3);
+  passTree_->setColumnWidth(1, 250);
+  loadPassOk_ = false;
+
+  c2fWhitelist_->clear();
+  loadWhitelist();
+
+  shortcutModel_->removeRows(0, shortcutModel_->rowCount());
+  editShortcut_->clear();
+}
 //----------------------------------------------------------------------------
 void OptionsDialog::loadLabels()
 {
@@ -2690,7 +2713,8 @@ void OptionsDialog::loadNotifier()
   parentIds.enqueue(0);
   while (!parentIds.empty()) {
     int parentId = parentIds.dequeue();
-    QString qStr = QString("SELECT text, id, image, xmlUrl FROM feeds WHERE parentId='%1' ORDER BY rowToParent").
+    QString qStr = QString("SELECT text, id, (SELECT image FROM feedsIcons WHERE feedId=feeds.id), xmlUrl "
+                           "FROM feeds WHERE parentId='%1' ORDER BY rowToParent").
         arg(parentId);
     q.exec(qStr);
     while (q.next()) {
@@ -2746,6 +2770,9 @@ void OptionsDialog::loadNotifier()
 //----------------------------------------------------------------------------
 void OptionsDialog::applyNotifier()
 {
+  // Feeds are not changed if page was not opened
+  if (!loadNotifierOk_) return;
+
   mainApp->mainWindow()->idFeedsNotifyList_.clear();
 
   feedsTreeNotify_->expandAll();
@@ -2774,12 +2801,10 @@ void OptionsDialog::applyNotifier()
 void OptionsDialog::showNotification()
 {
   if (notificationWidget_) delete notificationWidget_;
-  QList<int> idFeedList;
-  QList<int> cntNewNewsList;
+  QList<NotificationFeedStruct> feedsList;
   QList<int> idColorList;
   QStringList colorList;
-  notificationWidget_ = new NotificationWidget(idFeedList, cntNewNewsList,
-                                               idColorList, colorList,
+  notificationWidget_ = new NotificationWidget(feedsList, idColorList, colorList,
                                                this, this);
 
   connect(notificationWidget_, SIGNAL(signalClose()),
@@ -2817,6 +2842,26 @@ void OptionsDialog::slotShowPass()
   }
 }
 //----------------------------------------------------------------------------
+void OptionsDialog::loadPasswords()
+{
+  if (loadPassOk_) return;
+  loadPassOk_ = true;
+
+  QSqlQuery q;
+  q.exec("SELECT id, server, username, password FROM passwords");
+  while (q.next()) {
+    QString id = q.value(0).toString();
+    QString server = q.value(1).toString();
+    QString user = q.value(2).toString();
+    QString pass = QString::fromUtf8(QByteArray::fromBase64(q.value(3).toByteArray()));
+
+    QStringList strTreeItem;
+    strTreeItem << id << server << user << pass;
+    QTreeWidgetItem *treeWidgetItem = new QTreeWidgetItem(strTreeItem);
+    passTree_->addTopLevelItem(treeWidgetItem);
+  }
+}
+//----------------------------------------------------------------------------
 void OptionsDialog::applyPass()
 {
   db_.transaction();
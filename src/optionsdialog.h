@@ -42,6 +42,7 @@ public:
   explicit OptionsDialog(QWidget *parent);
   int currentIndex();
   void setCurrentItem(int index);
+  void reloadPages();
 
   // general
   QCheckBox *showSplashScreen_;
@@ -313,6 +314,7 @@ private:
 
   // browser
   void createBrowserWidget();
+  void loadWhitelist();
   void applyWhitelist();
 
   QCheckBox *c2fEnabled_;
@@ -343,8 +345,10 @@ private:
 
   // passwords
   void createPasswordsWidget();
+  void loadPasswords();
   void applyPass();
   QTreeWidget *passTree_;
+  bool loadPassOk_;
 
   // language
   void createLanguageWidget();
@@ -0,0 +1,243 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "parsebenchmark.h"
+
+#include "parseobject.h"
+#include "parseworker.h"
+#include "pipelinemetrics.h"
+#include "settings.h"
+
+#include <QtSql>
+#include <stdio.h>
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+// Same limit of parse threads as for update of feeds
+#define PARSE_THREADS_MAX 8
+
+ParseBenchmark::ParseBenchmark(const QString &corpusPath, QObject *parent)
+  : QObject(parent)
+  , corpusPath_(corpusPath)
+  , corpusSize_(0)
+  , parseObject_(0)
+  , pendingCount_(0)
+{
+  Settings settings;
+  int parseThreads = settings.value("Settings/parseThreads",
+                                    QThread::idealThreadCount()).toInt();
+  parseThreads = qBound(1, parseThreads, PARSE_THREADS_MAX);
+
+  parseObject_ = new ParseObject("benchmarkConnection", this);
+
+  qRegisterMetaType<ParsedFeedStruct>("ParsedFeedStruct");
+  qRegisterMetaType<FetchedFeed>("FetchedFeed");
+  for (int i = 0; i < parseThreads; ++i) {
+    QThread *parseThread = new QThread();
+    parseThread->setObjectName(QString("parseThread_%1").arg(i));
+    ParseWorker *parseWorker = new ParseWorker();
+    parseWorker->moveToThread(parseThread);
+    parseThread->start();
+    parseThreads_.append(parseThread);
+    parseWorkers_.append(parseWorker);
+  }
+  parseObject_->setWorkers(parseWorkers_);
+
+  connect(parseObject_, SIGNAL(signalFinishUpdate(int,bool,int,QString)),
+          this, SLOT(slotFinishUpdate(int,bool,int,QString)));
+}
+
+ParseBenchmark::~ParseBenchmark()
+{
+  foreach (QThread *parseThread, parseThreads_) {
+    parseThread->quit();
+    parseThread->wait();
+  }
+  qDeleteAll(parseWorkers_);
+  qDeleteAll(parseThreads_);
+}
+
+/** @brief Run both passes and print report
+ * @return exit code of application
+ *----------------------------------------------------------------------------*/
+int ParseBenchmark::run()
+{
+  if (!loadCorpus()) {
+    fprintf(stderr, "No feed data found in %s\n", qPrintable(corpusPath_));
+    return 1;
+  }
+  createFeeds();
+
+  int jsonCount = 0;
+  foreach (const QByteArray &data, corpus_) {
+    if (RequestFeed::isJsonFeedData(data))
+      jsonCount++;
+  }
+  printf("Corpus: %d files (%d JSON Feed), %.2f MB\n", corpus_.count(), jsonCount,
+         corpusSize_ / (1024.0 * 1024.0));
+  printf("Parse threads: %d\n", parseWorkers_.count());
+  printf("Base: %s\n", qPrintable(QSqlDatabase::database().databaseName()));
+
+  runPass("insert");
+  runPass("duplicates");
+
+  printf("Peak memory: %.1f MB\n", peakMemory() / (1024.0 * 1024.0));
+  fflush(stdout);
+  return 0;
+}
+
+/** @brief Read all files of corpus, it can be one file too
+ *----------------------------------------------------------------------------*/
+bool ParseBenchmark::loadCorpus()
+{
+  QFileInfo info(corpusPath_);
+  if (info.isDir()) {
+    QDir dir(corpusPath_);
+    foreach (const QString &fileName, dir.entryList(QDir::Files, QDir::Name))
+      fileNames_.append(dir.absoluteFilePath(fileName));
+  } else if (info.exists()) {
+    fileNames_.append(info.absoluteFilePath());
+  }
+
+  foreach (const QString &fileName, fileNames_) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+      qWarning() << "Benchmark: cannot open file" << fileName;
+      continue;
+    }
+    QByteArray data = file.readAll();
+    file.close();
+    if (data.isEmpty())
+      continue;
+    corpusSize_ += data.size();
+    corpus_.append(data);
+  }
+  return !corpus_.isEmpty();
+}
+
+void ParseBenchmark::createFeeds()
+{
+  QSqlDatabase db = QSqlDatabase::database();
+  db.transaction();
+  QSqlQuery q(db);
+  q.prepare("INSERT INTO feeds(text, title, xmlUrl, created, parentId, rowToParent) "
+            "VALUES(?, ?, ?, ?, 0, ?)");
+  for (int i = 0; i < corpus_.count(); ++i) {
+    QString name = QFileInfo(fileNames_.value(i)).fileName();
+    q.addBindValue(name);
+    q.addBindValue(name);
+    q.addBindValue(QUrl::fromLocalFile(fileNames_.value(i)).toString());
+    q.addBindValue(QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+    q.addBindValue(i);
+    q.exec();
+    feedIds_.append(q.lastInsertId().toInt());
+  }
+  db.commit();
+}
+
+/** @brief Parse whole corpus once and wait until it is stored
+ *----------------------------------------------------------------------------*/
+void ParseBenchmark::runPass(const QString &name)
+{
+  PipelineMetrics::reset();
+  int countBefore = newsCount();
+
+  QElapsedTimer timer;
+  timer.start();
+  pendingCount_ = corpus_.count();
+  for (int i = 0; i < corpus_.count(); ++i)
+    parseObject_->parseXml(corpus_.at(i), feedIds_.at(i), QDateTime(), QString());
+  if (pendingCount_ > 0)
+    loop_.exec();
+  double seconds = qMax(qint64(1), timer.elapsed()) / 1000.0;
+  qint64 lookups = 0;
+  qint64 shared = 0;
+  parseObject_->internStatistics(&lookups, &shared, true);
+
+  int inserted = newsCount() - countBefore;
+  printf("\nPass \"%s\": %.3f s\n", qPrintable(name), seconds);
+  printf("  feeds/s: %.1f, news inserted: %d, news/s: %.1f, MB/s: %.2f\n",
+         corpus_.count() / seconds, inserted, inserted / seconds,
+         corpusSize_ / (1024.0 * 1024.0) / seconds);
+  printf("  pooled fields: %lld, shared without allocation: %lld (%.1f%%)\n",
+         lookups, shared, lookups ? 100.0 * shared / lookups : 0.0);
+  printStages();
+}
+
+void ParseBenchmark::printStages()
+{
+  QList<PipelineMetrics::Stage> stages;
+  stages << PipelineMetrics::Decode << PipelineMetrics::Parse
+         << PipelineMetrics::Dedup << PipelineMetrics::Insert
+         << PipelineMetrics::Filter << PipelineMetrics::Recount
+         << PipelineMetrics::Store;
+
+  QVector<PipelineMetrics::Histogram> histograms = PipelineMetrics::histograms();
+  printf("  %-10s %8s %10s %8s %8s %8s %8s %8s\n", "stage, ms", "count", "total",
+         "avg", "p50", "p90", "p99", "max");
+  foreach (PipelineMetrics::Stage stage, stages) {
+    const PipelineMetrics::Histogram &histogram = histograms.at(stage);
+    printf("  %-10s %8lld %10lld %8lld %8lld %8lld %8lld %8lld\n",
+           qPrintable(PipelineMetrics::stageName(stage)),
+           histogram.count, histogram.sum,
+           histogram.count ? histogram.sum / histogram.count : Q_INT64_C(0),
+           histogram.percentile(0.5), histogram.percentile(0.9),
+           histogram.percentile(0.99), histogram.max);
+  }
+}
+
+void ParseBenchmark::slotFinishUpdate(int feedId, bool changed, int newCount, QString status)
+{
+  Q_UNUSED(feedId)
+  Q_UNUSED(changed)
+  Q_UNUSED(newCount)
+  Q_UNUSED(status)
+
+  if (--pendingCount_ <= 0)
+    loop_.quit();
+}
+
+int ParseBenchmark::newsCount()
+{
+  QSqlQuery q(QSqlDatabase::database());
+  q.exec("SELECT count(*) FROM news");
+  if (q.first())
+    return q.value(0).toInt();
+  return 0;
+}
+
+/** @brief Peak size of process memory, 0 if it is unknown
+ *----------------------------------------------------------------------------*/
+qint64 ParseBenchmark::peakMemory()
+{
+#if defined(Q_OS_WIN)
+  PROCESS_MEMORY_COUNTERS counters;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return counters.PeakWorkingSetSize;
+#elif defined(Q_OS_LINUX)
+  QFile file("/proc/self/status");
+  if (file.open(QIODevice::ReadOnly)) {
+    foreach (const QByteArray &line, file.readAll().split('\n')) {
+      if (line.startsWith("VmHWM:"))
+        return line.mid(6).trimmed().split(' ').value(0).toLongLong() * 1024;
+    }
+  }
+#endif
+  return 0;
+}
@@ -0,0 +1,67 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef PARSEBENCHMARK_H
+#define PARSEBENCHMARK_H
+
+#include <QEventLoop>
+#include <QObject>
+#include <QStringList>
+
+class ParseObject;
+class ParseWorker;
+
+/** @brief Replay saved feed data through parsing and storing into base
+ *
+ * Runs without network: each file of corpus is stored as data of own feed
+ * of scratch base. Second pass of the same data measures duplicates search.
+ *----------------------------------------------------------------------------*/
+class ParseBenchmark : public QObject
+{
+  Q_OBJECT
+public:
+  explicit ParseBenchmark(const QString &corpusPath, QObject *parent = 0);
+  ~ParseBenchmark();
+
+  int run();
+  static qint64 peakMemory();
+
+private slots:
+  void slotFinishUpdate(int feedId, bool changed, int newCount, QString status);
+
+private:
+  bool loadCorpus();
+  void createFeeds();
+  void runPass(const QString &name);
+  void printStages();
+  static int newsCount();
+
+  QString corpusPath_;
+  QStringList fileNames_;
+  QList<QByteArray> corpus_;
+  QList<int> feedIds_;
+  qint64 corpusSize_;
+
+  ParseObject *parseObject_;
+  QList<QThread *> parseThreads_;
+  QList<ParseWorker *> parseWorkers_;
+  int pendingCount_;
+  QEventLoop loop_;
+
+};
+
+#endif // PARSEBENCHMARK_H
@@ -21,112 +21,354 @@
 #include "database.h"
 #include "VersionNo.h"
 #include "common.h"
+#include "eventtrace.h"
+#include "feedtags.h"
+#include "logfile.h"
+#include "memoryaccounting.h"
+#include "pipelinemetrics.h"
+#include "settings.h"
 
 #include <QDebug>
+#include <qzregexp.h>
+#include <QThread>
+#include <QtEndian>
 #include <QDesktopServices>
-#include <QTextDocumentFragment>
 #if defined(Q_OS_WIN)
 #include <windows.h>
 #endif
-#include <qzregexp.h>
 
-ParseObject::ParseObject(QObject *parent)
+// Number of consecutive known news after which parsing of a feed stops
+#define PARSE_MAX_DUPLICATES 20
+// News are committed in slices to let other connections access base
+#define PARSE_BATCH_SIZE 100
+#define PARSE_BATCH_TIME 200
+// Commit time (ms) that means other connections are waiting for base
+#define PARSE_CONTENTION_TIME 20
+#define PARSE_YIELD_MAX 100
+// Maximum rows in one news insert (21 values per row, SQLite limit is 999)
+#define NEWS_INSERT_ROWS 32
+// Maximum number of news of one feed given to notification window
+#define NOTIFICATION_FEED_NEWS 100
+// Maximum number of images prefetched for one update of feed
+#define PREFETCH_FEED_IMAGES 100
+// Default size (MB) of downloaded data waiting for parse, requests are
+// paused above it and resumed when half of it is left
+#define PARSE_QUEUE_MAX_SIZE 32
+// Bands of 16 bits of simhash, news differing in less bits than bands
+// share at least one band
+#define SIMHASH_BANDS 4
+#define SIMHASH_MAX_DISTANCE 3
+// News of feed checked by filter job in one transaction
+#define FILTER_JOB_CHUNK 500
+// Pause between chunks of filter job, ms
+#define FILTER_JOB_INTERVAL 10
+// Delay of filter job while feeds are written, ms
+#define FILTER_JOB_YIELD_TIME 100
+// Digests of news keys kept in memory for all cached feeds
+#define STORED_KEYS_MAX 2000000
+// Delay before changed digests of feeds are saved to base, ms
+#define STORED_KEYS_SAVE_DELAY 30000
+
+ParseObject::ParseObject(const QString &connectionName, QObject *parent)
   : QObject(parent)
+  , insertTime_(0)
+  , feedPrefetch_(false)
+  , feedArticles_(false)
+  , feedEnclosures_(false)
   , currentFeedId_(0)
+  , parsedCount_(0)
+  , queuedBytes_(0)
+  , queueFull_(false)
+  , internLookups_(0)
+  , internShared_(0)
+  , timeShift_(0)
+  , markIdenticalNewsRead_(true)
+  , groupIdenticalNews_(false)
+  , avoidOldNews_(false)
+  , parseStopped_(false)
+  , firstNewsId_(0)
+  , userFiltersLoaded_(false)
+  , ingestMatcher_(false)
+  , filterJobsTotal_(0)
+  , filterJobsProcessed_(0)
+  , storedNewsCount_(0)
+  , storedDigestsCount_(0)
+  , currentDigests_(0)
+  , insertedCount_(0)
+  , insertedMaxId_(0)
 {
   setObjectName("parseObject_");
 
-  db_ = Database::connection("secondConnection");
+  db_ = Database::connection(connectionName);
+  queries_.setDatabase(db_);
+  parsedQueues_.resize(RequestFeed::PriorityCount);
 
+  Settings settings;
+  compressContent_ = settings.value("Settings/compressContent", false).toBool();
+  prefetchImages_ = settings.value("Settings/prefetchImages", false).toBool();
+  fetchArticles_ = settings.value("Settings/fetchArticles", false).toBool();
+  queueMaxBytes_ = qint64(qMax(1, settings.value("Settings/parseQueueMaxSize",
+                                                 PARSE_QUEUE_MAX_SIZE).toInt())) * 1024 * 1024;
+
+  // Started only when feeds are queued, zero interval lets other events
+  // be processed between feeds
   parseTimer_ = new QTimer(this);
   parseTimer_->setSingleShot(true);
-  parseTimer_->setInterval(10);
+  parseTimer_->setInterval(0);
   connect(parseTimer_, SIGNAL(timeout()), this, SLOT(getQueuedXml()),
           Qt::QueuedConnection);
 
-  connect(this, SIGNAL(signalReadyParse(QByteArray,int,QDateTime,QString)),
-          SLOT(slotParse(QByteArray,int,QDateTime,QString)));
+  connect(this, SIGNAL(signalReadyParse(ParsedFeedStruct)),
+          SLOT(slotParse(ParsedFeedStruct)));
+
+  filterJobTimer_ = new QTimer(this);
+  filterJobTimer_->setSingleShot(true);
+  connect(filterJobTimer_, SIGNAL(timeout()), this, SLOT(runFilterJob()));
+
+  saveKeysTimer_ = new QTimer(this);
+  saveKeysTimer_->setSingleShot(true);
+  saveKeysTimer_->setInterval(STORED_KEYS_SAVE_DELAY);
+  connect(saveKeysTimer_, SIGNAL(timeout()), this, SLOT(saveStoredKeys()));
 }
 
 ParseObject::~ParseObject()
 {
-
+  MemoryAccounting::remove(this);
 }
 
 void ParseObject::disconnectObjects()
 {
+  cancelUserFilters();
   disconnect(this);
+  foreach (ParseWorker *worker, workers_) {
+    worker->disconnectObjects();
+  }
+}
+
+/** @brief Set pool of workers decoding xml-data
+ *----------------------------------------------------------------------------*/
+void ParseObject::setWorkers(const QList<ParseWorker *> &workers)
+{
+  workers_ = workers;
+  workersLoad_.clear();
+  foreach (ParseWorker *worker, workers_) {
+    workersLoad_.append(0);
+    connect(worker, SIGNAL(signalDecoded(ParsedFeedStruct)),
+            this, SLOT(slotDecoded(ParsedFeedStruct)),
+            Qt::QueuedConnection);
+  }
 }
 
-/** @brief Queueing xml-data
+/** @brief Parse xml-data received from wizard or WebSub hub
  *----------------------------------------------------------------------------*/
 void ParseObject::parseXml(QByteArray data, int feedId,
-                           QDateTime dtReply, QString codecName)
+                           QDateTime dtReply, QString codecName, QString etag,
+                           int priority)
+{
+  FetchedFeedData *feed = new FetchedFeedData;
+  feed->feedId = feedId;
+  feed->data = data;
+  feed->dtReply = dtReply;
+  feed->codecName = codecName;
+  feed->etag = etag;
+  feed->priority = priority;
+  parseFeed(FetchedFeed(feed));
+}
+
+/** @brief Pass xml-data to the least loaded worker
+ *----------------------------------------------------------------------------*/
+void ParseObject::parseFeed(const FetchedFeed &feed)
+{
+  int feedId = feed->feedId;
+  if (mainApp->isSaveDataLastFeed()) {
+    QFile file(mainApp->dataDir()  + "/lastfeed.dat");
+    file.open(QIODevice::WriteOnly);
+    file.write(feed->data);
+    file.close();
+  }
+
+  if (workers_.isEmpty()) {
+    ParseWorker *worker = new ParseWorker(this);
+    setWorkers(QList<ParseWorker *>() << worker);
+  }
+
+  int index = 0;
+  for (int i = 1; i < workersLoad_.count(); ++i) {
+    if (workersLoad_.at(i) < workersLoad_.at(index))
+      index = i;
+  }
+  workersLoad_[index]++;
+  feedBytes_[feedId] += feed->data.size();
+  queuedBytes_ += feed->data.size();
+  MemoryAccounting::report(MemoryAccounting::ParseQueue, this, queuedBytes_);
+  if (!queueFull_ && (queuedBytes_ > queueMaxBytes_)) {
+    queueFull_ = true;
+    LOG_DEBUG(LogFile::Parse) << "parse queue full:" << queuedBytes_;
+    emit signalQueueFull(true);
+  }
+  decodePriority_.insert(feedId, qBound(0, feed->priority, RequestFeed::PriorityCount - 1));
+  LOG_DEBUG(LogFile::Parse) << "parseWorker <<" << feedId << "worker=" << index;
+
+  QMetaObject::invokeMethod(workers_.at(index), "decodeFeed", Qt::QueuedConnection,
+                            Q_ARG(FetchedFeed, feed));
+}
+
+/** @brief Queueing decoded xml-data
+ *----------------------------------------------------------------------------*/
+void ParseObject::slotDecoded(const ParsedFeedStruct &parsedFeed)
 {
-  idsQueue_.enqueue(feedId);
-  xmlsQueue_.enqueue(data);
-  dtReadyQueue_.enqueue(dtReply);
-  codecNameQueue_.enqueue(codecName);
-  qDebug() << "xmlsQueue_ <<" << feedId << "count=" << xmlsQueue_.count();
+  int index = workers_.indexOf(qobject_cast<ParseWorker *>(sender()));
+  if (index != -1)
+    workersLoad_[index]--;
+
+  int priority = decodePriority_.take(parsedFeed.feedId);
+  parsedQueues_[priority].enqueue(parsedFeed);
+  parsedCount_++;
+  LOG_DEBUG(LogFile::Parse) << "parsedQueue_ <<" << parsedFeed.feedId << "priority=" << priority
+                            << "count=" << parsedCount_;
+
+  if (!parseTimer_->isActive())
+    parseTimer_->start();
+}
+
+/** @brief Queue news received by sync client, they are already decoded
+ *----------------------------------------------------------------------------*/
+void ParseObject::parseSynced(const ParsedFeedStruct &parsedFeed)
+{
+  parsedQueues_[RequestFeed::PriorityImport].enqueue(parsedFeed);
+  parsedCount_++;
+  LOG_DEBUG(LogFile::Parse) << "parsedQueue_ << synced" << parsedFeed.feedId
+                            << "count=" << parsedCount_;
 
   if (!parseTimer_->isActive())
     parseTimer_->start();
 }
 
-/** @brief Process xml-data queue
+/** @brief Move feed of user-initiated update ahead of background feeds
+ *----------------------------------------------------------------------------*/
+void ParseObject::promoteFeed(int feedId)
+{
+  QHash<int, int>::iterator it = decodePriority_.find(feedId);
+  if (it != decodePriority_.end()) {
+    it.value() = RequestFeed::PriorityInteractive;
+    return;
+  }
+
+  for (int priority = RequestFeed::PriorityInteractive + 1;
+       priority < parsedQueues_.count(); ++priority) {
+    QQueue<ParsedFeedStruct> &queue = parsedQueues_[priority];
+    for (int i = 0; i < queue.count(); ++i) {
+      if (queue.at(i).feedId == feedId) {
+        parsedQueues_[RequestFeed::PriorityInteractive].enqueue(queue.takeAt(i));
+        LOG_DEBUG(LogFile::Parse) << "parsedQueue_ promoted" << feedId;
+        return;
+      }
+    }
+  }
+}
+
+/** @brief Process decoded xml-data queue
+ *
+ * Queue of higher update class is emptied first, so feed updated by user
+ * is written before feeds of background update decoded earlier.
  *----------------------------------------------------------------------------*/
 void ParseObject::getQueuedXml()
 {
+  PipelineMetrics::recordWakeup(PipelineMetrics::WakeParseQueue,
+                                currentFeedId_ || !parsedCount_);
   if (currentFeedId_) return;
 
-  if (idsQueue_.count()) {
-    currentFeedId_ = idsQueue_.dequeue();
-    QByteArray currentXml_ = xmlsQueue_.dequeue();
-    QDateTime currentDtReady_ = dtReadyQueue_.dequeue();
-    QString currentCodecName_ = codecNameQueue_.dequeue();
-    qDebug() << "xmlsQueue_ >>" << currentFeedId_ << "count=" << xmlsQueue_.count();
+  int priority = 0;
+  while ((priority < parsedQueues_.count()) && parsedQueues_.at(priority).isEmpty())
+    priority++;
 
-    emit signalReadyParse(currentXml_, currentFeedId_, currentDtReady_, currentCodecName_);
+  if (priority < parsedQueues_.count()) {
+    ParsedFeedStruct parsedFeed = parsedQueues_[priority].dequeue();
+    parsedCount_--;
+    currentFeedId_ = parsedFeed.feedId;
+    LOG_DEBUG(LogFile::Parse) << "parsedQueue_ >>" << currentFeedId_ << "count=" << parsedCount_;
+
+    emit signalReadyParse(parsedFeed);
+
+    queuedBytes_ -= feedBytes_.take(parsedFeed.feedId);
+    MemoryAccounting::report(MemoryAccounting::ParseQueue, this, queuedBytes_);
+    if (queueFull_ && (queuedBytes_ <= queueMaxBytes_ / 2)) {
+      queueFull_ = false;
+      LOG_DEBUG(LogFile::Parse) << "parse queue resumed:" << queuedBytes_;
+      emit signalQueueFull(false);
+    }
 
     currentFeedId_ = 0;
-    parseTimer_->start();
+    if (parsedCount_)
+      parseTimer_->start();
   }
 }
 
-/** @brief Parse xml-data
+/** @brief Write parsed feed into base
  *----------------------------------------------------------------------------*/
-void ParseObject::slotParse(const QByteArray &xmlData, const int &feedId,
-                            const QDateTime &dtReply, const QString &codecName)
+void ParseObject::slotParse(const ParsedFeedStruct &parsedFeed)
 {
-  if (mainApp->isSaveDataLastFeed()) {
-    QFile file(mainApp->dataDir()  + "/lastfeed.dat");
-    file.open(QIODevice::WriteOnly);
-    file.write(xmlData);
-    file.close();
-  }
-
-  qDebug() << "=================== parseXml:start ============================";
+  LOG_DEBUG(LogFile::Parse) << "=================== parseXml:start ============================";
 
+  QElapsedTimer storeTimer;
+  storeTimer.start();
+  qint64 traceStart = EventTrace::now();
   db_.transaction();
+  batchCount_ = 0;
+  batchTimer_.start();
+  insertTime_ = 0;
+
+  // Local time zone shift for dates without zone
+  QDateTime dtLocalTime = QDateTime::currentDateTime();
+  QDateTime dtUTC = QDateTime(dtLocalTime.date(), dtLocalTime.time(), Qt::UTC);
+  timeShift_ = dtLocalTime.secsTo(dtUTC);
 
   // extract feed id, duplicate news mode and date to avoid from feed table
-  parseFeedId_ = feedId;
+  parseFeedId_ = parsedFeed.feedId;
   QString feedUrl;
   duplicateNewsMode_ = false;
   addSingleNewsAnyDate_ = false;
   avoidedOldSingleNews_ = false;
   avoidedOldSingleNewsDate_ = QDate::currentDate();
-  QSqlQuery q(db_);
-  q.setForwardOnly(true);
-  q.exec(QString("SELECT duplicateNewsMode, xmlUrl, addSingleNewsAnyDateOn, avoidedOldSingleNewsDateOn, avoidedOldSingleNewsDate"
-                 " FROM feeds WHERE id=='%1'").arg(parseFeedId_));
+  feedPrefetch_ = false;
+  feedArticles_ = false;
+  feedEnclosures_ = false;
+  readNewsOptions();
+  QSqlQuery q = queries_.query("SELECT duplicateNewsMode, xmlUrl, addSingleNewsAnyDateOn, "
+                               "avoidedOldSingleNewsDateOn, avoidedOldSingleNewsDate, "
+                               "displayEmbeddedImages, loadTypes, displayNews, downloadEnclosures "
+                               "FROM feeds WHERE id=?");
+  q.addBindValue(parseFeedId_);
+  q.exec();
   if (q.first()) {
     duplicateNewsMode_ = q.value(0).toBool();
     feedUrl = q.value(1).toString();
     addSingleNewsAnyDate_ = q.value(2).toBool();
     avoidedOldSingleNews_ = q.value(3).toBool();
     avoidedOldSingleNewsDate_ = q.value(4).toDate();
+    if (prefetchImages_) {
+      // Images are prefetched only if browser would show them
+      int displayEmbeddedImages = q.value(5).toInt();
+      QString loadTypes = q.value(6).toString();
+      if (displayEmbeddedImages == 1) {
+        feedPrefetch_ = Settings::snapshot()->autoLoadImages;
+      } else {
+        feedPrefetch_ = (displayEmbeddedImages == 2);
+      }
+      if (!loadTypes.isEmpty() && !loadTypes.contains("images"))
+        feedPrefetch_ = false;
+    }
+    if (fetchArticles_) {
+      // Articles are needed only for feeds showing page of news link
+      if (q.value(7).toString().isEmpty()) {
+        feedArticles_ = !Settings::snapshot()->showDescriptionNews;
+      } else {
+        feedArticles_ = q.value(7).toInt();
+      }
+    }
+    feedEnclosures_ = q.value(8).toInt();
   }
+  q.finish();
 
   // id not found (ex. feed deleted while updating)
   if (feedUrl.isEmpty()) {
@@ -136,139 +378,698 @@ void ParseObject::slotParse(const QByteArray &xmlData, const int &feedId,
     return;
   }
 
-  qDebug() << QString("Feed '%1' found with id = %2").arg(feedUrl).arg(parseFeedId_);
+  LOG_DEBUG(LogFile::Parse) << QString("Feed '%1' found with id = %2").arg(feedUrl).arg(parseFeedId_);
 
   // actually parsing
   feedChanged_ = false;
 
-  bool codecOk = false;
-  QString convertData(xmlData);
-  QString feedType;
-  QDomDocument doc;
-  QString errorStr;
-  int errorLine;
-  int errorColumn;
-
-  QzRegExp rx("encoding=\"([^\"]+)", Qt::CaseInsensitive);
-  int pos = rx.indexIn(xmlData);
-  if (pos == -1) {
-    rx.setPattern("encoding='([^']+)");
-    pos = rx.indexIn(xmlData);
-  }
-  if (pos > -1) {
-    QString codecNameT = rx.cap(1);
-    qDebug() << "Codec name (1):" << codecNameT;
-    QTextCodec *codec = QTextCodec::codecForName(codecNameT.toUtf8());
-    if (codec) {
-      convertData = codec->toUnicode(xmlData);
-    } else {
-      qWarning() << "Codec not found (1): " << codecNameT << feedUrl;
-      if (codecNameT.contains("us-ascii", Qt::CaseInsensitive)) {
-        QString str(xmlData);
-        convertData = str.remove(rx.cap(0)+"\"");
-      }
+  if (!parsedFeed.feedType.isEmpty()) {
+    QElapsedTimer dedupTimer;
+    dedupTimer.start();
+    loadStoredNews();
+
+    duplicateCount_ = 0;
+    lastPublished_.clear();
+    newestFirst_ = true;
+    oldestPublished_.clear();
+    parseStopped_ = false;
+    firstNewsId_ = 0;
+    prepareIngestFilters();
+
+    if (parsedFeed.feedType == "feed") {
+      parseAtom(feedUrl, parsedFeed);
+    } else if ((parsedFeed.feedType == "rss") || (parsedFeed.feedType == "rdf:RDF")) {
+      parseRss(feedUrl, parsedFeed);
+    } else if (parsedFeed.feedType == "json") {
+      parseJson(feedUrl, parsedFeed);
+    } else if (parsedFeed.feedType == "sync") {
+      parseSyncItems(feedUrl, parsedFeed);
     }
-  } else {
-    if (!codecName.isEmpty()) {
-      qDebug() << "Codec name (2):" << codecName;
-      QTextCodec *codec = QTextCodec::codecForName(codecName.toUtf8());
-      if (codec) {
-        convertData = codec->toUnicode(xmlData);
-        codecOk = true;
+
+    insertPendingNews();
+    if (parsedFeed.feedType == "sync")
+      applySyncState();
+    else
+      saveFeedHorizon();
+    finishStoredNews();
+    // Inserts of batches are done while items are walked
+    PipelineMetrics::record(PipelineMetrics::Dedup, dedupTimer.elapsed() - insertTime_, parseFeedId_);
+    PipelineMetrics::record(PipelineMetrics::Insert, insertTime_, parseFeedId_);
+  }
+
+  // Items after first chunk are read while feed is parsed
+  QString error = parsedFeed.itemReader ? parsedFeed.itemReader->error() : parsedFeed.error;
+  if (!error.isEmpty()) {
+    qWarning() << QString("Parse data error (2): url %1, id %2, %3").
+                  arg(feedUrl).arg(parseFeedId_).arg(error);
+  }
+
+  // Set feed update time, receive data from server time and entity tag
+  QString updated = QLocale::c().toString(QDateTime::currentDateTimeUtc(),
+                                          "yyyy-MM-ddTHH:mm:ss");
+  QString lastBuildDate = parsedFeed.dtReply.toString(Qt::ISODate);
+  // News of sync server do not change state of requests of feed itself
+  if (parsedFeed.feedType != "sync") {
+    q = queries_.query("UPDATE feeds SET updated=?, lastBuildDate=?, etag=?, status=0 WHERE id=?");
+    q.addBindValue(updated);
+    q.addBindValue(lastBuildDate);
+    q.addBindValue(parsedFeed.etag);
+    q.addBindValue(parseFeedId_);
+    q.exec();
+  }
+
+  int newCount = 0;
+  NotificationFeedStruct notification;
+  notification.feedId = 0;
+  if (feedChanged_) {
+    // Filters are applied only to news inserted by this update
+    QElapsedTimer timer;
+    timer.start();
+    if (ingestMatcher_)
+      applyIngestFilters();
+    else
+      applyUserFilters(parseFeedId_, -1, firstNewsId_);
+    PipelineMetrics::record(PipelineMetrics::Filter, timer.restart(), parseFeedId_);
+    newCount = recountFeedCounts(parseFeedId_, feedUrl, updated, lastBuildDate);
+    PipelineMetrics::record(PipelineMetrics::Recount, timer.elapsed(), parseFeedId_);
+
+    if ((newCount > 0) && Settings::snapshot()->showNotifyOn)
+      notification = loadNotification(parseFeedId_, newCount);
+  }
+
+  q.finish();
+  db_.commit();
+  PipelineMetrics::record(PipelineMetrics::Store, storeTimer.elapsed(), parseFeedId_);
+  EventTrace::complete(EventTrace::Store, parseFeedId_, traceStart);
+
+  if (!prefetchUrls_.isEmpty()) {
+    emit signalPrefetchImages(prefetchUrls_);
+    prefetchUrls_.clear();
+  }
+  for (int i = 0; i < articleLinks_.count(); ++i)
+    emit signalFetchArticle(articleLinks_.at(i).first, articleLinks_.at(i).second);
+  articleLinks_.clear();
+  foreach (const NewsItemStruct &newsItem, enclosureNews_) {
+    emit signalDownloadEnclosure(parseFeedId_, newsItem.eUrl, newsItem.eType,
+                                 newsItem.eLength.toLongLong());
+  }
+  enclosureNews_.clear();
+  internPool_.clear();
+  plainTextPool_.clear();
+  if (notification.feedId)
+    emit signalNotificationData(notification);
+
+  emit signalFinishUpdate(parseFeedId_, feedChanged_, newCount, "0");
+  LOG_DEBUG(LogFile::Parse) << "=================== parseXml:finish ===========================";
+}
+
+/** @brief Get digests of keys of feed news stored in base to search duplicates
+ *
+ * Digests cached in memory or saved in base are used while number of news
+ * and last news id of feed are unchanged. Otherwise they are built from
+ * news table.
+ *----------------------------------------------------------------------------*/
+void ParseObject::loadStoredNews()
+{
+  clearStoredNews();
+
+  int newsCount = 0;
+  qlonglong maxNewsId = 0;
+  QSqlQuery q = queries_.query("SELECT count(id), max(id) FROM news WHERE feedId=?");
+  q.addBindValue(parseFeedId_);
+  if (q.exec() && q.first()) {
+    newsCount = q.value(0).toInt();
+    maxNewsId = q.value(1).toLongLong();
+  }
+  q.finish();
+
+  QHash<int, StoredKeysStruct>::iterator it = storedKeys_.find(parseFeedId_);
+  storedKeysOrder_.removeAll(parseFeedId_);
+  if ((it != storedKeys_.end()) &&
+      ((it->newsCount != newsCount) || (it->maxNewsId != maxNewsId))) {
+    storedDigestsCount_ -= it->digests.count();
+    storedKeys_.erase(it);
+    it = storedKeys_.end();
+  }
+
+  if (it == storedKeys_.end()) {
+    StoredKeysStruct keys;
+    keys.newsCount = newsCount;
+    keys.maxNewsId = maxNewsId;
+    keys.dirty = false;
+    // Feed without news may still have tombstones
+    if (!readSavedKeys(&keys)) {
+      // News moved to archive are still known as duplicates.
+      // Rows of all news of feed are read by typed columns, without QVariant
+      SQLiteStatement *statement;
+      if (Database::archiveAttached()) {
+        statement = queries_.statement("SELECT guid, title, published, link_href FROM news WHERE feedId=? "
+                                       "UNION ALL SELECT guid, title, published, link_href "
+                                       "FROM archive.news WHERE feedId=?");
+        statement->bind(2, parseFeedId_);
       } else {
-        qWarning() << "Codec not found (2): " << codecName << feedUrl;
+        statement = queries_.statement("SELECT guid, title, published, link_href FROM news WHERE feedId=?");
       }
-    }
-    if (!codecOk) {
-      codecOk = false;
-      QStringList codecNameList;
-      codecNameList << "UTF-8" << "Windows-1251" << "KOI8-R" << "KOI8-U"
-                    << "ISO 8859-5" << "IBM 866";
-      foreach (QString codecNameT, codecNameList) {
-        QTextCodec *codec = QTextCodec::codecForName(codecNameT.toUtf8());
-        if (codec && codec->canEncode(xmlData)) {
-          qDebug() << "Codec name (3):" << codecNameT;
-          convertData = codec->toUnicode(xmlData);
-          codecOk = true;
-          break;
-        }
+      statement->bind(1, parseFeedId_);
+      keys.digests.reserve(newsCount * KeyPublishedTitle);
+      while (statement->next()) {
+        addNewsKeys(&keys.digests, statement->stringValue(0), statement->stringValue(1),
+                    statement->stringValue(2), statement->stringValue(3));
       }
-      if (!codecOk) {
-        convertData = QString::fromLocal8Bit(xmlData);
+      statement = queries_.statement("SELECT digests FROM newsTombstones WHERE feedId=?");
+      statement->bind(1, parseFeedId_);
+      while (statement->next()) {
+        readDigests(statement->blobView(0), &keys.digests);
       }
+      keys.dirty = true;
+      LOG_DEBUG(LogFile::Parse) << "News keys built:" << parseFeedId_ << newsCount;
     }
+    storedDigestsCount_ += keys.digests.count();
+    it = storedKeys_.insert(parseFeedId_, keys);
   }
+  storedKeysOrder_.append(parseFeedId_);
 
-  if (!doc.setContent(convertData, false, &errorStr, &errorLine, &errorColumn)) {
-    qWarning() << QString("Parse data error (2): url %1, id %2, line %3, column %4: %5").
-                  arg(feedUrl).arg(parseFeedId_).
-                  arg(errorLine).arg(errorColumn).arg(errorStr);
-  } else {
-    QDomElement rootElem = doc.documentElement();
-    feedType = rootElem.tagName();
-    qDebug() << "Feed type: " << feedType;
+  storedNewsCount_ = newsCount;
+  currentDigests_ = &it->digests;
+}
+
+/** @brief Read digests of feed saved in base
+ * @return false if they are not saved or feed has changed since
+ *----------------------------------------------------------------------------*/
+bool ParseObject::readSavedKeys(StoredKeysStruct *keys)
+{
+  QSqlQuery q = queries_.query("SELECT newsCount, maxNewsId, digests FROM newsKeys WHERE feedId=?");
+  q.addBindValue(parseFeedId_);
+  q.exec();
+  bool valid = q.first() && (q.value(0).toInt() == keys->newsCount) &&
+      (q.value(1).toLongLong() == keys->maxNewsId);
+  if (valid)
+    readDigests(q.value(2).toByteArray(), &keys->digests);
+  q.finish();
+  return valid;
+}
+
+/** @brief Save changed digests of cached feeds to base
+ *----------------------------------------------------------------------------*/
+void ParseObject::saveStoredKeys()
+{
+  db_.transaction();
+  writeStoredKeys();
+  db_.commit();
+}
 
-    q.exec(QString("SELECT id, guid, title, published, link_href FROM news WHERE feedId='%1'").
-           arg(parseFeedId_));
-    if (q.lastError().isValid()) {
+void ParseObject::writeStoredKeys()
+{
+  QHash<int, StoredKeysStruct>::iterator it = storedKeys_.begin();
+  for (; it != storedKeys_.end(); ++it) {
+    if (!it->dirty) continue;
+
+    QByteArray data = digestsData(it->digests);
+
+    QSqlQuery q = queries_.query("INSERT OR REPLACE INTO newsKeys(feedId, newsCount, maxNewsId, digests) "
+                                 "VALUES(?, ?, ?, ?)");
+    q.addBindValue(it.key());
+    q.addBindValue(it->newsCount);
+    q.addBindValue(it->maxNewsId);
+    q.addBindValue(data);
+    if (!q.exec()) {
       qWarning() << __PRETTY_FUNCTION__ << __LINE__
                  << "q.lastError(): " << q.lastError().text();
     }
-    else {
-      while (q.next()) {
-        QString str = q.value(2).toString();
-        titleList_.append(str);
-
-        str = q.value(1).toString();
-        guidList_.append(str);
-
-        str = q.value(3).toString();
-        publishedList_.append(str);
-        str = q.value(4).toString();
-        linkList_.append(str);
+    q.finish();
+    it->dirty = false;
+  }
+}
+
+/** @brief Drop digests of least recently parsed feeds over memory limit
+ *----------------------------------------------------------------------------*/
+void ParseObject::evictStoredKeys()
+{
+  if (storedDigestsCount_ <= STORED_KEYS_MAX) return;
+
+  // Changed digests are saved before they are dropped, in transaction of parse
+  writeStoredKeys();
+
+  while ((storedDigestsCount_ > STORED_KEYS_MAX) && (storedKeysOrder_.count() > 1)) {
+    int feedId = storedKeysOrder_.takeFirst();
+    QHash<int, StoredKeysStruct>::iterator it = storedKeys_.find(feedId);
+    storedDigestsCount_ -= it->digests.count();
+    storedKeys_.erase(it);
+  }
+}
+
+/** @brief Add digests of inserted news to cached digests of feed
+ *----------------------------------------------------------------------------*/
+void ParseObject::finishStoredNews()
+{
+  QHash<int, StoredKeysStruct>::iterator it = storedKeys_.find(parseFeedId_);
+  bool cached = (it != storedKeys_.end());
+  if (cached && insertedCount_) {
+    int count = it->digests.count();
+    it->digests.unite(insertedDigests_);
+    storedDigestsCount_ += it->digests.count() - count;
+    it->newsCount += insertedCount_;
+    it->maxNewsId = qMax(it->maxNewsId, insertedMaxId_);
+    it->dirty = true;
+  }
+  clearStoredNews();
+
+  evictStoredKeys();
+  if (!saveKeysTimer_->isActive() && cached)
+    saveKeysTimer_->start();
+}
+
+/** @brief Add digests of keys of one news, the same keys as are checked
+ *   for duplicates
+ *----------------------------------------------------------------------------*/
+void ParseObject::addNewsKeys(QSet<qint64> *digests, const QString &guid, const QString &title,
+                              const QString &published, const QString &link)
+{
+  digests->insert(Common::keyDigest(KeyGuid, guid));
+  digests->insert(Common::keyDigest(KeyLink, link));
+  digests->insert(Common::keyDigest(KeyTitle, title));
+  digests->insert(Common::keyDigest(KeyPublished, published));
+  digests->insert(Common::keyDigest(KeyGuidPublished, guid, published));
+  digests->insert(Common::keyDigest(KeyGuidTitle, guid, title));
+  digests->insert(Common::keyDigest(KeyLinkPublished, link, published));
+  digests->insert(Common::keyDigest(KeyLinkTitle, link, title));
+  digests->insert(Common::keyDigest(KeyPublishedTitle, published, title));
+}
+
+/** @brief Digests as big-endian 64-bit values, as they are saved in base
+ *----------------------------------------------------------------------------*/
+QByteArray ParseObject::digestsData(const QSet<qint64> &digests)
+{
+  QByteArray data(digests.count() * int(sizeof(qint64)), Qt::Uninitialized);
+  uchar *digest = reinterpret_cast<uchar *>(data.data());
+  foreach (qint64 value, digests) {
+    qToBigEndian(value, digest);
+    digest += sizeof(qint64);
+  }
+  return data;
+}
+
+void ParseObject::readDigests(const QByteArray &data, QSet<qint64> *digests)
+{
+  const uchar *digest = reinterpret_cast<const uchar *>(data.constData());
+  int count = data.size() / int(sizeof(qint64));
+  digests->reserve(digests->count() + count);
+  for (int i = 0; i < count; ++i, digest += sizeof(qint64))
+    digests->insert(qFromBigEndian<qint64>(digest));
+}
+
+bool ParseObject::hasKey(int kind, const QString &key1, const QString &key2) const
+{
+  return currentDigests_ && currentDigests_->contains(Common::keyDigest(kind, key1, key2));
+}
+
+/** @brief Commit inserted news in slices
+ *
+ * Transaction is committed after PARSE_BATCH_SIZE news or PARSE_BATCH_TIME ms.
+ * If commit had to wait for the lock, the thread yields for the same time so
+ * that the waiting connections can run.
+ *----------------------------------------------------------------------------*/
+void ParseObject::commitBatch()
+{
+  batchCount_++;
+  if ((batchCount_ < PARSE_BATCH_SIZE) && (batchTimer_.elapsed() < PARSE_BATCH_TIME))
+    return;
+
+  insertPendingNews();
+
+  QElapsedTimer commitTimer;
+  commitTimer.start();
+  db_.commit();
+  qint64 commitTime = commitTimer.elapsed();
+  insertTime_ += commitTime;
+
+  if (commitTime >= PARSE_CONTENTION_TIME)
+    Common::sleep(int(qMin(commitTime, qint64(PARSE_YIELD_MAX))));
+  else
+    QThread::yieldCurrentThread();
+
+  db_.transaction();
+  batchCount_ = 0;
+  batchTimer_.start();
+}
+
+void ParseObject::clearStoredNews()
+{
+  storedNewsCount_ = 0;
+  currentDigests_ = 0;
+  insertedDigests_.clear();
+  insertedCount_ = 0;
+  insertedMaxId_ = 0;
+}
+
+/** @brief Read options of news adding for current parse
+ *
+ * Options are taken from snapshot, so main window is not read from parse
+ * thread and headless daemon gets the same options.
+ *----------------------------------------------------------------------------*/
+void ParseObject::readNewsOptions()
+{
+  QSharedPointer<const SettingsSnapshot> options = Settings::snapshot();
+  markIdenticalNewsRead_ = options->markIdenticalNewsRead;
+  groupIdenticalNews_ = (options->newsLayout == 2);
+  avoidOldNews_ = options->avoidOldNews;
+  avoidedOldNewsDate_ = options->avoidedOldNewsDate;
+}
+
+/** @brief Queue new news for batched insert into base
+ *----------------------------------------------------------------------------*/
+void ParseObject::addPendingNews(const NewsItemStruct &newsItem)
+{
+  PendingNewsStruct pending;
+  pending.read = false;
+  pending.clusterId = 0;
+  if (markIdenticalNewsRead_ || groupIdenticalNews_) {
+    pending.clusterId = findIdenticalNews(newsItem);
+    pending.read = markIdenticalNewsRead_ && pending.clusterId;
+  }
+
+  pending.news = newsItem;
+  if (pending.news.updated.isEmpty())
+    pending.news.updated = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+  pending.received = QDateTime::currentDateTime().toString(Qt::ISODate);
+  pendingNews_.append(pending);
+  feedChanged_ = true;
+}
+
+static inline qint64 simhashBand(qint64 simhash, int band)
+{
+  return (qint64(band) << 16) | ((quint64(simhash) >> (16 * band)) & 0xFFFF);
+}
+
+/** @brief Find the same or nearly the same news in other feed
+ *
+ * News are found by hash of normalized title and by bands of simhash
+ * of description, so all lookups use indexes.
+ * @return id of first news of story, 0 if not found
+ *----------------------------------------------------------------------------*/
+qlonglong ParseObject::findIdenticalNews(const NewsItemStruct &newsItem)
+{
+  QSqlQuery q;
+  qlonglong clusterId = 0;
+  if (newsItem.titleHash) {
+    q = queries_.query("SELECT ifnull(clusterId, id) FROM news WHERE titleHash=? AND feedId!=? LIMIT 1");
+    q.addBindValue(newsItem.titleHash);
+    q.addBindValue(parseFeedId_);
+    q.exec();
+    if (q.first()) clusterId = q.value(0).toLongLong();
+    q.finish();
+    if (clusterId) return clusterId;
+  }
+
+  // News stored before titles were hashed
+  q = queries_.query("SELECT ifnull(clusterId, id) FROM news "
+                     "WHERE lower(title)=lower(?) AND feedId!=? LIMIT 1");
+  q.addBindValue(newsItem.title);
+  q.addBindValue(parseFeedId_);
+  q.exec();
+  if (q.first()) clusterId = q.value(0).toLongLong();
+  q.finish();
+  if (clusterId || !newsItem.simhash) return clusterId;
+
+  q = queries_.query("SELECT news.simhash, ifnull(news.clusterId, news.id) FROM newsFingerprints "
+                     "JOIN news ON news.id=newsFingerprints.newsId "
+                     "WHERE newsFingerprints.fingerprint IN (?, ?, ?, ?) AND news.feedId!=?");
+  for (int band = 0; band < SIMHASH_BANDS; ++band)
+    q.addBindValue(simhashBand(newsItem.simhash, band));
+  q.addBindValue(parseFeedId_);
+  q.exec();
+  while (!clusterId && q.next()) {
+    if (Common::hammingDistance(q.value(0).toLongLong(), newsItem.simhash) <= SIMHASH_MAX_DISTANCE)
+      clusterId = q.value(1).toLongLong();
+  }
+  q.finish();
+  return clusterId;
+}
+
+/** @brief Insert queued news with multi-row statements
+ *
+ * Rows are written in chunks of power of two size, so only a few
+ * statements are prepared and cached.
+ *----------------------------------------------------------------------------*/
+void ParseObject::insertPendingNews()
+{
+  QElapsedTimer insertTimer;
+  insertTimer.start();
+  int pos = 0;
+  while (pos < pendingNews_.count()) {
+    int rows = NEWS_INSERT_ROWS;
+    while (rows > pendingNews_.count() - pos)
+      rows /= 2;
+
+    QString qStr("INSERT INTO news("
+                 "feedId, guid, title, author_name, "
+                 "author_uri, author_email, published, received, "
+                 "link_href, link_alternate, category, comments, "
+                 "enclosure_url, enclosure_type, enclosure_length, new, read, snippet, "
+                 "titleHash, simhash, clusterId) "
+                 "VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+    for (int i = 1; i < rows; ++i) {
+      qStr.append(", (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+    }
+    QSqlQuery q = queries_.query(qStr);
+    for (int i = pos; i < pos + rows; ++i) {
+      const PendingNewsStruct &pending = pendingNews_.at(i);
+      const NewsItemStruct &newsItem = pending.news;
+      q.addBindValue(parseFeedId_);
+      q.addBindValue(newsItem.id);
+      q.addBindValue(newsItem.title);
+      q.addBindValue(newsItem.author);
+      q.addBindValue(newsItem.authorUri);
+      q.addBindValue(newsItem.authorEmail);
+      q.addBindValue(newsItem.updated);
+      q.addBindValue(pending.received);
+      q.addBindValue(newsItem.link);
+      q.addBindValue(newsItem.linkAlternate);
+      q.addBindValue(newsItem.category);
+      q.addBindValue(newsItem.comments);
+      q.addBindValue(newsItem.eUrl);
+      q.addBindValue(newsItem.eType);
+      q.addBindValue(newsItem.eLength);
+      q.addBindValue(pending.read ? 0 : 1);
+      q.addBindValue(pending.read ? 2 : 0);
+      q.addBindValue(newsItem.snippet);
+      q.addBindValue(newsItem.titleHash ? QVariant(newsItem.titleHash) : QVariant());
+      q.addBindValue(newsItem.simhash ? QVariant(newsItem.simhash) : QVariant());
+      q.addBindValue(pending.clusterId ? QVariant(pending.clusterId) : QVariant());
+    }
+    if (!q.exec()) {
+      qWarning() << __PRETTY_FUNCTION__ << __LINE__
+                 << "q.lastError(): " << q.lastError().text();
+      q.finish();
+      pos += rows;
+      continue;
+    }
+    // Rows of one insert get consecutive ids
+    qlonglong newsId = q.lastInsertId().toLongLong() - rows + 1;
+    const qlonglong firstRowId = newsId;
+    q.finish();
+    if (!firstNewsId_)
+      firstNewsId_ = newsId;
+
+    for (int i = pos; i < pos + rows; ++i) {
+      const NewsItemStruct &newsItem = pendingNews_.at(i).news;
+      addNewsKeys(&insertedDigests_, newsItem.id, newsItem.title,
+                  newsItem.updated, newsItem.link);
+    }
+    insertedCount_ += rows;
+    insertedMaxId_ = qMax(insertedMaxId_, newsId + rows - 1);
+
+    // Bodies are compressed by SQLite function of SQLiteDriver
+    QString values = compressContent_ ? "(?, compress(?), compress(?))" : "(?, ?, ?)";
+    qStr = "INSERT INTO newsContent(newsId, description, content) VALUES" + values;
+    for (int i = 1; i < rows; ++i) {
+      qStr.append(", " + values);
+    }
+    q = queries_.query(qStr);
+    for (int i = pos; i < pos + rows; ++i, ++newsId) {
+      const NewsItemStruct &newsItem = pendingNews_.at(i).news;
+      q.addBindValue(newsId);
+      q.addBindValue(newsItem.description);
+      q.addBindValue(newsItem.content);
+      if (!ingestFilters_.isEmpty())
+        matchIngestFilters(newsId, pendingNews_.at(i));
+      if (pendingNews_.at(i).read)
+        continue;
+      if (feedPrefetch_)
+        collectImages(newsItem);
+      if (feedArticles_) {
+        QString link = newsItem.link.isEmpty() ? newsItem.linkAlternate : newsItem.link;
+        if (!link.isEmpty())
+          articleLinks_.append(qMakePair(int(newsId), link));
       }
+      if (feedEnclosures_ && !newsItem.eUrl.isEmpty())
+        enclosureNews_.append(newsItem);
+    }
+    if (!q.exec()) {
+      qWarning() << __PRETTY_FUNCTION__ << __LINE__
+                 << "q.lastError(): " << q.lastError().text();
     }
     q.finish();
 
-    if (feedType == "feed") {
-      parseAtom(feedUrl, doc);
-    } else if ((feedType == "rss") || (feedType == "rdf:RDF")) {
-      parseRss(feedUrl, doc);
+    // Size is kept on first news of story, so list shows it without count query
+    q = queries_.query("UPDATE news SET clusterSize=clusterSize+1 WHERE id=?");
+    for (int i = pos; i < pos + rows; ++i) {
+      if (!pendingNews_.at(i).clusterId) continue;
+      q.addBindValue(pendingNews_.at(i).clusterId);
+      q.exec();
     }
+    q.finish();
 
-    guidList_.clear();
-    titleList_.clear();
-    publishedList_.clear();
-    linkList_.clear();
+    // Bands of simhash are needed only to find identical news
+    if (markIdenticalNewsRead_ || groupIdenticalNews_) {
+      q = queries_.query("INSERT OR IGNORE INTO newsFingerprints(fingerprint, newsId) "
+                         "VALUES(?, ?)");
+      for (int i = pos; i < pos + rows; ++i) {
+        qint64 simhash = pendingNews_.at(i).news.simhash;
+        if (!simhash) continue;
+        for (int band = 0; band < SIMHASH_BANDS; ++band) {
+          q.addBindValue(simhashBand(simhash, band));
+          q.addBindValue(firstRowId + i - pos);
+          q.exec();
+        }
+      }
+      q.finish();
+    }
+    pos += rows;
   }
 
-  // Set feed update time and receive data from server time
-  QString updated = QLocale::c().toString(QDateTime::currentDateTimeUtc(),
-                                          "yyyy-MM-ddTHH:mm:ss");
-  QString lastBuildDate = dtReply.toString(Qt::ISODate);
-  q.prepare("UPDATE feeds SET updated=?, lastBuildDate=?, status=0 WHERE id=?");
-  q.addBindValue(updated);
-  q.addBindValue(lastBuildDate);
-  q.addBindValue(parseFeedId_);
-  q.exec();
+  if (!pendingNews_.isEmpty())
+    LOG_DEBUG(LogFile::Parse) << "Inserted news:" << parseFeedId_ << pendingNews_.count();
+  pendingNews_.clear();
+  insertTime_ += insertTimer.elapsed();
+}
 
-  int newCount = 0;
-  if (feedChanged_) {
-    runUserFilter(parseFeedId_);
-    newCount = recountFeedCounts(parseFeedId_, feedUrl, updated, lastBuildDate);
+/** @brief Add images of unread news to list of prefetch
+ *----------------------------------------------------------------------------*/
+void ParseObject::collectImages(const NewsItemStruct &newsItem)
+{
+  QzRegExp rx("<img[^>]+src\\s*=\\s*['\"]([^'\"]+)['\"]", Qt::CaseInsensitive);
+  QUrl baseUrl(newsItem.link);
+  QStringList texts;
+  texts << newsItem.description << newsItem.content;
+  foreach (const QString &text, texts) {
+    int pos = 0;
+    while ((prefetchUrls_.count() < PREFETCH_FEED_IMAGES) &&
+           ((pos = rx.indexIn(text, pos)) != -1)) {
+      pos += rx.matchedLength();
+      QString src = rx.cap(1).trimmed();
+      if (src.startsWith("data:", Qt::CaseInsensitive))
+        continue;
+      QUrl url = baseUrl.resolved(QUrl(src));
+      if (!url.scheme().startsWith("http"))
+        continue;
+      QString urlString = url.toString();
+      if (!prefetchUrls_.contains(urlString))
+        prefetchUrls_.append(urlString);
+    }
   }
+}
 
+/** @brief Store article extracted from page of news link
+ *----------------------------------------------------------------------------*/
+void ParseObject::saveArticle(int newsId, const QString &html)
+{
+  QSqlQuery q = queries_.query(compressContent_ ?
+                                 "UPDATE newsContent SET article=compress(?) WHERE newsId=?" :
+                                 "UPDATE newsContent SET article=? WHERE newsId=?");
+  q.addBindValue(html);
+  q.addBindValue(newsId);
+  if (!q.exec()) {
+    qWarning() << __PRETTY_FUNCTION__ << __LINE__
+               << "q.lastError(): " << q.lastError().text();
+  }
   q.finish();
-  db_.commit();
+}
 
-  emit signalFinishUpdate(parseFeedId_, feedChanged_, newCount, "0");
-  qDebug() << "=================== parseXml:finish ===========================";
+/** @brief Check if the rest of feed items can be skipped
+ *
+ * Parsing stops after a long run of news which are already in base,
+ * but only while feed lists its news from newest to oldest.
+ *----------------------------------------------------------------------------*/
+bool ParseObject::isParseFinished(bool isDuplicate, const QString &published)
+{
+  if (!published.isEmpty()) {
+    if (!lastPublished_.isEmpty() && (published > lastPublished_))
+      newestFirst_ = false;
+    lastPublished_ = published;
+    if (oldestPublished_.isEmpty() || (published < oldestPublished_))
+      oldestPublished_ = published;
+  }
+
+  if (isDuplicate)
+    duplicateCount_++;
+  else
+    duplicateCount_ = 0;
+
+  if (newestFirst_ && (duplicateCount_ >= PARSE_MAX_DUPLICATES))
+    parseStopped_ = true;
+  return parseStopped_;
 }
 
-void ParseObject::parseAtom(const QString &feedUrl, const QDomDocument &doc)
+/** @brief Save date of the oldest item served by feed
+ *
+ * Clean up drops tombstones of news older than it, since feed does not
+ * serve them any more. Date is known only if all items were parsed.
+ *----------------------------------------------------------------------------*/
+void ParseObject::saveFeedHorizon()
+{
+  if (parseStopped_ || oldestPublished_.isEmpty() ||
+      (feedHorizons_.value(parseFeedId_) == oldestPublished_))
+    return;
+
+  QSqlQuery q = queries_.query("DELETE FROM feeds_ex WHERE feedId=? AND name='tombstoneHorizon'");
+  q.addBindValue(parseFeedId_);
+  q.exec();
+  q = queries_.query("INSERT INTO feeds_ex(feedId, name, value) VALUES (?, 'tombstoneHorizon', ?)");
+  q.addBindValue(parseFeedId_);
+  q.addBindValue(oldestPublished_);
+  q.exec();
+  feedHorizons_.insert(parseFeedId_, oldestPublished_);
+}
+
+/** @brief Read next chunk of items of XML feed left by worker
+ *
+ * Items are read in base thread, but only while parsing is not finished.
+ * @return false if there are no items left
+ *----------------------------------------------------------------------------*/
+bool ParseObject::readNextItems(const ParsedFeedStruct &parsedFeed,
+                                QList<QDomDocument> *itemDocs,
+                                QList<ParsedItemText> *itemTexts)
+{
+  itemDocs->clear();
+  itemTexts->clear();
+  if (!parsedFeed.itemReader)
+    return false;
+  return parsedFeed.itemReader->readItems(itemDocs, itemTexts);
+}
+
+void ParseObject::parseAtom(const QString &feedUrl, const ParsedFeedStruct &parsedFeed)
 {
-  QDomElement rootElem = doc.documentElement();
   FeedItemStruct feedItem;
+  parseAtomFeedItem(feedUrl, parsedFeed.feedDoc.documentElement(), &feedItem);
+
+  QList<QDomDocument> itemDocs = parsedFeed.itemDocs;
+  QList<ParsedItemText> itemTexts = parsedFeed.itemTexts;
+  do {
+    for (int i = 0; i < itemDocs.count(); ++i) {
+      if (parseAtomEntry(feedUrl, itemDocs.at(i).documentElement(),
+                         itemTexts.at(i), feedItem)) {
+        LOG_DEBUG(LogFile::Parse) << "Parse finished on known news:" << feedUrl;
+        return;
+      }
+    }
+  } while (readNextItems(parsedFeed, &itemDocs, &itemTexts));
+}
+
+void ParseObject::parseAtomFeedItem(const QString &feedUrl, const QDomElement &rootElem,
+                                    FeedItemStruct *feedItemPtr)
+{
+  FeedItemStruct &feedItem = *feedItemPtr;
 
   feedItem.linkBase = rootElem.attribute("xml:base");
   feedItem.title = toPlainText(rootElem.namedItem("title").toElement().text());
@@ -283,6 +1084,7 @@ void ParseObject::parseAtom(const QString &feedUrl, const QDomDocument &doc)
     feedItem.authorEmail = authorElem.namedItem("email").toElement().text();
   }
   feedItem.language = rootElem.namedItem("language").toElement().text();
+  findHub(feedUrl, rootElem);
   QDomNodeList linksList = rootElem.elementsByTagName("link");
   for (int j = 0; j < linksList.size(); j++) {
     if (linksList.at(j).toElement().attribute("rel") == "alternate") {
@@ -329,228 +1131,191 @@ void ParseObject::parseAtom(const QString &feedUrl, const QDomDocument &doc)
   q.addBindValue(feedItem.language);
   q.addBindValue(parseFeedId_);
   q.exec();
+}
 
-  QDomNodeList newsList = doc.elementsByTagName("entry");
-  for (int i = 0; i < newsList.size(); i++) {
-    NewsItemStruct newsItem;
-    newsItem.id = newsList.item(i).namedItem("id").toElement().text();
-    newsItem.title = toPlainText(newsList.item(i).namedItem("title").toElement().text());
-    newsItem.updated = newsList.item(i).namedItem("published").toElement().text();
-    if (newsItem.updated.isEmpty())
-      newsItem.updated = newsList.item(i).namedItem("updated").toElement().text();
-    newsItem.updated = parseDate(newsItem.updated, feedUrl);
-    QDomElement authorElem = newsList.item(i).namedItem("author").toElement();
-    if (!authorElem.isNull()) {
-      newsItem.author = toPlainText(authorElem.namedItem("name").toElement().text());
-      if (newsItem.author.isEmpty()) newsItem.author = toPlainText(authorElem.text());
-      newsItem.authorUri = authorElem.namedItem("uri").toElement().text();
-      newsItem.authorEmail = authorElem.namedItem("email").toElement().text();
-    }
-
-    newsItem.description = newsList.item(i).namedItem("summary").toElement().text();
-    QDomNode nodeSummary = newsList.item(i).namedItem("summary");
-    if (!nodeSummary.isNull() && newsItem.description.isEmpty()) {
-      QTextStream in(&newsItem.description);
-      nodeSummary.save(in, 0);
-    }
-    QDomNode nodeContent = newsList.item(i).namedItem("content");
-    if (nodeContent.toElement().attribute("type") == "xhtml") {
-      QTextStream in(&newsItem.content);
-      nodeContent.save(in, 0);
-    } else {
-      newsItem.content = nodeContent.toElement().text();
-    }
-    if (newsItem.content.isEmpty()) {
-      nodeContent = newsList.item(i).namedItem("media:group");
-      if (!nodeContent.isNull()) {
-        QString description = nodeContent.namedItem("media:description").toElement().text();
-        QString media = nodeContent.namedItem("media:thumbnail").toElement().attribute("url");
-        newsItem.content += "<p class=\"description\">" + description + "</p>";
-        newsItem.content += "<img src=\"" + media + "\" alt=\"image\"/>";
-      }
-    }
-    if (!(newsItem.content.isEmpty() ||
-          (newsItem.description.length() > newsItem.content.length()))) {
-      newsItem.description = newsItem.content;
-    }
-    newsItem.content.clear();
+/** @brief Parse one Atom entry and add it into base
+ * @return true if the rest of feed entries can be skipped
+ *----------------------------------------------------------------------------*/
+bool ParseObject::parseAtomEntry(const QString &feedUrl, const QDomElement &entryElem,
+                                 const ParsedItemText &itemText,
+                                 const FeedItemStruct &feedItem)
+{
+  // Children are sorted by tags once instead of search for each field
+  FeedTags::Children children;
+  FeedTags::collect(entryElem, &children);
+
+  NewsItemStruct newsItem;
+  newsItem.id = children.text(FeedTags::TagId);
+  newsItem.title = itemText.title;
+  newsItem.snippet = itemText.snippet;
+  newsItem.titleHash = itemText.titleHash;
+  newsItem.simhash = itemText.simhash;
+  newsItem.updated = children.text(FeedTags::TagPublished);
+  if (newsItem.updated.isEmpty())
+    newsItem.updated = children.text(FeedTags::TagUpdated);
+  newsItem.updated = parseDate(newsItem.updated, feedUrl);
+  const QDomElement &authorElem = children.element(FeedTags::TagAuthor);
+  if (!authorElem.isNull()) {
+    FeedTags::Children authorChildren;
+    FeedTags::collect(authorElem, &authorChildren);
+    newsItem.author = pooledPlainText(authorChildren.text(FeedTags::TagName));
+    if (newsItem.author.isEmpty()) newsItem.author = pooledPlainText(authorElem.text());
+    newsItem.authorUri = intern(authorChildren.text(FeedTags::TagUri));
+    newsItem.authorEmail = intern(authorChildren.text(FeedTags::TagEmail));
+  }
 
-    QDomNodeList categoryElem = newsList.item(i).toElement().elementsByTagName("category");
-    for (int j = 0; j < categoryElem.size(); j++) {
-      if (!newsItem.category.isEmpty()) newsItem.category.append(", ");
-      QString category = categoryElem.at(j).toElement().attribute("label");
-      if (category.isEmpty())
-        category = categoryElem.at(j).toElement().attribute("term");
-      newsItem.category.append(toPlainText(category));
+  const QDomElement &nodeSummary = children.element(FeedTags::TagSummary);
+  newsItem.description = nodeSummary.text();
+  if (!nodeSummary.isNull() && newsItem.description.isEmpty()) {
+    QTextStream in(&newsItem.description);
+    nodeSummary.save(in, 0);
+  }
+  const QDomElement &nodeContent = children.element(FeedTags::TagContent);
+  if (nodeContent.attribute("type") == "xhtml") {
+    QTextStream in(&newsItem.content);
+    nodeContent.save(in, 0);
+  } else {
+    newsItem.content = nodeContent.text();
+  }
+  if (newsItem.content.isEmpty()) {
+    const QDomElement &mediaGroup = children.element(FeedTags::TagMediaGroup);
+    if (!mediaGroup.isNull()) {
+      FeedTags::Children mediaChildren;
+      FeedTags::collect(mediaGroup, &mediaChildren);
+      QString description = mediaChildren.text(FeedTags::TagMediaDescription);
+      QString media = mediaChildren.element(FeedTags::TagMediaThumbnail).attribute("url");
+      newsItem.content += "<p class=\"description\">" + description + "</p>";
+      newsItem.content += "<img src=\"" + media + "\" alt=\"image\"/>";
     }
-    QDomElement enclosureElem = newsList.item(i).namedItem("enclosure").toElement();
-    newsItem.eUrl = enclosureElem.attribute("url");
-    newsItem.eType = enclosureElem.attribute("type");
-    newsItem.eLength = enclosureElem.attribute("length");
-    QDomNodeList linksList = newsList.item(i).toElement().elementsByTagName("link");
-    for (int j = 0; j < linksList.size(); j++) {
-      if (linksList.at(j).toElement().attribute("type") == "text/html") {
-        if (linksList.at(j).toElement().attribute("rel") == "self")
-          newsItem.link = linksList.at(j).toElement().attribute("href");
-        if (linksList.at(j).toElement().attribute("rel") == "alternate")
-          newsItem.linkAlternate = linksList.at(j).toElement().attribute("href");
-        if (linksList.at(j).toElement().attribute("rel") == "replies")
-          newsItem.comments = linksList.at(j).toElement().attribute("href");
-      } else if (newsItem.linkAlternate.isEmpty()) {
-        if (linksList.at(j).toElement().attribute("rel") == "alternate")
-          newsItem.linkAlternate = linksList.at(j).toElement().attribute("href");
-      }
+  }
+  if (!(newsItem.content.isEmpty() ||
+        (newsItem.description.length() > newsItem.content.length()))) {
+    newsItem.description = newsItem.content;
+  }
+  newsItem.content.clear();
+
+  foreach (const QDomElement &categoryElem, children.categories) {
+    if (!newsItem.category.isEmpty()) newsItem.category.append(", ");
+    QString category = categoryElem.attribute("label");
+    if (category.isEmpty())
+      category = categoryElem.attribute("term");
+    newsItem.category.append(pooledPlainText(category));
+  }
+  if (children.categories.count() > 1)
+    newsItem.category = intern(newsItem.category);
+  const QDomElement &enclosureElem = children.element(FeedTags::TagEnclosure);
+  newsItem.eUrl = enclosureElem.attribute("url");
+  newsItem.eType = intern(enclosureElem.attribute("type"));
+  newsItem.eLength = enclosureElem.attribute("length");
+  foreach (const QDomElement &linkElem, children.links) {
+    QString rel = linkElem.attribute("rel");
+    if (linkElem.attribute("type") == "text/html") {
+      if (rel == "self")
+        newsItem.link = linkElem.attribute("href");
+      if (rel == "alternate")
+        newsItem.linkAlternate = linkElem.attribute("href");
+      if (rel == "replies")
+        newsItem.comments = linkElem.attribute("href");
+    } else if (newsItem.linkAlternate.isEmpty()) {
+      if (rel == "alternate")
+        newsItem.linkAlternate = linkElem.attribute("href");
     }
-    for (int j = 0; j < linksList.size(); j++) {
-      if (newsItem.linkAlternate.isEmpty()) {
-        if (!(linksList.at(j).toElement().attribute("rel") == "self")) {
-          newsItem.linkAlternate = linksList.at(j).toElement().attribute("href");
-          break;
-        }
+  }
+  if (newsItem.linkAlternate.isEmpty()) {
+    foreach (const QDomElement &linkElem, children.links) {
+      if (linkElem.attribute("rel") != "self") {
+        newsItem.linkAlternate = linkElem.attribute("href");
+        break;
       }
     }
+  }
 
-    if (!newsItem.link.isEmpty() && QUrl(newsItem.link).host().isEmpty())
-      newsItem.link = feedItem.linkBase + newsItem.link;
-    newsItem.link = toPlainText(newsItem.link);
-    if (!newsItem.linkAlternate.isEmpty() && QUrl(newsItem.linkAlternate).host().isEmpty())
-      newsItem.linkAlternate = feedItem.linkBase + newsItem.linkAlternate;
-    newsItem.linkAlternate = toPlainText(newsItem.linkAlternate);
-    if (newsItem.link.isEmpty()) {
-      newsItem.link = newsItem.linkAlternate;
-      newsItem.linkAlternate.clear();
-    }
-
-    addAtomNewsIntoBase(&newsItem);
+  if (!newsItem.link.isEmpty() && QUrl(newsItem.link).host().isEmpty())
+    newsItem.link = feedItem.linkBase + newsItem.link;
+  newsItem.link = toPlainText(newsItem.link);
+  if (!newsItem.linkAlternate.isEmpty() && QUrl(newsItem.linkAlternate).host().isEmpty())
+    newsItem.linkAlternate = feedItem.linkBase + newsItem.linkAlternate;
+  newsItem.linkAlternate = toPlainText(newsItem.linkAlternate);
+  if (newsItem.link.isEmpty()) {
+    newsItem.link = newsItem.linkAlternate;
+    newsItem.linkAlternate.clear();
   }
+
+  bool isDuplicate = addAtomNewsIntoBase(&newsItem);
+  return isParseFinished(isDuplicate, newsItem.updated);
 }
 
-void ParseObject::addAtomNewsIntoBase(NewsItemStruct *newsItem)
+/** @brief Add Atom news into base if it is not a duplicate
+ * @return true if news is already in base
+ *----------------------------------------------------------------------------*/
+bool ParseObject::addAtomNewsIntoBase(NewsItemStruct *newsItem)
 {
-  Common::sleep(5);
-
   // search news duplicates in base
-  QSqlQuery q(db_);
-  q.setForwardOnly(true);
-  QString qStr;
-  qDebug() << "atomId:" << newsItem->id;
-  qDebug() << "title:" << newsItem->title;
-  qDebug() << "published:" << newsItem->updated;
+  LOG_DEBUG(LogFile::Trace) << "atomId:" << newsItem->id;
+  LOG_DEBUG(LogFile::Trace) << "title:" << newsItem->title;
+  LOG_DEBUG(LogFile::Trace) << "published:" << newsItem->updated;
 
   bool isDuplicate = false;
-  for (int i = 0; i < guidList_.count(); ++i) {
-    if (!newsItem->id.isEmpty()) {         // search by guid if present
-      if (guidList_.at(i) == newsItem->id) {
-        if (duplicateNewsMode_) {       // autodelete duplicate news enabled
-          isDuplicate = true;
-        } else {                        // autodelete dupl. news disabled
-          if (!newsItem->updated.isEmpty()) {  // search by pubDate if present
-            if (publishedList_.at(i) == newsItem->updated)
-              isDuplicate = true;
-          } else {                      // ... or by title
-            if (!newsItem->title.isEmpty() && (titleList_.at(i) == newsItem->title))
-              isDuplicate = true;
-          }
-        }
-      }
-    } else {                                // guid is absent
-      if (!newsItem->updated.isEmpty()) {    // search by pubDate if present
-        if (publishedList_.at(i) == newsItem->updated)
-          isDuplicate = true;
-      } else {                              // ... or by title
-        if (!newsItem->title.isEmpty() && (titleList_.at(i) == newsItem->title))
-          isDuplicate = true;
+  if (!newsItem->id.isEmpty()) {         // search by guid if present
+    if (duplicateNewsMode_) {       // autodelete duplicate news enabled
+      isDuplicate = hasKey(KeyGuid, newsItem->id);
+    } else {                        // autodelete dupl. news disabled
+      if (!newsItem->updated.isEmpty()) {  // search by pubDate if present
+        isDuplicate = hasKey(KeyGuidPublished, newsItem->id, newsItem->updated);
+      } else if (!newsItem->title.isEmpty()) {  // ... or by title
+        isDuplicate = hasKey(KeyGuidTitle, newsItem->id, newsItem->title);
       }
     }
-    if (isDuplicate) break;
+  } else {                                // guid is absent
+    if (!newsItem->updated.isEmpty()) {    // search by pubDate if present
+      isDuplicate = hasKey(KeyPublished, newsItem->updated);
+    } else if (!newsItem->title.isEmpty()) {  // ... or by title
+      isDuplicate = hasKey(KeyTitle, newsItem->title);
+    }
   }
 
   // Verify old news before a date to avoid adding them to base
   bool isOld = false;
   QDateTime pubDate_ = QDateTime::fromString(newsItem->updated, "yyyy-MM-ddTHH:mm:ss");
-  QDateTime avoidedDate_ = QDateTime(mainApp->mainWindow()->avoidedOldNewsDate_);
+  QDateTime avoidedDate_ = QDateTime(avoidedOldNewsDate_);
   if (!addSingleNewsAnyDate_) {      //
     if (avoidedOldSingleNews_ ) {     // avoid adding old single news
       if (QDateTime(avoidedOldSingleNewsDate_) > pubDate_)
         isOld = true;
-      } else if (mainApp->mainWindow()->avoidOldNews_ && avoidedDate_ > pubDate_) {   // avoid adding old news
+      } else if (avoidOldNews_ && avoidedDate_ > pubDate_) {   // avoid adding old news
         isOld = true;
       }
    }
 
   // if duplicates not found and is old news, add them into base
   if (!isDuplicate && !isOld) {
-    bool read = false;
-    if (mainApp->mainWindow()->markIdenticalNewsRead_) {
-      q.prepare("SELECT id FROM news WHERE title LIKE :title AND feedId!=:id");
-      q.bindValue(":id", parseFeedId_);
-      q.bindValue(":title", newsItem->title);
-      q.exec();
-      if (q.first()) read = true;
-    }
+    addPendingNews(*newsItem);
+    commitBatch();
+  }
+  return isDuplicate;
+}
 
-    qStr = QString("INSERT INTO news("
-                   "feedId, description, content, guid, title, author_name, "
-                   "author_uri, author_email, published, received, "
-                   "link_href, link_alternate, category, comments, "
-                   "enclosure_url, enclosure_type, enclosure_length, new, read) "
-                   "VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
-    q.prepare(qStr);
-    q.addBindValue(parseFeedId_);
-    q.addBindValue(newsItem->description);
-    q.addBindValue(newsItem->content);
-    q.addBindValue(newsItem->id);
-    q.addBindValue(newsItem->title);
-    q.addBindValue(newsItem->author);
-    q.addBindValue(newsItem->authorUri);
-    q.addBindValue(newsItem->authorEmail);
-    QString updated = newsItem->updated;
-    if (updated.isEmpty())
-      updated = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
-    q.addBindValue(updated);
-    q.addBindValue(QDateTime::currentDateTime().toString(Qt::ISODate));
-    q.addBindValue(newsItem->link);
-    q.addBindValue(newsItem->linkAlternate);
-    q.addBindValue(newsItem->category);
-    q.addBindValue(newsItem->comments);
-    q.addBindValue(newsItem->eUrl);
-    q.addBindValue(newsItem->eType);
-    q.addBindValue(newsItem->eLength);
-    q.addBindValue(read ? 0 : 1);
-    q.addBindValue(read ? 2 : 0);
-    if (!q.exec()) {
-      qWarning() << __PRETTY_FUNCTION__ << __LINE__
-                 << "q.lastError(): " << q.lastError().text();
-    }
-    q.finish();
-    qDebug() << "q.exec(" << q.lastQuery() << ")";
-    qDebug() << "       " << parseFeedId_;
-    qDebug() << "       " << newsItem->description;
-    qDebug() << "       " << newsItem->content;
-    qDebug() << "       " << newsItem->id;
-    qDebug() << "       " << newsItem->title;
-    qDebug() << "       " << newsItem->author;
-    qDebug() << "       " << newsItem->authorUri;
-    qDebug() << "       " << newsItem->authorEmail;
-    qDebug() << "       " << newsItem->updated;
-    qDebug() << "       " << QDateTime::currentDateTime().toString();
-    qDebug() << "       " << newsItem->link;
-    qDebug() << "       " << newsItem->linkAlternate;
-    qDebug() << "       " << newsItem->category;
-    qDebug() << "       " << newsItem->comments;
-    qDebug() << "       " << newsItem->eUrl;
-    qDebug() << "       " << newsItem->eType;
-    qDebug() << "       " << newsItem->eLength;
-    feedChanged_ = true;
-  }
-}
-
-void ParseObject::parseRss(const QString &feedUrl, const QDomDocument &doc)
-{
-  QDomNode channel = doc.documentElement().namedItem("channel");
-  if (channel.isNull())
-    channel = doc.documentElement().namedItem("rss:channel");
+void ParseObject::parseRss(const QString &feedUrl, const ParsedFeedStruct &parsedFeed)
+{
   FeedItemStruct feedItem;
+  parseRssFeedItem(feedUrl, parsedFeed.feedDoc.documentElement(), &feedItem);
+
+  QList<QDomDocument> itemDocs = parsedFeed.itemDocs;
+  QList<ParsedItemText> itemTexts = parsedFeed.itemTexts;
+  do {
+    for (int i = 0; i < itemDocs.count(); ++i) {
+      if (parseRssItem(feedUrl, itemDocs.at(i).documentElement(), itemTexts.at(i))) {
+        LOG_DEBUG(LogFile::Parse) << "Parse finished on known news:" << feedUrl;
+        return;
+      }
+    }
+  } while (readNextItems(parsedFeed, &itemDocs, &itemTexts));
+}
+
+void ParseObject::parseRssFeedItem(const QString &feedUrl, const QDomElement &channel,
+                                   FeedItemStruct *feedItemPtr)
+{
+  FeedItemStruct &feedItem = *feedItemPtr;
 
   feedItem.title = toPlainText(channel.namedItem("title").toElement().text());
   if (feedItem.title.isEmpty())
@@ -576,262 +1341,502 @@ void ParseObject::parseRss(const QString &feedUrl, const QDomDocument &doc)
   feedItem.language = channel.namedItem("language").toElement().text();
   if (feedItem.language.isEmpty())
     feedItem.language = channel.namedItem("dc:language").toElement().text();
+  findHub(feedUrl, channel);
+
+  // Hints for aggregators when feed should not be updated
+  QVariant ttl;
+  QString ttlStr = channel.namedItem("ttl").toElement().text().trimmed();
+  if (!ttlStr.isEmpty())
+    ttl = ttlStr.toInt();
+  QStringList skipHours;
+  QDomNodeList hours = channel.namedItem("skipHours").toElement().elementsByTagName("hour");
+  for (int i = 0; i < hours.count(); ++i) {
+    skipHours.append(hours.item(i).toElement().text().trimmed());
+  }
+  QStringList skipDays;
+  QDomNodeList days = channel.namedItem("skipDays").toElement().elementsByTagName("day");
+  for (int i = 0; i < days.count(); ++i) {
+    skipDays.append(days.item(i).toElement().text().trimmed());
+  }
 
-  QSqlQuery q(db_);
-  q.setForwardOnly(true);
-  QString qStr("UPDATE feeds "
-               "SET title=?, description=?, htmlUrl=?, "
-               "author_name=?, pubdate=?, language=? "
-               "WHERE id==?");
-  q.prepare(qStr);
+  QSqlQuery q = queries_.query("UPDATE feeds "
+                               "SET title=?, description=?, htmlUrl=?, "
+                               "author_name=?, pubdate=?, language=?, "
+                               "ttl=?, skipHours=?, skipDays=? "
+                               "WHERE id==?");
   q.addBindValue(feedItem.title);
   q.addBindValue(feedItem.description);
   q.addBindValue(feedItem.link);
   q.addBindValue(feedItem.author);
   q.addBindValue(feedItem.updated);
   q.addBindValue(feedItem.language);
+  q.addBindValue(ttl);
+  q.addBindValue(skipHours.join(","));
+  q.addBindValue(skipDays.join(","));
   q.addBindValue(parseFeedId_);
   q.exec();
+}
 
-  QDomNodeList newsList = doc.elementsByTagName("item");
-  if (newsList.isEmpty())
-    newsList = doc.elementsByTagName("rss:item");
-  for (int i = 0; i < newsList.size(); i++) {
-    NewsItemStruct newsItem;
-    newsItem.id = newsList.item(i).namedItem("guid").toElement().text();
-    newsItem.title = toPlainText(newsList.item(i).namedItem("title").toElement().text());
-    if (newsItem.title.isEmpty())
-      newsItem.title = toPlainText(newsList.item(i).namedItem("rss:title").toElement().text());
-    newsItem.updated = newsList.item(i).namedItem("pubDate").toElement().text();
-    if (newsItem.updated.isEmpty())
-      newsItem.updated = newsList.item(i).namedItem("pubdate").toElement().text();
-    if (newsItem.updated.isEmpty())
-      newsItem.updated = newsList.item(i).namedItem("dc:date").toElement().text();
-    newsItem.updated = parseDate(newsItem.updated, feedUrl);
-    newsItem.author = toPlainText(newsList.item(i).namedItem("author").toElement().text());
-    if (newsItem.author.isEmpty())
-      newsItem.author = toPlainText(newsList.item(i).namedItem("dc:creator").toElement().text());
-    newsItem.link = toPlainText(newsList.item(i).namedItem("link").toElement().text());
-    if (newsItem.link.isEmpty()) {
-        newsItem.link = toPlainText(newsList.item(i).namedItem("rss:link").toElement().text());
-        if (newsItem.link.isEmpty()) {
-            if (newsList.item(i).namedItem("guid").toElement().attribute("isPermaLink") == "true")
-                newsItem.link = newsItem.id;
-        }
+/** @brief Parse one RSS item and add it into base
+ * @return true if the rest of feed items can be skipped
+ *----------------------------------------------------------------------------*/
+bool ParseObject::parseRssItem(const QString &feedUrl, const QDomElement &itemElem,
+                               const ParsedItemText &itemText)
+{
+  // Children are sorted by tags once instead of search for each field
+  FeedTags::Children children;
+  FeedTags::collect(itemElem, &children);
+
+  NewsItemStruct newsItem;
+  newsItem.id = children.text(FeedTags::TagGuid);
+  newsItem.title = itemText.title;
+  newsItem.snippet = itemText.snippet;
+  newsItem.titleHash = itemText.titleHash;
+  newsItem.simhash = itemText.simhash;
+  newsItem.updated = children.text(FeedTags::TagPubDate);
+  if (newsItem.updated.isEmpty())
+    newsItem.updated = children.text(FeedTags::TagPubDateLower);
+  if (newsItem.updated.isEmpty())
+    newsItem.updated = children.text(FeedTags::TagDcDate);
+  newsItem.updated = parseDate(newsItem.updated, feedUrl);
+  newsItem.author = pooledPlainText(children.text(FeedTags::TagAuthor));
+  if (newsItem.author.isEmpty())
+    newsItem.author = pooledPlainText(children.text(FeedTags::TagDcCreator));
+  newsItem.link = toPlainText(children.text(FeedTags::TagLink));
+  if (newsItem.link.isEmpty()) {
+      newsItem.link = toPlainText(children.text(FeedTags::TagRssLink));
+      if (newsItem.link.isEmpty()) {
+          if (children.element(FeedTags::TagGuid).attribute("isPermaLink") == "true")
+              newsItem.link = newsItem.id;
+      }
+  }
+  QUrl url = QUrl(newsItem.link);
+  if (url.host().isEmpty())
+    url.setHost(QUrl(feedUrl).host());
+  if (url.scheme().isEmpty())
+    url.setScheme(QUrl(feedUrl).scheme());
+  newsItem.link = url.toString();
+
+  const QDomElement &nodeSummary = children.element(FeedTags::TagDescription);
+  newsItem.description = nodeSummary.text();
+  if (!nodeSummary.isNull() && newsItem.description.isEmpty()) {
+    QTextStream in(&newsItem.description);
+    nodeSummary.save(in, 0);
+  }
+  const QDomElement &nodeContent = children.element(FeedTags::TagContentEncoded);
+  newsItem.content = nodeContent.text();
+  if (!nodeContent.isNull() && newsItem.content.isEmpty()) {
+    QTextStream in(&newsItem.content);
+    nodeContent.save(in, 0);
+  }
+
+  if (newsItem.content.isEmpty() || (newsItem.description.length() > newsItem.content.length())) {
+    newsItem.content.clear();
+  } else {
+    newsItem.description = newsItem.content;
+  }
+
+  foreach (const QDomElement &categoryElem, children.categories) {
+    if (!newsItem.category.isEmpty()) newsItem.category.append(", ");
+    newsItem.category.append(pooledPlainText(categoryElem.text()));
+  }
+  if (children.categories.count() > 1)
+    newsItem.category = intern(newsItem.category);
+  newsItem.comments = children.text(FeedTags::TagComments);
+  const QDomElement &enclosureElem = children.element(FeedTags::TagEnclosure);
+  newsItem.eUrl = enclosureElem.attribute("url");
+  newsItem.eType = intern(enclosureElem.attribute("type"));
+  newsItem.eLength = enclosureElem.attribute("length");
+
+  if (newsItem.title.isEmpty()) {
+    newsItem.title = newsItem.snippet;
+    if (newsItem.title.size() > 50) {
+      newsItem.title.resize(50);
+      newsItem.title = newsItem.title % "...";
     }
-    url = QUrl(newsItem.link);
-    if (url.host().isEmpty())
-      url.setHost(QUrl(feedUrl).host());
-    if (url.scheme().isEmpty())
-      url.setScheme(QUrl(feedUrl).scheme());
-    newsItem.link = url.toString();
-
-    newsItem.description = newsList.item(i).namedItem("description").toElement().text();
-    QDomNode nodeSummary = newsList.item(i).namedItem("description");
-    if (!nodeSummary.isNull() && newsItem.description.isEmpty()) {
-      QTextStream in(&newsItem.description);
-      nodeSummary.save(in, 0);
+    newsItem.titleHash = Common::titleFingerprint(newsItem.title);
+  }
+
+  bool isDuplicate = addRssNewsIntoBase(&newsItem);
+  return isParseFinished(isDuplicate, newsItem.updated);
+}
+
+/** @brief Add RSS news into base if it is not a duplicate
+ * @return true if news is already in base
+ *----------------------------------------------------------------------------*/
+bool ParseObject::addRssNewsIntoBase(NewsItemStruct *newsItem)
+{
+  // search news duplicates in base
+  LOG_DEBUG(LogFile::Trace) << "guid:     " << newsItem->id;
+  LOG_DEBUG(LogFile::Trace) << "link_href:" << newsItem->link;
+  LOG_DEBUG(LogFile::Trace) << "title:"     << newsItem->title;
+  LOG_DEBUG(LogFile::Trace) << "published:" << newsItem->updated;
+
+  bool isDuplicate = false;
+  if (!newsItem->id.isEmpty()) {         // search by guid if present
+    if (!newsItem->updated.isEmpty()) {  // search by pubDate if present
+      if (!duplicateNewsMode_)
+        isDuplicate = hasKey(KeyGuidPublished, newsItem->id, newsItem->updated);
+      else
+        isDuplicate = hasKey(KeyGuid, newsItem->id);
+    } else if (!newsItem->title.isEmpty()) {  // ... or by title
+      isDuplicate = hasKey(KeyGuidTitle, newsItem->id, newsItem->title);
     }
-    newsItem.content = newsList.item(i).namedItem("content:encoded").toElement().text();
-    QDomNode nodeContent = newsList.item(i).namedItem("content:encoded");
-    if (!nodeContent.isNull() && newsItem.content.isEmpty()) {
-      QTextStream in(&newsItem.content);
-      nodeContent.save(in, 0);
+  }
+  else if (!newsItem->link.isEmpty()) {   // search by link_href
+    if (!newsItem->updated.isEmpty()) {  // search by pubDate if present
+      if (!duplicateNewsMode_)
+        isDuplicate = hasKey(KeyLinkPublished, newsItem->link, newsItem->updated);
+      else
+        isDuplicate = hasKey(KeyLink, newsItem->link);
+    } else if (!newsItem->title.isEmpty()) {  // ... or by title
+      isDuplicate = hasKey(KeyLinkTitle, newsItem->link, newsItem->title);
     }
-
-    if (newsItem.content.isEmpty() || (newsItem.description.length() > newsItem.content.length())) {
-      newsItem.content.clear();
-    } else {
-      newsItem.description = newsItem.content;
+  }
+  else {                                // guid is absent
+    if (!newsItem->updated.isEmpty()) {  // search by pubDate if present
+      if (!duplicateNewsMode_)
+        isDuplicate = hasKey(KeyPublished, newsItem->updated);
+      else
+        isDuplicate = (storedNewsCount_ > 0);
+    } else if (!newsItem->title.isEmpty()) {  // ... or by title
+      isDuplicate = hasKey(KeyTitle, newsItem->title);
     }
+  }
+  // same pubDate and title
+  if (!isDuplicate && !newsItem->updated.isEmpty()) {
+    isDuplicate = hasKey(KeyPublishedTitle, newsItem->updated, newsItem->title);
+  }
 
-    QDomNodeList categoryElem = newsList.item(i).toElement().elementsByTagName("category");
-    for (int j = 0; j < categoryElem.size(); j++) {
-      if (!newsItem.category.isEmpty()) newsItem.category.append(", ");
-      newsItem.category.append(toPlainText(categoryElem.at(j).toElement().text()));
-    }
-    newsItem.comments = newsList.item(i).namedItem("comments").toElement().text();
-    QDomElement enclosureElem = newsList.item(i).namedItem("enclosure").toElement();
-    newsItem.eUrl = enclosureElem.attribute("url");
-    newsItem.eType = enclosureElem.attribute("type");
-    newsItem.eLength = enclosureElem.attribute("length");
-
-    if (newsItem.title.isEmpty()) {
-      newsItem.title = toPlainText(newsItem.description);
-      if (newsItem.title.size() > 50) {
-        newsItem.title.resize(50);
-        newsItem.title = newsItem.title % "...";
+  // Verify old news before a date to avoid adding them to base
+  bool isOld = false;
+  QDateTime pubDate_ = QDateTime::fromString(newsItem->updated, "yyyy-MM-ddTHH:mm:ss");
+  QDateTime avoidedDate_ = QDateTime(avoidedOldNewsDate_);
+  if (!addSingleNewsAnyDate_) {      //
+    if (avoidedOldSingleNews_ ) {     // avoid adding old single news
+      if (QDateTime(avoidedOldSingleNewsDate_) > pubDate_)
+        isOld = true;
+      } else if (avoidOldNews_ && avoidedDate_ > pubDate_) {   // avoid adding old news
+              isOld = true;
       }
-    }
+   }
 
-    addRssNewsIntoBase(&newsItem);
+ // if duplicates not found And old news, add them into base
+ if (!isDuplicate && !isOld) {
+    addPendingNews(*newsItem);
+    commitBatch();
   }
+  return isDuplicate;
 }
 
-void ParseObject::addRssNewsIntoBase(NewsItemStruct *newsItem)
+/** @brief Add news of JSON Feed read by worker into base
+ *
+ * Items of JSON Feed have required id, so they are checked for duplicates
+ * as Atom entries.
+ *----------------------------------------------------------------------------*/
+void ParseObject::parseJson(const QString &feedUrl, const ParsedFeedStruct &parsedFeed)
 {
-  Common::sleep(5);
-
-  // search news duplicates in base
-  QSqlQuery q(db_);
-  q.setForwardOnly(true);
-  QString qStr;
-  qDebug() << "guid:     " << newsItem->id;
-  qDebug() << "link_href:" << newsItem->link;
-  qDebug() << "title:"     << newsItem->title;
-  qDebug() << "published:" << newsItem->updated;
+  FeedItemStruct feedItem = parsedFeed.feedItem;
+  QUrl url(feedItem.link);
+  if (url.host().isEmpty())
+    url = QUrl(feedUrl);
+  feedItem.linkBase = url.scheme() % "://" % url.host();
+  if (feedItem.link.isEmpty() || QUrl(feedItem.link).host().isEmpty())
+    feedItem.link = feedItem.linkBase;
+
+  if (!parsedFeed.hubUrl.isEmpty())
+    emit signalHubFound(parseFeedId_, parsedFeed.hubUrl, feedUrl);
+
+  QSqlQuery q = queries_.query("UPDATE feeds "
+                               "SET title=?, description=?, htmlUrl=?, "
+                               "author_name=?, author_uri=?, language=? "
+                               "WHERE id==?");
+  q.addBindValue(feedItem.title);
+  q.addBindValue(feedItem.description);
+  q.addBindValue(feedItem.link);
+  q.addBindValue(feedItem.author);
+  q.addBindValue(feedItem.authorUri);
+  q.addBindValue(feedItem.language);
+  q.addBindValue(parseFeedId_);
+  q.exec();
+  q.finish();
 
-  bool isDuplicate = false;
-  for (int i = 0; i < guidList_.count(); ++i) {
-    if (!newsItem->id.isEmpty()) {         // search by guid if present
-      if (guidList_.at(i) == newsItem->id) {
-        if (!newsItem->updated.isEmpty()) {  // search by pubDate if present
-          if (!duplicateNewsMode_) {
-            if (publishedList_.at(i) == newsItem->updated)
-              isDuplicate = true;
-          }
-          else {
-            isDuplicate = true;
-          }
-        } else {                            // ... or by title
-          if (!newsItem->title.isEmpty() && (titleList_.at(i) == newsItem->title))
-            isDuplicate = true;
-        }
-      }
-      if (!isDuplicate) {
-        if (!newsItem->updated.isEmpty()) {
-          if ((publishedList_.at(i) == newsItem->updated) &&
-              (titleList_.at(i) == newsItem->title)) {
-            isDuplicate = true;
-          }
-        }
-      }
+  foreach (NewsItemStruct newsItem, parsedFeed.newsItems) {
+    newsItem.updated = parseDate(newsItem.updated, feedUrl);
+    newsItem.author = intern(newsItem.author);
+    newsItem.authorUri = intern(newsItem.authorUri);
+    newsItem.category = intern(newsItem.category);
+    newsItem.eType = intern(newsItem.eType);
+    if (!newsItem.link.isEmpty() && QUrl(newsItem.link).host().isEmpty())
+      newsItem.link = feedItem.linkBase + newsItem.link;
+    if (newsItem.link.isEmpty()) {
+      newsItem.link = newsItem.linkAlternate;
+      newsItem.linkAlternate.clear();
     }
-    else if (!newsItem->link.isEmpty()) {   // search by link_href
-      if (linkList_.at(i) == newsItem->link) {
-        if (!newsItem->updated.isEmpty()) {  // search by pubDate if present
-          if (!duplicateNewsMode_) {
-            if (publishedList_.at(i) == newsItem->updated)
-              isDuplicate = true;
-          }
-          else {
-            isDuplicate = true;
-          }
-        } else {                            // ... or by title
-          if (!newsItem->title.isEmpty() && (titleList_.at(i) == newsItem->title))
-            isDuplicate = true;
-        }
-      }
-      if (!isDuplicate) {
-        if (!newsItem->updated.isEmpty()) {
-          if ((publishedList_.at(i) == newsItem->updated) &&
-              (titleList_.at(i) == newsItem->title)) {
-            isDuplicate = true;
-          }
-        }
-      }
+
+    bool isDuplicate = addAtomNewsIntoBase(&newsItem);
+    if (isParseFinished(isDuplicate, newsItem.updated)) {
+      LOG_DEBUG(LogFile::Parse) << "Parse finished on known news:" << feedUrl;
+      break;
     }
-    else {                                // guid is absent
-      if (!newsItem->updated.isEmpty()) {  // search by pubDate if present
-        if (!duplicateNewsMode_) {
-          if (publishedList_.at(i) == newsItem->updated)
-            isDuplicate = true;
-        }
-        else {
-          isDuplicate = true;
-        }
-      } else {                            // ... or by title
-        if (!newsItem->title.isEmpty() && (titleList_.at(i) == newsItem->title))
-          isDuplicate = true;
-      }
-      if (!isDuplicate) {
-        if (!newsItem->updated.isEmpty()) {
-          if ((publishedList_.at(i) == newsItem->updated) &&
-              (titleList_.at(i) == newsItem->title)) {
-            isDuplicate = true;
-          }
-        }
-      }
+  }
+}
+
+/** @brief Add news of feed received by sync client
+ *
+ * Items of sync server are not ordered by feed, so all of them are checked.
+ *----------------------------------------------------------------------------*/
+void ParseObject::parseSyncItems(const QString &feedUrl, const ParsedFeedStruct &parsedFeed)
+{
+  foreach (NewsItemStruct newsItem, parsedFeed.newsItems) {
+    newsItem.updated = parseDate(newsItem.updated, feedUrl);
+    newsItem.author = intern(newsItem.author);
+    newsItem.category = intern(newsItem.category);
+    // News fetched from feed before it was synced has its own guid
+    if (!newsItem.link.isEmpty() && hasKey(KeyLinkTitle, newsItem.link, newsItem.title))
+      continue;
+    addAtomNewsIntoBase(&newsItem);
+  }
+}
+
+/** @brief Link items of sync server with inserted news and set their state
+ *
+ * Item without news got duplicate of news which is already in base.
+ *----------------------------------------------------------------------------*/
+void ParseObject::applySyncState()
+{
+  QSqlQuery q = queries_.query("UPDATE syncItems SET newsId=ifnull((SELECT max(id) FROM news "
+                               "WHERE news.feedId=syncItems.feedId AND news.guid=syncItems.itemId), -1) "
+                               "WHERE feedId=? AND newsId=0");
+  q.addBindValue(parseFeedId_);
+  q.exec();
+  if (!firstNewsId_)
+    return;
+
+  q = queries_.query("UPDATE news SET read=2, new=0 WHERE id IN "
+                     "(SELECT newsId FROM syncItems WHERE feedId=? AND newsId>=? AND read=1)");
+  q.addBindValue(parseFeedId_);
+  q.addBindValue(firstNewsId_);
+  q.exec();
+  q = queries_.query("UPDATE news SET starred=1 WHERE id IN "
+                     "(SELECT newsId FROM syncItems WHERE feedId=? AND newsId>=? AND starred=1)");
+  q.addBindValue(parseFeedId_);
+  q.addBindValue(firstNewsId_);
+  q.exec();
+}
+
+/** @brief Look for WebSub hub advertised by feed
+ *----------------------------------------------------------------------------*/
+void ParseObject::findHub(const QString &feedUrl, const QDomElement &rootElem)
+{
+  QString hubUrl;
+  QString topicUrl;
+  QDomElement linkElem = rootElem.firstChildElement();
+  while (!linkElem.isNull()) {
+    if ((linkElem.tagName() == "link") || linkElem.tagName().endsWith(":link")) {
+      if (linkElem.attribute("rel") == "hub")
+        hubUrl = linkElem.attribute("href");
+      else if (linkElem.attribute("rel") == "self")
+        topicUrl = linkElem.attribute("href");
     }
-    if (isDuplicate) break;
+    linkElem = linkElem.nextSiblingElement();
+  }
+
+  if (hubUrl.isEmpty()) return;
+  if (topicUrl.isEmpty())
+    topicUrl = feedUrl;
+  emit signalHubFound(parseFeedId_, hubUrl, topicUrl);
+}
+
+QString ParseObject::toPlainText(const QString &text)
+{
+  return Common::htmlToPlainText(text);
+}
+
+/** @brief Return value stored earlier in this parse if \a value is the same
+ *
+ * Fields such as enclosure type or author e-mail repeat in most items of
+ * feed, pending news then share one copy of them.
+ *----------------------------------------------------------------------------*/
+QString ParseObject::intern(const QString &value)
+{
+  if (value.isEmpty())
+    return QString();
+
+  internLookups_++;
+  QSet<QString>::const_iterator it = internPool_.constFind(value);
+  if (it != internPool_.constEnd()) {
+    internShared_++;
+    return *it;
+  }
+  internPool_.insert(value);
+  return value;
+}
+
+/** @brief Convert html of repeated field to plain text once per parse
+ *----------------------------------------------------------------------------*/
+QString ParseObject::pooledPlainText(const QString &text)
+{
+  if (text.isEmpty())
+    return QString();
+
+  internLookups_++;
+  QHash<QString, QString>::const_iterator it = plainTextPool_.constFind(text);
+  if (it != plainTextPool_.constEnd()) {
+    internShared_++;
+    return it.value();
+  }
+  QString plainText = toPlainText(text);
+  plainTextPool_.insert(text, plainText);
+  return plainText;
+}
+
+/** @brief Get number of pooled field values and how many of them were shared
+ *----------------------------------------------------------------------------*/
+void ParseObject::internStatistics(qint64 *lookups, qint64 *shared, bool reset)
+{
+  *lookups = internLookups_;
+  *shared = internShared_;
+  if (reset) {
+    internLookups_ = 0;
+    internShared_ = 0;
   }
+}
 
-  // Verify old news before a date to avoid adding them to base
-  bool isOld = false;
-  QDateTime pubDate_ = QDateTime::fromString(newsItem->updated, "yyyy-MM-ddTHH:mm:ss");
-  QDateTime avoidedDate_ = QDateTime(mainApp->mainWindow()->avoidedOldNewsDate_);
-  if (!addSingleNewsAnyDate_) {      //
-    if (avoidedOldSingleNews_ ) {     // avoid adding old single news
-      if (QDateTime(avoidedOldSingleNewsDate_) > pubDate_)
-        isOld = true;
-      } else if (mainApp->mainWindow()->avoidOldNews_ && avoidedDate_ > pubDate_) {   // avoid adding old news
-              isOld = true;
-      }
-   }
+static int readNumber(const QString &str, int *pos, int minDigits, int maxDigits)
+{
+  int value = 0;
+  int digits = 0;
+  while ((*pos < str.length()) && (digits < maxDigits) && str.at(*pos).isDigit()) {
+    value = value * 10 + str.at(*pos).digitValue();
+    ++*pos;
+    ++digits;
+  }
+  if (digits < minDigits) return -1;
+  return value;
+}
 
- // if duplicates not found And old news, add them into base
- if (!isDuplicate && !isOld) {
-    bool read = false;
-    if (mainApp->mainWindow()->markIdenticalNewsRead_) {
-      q.prepare("SELECT id FROM news WHERE title LIKE :title AND feedId!=:id");
-      q.bindValue(":id", parseFeedId_);
-      q.bindValue(":title", newsItem->title);
-      q.exec();
-      if (q.first()) read = true;
-    }
+static bool skipChar(const QString &str, int *pos, char ch)
+{
+  if ((*pos < str.length()) && (str.at(*pos) == QLatin1Char(ch))) {
+    ++*pos;
+    return true;
+  }
+  return false;
+}
 
-    qStr = QString("INSERT INTO news("
-                   "feedId, description, content, guid, title, author_name, "
-                   "published, received, link_href, category, comments, "
-                   "enclosure_url, enclosure_type, enclosure_length, new, read) "
-                   "VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
-    q.prepare(qStr);
-    q.addBindValue(parseFeedId_);
-    q.addBindValue(newsItem->description);
-    q.addBindValue(newsItem->content);
-    q.addBindValue(newsItem->id);
-    q.addBindValue(newsItem->title);
-    q.addBindValue(newsItem->author);
-    QString updated = newsItem->updated;
-    if (updated.isEmpty())
-      updated = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
-    q.addBindValue(updated);
-    q.addBindValue(QDateTime::currentDateTime().toString(Qt::ISODate));
-    q.addBindValue(newsItem->link);
-    q.addBindValue(newsItem->category);
-    q.addBindValue(newsItem->comments);
-    q.addBindValue(newsItem->eUrl);
-    q.addBindValue(newsItem->eType);
-    q.addBindValue(newsItem->eLength);
-    q.addBindValue(read ? 0 : 1);
-    q.addBindValue(read ? 2 : 0);
-    if (!q.exec()) {
-      qWarning() << __PRETTY_FUNCTION__ << __LINE__
-                 << "q.lastError(): " << q.lastError().text();
+static void skipSpaces(const QString &str, int *pos)
+{
+  while ((*pos < str.length()) && str.at(*pos).isSpace()) ++*pos;
+}
+
+/** @brief Read time zone offset in seconds
+ * @return false if zone is unknown
+ *----------------------------------------------------------------------------*/
+static bool readTimeZone(const QString &str, int *pos, int *offset)
+{
+  if (*pos >= str.length()) return false;
+
+  QChar sign = str.at(*pos);
+  if ((sign == QLatin1Char('+')) || (sign == QLatin1Char('-'))) {
+    ++*pos;
+    int hours = readNumber(str, pos, 2, 2);
+    if (hours < 0) return false;
+    skipChar(str, pos, ':');
+    int minutes = readNumber(str, pos, 0, 2);
+    if (minutes < 0) minutes = 0;
+    *offset = hours * 3600 + minutes * 60;
+    if (sign == QLatin1Char('-')) *offset = -*offset;
+    return true;
+  }
+
+  static const char *zones[] = { "Z", "UT", "UTC", "GMT", "EST", "EDT", "CST", "CDT",
+                                 "MST", "MDT", "PST", "PDT" };
+  static const int zoneHours[] = { 0, 0, 0, 0, -5, -4, -6, -5, -7, -6, -8, -7 };
+  int end = *pos;
+  while ((end < str.length()) && str.at(end).isLetter()) ++end;
+  QString zone = str.mid(*pos, end - *pos).toUpper();
+  for (uint i = 0; i < sizeof(zoneHours) / sizeof(zoneHours[0]); ++i) {
+    if (zone == QLatin1String(zones[i])) {
+      *offset = zoneHours[i] * 3600;
+      *pos = end;
+      return true;
     }
-    q.finish();
-    qDebug() << "q.exec(" << q.lastQuery() << ")";
-    qDebug() << "       " << parseFeedId_;
-    qDebug() << "       " << newsItem->description;
-    qDebug() << "       " << newsItem->content;
-    qDebug() << "       " << newsItem->id;
-    qDebug() << "       " << newsItem->title;
-    qDebug() << "       " << newsItem->author;
-    qDebug() << "       " << newsItem->updated;
-    qDebug() << "       " << QDateTime::currentDateTime().toString();
-    qDebug() << "       " << newsItem->link;
-    qDebug() << "       " << newsItem->category;
-    qDebug() << "       " << newsItem->comments;
-    qDebug() << "       " << newsItem->eUrl;
-    qDebug() << "       " << newsItem->eType;
-    qDebug() << "       " << newsItem->eLength;
-    feedChanged_ = true;
   }
+  return false;
 }
 
-QString ParseObject::toPlainText(const QString &text)
+/** @brief Parse RFC 822 and ISO 8601 (RFC 3339) date without format cascade
+ * @return false if date has other format
+ *----------------------------------------------------------------------------*/
+bool ParseObject::parseDateFast(const QString &dateString, QDateTime *dateTime)
 {
-  return QTextDocumentFragment::fromHtml(text).toPlainText().simplified();
+  static const char *months[] = { "jan", "feb", "mar", "apr", "may", "jun",
+                                  "jul", "aug", "sep", "oct", "nov", "dec" };
+  const QString &str = dateString;
+  int pos = 0;
+  int year, month, day;
+  skipSpaces(str, &pos);
+
+  if ((pos + 4 < str.length()) && str.at(pos + 4) == QLatin1Char('-')) {
+    // ISO 8601: yyyy-MM-ddTHH:mm:ss[.zzz][Z|+HH:mm]
+    year = readNumber(str, &pos, 4, 4);
+    if (!skipChar(str, &pos, '-')) return false;
+    month = readNumber(str, &pos, 2, 2);
+    if (!skipChar(str, &pos, '-')) return false;
+    day = readNumber(str, &pos, 2, 2);
+    if (!skipChar(str, &pos, 'T') && !skipChar(str, &pos, ' ')) return false;
+  } else {
+    // RFC 822: [ddd,] d MMM yyyy HH:mm[:ss] zone
+    int comma = str.indexOf(QLatin1Char(','));
+    if ((comma != -1) && (comma < 12)) {
+      pos = comma + 1;
+      skipSpaces(str, &pos);
+    }
+    day = readNumber(str, &pos, 1, 2);
+    skipSpaces(str, &pos);
+    QString monthName = str.mid(pos, 3).toLower();
+    month = -1;
+    for (int i = 0; i < 12; ++i) {
+      if (monthName == QLatin1String(months[i])) {
+        month = i + 1;
+        break;
+      }
+    }
+    if (month == -1) return false;
+    pos += 3;
+    skipSpaces(str, &pos);
+    int yearPos = pos;
+    year = readNumber(str, &pos, 2, 4);
+    if (pos - yearPos == 2)
+      year += (year > 70) ? 1900 : 2000;
+    else if (pos - yearPos != 4)
+      return false;
+    skipSpaces(str, &pos);
+  }
+  if ((year < 0) || (month < 1) || (day < 1)) return false;
+
+  int hour = readNumber(str, &pos, 2, 2);
+  if (!skipChar(str, &pos, ':')) return false;
+  int minute = readNumber(str, &pos, 2, 2);
+  int second = 0;
+  if (skipChar(str, &pos, ':'))
+    second = readNumber(str, &pos, 2, 2);
+  if ((hour < 0) || (minute < 0) || (second < 0)) return false;
+  if (skipChar(str, &pos, '.') || skipChar(str, &pos, ','))
+    readNumber(str, &pos, 1, 9);
+  skipSpaces(str, &pos);
+
+  int offset = timeShift_;
+  if ((pos < str.length()) && !readTimeZone(str, &pos, &offset))
+    return false;
+
+  QDate date(year, month, day);
+  QTime time(hour, minute, second);
+  if (!date.isValid() || !time.isValid()) return false;
+
+  *dateTime = QDateTime(date, time, Qt::UTC).addSecs(-offset);
+  return true;
 }
 
 /** @brief Date/time string parsing
@@ -844,9 +1849,15 @@ QString ParseObject::parseDate(const QString &dateString, const QString &urlStri
 
   if (dateString.isEmpty()) return QString();
 
-  QDateTime dtLocalTime = QDateTime::currentDateTime();
-  QDateTime dtUTC = QDateTime(dtLocalTime.date(), dtLocalTime.time(), Qt::UTC);
-  int nTimeShift = dtLocalTime.secsTo(dtUTC)/3600;
+  if (parseDateFast(dateString, &dt)) {
+    char buf[32];
+    qsnprintf(buf, sizeof(buf), "%04d-%02d-%02dT%02d:%02d:%02d",
+              dt.date().year(), dt.date().month(), dt.date().day(),
+              dt.time().hour(), dt.time().minute(), dt.time().second());
+    return QString::fromLatin1(buf);
+  }
+
+  int nTimeShift = timeShift_/3600;
 
   QString ds = dateString.simplified();
   QLocale locale(QLocale::C);
@@ -926,297 +1937,613 @@ QString ParseObject::parseDate(const QString &dateString, const QString &urlStri
     if (dt.isValid()) return locale.toString(dt.addSecs(timeZone.toInt() * -3600), "yyyy-MM-ddTHH:mm:ss");
   }
 
-  qDebug() << __LINE__ << "parseDate: error with" << dateString << urlString;
+  LOG_DEBUG(LogFile::Parse) << __LINE__ << "parseDate: error with" << dateString << urlString;
   return QString();
 }
 
-/** @brief Apply user filters
- * @param feedId - Feed Id
- * @param filterId - Id of particular filter
+/** @brief Build SQL condition of user filter
+ * @param field - Checked news field
+ * @param condition - Comparison type
+ * @param content - Value to compare with (quotes escaped)
  *---------------------------------------------------------------------------*/
-void ParseObject::runUserFilter(int feedId, int filterId)
+static QString filterConditionStr(int field, int condition, const QString &content)
 {
-  QSqlQuery q(db_);
-  bool isAllFilters = true;
-
-  if (filterId != -1) {
-    isAllFilters = false;
-    q.exec(QString("SELECT enable, type FROM filters WHERE id='%1' AND feeds LIKE '%,%2,%'").
-           arg(filterId).arg(feedId));
-  } else {
-    q.exec(QString("SELECT enable, type, id FROM filters WHERE feeds LIKE '%,%1,%' ORDER BY num").
-           arg(feedId));
-  }
-
-  while (q.next()) {
-    if ((q.value(0).toInt() == 0) && isAllFilters) continue;
-
-    if (isAllFilters)
-      filterId = q.value(2).toInt();
-    int filterType = q.value(1).toInt();
-
-    QString qStr("UPDATE news SET");
-    QString qStr1;
-    QString qStr2;
-    QString whereStr;
-    QList<int> idLabelsList;
-    QStringList soundList;
-    QStringList colorList;
-
-    QSqlQuery q1(db_);
-    q1.exec(QString("SELECT action, params FROM filterActions "
-                    "WHERE idFilter=='%1'").arg(filterId));
-    while (q1.next()) {
-      switch (q1.value(0).toInt()) {
-      case 0: // action -> Mark news as read
-        if (!qStr1.isNull()) qStr1.append(",");
-        qStr1.append(" new=0, read=2");
+  QString str;
+  switch (field) {
+  case 0: // field -> Title
+    switch (condition) {
+    case 0: // condition -> contains
+      str = QString("UPPER(title) LIKE '%%1%' ").arg(content.toUpper());
+      break;
+    case 1: // condition -> doesn't contains
+      str = QString("UPPER(title) NOT LIKE '%%1%' ").arg(content.toUpper());
+      break;
+    case 2: // condition -> is
+      str = QString("UPPER(title) LIKE '%1' ").arg(content.toUpper());
+      break;
+    case 3: // condition -> isn't
+      str = QString("UPPER(title) NOT LIKE '%1' ").arg(content.toUpper());
+      break;
+    case 4: // condition -> begins with
+      str = QString("UPPER(title) LIKE '%1%' ").arg(content.toUpper());
+      break;
+    case 5: // condition -> ends with
+      str = QString("UPPER(title) LIKE '%%1' ").arg(content.toUpper());
+      break;
+    case 6: // condition -> regExp
+      str = QString("title REGEXP '%1' ").arg(content);
+      break;
+    }
+    break;
+  case 1: // field -> Description
+    switch (condition) {
+    case 0: // condition -> contains
+      str = QString("id IN (SELECT newsId FROM newsContent "
+                    "WHERE UPPER(uncompress(description)) LIKE '%%1%') ").arg(content.toUpper());
+      break;
+    case 1: // condition -> doesn't contains
+      str = QString("id IN (SELECT newsId FROM newsContent "
+                    "WHERE UPPER(uncompress(description)) NOT LIKE '%%1%') ").arg(content.toUpper());
+      break;
+    case 2: // condition -> regExp
+      str = QString("id IN (SELECT newsId FROM newsContent "
+                    "WHERE uncompress(description) REGEXP '%1') ").arg(content);
+      break;
+    }
+    break;
+  case 2: // field -> Author
+    switch (condition) {
+    case 0: // condition -> contains
+      str = QString("UPPER(author_name) LIKE '%%1%' ").arg(content.toUpper());
+      break;
+    case 1: // condition -> doesn't contains
+      str = QString("UPPER(author_name) NOT LIKE '%%1%' ").arg(content.toUpper());
+      break;
+    case 2: // condition -> is
+      str = QString("UPPER(author_name) LIKE '%1' ").arg(content.toUpper());
+      break;
+    case 3: // condition -> isn't
+      str = QString("UPPER(author_name) NOT LIKE '%1' ").arg(content.toUpper());
+      break;
+    case 4: // condition -> regExp
+      str = QString("author_name REGEXP '%1' ").arg(content);
+      break;
+    }
+    break;
+  case 3: // field -> Category
+    switch (condition) {
+    case 0: // condition -> contains
+      str = QString("UPPER(category) LIKE '%%1%' ").arg(content.toUpper());
+      break;
+    case 1: // condition -> doesn't contains
+      str = QString("UPPER(category) NOT LIKE '%%1%' ").arg(content.toUpper());
+      break;
+    case 2: // condition -> is
+      str = QString("UPPER(category) LIKE '%1' ").arg(content.toUpper());
+      break;
+    case 3: // condition -> isn't
+      str = QString("UPPER(category) NOT LIKE '%1' ").arg(content.toUpper());
+      break;
+    case 4: // condition -> begins with
+      str = QString("UPPER(category) LIKE '%1%' ").arg(content.toUpper());
+      break;
+    case 5: // condition -> ends with
+      str = QString("UPPER(category) LIKE '%%1' ").arg(content.toUpper());
+      break;
+    case 6: // condition -> regExp
+      str = QString("category REGEXP '%1' ").arg(content);
+      break;
+    }
+    break;
+  case 4: // field -> Status
+    if (condition == 0) { // Status -> is
+      switch (content.toInt()) {
+      case 0:
+        str = "new==1 ";
         break;
-      case 1: // action -> Add star
-        if (!qStr1.isNull()) qStr1.append(",");
-        qStr1.append(" starred=1");
+      case 1:
+        str = "read>=1 ";
         break;
-      case 2: // action -> Delete
-        if (!qStr1.isNull()) qStr1.append(",");
-        qStr1.append(" new=0, read=2, deleted=1, ");
-        qStr1.append(QString("deleteDate='%1'").
-                     arg(QDateTime::currentDateTime().toString(Qt::ISODate)));
+      case 2:
+        str = "starred==1 ";
         break;
-      case 3: // action -> Add Label
-        idLabelsList.append(q1.value(1).toInt());
+      }
+    } else { // Status -> isn't
+      switch (content.toInt()) {
+      case 0:
+        str = "new==0 ";
         break;
-      case 4: // action -> Play Sound
-        soundList.append(q1.value(1).toString());
+      case 1:
+        str = "read==0 ";
         break;
-      case 5: // action -> Show News in Notifier
-        colorList.append(q1.value(1).toString());
+      case 2:
+        str = "starred==0 ";
         break;
       }
     }
+    break;
+  case 5: // field -> Link
+    switch (condition) {
+    case 0: // condition -> contains
+      str = QString("link_href LIKE '%%1%' ").arg(content);
+      break;
+    case 1: // condition -> doesn't contains
+      str = QString("link_href NOT LIKE '%%1%' ").arg(content);
+      break;
+    case 2: // condition -> is
+      str = QString("link_href LIKE '%1' ").arg(content);
+      break;
+    case 3: // condition -> isn't
+      str = QString("link_href NOT LIKE '%1' ").arg(content);
+      break;
+    case 4: // condition -> begins with
+      str = QString("link_href LIKE '%1%' ").arg(content);
+      break;
+    case 5: // condition -> ends with
+      str = QString("link_href LIKE '%%1' ").arg(content);
+      break;
+    case 6: // condition -> regExp
+      str = QString("link_href REGEXP '%1' ").arg(content);
+      break;
+    }
+    break;
+  case 6: // field -> News
+    switch (condition) {
+    case 0: // condition -> contains
+      str = QString("(UPPER(title) LIKE '%%1%' OR id IN (SELECT newsId FROM newsContent "
+                    "WHERE UPPER(uncompress(description)) LIKE '%%1%')) ").arg(content.toUpper());
+      break;
+    case 1: // condition -> doesn't contains
+      str = QString("(UPPER(title) NOT LIKE '%%1%' OR id IN (SELECT newsId FROM newsContent "
+                    "WHERE UPPER(uncompress(description)) NOT LIKE '%%1%')) ").arg(content.toUpper());
+      break;
+    case 2: // condition -> regExp
+      str = QString("(title REGEXP '%1' OR id IN (SELECT newsId FROM newsContent "
+                    "WHERE uncompress(description) REGEXP '%1')) ").arg(content);
+      break;
+    }
+    break;
+  }
+  return str;
+}
 
-    if (qStr1.isEmpty())
-      qStr.clear();
-    else
-      qStr.append(qStr1);
+/** @brief Load user filters with their actions and conditions
+ *
+ *  Filters are cached until reloadUserFilters() is called
+ *---------------------------------------------------------------------------*/
+void ParseObject::loadUserFilters()
+{
+  userFilters_.clear();
+  filterMatcher_.clear();
+  QHash<int,int> filterIndex;
 
-    whereStr = QString(" WHERE feedId='%1' AND deleted=0").arg(feedId);
+  QSqlQuery q(db_);
+  q.exec("SELECT id, enable, type, feeds FROM filters ORDER BY num");
+  while (q.next()) {
+    UserFilterStruct filter;
+    filter.id = q.value(0).toInt();
+    filter.enable = (q.value(1).toInt() != 0);
+    filter.type = q.value(2).toInt();
+    foreach (const QString &idFeed, q.value(3).toString().split(",", QString::SkipEmptyParts))
+      filter.feeds.insert(idFeed.toInt());
+    filter.markRead = false;
+    filter.addStar = false;
+    filter.deleteNews = false;
+    filter.matcherReady = true;
+    filterIndex.insert(filter.id, userFilters_.count());
+    filterMatcher_.addFilter(filter.type);
+    userFilters_.append(filter);
+  }
 
-    qStr2.clear();
-    switch (filterType) {
-    case 1: // Match all conditions
-      qStr2.append("AND ");
+  q.exec("SELECT idFilter, action, params FROM filterActions");
+  while (q.next()) {
+    int index = filterIndex.value(q.value(0).toInt(), -1);
+    if (index == -1) continue;
+    UserFilterStruct &filter = userFilters_[index];
+    switch (q.value(1).toInt()) {
+    case 0: // action -> Mark news as read
+      filter.markRead = true;
+      break;
+    case 1: // action -> Add star
+      filter.addStar = true;
+      break;
+    case 2: // action -> Delete
+      filter.deleteNews = true;
+      break;
+    case 3: // action -> Add Label
+      filter.idLabelsList.append(q.value(2).toInt());
       break;
-    case 2: // Match any condition
-      qStr2.append("OR ");
+    case 4: // action -> Play Sound
+      filter.soundList.append(q.value(2).toString());
+      break;
+    case 5: // action -> Show News in Notifier
+      filter.colorList.append(q.value(2).toString());
       break;
     }
+  }
 
-    if ((filterType == 1) || (filterType == 2)) {
-      whereStr.append(" AND ( ");
-      qStr1.clear();
-
-      q1.exec(QString("SELECT field, condition, content FROM filterConditions "
-                      "WHERE idFilter=='%1'").arg(filterId));
-      while (q1.next()) {
-        if (!qStr1.isNull()) qStr1.append(qStr2);
-        QString content = q1.value(2).toString().replace("'", "''");
-        switch (q1.value(0).toInt()) {
-        case 0: // field -> Title
-          switch (q1.value(1).toInt()) {
-          case 0: // condition -> contains
-            qStr1.append(QString("UPPER(title) LIKE '%%1%' ").arg(content.toUpper()));
-            break;
-          case 1: // condition -> doesn't contains
-            qStr1.append(QString("UPPER(title) NOT LIKE '%%1%' ").arg(content.toUpper()));
-            break;
-          case 2: // condition -> is
-            qStr1.append(QString("UPPER(title) LIKE '%1' ").arg(content.toUpper()));
-            break;
-          case 3: // condition -> isn't
-            qStr1.append(QString("UPPER(title) NOT LIKE '%1' ").arg(content.toUpper()));
-            break;
-          case 4: // condition -> begins with
-            qStr1.append(QString("UPPER(title) LIKE '%1%' ").arg(content.toUpper()));
-            break;
-          case 5: // condition -> ends with
-            qStr1.append(QString("UPPER(title) LIKE '%%1' ").arg(content.toUpper()));
-            break;
-          case 6: // condition -> regExp
-            qStr1.append(QString("title REGEXP '%1' ").arg(content));
-            break;
-          }
-          break;
-        case 1: // field -> Description
-          switch (q1.value(1).toInt()) {
-          case 0: // condition -> contains
-            qStr1.append(QString("UPPER(description) LIKE '%%1%' ").arg(content.toUpper()));
-            break;
-          case 1: // condition -> doesn't contains
-            qStr1.append(QString("UPPER(description) NOT LIKE '%%1%' ").arg(content.toUpper()));
-            break;
-          case 2: // condition -> regExp
-            qStr1.append(QString("description REGEXP '%1' ").arg(content));
-            break;
-          }
-          break;
-        case 2: // field -> Author
-          switch (q1.value(1).toInt()) {
-          case 0: // condition -> contains
-            qStr1.append(QString("UPPER(author_name) LIKE '%%1%' ").arg(content.toUpper()));
-            break;
-          case 1: // condition -> doesn't contains
-            qStr1.append(QString("UPPER(author_name) NOT LIKE '%%1%' ").arg(content.toUpper()));
-            break;
-          case 2: // condition -> is
-            qStr1.append(QString("UPPER(author_name) LIKE '%1' ").arg(content.toUpper()));
-            break;
-          case 3: // condition -> isn't
-            qStr1.append(QString("UPPER(author_name) NOT LIKE '%1' ").arg(content.toUpper()));
-            break;
-          case 4: // condition -> regExp
-            qStr1.append(QString("author_name REGEXP '%1' ").arg(content));
-            break;
-          }
-          break;
-        case 3: // field -> Category
-          switch (q1.value(1).toInt()) {
-          case 0: // condition -> contains
-            qStr1.append(QString("UPPER(category) LIKE '%%1%' ").arg(content.toUpper()));
-            break;
-          case 1: // condition -> doesn't contains
-            qStr1.append(QString("UPPER(category) NOT LIKE '%%1%' ").arg(content.toUpper()));
-            break;
-          case 2: // condition -> is
-            qStr1.append(QString("UPPER(category) LIKE '%1' ").arg(content.toUpper()));
-            break;
-          case 3: // condition -> isn't
-            qStr1.append(QString("UPPER(category) NOT LIKE '%1' ").arg(content.toUpper()));
-            break;
-          case 4: // condition -> begins with
-            qStr1.append(QString("UPPER(category) LIKE '%1%' ").arg(content.toUpper()));
-            break;
-          case 5: // condition -> ends with
-            qStr1.append(QString("UPPER(category) LIKE '%%1' ").arg(content.toUpper()));
-            break;
-          case 6: // condition -> regExp
-            qStr1.append(QString("category REGEXP '%1' ").arg(content));
-            break;
-          }
-          break;
-        case 4: // field -> Status
-          if (q1.value(1).toInt() == 0) { // Status -> is
-            switch (q1.value(2).toInt()) {
-            case 0:
-              qStr1.append("new==1 ");
-              break;
-            case 1:
-              qStr1.append("read>=1 ");
-              break;
-            case 2:
-              qStr1.append("starred==1 ");
-              break;
-            }
-          } else { // Status -> isn't
-            switch (q1.value(2).toInt()) {
-            case 0:
-              qStr1.append("new==0 ");
-              break;
-            case 1:
-              qStr1.append("read==0 ");
-              break;
-            case 2:
-              qStr1.append("starred==0 ");
-              break;
-            }
-          }
-          break;
-        case 5: // field -> Link
-          switch (q1.value(1).toInt()) {
-          case 0: // condition -> contains
-            qStr1.append(QString("link_href LIKE '%%1%' ").arg(content));
-            break;
-          case 1: // condition -> doesn't contains
-            qStr1.append(QString("link_href NOT LIKE '%%1%' ").arg(content));
-            break;
-          case 2: // condition -> is
-            qStr1.append(QString("link_href LIKE '%1' ").arg(content));
-            break;
-          case 3: // condition -> isn't
-            qStr1.append(QString("link_href NOT LIKE '%1' ").arg(content));
-            break;
-          case 4: // condition -> begins with
-            qStr1.append(QString("link_href LIKE '%1%' ").arg(content));
-            break;
-          case 5: // condition -> ends with
-            qStr1.append(QString("link_href LIKE '%%1' ").arg(content));
-            break;
-          case 6: // condition -> regExp
-            qStr1.append(QString("link_href REGEXP '%1' ").arg(content));
-            break;
-          }
-          break;
-        case 6: // field -> News
-          switch (q1.value(1).toInt()) {
-          case 0: // condition -> contains
-            qStr1.append(QString("(UPPER(title) LIKE '%%1%' OR UPPER(description) LIKE '%%1%') ").arg(content.toUpper()));
-            break;
-          case 1: // condition -> doesn't contains
-            qStr1.append(QString("(UPPER(title) NOT LIKE '%%1%' OR UPPER(description) NOT LIKE '%%1%') ").arg(content.toUpper()));
-            break;
-          case 2: // condition -> regExp
-            qStr1.append(QString("(title REGEXP '%1' OR description REGEXP '%1') ").arg(content));
-            break;
-          }
-          break;
-        }
+  q.exec("SELECT idFilter, field, condition, content FROM filterConditions ORDER BY id");
+  while (q.next()) {
+    int index = filterIndex.value(q.value(0).toInt(), -1);
+    if (index == -1) continue;
+    UserFilterStruct &filter = userFilters_[index];
+    if ((filter.type != 1) && (filter.type != 2)) continue;
+
+    if (!filterMatcher_.addCondition(index, q.value(1).toInt(), q.value(2).toInt(),
+                                     q.value(3).toString()))
+      filter.matcherReady = false;
+
+    QString content = q.value(3).toString().replace("'", "''");
+    QString str = filterConditionStr(q.value(1).toInt(), q.value(2).toInt(), content);
+    if (!filter.conditionStr.isNull())
+      filter.conditionStr.append((filter.type == 1) ? "AND " : "OR ");
+    filter.conditionStr.append(str);
+  }
+  filterMatcher_.compile();
+
+  userFiltersLoaded_ = true;
+}
+
+/** @brief Drop cached user filters after changes in filters dialog
+ *---------------------------------------------------------------------------*/
+void ParseObject::reloadUserFilters()
+{
+  userFiltersLoaded_ = false;
+}
+
+/** @brief Apply user filters to news stored in base
+ *
+ * Job is run in chunks of news between writes of received feeds.
+ * @param feedId - Feed Id
+ * @param filterId - Id of particular filter
+ *---------------------------------------------------------------------------*/
+void ParseObject::runUserFilter(int feedId, int filterId)
+{
+  // Filter can be changed in opened filters dialog before applying
+  if (filterId != -1)
+    userFiltersLoaded_ = false;
+
+  foreach (const FilterJobStruct &job, filterJobs_) {
+    if ((job.feedId == feedId) && (job.filterId == filterId) && (job.lastNewsId == 0))
+      return;
+  }
+
+  FilterJobStruct job;
+  job.feedId = feedId;
+  job.filterId = filterId;
+  job.lastNewsId = 0;
+  job.matched = false;
+  filterJobs_.enqueue(job);
+
+  QSqlQuery q = queries_.query("SELECT count(id) FROM news WHERE feedId=? AND deleted=0");
+  q.addBindValue(feedId);
+  q.exec();
+  if (q.first())
+    filterJobsTotal_ += q.value(0).toInt();
+  q.finish();
+
+  if (!filterJobTimer_->isActive())
+    filterJobTimer_->start(0);
+}
+
+/** @brief Stop applying of filters to stored news
+ *---------------------------------------------------------------------------*/
+void ParseObject::cancelUserFilters()
+{
+  if (filterJobs_.isEmpty()) return;
+
+  filterJobTimer_->stop();
+  while (!filterJobs_.isEmpty()) {
+    FilterJobStruct job = filterJobs_.dequeue();
+    if (job.lastNewsId > 0)
+      emit signalUserFilterFinished(job.feedId);
+  }
+  filterJobsTotal_ = 0;
+  filterJobsProcessed_ = 0;
+  emit signalUserFilterProgress(0, 0);
+}
+
+/** @brief Apply first queued filter job to next chunk of news
+ *---------------------------------------------------------------------------*/
+void ParseObject::runFilterJob()
+{
+  if (filterJobs_.isEmpty()) return;
+
+  // Received feeds are written first
+  if (currentFeedId_ || (parsedCount_ > 0)) {
+    filterJobTimer_->start(FILTER_JOB_YIELD_TIME);
+    return;
+  }
+
+  if (!userFiltersLoaded_)
+    loadUserFilters();
+
+  FilterJobStruct &job = filterJobs_.head();
+
+  // Last id of chunk, range is open if less news is left
+  qlonglong endNewsId = 0;
+  int chunkCount = FILTER_JOB_CHUNK;
+  QSqlQuery q = queries_.query("SELECT id FROM news WHERE feedId=? AND deleted=0 AND id>? "
+                               "ORDER BY id LIMIT 1 OFFSET ?");
+  q.addBindValue(job.feedId);
+  q.addBindValue(job.lastNewsId);
+  q.addBindValue(FILTER_JOB_CHUNK - 1);
+  q.exec();
+  if (q.first())
+    endNewsId = q.value(0).toLongLong();
+  q.finish();
+  if (!endNewsId) {
+    q = queries_.query("SELECT count(id), max(id) FROM news WHERE feedId=? AND deleted=0 AND id>?");
+    q.addBindValue(job.feedId);
+    q.addBindValue(job.lastNewsId);
+    q.exec();
+    if (q.first()) {
+      chunkCount = q.value(0).toInt();
+      endNewsId = q.value(1).toLongLong();
+    }
+    q.finish();
+  }
+
+  bool isFinished = (chunkCount < FILTER_JOB_CHUNK) || !endNewsId;
+  if (endNewsId) {
+    QString rangeStr = QString(" AND id>%1 AND id<=%2").arg(job.lastNewsId).arg(endNewsId);
+    bool isAllFilters = (job.filterId == -1);
+
+    db_.transaction();
+    foreach (const UserFilterStruct &filter, userFilters_) {
+      if (isAllFilters) {
+        if (!filter.enable) continue;
+      } else if (filter.id != job.filterId) {
+        continue;
+      }
+      if (!filter.feeds.contains(job.feedId)) continue;
+
+      if (applyUserFilter(filter, job.feedId, rangeStr) && !job.matched) {
+        job.matched = true;
+        if (!filter.soundList.isEmpty())
+          emit signalPlaySound(filter.soundList.at(0));
       }
-      whereStr.append(qStr1).append(")");
     }
+    db_.commit();
+    job.lastNewsId = endNewsId;
+  }
 
-    if (q1.exec(QString("SELECT id, label FROM news").append(whereStr))) {
-      QSqlQuery q2(db_);
-      bool isPlaySound = false;
-
-      while (q1.next()) {
-        if (!qStr.isEmpty()) {
-          qStr1 = qStr % QString(" WHERE id='%1'").arg(q1.value(0).toInt());
-          if (!q2.exec(qStr1)) {
-            qWarning() << __PRETTY_FUNCTION__ << __LINE__
-                       << "q.lastError(): " << q2.lastError().text();
-          }
-        }
+  filterJobsProcessed_ += chunkCount;
+  emit signalUserFilterProgress(filterJobsProcessed_, filterJobsTotal_);
+
+  if (isFinished) {
+    int feedId = job.feedId;
+    filterJobs_.dequeue();
+    emit signalUserFilterFinished(feedId);
+    if (filterJobs_.isEmpty()) {
+      filterJobsTotal_ = 0;
+      filterJobsProcessed_ = 0;
+      return;
+    }
+  }
+  filterJobTimer_->start(FILTER_JOB_INTERVAL);
+}
+
+/** @brief Apply cached user filters to news of feed
+ * @param feedId - Feed Id
+ * @param filterId - Id of particular filter, -1 for all enabled filters
+ * @param firstNewsId - Apply only to news with id from this one (0 - to all)
+ *---------------------------------------------------------------------------*/
+void ParseObject::applyUserFilters(int feedId, int filterId, qlonglong firstNewsId)
+{
+  if (!userFiltersLoaded_)
+    loadUserFilters();
+
+  bool isAllFilters = (filterId == -1);
+
+  foreach (const UserFilterStruct &filter, userFilters_) {
+    if (isAllFilters) {
+      if (!filter.enable) continue;
+    } else if (filter.id != filterId) {
+      continue;
+    }
+    if (!filter.feeds.contains(feedId)) continue;
+
+    QString rangeStr;
+    if (firstNewsId > 0)
+      rangeStr = QString(" AND id>=%1").arg(firstNewsId);
+    if (applyUserFilter(filter, feedId, rangeStr) && !filter.soundList.isEmpty())
+      emit signalPlaySound(filter.soundList.at(0));
+  }
+}
+
+/** @brief Select filters checked on news of parsed feed before insert
+ *
+ * SQL conditions are used for all filters of feed if one of them has
+ * condition not supported by FilterMatcher, so filters keep their order.
+ *---------------------------------------------------------------------------*/
+void ParseObject::prepareIngestFilters()
+{
+  if (!userFiltersLoaded_)
+    loadUserFilters();
+
+  ingestFilters_.clear();
+  ingestMatches_.clear();
+  ingestMatcher_ = true;
+  for (int i = 0; i < userFilters_.count(); ++i) {
+    const UserFilterStruct &filter = userFilters_.at(i);
+    if (!filter.enable || !filter.feeds.contains(parseFeedId_)) continue;
+    if (!filter.matcherReady) {
+      ingestMatcher_ = false;
+      ingestFilters_.clear();
+      return;
+    }
+    ingestFilters_.append(i);
+  }
+}
+
+/** @brief Check filters on news being inserted
+ *
+ * Actions of matched filter change state seen by next filters, as if
+ * they were applied one by one.
+ *---------------------------------------------------------------------------*/
+void ParseObject::matchIngestFilters(qlonglong newsId, const PendingNewsStruct &pending)
+{
+  FilterMatcher::Item item;
+  item.title = pending.news.title;
+  item.description = pending.news.description;
+  item.author = pending.news.author;
+  item.category = pending.news.category;
+  item.link = pending.news.link;
+  item.isNew = !pending.read;
+  item.isRead = pending.read;
+  item.isStarred = false;
+  filterMatcher_.scan(item);
+
+  foreach (int index, ingestFilters_) {
+    if (!filterMatcher_.matches(index, item)) continue;
+    ingestMatches_[index].append(newsId);
+
+    const UserFilterStruct &filter = userFilters_.at(index);
+    if (filter.markRead || filter.deleteNews) {
+      item.isNew = false;
+      item.isRead = true;
+    }
+    if (filter.addStar)
+      item.isStarred = true;
+    if (filter.deleteNews)
+      break;
+  }
+}
+
+/** @brief Apply actions of filters to news matched before insert
+ *---------------------------------------------------------------------------*/
+void ParseObject::applyIngestFilters()
+{
+  foreach (int index, ingestFilters_) {
+    const QList<qlonglong> newsIds = ingestMatches_.value(index);
+    if (newsIds.isEmpty()) continue;
+
+    QStringList idList;
+    foreach (qlonglong newsId, newsIds)
+      idList.append(QString::number(newsId));
+    const UserFilterStruct &filter = userFilters_.at(index);
+    QString rangeStr = QString(" AND id IN (%1)").arg(idList.join(","));
+    if (applyUserFilter(filter, parseFeedId_, rangeStr, false) && !filter.soundList.isEmpty())
+      emit signalPlaySound(filter.soundList.at(0));
+  }
+  ingestMatches_.clear();
+}
+
+/** @brief Apply actions of filter to news of feed matching its conditions
+ * @param rangeStr - Condition limiting range of news id
+ * @param checkConditions - false if news in range are already matched
+ * @return true if filter matched any news
+ *---------------------------------------------------------------------------*/
+bool ParseObject::applyUserFilter(const UserFilterStruct &filter, int feedId,
+                                  const QString &rangeStr, bool checkConditions)
+{
+  QStringList setList;
+  if (filter.markRead || filter.deleteNews)
+    setList.append("new=0, read=2");
+  if (filter.addStar)
+    setList.append("starred=1");
+  if (filter.deleteNews) {
+    setList.append(QString("deleted=1, deleteDate='%1'").
+                   arg(QDateTime::currentDateTime().toString(Qt::ISODate)));
+  }
+  QString qStr;
+  if (!setList.isEmpty())
+    qStr = "UPDATE news SET " % setList.join(", ");
+
+  QString whereStr = QString(" WHERE feedId='%1' AND deleted=0").arg(feedId);
+  whereStr.append(rangeStr);
+  if (checkConditions && ((filter.type == 1) || (filter.type == 2)))
+    whereStr.append(" AND ( ").append(filter.conditionStr).append(")");
+
+  bool matched = false;
+  QSqlQuery q1(db_);
+  if (q1.exec(QString("SELECT id, label FROM news").append(whereStr))) {
+    QSqlQuery q2;
+    // actions statement depends on filter, so it is prepared once per run
+    QSqlQuery q3(db_);
+    if (!qStr.isEmpty())
+      q3.prepare(qStr % " WHERE id=?");
 
-        if (!idLabelsList.isEmpty()) {
-          QString idLabelsStr = q1.value(1).toString();
-          foreach (int idLabel, idLabelsList) {
-            if (idLabelsStr.contains(QString(",%1,").arg(idLabel))) continue;
-            if (idLabelsStr.isEmpty()) idLabelsStr.append(",");
-            idLabelsStr.append(QString("%1,").arg(idLabel));
-
-          }
-          qStr1 = QString("UPDATE news SET label='%1' WHERE id='%2'").arg(idLabelsStr).
-              arg(q1.value(0).toInt());
-          if (!q2.exec(qStr1)) {
-            qWarning() << __PRETTY_FUNCTION__ << __LINE__
-                       << "q.lastError(): " << q2.lastError().text();
-          }
+    while (q1.next()) {
+      if (!qStr.isEmpty()) {
+        q3.addBindValue(q1.value(0).toInt());
+        if (!q3.exec()) {
+          qWarning() << __PRETTY_FUNCTION__ << __LINE__
+                     << "q.lastError(): " << q3.lastError().text();
         }
+      }
 
-        if (!colorList.isEmpty()) {
-          emit signalAddColorList(q1.value(0).toInt(), colorList.at(0));
+      if (!filter.idLabelsList.isEmpty()) {
+        QString idLabelsStr = q1.value(1).toString();
+        foreach (int idLabel, filter.idLabelsList) {
+          if (idLabelsStr.contains(QString(",%1,").arg(idLabel))) continue;
+          if (idLabelsStr.isEmpty()) idLabelsStr.append(",");
+          idLabelsStr.append(QString("%1,").arg(idLabel));
+
+        }
+        q2 = queries_.query("UPDATE news SET label=? WHERE id=?");
+        q2.addBindValue(idLabelsStr);
+        q2.addBindValue(q1.value(0).toInt());
+        if (!q2.exec()) {
+          qWarning() << __PRETTY_FUNCTION__ << __LINE__
+                     << "q.lastError(): " << q2.lastError().text();
         }
+      }
 
-        isPlaySound = true;
+      if (!filter.colorList.isEmpty()) {
+        emit signalAddColorList(q1.value(0).toInt(), filter.colorList.at(0));
       }
 
-      if (isPlaySound && !soundList.isEmpty())
-        emit signalPlaySound(soundList.at(0));
-    } else {
-      qWarning() << __PRETTY_FUNCTION__ << __LINE__
-                 << "q.lastError(): " << q1.lastError().text();
+      matched = true;
     }
+  } else {
+    qWarning() << __PRETTY_FUNCTION__ << __LINE__
+               << "q.lastError(): " << q1.lastError().text();
+  }
+  return matched;
+}
+
+/** @brief Load data shown by notification window about new news of feed
+ *
+ * Data is loaded here in one transaction with news, so window is built
+ * without queries of GUI thread.
+ *----------------------------------------------------------------------------*/
+NotificationFeedStruct ParseObject::loadNotification(int feedId, int newCount)
+{
+  NotificationFeedStruct notification;
+  notification.feedId = feedId;
+  notification.newCount = newCount;
+
+  QSqlQuery q = queries_.query("SELECT text, (SELECT image FROM feedsIcons WHERE feedId=feeds.id) "
+                               "FROM feeds WHERE id=?");
+  q.addBindValue(feedId);
+  q.exec();
+  if (q.first()) {
+    notification.title = q.value(0).toString();
+    QByteArray byteArray = q.value(1).toByteArray();
+    if (!byteArray.isNull())
+      notification.icon.loadFromData(QByteArray::fromBase64(byteArray));
+  }
+  q.finish();
 
+  q = queries_.query("SELECT id, title, link_href, link_alternate, snippet FROM news "
+                     "WHERE new=1 AND feedId=? ORDER BY received DESC LIMIT ?");
+  q.addBindValue(feedId);
+  q.addBindValue(NOTIFICATION_FEED_NEWS);
+  q.exec();
+  while (q.next()) {
+    NotificationNewsStruct news;
+    news.newsId = q.value(0).toInt();
+    news.title = q.value(1).toString();
+    news.link = q.value(2).toString();
+    if (news.link.isEmpty())
+      news.link = q.value(3).toString();
+    news.snippet = q.value(4).toString();
+    notification.news.append(news);
   }
+  q.finish();
+  return notification;
 }
 
 /** @brief Update feed counts and all its parent categories
@@ -1230,54 +2557,46 @@ void ParseObject::runUserFilter(int feedId, int filterId)
 int ParseObject::recountFeedCounts(int feedId, const QString &feedUrl,
                                    const QString &updated, const QString &lastBuildDate)
 {
-  QSqlQuery q(db_);
-  q.setForwardOnly(true);
-  QString qStr;
+  QSqlQuery q;
   QString htmlUrl;
   QString title;
 
   int feedParId = 0;
-  q.exec(QString("SELECT parentId, htmlUrl, title FROM feeds WHERE id=='%1'").arg(feedId));
+  int unreadCountOld = 0;
+  int newCountOld = 0;
+  int undeleteCountOld = 0;
+  q = queries_.query("SELECT parentId, htmlUrl, title, "
+                     "feedsState.unread, feedsState.newCount, feedsState.undeleteCount "
+                     "FROM feeds LEFT JOIN feedsState ON feedsState.feedId=feeds.id WHERE id=?");
+  q.addBindValue(feedId);
+  q.exec();
   if (q.first()) {
     feedParId = q.value(0).toInt();
     htmlUrl = q.value(1).toString();
     title = q.value(2).toString();
+    unreadCountOld = q.value(3).toInt();
+    newCountOld = q.value(4).toInt();
+    undeleteCountOld = q.value(5).toInt();
   }
+  q.finish();
 
   FeedCountStruct counts;
   int undeleteCount = 0;
   int unreadCount = 0;
   int newNewsCount = 0;
 
-  // Count all news (not marked Deleted)
-  qStr = QString("SELECT count(id) FROM news WHERE feedId=='%1' AND deleted==0").
-      arg(feedId);
-  q.exec(qStr);
-  if (q.first()) undeleteCount = q.value(0).toInt();
-
-  // Count unread news
-  qStr = QString("SELECT count(read) FROM news WHERE feedId=='%1' AND read==0 AND deleted==0").
-      arg(feedId);
-  q.exec(qStr);
-  if (q.first()) unreadCount = q.value(0).toInt();
-
-  // Count new news
-  qStr = QString("SELECT count(new) FROM news WHERE feedId=='%1' AND new==1 AND deleted==0").
-      arg(feedId);
-  q.exec(qStr);
-  if (q.first()) newNewsCount = q.value(0).toInt();
-
-  int unreadCountOld = 0;
-  int newCountOld = 0;
-  int undeleteCountOld = 0;
-  qStr = QString("SELECT unread, newCount, undeleteCount FROM feeds WHERE id=='%1'").
-      arg(feedId);
-  q.exec(qStr);
-  if (q.first()) {
-    unreadCountOld = q.value(0).toInt();
-    newCountOld = q.value(1).toInt();
-    undeleteCountOld = q.value(2).toInt();
+  // Count all (not marked Deleted), unread and new news in one pass
+  SQLiteStatement *statement = queries_.statement(
+        "SELECT count(id), sum(CASE WHEN read==0 THEN 1 ELSE 0 END), "
+        "sum(CASE WHEN new==1 THEN 1 ELSE 0 END) "
+        "FROM news WHERE feedId=? AND deleted==0");
+  statement->bind(1, feedId);
+  if (statement->next()) {
+    undeleteCount = statement->intValue(0);
+    unreadCount = statement->intValue(1);
+    newNewsCount = statement->intValue(2);
   }
+  statement->reset();
 
   if ((unreadCount == unreadCountOld) && (newNewsCount == newCountOld) &&
       (undeleteCount == undeleteCountOld)) {
@@ -1293,10 +2612,12 @@ int ParseObject::recountFeedCounts(int feedId, const QString &feedUrl,
   }
 
   // Set number unread, new and all(undelete) news for feed
-  qStr = QString("UPDATE feeds SET unread='%1', newCount='%2', undeleteCount='%3' "
-                 "WHERE id=='%4'").
-      arg(unreadCount).arg(newNewsCount).arg(undeleteCount).arg(feedId);
-  q.exec(qStr);
+  q = queries_.query("UPDATE feedsState SET unread=?, newCount=?, undeleteCount=? WHERE feedId=?");
+  q.addBindValue(unreadCount);
+  q.addBindValue(newNewsCount);
+  q.addBindValue(undeleteCount);
+  q.addBindValue(feedId);
+  q.exec();
 
   counts.feedId = feedId;
   counts.unreadCount = unreadCount;
@@ -1308,43 +2629,53 @@ int ParseObject::recountFeedCounts(int feedId, const QString &feedUrl,
   counts.xmlUrl = feedUrl;
   counts.title = title;
 
-  emit feedCountsUpdate(counts);
-
-  // Recount counters for all feed parents
-  int l_feedParId = feedParId;
-  while (l_feedParId) {
-    QString updatedParent;
-    int newCount = 0;
-
-    qStr = QString("SELECT sum(unread), sum(newCount), sum(undeleteCount), "
-                   "max(updated) FROM feeds WHERE parentId=='%1'").
-        arg(l_feedParId);
-    q.exec(qStr);
-    if (q.first()) {
-      unreadCount   = q.value(0).toInt();
-      newCount      = q.value(1).toInt();
-      undeleteCount = q.value(2).toInt();
-      updatedParent = q.value(3).toString();
+  QList<FeedCountStruct> countsList;
+  countsList.append(counts);
+
+  // Add counters delta to all feed parents
+  if (feedParId) {
+    const QString parentsStr(
+          "WITH RECURSIVE parents(id) AS ("
+          "SELECT ? UNION ALL "
+          "SELECT feeds.parentId FROM feeds, parents "
+          "WHERE feeds.id=parents.id AND feeds.parentId>0) "
+          "SELECT id FROM parents");
+
+    q = queries_.query("UPDATE feedsState SET unread=unread+?, newCount=newCount+?, "
+                       "undeleteCount=undeleteCount+? "
+                       "WHERE feedId IN (" % parentsStr % ")");
+    q.addBindValue(unreadCount - unreadCountOld);
+    q.addBindValue(newNewsCount - newCountOld);
+    q.addBindValue(undeleteCount - undeleteCountOld);
+    q.addBindValue(feedParId);
+    q.exec();
+
+    // Row of folder is written only if its update time changes
+    q = queries_.query("UPDATE feeds SET updated=? "
+                       "WHERE id IN (" % parentsStr % ") AND ifnull(updated, '')<?");
+    q.addBindValue(updated);
+    q.addBindValue(feedParId);
+    q.addBindValue(updated);
+    q.exec();
+
+    q = queries_.query("SELECT id, feedsState.unread, feedsState.newCount, "
+                       "feedsState.undeleteCount, updated "
+                       "FROM feeds LEFT JOIN feedsState ON feedsState.feedId=feeds.id "
+                       "WHERE id IN (" % parentsStr % ")");
+    q.addBindValue(feedParId);
+    q.exec();
+    while (q.next()) {
+      FeedCountStruct parentCounts;
+      parentCounts.feedId = q.value(0).toInt();
+      parentCounts.unreadCount = q.value(1).toInt();
+      parentCounts.newCount = q.value(2).toInt();
+      parentCounts.undeleteCount = q.value(3).toInt();
+      parentCounts.updated = q.value(4).toString();
+      countsList.append(parentCounts);
     }
-    qStr = QString("UPDATE feeds SET unread='%1', newCount='%2', undeleteCount='%3', "
-                   "updated='%4' WHERE id=='%5'").
-        arg(unreadCount).arg(newCount).arg(undeleteCount).arg(updatedParent).
-        arg(l_feedParId);
-    q.exec(qStr);
-
-    FeedCountStruct counts;
-    counts.feedId = l_feedParId;
-
-    q.exec(QString("SELECT parentId FROM feeds WHERE id==%1").arg(l_feedParId));
-    if (q.first()) l_feedParId = q.value(0).toInt();
-
-    counts.unreadCount = unreadCount;
-    counts.newCount = newCount;
-    counts.undeleteCount = undeleteCount;
-    counts.updated = updatedParent;
-
-    emit feedCountsUpdate(counts);
   }
 
+  emit feedsCountsUpdate(countsList);
+
   return (newNewsCount - newCountOld);
 }
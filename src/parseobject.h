@@ -21,39 +21,23 @@
 #include <QtSql>
 #include <QDateTime>
 #include <QDomDocument>
+#include <QElapsedTimer>
+#include <QImage>
 #include <QQueue>
 #include <QObject>
+#include <QSet>
 #include <QUrl>
 
-struct FeedItemStruct {
-  QString title;
-  QString updated;
-  QString link;
-  QString linkBase;
-  QString language;
-  QString author;
-  QString authorUri;
-  QString authorEmail;
-  QString description;
-};
+#include "filtermatcher.h"
+#include "parseworker.h"
+#include "querycache.h"
+#include "requestfeed.h"
 
-struct NewsItemStruct {
-  QString id;
-  QString title;
-  QString updated;
-  QString link;
-  QString linkAlternate;
-  QString language;
-  QString author;
-  QString authorUri;
-  QString authorEmail;
-  QString description;
-  QString content;
-  QString category;
-  QString eUrl;
-  QString eType;
-  QString eLength;
-  QString comments;
+struct PendingNewsStruct {
+  NewsItemStruct news;
+  QString received;
+  bool read;
+  qlonglong clusterId;  // first news of same story in other feed, 0 if none
 };
 
 struct FeedCountStruct{
@@ -70,62 +54,259 @@ struct FeedCountStruct{
 
 Q_DECLARE_METATYPE(FeedCountStruct)
 
+struct CategoryCountStruct {
+  int allStarredCount;
+  int unreadStarredCount;
+  int deletedCount;
+  QHash<int,int> allLabelCount;
+  QHash<int,int> unreadLabelCount;
+};
+
+Q_DECLARE_METATYPE(CategoryCountStruct)
+
+struct NotificationNewsStruct {
+  int newsId;
+  QString title;
+  QString snippet;
+  QString link;
+};
+
+//! New news of feed shown by notification window
+struct NotificationFeedStruct {
+  int feedId;
+  QString title;
+  QImage icon;
+  int newCount;
+  QList<NotificationNewsStruct> news;
+};
+
+Q_DECLARE_METATYPE(NotificationFeedStruct)
+
+struct UserFilterStruct {
+  int id;
+  bool enable;
+  int type;
+  QSet<int> feeds;
+  bool markRead;
+  bool addStar;
+  bool deleteNews;
+  QList<int> idLabelsList;
+  QStringList soundList;
+  QStringList colorList;
+  QString conditionStr;
+  bool matcherReady;      // all conditions are checked by FilterMatcher
+};
+
+//! Applying of filter to news stored in base, see runUserFilter()
+struct FilterJobStruct {
+  int feedId;
+  int filterId;
+  qlonglong lastNewsId;
+  bool matched;
+};
+
 class ParseObject : public QObject
 {
   Q_OBJECT
+  // Date parsing is timed by micro-benchmark
+  friend class KernelBenchmark;
 public:
-  explicit ParseObject(QObject *parent = 0);
+  explicit ParseObject(const QString &connectionName = QString("secondConnection"),
+                       QObject *parent = 0);
   ~ParseObject();
 
+  QString connectionName() const { return db_.connectionName(); }
   void disconnectObjects();
+  static void addNewsKeys(QSet<qint64> *digests, const QString &guid, const QString &title,
+                          const QString &published, const QString &link);
+  static QByteArray digestsData(const QSet<qint64> &digests);
+  static void readDigests(const QByteArray &data, QSet<qint64> *digests);
+  void setWorkers(const QList<ParseWorker *> &workers);
+  void internStatistics(qint64 *lookups, qint64 *shared, bool reset = false);
 
 public slots:
   void parseXml(QByteArray data, int feedId,
-                QDateTime dtReply, QString codecName);
+                QDateTime dtReply, QString codecName, QString etag = "",
+                int priority = RequestFeed::PriorityScheduled);
+  void parseFeed(const FetchedFeed &feed);
+  void parseSynced(const ParsedFeedStruct &parsedFeed);
+  void promoteFeed(int feedId);
   void runUserFilter(int feedId, int filterId = -1);
+  void cancelUserFilters();
+  void reloadUserFilters();
+  void saveArticle(int newsId, const QString &html);
 
 signals:
-  void signalReadyParse(const QByteArray &xml, const int &feedId,
-                        const QDateTime &dtReply, const QString &codecName);
+  void signalReadyParse(const ParsedFeedStruct &parsedFeed);
+  void signalQueueFull(bool full);
   void signalFinishUpdate(int feedId, bool changed, int newCount, QString status);
   void feedCountsUpdate(FeedCountStruct counts);
+  void feedsCountsUpdate(QList<FeedCountStruct> countsList);
   void signalPlaySound(const QString &soundPath);
   void signalAddColorList(int id, const QString &color);
+  void signalHubFound(int feedId, QString hubUrl, QString topicUrl);
+  void signalPrefetchImages(const QStringList &urls);
+  void signalFetchArticle(int newsId, const QString &link);
+  void signalDownloadEnclosure(int feedId, const QString &url,
+                               const QString &type, qint64 length);
+  void signalNotificationData(const NotificationFeedStruct &data);
+  void signalUserFilterProgress(int processed, int total);
+  void signalUserFilterFinished(int feedId);
 
 private slots:
   void getQueuedXml();
-  void slotParse(const QByteArray &xmlData, const int &feedId,
-                 const QDateTime &dtReply, const QString &codecName);
-  void addAtomNewsIntoBase(NewsItemStruct *newsItem);
-  void addRssNewsIntoBase(NewsItemStruct *newsItem);
+  void runFilterJob();
+  void saveStoredKeys();
+  void slotDecoded(const ParsedFeedStruct &parsedFeed);
+  void slotParse(const ParsedFeedStruct &parsedFeed);
+  bool addAtomNewsIntoBase(NewsItemStruct *newsItem);
+  bool addRssNewsIntoBase(NewsItemStruct *newsItem);
 
 private:
-  void parseAtom(const QString &feedUrl, const QDomDocument &doc);
-  void parseRss(const QString &feedUrl, const QDomDocument &doc);
+  void readNewsOptions();
+  void loadStoredNews();
+  void clearStoredNews();
+  void finishStoredNews();
+  bool hasKey(int kind, const QString &key1, const QString &key2 = QString()) const;
+  void saveFeedHorizon();
+  void commitBatch();
+  void addPendingNews(const NewsItemStruct &newsItem);
+  qlonglong findIdenticalNews(const NewsItemStruct &newsItem);
+  void insertPendingNews();
+  void collectImages(const NewsItemStruct &newsItem);
+  bool isParseFinished(bool isDuplicate, const QString &published);
+  bool readNextItems(const ParsedFeedStruct &parsedFeed, QList<QDomDocument> *itemDocs,
+                     QList<ParsedItemText> *itemTexts);
+  void parseAtom(const QString &feedUrl, const ParsedFeedStruct &parsedFeed);
+  void parseAtomFeedItem(const QString &feedUrl, const QDomElement &rootElem,
+                         FeedItemStruct *feedItemPtr);
+  bool parseAtomEntry(const QString &feedUrl, const QDomElement &entryElem,
+                      const ParsedItemText &itemText, const FeedItemStruct &feedItem);
+  void parseRss(const QString &feedUrl, const ParsedFeedStruct &parsedFeed);
+  void parseRssFeedItem(const QString &feedUrl, const QDomElement &channel,
+                        FeedItemStruct *feedItemPtr);
+  bool parseRssItem(const QString &feedUrl, const QDomElement &itemElem,
+                    const ParsedItemText &itemText);
+  void parseJson(const QString &feedUrl, const ParsedFeedStruct &parsedFeed);
+  void parseSyncItems(const QString &feedUrl, const ParsedFeedStruct &parsedFeed);
+  void applySyncState();
+  void findHub(const QString &feedUrl, const QDomElement &rootElem);
   QString toPlainText(const QString &text);
+  QString intern(const QString &value);
+  QString pooledPlainText(const QString &text);
   QString parseDate(const QString &dateString, const QString &urlString);
+  bool parseDateFast(const QString &dateString, QDateTime *dateTime);
   int recountFeedCounts(int feedId, const QString &feedUrl,
                         const QString &updated, const QString &lastBuildDate);
+  NotificationFeedStruct loadNotification(int feedId, int newCount);
+  void loadUserFilters();
+  void applyUserFilters(int feedId, int filterId, qlonglong firstNewsId);
+  bool applyUserFilter(const UserFilterStruct &filter, int feedId, const QString &rangeStr,
+                       bool checkConditions = true);
+  void prepareIngestFilters();
+  void matchIngestFilters(qlonglong newsId, const PendingNewsStruct &pending);
+  void applyIngestFilters();
 
   QSqlDatabase db_;
+  QueryCache queries_;
   QTimer *parseTimer_;
+  QElapsedTimer batchTimer_;
+  int batchCount_;
+  qint64 insertTime_;
+  QList<PendingNewsStruct> pendingNews_;
+  bool compressContent_;
+  bool prefetchImages_;
+  bool feedPrefetch_;
+  QStringList prefetchUrls_;
+  bool fetchArticles_;
+  bool feedArticles_;
+  QList<QPair<int, QString> > articleLinks_;
+  bool feedEnclosures_;
+  QList<NewsItemStruct> enclosureNews_;
   int currentFeedId_;
-  QQueue<int> idsQueue_;
-  QQueue<QByteArray> xmlsQueue_;
-  QQueue<QDateTime> dtReadyQueue_;
-  QQueue<QString> codecNameQueue_;
+  // Decoded feeds waiting for write, one queue per update class
+  QVector<QQueue<ParsedFeedStruct> > parsedQueues_;
+  int parsedCount_;
+  QHash<int, int> decodePriority_;
+  // Size of downloaded data which is not written to base yet
+  qint64 queuedBytes_;
+  qint64 queueMaxBytes_;
+  bool queueFull_;
+  QHash<int, qint64> feedBytes_;
+  // Field values met in current parse, see intern()
+  QSet<QString> internPool_;
+  QHash<QString, QString> plainTextPool_;
+  qint64 internLookups_;
+  qint64 internShared_;
+  QList<ParseWorker *> workers_;
+  QList<int> workersLoad_;
 
   int parseFeedId_;
+  int timeShift_;
   bool duplicateNewsMode_;
   bool feedChanged_;
   bool addSingleNewsAnyDate_;
   bool avoidedOldSingleNews_;
   QDate avoidedOldSingleNewsDate_;
+  // Options of main window, read from settings when it does not exist
+  bool markIdenticalNewsRead_;
+  bool groupIdenticalNews_;
+  bool avoidOldNews_;
+  QDate avoidedOldNewsDate_;
+  int duplicateCount_;
+  QString lastPublished_;
+  bool newestFirst_;
+  // Oldest date of parsed items and whether parse stopped before the end
+  QString oldestPublished_;
+  bool parseStopped_;
+  QHash<int, QString> feedHorizons_;
+  qlonglong firstNewsId_;
+
+  QList<UserFilterStruct> userFilters_;
+  bool userFiltersLoaded_;
+  // Filters of parsed feed checked on news before insert
+  FilterMatcher filterMatcher_;
+  bool ingestMatcher_;
+  QList<int> ingestFilters_;
+  QHash<int, QList<qlonglong> > ingestMatches_;
+  QQueue<FilterJobStruct> filterJobs_;
+  QTimer *filterJobTimer_;
+  int filterJobsTotal_;
+  int filterJobsProcessed_;
+
+  // Digests of keys of news stored in base for duplicates search. They are
+  // kept for recently parsed feeds and saved to newsKeys table, so long
+  // history of feed is not read on each update
+  enum NewsKeyKind {
+    KeyGuid = 1,
+    KeyLink,
+    KeyTitle,
+    KeyPublished,
+    KeyGuidPublished,
+    KeyGuidTitle,
+    KeyLinkPublished,
+    KeyLinkTitle,
+    KeyPublishedTitle
+  };
+  struct StoredKeysStruct {
+    QSet<qint64> digests;
+    int newsCount;         // news of feed in base, checked before use
+    qlonglong maxNewsId;
+    bool dirty;            // not saved to base
+  };
+  bool readSavedKeys(StoredKeysStruct *keys);
+  void writeStoredKeys();
+  void evictStoredKeys();
 
-  QStringList guidList_;
-  QStringList linkList_;
-  QStringList titleList_;
-  QStringList publishedList_;
+  int storedNewsCount_;
+  QHash<int, StoredKeysStruct> storedKeys_;
+  QList<int> storedKeysOrder_;  // least recently parsed feed first
+  int storedDigestsCount_;
+  const QSet<qint64> *currentDigests_;
+  QSet<qint64> insertedDigests_;
+  int insertedCount_;
+  qlonglong insertedMaxId_;
+  QTimer *saveKeysTimer_;
 
 };
 
@@ -0,0 +1,625 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "parseworker.h"
+
+#include "bytescan.h"
+#include "common.h"
+#include "eventtrace.h"
+#include "jsonreader.h"
+#include "logfile.h"
+#include "pipelinemetrics.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QTextCodec>
+#if QT_VERSION < 0x050000
+#include <QTextDocument>
+#endif
+
+// Bytes searched for XML prolog encoding
+#define ENCODING_PROLOG_SIZE 1024
+// Bytes used to guess encoding when it is not declared
+#define ENCODING_SNIFF_SIZE 4096
+// Characters of description kept as plain text preview of news
+#define NEWS_SNIPPET_LENGTH 200
+// Length of description text used for simhash of news
+#define NEWS_SIMHASH_LENGTH 4096
+// Items of XML feed read at once, more than known news which stop parsing
+#define ITEMS_CHUNK_SIZE 50
+
+ParseWorker::ParseWorker(QObject *parent)
+  : QObject(parent)
+{
+  setObjectName("parseWorker_");
+}
+
+void ParseWorker::disconnectObjects()
+{
+  disconnect(this);
+}
+
+/** @brief Decode xml-data and read feed with first chunk of its items
+ *----------------------------------------------------------------------------*/
+void ParseWorker::decodeFeed(const FetchedFeed &feed)
+{
+  int feedId = feed->feedId;
+  ParsedFeedStruct parsedFeed;
+  parsedFeed.feedId = feedId;
+  parsedFeed.dtReply = feed->dtReply;
+  parsedFeed.etag = feed->etag;
+
+  QElapsedTimer timer;
+  timer.start();
+  qint64 traceStart = EventTrace::now();
+  const QString &text = convertData(feed->data, feed->codecName, feedId);
+  PipelineMetrics::record(PipelineMetrics::Decode, timer.restart(), feedId);
+  EventTrace::complete(EventTrace::Decode, feedId, traceStart);
+  traceStart = EventTrace::now();
+  if (isJsonText(text)) {
+    parsedFeed.feedType = "json";
+    LOG_DEBUG(LogFile::Parse) << "Feed type: " << parsedFeed.feedType;
+    JsonReader json(text);
+    readJsonFeed(json, &parsedFeed);
+    if (json.hasError()) {
+      parsedFeed.error = QString("offset %1: %2").
+          arg(json.offset()).arg(json.errorString());
+    }
+  } else {
+    QSharedPointer<FeedItemReader> itemReader(new FeedItemReader(text));
+    parsedFeed.feedType = itemReader->readFeed(&parsedFeed.feedDoc);
+    if (!parsedFeed.feedType.isEmpty())
+      LOG_DEBUG(LogFile::Parse) << "Feed type: " << parsedFeed.feedType;
+    itemReader->readItems(&parsedFeed.itemDocs, &parsedFeed.itemTexts);
+    parsedFeed.error = itemReader->error();
+    if (!itemReader->atEnd())
+      parsedFeed.itemReader = itemReader;
+  }
+  PipelineMetrics::record(PipelineMetrics::Parse, timer.elapsed(), feedId);
+  EventTrace::complete(EventTrace::Parse, feedId, traceStart);
+
+  emit signalDecoded(parsedFeed);
+}
+
+/** @brief Free text buffer kept for next feed
+ *----------------------------------------------------------------------------*/
+void ParseWorker::releaseMemory()
+{
+  textBuffer_ = QString();
+}
+
+/** @brief Convert xml-data to unicode using declared or detected codec
+ *----------------------------------------------------------------------------*/
+const QString &ParseWorker::convertData(const QByteArray &xmlData, const QString &codecName,
+                                        int feedId)
+{
+  // Byte order mark
+  QTextCodec *codec = QTextCodec::codecForUtfText(xmlData, 0);
+  if (codec) {
+    LOG_DEBUG(LogFile::Parse) << "Codec name (BOM):" << codec->name();
+    return decode(codec, xmlData);
+  }
+
+  // Encoding declared in XML prolog
+  QByteArray prolog = xmlData.left(ENCODING_PROLOG_SIZE);
+  int prologEnd = prolog.indexOf("?>");
+  if (prologEnd != -1)
+    prolog.truncate(prologEnd);
+  int pos = prolog.indexOf("encoding=");
+  if (pos == -1)
+    pos = prolog.toLower().indexOf("encoding=");
+  if ((pos != -1) && (pos + 10 < prolog.size())) {
+    char quote = prolog.at(pos + 9);
+    int nameEnd = prolog.indexOf(quote, pos + 10);
+    if (((quote == '"') || (quote == '\'')) && (nameEnd != -1)) {
+      QByteArray codecNameT = prolog.mid(pos + 10, nameEnd - pos - 10);
+      LOG_DEBUG(LogFile::Parse) << "Codec name (1):" << codecNameT;
+      codec = QTextCodec::codecForName(codecNameT);
+      if (codec)
+        return decode(codec, xmlData);
+
+      qWarning() << "Codec not found (1): " << codecNameT << feedId;
+      textBuffer_ = QString(xmlData);
+      if (codecNameT.toLower().contains("us-ascii"))
+        textBuffer_.remove(QString::fromLatin1(prolog.mid(pos, nameEnd - pos + 1)));
+      return textBuffer_;
+    }
+  }
+
+  // Charset from HTTP header
+  if (!codecName.isEmpty()) {
+    LOG_DEBUG(LogFile::Parse) << "Codec name (2):" << codecName;
+    codec = QTextCodec::codecForName(codecName.toUtf8());
+    if (codec)
+      return decode(codec, xmlData);
+    qWarning() << "Codec not found (2): " << codecName << feedId;
+  }
+
+  // Guess codec. Whole data is checked for UTF-8, as invalid sequence can
+  // be far from beginning, other codecs are tried on beginning of data
+  if (ByteScan::isUtf8(xmlData.constData(), xmlData.size())) {
+    LOG_DEBUG(LogFile::Parse) << "Codec name (3): UTF-8";
+    return decode(QTextCodec::codecForMib(106), xmlData);
+  }
+  QString sample(xmlData.left(ENCODING_SNIFF_SIZE));
+  QStringList codecNameList;
+  codecNameList << "UTF-8" << "Windows-1251" << "KOI8-R" << "KOI8-U"
+                << "ISO 8859-5" << "IBM 866";
+  foreach (QString codecNameT, codecNameList) {
+    codec = QTextCodec::codecForName(codecNameT.toUtf8());
+    if (codec && codec->canEncode(sample)) {
+      LOG_DEBUG(LogFile::Parse) << "Codec name (3):" << codecNameT;
+      return decode(codec, xmlData);
+    }
+  }
+
+  textBuffer_ = QString::fromLocal8Bit(xmlData);
+  return textBuffer_;
+}
+
+/** @brief Check that \a codec encodes ASCII characters as ASCII bytes
+ *
+ * Codecs are checked by MIB: UTF-8, US-ASCII, ISO 8859, Windows-125x,
+ * KOI8 and IBM 866, which cover feeds in practice.
+ *----------------------------------------------------------------------------*/
+bool ParseWorker::isAsciiBased(QTextCodec *codec)
+{
+  int mib = codec->mibEnum();
+  return (mib == 106) || (mib == 3) || ((mib >= 4) && (mib <= 13)) ||
+      ((mib >= 109) && (mib <= 112)) || ((mib >= 2250) && (mib <= 2258)) ||
+      (mib == 2084) || (mib == 2086) || (mib == 2088);
+}
+
+/** @brief Convert \a xmlData with \a codec into text buffer of worker
+ *----------------------------------------------------------------------------*/
+const QString &ParseWorker::decode(QTextCodec *codec, const QByteArray &xmlData)
+{
+  // Only ASCII is the same text in all ASCII based codecs, it is widened
+  // without decoder
+  if (isAsciiBased(codec) && ByteScan::isAscii(xmlData.constData(), xmlData.size())) {
+    const char *data = xmlData.constData();
+    textBuffer_.resize(xmlData.size());
+    QChar *text = textBuffer_.data();
+    for (int i = 0; i < xmlData.size(); ++i)
+      text[i] = QLatin1Char(data[i]);
+    return textBuffer_;
+  }
+
+  QTextDecoder decoder(codec);
+  decoder.toUnicode(&textBuffer_, xmlData.constData(), xmlData.size());
+  return textBuffer_;
+}
+
+FeedItemReader::FeedItemReader(const QString &text)
+  : xml_(text)
+  , inChannel_(false)
+  , atItem_(false)
+  , atEnd_(false)
+{
+  xml_.setNamespaceProcessing(false);
+}
+
+/** @brief Read root element and feed elements before first item
+ *
+ * Feed element of Atom is the root one, of RSS it is the first channel.
+ * Elements of feed which follow items are not read.
+ * @return type of feed, empty if text is not XML
+ *----------------------------------------------------------------------------*/
+QString FeedItemReader::readFeed(QDomDocument *feedDoc)
+{
+  if (!xml_.readNextStartElement()) {
+    atEnd_ = true;
+    return QString();
+  }
+  feedType_ = xml_.qualifiedName().toString();
+
+  QDomElement feedElem;
+  if (feedType_ == "feed") {
+    feedElem = feedDoc->createElement(feedType_);
+    foreach (const QXmlStreamAttribute &attribute, xml_.attributes()) {
+      feedElem.setAttribute(attribute.qualifiedName().toString(), attribute.value().toString());
+    }
+    feedDoc->appendChild(feedElem);
+  } else if ((feedType_ != "rss") && (feedType_ != "rdf:RDF")) {
+    atEnd_ = true;
+    return feedType_;
+  }
+
+  bool isFirstChannel = false;
+  while (readNextChild()) {
+    if (isItem()) {
+      atItem_ = true;
+      return feedType_;
+    }
+    if (!inChannel_ && isChannel()) {
+      isFirstChannel = feedElem.isNull();
+      if (isFirstChannel) {
+        feedElem = feedDoc->createElement(xml_.qualifiedName().toString());
+        feedDoc->appendChild(feedElem);
+      }
+      inChannel_ = true;
+    } else if ((feedType_ == "feed") || (inChannel_ && isFirstChannel)) {
+      feedElem.appendChild(readElement(*feedDoc));
+    } else {
+      xml_.skipCurrentElement();
+    }
+  }
+  atEnd_ = true;
+  return feedType_;
+}
+
+/** @brief Read next chunk of items
+ * @return false if there are no items left
+ *----------------------------------------------------------------------------*/
+bool FeedItemReader::readItems(QList<QDomDocument> *itemDocs,
+                               QList<ParsedItemText> *itemTexts)
+{
+  int count = 0;
+  while (count < ITEMS_CHUNK_SIZE) {
+    QDomDocument itemDoc;
+    ParsedItemText itemText;
+    if (!readItem(&itemDoc, &itemText))
+      break;
+    itemDocs->append(itemDoc);
+    itemTexts->append(itemText);
+    count++;
+  }
+  return (count > 0);
+}
+
+QString FeedItemReader::error() const
+{
+  if (!xml_.hasError())
+    return QString();
+  return QString("line %1, column %2: %3").
+      arg(xml_.lineNumber()).arg(xml_.columnNumber()).arg(xml_.errorString());
+}
+
+/** @brief Move to next child element of root or of RSS channel
+ *
+ * Items of RSS 1.0 are placed next to channel, so root is read again
+ * after end of channel.
+ *----------------------------------------------------------------------------*/
+bool FeedItemReader::readNextChild()
+{
+  while (!xml_.readNextStartElement()) {
+    if (!inChannel_ || xml_.hasError())
+      return false;
+    inChannel_ = false;
+  }
+  return true;
+}
+
+bool FeedItemReader::isItem() const
+{
+  QStringRef name = xml_.qualifiedName();
+  if (feedType_ == "feed")
+    return (name == "entry");
+  return (name == "item") || (name == "rss:item");
+}
+
+bool FeedItemReader::isChannel() const
+{
+  QStringRef name = xml_.qualifiedName();
+  return (feedType_ != "feed") && ((name == "channel") || (name == "rss:channel"));
+}
+
+/** @brief Read next item into its own document and make plain text of it
+ *
+ * Only this item is parsed, the rest of feed is read by next calls.
+ * @return false if there are no items left
+ *----------------------------------------------------------------------------*/
+bool FeedItemReader::readItem(QDomDocument *itemDoc, ParsedItemText *itemText)
+{
+  if (atEnd_)
+    return false;
+  while (!atItem_) {
+    if (!readNextChild()) {
+      atEnd_ = true;
+      return false;
+    }
+    if (isItem())
+      atItem_ = true;
+    else if (!inChannel_ && isChannel())
+      inChannel_ = true;
+    else
+      xml_.skipCurrentElement();
+  }
+  atItem_ = false;
+
+  QDomElement itemElem = readElement(*itemDoc);
+  itemDoc->appendChild(itemElem);
+
+  FeedTags::Children children;
+  FeedTags::collect(itemElem, &children);
+
+  itemText->title = Common::htmlToPlainText(itemField(children, FeedTags::TagTitle,
+                                                      FeedTags::TagRssTitle));
+  QString description = itemField(children, FeedTags::TagDescription, FeedTags::TagSummary);
+  if (description.isEmpty())
+    description = itemField(children, FeedTags::TagContentEncoded, FeedTags::TagContent);
+  if (description.isEmpty())
+    description = itemField(children, FeedTags::TagRssDescription, FeedTags::TagMediaGroup);
+  itemText->snippet = Common::htmlToPlainText(description, NEWS_SNIPPET_LENGTH);
+  itemText->titleHash = Common::titleFingerprint(itemText->title);
+  itemText->simhash = Common::simHash(Common::htmlToPlainText(description, NEWS_SIMHASH_LENGTH));
+  return true;
+}
+
+/** @brief Read current element with all its children into \a doc
+ *----------------------------------------------------------------------------*/
+QDomElement FeedItemReader::readElement(QDomDocument &doc)
+{
+  QDomElement root = doc.createElement(xml_.qualifiedName().toString());
+  foreach (const QXmlStreamAttribute &attribute, xml_.attributes()) {
+    root.setAttribute(attribute.qualifiedName().toString(), attribute.value().toString());
+  }
+
+  QDomElement current = root;
+  int depth = 1;
+  while (depth && !xml_.atEnd()) {
+    switch (xml_.readNext()) {
+    case QXmlStreamReader::StartElement: {
+      QDomElement element = doc.createElement(xml_.qualifiedName().toString());
+      foreach (const QXmlStreamAttribute &attribute, xml_.attributes()) {
+        element.setAttribute(attribute.qualifiedName().toString(), attribute.value().toString());
+      }
+      current.appendChild(element);
+      current = element;
+      depth++;
+    }
+      break;
+    case QXmlStreamReader::EndElement:
+      current = current.parentNode().toElement();
+      depth--;
+      break;
+    case QXmlStreamReader::Characters:
+      if (xml_.isCDATA())
+        current.appendChild(doc.createCDATASection(xml_.text().toString()));
+      else if (!xml_.isWhitespace())
+        current.appendChild(doc.createTextNode(xml_.text().toString()));
+      break;
+    default:
+      break;
+    }
+  }
+  return root;
+}
+
+/** @brief Text of child element \a tag or \a altTag of item
+ *----------------------------------------------------------------------------*/
+QString FeedItemReader::itemField(const FeedTags::Children &children, FeedTags::Tag tag,
+                                  FeedTags::Tag altTag)
+{
+  QString text = children.text(tag);
+  if (text.isEmpty())
+    text = children.text(altTag);
+  return text;
+}
+
+/** @brief Check if decoded text is JSON, not XML
+ *----------------------------------------------------------------------------*/
+bool ParseWorker::isJsonText(const QString &text)
+{
+  for (int i = 0; i < text.size(); ++i) {
+    if (text.at(i).isSpace() || (text.at(i).unicode() == 0xFEFF))
+      continue;
+    return (text.at(i) == QLatin1Char('{'));
+  }
+  return false;
+}
+
+/** @brief Read JSON Feed (version 1 and 1.1) into feed and news fields
+ *
+ * Values are taken as they are, dates are converted by ParseObject.
+ *----------------------------------------------------------------------------*/
+void ParseWorker::readJsonFeed(JsonReader &json, ParsedFeedStruct *parsedFeed)
+{
+  FeedItemStruct &feedItem = parsedFeed->feedItem;
+  if (json.readNext() != JsonReader::StartObject)
+    return;
+
+  while (json.readNext() == JsonReader::Name) {
+    const QString name = json.text();
+    if (name == "title") {
+      feedItem.title = Common::htmlToPlainText(json.readText());
+    } else if (name == "home_page_url") {
+      feedItem.link = json.readText();
+    } else if (name == "description") {
+      feedItem.description = json.readText();
+    } else if (name == "language") {
+      feedItem.language = json.readText();
+    } else if ((name == "author") || (name == "authors")) {
+      readJsonAuthors(json, &feedItem.author, &feedItem.authorUri);
+    } else if (name == "hubs") {
+      readJsonHubs(json, parsedFeed);
+    } else if (name == "items") {
+      if (!json.readStartArray())
+        continue;
+      int depth = json.depth();
+      while (json.readNext() == JsonReader::StartObject)
+        readJsonItem(json, parsedFeed);
+      json.leave(depth);
+    } else {
+      json.skipValue();
+    }
+  }
+}
+
+/** @brief Read one object of items array
+ *----------------------------------------------------------------------------*/
+void ParseWorker::readJsonItem(JsonReader &json, ParsedFeedStruct *parsedFeed)
+{
+  NewsItemStruct newsItem;
+  QString contentHtml;
+  QString contentText;
+  QString summary;
+  QString image;
+  QString published;
+  QString modified;
+  QStringList tags;
+
+  while (json.readNext() == JsonReader::Name) {
+    const QString name = json.text();
+    if (name == "id") {
+      newsItem.id = json.readText();
+    } else if (name == "url") {
+      newsItem.link = json.readText();
+    } else if (name == "external_url") {
+      newsItem.linkAlternate = json.readText();
+    } else if (name == "title") {
+      newsItem.title = json.readText();
+    } else if (name == "content_html") {
+      contentHtml = json.readText();
+    } else if (name == "content_text") {
+      contentText = json.readText();
+    } else if (name == "summary") {
+      summary = json.readText();
+    } else if (name == "image") {
+      image = json.readText();
+    } else if (name == "date_published") {
+      published = json.readText();
+    } else if (name == "date_modified") {
+      modified = json.readText();
+    } else if (name == "language") {
+      newsItem.language = json.readText();
+    } else if ((name == "author") || (name == "authors")) {
+      readJsonAuthors(json, &newsItem.author, &newsItem.authorUri);
+    } else if (name == "tags") {
+      if (!json.readStartArray())
+        continue;
+      int depth = json.depth();
+      while (json.readNext() == JsonReader::String)
+        tags.append(json.text());
+      json.leave(depth);
+    } else if (name == "attachments") {
+      readJsonAttachment(json, &newsItem);
+    } else {
+      json.skipValue();
+    }
+  }
+  if (json.hasError())
+    return;
+
+  newsItem.updated = published.isEmpty() ? modified : published;
+  newsItem.category = tags.join(", ");
+  if (!contentHtml.isEmpty()) {
+    newsItem.description = contentHtml;
+  } else if (!contentText.isEmpty()) {
+#if QT_VERSION >= 0x050000
+    newsItem.description = contentText.toHtmlEscaped();
+#else
+    newsItem.description = Qt::escape(contentText);
+#endif
+    newsItem.description.replace("\n", "<br/>");
+  } else {
+    newsItem.description = summary;
+  }
+  if (!image.isEmpty() && !newsItem.description.contains(image))
+    newsItem.description.prepend("<img src=\"" + image + "\" alt=\"image\"/>");
+
+  newsItem.title = Common::htmlToPlainText(newsItem.title);
+  QString text = summary.isEmpty() ? newsItem.description : summary;
+  newsItem.snippet = Common::htmlToPlainText(text, NEWS_SNIPPET_LENGTH);
+  newsItem.titleHash = Common::titleFingerprint(newsItem.title);
+  newsItem.simhash = Common::simHash(Common::htmlToPlainText(newsItem.description,
+                                                             NEWS_SIMHASH_LENGTH));
+  parsedFeed->newsItems.append(newsItem);
+}
+
+/** @brief Read author object of version 1 or authors array of version 1.1
+ *
+ * Names of several authors are joined, URL of the first one is kept.
+ *----------------------------------------------------------------------------*/
+void ParseWorker::readJsonAuthors(JsonReader &json, QString *author, QString *authorUri)
+{
+  QStringList names;
+  JsonReader::TokenType token = json.readNext();
+  bool isArray = (token == JsonReader::StartArray);
+  int depth = json.depth();
+  if (isArray)
+    token = json.readNext();
+  while (token == JsonReader::StartObject) {
+    while (json.readNext() == JsonReader::Name) {
+      const QString name = json.text();
+      if (name == "name") {
+        QString value = Common::htmlToPlainText(json.readText());
+        if (!value.isEmpty())
+          names.append(value);
+      } else if ((name == "url") && authorUri->isEmpty()) {
+        *authorUri = json.readText();
+      } else {
+        json.skipValue();
+      }
+    }
+    if (!isArray)
+      break;
+    token = json.readNext();
+  }
+  if (isArray)
+    json.leave(depth);
+  if (!names.isEmpty())
+    *author = names.join(", ");
+}
+
+/** @brief Read WebSub hub from hubs array of feed
+ *----------------------------------------------------------------------------*/
+void ParseWorker::readJsonHubs(JsonReader &json, ParsedFeedStruct *parsedFeed)
+{
+  if (!json.readStartArray())
+    return;
+  int depth = json.depth();
+  while (json.readNext() == JsonReader::StartObject) {
+    QString type;
+    QString url;
+    while (json.readNext() == JsonReader::Name) {
+      if (json.text() == "type")
+        type = json.readText();
+      else if (json.text() == "url")
+        url = json.readText();
+      else
+        json.skipValue();
+    }
+    if (!type.compare("WebSub", Qt::CaseInsensitive) && parsedFeed->hubUrl.isEmpty())
+      parsedFeed->hubUrl = url;
+  }
+  json.leave(depth);
+}
+
+/** @brief Read first object of attachments array as enclosure of news
+ *----------------------------------------------------------------------------*/
+void ParseWorker::readJsonAttachment(JsonReader &json, NewsItemStruct *newsItem)
+{
+  if (!json.readStartArray())
+    return;
+  int depth = json.depth();
+  while (json.readNext() == JsonReader::StartObject) {
+    bool isFirst = newsItem->eUrl.isEmpty();
+    while (json.readNext() == JsonReader::Name) {
+      const QString name = json.text();
+      if (isFirst && (name == "url"))
+        newsItem->eUrl = json.readText();
+      else if (isFirst && (name == "mime_type"))
+        newsItem->eType = json.readText();
+      else if (isFirst && (name == "size_in_bytes"))
+        newsItem->eLength = json.readText();
+      else
+        json.skipValue();
+    }
+  }
+  json.leave(depth);
+}
@@ -0,0 +1,183 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef PARSEWORKER_H
+#define PARSEWORKER_H
+
+#include <QDateTime>
+#include <QDomDocument>
+#include <QList>
+#include <QObject>
+#include <QSharedPointer>
+#include <QTextCodec>
+#include <QXmlStreamReader>
+
+#include "feedtags.h"
+
+class JsonReader;
+
+// Downloaded data of feed. It is passed between update threads by shared
+// pointer, so queued signals copy only the pointer.
+struct FetchedFeedData {
+  int feedId;
+  QByteArray data;
+  QDateTime dtReply;
+  QString codecName;
+  QString etag;
+  int priority;
+};
+
+typedef QSharedPointer<const FetchedFeedData> FetchedFeed;
+
+Q_DECLARE_METATYPE(FetchedFeed)
+
+struct FeedItemStruct {
+  QString title;
+  QString updated;
+  QString link;
+  QString linkBase;
+  QString language;
+  QString author;
+  QString authorUri;
+  QString authorEmail;
+  QString description;
+};
+
+struct NewsItemStruct {
+  QString id;
+  QString title;
+  QString updated;
+  QString link;
+  QString linkAlternate;
+  QString language;
+  QString author;
+  QString authorUri;
+  QString authorEmail;
+  QString description;
+  QString content;
+  QString snippet;
+  qint64 titleHash;
+  qint64 simhash;
+  QString category;
+  QString eUrl;
+  QString eType;
+  QString eLength;
+  QString comments;
+};
+
+// Plain text of item made by worker, so it is not converted in base thread
+struct ParsedItemText {
+  QString title;
+  QString snippet;
+  qint64 titleHash;
+  qint64 simhash;
+};
+
+/** @brief Stream reader of feed element and items of XML feed
+ *
+ * Items are read in chunks. Worker reads feed element and first chunk,
+ * ParseObject reads next chunks only until it stops on known news, so
+ * the rest of feed is not parsed and documents of one chunk are kept.
+ *----------------------------------------------------------------------------*/
+class FeedItemReader
+{
+public:
+  explicit FeedItemReader(const QString &text);
+
+  QString readFeed(QDomDocument *feedDoc);
+  bool readItems(QList<QDomDocument> *itemDocs, QList<ParsedItemText> *itemTexts);
+  bool atEnd() const { return atEnd_; }
+  QString error() const;
+
+private:
+  bool readNextChild();
+  bool isItem() const;
+  bool isChannel() const;
+  bool readItem(QDomDocument *itemDoc, ParsedItemText *itemText);
+  QDomElement readElement(QDomDocument &doc);
+  static QString itemField(const FeedTags::Children &children, FeedTags::Tag tag,
+                           FeedTags::Tag altTag);
+
+  QXmlStreamReader xml_;
+  QString feedType_;
+  bool inChannel_;
+  // Reader stands on start of item, which is not read yet
+  bool atItem_;
+  bool atEnd_;
+
+  Q_DISABLE_COPY(FeedItemReader)
+};
+
+struct ParsedFeedStruct {
+  int feedId;
+  QDateTime dtReply;
+  QString etag;
+  QString feedType;
+  QDomDocument feedDoc;
+  QList<QDomDocument> itemDocs;
+  QList<ParsedItemText> itemTexts;
+  // Items after first chunk, null if all items are read
+  QSharedPointer<FeedItemReader> itemReader;
+  // JSON Feed is read straight into fields of feed and news
+  FeedItemStruct feedItem;
+  QList<NewsItemStruct> newsItems;
+  QString hubUrl;
+  QString error;
+};
+
+Q_DECLARE_METATYPE(ParsedFeedStruct)
+
+/** @brief Decode and parse xml-data outside of database thread
+ *
+ * Each worker lives in its own thread. Result contains feed element and
+ * first chunk of items, which are written to base by ParseObject.
+ *----------------------------------------------------------------------------*/
+class ParseWorker : public QObject
+{
+  Q_OBJECT
+  // Encoding detection is timed by micro-benchmark
+  friend class KernelBenchmark;
+public:
+  explicit ParseWorker(QObject *parent = 0);
+
+  void disconnectObjects();
+
+public slots:
+  void decodeFeed(const FetchedFeed &feed);
+  void releaseMemory();
+
+signals:
+  void signalDecoded(ParsedFeedStruct parsedFeed);
+
+private:
+  const QString &convertData(const QByteArray &xmlData, const QString &codecName,
+                             int feedId);
+  const QString &decode(QTextCodec *codec, const QByteArray &xmlData);
+  static bool isAsciiBased(QTextCodec *codec);
+  static bool isJsonText(const QString &text);
+  void readJsonFeed(JsonReader &json, ParsedFeedStruct *parsedFeed);
+  void readJsonItem(JsonReader &json, ParsedFeedStruct *parsedFeed);
+  static void readJsonAuthors(JsonReader &json, QString *author, QString *authorUri);
+  static void readJsonHubs(JsonReader &json, ParsedFeedStruct *parsedFeed);
+  static void readJsonAttachment(JsonReader &json, NewsItemStruct *newsItem);
+
+  // Converted text of last feed, its memory is used again for next one
+  QString textBuffer_;
+
+};
+
+#endif // PARSEWORKER_H
@@ -0,0 +1,430 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "pipelinemetricsdialog.h"
+
+#include "eventtrace.h"
+#include "memoryaccounting.h"
+#include "networkmanager.h"
+#include "settings.h"
+#include "sharednetworkcache.h"
+#include "sqlitedriver.h"
+
+#include <QtSql>
+#include <algorithm>
+
+// Rows shown in lists of feeds and statements
+#define PERFORMANCE_TOP_COUNT 20
+
+typedef QPair<int, PipelineMetrics::FeedFailures> FeedFailuresPair;
+
+static bool failuresMoreThan(const FeedFailuresPair &f1, const FeedFailuresPair &f2)
+{
+  if (f1.second.consecutive != f2.second.consecutive)
+    return f1.second.consecutive > f2.second.consecutive;
+  return f1.second.count > f2.second.count;
+}
+
+static bool traceMoreThan(const SQLiteStatementTrace &t1, const SQLiteStatementTrace &t2)
+{
+  return (t1.prepareTime + t1.stepTime) > (t2.prepareTime + t2.stepTime);
+}
+
+PipelineMetricsDialog::PipelineMetricsDialog(QWidget *parent)
+  : Dialog(parent)
+{
+  setWindowFlags (windowFlags() & ~Qt::WindowContextHelpButtonHint);
+  setWindowTitle(tr("Performance"));
+  setObjectName("PipelineMetricsDialog");
+  setMinimumWidth(640);
+  setMinimumHeight(420);
+
+  metricsTree_ = createTree(QStringList() << tr("Stage") << tr("Count") << tr("Average")
+                            << "50%" << "90%" << "99%" << tr("Maximum"));
+  networkTree_ = createTree(QStringList() << tr("Feed") << tr("Time"));
+  parseTree_ = createTree(QStringList() << tr("Feed") << tr("Time"));
+  payloadTree_ = createTree(QStringList() << tr("Feed") << tr("Bytes"));
+  failuresTree_ = createTree(QStringList() << tr("Feed") << tr("In a row")
+                             << tr("Failures") << tr("Timeouts") << tr("Last error"));
+  statementsTree_ = createTree(QStringList() << tr("Statement") << tr("Count")
+                               << tr("Average") << tr("Maximum") << tr("Total"));
+  cacheTree_ = createTree(QStringList() << tr("Source") << tr("Hits") << tr("Misses")
+                          << tr("Hit ratio") << tr("Read bytes") << tr("Written bytes"));
+  memoryTree_ = createTree(QStringList() << tr("Subsystem") << tr("Memory, KB"));
+
+  tabWidget_ = new QTabWidget();
+  tabWidget_->addTab(metricsTree_, tr("Stages"));
+  tabWidget_->addTab(networkTree_, tr("Slow Feeds"));
+  tabWidget_->addTab(parseTree_, tr("Slow Parsing"));
+  tabWidget_->addTab(payloadTree_, tr("Payloads"));
+  tabWidget_->addTab(failuresTree_, tr("Failures"));
+  tabWidget_->addTab(statementsTree_, tr("SQL"));
+  tabWidget_->addTab(cacheTree_, tr("Cache"));
+  tabWidget_->addTab(memoryTree_, tr("Memory"));
+
+  // Tracing is enabled by "traceSQL" setting or "sql" debug category
+  traceTree_ = 0;
+  if (SQLiteDriver::isTraceEnabled()) {
+    traceTree_ = createTree(QStringList() << tr("Statement") << tr("Executions")
+                            << tr("Rows") << tr("Full scans") << tr("Prepare")
+                            << tr("Step"));
+    tabWidget_->addTab(traceTree_, tr("SQL Trace"));
+  }
+
+  QLabel *infoLabel = new QLabel(tr("Time is in milliseconds, percentiles are accurate to factor of two. "
+                                    "Feeds are compared by their last update, "
+                                    "statements faster than 1 ms are not counted."));
+  infoLabel->setWordWrap(true);
+
+  pageLayout->addWidget(tabWidget_, 1);
+  pageLayout->addWidget(infoLabel);
+
+  QPushButton *updateButton = buttonBox->addButton(tr("Refresh"), QDialogButtonBox::ActionRole);
+  connect(updateButton, SIGNAL(clicked()), this, SLOT(updateMetrics()));
+  QPushButton *resetButton = buttonBox->addButton(tr("Reset"), QDialogButtonBox::ResetRole);
+  connect(resetButton, SIGNAL(clicked()), this, SLOT(resetMetrics()));
+  QPushButton *exportButton = buttonBox->addButton(tr("Export..."), QDialogButtonBox::ActionRole);
+  connect(exportButton, SIGNAL(clicked()), this, SLOT(exportMetrics()));
+  if (EventTrace::isEnabled()) {
+    QPushButton *traceButton = buttonBox->addButton(tr("Export Trace..."), QDialogButtonBox::ActionRole);
+    connect(traceButton, SIGNAL(clicked()), this, SLOT(exportTrace()));
+  }
+  buttonBox->addButton(QDialogButtonBox::Close);
+
+  connect(this, SIGNAL(finished(int)), this, SLOT(closeDialog()));
+
+  Settings settings;
+  restoreGeometry(settings.value("pipelineMetricsDlg/geometry").toByteArray());
+  tabWidget_->setCurrentIndex(settings.value("pipelineMetricsDlg/currentTab", 0).toInt());
+
+  updateMetrics();
+}
+
+void PipelineMetricsDialog::closeDialog()
+{
+  Settings settings;
+  settings.setValue("pipelineMetricsDlg/geometry", saveGeometry());
+  settings.setValue("pipelineMetricsDlg/currentTab", tabWidget_->currentIndex());
+}
+
+QTreeWidget *PipelineMetricsDialog::createTree(const QStringList &labels)
+{
+  QTreeWidget *tree = new QTreeWidget(this);
+  tree->setIndentation(0);
+  tree->setSortingEnabled(false);
+  tree->setColumnCount(labels.count());
+  tree->setHeaderLabels(labels);
+#ifdef HAVE_QT5
+  tree->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+#else
+  tree->header()->setResizeMode(0, QHeaderView::Stretch);
+#endif
+  tree->header()->setStretchLastSection(false);
+  return tree;
+}
+
+/** @brief Add row to \a tree, numbers are aligned to right
+ *----------------------------------------------------------------------------*/
+static void addTreeItem(QTreeWidget *tree, const QStringList &treeItem, int textColumns = 1)
+{
+  QTreeWidgetItem *item = new QTreeWidgetItem(treeItem);
+  for (int column = 0; column < treeItem.count(); ++column) {
+    if (column >= textColumns)
+      item->setTextAlignment(column, Qt::AlignRight | Qt::AlignVCenter);
+    item->setToolTip(column, treeItem.at(column));
+  }
+  tree->addTopLevelItem(item);
+}
+
+static void resizeColumns(QTreeWidget *tree, int firstColumn = 1, int lastColumn = -1)
+{
+  if (lastColumn < 0)
+    lastColumn = tree->columnCount() - 1;
+  for (int column = firstColumn; column <= lastColumn; ++column)
+    tree->resizeColumnToContents(column);
+}
+
+QString PipelineMetricsDialog::feedTitle(int feedId)
+{
+  QHash<int, QString>::const_iterator it = feedTitles_.constFind(feedId);
+  if (it != feedTitles_.constEnd())
+    return it.value();
+
+  QString title = QString("#%1").arg(feedId);
+  QSqlQuery q;
+  q.prepare("SELECT text FROM feeds WHERE id=?");
+  q.addBindValue(feedId);
+  if (q.exec() && q.first())
+    title = q.value(0).toString();
+  feedTitles_.insert(feedId, title);
+  return title;
+}
+
+/** @brief Fill tree with current histograms and reports
+ *----------------------------------------------------------------------------*/
+void PipelineMetricsDialog::updateMetrics()
+{
+  QStringList stageTitles;
+  stageTitles << tr("Queue wait") << tr("Time to first byte") << tr("Download")
+              << tr("Received bytes") << tr("Decode") << tr("Parse XML")
+              << tr("Search duplicates") << tr("Insert news") << tr("User filters")
+              << tr("Recount") << tr("Store feed") << tr("Apply to feeds tree");
+
+  metricsTree_->clear();
+  QVector<PipelineMetrics::Histogram> histograms = PipelineMetrics::histograms();
+  for (int i = 0; i < histograms.count(); ++i) {
+    const PipelineMetrics::Histogram &histogram = histograms.at(i);
+    QStringList treeItem;
+    treeItem << stageTitles.value(i, PipelineMetrics::stageName(i))
+             << QString::number(histogram.count)
+             << QString::number(histogram.count ? histogram.sum / histogram.count : 0)
+             << QString::number(histogram.percentile(0.5))
+             << QString::number(histogram.percentile(0.9))
+             << QString::number(histogram.percentile(0.99))
+             << QString::number(histogram.max);
+    addTreeItem(metricsTree_, treeItem);
+  }
+
+  QStringList wakeupTitles;
+  wakeupTitles << tr("feeds queue") << tr("feeds timeouts") << tr("icons queue")
+               << tr("icons timeouts") << tr("parse queue");
+  QVector<PipelineMetrics::Wakeups> wakeups = PipelineMetrics::wakeups();
+  for (int i = 0; i < wakeups.count(); ++i) {
+    addTreeItem(metricsTree_, QStringList() <<
+                tr("Wakeups of %1: %2, idle: %3").
+                arg(wakeupTitles.value(i, PipelineMetrics::wakeupName(i))).
+                arg(wakeups.at(i).count).arg(wakeups.at(i).idle));
+  }
+  resizeColumns(metricsTree_);
+
+  fillFeedsTree(networkTree_, QList<PipelineMetrics::Stage>()
+                << PipelineMetrics::Ttfb << PipelineMetrics::Download);
+  fillFeedsTree(parseTree_, QList<PipelineMetrics::Stage>()
+                << PipelineMetrics::Decode << PipelineMetrics::Parse
+                << PipelineMetrics::Store);
+  fillFeedsTree(payloadTree_, QList<PipelineMetrics::Stage>()
+                << PipelineMetrics::Bytes);
+  fillFailuresTree();
+  fillStatementsTree();
+  fillTraceTree();
+  fillCacheTree();
+  fillMemoryTree();
+}
+
+void PipelineMetricsDialog::fillFeedsTree(QTreeWidget *tree,
+                                          const QList<PipelineMetrics::Stage> &stages)
+{
+  tree->clear();
+  QList<PipelineMetrics::FeedValue> feeds =
+      PipelineMetrics::topFeeds(stages, PERFORMANCE_TOP_COUNT);
+  foreach (const PipelineMetrics::FeedValue &feed, feeds) {
+    addTreeItem(tree, QStringList() << feedTitle(feed.first)
+                << QString::number(feed.second));
+  }
+  resizeColumns(tree);
+}
+
+/** @brief List feeds failing in a row first
+ *----------------------------------------------------------------------------*/
+void PipelineMetricsDialog::fillFailuresTree()
+{
+  failuresTree_->clear();
+
+  QList<FeedFailuresPair> feeds;
+  QHash<int, PipelineMetrics::FeedFailures> failures = PipelineMetrics::failures();
+  QHash<int, PipelineMetrics::FeedFailures>::const_iterator it = failures.constBegin();
+  for (; it != failures.constEnd(); ++it)
+    feeds.append(FeedFailuresPair(it.key(), it.value()));
+  std::sort(feeds.begin(), feeds.end(), failuresMoreThan);
+
+  foreach (const FeedFailuresPair &feed, feeds.mid(0, PERFORMANCE_TOP_COUNT)) {
+    QStringList treeItem;
+    treeItem << feedTitle(feed.first)
+             << QString::number(feed.second.consecutive)
+             << QString::number(feed.second.count)
+             << QString::number(feed.second.timeouts)
+             << feed.second.error;
+    addTreeItem(failuresTree_, treeItem);
+    failuresTree_->topLevelItem(failuresTree_->topLevelItemCount() - 1)->
+        setTextAlignment(4, Qt::AlignLeft | Qt::AlignVCenter);
+  }
+  resizeColumns(failuresTree_);
+}
+
+void PipelineMetricsDialog::fillStatementsTree()
+{
+  statementsTree_->clear();
+
+  QList<PipelineMetrics::Statement> statements =
+      PipelineMetrics::slowStatements(PERFORMANCE_TOP_COUNT);
+  foreach (const PipelineMetrics::Statement &statement, statements) {
+    QStringList treeItem;
+    treeItem << statement.sql
+             << QString::number(statement.count)
+             << QString::number(statement.count ? statement.total / statement.count : 0)
+             << QString::number(statement.max)
+             << QString::number(statement.total);
+    addTreeItem(statementsTree_, treeItem);
+  }
+  resizeColumns(statementsTree_);
+}
+
+/** @brief List traced statements from the longest total time
+ *----------------------------------------------------------------------------*/
+void PipelineMetricsDialog::fillTraceTree()
+{
+  if (!traceTree_)
+    return;
+  traceTree_->clear();
+
+  QList<SQLiteStatementTrace> statements = SQLiteDriver::traceStatements();
+  std::sort(statements.begin(), statements.end(), traceMoreThan);
+  foreach (const SQLiteStatementTrace &trace, statements.mid(0, PERFORMANCE_TOP_COUNT)) {
+    QStringList treeItem;
+    treeItem << trace.sql
+             << QString::number(trace.execCount)
+             << QString::number(trace.rows)
+             << QString::number(trace.fullScanCount)
+             << QString::number(trace.prepareTime / 1000.0, 'f', 1)
+             << QString::number(trace.stepTime / 1000.0, 'f', 1);
+    addTreeItem(traceTree_, treeItem);
+  }
+  resizeColumns(traceTree_);
+}
+
+/** @brief Show use of disk cache by browser, feeds and icons
+ *----------------------------------------------------------------------------*/
+void PipelineMetricsDialog::fillCacheTree()
+{
+  cacheTree_->clear();
+
+  QStringList sourceTitles;
+  sourceTitles << tr("Browser") << tr("Feeds") << tr("Favicons") << tr("Image prefetch");
+
+  QVector<SharedNetworkCache::Statistics> statistics = SharedNetworkCache::statistics();
+  SharedNetworkCache::Statistics total;
+  for (int i = 0; i <= statistics.count(); ++i) {
+    SharedNetworkCache::Statistics source = total;
+    QString title = tr("Total");
+    if (i < statistics.count()) {
+      source = statistics.at(i);
+      title = sourceTitles.value(i);
+      total.hits += source.hits;
+      total.misses += source.misses;
+      total.bytesRead += source.bytesRead;
+      total.inserts += source.inserts;
+      total.bytesWritten += source.bytesWritten;
+    }
+    qint64 lookups = source.hits + source.misses;
+    QStringList treeItem;
+    treeItem << title
+             << QString::number(source.hits)
+             << QString::number(source.misses)
+             << (lookups ? QString("%1%").arg(100.0 * source.hits / lookups, 0, 'f', 1) : "-")
+             << QString::number(source.bytesRead)
+             << QString::number(source.bytesWritten);
+    addTreeItem(cacheTree_, treeItem);
+  }
+
+  addTreeItem(cacheTree_, QStringList() <<
+              tr("Disk usage: %1 of %2 KB, evicted entries: %3").
+              arg(SharedNetworkCache::diskUsage() / 1024).
+              arg(SharedNetworkCache::maximumCacheSize() / 1024).
+              arg(SharedNetworkCache::evictions()));
+
+  qint64 handshakes = 0;
+  qint64 withTicket = 0;
+  int ticketHosts = 0;
+  NetworkManager::tlsStatistics(&handshakes, &withTicket, &ticketHosts);
+  addTreeItem(cacheTree_, QStringList() <<
+              tr("TLS handshakes: %1, with session ticket: %2, hosts with ticket: %3").
+              arg(handshakes).arg(withTicket).arg(ticketHosts));
+  resizeColumns(cacheTree_);
+}
+
+/** @brief Show approximate memory reported by subsystems
+ *----------------------------------------------------------------------------*/
+void PipelineMetricsDialog::fillMemoryTree()
+{
+  memoryTree_->clear();
+
+  QStringList subsystemTitles;
+  subsystemTitles << tr("Browser pages") << tr("Cached query rows") << tr("Feeds tree")
+                  << tr("AdBlock rules") << tr("Log queue") << tr("SQLite")
+                  << tr("Parse queue");
+
+  QVector<qint64> usage = MemoryAccounting::usage();
+  qint64 total = 0;
+  for (int i = 0; i < usage.count(); ++i) {
+    total += usage.at(i);
+    addTreeItem(memoryTree_, QStringList()
+                << subsystemTitles.value(i, MemoryAccounting::subsystemName(i))
+                << QString::number(usage.at(i) / 1024));
+  }
+  addTreeItem(memoryTree_, QStringList() << tr("Total") << QString::number(total / 1024));
+
+  qint64 process = MemoryAccounting::processUsage();
+  if (process >= 0) {
+    addTreeItem(memoryTree_, QStringList() << tr("Resident memory of process")
+                << QString::number(process / 1024));
+  }
+  resizeColumns(memoryTree_);
+}
+
+void PipelineMetricsDialog::resetMetrics()
+{
+  PipelineMetrics::reset();
+  SQLiteDriver::clearTrace();
+  EventTrace::clear();
+  SharedNetworkCache::resetStatistics();
+  updateMetrics();
+}
+
+void PipelineMetricsDialog::exportMetrics()
+{
+  QString fileName = QFileDialog::getSaveFileName(this, tr("Export Statistics"),
+                                                  QDir::homePath() + "/quiterss_metrics.json",
+                                                  "JSON (*.json)");
+  if (fileName.isEmpty())
+    return;
+
+  QFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    QMessageBox::warning(this, tr("Export Statistics"),
+                         tr("Cannot write file %1:\n%2.").
+                         arg(fileName).arg(file.errorString()));
+    return;
+  }
+  file.write(PipelineMetrics::toJson().toUtf8());
+  file.close();
+}
+
+/** @brief Save timeline of feed updates in Chrome trace format
+ *----------------------------------------------------------------------------*/
+void PipelineMetricsDialog::exportTrace()
+{
+  QString fileName = QFileDialog::getSaveFileName(this, tr("Export Trace"),
+                                                  QDir::homePath() + "/quiterss_trace.json",
+                                                  "JSON (*.json)");
+  if (fileName.isEmpty())
+    return;
+
+  if (!EventTrace::exportChromeTrace(fileName)) {
+    QMessageBox::warning(this, tr("Export Trace"),
+                         tr("Cannot write file %1.").arg(fileName));
+  }
+}
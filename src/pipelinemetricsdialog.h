@@ -0,0 +1,63 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef PIPELINEMETRICSDIALOG_H
+#define PIPELINEMETRICSDIALOG_H
+
+#include "dialog.h"
+
+#include "pipelinemetrics.h"
+
+class PipelineMetricsDialog : public Dialog
+{
+  Q_OBJECT
+public:
+  explicit PipelineMetricsDialog(QWidget *parent);
+
+private slots:
+  void updateMetrics();
+  void resetMetrics();
+  void exportMetrics();
+  void exportTrace();
+  void closeDialog();
+
+private:
+  QTreeWidget *createTree(const QStringList &labels);
+  QString feedTitle(int feedId);
+  void fillFeedsTree(QTreeWidget *tree, const QList<PipelineMetrics::Stage> &stages);
+  void fillFailuresTree();
+  void fillStatementsTree();
+  void fillTraceTree();
+  void fillCacheTree();
+  void fillMemoryTree();
+
+  QTabWidget *tabWidget_;
+  QTreeWidget *metricsTree_;
+  QTreeWidget *networkTree_;
+  QTreeWidget *parseTree_;
+  QTreeWidget *payloadTree_;
+  QTreeWidget *failuresTree_;
+  QTreeWidget *statementsTree_;
+  QTreeWidget *traceTree_;
+  QTreeWidget *cacheTree_;
+  QTreeWidget *memoryTree_;
+
+  QHash<int, QString> feedTitles_;
+
+};
+
+#endif // PIPELINEMETRICSDIALOG_H
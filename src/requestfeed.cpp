@@ -18,6 +18,12 @@
 #include "requestfeed.h"
 #include "VersionNo.h"
 #include "mainapplication.h"
+#include "bytescan.h"
+#include "eventtrace.h"
+#include "logfile.h"
+#include "pipelinemetrics.h"
+#include "settings.h"
+#include "sharednetworkcache.h"
 
 #include <QDebug>
 #ifdef HAVE_QT5
@@ -27,37 +33,84 @@
 #endif
 #include <QtSql>
 #include <qzregexp.h>
+#include <ctype.h>
+#ifdef HAVE_ZLIB
+#include <string.h>
+#include <zlib.h>
+#endif
 
 #define REPLY_MAX_COUNT 10
+// Maximum number of simultaneous feeds fetched from one host
+#define HOST_MAX_COUNT 4
+// Request slots over the limit which only user-initiated updates may take
+#define INTERACTIVE_EXTRA_COUNT 2
+// Part of request slots icons may take when no feeds are waiting
+#define ICON_SLOTS_DIVISOR 2
+// Delay before a host that replied "Service Temporarily Unavailable" is used again
+#define HOST_BACKOFF_MIN 2000
+#define HOST_BACKOFF_MAX 60000
+// Failed requests in a row after which host is not requested for a while
+#define HOST_BREAKER_FAILURES 3
+#define HOST_BREAKER_MIN 300000
+#define HOST_BREAKER_MAX 3600000
+// Updates in a row with the same permanent redirect before feed URL is changed
+#define REDIRECT_REWRITE_COUNT 3
+// Size of data start which is checked for feed root element
+#define FEED_SNIFF_SIZE 4096
 
 RequestFeed::RequestFeed(int timeoutRequest, int numberRequests,
-                         int numberRepeats, QObject *parent)
+                         int numberRepeats, int maxFeedSize, bool http2Enabled,
+                         QObject *parent)
   : QObject(parent)
   , timeoutRequest_(timeoutRequest)
   , numberRequests_(numberRequests)
   , numberRepeats_(numberRepeats)
+  , maxFeedSize_(qint64(maxFeedSize) * 1024 * 1024)
+  , http2Enabled_(http2Enabled)
+  , clearConnections_(false)
+  , paused_(false)
+  , requestsCount_(0)
+  , http2Count_(0)
+  , handshakesCount_(0)
+  , encodedBytes_(0)
+  , decodedBytes_(0)
+  , dispatchPending_(false)
+  , queuedCount_(0)
+  , wheelPos_(0)
 {
   setObjectName("requestFeed_");
 
+  clock_.start();
+
+  timeoutWheel_.resize(qMax(timeoutRequest_, 1) + 1);
+  lanes_.resize(PriorityCount);
+  for (int i = 0; i < lanes_.count(); ++i)
+    lanes_[i].hostIndex = 0;
+
   timeout_ = new QTimer(this);
   timeout_->setInterval(1000);
   connect(timeout_, SIGNAL(timeout()), this, SLOT(slotRequestTimeout()));
 
+  // Wakes queues only when delay of throttled host is over
   getUrlTimer_ = new QTimer(this);
   getUrlTimer_->setSingleShot(true);
-  getUrlTimer_->setInterval(50);
   connect(getUrlTimer_, SIGNAL(timeout()), this, SLOT(getQueuedUrl()));
 
   networkManager_ = new NetworkManager(true, this);
+  networkManager_->setCache(new SharedNetworkCache(SharedNetworkCache::Feeds));
+  networkManager_->setArchive(mainApp->networkArchive());
   connect(networkManager_, SIGNAL(finished(QNetworkReply*)),
           this, SLOT(finished(QNetworkReply*)));
+#if QT_VERSION >= 0x050100
+  connect(networkManager_, SIGNAL(encrypted(QNetworkReply*)),
+          this, SLOT(slotEncrypted()));
+#endif
 
-  connect(this, SIGNAL(signalHead(QUrl,int,QString,QDateTime,int)),
-          SLOT(slotHead(QUrl,int,QString,QDateTime,int)),
-          Qt::QueuedConnection);
   connect(this, SIGNAL(signalGet(QUrl,int,QString,QDateTime,int)),
           SLOT(slotGet(QUrl,int,QString,QDateTime,int)),
           Qt::QueuedConnection);
+  connect(this, SIGNAL(getUrlDone(int,int,QString,QString,QByteArray,QDateTime,QString)),
+          SLOT(slotFeedDone(int,int)));
 }
 
 RequestFeed::~RequestFeed()
@@ -71,129 +124,753 @@ void RequestFeed::disconnectObjects()
   networkManager_->disconnect(networkManager_);
 }
 
-/** @brief Put URL in request queue
+/** @brief Put URL in request queue of its host in lane of \a priority
  *----------------------------------------------------------------------------*/
-void RequestFeed::requestUrl(int id, QString urlString,
-                              QDateTime date, QString userInfo)
+void RequestFeed::requestUrl(int id, QString urlString, QDateTime date,
+                              QString userInfo, QString etag, int priority)
 {
-  if (!timeout_->isActive())
-    timeout_->start();
+  QueuedFeed feed;
+  feed.id = id;
+  feed.url = urlString;
+  feed.date = date;
+  feed.userInfo = userInfo;
+  feed.etag = etag;
+  feed.queued = clock_.elapsed();
+
+  priority = qBound(0, priority, PriorityIcon - 1);
+  enqueueFeed(priority, QUrl(urlString).host(), feed);
+  scheduleDispatch();
+
+  LOG_DEBUG(LogFile::Fetch) << "urlsQueue_ <<" << urlString << "priority=" << priority
+                            << "count=" << queuedCount_;
+}
+
+/** @brief Put URLs of many feeds in request queues at once
+ *
+ * Used by updates of folder or all feeds, so thousands of feeds are
+ * passed in one queued call.
+ *----------------------------------------------------------------------------*/
+void RequestFeed::requestUrls(FeedRequestList requests)
+{
+  if (requests.isEmpty()) return;
+
+  qint64 queued = clock_.elapsed();
+  foreach (const FeedRequest &request, requests) {
+    QueuedFeed feed;
+    feed.id = request.id;
+    feed.url = request.url;
+    feed.date = request.date;
+    feed.userInfo = request.userInfo;
+    feed.etag = request.etag;
+    feed.queued = queued;
+
+    int priority = qBound(0, request.priority, PriorityIcon - 1);
+    enqueueFeed(priority, QUrl(request.url).host(), feed);
+  }
+  scheduleDispatch();
+
+  LOG_DEBUG(LogFile::Fetch) << "urlsQueue_ << feeds:" << requests.count()
+                            << "count=" << queuedCount_;
+}
+
+void RequestFeed::enqueueFeed(int priority, const QString &host, const QueuedFeed &feed)
+{
+  Lane &lane = lanes_[priority];
+  if (!lane.hostQueues.contains(host)) {
+    lane.hostOrder.append(host);
+    networkManager_->resolveHost(host);
+  }
+  lane.hostQueues[host].enqueue(feed);
+  queuedCount_++;
+}
+
+/** @brief Process request queues once control returns to event loop
+ *
+ * Calls made while dispatch is pending are merged, so feeds queued one by
+ * one are dispatched together.
+ *----------------------------------------------------------------------------*/
+void RequestFeed::scheduleDispatch()
+{
+  if (dispatchPending_)
+    return;
+
+  dispatchPending_ = true;
+  QMetaObject::invokeMethod(this, "getQueuedUrl", Qt::QueuedConnection);
+}
+
+/** @brief Move queued feed to lane of user-initiated updates
+ *
+ * Used when user updates feed which is already waiting in background update.
+ *----------------------------------------------------------------------------*/
+void RequestFeed::promoteFeed(int feedId)
+{
+  for (int priority = PriorityInteractive + 1; priority < lanes_.count(); ++priority) {
+    Lane &lane = lanes_[priority];
+    for (int i = 0; i < lane.hostOrder.count(); ++i) {
+      QString host = lane.hostOrder.at(i);
+      QQueue<QueuedFeed> &queue = lane.hostQueues[host];
+      for (int j = 0; j < queue.count(); ++j) {
+        if (queue.at(j).id != feedId)
+          continue;
 
-  idsQueue_.enqueue(id);
-  feedsQueue_.enqueue(urlString);
-  dateQueue_.enqueue(date);
-  userInfo_.enqueue(userInfo);
+        QueuedFeed feed = queue.takeAt(j);
+        queuedCount_--;
+        if (queue.isEmpty()) {
+          lane.hostQueues.remove(host);
+          lane.hostOrder.removeAt(i);
+          if (lane.hostIndex > i)
+            lane.hostIndex--;
+        }
+        enqueueFeed(PriorityInteractive, host, feed);
+        LOG_DEBUG(LogFile::Fetch) << "urlsQueue_ promoted" << feed.url;
+        scheduleDispatch();
+        return;
+      }
+    }
+  }
+}
 
-  if (!getUrlTimer_->isActive())
-    getUrlTimer_->start();
+/** @brief Queue request of icon from \a host in lowest lane
+ *
+ * Slot is given by iconSlotReady() and must be released by
+ * releaseIconSlot(). Tokens are negative, so they never match feed ids.
+ *----------------------------------------------------------------------------*/
+void RequestFeed::requestIconSlot(int token, QString host)
+{
+  QueuedFeed icon;
+  icon.id = token;
+  icon.queued = clock_.elapsed();
+  enqueueFeed(PriorityIcon, host, icon);
+  scheduleDispatch();
+}
 
-  qDebug() << "urlsQueue_ <<" << urlString << "count=" << feedsQueue_.count();
+void RequestFeed::releaseIconSlot(int token)
+{
+  slotFeedDone(0, token);
 }
 
 void RequestFeed::stopRequest()
 {
-  while (!feedsQueue_.isEmpty()) {
-    int feedId = idsQueue_.dequeue();
-    QString feedUrl = feedsQueue_.dequeue();
-    dateQueue_.clear();
-    userInfo_.clear();
+  // Icons are still requested when update is stopped
+  QList<QueuedFeed> feeds;
+  for (int i = 0; i < PriorityIcon; ++i) {
+    Lane &lane = lanes_[i];
+    foreach (const QString &host, lane.hostOrder) {
+      feeds.append(lane.hostQueues.value(host));
+    }
+    lane.hostQueues.clear();
+    lane.hostOrder.clear();
+    lane.hostIndex = 0;
+  }
+  queuedCount_ -= feeds.count();
 
-    emit getUrlDone(feedsQueue_.count(), feedId, feedUrl);
+  for (int i = 0; i < feeds.count(); ++i) {
+    emit getUrlDone(feeds.count() - i - 1, feeds.at(i).id, feeds.at(i).url);
   }
 }
 
-/** @brief Process request queue on timer timeouts
+/** @brief Apply changed request settings without stopping update
+ *
+ * Queued and active requests are kept. New limit of requests is used at
+ * once, active requests get new timeout counted from their start.
+ * Connections kept alive are dropped when requests are finished, as they
+ * can be opened through previous proxy.
  *----------------------------------------------------------------------------*/
-void RequestFeed::getQueuedUrl()
+void RequestFeed::applySettings()
 {
-  if ((numberRequests_ <= currentFeeds_.size()) ||
-      (REPLY_MAX_COUNT <= currentFeeds_.size())) {
-    getUrlTimer_->start();
+  QSharedPointer<const SettingsSnapshot> options = Settings::snapshot();
+  int timeoutRequest = options->timeoutRequest;
+  numberRequests_ = options->numberRequests;
+  numberRepeats_ = options->numberRepeats;
+  maxFeedSize_ = qint64(options->maxFeedSize) * 1024 * 1024;
+  http2Enabled_ = options->http2Enabled;
+
+  if (timeoutRequest != timeoutRequest_) {
+    timeoutRequest_ = timeoutRequest;
+    QVector<QList<QNetworkReply*> > timeoutWheel(qMax(timeoutRequest_, 1) + 1);
+    wheelPos_ = 0;
+    timeoutWheel_ = timeoutWheel;
+    QHash<QNetworkReply*, FeedReply>::iterator it = replies_.begin();
+    for (; it != replies_.end(); ++it) {
+      scheduleTimeout(it.key(), it.value());
+    }
+  }
+
+  if (activeFeeds_.isEmpty()) {
+#if QT_VERSION >= 0x050200
+    networkManager_->clearAccessCache();
+#endif
+  } else {
+    clearConnections_ = true;
+  }
+
+  LOG_DEBUG(LogFile::Fetch) << objectName() << "settings applied: requests" << numberRequests_
+                            << "timeout" << timeoutRequest_ << "repeats" << numberRepeats_;
+
+  if (queuedCount_)
+    scheduleDispatch();
+}
+
+/** @brief Check if one more feed of \a host can be requested now
+ *----------------------------------------------------------------------------*/
+bool RequestFeed::isHostReady(const QString &host) const
+{
+  int active = hostActive_.value(host, 0);
+  // When back-off of broken host is over, one feed is let through to probe it
+  if (hostBreakers_.value(host).failures >= HOST_BREAKER_FAILURES) {
+    if (active > 0)
+      return false;
+  } else if (hostList_.contains(host)) {
+    if (active > 0)
+      return false;
+  } else if (active >= HOST_MAX_COUNT) {
+    return false;
+  }
+
+  QHash<QString, qint64>::const_iterator it = hostDelay_.constFind(host);
+  if ((it != hostDelay_.constEnd()) && (clock_.elapsed() < it.value()))
+    return false;
+
+  return true;
+}
+
+/** @brief Check if background feeds of \a host should fail without request
+ *----------------------------------------------------------------------------*/
+bool RequestFeed::isHostBroken(const QString &host) const
+{
+  QHash<QString, HostBreaker>::const_iterator it = hostBreakers_.constFind(host);
+  if ((it == hostBreakers_.constEnd()) || (it.value().failures < HOST_BREAKER_FAILURES))
+    return false;
+  return clock_.elapsed() < it.value().openUntil;
+}
+
+/** @brief Count request of \a host which got no answer
+ *
+ * Back-off of broken host is doubled each time probe fails.
+ *----------------------------------------------------------------------------*/
+void RequestFeed::hostFailed(const QString &host)
+{
+  HostBreaker &breaker = hostBreakers_[host];
+  if (!breaker.failures)
+    breaker.backoff = 0;
+  breaker.failures++;
+  if (breaker.failures < HOST_BREAKER_FAILURES)
     return;
+
+  breaker.backoff = qBound(qint64(HOST_BREAKER_MIN), 2 * breaker.backoff, qint64(HOST_BREAKER_MAX));
+  breaker.openUntil = clock_.elapsed() + breaker.backoff;
+  LOG_DEBUG(LogFile::Fetch) << objectName() << "host is not responding:" << host
+                            << "failures:" << breaker.failures << "back-off:" << breaker.backoff;
+}
+
+/** @brief Reset failures of \a host which answered
+ *
+ * Throttling of host is dropped when its back-off is over, so hosts which
+ * were unavailable once do not stay limited to one request.
+ *----------------------------------------------------------------------------*/
+void RequestFeed::hostReplied(const QString &host)
+{
+  hostBreakers_.remove(host);
+
+  QHash<QString, qint64>::iterator it = hostDelay_.find(host);
+  if ((it != hostDelay_.end()) && (clock_.elapsed() >= it.value())) {
+    hostDelay_.erase(it);
+    hostList_.removeAll(host);
   }
+}
 
-  if (!feedsQueue_.isEmpty()) {
-    getUrlTimer_->start();
-    QString feedUrl = feedsQueue_.head();
+/** @brief Stop or resume requesting background feeds
+ *
+ * Parser pauses requests while its queue of downloaded data is full.
+ * Active requests are finished, feeds updated by user are still requested.
+ *----------------------------------------------------------------------------*/
+void RequestFeed::setPaused(bool paused)
+{
+  if (paused == paused_)
+    return;
 
-    if (hostList_.contains(QUrl(feedUrl).host())) {
-      foreach (QString url, currentFeeds_) {
-        if (QUrl(url).host() == QUrl(feedUrl).host()) {
-          return;
-        }
+  paused_ = paused;
+  LOG_DEBUG(LogFile::Fetch) << objectName() << (paused_ ? "paused" : "resumed")
+                            << "queued:" << queuedCount_;
+
+  if (!paused_ && queuedCount_)
+    scheduleDispatch();
+}
+
+/** @brief Process request queues when feeds are queued or slot is released
+ *
+ * Lanes are served in order of priority, lower lane gets only slots left
+ * free by higher one. User-initiated updates may take few extra slots, so
+ * they are not waiting for background requests.
+ *----------------------------------------------------------------------------*/
+void RequestFeed::getQueuedUrl()
+{
+  dispatchPending_ = false;
+  int queuedCount = queuedCount_;
+  int maxCount = qMin(numberRequests_, REPLY_MAX_COUNT);
+
+  // Feeds updated by user are requested even from broken hosts
+  dispatchLane(lanes_[PriorityInteractive], maxCount + INTERACTIVE_EXTRA_COUNT, false);
+  // When paused queues are processed again by setPaused()
+  if (!paused_) {
+    bool feedsQueued = !lanes_[PriorityInteractive].hostOrder.isEmpty();
+    for (int priority = PriorityInteractive + 1; priority < PriorityIcon; ++priority) {
+      dispatchLane(lanes_[priority], maxCount);
+      feedsQueued = feedsQueued || !lanes_[priority].hostOrder.isEmpty();
+    }
+    // Icons wait for all queued feeds and leave slots free for next ones
+    if (!feedsQueued)
+      dispatchLane(lanes_[PriorityIcon], qMax(1, maxCount / ICON_SLOTS_DIVISOR), false);
+  }
+
+  PipelineMetrics::recordWakeup(PipelineMetrics::WakeFeedQueue, queuedCount_ == queuedCount);
+
+  // Busy slots and hosts are freed by slotFeedDone(), only delay of
+  // throttled host needs timer
+  if (queuedCount_) {
+    qint64 deadline = nextHostDeadline();
+    if (deadline >= 0)
+      getUrlTimer_->start(int(qMax(qint64(1), deadline - clock_.elapsed())));
+  }
+}
+
+/** @brief Earliest end of delay of host which has queued feeds
+ *
+ * Returns -1 if no queued host is delayed.
+ *----------------------------------------------------------------------------*/
+qint64 RequestFeed::nextHostDeadline() const
+{
+  qint64 now = clock_.elapsed();
+  qint64 deadline = -1;
+  QHash<QString, qint64>::const_iterator it = hostDelay_.constBegin();
+  for (; it != hostDelay_.constEnd(); ++it) {
+    if ((it.value() <= now) || ((deadline >= 0) && (it.value() >= deadline)))
+      continue;
+    foreach (const Lane &lane, lanes_) {
+      if (lane.hostQueues.contains(it.key())) {
+        deadline = it.value();
+        break;
       }
     }
-    int feedId = idsQueue_.dequeue();
-    feedUrl = feedsQueue_.dequeue();
+  }
+  return deadline;
+}
+
+/** @brief Request feeds of one lane while free slots remain
+ *
+ * Hosts are served round-robin, so a throttled host never blocks feeds of
+ * other hosts.
+ *----------------------------------------------------------------------------*/
+void RequestFeed::dispatchLane(Lane &lane, int maxCount, bool useBreaker)
+{
+  int skipped = 0;
 
-    emit setStatusFeed(feedId, "1 Update");
+  while ((activeFeeds_.count() < maxCount) && !lane.hostOrder.isEmpty() &&
+         (skipped < lane.hostOrder.count())) {
+    if (lane.hostIndex >= lane.hostOrder.count())
+      lane.hostIndex = 0;
+    QString host = lane.hostOrder.at(lane.hostIndex);
 
-    QUrl getUrl = QUrl::fromEncoded(feedUrl.toUtf8());
-    QString userInfo = userInfo_.dequeue();
-    if (!userInfo.isEmpty()) {
-      getUrl.setUserInfo(userInfo);
-//      getUrl.addQueryItem("auth", getUrl.scheme());
+    if (useBreaker && isHostBroken(host)) {
+      // Feeds of broken host do not take request slots and timeouts
+      QQueue<QueuedFeed> feeds = lane.hostQueues.take(host);
+      lane.hostOrder.removeAt(lane.hostIndex);
+      queuedCount_ -= feeds.count();
+      foreach (const QueuedFeed &feed, feeds) {
+        emit getUrlDone(-3, feed.id, feed.url, tr("Host is not responding!"));
+      }
+      continue;
     }
-    QDateTime currentDate = dateQueue_.dequeue();
 
-    if (currentDate.isValid())
-      emit signalHead(getUrl, feedId, feedUrl, currentDate);
+    if (!isHostReady(host)) {
+      lane.hostIndex++;
+      skipped++;
+      continue;
+    }
+    skipped = 0;
+
+    QQueue<QueuedFeed> &queue = lane.hostQueues[host];
+    QueuedFeed feed = queue.dequeue();
+    queuedCount_--;
+    if (queue.isEmpty()) {
+      lane.hostQueues.remove(host);
+      lane.hostOrder.removeAt(lane.hostIndex);
+    } else {
+      lane.hostIndex++;
+    }
+
+    activeFeeds_.insert(feed.id, host);
+    hostActive_[host]++;
+    if (feed.id < 0)
+      emit iconSlotReady(feed.id);
     else
-      emit signalGet(getUrl, feedId, feedUrl, currentDate);
+      dispatchFeed(feed);
+  }
+}
 
-    qDebug() << "urlsQueue_ >>" << feedUrl << "count=" << feedsQueue_.count();
+void RequestFeed::dispatchFeed(const QueuedFeed &feed)
+{
+  emit setStatusFeed(feed.id, "1 Update");
+  PipelineMetrics::record(PipelineMetrics::QueueWait, clock_.elapsed() - feed.queued, feed.id);
+  if (EventTrace::isEnabled()) {
+    EventTrace::complete(EventTrace::QueueWait, feed.id,
+                         EventTrace::now() - (clock_.elapsed() - feed.queued) * 1000);
+  }
+
+  QUrl getUrl = QUrl::fromEncoded(feed.url.toUtf8());
+  QHash<int, QUrl>::const_iterator it = redirectCache_.constFind(feed.id);
+  if (it != redirectCache_.constEnd())
+    getUrl = it.value();
+  if (!feed.userInfo.isEmpty()) {
+    getUrl.setUserInfo(feed.userInfo);
+//      getUrl.addQueryItem("auth", getUrl.scheme());
   }
+
+  if (!feed.etag.isEmpty())
+    feedEtags_.insert(feed.id, feed.etag);
+
+  emit signalGet(getUrl, feed.id, feed.url, feed.date);
+
+  LOG_DEBUG(LogFile::Fetch) << "urlsQueue_ >>" << feed.url << "count=" << queuedCount_;
 }
 
-/** @brief Prepare and send network request to get head
+/** @brief Release request slot of the finished feed
  *----------------------------------------------------------------------------*/
-void RequestFeed::slotHead(const QUrl &getUrl, const int &id, const QString &feedUrl,
-                            const QDateTime &date, const int &count)
+void RequestFeed::slotFeedDone(int result, int feedId)
 {
-  qDebug() << objectName() << "::head:" << getUrl.toEncoded() << "feed:" << feedUrl << count;
-  QNetworkRequest request(getUrl);
-  QString userAgent = QString("Mozilla/5.0 (Windows NT 6.1) AppleWebKit/%1 (KHTML, like Gecko) Chrome/77.0.3865.120 Safari/%1").
-      arg(qWebKitVersion());
-  request.setRawHeader("User-Agent", userAgent.toUtf8());
+  redirectTargets_.remove(feedId);
+  temporaryRedirects_.remove(feedId);
+  // Cached target may be gone, original URL is requested next time
+  if (result < 0)
+    redirectCache_.remove(feedId);
 
-  currentUrls_.append(getUrl);
-  currentIds_.append(id);
-  currentFeeds_.append(feedUrl);
-  currentDates_.append(date);
-  currentCount_.append(count);
-  currentHead_.append(true);
-  currentTime_.append(timeoutRequest_);
+  QHash<int, QString>::iterator it = activeFeeds_.find(feedId);
+  if (it == activeFeeds_.end())
+    return;
 
-  QNetworkReply *reply = networkManager_->head(request);
-  reply->setProperty("feedReply", QVariant(true));
-  requestUrl_.append(reply->url());
-  networkReply_.append(reply);
+  QString host = it.value();
+  activeFeeds_.erase(it);
+  feedEtags_.remove(feedId);
+  if (--hostActive_[host] <= 0)
+    hostActive_.remove(host);
+
+  if (activeFeeds_.isEmpty() && clearConnections_) {
+    clearConnections_ = false;
+#if QT_VERSION >= 0x050200
+    networkManager_->clearAccessCache();
+#endif
+  }
+
+  if (activeFeeds_.isEmpty() && !queuedCount_ && requestsCount_) {
+    LOG_DEBUG(LogFile::Fetch) << objectName() << "requests:" << requestsCount_
+                              << "HTTP/2:" << http2Count_ << "TLS handshakes:" << handshakesCount_
+#ifdef HAVE_ZLIB
+                              << "bytes received:" << encodedBytes_
+#endif
+                              << "decoded:" << decodedBytes_;
+    requestsCount_ = 0;
+    http2Count_ = 0;
+    handshakesCount_ = 0;
+    encodedBytes_ = 0;
+    decodedBytes_ = 0;
+  }
+
+  if (queuedCount_)
+    scheduleDispatch();
 }
 
 /** @brief Prepare and send network request to get all data
+ *
+ * Request is conditional if feed has stored validators: server replies
+ * "304 Not Modified" without data if feed has not been changed.
  *----------------------------------------------------------------------------*/
 void RequestFeed::slotGet(const QUrl &getUrl, const int &id, const QString &feedUrl,
                            const QDateTime &date, const int &count)
 {
-  qDebug() << objectName() << "::get:" << getUrl.toEncoded() << "feed:" << feedUrl << count;
+  LOG_DEBUG(LogFile::Fetch) << objectName() << "::get:" << getUrl.toEncoded() << "feed:" << feedUrl << count;
   QNetworkRequest request(getUrl);
   request.setRawHeader("Accept", "application/atom+xml,application/rss+xml;q=0.9,application/xml;q=0.8,text/xml;q=0.7,*/*;q=0.6");
   QString userAgent = QString("Mozilla/5.0 (Windows NT 6.1) AppleWebKit/%1 (KHTML, like Gecko) Chrome/77.0.3865.120 Safari/%1").
       arg(qWebKitVersion());
   request.setRawHeader("User-Agent", userAgent.toUtf8());
+#ifdef HAVE_ZLIB
+  // Body is decoded in finished(), so size of data on the wire is known.
+  // Qt does not decompress replies when Accept-Encoding is set by request
+  request.setRawHeader("Accept-Encoding", "gzip, deflate");
+#else
+  // Accept-Encoding is not set here: then Qt requests gzip and deflate itself
+  // and decompresses data while it is downloaded
+#endif
 
-  currentUrls_.append(getUrl);
-  currentIds_.append(id);
-  currentFeeds_.append(feedUrl);
-  currentDates_.append(date);
-  currentCount_.append(count);
-  currentHead_.append(false);
-  currentTime_.append(timeoutRequest_);
+  // Feed is stored in base, so it is not written into cache. Cached reply
+  // loaded by browser is used only if feed has no validators of its own,
+  // otherwise "304 Not Modified" must reach finished()
+  request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
+  QString etag = feedEtags_.value(id);
+  if (!etag.isEmpty())
+    request.setRawHeader("If-None-Match", etag.toLatin1());
+#if QT_VERSION >= 0x050800
+  // Requests to the same host share one multiplexed connection
+  if (http2Enabled_)
+    request.setAttribute(QNetworkRequest::HTTP2AllowedAttribute, true);
+#endif
+  if (date.isValid()) {
+    // Date is stored as UTC time without time spec
+    QString modifiedSince = QLocale::c().toString(date, "ddd, dd MMM yyyy HH:mm:ss 'GMT'");
+    request.setRawHeader("If-Modified-Since", modifiedSince.toLatin1());
+  }
+  if (!etag.isEmpty() || date.isValid())
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
 
   QNetworkReply *reply = networkManager_->get(request);
   reply->setProperty("feedReply", QVariant(true));
-  requestUrl_.append(reply->url());
-  networkReply_.append(reply);
+  connect(reply, SIGNAL(readyRead()), this, SLOT(slotReadyRead()));
+  connect(reply, SIGNAL(metaDataChanged()), this, SLOT(slotReplyProgress()));
+  connect(reply, SIGNAL(downloadProgress(qint64,qint64)), this, SLOT(slotReplyProgress()));
+
+  FeedReply feedReply;
+  feedReply.feedId = id;
+  feedReply.feedUrl = feedUrl;
+  feedReply.feedDate = date;
+  feedReply.count = count;
+  feedReply.started = clock_.elapsed();
+  feedReply.firstData = -1;
+  feedReply.lastProgress = -1;
+  scheduleTimeout(reply, replies_.insert(reply, feedReply).value());
+}
+
+/** @brief Put reply in slot of timer wheel at its deadline
+ *
+ * Until server answers, deadline is counted from start of request
+ * (connection, TLS handshake and server response). Then it is counted from
+ * last received data, so slow download goes on while data keeps coming.
+ *----------------------------------------------------------------------------*/
+void RequestFeed::scheduleTimeout(QNetworkReply *reply, FeedReply &feedReply)
+{
+  qint64 since = (feedReply.lastProgress < 0) ? feedReply.started : feedReply.lastProgress;
+  qint64 remaining = since + qint64(qMax(timeoutRequest_, 1)) * 1000 - clock_.elapsed();
+  int seconds = qBound(1, int((remaining + 999) / 1000), timeoutWheel_.count() - 1);
+  feedReply.timeoutSlot = (wheelPos_ + seconds) % timeoutWheel_.count();
+  timeoutWheel_[feedReply.timeoutSlot].append(reply);
+
+  if (!timeout_->isActive())
+    timeout_->start();
+}
+
+/** @brief Move deadline of reply which received headers or data
+ *----------------------------------------------------------------------------*/
+void RequestFeed::slotReplyProgress()
+{
+  QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+  QHash<QNetworkReply*, FeedReply>::iterator it = replies_.find(reply);
+  if (it != replies_.end())
+    it.value().lastProgress = clock_.elapsed();
+}
+
+/** @brief Count new encrypted connections
+ *----------------------------------------------------------------------------*/
+void RequestFeed::slotEncrypted()
+{
+  handshakesCount_++;
+}
+
+/** @brief Check if data start looks like feed
+ *----------------------------------------------------------------------------*/
+bool RequestFeed::isFeedData(const QByteArray &data)
+{
+  QByteArray start = data.left(FEED_SNIFF_SIZE).toLower();
+  return (start.contains("<rss") || start.contains("<feed") ||
+          start.contains("<rdf:rdf") || isJsonFeedData(data));
+}
+
+/** @brief Check if data is JSON Feed: object declaring its version URL
+ *----------------------------------------------------------------------------*/
+bool RequestFeed::isJsonFeedData(const QByteArray &data)
+{
+  int pos = data.startsWith("\xEF\xBB\xBF") ? 3 : 0;
+  while ((pos < data.size()) && isspace(uchar(data.at(pos))))
+    ++pos;
+  return (pos < data.size()) && (data.at(pos) == '{') &&
+      data.left(FEED_SNIFF_SIZE).contains("jsonfeed.org/version");
+}
+
+/** @brief Read reply data while it is downloaded
+ *
+ * Download is stopped if data exceeds size limit. HTML page is read only up
+ * to end of its head, which is enough to find feed links in it.
+ *----------------------------------------------------------------------------*/
+void RequestFeed::slotReadyRead()
+{
+  QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+  if (!reply || reply->property("dataComplete").toBool())
+    return;
+
+  int httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+  if ((httpStatus >= 300) && (httpStatus < 400))
+    return;
+
+  QByteArray &data = replyData_[reply];
+  bool isFirstChunk = data.isEmpty();
+  if (isFirstChunk) {
+    QHash<QNetworkReply*, FeedReply>::iterator it = replies_.find(reply);
+    if ((it != replies_.end()) && (it.value().firstData < 0))
+      it.value().firstData = clock_.elapsed();
+  }
+  data.append(reply->readAll());
+
+  if (maxFeedSize_ && (data.size() > maxFeedSize_)) {
+    qWarning() << "Feed size exceeds limit:" << reply->url().toString() << data.size();
+    reply->setProperty("sizeExceeded", true);
+    reply->abort();
+    return;
+  }
+
+  QString contentType = reply->header(QNetworkRequest::ContentTypeHeader).toString();
+  if (isFirstChunk && (contentType.startsWith("image/") || contentType.startsWith("audio/") ||
+                       contentType.startsWith("video/"))) {
+    qWarning() << "Reply is not a feed:" << reply->url().toString() << contentType;
+    reply->setProperty("notFeed", true);
+    reply->abort();
+    return;
+  }
+
+  // Encoded data is sniffed only after it is decoded
+  if (contentType.contains("html", Qt::CaseInsensitive) &&
+      !reply->hasRawHeader("Content-Encoding") &&
+      (data.size() >= FEED_SNIFF_SIZE) && !isFeedData(data)) {
+    int headEnd = data.indexOf("</head>");
+    if (headEnd == -1)
+      headEnd = data.indexOf("</HEAD>");
+    if (headEnd != -1) {
+      LOG_DEBUG(LogFile::Fetch) << objectName() << "  html page, stop reading:" << reply->url().toString();
+      data.resize(headEnd + 7);
+      reply->setProperty("dataComplete", true);
+      reply->abort();
+    }
+  }
+}
+
+#ifdef HAVE_ZLIB
+/** @brief Decode body of reply sent with gzip or deflate Content-Encoding
+ *
+ * Servers send "deflate" both as zlib stream and as raw deflate data, both
+ * are accepted. Decoding stops when data exceeds \a maxSize, if it is set.
+ *----------------------------------------------------------------------------*/
+RequestFeed::DecodeResult RequestFeed::decodeContent(const QByteArray &data,
+                                                     const QByteArray &encoding,
+                                                     qint64 maxSize, QByteArray *result)
+{
+  if ((encoding != "gzip") && (encoding != "x-gzip") && (encoding != "deflate"))
+    return DecodeFailed;
+
+  // 32 + MAX_WBITS detects zlib and gzip headers, negative bits read raw deflate
+  int windowBits = 32 + MAX_WBITS;
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, windowBits) != Z_OK)
+      return DecodeFailed;
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.constData()));
+    stream.avail_in = uInt(data.size());
+
+    result->clear();
+    char buffer[16384];
+    int ret;
+    do {
+      stream.next_out = reinterpret_cast<Bytef*>(buffer);
+      stream.avail_out = sizeof(buffer);
+      ret = inflate(&stream, Z_NO_FLUSH);
+      if ((ret != Z_OK) && (ret != Z_STREAM_END))
+        break;
+      result->append(buffer, int(sizeof(buffer) - stream.avail_out));
+      if (maxSize && (result->size() > maxSize)) {
+        inflateEnd(&stream);
+        return DecodeTooLarge;
+      }
+    } while ((ret == Z_OK) && ((stream.avail_in > 0) || (stream.avail_out == 0)));
+    inflateEnd(&stream);
+
+    // Truncated stream still gives data read so far
+    if ((ret == Z_STREAM_END) || ((ret == Z_OK) && !result->isEmpty()))
+      return DecodeOk;
+    if ((encoding != "deflate") || (windowBits < 0) || !result->isEmpty())
+      break;
+    windowBits = -MAX_WBITS;
+  }
+  return DecodeFailed;
+}
+#endif
+
+/** @brief Fix common errors of feed data in one pass
+ *
+ * Trims whitespaces, escapes bare ampersands, closes <br> tags and cuts
+ * garbage after the end of feed. JSON Feed is only trimmed.
+ *----------------------------------------------------------------------------*/
+QByteArray RequestFeed::sanitizeData(const QByteArray &data)
+{
+  const char *begin = data.constData();
+  const char *end = begin + data.size();
+  while ((begin < end) && isspace(uchar(*begin))) ++begin;
+  while ((end > begin) && isspace(uchar(*(end - 1)))) --end;
+
+  // Fixes of XML would break strings of JSON
+  if (isJsonFeedData(data))
+    return QByteArray(begin, int(end - begin));
+
+  QByteArray result;
+  result.reserve(int(end - begin) + 64);
+
+  int rssEnd = -1;
+  int feedEnd = -1;
+  int rdfEnd = -1;
+
+  // Only '&' and '<' are changed, bytes between them are copied by runs
+  const char *ch = begin;
+  while (ch < end) {
+    const char *next = ByteScan::findEither(ch, end, '&', '<');
+    result.append(ch, int(next - ch));
+    ch = next;
+    if (ch == end)
+      break;
+
+    if (*ch == '&') {
+      // keep entity "&[a-z0-9#]+;"
+      next = ch + 1;
+      while ((next < end) && (((*next >= 'a') && (*next <= 'z')) ||
+                              ((*next >= '0') && (*next <= '9')) || (*next == '#'))) {
+        ++next;
+      }
+      if ((next > ch + 1) && (next < end) && (*next == ';'))
+        result.append('&');
+      else
+        result.append("&amp;");
+    } else if ((end - ch >= 4) && !qstrncmp(ch, "<br>", 4)) {
+      result.append("<br/>");
+      ch += 3;
+    } else {
+      // End of feed is searched after beginning of data only
+      int size = result.size();
+      if (size) {
+        if ((rssEnd == -1) && (end - ch >= 6) && !qstrncmp(ch, "</rss>", 6))
+          rssEnd = size + 6;
+        if ((feedEnd == -1) && (end - ch >= 7) && !qstrncmp(ch, "</feed>", 7))
+          feedEnd = size + 7;
+        if ((rdfEnd == -1) && (end - ch >= 10) && !qstrncmp(ch, "</rdf:RDF>", 10))
+          rdfEnd = size + 10;
+      }
+      result.append('<');
+    }
+    ++ch;
+  }
+
+  if (rssEnd != -1)
+    result.resize(rssEnd);
+  if ((feedEnd != -1) && (feedEnd <= result.size()))
+    result.resize(feedEnd);
+  if ((rdfEnd != -1) && (rdfEnd <= result.size()))
+    result.resize(rdfEnd);
+
+  return result;
 }
 
 /** @brief Process network reply
@@ -202,98 +879,127 @@ void RequestFeed::finished(QNetworkReply *reply)
 {
   QUrl replyUrl = reply->url();
 
-  qDebug() << "reply.finished():" << replyUrl.toString();
-  qDebug() << reply->header(QNetworkRequest::ContentTypeHeader);
-  qDebug() << reply->header(QNetworkRequest::ContentLengthHeader);
-  qDebug() << reply->header(QNetworkRequest::LocationHeader);
-  qDebug() << reply->header(QNetworkRequest::LastModifiedHeader);
-  qDebug() << reply->header(QNetworkRequest::CookieHeader);
-  qDebug() << reply->header(QNetworkRequest::SetCookieHeader);
-
-  int currentReplyIndex = currentUrls_.indexOf(replyUrl);
-
-  if (currentReplyIndex >= 0) {
-    currentTime_.removeAt(currentReplyIndex);
-    currentUrls_.removeAt(currentReplyIndex);
-    int feedId    = currentIds_.takeAt(currentReplyIndex);
-    QString feedUrl    = currentFeeds_.takeAt(currentReplyIndex);
-    QDateTime feedDate = currentDates_.takeAt(currentReplyIndex);
-    int count = currentCount_.takeAt(currentReplyIndex) + 1;
-    bool headOk = currentHead_.takeAt(currentReplyIndex);
-
-    if (reply->error() != QNetworkReply::NoError) {
-      qDebug() << "  error retrieving RSS feed:" << reply->error() << reply->errorString();
-      if (!headOk) {
-        if (reply->error() == QNetworkReply::AuthenticationRequiredError)
-          emit getUrlDone(-2, feedId, feedUrl, tr("Server requires authentication!"));
-        else if (reply->error() == QNetworkReply::ContentNotFoundError)
-          emit getUrlDone(-5, feedId, feedUrl, tr("Server replied: Not Found!"));
-        else {
-          if (reply->errorString().contains("Service Temporarily Unavailable")) {
-            if (!hostList_.contains(QUrl(feedUrl).host())) {
-              hostList_.append(QUrl(feedUrl).host());
-              count--;
-            }
-          }
+  LOG_DEBUG(LogFile::Fetch) << "reply.finished():" << replyUrl.toString();
+  LOG_DEBUG(LogFile::Trace) << reply->header(QNetworkRequest::ContentTypeHeader)
+                            << reply->header(QNetworkRequest::ContentLengthHeader)
+                            << reply->header(QNetworkRequest::LocationHeader)
+                            << reply->header(QNetworkRequest::LastModifiedHeader)
+                            << reply->header(QNetworkRequest::CookieHeader)
+                            << reply->header(QNetworkRequest::SetCookieHeader);
+
+  QHash<QNetworkReply*, FeedReply>::iterator it = replies_.find(reply);
+
+  if (it != replies_.end()) {
+    requestsCount_++;
+#if QT_VERSION >= 0x050900
+    if (reply->attribute(QNetworkRequest::HTTP2WasUsedAttribute).toBool())
+      http2Count_++;
+#endif
+    FeedReply feedReply = it.value();
+    replies_.erase(it);
+    int feedId    = feedReply.feedId;
+    if (EventTrace::isEnabled()) {
+      EventTrace::complete(EventTrace::Request, feedId,
+                           EventTrace::now() - (clock_.elapsed() - feedReply.started) * 1000);
+    }
+    QString feedUrl    = feedReply.feedUrl;
+    QDateTime feedDate = feedReply.feedDate;
+    int count = feedReply.count + 1;
+    int httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    bool dataComplete = reply->property("dataComplete").toBool();
+    QString feedHost = QUrl(feedUrl).host();
+    if (httpStatus || dataComplete)
+      hostReplied(feedHost);
 
-          if (count < numberRepeats_) {
-            emit signalGet(replyUrl, feedId, feedUrl, feedDate, count);
-          } else {
-            emit getUrlDone(-1, feedId, feedUrl, QString("%1 (%2)").arg(reply->errorString()).arg(reply->error()));
+    if (reply->property("sizeExceeded").toBool()) {
+      emit getUrlDone(-1, feedId, feedUrl, tr("Feed size exceeds limit!"));
+    } else if (reply->property("notFeed").toBool()) {
+      emit getUrlDone(-1, feedId, feedUrl, tr("Reply is not a feed!"));
+    } else if ((reply->error() != QNetworkReply::NoError) && !dataComplete) {
+      LOG_DEBUG(LogFile::Fetch) << "  error retrieving RSS feed:" << reply->error() << reply->errorString();
+      if (reply->error() == QNetworkReply::AuthenticationRequiredError)
+        emit getUrlDone(-2, feedId, feedUrl, tr("Server requires authentication!"));
+      else if (reply->error() == QNetworkReply::ContentNotFoundError)
+        emit getUrlDone(-5, feedId, feedUrl, tr("Server replied: Not Found!"));
+      else {
+        if (reply->errorString().contains("Service Temporarily Unavailable") ||
+            (httpStatus == 503) || (httpStatus == 429)) {
+          QString host = QUrl(feedUrl).host();
+          if (!hostList_.contains(host)) {
+            hostList_.append(host);
+            count--;
           }
+          // Double the back-off while the host keeps refusing,
+          // but wait at least as long as server asks
+          qint64 delay = 2 * (hostDelay_.value(host, 0) - clock_.elapsed());
+          bool ok = false;
+          qint64 retryAfter = reply->rawHeader("Retry-After").trimmed().toLongLong(&ok);
+          if (ok)
+            delay = qMax(delay, retryAfter * 1000);
+          delay = qBound(qint64(HOST_BACKOFF_MIN), delay, qint64(HOST_BACKOFF_MAX));
+          hostDelay_.insert(host, clock_.elapsed() + delay);
+        }
+
+        if (count < numberRepeats_) {
+          emit signalGet(replyUrl, feedId, feedUrl, feedDate, count);
+        } else {
+          if (!httpStatus)
+            hostFailed(feedHost);
+          emit getUrlDone(-1, feedId, feedUrl, QString("%1 (%2)").arg(reply->errorString()).arg(reply->error()));
         }
-      } else {
-        emit signalGet(replyUrl, feedId, feedUrl, feedDate);
       }
+    } else if (httpStatus == 304) {
+      // Feed not modified since last update
+      LOG_DEBUG(LogFile::Fetch) << objectName() << "  not modified:" << feedUrl;
+      PipelineMetrics::record(PipelineMetrics::Ttfb, clock_.elapsed() - feedReply.started, feedId);
+      redirectDone(feedId);
+      emit getUrlDone(queuedCount_, feedId, feedUrl);
     } else {
       QUrl redirectionTarget = reply->attribute(QNetworkRequest::RedirectionTargetAttribute).toUrl();
       if (redirectionTarget.isValid()) {
         if (count < (numberRepeats_ + 3)) {
-          if (headOk && (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 302)) {
-            emit signalGet(replyUrl, feedId, feedUrl, feedDate);
-          } else {
-            QString host(QUrl::fromEncoded(feedUrl.toUtf8()).host());
-            if (redirectionTarget.host().isEmpty()) {
-              if (redirectionTarget.path() == ".") {
-                if (redirectionTarget.hasQuery()) {
+          QString host(QUrl::fromEncoded(feedUrl.toUtf8()).host());
+          if (redirectionTarget.host().isEmpty()) {
+            if (redirectionTarget.path() == ".") {
+              if (redirectionTarget.hasQuery()) {
 #if QT_VERSION >= 0x050000
-                  QString query = redirectionTarget.query();
-                  redirectionTarget.setUrl(replyUrl.scheme() + "://" + host + replyUrl.path());
-                  redirectionTarget.setQuery(query);
+                QString query = redirectionTarget.query();
+                redirectionTarget.setUrl(replyUrl.scheme() + "://" + host + replyUrl.path());
+                redirectionTarget.setQuery(query);
 #else
-                  QByteArray query = redirectionTarget.encodedQuery();
-                  redirectionTarget.setUrl(replyUrl.scheme() + "://" + host + replyUrl.path());
-                  redirectionTarget.setEncodedQuery(query);
+                QByteArray query = redirectionTarget.encodedQuery();
+                redirectionTarget.setUrl(replyUrl.scheme() + "://" + host + replyUrl.path());
+                redirectionTarget.setEncodedQuery(query);
 #endif
-                }
-              } else {
-                redirectionTarget.setUrl(replyUrl.scheme() + "://" + host + redirectionTarget.toString());
               }
-            }
-            if (redirectionTarget.scheme().isEmpty())
-              redirectionTarget.setScheme(QUrl(feedUrl).scheme());
-            if (reply->operation() == QNetworkAccessManager::HeadOperation) {
-              qDebug() << objectName() << "  head redirect..." << redirectionTarget.toString();
-              emit signalHead(redirectionTarget, feedId, feedUrl, feedDate, count);
-            }
-            else {
-              qDebug() << objectName() << "  get redirect..." << redirectionTarget.toString();
-              emit signalGet(redirectionTarget, feedId, feedUrl, feedDate, count);
+            } else {
+              redirectionTarget.setUrl(replyUrl.scheme() + "://" + host + redirectionTarget.toString());
             }
           }
+          if (redirectionTarget.scheme().isEmpty())
+            redirectionTarget.setScheme(QUrl(feedUrl).scheme());
+          if ((httpStatus != 301) && (httpStatus != 308))
+            temporaryRedirects_.insert(feedId);
+          redirectTargets_.insert(feedId, redirectionTarget);
+          LOG_DEBUG(LogFile::Fetch) << objectName() << "  get redirect..." << httpStatus
+                                    << redirectionTarget.toString();
+          emit signalGet(redirectionTarget, feedId, feedUrl, feedDate, count);
         } else {
           emit getUrlDone(-4, feedId, feedUrl, tr("Redirect error!"));
         }
       } else {
         QDateTime replyDate = reply->header(QNetworkRequest::LastModifiedHeader).toDateTime();
         QDateTime replyLocalDate = QDateTime(replyDate.date(), replyDate.time());
+        QString etag = QString::fromLatin1(reply->rawHeader("ETag"));
 
-        qDebug() << feedDate << replyDate << replyLocalDate;
-        qDebug() << feedDate.toMSecsSinceEpoch() << replyDate.toMSecsSinceEpoch() << replyLocalDate.toMSecsSinceEpoch();
-        if ((reply->operation() == QNetworkAccessManager::HeadOperation) &&
-            ((!feedDate.isValid()) || (!replyLocalDate.isValid()) ||
-             (feedDate < replyLocalDate) || !replyDate.toMSecsSinceEpoch())) {
-          emit signalGet(replyUrl, feedId, feedUrl, feedDate);
+        LOG_DEBUG(LogFile::Trace) << feedDate << replyDate << replyLocalDate << etag;
+        if (feedDate.isValid() && replyLocalDate.isValid() &&
+            replyDate.toMSecsSinceEpoch() && (replyLocalDate <= feedDate) &&
+            (etag.isEmpty() || (etag == feedEtags_.value(feedId)))) {
+          // Server ignores conditional request, but data is the same
+          LOG_DEBUG(LogFile::Fetch) << objectName() << "  not modified (date):" << feedUrl;
+          redirectDone(feedId);
+          emit getUrlDone(queuedCount_, feedId, feedUrl);
         }
         else {
           QString codecName;
@@ -303,26 +1009,44 @@ void RequestFeed::finished(QNetworkReply *reply)
             codecName = rx.cap(1);
           }
 
-          QByteArray data = reply->readAll();
-          data = data.trimmed();
+          QByteArray data = replyData_.take(reply);
+          if (!dataComplete)
+            data.append(reply->readAll());
 
-          rx.setPattern("&(?!([a-z0-9#]+;))");
-          pos = 0;
-          while ((pos = rx.indexIn(QString::fromLatin1(data), pos)) != -1) {
-            data.replace(pos, 1, "&amp;");
-            pos += 1;
+          // Without zlib Qt decodes body, then only decoded size is known
+          QByteArray encoding = reply->rawHeader("Content-Encoding").trimmed().toLower();
+          qint64 encodedSize = data.size();
+#ifdef HAVE_ZLIB
+          if (!encoding.isEmpty() && (encoding != "identity")) {
+            QByteArray decoded;
+            DecodeResult decodeResult = decodeContent(data, encoding, maxFeedSize_, &decoded);
+            if (decodeResult != DecodeOk) {
+              qWarning() << "Unable to decode reply:" << feedUrl << encoding << int(decodeResult);
+              emit getUrlDone(-1, feedId, feedUrl,
+                              (decodeResult == DecodeTooLarge) ? tr("Feed size exceeds limit!")
+                                                               : tr("Unable to decode reply!"));
+              replyData_.remove(reply);
+              reply->abort();
+              reply->deleteLater();
+              return;
+            }
+            data = decoded;
           }
+          encodedBytes_ += encodedSize;
+#endif
+          decodedBytes_ += data.size();
 
-          data.replace("<br>", "<br/>");
-
-          if (data.indexOf("</rss>") > 0)
-            data.resize(data.indexOf("</rss>") + 6);
-          if (data.indexOf("</feed>") > 0)
-            data.resize(data.indexOf("</feed>") + 7);
-          if (data.indexOf("</rdf:RDF>") > 0)
-            data.resize(data.indexOf("</rdf:RDF>") + 10);
+          qint64 finishedTime = clock_.elapsed();
+          qint64 firstData = (feedReply.firstData < 0) ? finishedTime : feedReply.firstData;
+          PipelineMetrics::record(PipelineMetrics::Ttfb, firstData - feedReply.started, feedId);
+          PipelineMetrics::record(PipelineMetrics::Download, finishedTime - firstData, feedId);
+          PipelineMetrics::record(PipelineMetrics::Bytes, encodedSize, feedId);
+          LOG_DEBUG(LogFile::Fetch) << objectName() << "  received:" << feedUrl << encoding
+                                    << encodedSize << data.size();
+          data = sanitizeData(data);
 
-          emit getUrlDone(feedsQueue_.count(), feedId, feedUrl, "", data, replyLocalDate, codecName);
+          redirectDone(feedId);
+          emit getUrlDone(queuedCount_, feedId, feedUrl, "", data, replyLocalDate, codecName, etag);
         }
       }
     }
@@ -330,45 +1054,95 @@ void RequestFeed::finished(QNetworkReply *reply)
     qCritical() << "Request Url error: " << replyUrl.toString() << reply->errorString();
   }
 
-  int replyIndex = requestUrl_.indexOf(replyUrl);
-  if (replyIndex >= 0) {
-    requestUrl_.removeAt(replyIndex);
-    networkReply_.removeAt(replyIndex);
-  }
-
+  replyData_.remove(reply);
   reply->abort();
   reply->deleteLater();
 }
 
+/** @brief Remember where redirects of feed led after successful request
+ *
+ * Target of chain with temporary redirect is requested directly in this
+ * session. Feed URL is changed only when the same permanent (301, 308)
+ * target is seen in few updates in a row.
+ *----------------------------------------------------------------------------*/
+void RequestFeed::redirectDone(int feedId)
+{
+  QHash<int, QUrl>::iterator it = redirectTargets_.find(feedId);
+  if (it == redirectTargets_.end()) {
+    permanentRedirects_.remove(feedId);
+    return;
+  }
+
+  QUrl target = it.value();
+  redirectTargets_.erase(it);
+  if (temporaryRedirects_.remove(feedId)) {
+    redirectCache_.insert(feedId, target);
+    permanentRedirects_.remove(feedId);
+    return;
+  }
+
+  QPair<QString, int> &seen = permanentRedirects_[feedId];
+  QString targetStr = QString::fromUtf8(target.toEncoded());
+  if (seen.first == targetStr) {
+    seen.second++;
+  } else {
+    seen.first = targetStr;
+    seen.second = 1;
+  }
+  if (seen.second >= REDIRECT_REWRITE_COUNT) {
+    LOG_DEBUG(LogFile::Fetch) << objectName() << "feed moved permanently:" << feedId << targetStr;
+    emit feedUrlMoved(feedId, targetStr);
+    permanentRedirects_.remove(feedId);
+  }
+}
+
 /** @brief Timeout to delete network requests which has no answer
+ *
+ * Only replies of current slot of timer wheel are checked. Reply which got
+ * data since it was scheduled is put in slot of its new deadline. Wheel
+ * stops when no requests are active and is started by scheduleTimeout().
  *----------------------------------------------------------------------------*/
 void RequestFeed::slotRequestTimeout()
 {
-  for (int i = currentTime_.count() - 1; i >= 0; i--) {
-    int time = currentTime_.at(i) - 1;
-    if (time <= 0) {
-      QUrl url = currentUrls_.takeAt(i);
-      int feedId    = currentIds_.takeAt(i);
-      QString feedUrl = currentFeeds_.takeAt(i);
-      QDateTime feedDate = currentDates_.takeAt(i);
-      int count = currentCount_.takeAt(i) + 1;
-      currentTime_.removeAt(i);
-      currentHead_.removeAt(i);
-
-      int replyIndex = requestUrl_.indexOf(url);
-      if (replyIndex >= 0) {
-        QUrl replyUrl = requestUrl_.takeAt(replyIndex);
-        QNetworkReply *reply = networkReply_.takeAt(replyIndex);
-        reply->deleteLater();
+  if (replies_.isEmpty()) {
+    timeout_->stop();
+    for (int i = 0; i < timeoutWheel_.count(); ++i)
+      timeoutWheel_[i].clear();
+    PipelineMetrics::recordWakeup(PipelineMetrics::WakeFeedTimeout, true);
+    return;
+  }
 
-        if (count < numberRepeats_) {
-          emit signalGet(replyUrl, feedId, feedUrl, feedDate, count);
-        } else {
-          emit getUrlDone(-3, feedId, feedUrl, tr("Request timeout!"));
-        }
-      }
+  wheelPos_ = (wheelPos_ + 1) % timeoutWheel_.count();
+  QList<QNetworkReply*> replies = timeoutWheel_[wheelPos_];
+  timeoutWheel_[wheelPos_].clear();
+  PipelineMetrics::recordWakeup(PipelineMetrics::WakeFeedTimeout, replies.isEmpty());
+
+  foreach (QNetworkReply *reply, replies) {
+    QHash<QNetworkReply*, FeedReply>::iterator it = replies_.find(reply);
+    if ((it == replies_.end()) || (it.value().timeoutSlot != wheelPos_))
+      continue;
+
+    qint64 since = (it.value().lastProgress < 0) ? it.value().started : it.value().lastProgress;
+    if (clock_.elapsed() - since < qint64(qMax(timeoutRequest_, 1)) * 1000) {
+      scheduleTimeout(reply, it.value());
+      continue;
+    }
+
+    FeedReply feedReply = it.value();
+    replies_.erase(it);
+    replyData_.remove(reply);
+    int count = feedReply.count + 1;
+    LOG_DEBUG(LogFile::Fetch) << objectName() << "  timeout:" << feedReply.feedUrl
+                              << ((feedReply.lastProgress < 0) ? "no reply" : "stalled");
+
+    QUrl replyUrl = reply->url();
+    reply->deleteLater();
+
+    if (count < numberRepeats_) {
+      emit signalGet(replyUrl, feedReply.feedId, feedReply.feedUrl, feedReply.feedDate, count);
     } else {
-      currentTime_.replace(i, time);
+      hostFailed(QUrl(feedReply.feedUrl).host());
+      emit getUrlDone(-3, feedReply.feedId, feedReply.feedUrl, tr("Request timeout!"));
     }
   }
 }
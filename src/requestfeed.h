@@ -19,71 +19,199 @@
 #define REQUESTFEED_H
 
 #include <QDateTime>
+#include <QHash>
+#include <QMetaType>
 #include <QObject>
 #include <QQueue>
+#include <QSet>
 #include <QNetworkReply>
 #include <QTimer>
+#include <QVector>
 #include <QElapsedTimer>
 
 #include "networkmanager.h"
 
+// Feed request given to scheduler in bulk
+struct FeedRequest {
+  int id;
+  QString url;
+  QDateTime date;
+  QString userInfo;
+  QString etag;
+  int priority;
+};
+typedef QList<FeedRequest> FeedRequestList;
+Q_DECLARE_METATYPE(FeedRequestList)
+
 class RequestFeed : public QObject
 {
   Q_OBJECT
+  // Payload sanitizer is timed by micro-benchmark
+  friend class KernelBenchmark;
 public:
+  // Update classes of feeds, feeds of higher class are requested first
+  enum Priority {
+    PriorityInteractive = 0,
+    PriorityStartup,
+    PriorityScheduled,
+    PriorityImport,
+    // Feeds demoted by update cost budget
+    PriorityDemoted,
+    // Icons of feeds, fetched by FaviconObject in slots given by scheduler
+    PriorityIcon,
+    PriorityCount
+  };
+
   explicit RequestFeed(int timeoutRequest, int numberRequests,
-                       int numberRepeats, QObject *parent = 0);
+                       int numberRepeats, int maxFeedSize, bool http2Enabled,
+                       QObject *parent = 0);
   ~RequestFeed();
 
   void disconnectObjects();
+  static bool isJsonFeedData(const QByteArray &data);
+  static bool isFeedData(const QByteArray &data);
+  static QByteArray sanitizeData(const QByteArray &data);
+#ifdef HAVE_ZLIB
+  enum DecodeResult {
+    DecodeOk = 0,
+    DecodeFailed,
+    DecodeTooLarge
+  };
+  static DecodeResult decodeContent(const QByteArray &data, const QByteArray &encoding,
+                                    qint64 maxSize, QByteArray *result);
+#endif
 
 public slots:
-  void requestUrl(int id, QString urlString, QDateTime date, QString userInfo = "");
+  void requestUrl(int id, QString urlString, QDateTime date,
+                  QString userInfo = "", QString etag = "",
+                  int priority = PriorityScheduled);
+  void requestUrls(FeedRequestList requests);
+  void promoteFeed(int feedId);
+  void requestIconSlot(int token, QString host);
+  void releaseIconSlot(int token);
+  void setPaused(bool paused);
   void stopRequest();
-  void slotHead(const QUrl &getUrl, const int &id, const QString &feedUrl,
-                const QDateTime &date, const int &count);
+  void applySettings();
   void slotGet(const QUrl &getUrl, const int &id, const QString &feedUrl,
                const QDateTime &date, const int &count);
 
 signals:
   void getUrlDone(int result, int feedId, QString feedUrl = "",
                   QString error = "", QByteArray data = NULL,
-                  QDateTime dtReply = QDateTime(), QString codecName = "");
-  void signalHead(const QUrl &getUrl, const int &id, const QString &feedUrl,
-                  const QDateTime &date, const int &count = 0);
+                  QDateTime dtReply = QDateTime(), QString codecName = "",
+                  QString etag = "");
   void signalGet(const QUrl &getUrl, const int &id, const QString &feedUrl,
                  const QDateTime &date, const int &count = 0);
   void setStatusFeed(int feedId, QString status);
+  void iconSlotReady(int token);
+  void feedUrlMoved(int feedId, QString newUrl);
 
 private slots:
   void getQueuedUrl();
   void finished(QNetworkReply *reply);
+  void slotReadyRead();
+  void slotReplyProgress();
+  void slotEncrypted();
   void slotRequestTimeout();
+  void slotFeedDone(int result, int feedId);
 
 private:
+  struct QueuedFeed {
+    int id;
+    QString url;
+    QDateTime date;
+    QString userInfo;
+    QString etag;
+    qint64 queued;
+  };
+
+  // Feeds of one update class queued per host
+  struct Lane {
+    QHash<QString, QQueue<QueuedFeed> > hostQueues;
+    QStringList hostOrder;
+    int hostIndex;
+  };
+
+  // Circuit breaker of host which does not answer: while it is open,
+  // background feeds of host fail at once instead of waiting for timeout
+  struct HostBreaker {
+    int failures;
+    qint64 backoff;
+    qint64 openUntil;
+  };
+
+  // State of one network request of feed
+  struct FeedReply {
+    int feedId;
+    QString feedUrl;
+    QDateTime feedDate;
+    int count;
+    int timeoutSlot;
+    qint64 started;
+    qint64 firstData;
+    qint64 lastProgress;  // time of last headers or data, -1 before reply
+  };
+
+  bool isHostReady(const QString &host) const;
+  bool isHostBroken(const QString &host) const;
+  void hostFailed(const QString &host);
+  void hostReplied(const QString &host);
+  void enqueueFeed(int priority, const QString &host, const QueuedFeed &feed);
+  void scheduleDispatch();
+  qint64 nextHostDeadline() const;
+  void dispatchLane(Lane &lane, int maxCount, bool useBreaker = true);
+  void dispatchFeed(const QueuedFeed &feed);
+  void scheduleTimeout(QNetworkReply *reply, FeedReply &feedReply);
+  void redirectDone(int feedId);
+
   NetworkManager *networkManager_;
 
   int timeoutRequest_;
   int numberRequests_;
   int numberRepeats_;
+  qint64 maxFeedSize_;
+  bool http2Enabled_;
+  bool clearConnections_;
+  bool paused_;
+
+  // Connections statistics of current update
+  int requestsCount_;
+  int http2Count_;
+  int handshakesCount_;
+  qint64 encodedBytes_;  // bytes on the wire, known only when body is decoded here
+  qint64 decodedBytes_;
   QTimer *timeout_;
   QTimer *getUrlTimer_;
+  bool dispatchPending_;
 
-  QQueue<int> idsQueue_;
-  QQueue<QString> feedsQueue_;
-  QQueue<QDateTime> dateQueue_;
-  QQueue<QString> userInfo_;
-
-  QList<QUrl> currentUrls_;
-  QList<int> currentIds_;
-  QList<QString> currentFeeds_;
-  QList<QDateTime> currentDates_;
-  QList<int> currentCount_;
-  QList<bool> currentHead_;
-  QList<int> currentTime_;
-  QList<QUrl> requestUrl_;
-  QList<QNetworkReply*> networkReply_;
+  // Per-host scheduler: one queue per host, served round-robin inside
+  // lane of each update class
+  QVector<Lane> lanes_;
+  int queuedCount_;
+  QHash<int, QString> activeFeeds_;
+  QHash<QString, int> hostActive_;
+  QHash<QString, qint64> hostDelay_;
+  QHash<int, QString> feedEtags_;
+  QElapsedTimer clock_;
+  QHash<QNetworkReply*, QByteArray> replyData_;
+
+  QHash<QNetworkReply*, FeedReply> replies_;
+  // Timer wheel with one slot per second of request timeout. Progress of
+  // reply only moves its deadline; reply is put in new slot when old
+  // one expires, so data chunks do not touch the wheel
+  QVector<QList<QNetworkReply*> > timeoutWheel_;
+  int wheelPos_;
   QList<QString> hostList_;
+  QHash<QString, HostBreaker> hostBreakers_;
+
+  // Redirects of current request of feed: last target and if any of them
+  // was temporary
+  QHash<int, QUrl> redirectTargets_;
+  QSet<int> temporaryRedirects_;
+  // Targets of temporary redirects requested directly till end of session
+  QHash<int, QUrl> redirectCache_;
+  // Target of permanent redirects and number of updates it was seen in a row
+  QHash<int, QPair<QString, int> > permanentRedirects_;
 
 };
 
@@ -0,0 +1,238 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "stressrun.h"
+
+#include "mainapplication.h"
+#include "mainwindow.h"
+#include "memoryaccounting.h"
+#include "updatefeeds.h"
+
+#include <stdio.h>
+
+// Rounds of replies when count is not given
+#define STRESS_ROUNDS 3
+// Every synthetic reply has new news for each round
+#define STRESS_FEED_NEWS 10
+// Replies handed to update thread per tick
+#define STRESS_INJECT_BATCH 100
+#define STRESS_INJECT_INTERVAL 50
+// User action is done on every tick while feeds are updated
+#define STRESS_ACTION_INTERVAL 100
+// Delay of GUI event loop is measured on every tick of probe
+#define STRESS_PROBE_INTERVAL 20
+// Run fails when GUI thread is blocked longer, ms
+#define STRESS_MAX_LATENCY 500
+#define STRESS_P99_LATENCY 100
+// Application is closed while the last round is still processed
+#define STRESS_SHUTDOWN_DELAY 1000
+// Word searched in news list
+#define STRESS_FIND_TEXT "stress"
+
+StressRun::StressRun(MainWindow *mainWindow, int rounds, QObject *parent)
+  : QObject(parent)
+  , mainWindow_(mainWindow)
+  , rounds_(rounds > 0 ? rounds : STRESS_ROUNDS)
+  , labelId_(0)
+  , round_(0)
+  , nextFeed_(0)
+  , injected_(0)
+  , actions_(0)
+  , passed_(false)
+{
+  probeTimer_.setInterval(STRESS_PROBE_INTERVAL);
+  injectTimer_.setInterval(STRESS_INJECT_INTERVAL);
+  actionTimer_.setInterval(STRESS_ACTION_INTERVAL);
+  connect(&probeTimer_, SIGNAL(timeout()), this, SLOT(probeLatency()));
+  connect(&injectTimer_, SIGNAL(timeout()), this, SLOT(injectReplies()));
+  connect(&actionTimer_, SIGNAL(timeout()), this, SLOT(userAction()));
+}
+
+void StressRun::start()
+{
+  QSqlQuery q(QSqlDatabase::database());
+  q.exec("SELECT id, xmlUrl FROM feeds WHERE xmlUrl!=''");
+  while (q.next()) {
+    feedIds_.append(q.value(0).toInt());
+    feedUrls_.append(q.value(1).toString());
+  }
+  q.exec("SELECT id FROM labels ORDER BY num LIMIT 1");
+  if (q.first())
+    labelId_ = q.value(0).toInt();
+
+  printf("Base: %s\n", qPrintable(QSqlDatabase::database().databaseName()));
+  printf("Stress: %d feeds, %d rounds\n", feedIds_.count(), rounds_);
+  fflush(stdout);
+  if (feedIds_.isEmpty()) {
+    printf("Base has no feeds\n");
+    emit finished();
+    return;
+  }
+
+  runClock_.start();
+  probeClock_.start();
+  probeTimer_.start();
+  injectTimer_.start();
+  actionTimer_.start();
+}
+
+bool StressRun::passed() const
+{
+  return passed_;
+}
+
+/** @brief Time between ticks above interval is time GUI thread was busy
+ *----------------------------------------------------------------------------*/
+void StressRun::probeLatency()
+{
+  int lag = probeClock_.restart() - STRESS_PROBE_INTERVAL;
+  lags_.append(qMax(lag, 0));
+}
+
+/** @brief Queue synthetic replies to update thread as network thread does
+ *----------------------------------------------------------------------------*/
+void StressRun::injectReplies()
+{
+  QObject *updateObject = mainApp->updateFeeds()->updateObject_;
+  for (int i = 0; i < STRESS_INJECT_BATCH; ++i) {
+    if (nextFeed_ >= feedIds_.count()) {
+      nextFeed_ = 0;
+      round_++;
+      printf("%-24s %10lld\n", qPrintable(QString("round %1 queued").arg(round_)),
+             runClock_.elapsed());
+      fflush(stdout);
+      if (round_ >= rounds_) {
+        injectTimer_.stop();
+        QTimer::singleShot(STRESS_SHUTDOWN_DELAY, this, SLOT(stop()));
+        return;
+      }
+    }
+    int feedId = feedIds_.at(nextFeed_);
+    QMetaObject::invokeMethod(updateObject, "getUrlDone", Qt::QueuedConnection,
+                              Q_ARG(int, 0), Q_ARG(int, feedId),
+                              Q_ARG(QString, feedUrls_.at(nextFeed_)),
+                              Q_ARG(QString, QString()),
+                              Q_ARG(QByteArray, feedData(feedId, round_)),
+                              Q_ARG(QDateTime, QDateTime::currentDateTimeUtc()),
+                              Q_ARG(QString, QString("UTF-8")),
+                              Q_ARG(QString, QString()));
+    nextFeed_++;
+    injected_++;
+  }
+}
+
+/** @brief Actions of user on news list done in turn
+ *----------------------------------------------------------------------------*/
+void StressRun::userAction()
+{
+  int action = actions_++ % 5;
+  if (action == 0) {
+    openFeed(feedIds_.at(qrand() % feedIds_.count()));
+    return;
+  }
+
+  NewsTabWidget *tab = mainWindow_->currentNewsTab;
+  if (!tab || !tab->newsModel_->rowCount())
+    return;
+  int row = qrand() % tab->newsModel_->rowCount();
+
+  switch (action) {
+  case 1:
+    selectNews(row);
+    tab->markNewsRead();
+    break;
+  case 2:
+    selectNews(row);
+    tab->deleteNews();
+    break;
+  case 3:
+    if (labelId_) {
+      selectNews(row);
+      tab->setLabelNews(labelId_);
+    }
+    break;
+  default:
+    if (tab->findText_->text().isEmpty())
+      tab->findText_->setText(STRESS_FIND_TEXT);
+    else
+      tab->findText_->clear();
+    QMetaObject::invokeMethod(tab->findText_, "returnPressed");
+  }
+}
+
+void StressRun::stop()
+{
+  probeTimer_.stop();
+  actionTimer_.stop();
+
+  qSort(lags_);
+  int maxLag = lags_.isEmpty() ? 0 : lags_.last();
+  int p99Lag = lags_.isEmpty() ? 0 : lags_.at(lags_.count() * 99 / 100);
+  passed_ = (maxLag <= STRESS_MAX_LATENCY) && (p99Lag <= STRESS_P99_LATENCY);
+
+  printf("%-24s %10d\n", "replies queued", injected_);
+  printf("%-24s %10d\n", "user actions", actions_);
+  printf("%-24s %10d\n", "GUI lag p99, ms", p99Lag);
+  printf("%-24s %10d\n", "GUI lag max, ms", maxLag);
+  printf("%-24s %10.1f\n", "memory, MB",
+         MemoryAccounting::processUsage() / (1024.0 * 1024.0));
+  printf("%s: limits %d ms p99, %d ms max\n", passed_ ? "PASS" : "FAIL",
+         STRESS_P99_LATENCY, STRESS_MAX_LATENCY);
+  fflush(stdout);
+
+  emit finished();
+}
+
+/** @brief RSS with news unique for feed and round
+ *----------------------------------------------------------------------------*/
+QByteArray StressRun::feedData(int feedId, int round) const
+{
+  QString date = QLocale::c().toString(QDateTime::currentDateTimeUtc(),
+                                       "ddd, dd MMM yyyy hh:mm:ss") + " +0000";
+  QString data = QString("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                         "<rss version=\"2.0\"><channel>"
+                         "<title>Stress feed %1</title>"
+                         "<link>http://feed%1.example.com/</link>\n").arg(feedId);
+  for (int i = 0; i < STRESS_FEED_NEWS; ++i) {
+    data.append(QString("<item><title>Stress news %1.%2 of feed %3</title>"
+                        "<link>http://feed%3.example.com/stress/%1/%2.html</link>"
+                        "<guid>stress-%3-%1-%2</guid>"
+                        "<pubDate>%4</pubDate>"
+                        "<description>&lt;p&gt;Round %1, news %2.&lt;/p&gt;</description>"
+                        "</item>\n").arg(round).arg(i).arg(feedId).arg(date));
+  }
+  data.append("</channel></rss>\n");
+  return data.toUtf8();
+}
+
+/** @brief Select feed in feeds tree as click does
+ *----------------------------------------------------------------------------*/
+void StressRun::openFeed(int feedId)
+{
+  QModelIndex index = mainWindow_->feedsProxyModel_->mapFromSource(feedId);
+  if (!index.isValid())
+    return;
+  mainWindow_->feedsView_->setCurrentIndex(index);
+  mainWindow_->slotFeedClicked(index);
+}
+
+void StressRun::selectNews(int row)
+{
+  NewsTabWidget *tab = mainWindow_->currentNewsTab;
+  tab->newsView_->setCurrentIndex(
+        tab->newsModel_->index(row, tab->newsModel_->fieldIndex("title")));
+}
@@ -0,0 +1,78 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef STRESSRUN_H
+#define STRESSRUN_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QList>
+#include <QTimer>
+
+class MainWindow;
+
+/** @brief Scripted load of update pipeline with checks of GUI responsiveness
+ *
+ * Synthetic replies for every feed of base are handed to update thread in
+ * batches, so parse and update threads and shared connections are busy.
+ * User actions are done meanwhile, and delay of GUI event loop is measured.
+ * Application is closed before the last round is processed.
+ * Build with CONFIG+=tsan to run it under ThreadSanitizer.
+ *----------------------------------------------------------------------------*/
+class StressRun : public QObject
+{
+  Q_OBJECT
+public:
+  StressRun(MainWindow *mainWindow, int rounds, QObject *parent = 0);
+
+  void start();
+  bool passed() const;
+
+signals:
+  void finished();
+
+private slots:
+  void probeLatency();
+  void injectReplies();
+  void userAction();
+  void stop();
+
+private:
+  QByteArray feedData(int feedId, int round) const;
+  void openFeed(int feedId);
+  void selectNews(int row);
+
+  MainWindow *mainWindow_;
+  int rounds_;
+  QList<int> feedIds_;
+  QStringList feedUrls_;
+  int labelId_;
+  int round_;
+  int nextFeed_;
+  int injected_;
+  int actions_;
+  QTimer probeTimer_;
+  QTimer injectTimer_;
+  QTimer actionTimer_;
+  QElapsedTimer probeClock_;
+  QElapsedTimer runClock_;
+  QList<int> lags_;
+  bool passed_;
+
+};
+
+#endif // STRESSRUN_H
@@ -0,0 +1,697 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "greadersync.h"
+
+#include "common.h"
+#include "database.h"
+#include "jsonreader.h"
+#include "logfile.h"
+#include "networkmanager.h"
+#include "settings.h"
+
+#include <QDebug>
+#include <QNetworkReply>
+#include <QTimer>
+#if QT_VERSION < 0x050000
+#include <QTextDocument>
+#endif
+
+// Request to server is aborted after (ms)
+#define SYNC_REQUEST_TIMEOUT 60000
+// Sync is repeated after feeds of new subscriptions are imported (ms)
+#define SYNC_IMPORT_DELAY 60000
+// Item ids in one edit-tag request
+#define SYNC_EDIT_BATCH 250
+// Item ids in one page of unread and starred ids
+#define SYNC_IDS_PAGE 10000
+// Items in one page of stream contents
+#define SYNC_CONTENTS_PAGE 500
+// Age of items received by first sync (sec)
+#define SYNC_FIRST_AGE 2592000
+// Items crawled at the time of previous sync are requested again (sec)
+#define SYNC_TIME_MARGIN 300
+// Lengths of description text of news, the same as of ParseWorker
+#define NEWS_SNIPPET_LENGTH 200
+#define NEWS_SIMHASH_LENGTH 4096
+
+static const char *kReadTag = "user/-/state/com.google/read";
+static const char *kStarredTag = "user/-/state/com.google/starred";
+static const char *kReadingList = "user/-/state/com.google/reading-list";
+
+GReaderSync::GReaderSync(const QString &apiUrl, const QString &user,
+                         const QString &password, int interval, QObject *parent)
+  : QObject(parent)
+  , reply_(NULL)
+  , step_(StepIdle)
+  , user_(user)
+  , password_(password)
+  , lastSync_(0)
+  , syncStart_(0)
+  , itemsCount_(0)
+{
+  setObjectName("syncClient_");
+
+  apiUrl_ = apiUrl.toUtf8();
+  while (apiUrl_.endsWith('/'))
+    apiUrl_.chop(1);
+
+  db_ = Database::connection("secondConnection");
+
+  networkManager_ = new NetworkManager(true, this);
+  connect(networkManager_, SIGNAL(finished(QNetworkReply*)),
+          this, SLOT(finished(QNetworkReply*)));
+
+  syncTimer_ = new QTimer(this);
+  syncTimer_->setInterval(qMax(1, interval) * 60000);
+  connect(syncTimer_, SIGNAL(timeout()), this, SLOT(sync()));
+
+  timeout_ = new QTimer(this);
+  timeout_->setSingleShot(true);
+  timeout_->setInterval(SYNC_REQUEST_TIMEOUT);
+  connect(timeout_, SIGNAL(timeout()), this, SLOT(slotTimeout()));
+}
+
+void GReaderSync::disconnectObjects()
+{
+  disconnect(this);
+  networkManager_->disconnect(networkManager_);
+}
+
+/** @brief Start periodic sync in thread of object
+ *----------------------------------------------------------------------------*/
+void GReaderSync::start()
+{
+  Settings settings;
+  lastSync_ = settings.value("Settings/syncLastTime", 0).toLongLong();
+
+  syncTimer_->start();
+  sync();
+}
+
+/** @brief Start one sync if previous one is finished
+ *----------------------------------------------------------------------------*/
+void GReaderSync::sync()
+{
+  if (step_ != StepIdle) return;
+
+  syncStart_ = QDateTime::currentDateTime().toTime_t();
+  itemsCount_ = 0;
+  streamFeeds_.clear();
+  edits_.clear();
+  unreadIds_.clear();
+  starredIds_.clear();
+  continuation_.clear();
+
+  // Token of previous sync is reused until server rejects it
+  if (!auth_.isEmpty()) {
+    get(StepToken, "/reader/api/0/token");
+    return;
+  }
+
+  QByteArray body;
+  body.append("Email=" + QUrl::toPercentEncoding(user_));
+  body.append("&Passwd=" + QUrl::toPercentEncoding(password_));
+  post(StepLogin, "/accounts/ClientLogin", body);
+}
+
+/** @brief Abort current sync, next one is started by timer
+ *----------------------------------------------------------------------------*/
+void GReaderSync::stop()
+{
+  if (step_ == StepIdle) return;
+
+  step_ = StepIdle;
+  timeout_->stop();
+  if (reply_) {
+    QNetworkReply *reply = reply_;
+    reply_ = NULL;
+    reply->abort();
+  }
+}
+
+void GReaderSync::get(Step step, const QByteArray &path, const QByteArray &query)
+{
+  QByteArray url = apiUrl_ + path;
+  if (!query.isEmpty())
+    url.append("?" + query);
+
+  QNetworkRequest request(QUrl::fromEncoded(url));
+  if (!auth_.isEmpty())
+    request.setRawHeader("Authorization", "GoogleLogin auth=" + auth_);
+
+  step_ = step;
+  reply_ = networkManager_->get(request);
+  timeout_->start();
+}
+
+void GReaderSync::post(Step step, const QByteArray &path, const QByteArray &body)
+{
+  QNetworkRequest request(QUrl::fromEncoded(apiUrl_ + path));
+  request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
+  if (!auth_.isEmpty())
+    request.setRawHeader("Authorization", "GoogleLogin auth=" + auth_);
+
+  step_ = step;
+  reply_ = networkManager_->post(request, body);
+  timeout_->start();
+}
+
+void GReaderSync::slotTimeout()
+{
+  if (reply_)
+    reply_->abort();
+}
+
+void GReaderSync::finishSync(bool ok, const QString &error)
+{
+  step_ = StepIdle;
+  reply_ = NULL;
+  if (!ok)
+    qWarning() << "Sync: error" << error;
+}
+
+void GReaderSync::finished(QNetworkReply *reply)
+{
+  reply->deleteLater();
+  if (reply != reply_) return;
+
+  timeout_->stop();
+  reply_ = NULL;
+
+  int httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+  if ((reply->error() != QNetworkReply::NoError) || (httpStatus / 100 != 2)) {
+    // Token is expired or password is changed
+    if (httpStatus == 401)
+      auth_.clear();
+    finishSync(false, QString("%1 %2").arg(httpStatus).arg(reply->errorString()));
+    return;
+  }
+
+  QByteArray data = reply->readAll();
+  switch (step_) {
+  case StepLogin:
+    replyLogin(data);
+    break;
+  case StepToken:
+    token_ = data.trimmed();
+    get(StepSubscriptions, "/reader/api/0/subscription/list", "output=json");
+    break;
+  case StepSubscriptions:
+    replySubscriptions(data);
+    break;
+  case StepEditTag:
+    saveEdit(edits_.takeFirst());
+    sendNextEdit();
+    break;
+  case StepUnreadIds:
+    replyIds(data, &unreadIds_);
+    break;
+  case StepStarredIds:
+    replyIds(data, &starredIds_);
+    break;
+  case StepContents:
+    replyContents(data);
+    break;
+  default:
+    break;
+  }
+}
+
+void GReaderSync::replyLogin(const QByteArray &data)
+{
+  foreach (const QByteArray &line, data.split('\n')) {
+    if (line.startsWith("Auth="))
+      auth_ = line.mid(5).trimmed();
+  }
+  if (auth_.isEmpty()) {
+    finishSync(false, "login is rejected");
+    return;
+  }
+  get(StepToken, "/reader/api/0/token");
+}
+
+/** @brief Map subscriptions of server to feeds
+ *
+ * Feeds of server are updated by server only. Subscriptions without feed
+ * are imported, then sync is repeated.
+ *----------------------------------------------------------------------------*/
+void GReaderSync::replySubscriptions(const QByteArray &data)
+{
+  QHash<QString, int> feedIds;
+  QSqlQuery q(db_);
+  q.exec("SELECT id, xmlUrl FROM feeds WHERE xmlUrl!=''");
+  while (q.next()) {
+    feedIds.insert(q.value(1).toString().toLower(), q.value(0).toInt());
+  }
+
+  QString outlines;
+  JsonReader json(QString::fromUtf8(data));
+  if (json.readNext() == JsonReader::StartObject) {
+    while (json.readNext() == JsonReader::Name) {
+      if ((json.text() != "subscriptions") || !json.readStartArray()) {
+        json.skipValue();
+        continue;
+      }
+      int depth = json.depth();
+      while (json.readNext() == JsonReader::StartObject) {
+        QString streamId;
+        QString title;
+        QString url;
+        while (json.readNext() == JsonReader::Name) {
+          const QString name = json.text();
+          if (name == "id")
+            streamId = json.readText();
+          else if (name == "title")
+            title = json.readText();
+          else if (name == "url")
+            url = json.readText();
+          else
+            json.skipValue();
+        }
+        if (url.isEmpty() && streamId.startsWith("feed/"))
+          url = streamId.mid(5);
+        if (url.isEmpty())
+          continue;
+
+        int feedId = feedIds.value(url.toLower(), 0);
+        if (feedId) {
+          streamFeeds_.insert(streamId, feedId);
+        } else if (!importedUrls_.contains(url.toLower())) {
+          importedUrls_.insert(url.toLower());
+#if QT_VERSION >= 0x050000
+          title = title.toHtmlEscaped();
+          url = url.toHtmlEscaped();
+#else
+          title = Qt::escape(title);
+          url = Qt::escape(url);
+#endif
+          outlines.append(QString("<outline text=\"%1\" title=\"%1\" type=\"rss\" xmlUrl=\"%2\"/>\n").
+                          arg(title, url));
+        }
+      }
+      json.leave(depth);
+    }
+  }
+  if (json.hasError()) {
+    finishSync(false, "subscriptions: " + json.errorString());
+    return;
+  }
+
+  if (!outlines.isEmpty()) {
+    QString opml = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<opml version=\"2.0\"><head><title>Sync</title></head><body>\n" +
+        outlines + "</body></opml>\n";
+    emit signalImportFeeds(opml.toUtf8());
+    finishSync(true);
+    QTimer::singleShot(SYNC_IMPORT_DELAY, this, SLOT(sync()));
+    return;
+  }
+
+  db_.transaction();
+  q.prepare("UPDATE feeds SET disableUpdate=1 WHERE id=? AND disableUpdate=0");
+  foreach (int feedId, streamFeeds_) {
+    q.addBindValue(feedId);
+    q.exec();
+  }
+  db_.commit();
+
+  prepareEdits();
+  sendNextEdit();
+}
+
+/** @brief Split local changes of read and starred state into batches
+ *----------------------------------------------------------------------------*/
+void GReaderSync::prepareEdits()
+{
+  EditBatch batches[4];
+  batches[0].tag = kReadTag;
+  batches[0].add = true;
+  batches[1].tag = kReadTag;
+  batches[1].add = false;
+  batches[2].tag = kStarredTag;
+  batches[2].add = true;
+  batches[3].tag = kStarredTag;
+  batches[3].add = false;
+
+  QSqlQuery q(db_);
+  q.exec("SELECT s.itemId, n.read>0, n.starred, s.read, s.starred "
+         "FROM syncItems s JOIN news n ON n.id=s.newsId "
+         "WHERE (n.read>0)!=s.read OR n.starred!=s.starred");
+  while (q.next()) {
+    bool read = q.value(1).toInt();
+    bool starred = q.value(2).toInt();
+    if (read != q.value(3).toBool())
+      batches[read ? 0 : 1].itemIds.append(q.value(0).toString());
+    if (starred != q.value(4).toBool())
+      batches[starred ? 2 : 3].itemIds.append(q.value(0).toString());
+  }
+
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < batches[i].itemIds.count(); j += SYNC_EDIT_BATCH) {
+      EditBatch batch = batches[i];
+      batch.itemIds = batches[i].itemIds.mid(j, SYNC_EDIT_BATCH);
+      edits_.append(batch);
+    }
+  }
+}
+
+void GReaderSync::sendNextEdit()
+{
+  if (edits_.isEmpty()) {
+    requestIds(StepUnreadIds);
+    return;
+  }
+
+  const EditBatch &batch = edits_.first();
+  QByteArray body = "T=" + QUrl::toPercentEncoding(token_);
+  body.append(batch.add ? "&a=" : "&r=");
+  body.append(QUrl::toPercentEncoding(batch.tag));
+  foreach (const QString &itemId, batch.itemIds) {
+    body.append("&i=" + QUrl::toPercentEncoding(longItemId(itemId)));
+  }
+  post(StepEditTag, "/reader/api/0/edit-tag", body);
+}
+
+void GReaderSync::saveEdit(const EditBatch &batch)
+{
+  QSqlQuery q(db_);
+  if (batch.tag == kReadTag)
+    q.prepare("UPDATE syncItems SET read=? WHERE itemId=?");
+  else
+    q.prepare("UPDATE syncItems SET starred=? WHERE itemId=?");
+
+  db_.transaction();
+  foreach (const QString &itemId, batch.itemIds) {
+    q.addBindValue(batch.add ? 1 : 0);
+    q.addBindValue(itemId);
+    q.exec();
+  }
+  db_.commit();
+}
+
+void GReaderSync::requestIds(Step step)
+{
+  QByteArray query;
+  if (step == StepUnreadIds) {
+    query = "s=" + QUrl::toPercentEncoding(kReadingList);
+    query.append("&xt=" + QUrl::toPercentEncoding(kReadTag));
+  } else {
+    query = "s=" + QUrl::toPercentEncoding(kStarredTag);
+  }
+  query.append("&n=" + QByteArray::number(SYNC_IDS_PAGE));
+  if (!continuation_.isEmpty())
+    query.append("&c=" + QUrl::toPercentEncoding(continuation_));
+  get(step, "/reader/api/0/stream/items/ids", query);
+}
+
+void GReaderSync::replyIds(const QByteArray &data, QSet<QString> *ids)
+{
+  continuation_.clear();
+  JsonReader json(QString::fromUtf8(data));
+  if (json.readNext() == JsonReader::StartObject) {
+    while (json.readNext() == JsonReader::Name) {
+      if (json.text() == "continuation") {
+        continuation_ = json.readText();
+        continue;
+      }
+      if ((json.text() != "itemRefs") || !json.readStartArray()) {
+        json.skipValue();
+        continue;
+      }
+      int depth = json.depth();
+      while (json.readNext() == JsonReader::StartObject) {
+        while (json.readNext() == JsonReader::Name) {
+          if (json.text() == "id")
+            ids->insert(shortItemId(json.readText()));
+          else
+            json.skipValue();
+        }
+      }
+      json.leave(depth);
+    }
+  }
+  if (json.hasError()) {
+    finishSync(false, "item ids: " + json.errorString());
+    return;
+  }
+
+  if (!continuation_.isEmpty()) {
+    requestIds(step_);
+  } else if (step_ == StepUnreadIds) {
+    requestIds(StepStarredIds);
+  } else {
+    applyServerState();
+    requestContents();
+  }
+}
+
+/** @brief Set state of news by unread and starred ids of server
+ *----------------------------------------------------------------------------*/
+void GReaderSync::applyServerState()
+{
+  QSet<int> changedFeeds;
+  bool starredChanged = false;
+
+  QSqlQuery q(db_);
+  QSqlQuery qUpdate(db_);
+  db_.transaction();
+  q.exec("SELECT itemId, newsId, feedId, read, starred FROM syncItems WHERE newsId>0");
+  while (q.next()) {
+    QString itemId = q.value(0).toString();
+    int newsId = q.value(1).toInt();
+    bool read = !unreadIds_.contains(itemId);
+    bool starred = starredIds_.contains(itemId);
+
+    if (read != q.value(3).toBool()) {
+      if (read)
+        qUpdate.prepare("UPDATE news SET read=2, new=0 WHERE id=?");
+      else
+        qUpdate.prepare("UPDATE news SET read=0 WHERE id=?");
+      qUpdate.addBindValue(newsId);
+      qUpdate.exec();
+      changedFeeds.insert(q.value(2).toInt());
+    }
+    if (starred != q.value(4).toBool()) {
+      qUpdate.prepare("UPDATE news SET starred=? WHERE id=?");
+      qUpdate.addBindValue(starred ? 1 : 0);
+      qUpdate.addBindValue(newsId);
+      qUpdate.exec();
+      starredChanged = true;
+    }
+    if ((read != q.value(3).toBool()) || (starred != q.value(4).toBool())) {
+      qUpdate.prepare("UPDATE syncItems SET read=?, starred=? WHERE itemId=?");
+      qUpdate.addBindValue(read ? 1 : 0);
+      qUpdate.addBindValue(starred ? 1 : 0);
+      qUpdate.addBindValue(itemId);
+      qUpdate.exec();
+    }
+  }
+  db_.commit();
+
+  foreach (int feedId, changedFeeds) {
+    emit signalFeedStateChanged(feedId);
+  }
+  if (starredChanged || !changedFeeds.isEmpty())
+    emit signalCategoryCountsChanged();
+}
+
+void GReaderSync::requestContents()
+{
+  qint64 since = lastSync_ ? lastSync_ : syncStart_ - SYNC_FIRST_AGE;
+
+  QByteArray query = "output=json&n=" + QByteArray::number(SYNC_CONTENTS_PAGE);
+  query.append("&ot=" + QByteArray::number(since));
+  if (!continuation_.isEmpty())
+    query.append("&c=" + QUrl::toPercentEncoding(continuation_));
+  get(StepContents, "/reader/api/0/stream/contents/" +
+      QUrl::toPercentEncoding(kReadingList, "/"), query);
+}
+
+/** @brief Read page of items and pass them to ParseObject by feed
+ *----------------------------------------------------------------------------*/
+void GReaderSync::replyContents(const QByteArray &data)
+{
+  QHash<int, ParsedFeedStruct> parsedFeeds;
+  continuation_.clear();
+
+  QSqlQuery q(db_);
+  q.prepare("INSERT OR IGNORE INTO syncItems(itemId, feedId, read, starred) "
+            "VALUES (?, ?, ?, ?)");
+  db_.transaction();
+
+  JsonReader json(QString::fromUtf8(data));
+  if (json.readNext() == JsonReader::StartObject) {
+    while (json.readNext() == JsonReader::Name) {
+      if (json.text() == "continuation") {
+        continuation_ = json.readText();
+        continue;
+      }
+      if ((json.text() != "items") || !json.readStartArray()) {
+        json.skipValue();
+        continue;
+      }
+      int depth = json.depth();
+      while (json.readNext() == JsonReader::StartObject) {
+        NewsItemStruct newsItem;
+        QString streamId;
+        QString summary;
+        QStringList categories;
+        while (json.readNext() == JsonReader::Name) {
+          const QString name = json.text();
+          if (name == "id") {
+            newsItem.id = shortItemId(json.readText());
+          } else if (name == "title") {
+            newsItem.title = json.readText();
+          } else if (name == "published") {
+            uint published = json.readText().toUInt();
+            if (published)
+              newsItem.updated = QDateTime::fromTime_t(published).toUTC().toString(Qt::ISODate);
+          } else if (name == "author") {
+            newsItem.author = json.readText();
+          } else if ((name == "canonical") || (name == "alternate")) {
+            if (!json.readStartArray())
+              continue;
+            int linkDepth = json.depth();
+            while (json.readNext() == JsonReader::StartObject) {
+              while (json.readNext() == JsonReader::Name) {
+                if ((json.text() == "href") && newsItem.link.isEmpty())
+                  newsItem.link = json.readText();
+                else
+                  json.skipValue();
+              }
+            }
+            json.leave(linkDepth);
+          } else if ((name == "summary") || (name == "content")) {
+            if (json.readNext() != JsonReader::StartObject)
+              continue;
+            while (json.readNext() == JsonReader::Name) {
+              if ((json.text() == "content") && (name == "content"))
+                newsItem.description = json.readText();
+              else if (json.text() == "content")
+                summary = json.readText();
+              else
+                json.skipValue();
+            }
+          } else if (name == "origin") {
+            if (json.readNext() != JsonReader::StartObject)
+              continue;
+            while (json.readNext() == JsonReader::Name) {
+              if (json.text() == "streamId")
+                streamId = json.readText();
+              else
+                json.skipValue();
+            }
+          } else if (name == "categories") {
+            if (!json.readStartArray())
+              continue;
+            int categoryDepth = json.depth();
+            while (json.readNext() == JsonReader::String)
+              categories.append(json.text());
+            json.leave(categoryDepth);
+          } else {
+            json.skipValue();
+          }
+        }
+
+        int feedId = streamFeeds_.value(streamId, 0);
+        if (!feedId || newsItem.id.isEmpty())
+          continue;
+
+        bool read = false;
+        bool starred = false;
+        QStringList labels;
+        foreach (const QString &category, categories) {
+          if (category.endsWith("/state/com.google/read"))
+            read = true;
+          else if (category.endsWith("/state/com.google/starred"))
+            starred = true;
+          else if (category.contains("/label/"))
+            labels.append(category.section("/label/", 1));
+        }
+        q.addBindValue(newsItem.id);
+        q.addBindValue(feedId);
+        q.addBindValue(read ? 1 : 0);
+        q.addBindValue(starred ? 1 : 0);
+        q.exec();
+
+        if (newsItem.description.isEmpty())
+          newsItem.description = summary;
+        newsItem.category = labels.join(", ");
+        newsItem.title = Common::htmlToPlainText(newsItem.title);
+        newsItem.snippet = Common::htmlToPlainText(summary.isEmpty() ? newsItem.description : summary,
+                                                   NEWS_SNIPPET_LENGTH);
+        newsItem.titleHash = Common::titleFingerprint(newsItem.title);
+        newsItem.simhash = Common::simHash(Common::htmlToPlainText(newsItem.description,
+                                                                   NEWS_SIMHASH_LENGTH));
+
+        ParsedFeedStruct &parsedFeed = parsedFeeds[feedId];
+        if (parsedFeed.feedType.isEmpty()) {
+          parsedFeed.feedId = feedId;
+          parsedFeed.dtReply = QDateTime::currentDateTimeUtc();
+          parsedFeed.feedType = "sync";
+        }
+        parsedFeed.newsItems.append(newsItem);
+        itemsCount_++;
+      }
+      json.leave(depth);
+    }
+  }
+  db_.commit();
+
+  if (json.hasError()) {
+    finishSync(false, "items: " + json.errorString());
+    return;
+  }
+
+  foreach (const ParsedFeedStruct &parsedFeed, parsedFeeds) {
+    emit signalNewsReady(parsedFeed);
+  }
+
+  if (!continuation_.isEmpty()) {
+    requestContents();
+    return;
+  }
+
+  lastSync_ = syncStart_ - SYNC_TIME_MARGIN;
+  Settings settings;
+  settings.setValue("Settings/syncLastTime", lastSync_);
+  LOG_DEBUG(LogFile::Sync) << "Sync: done, items" << itemsCount_;
+  finishSync(true);
+}
+
+/** @brief Id of item in short form used in base
+ *
+ * Item id of tag form keeps 16 hex digits, ids of stream/items/ids are
+ * decimal.
+ *----------------------------------------------------------------------------*/
+QString GReaderSync::shortItemId(const QString &itemId)
+{
+  if (itemId.startsWith("tag:"))
+    return itemId.section('/', -1).rightJustified(16, QChar('0'));
+
+  bool ok;
+  quint64 id = itemId.toULongLong(&ok);
+  if (!ok)
+    return itemId;
+  return QString("%1").arg(id, 16, 16, QChar('0'));
+}
+
+QString GReaderSync::longItemId(const QString &itemId)
+{
+  return "tag:google.com,2005:reader/item/" + itemId;
+}
@@ -0,0 +1,127 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef GREADERSYNC_H
+#define GREADERSYNC_H
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QtSql>
+
+#include "parseworker.h"
+
+class QNetworkReply;
+class QTimer;
+class NetworkManager;
+
+/** @brief Sync client of Google Reader compatible API (FreshRSS, Miniflux,
+ *  Inoreader and others)
+ *
+ * One sync is a chain of requests: login, token, subscriptions, batched
+ * edit-tag of local state changes, ids of unread and starred items, and
+ * items crawled since previous sync (ot) page by page. Items are passed to
+ * ParseObject by feed, state of items known to server is kept in syncItems
+ * table.
+ *----------------------------------------------------------------------------*/
+class GReaderSync : public QObject
+{
+  Q_OBJECT
+public:
+  explicit GReaderSync(const QString &apiUrl, const QString &user,
+                       const QString &password, int interval, QObject *parent = 0);
+
+  void disconnectObjects();
+
+public slots:
+  void start();
+  void sync();
+  void stop();
+
+signals:
+  void signalNewsReady(const ParsedFeedStruct &parsedFeed);
+  void signalImportFeeds(const QByteArray &opmlData);
+  void signalFeedStateChanged(int feedId);
+  void signalCategoryCountsChanged();
+
+private slots:
+  void finished(QNetworkReply *reply);
+  void slotTimeout();
+
+private:
+  enum Step {
+    StepIdle,
+    StepLogin,
+    StepToken,
+    StepSubscriptions,
+    StepEditTag,
+    StepUnreadIds,
+    StepStarredIds,
+    StepContents
+  };
+
+  struct EditBatch {
+    QString tag;
+    bool add;
+    QStringList itemIds;
+  };
+
+  void get(Step step, const QByteArray &path, const QByteArray &query = QByteArray());
+  void post(Step step, const QByteArray &path, const QByteArray &body);
+  void finishSync(bool ok, const QString &error = QString());
+
+  void replyLogin(const QByteArray &data);
+  void replySubscriptions(const QByteArray &data);
+  void prepareEdits();
+  void sendNextEdit();
+  void saveEdit(const EditBatch &batch);
+  void requestIds(Step step);
+  void replyIds(const QByteArray &data, QSet<QString> *ids);
+  void applyServerState();
+  void requestContents();
+  void replyContents(const QByteArray &data);
+
+  static QString shortItemId(const QString &itemId);
+  static QString longItemId(const QString &itemId);
+
+  QSqlDatabase db_;
+  NetworkManager *networkManager_;
+  QTimer *syncTimer_;
+  QTimer *timeout_;
+  QNetworkReply *reply_;
+  Step step_;
+
+  QByteArray apiUrl_;
+  QString user_;
+  QString password_;
+  QByteArray auth_;
+  QByteArray token_;
+
+  QHash<QString, int> streamFeeds_;
+  QSet<QString> importedUrls_;
+  QList<EditBatch> edits_;
+  QSet<QString> unreadIds_;
+  QSet<QString> starredIds_;
+  QString continuation_;
+  qint64 lastSync_;
+  qint64 syncStart_;
+  int itemsCount_;
+
+};
+
+#endif // GREADERSYNC_H
@@ -0,0 +1,165 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "uibenchmark.h"
+
+#include "mainwindow.h"
+#include "parsebenchmark.h"
+
+#include <stdio.h>
+
+// Feeds tree is rebuilt several times, best time is printed
+#define UI_BENCH_RUNS 3
+// Word searched in news list, generated base uses it in titles
+#define UI_BENCH_FIND_TEXT "release"
+
+UiBenchmark::UiBenchmark(MainWindow *mainWindow)
+  : mainWindow_(mainWindow)
+{
+}
+
+void UiBenchmark::run()
+{
+  QElapsedTimer timer;
+  printf("Base: %s\n", qPrintable(QSqlDatabase::database().databaseName()));
+  printf("%-24s %10s\n", "step", "ms");
+
+  // Feeds tree is loaded completely, as after import of feeds
+  qint64 best = -1;
+  for (int i = 0; i < UI_BENCH_RUNS; ++i) {
+    timer.start();
+    mainWindow_->feedsModelReload();
+    processEvents();
+    best = (best < 0) ? timer.elapsed() : qMin(best, timer.elapsed());
+  }
+  printTime("feeds refresh", best, QString("best of %1").arg(UI_BENCH_RUNS));
+
+  int feedId = feedIdByQuery("SELECT id FROM feeds WHERE xmlUrl!='' "
+                             "ORDER BY (SELECT undeleteCount FROM feedsState WHERE feedId=feeds.id) DESC LIMIT 1");
+  int folderId = feedIdByQuery("SELECT id FROM feeds WHERE ifnull(xmlUrl, '')=='' "
+                               "ORDER BY (SELECT undeleteCount FROM feedsState WHERE feedId=feeds.id) DESC LIMIT 1");
+  if (!feedId) {
+    printf("Base has no feeds\n");
+    return;
+  }
+
+  timer.start();
+  openFeed(feedId);
+  NewsTabWidget *tab = mainWindow_->currentNewsTab;
+  printTime("open biggest feed", timer.elapsed(),
+            QString("%1 news loaded").arg(tab->newsModel_->rowCount()));
+
+  // Scrolling to the end of list loads all news
+  timer.start();
+  while (tab->newsModel_->canFetchMore())
+    tab->newsModel_->fetchMore();
+  processEvents();
+  printTime("load all news", timer.elapsed(),
+            QString("%1 news").arg(tab->newsModel_->rowCount()));
+
+  int sortSection = tab->newsHeader_->sortIndicatorSection();
+  Qt::SortOrder sortOrder = tab->newsHeader_->sortIndicatorOrder();
+  timer.start();
+  tab->newsView_->sortByColumn(tab->newsModel_->fieldIndex("title"), Qt::AscendingOrder);
+  processEvents();
+  printTime("sort by title", timer.elapsed());
+  timer.start();
+  tab->newsView_->sortByColumn(tab->newsModel_->fieldIndex("published"), Qt::DescendingOrder);
+  processEvents();
+  printTime("sort by date", timer.elapsed());
+  tab->newsView_->sortByColumn(sortSection, sortOrder);
+  processEvents();
+
+  timer.start();
+  tab->findText_->setText(UI_BENCH_FIND_TEXT);
+  QMetaObject::invokeMethod(tab->findText_, "returnPressed");
+  processEvents();
+  printTime("search", timer.elapsed(),
+            QString("%1 news found").arg(tab->newsModel_->rowCount()));
+  timer.start();
+  tab->findText_->clear();
+  QMetaObject::invokeMethod(tab->findText_, "returnPressed");
+  processEvents();
+  printTime("clear search", timer.elapsed());
+
+  if (folderId) {
+    timer.start();
+    openFeed(folderId);
+    printTime("open biggest folder", timer.elapsed(),
+              QString("%1 news loaded").arg(mainWindow_->currentNewsTab->newsModel_->rowCount()));
+  }
+
+  QList<QTreeWidgetItem *> categories;
+  categories << mainWindow_->categoriesTree_->topLevelItem(CategoriesTreeWidget::UnreadItem)
+             << mainWindow_->categoriesTree_->topLevelItem(CategoriesTreeWidget::StarredItem)
+             << mainWindow_->categoriesTree_->topLevelItem(CategoriesTreeWidget::DeletedItem);
+  if (mainWindow_->categoriesTree_->labelsCount())
+    categories << mainWindow_->categoriesTree_->getLabelListItems().first();
+  foreach (QTreeWidgetItem *item, categories) {
+    timer.start();
+    mainWindow_->categoriesTree_->setCurrentItem(item);
+    mainWindow_->slotCategoriesClicked(item, 0);
+    processEvents();
+    printTime(QString("open category %1").arg(item->text(0)), timer.elapsed(),
+              QString("%1 news loaded").arg(mainWindow_->currentNewsTab->newsModel_->rowCount()));
+  }
+
+  openFeed(feedId);
+  QAction *layoutAction = mainWindow_->layoutGroup_->checkedAction();
+  mainWindow_->newspaperLayoutAct_->setChecked(true);
+  timer.start();
+  mainWindow_->setNewsLayout(mainWindow_->newspaperLayoutAct_);
+  processEvents();
+  printTime("newspaper layout", timer.elapsed());
+  layoutAction->setChecked(true);
+  mainWindow_->setNewsLayout(layoutAction);
+  processEvents();
+
+  printf("Peak memory: %.1f MB\n", ParseBenchmark::peakMemory() / (1024.0 * 1024.0));
+  fflush(stdout);
+}
+
+/** @brief Select feed or folder in feeds tree as click does
+ *----------------------------------------------------------------------------*/
+void UiBenchmark::openFeed(int feedId)
+{
+  QModelIndex index = mainWindow_->feedsProxyModel_->mapFromSource(feedId);
+  mainWindow_->feedsView_->setCurrentIndex(index);
+  mainWindow_->slotFeedClicked(index);
+  processEvents();
+}
+
+void UiBenchmark::printTime(const QString &step, qint64 elapsed, const QString &info)
+{
+  printf("%-24s %10lld  %s\n", qPrintable(step), elapsed, qPrintable(info));
+  fflush(stdout);
+}
+
+void UiBenchmark::processEvents()
+{
+  QCoreApplication::sendPostedEvents();
+  QCoreApplication::processEvents();
+}
+
+int UiBenchmark::feedIdByQuery(const QString &query)
+{
+  QSqlQuery q(QSqlDatabase::database());
+  q.exec(query);
+  if (q.first())
+    return q.value(0).toInt();
+  return 0;
+}
@@ -0,0 +1,47 @@
+/* ============================================================
+* QuiteRSS is a open-source cross-platform RSS/Atom news feeds reader
+* Copyright (C) 2011-2019 QuiteRSS Team <quiterssteam@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <https://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef UIBENCHMARK_H
+#define UIBENCHMARK_H
+
+#include <QString>
+
+class MainWindow;
+
+/** @brief Scripted run of slow operations of main window
+ *
+ * Every step is done the way user action does it and is timed together
+ * with processing of events it posts, so repaint is included.
+ *----------------------------------------------------------------------------*/
+class UiBenchmark
+{
+public:
+  explicit UiBenchmark(MainWindow *mainWindow);
+
+  void run();
+
+private:
+  void openFeed(int feedId);
+  void printTime(const QString &step, qint64 elapsed, const QString &info = QString());
+  static void processEvents();
+  static int feedIdByQuery(const QString &query);
+
+  MainWindow *mainWindow_;
+
+};
+
+#endif // UIBENCHMARK_H
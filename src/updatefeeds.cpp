@@ -19,23 +19,106 @@
 
 #include "mainapplication.h"
 #include "database.h"
+#include "common.h"
 #include "settings.h"
+#include "eventtrace.h"
+#include "logfile.h"
+#include "pipelinemetrics.h"
 
 #include <QDebug>
 #include <qzregexp.h>
 
+#include <algorithm>
+
 #define UPDATE_INTERVAL 3000
 #define UPDATE_INTERVAL_MIN 500
+#define PARSE_THREADS_MAX 8
+// Adaptive update: number of last news to estimate publish interval
+#define ADAPTIVE_NEWS_COUNT 10
+// Adaptive update: maximum interval between updates of feed (sec)
+#define ADAPTIVE_INTERVAL_MAX 86400
+// Failed updates in a row after which feed is not updated by timer for a while
+#define FEED_BREAKER_FAILURES 3
+// Back-off of failing feed, doubled by each next failure (sec)
+#define FEED_BACKOFF_MIN 3600
+#define FEED_BACKOFF_MAX 604800
+// Update cost budget: updates of feed averaged before it may be demoted
+#define FEED_COST_SAMPLES 3
+// Update cost budget: average cost of update for feed to be demoted (ms)
+#define FEED_COST_MIN 500
+// Update cost budget: cost per new news for feed to be demoted (ms)
+#define FEED_COST_PER_NEWS 250
+// Demoted feeds are updated by timer this times less often
+#define FEED_DEMOTION_FACTOR 4
+// Staggered update: maximum time to spread feeds requests over (sec)
+#define STAGGER_WINDOW_MAX 1800
+// Import: feeds requested at once and interval between batches (ms)
+#define IMPORT_FETCH_BATCH 10
+#define IMPORT_FETCH_INTERVAL 2000
+// Progress, status and finished feeds are sent to GUI at most this often (ms)
+#define PROGRESS_INTERVAL 100
+// News state changes are collected for this time before written (ms)
+#define NEWS_STATE_INTERVAL 250
+// Delay (ms) to collect received icons into one transaction
+#define ICON_SAVE_INTERVAL 1000
+// Delay of batched update time of feeds with unchanged payload, ms
+#define UNCHANGED_SAVE_INTERVAL 1000
+// Cleanup: steps done for all feeds at once before counters recalculation
+#define CLEANUP_STEPS 3
+// Tombstones published this long before horizon of feed are dropped (days)
+#define TOMBSTONE_HORIZON_MARGIN 30
+// Idle vacuum: check interval and interval between slices (ms)
+#define VACUUM_IDLE_INTERVAL 60000
+#define VACUUM_SLICE_INTERVAL 1000
+// Idle vacuum: free pages returned to file system by one slice
+#define VACUUM_SLICE_PAGES 256
+// Idle archive: check interval and interval between chunks (ms)
+#define ARCHIVE_IDLE_INTERVAL 600000
+#define ARCHIVE_SLICE_INTERVAL 1000
+// Idle archive: news moved to archive base by one chunk
+#define ARCHIVE_SLICE_NEWS 500
+// Rows of categories counters table, labels use their ids
+#define CATEGORY_STARRED -1
+#define CATEGORY_DELETED -2
+#define CATEGORY_TOTAL -3
+// Clean up deferred from shutdown: delay after start and retry while busy (ms)
+#define CLEANUP_IDLE_DELAY 120000
+// Idle maintenance of base: check interval and interval between tables (ms)
+#define MAINTENANCE_IDLE_INTERVAL 600000
+#define MAINTENANCE_SLICE_INTERVAL 1000
+// Idle maintenance: days between optimizing planner and checking base
+#define MAINTENANCE_DAYS 7
+
+// Counts of not deleted news of feed, read by typed columns
+static const char *kNewsCountsQuery =
+    "SELECT count(id), sum(CASE WHEN read==0 THEN 1 ELSE 0 END), "
+    "sum(CASE WHEN new==1 THEN 1 ELSE 0 END) "
+    "FROM news WHERE feedId=? AND deleted==0";
+
+struct NewsCountsRow {
+  int undeleteCount;
+  int unreadCount;
+  int newCount;
+
+  void read(const SQLiteStatement &statement) {
+    undeleteCount = statement.intValue(0);
+    unreadCount = statement.intValue(1);
+    newCount = statement.intValue(2);
+  }
+};
 
-UpdateFeeds::UpdateFeeds(QObject *parent, bool addFeed)
+UpdateFeeds::UpdateFeeds(QObject *parent)
   : QObject(parent)
   , updateObject_(NULL)
   , requestFeed_(NULL)
   , parseObject_(NULL)
   , faviconObject_(NULL)
+  , imagePrefetcher_(NULL)
+  , articleFetcher_(NULL)
+  , webSubClient_(NULL)
+  , syncClient_(NULL)
   , updateFeedThread_(NULL)
   , getFaviconThread_(NULL)
-  , addFeed_(addFeed)
   , saveMemoryDBTimer_(NULL)
 {
   getFeedThread_ = new QThread();
@@ -43,179 +126,312 @@ UpdateFeeds::UpdateFeeds(QObject *parent, bool addFeed)
   updateFeedThread_ = new QThread();
   updateFeedThread_->setObjectName("updateFeedThread_");
 
-  Settings settings;
-  int timeoutRequest = settings.value("Settings/timeoutRequest", 15).toInt();
-  int numberRequests = settings.value("Settings/numberRequest", 10).toInt();
-  int numberRepeats = settings.value("Settings/numberRepeats", 2).toInt();
+  QSharedPointer<const SettingsSnapshot> options = Settings::snapshot();
+  int parseThreads = qBound(1, options->parseThreads, PARSE_THREADS_MAX);
+
+  requestFeed_ = new RequestFeed(options->timeoutRequest, options->numberRequests,
+                                 options->numberRepeats, options->maxFeedSize,
+                                 options->http2Enabled);
+
+  parseObject_ = new ParseObject("secondConnection");
+
+  // Feeds are decoded in parallel, but written to base by parseObject_ only
+  qRegisterMetaType<ParsedFeedStruct>("ParsedFeedStruct");
+  qRegisterMetaType<FetchedFeed>("FetchedFeed");
+  qRegisterMetaType<FeedRequestList>("FeedRequestList");
+  for (int i = 0; i < parseThreads; ++i) {
+    QThread *parseThread = new QThread();
+    parseThread->setObjectName(QString("parseThread_%1").arg(i));
+    ParseWorker *parseWorker = new ParseWorker();
+    parseWorker->moveToThread(parseThread);
+    parseThreads_.append(parseThread);
+    parseWorkers_.append(parseWorker);
+  }
+  parseObject_->setWorkers(parseWorkers_);
+
+  getFaviconThread_ = new QThread();
+  getFaviconThread_->setObjectName("getFaviconThread_");
+
+  updateObject_ = new UpdateObject();
+  faviconObject_ = new FaviconObject();
+
+  connect(updateObject_, SIGNAL(signalRequestUrl(int,QString,QDateTime,QString,QString,int)),
+          requestFeed_, SLOT(requestUrl(int,QString,QDateTime,QString,QString,int)));
+  connect(updateObject_, SIGNAL(signalRequestUrls(FeedRequestList)),
+          requestFeed_, SLOT(requestUrls(FeedRequestList)));
+  connect(updateObject_, SIGNAL(signalPromoteFeed(int)),
+          requestFeed_, SLOT(promoteFeed(int)));
+  connect(updateObject_, SIGNAL(signalPromoteFeed(int)),
+          parseObject_, SLOT(promoteFeed(int)),
+          Qt::QueuedConnection);
+  connect(requestFeed_, SIGNAL(getUrlDone(int,int,QString,QString,QByteArray,QDateTime,QString,QString)),
+          updateObject_, SLOT(getUrlDone(int,int,QString,QString,QByteArray,QDateTime,QString,QString)));
+  connect(requestFeed_, SIGNAL(feedUrlMoved(int,QString)),
+          updateObject_, SLOT(slotFeedUrlMoved(int,QString)));
+  connect(requestFeed_, SIGNAL(setStatusFeed(int,QString)),
+          updateObject_, SLOT(queueFeedStatus(int,QString)));
+  connect(parent, SIGNAL(signalStopUpdate()),
+          requestFeed_, SLOT(stopRequest()));
+  connect(parent, SIGNAL(signalStopUpdate()),
+          updateObject_, SLOT(slotStopUpdate()));
+
+  connect(parent, SIGNAL(signalGetFeedTimer(int)),
+          updateObject_, SLOT(slotGetFeedTimer(int)));
+  connect(parent, SIGNAL(signalGetAllFeedsTimer(int)),
+          updateObject_, SLOT(slotGetAllFeedsTimer(int)));
+  connect(parent, SIGNAL(signalGetAllFeeds(int)),
+          updateObject_, SLOT(slotGetAllFeeds(int)));
+
+  connect(updateObject_, SIGNAL(feedReadyParse(FetchedFeed)),
+          parseObject_, SLOT(parseFeed(FetchedFeed)),
+          Qt::QueuedConnection);
+  connect(parseObject_, SIGNAL(signalFinishUpdate(int,bool,int,QString)),
+          updateObject_, SLOT(finishUpdate(int,bool,int,QString)),
+          Qt::QueuedConnection);
+  connect(parseObject_, SIGNAL(signalQueueFull(bool)),
+          requestFeed_, SLOT(setPaused(bool)));
+  qRegisterMetaType<QList<int> >("QList<int>");
+  qRegisterMetaType<FeedCountStruct>("FeedCountStruct");
+  qRegisterMetaType<QList<FeedCountStruct> >("QList<FeedCountStruct>");
+  qRegisterMetaType<NotificationFeedStruct>("NotificationFeedStruct");
+  qRegisterMetaType<CategoryCountStruct>("CategoryCountStruct");
+  qRegisterMetaType<QList<QByteArray> >("QList<QByteArray>");
+
+  connect(mainApp, SIGNAL(signalSqlQueryExec(QString)),
+          updateObject_, SLOT(slotSqlQueryExec(QString)));
+  connect(mainApp, SIGNAL(signalRunUserFilter(int, int)),
+          parseObject_, SLOT(runUserFilter(int, int)));
+  connect(mainApp, SIGNAL(signalReloadUserFilters()),
+          parseObject_, SLOT(reloadUserFilters()));
+  connect(parent, SIGNAL(signalStopUpdate()),
+          parseObject_, SLOT(cancelUserFilters()));
+
+  // faviconObject_
+  connect(faviconObject_, SIGNAL(signalRequestSlot(int,QString)),
+          requestFeed_, SLOT(requestIconSlot(int,QString)));
+  connect(requestFeed_, SIGNAL(iconSlotReady(int)),
+          faviconObject_, SLOT(slotIconSlot(int)));
+  connect(faviconObject_, SIGNAL(signalReleaseSlot(int)),
+          requestFeed_, SLOT(releaseIconSlot(int)));
+
+  connect(parent, SIGNAL(signalQuitApp()),
+          updateObject_, SLOT(quitApp()));
+  connect(this, SIGNAL(signalSaveMemoryDatabase()),
+          updateObject_, SLOT(saveMemoryDatabase()));
+
+  // Headless daemon has no window to show progress and counters
+  if (mainApp->isHeadless()) {
+    connect(parent, SIGNAL(signalCleanUp()),
+            updateObject_, SLOT(cleanUpShutdown()));
+  } else {
+    connectWindow(parent);
+  }
 
-  requestFeed_ = new RequestFeed(timeoutRequest, numberRequests, numberRepeats);
+  // webSubClient_, content pushed by hub is verified by HMAC of Qt 5.1
+#if QT_VERSION >= 0x050100
+  if (options->webSubEnabled) {
+    webSubClient_ = new WebSubClient(options->webSubPort, options->webSubCallbackUrl);
 
-  parseObject_ = new ParseObject();
+    connect(parseObject_, SIGNAL(signalHubFound(int,QString,QString)),
+            webSubClient_, SLOT(slotHubFound(int,QString,QString)));
+    connect(webSubClient_, SIGNAL(xmlReadyParse(QByteArray,int,QDateTime,QString,QString)),
+            parseObject_, SLOT(parseXml(QByteArray,int,QDateTime,QString,QString)));
 
-  if (addFeed_) {
-    connect(parent, SIGNAL(signalRequestUrl(int,QString,QDateTime,QString)),
-            requestFeed_, SLOT(requestUrl(int,QString,QDateTime,QString)));
-    connect(requestFeed_, SIGNAL(getUrlDone(int,int,QString,QString,QByteArray,QDateTime,QString)),
-            parent, SLOT(getUrlDone(int,int,QString,QString,QByteArray,QDateTime,QString)));
+    webSubClient_->moveToThread(updateFeedThread_);
+    QMetaObject::invokeMethod(webSubClient_, "start", Qt::QueuedConnection);
+  }
+#endif
 
-    connect(parent, SIGNAL(xmlReadyParse(QByteArray,int,QDateTime,QString)),
-            parseObject_, SLOT(parseXml(QByteArray,int,QDateTime,QString)));
-    connect(parseObject_, SIGNAL(signalFinishUpdate(int,bool,int,QString)),
-            parent, SLOT(slotUpdateFeed(int,bool,int,QString)));
-  } else {
-    getFaviconThread_ = new QThread();
-    getFaviconThread_->setObjectName("getFaviconThread_");
-
-    updateObject_ = new UpdateObject();
-    faviconObject_ = new FaviconObject();
-
-    connect(updateObject_, SIGNAL(signalRequestUrl(int,QString,QDateTime,QString)),
-            requestFeed_, SLOT(requestUrl(int,QString,QDateTime,QString)));
-    connect(requestFeed_, SIGNAL(getUrlDone(int,int,QString,QString,QByteArray,QDateTime,QString)),
-            updateObject_, SLOT(getUrlDone(int,int,QString,QString,QByteArray,QDateTime,QString)));
-    connect(requestFeed_, SIGNAL(setStatusFeed(int,QString)),
-            parent, SLOT(setStatusFeed(int,QString)));
-    connect(parent, SIGNAL(signalStopUpdate()),
-            requestFeed_, SLOT(stopRequest()));
-
-    connect(parent, SIGNAL(signalGetFeedTimer(int)),
-            updateObject_, SLOT(slotGetFeedTimer(int)));
-    connect(parent, SIGNAL(signalGetAllFeedsTimer()),
-            updateObject_, SLOT(slotGetAllFeedsTimer()));
-    connect(parent, SIGNAL(signalGetAllFeeds()),
-            updateObject_, SLOT(slotGetAllFeeds()));
-    connect(parent, SIGNAL(signalGetFeed(int,QString,QDateTime,int)),
-            updateObject_, SLOT(slotGetFeed(int,QString,QDateTime,int)));
-    connect(parent, SIGNAL(signalGetFeedsFolder(QString)),
-            updateObject_, SLOT(slotGetFeedsFolder(QString)));
-    connect(parent, SIGNAL(signalImportFeeds(QByteArray)),
+  // syncClient_
+  if (options->syncEnabled) {
+    syncClient_ = new GReaderSync(options->syncApiUrl, options->syncUser,
+                                  options->syncPassword, options->syncInterval);
+
+    connect(syncClient_, SIGNAL(signalNewsReady(ParsedFeedStruct)),
+            parseObject_, SLOT(parseSynced(ParsedFeedStruct)));
+    connect(syncClient_, SIGNAL(signalImportFeeds(QByteArray)),
             updateObject_, SLOT(slotImportFeeds(QByteArray)));
-    connect(updateObject_, SIGNAL(showProgressBar(int)),
-            parent, SLOT(showProgressBar(int)));
-    connect(updateObject_, SIGNAL(loadProgress(int)),
-            parent, SLOT(slotSetValue(int)));
-    connect(updateObject_, SIGNAL(signalMessageStatusBar(QString,int)),
-            parent, SLOT(showMessageStatusBar(QString,int)));
-    connect(updateObject_, SIGNAL(signalUpdateFeedsModel()),
-            parent, SLOT(feedsModelReload()),
-            Qt::BlockingQueuedConnection);
-
-    connect(updateObject_, SIGNAL(xmlReadyParse(QByteArray,int,QDateTime,QString)),
-            parseObject_, SLOT(parseXml(QByteArray,int,QDateTime,QString)),
-            Qt::QueuedConnection);
-    connect(parseObject_, SIGNAL(signalFinishUpdate(int,bool,int,QString)),
-            updateObject_, SLOT(finishUpdate(int,bool,int,QString)),
-            Qt::QueuedConnection);
-    connect(updateObject_, SIGNAL(feedUpdated(int,bool,int,bool)),
-            parent, SLOT(slotUpdateFeed(int,bool,int,bool)));
-    connect(updateObject_, SIGNAL(setStatusFeed(int,QString)),
-            parent, SLOT(setStatusFeed(int,QString)));
-
-    qRegisterMetaType<FeedCountStruct>("FeedCountStruct");
-    connect(parseObject_, SIGNAL(feedCountsUpdate(FeedCountStruct)),
-            parent, SLOT(slotFeedCountsUpdate(FeedCountStruct)));
-
-    connect(parseObject_, SIGNAL(signalPlaySound(QString)),
-            parent, SLOT(slotPlaySound(QString)));
-    connect(parseObject_, SIGNAL(signalAddColorList(int,QString)),
-            parent, SLOT(slotAddColorList(int,QString)));
-
-    connect(parent, SIGNAL(signalNextUpdate(bool)),
-            updateObject_, SLOT(slotNextUpdateFeed(bool)));
-    connect(updateObject_, SIGNAL(signalUpdateModel(bool)),
-            parent, SLOT(feedsModelReload(bool)));
-    connect(updateObject_, SIGNAL(signalUpdateNews(int)),
-            parent, SLOT(slotUpdateNews(int)));
-    connect(updateObject_, SIGNAL(signalCountsStatusBar(int,int)),
-            parent, SLOT(slotCountsStatusBar(int,int)));
-
-    connect(parent, SIGNAL(signalRecountCategoryCounts()),
-            updateObject_, SLOT(slotRecountCategoryCounts()));
-    qRegisterMetaType<QList<int> >("QList<int>");
-    connect(updateObject_, SIGNAL(signalRecountCategoryCounts(QList<int>,QList<int>,QList<int>,QStringList)),
-            parent, SLOT(slotRecountCategoryCounts(QList<int>,QList<int>,QList<int>,QStringList)),
-            Qt::QueuedConnection);
-    connect(parent, SIGNAL(signalRecountFeedCounts(int,bool)),
-            updateObject_, SLOT(slotRecountFeedCounts(int,bool)));
-    connect(updateObject_, SIGNAL(feedCountsUpdate(FeedCountStruct)),
-            parent, SLOT(slotFeedCountsUpdate(FeedCountStruct)));
-    connect(updateObject_, SIGNAL(signalFeedsViewportUpdate()),
-            parent, SLOT(slotFeedsViewportUpdate()));
-    connect(parent, SIGNAL(signalSetFeedRead(int,int,int,QList<int>)),
-            updateObject_, SLOT(slotSetFeedRead(int,int,int,QList<int>)),
-            Qt::DirectConnection);
-    connect(parent, SIGNAL(signalMarkFeedRead(int,bool,bool)),
-            updateObject_, SLOT(slotMarkFeedRead(int,bool,bool)));
-    connect(parent, SIGNAL(signalRefreshInfoTray()),
-            updateObject_, SLOT(slotRefreshInfoTray()));
-    connect(updateObject_, SIGNAL(signalRefreshInfoTray(int,int)),
-            parent, SLOT(slotRefreshInfoTray(int,int)));
-    connect(parent, SIGNAL(signalUpdateStatus(int,bool)),
-            updateObject_, SLOT(slotUpdateStatus(int,bool)));
-    connect(parent, SIGNAL(signalMarkAllFeedsRead()),
-            updateObject_, SLOT(slotMarkAllFeedsRead()));
-    connect(parent, SIGNAL(signalMarkReadCategory(int,int)),
-            updateObject_, SLOT(slotMarkReadCategory(int,int)));
-    connect(parent, SIGNAL(signalRefreshNewsView(int)),
-            updateObject_, SIGNAL(signalMarkAllFeedsRead(int)));
-    connect(updateObject_, SIGNAL(signalMarkAllFeedsRead(int)),
-            parent, SLOT(slotRefreshNewsView(int)));
-    connect(parent, SIGNAL(signalMarkAllFeedsOld()),
-            updateObject_, SLOT(slotMarkAllFeedsOld()));
-
-    connect(parent, SIGNAL(signalSetFeedsFilter(bool)),
-            updateObject_, SIGNAL(signalSetFeedsFilter(bool)));
-    connect(updateObject_, SIGNAL(signalSetFeedsFilter(bool)),
-            parent, SLOT(setFeedsFilter(bool)), Qt::QueuedConnection);
-
-    connect(mainApp, SIGNAL(signalSqlQueryExec(QString)),
-            updateObject_, SLOT(slotSqlQueryExec(QString)));
-    connect(mainApp, SIGNAL(signalRunUserFilter(int, int)),
-            parseObject_, SLOT(runUserFilter(int, int)));
-
-    // faviconObject_
-    connect(parent, SIGNAL(faviconRequestUrl(QString,QString)),
-            faviconObject_, SLOT(requestUrl(QString,QString)));
-    connect(faviconObject_, SIGNAL(signalIconRecived(QString,QByteArray,QString)),
-            parent, SLOT(slotIconFeedPreparing(QString,QByteArray,QString)));
-    connect(parent, SIGNAL(signalIconFeedReady(QString,QByteArray)),
-            updateObject_, SLOT(slotIconSave(QString,QByteArray)));
-    connect(updateObject_, SIGNAL(signalIconUpdate(int,QByteArray)),
-            parent, SLOT(slotIconFeedUpdate(int,QByteArray)));
-
-    connect(parent, SIGNAL(signalQuitApp()),
-            updateObject_, SLOT(quitApp()));
-    connect(this, SIGNAL(signalSaveMemoryDatabase()),
-            updateObject_, SLOT(saveMemoryDatabase()));
-
-    updateObject_->moveToThread(updateFeedThread_);
-    faviconObject_->moveToThread(getFaviconThread_);
-
-    getFaviconThread_->start(QThread::LowPriority);
-
-    startSaveTimer();
+    connect(syncClient_, SIGNAL(signalFeedStateChanged(int)),
+            updateObject_, SLOT(slotRecountFeedCounts(int)));
+    connect(syncClient_, SIGNAL(signalCategoryCountsChanged()),
+            updateObject_, SLOT(slotCategoryCountsChanged()));
+    connect(parent, SIGNAL(signalStopUpdate()),
+            syncClient_, SLOT(stop()));
+
+    syncClient_->moveToThread(updateFeedThread_);
+    QMetaObject::invokeMethod(syncClient_, "start", Qt::QueuedConnection);
+  }
+
+  // imagePrefetcher_
+  if (options->prefetchImages) {
+    imagePrefetcher_ = new ImagePrefetcher(options->prefetchRequests,
+                                           options->prefetchBandwidth);
+
+    connect(parseObject_, SIGNAL(signalPrefetchImages(QStringList)),
+            imagePrefetcher_, SLOT(prefetch(QStringList)));
+    connect(parent, SIGNAL(signalStopUpdate()),
+            imagePrefetcher_, SLOT(stop()));
+
+    imagePrefetcher_->moveToThread(getFaviconThread_);
+  }
+
+  connect(parseObject_, SIGNAL(signalDownloadEnclosure(int,QString,QString,qint64)),
+          mainApp, SLOT(downloadEnclosure(int,QString,QString,qint64)));
+
+  // articleFetcher_
+  if (options->fetchArticles) {
+    articleFetcher_ = new ArticleFetcher(options->fetchArticlesRequests);
+
+    connect(parseObject_, SIGNAL(signalFetchArticle(int,QString)),
+            articleFetcher_, SLOT(fetchArticle(int,QString)));
+    connect(articleFetcher_, SIGNAL(signalArticleReady(int,QString)),
+            parseObject_, SLOT(saveArticle(int,QString)));
+    connect(parent, SIGNAL(signalStopUpdate()),
+            articleFetcher_, SLOT(stop()));
+
+    articleFetcher_->moveToThread(getFaviconThread_);
   }
 
+  updateObject_->moveToThread(updateFeedThread_);
+  faviconObject_->moveToThread(getFaviconThread_);
+
+  getFaviconThread_->start(QThread::LowPriority);
+
+  startSaveTimer();
+
   requestFeed_->moveToThread(getFeedThread_);
   parseObject_->moveToThread(updateFeedThread_);
+  Database::setConnectionThread(parseObject_->connectionName(), updateFeedThread_);
 
   getFeedThread_->start(QThread::LowPriority);
   updateFeedThread_->start(QThread::LowPriority);
+  foreach (QThread *parseThread, parseThreads_) {
+    parseThread->start(QThread::LowPriority);
+  }
+}
+
+/** @brief Connect update objects with main window
+ *---------------------------------------------------------------------------*/
+void UpdateFeeds::connectWindow(QObject *window)
+{
+  connect(window, SIGNAL(signalNetworkSettingsChanged()),
+          requestFeed_, SLOT(applySettings()));
+  connect(window, SIGNAL(signalGetFeed(int,QString,QDateTime,int)),
+          updateObject_, SLOT(slotGetFeed(int,QString,QDateTime,int)));
+  connect(window, SIGNAL(signalGetFeedsFolder(QString)),
+          updateObject_, SLOT(slotGetFeedsFolder(QString)));
+  connect(window, SIGNAL(signalImportFeeds(QByteArray)),
+          updateObject_, SLOT(slotImportFeeds(QByteArray)));
+  connect(updateObject_, SIGNAL(showProgressBar(int)),
+          window, SLOT(showProgressBar(int)));
+  connect(updateObject_, SIGNAL(loadProgress(int)),
+          window, SLOT(slotSetValue(int)));
+  connect(updateObject_, SIGNAL(signalMessageStatusBar(QString,int)),
+          window, SLOT(showMessageStatusBar(QString,int)));
+  connect(updateObject_, SIGNAL(signalUpdateFeedsModel()),
+          window, SLOT(feedsModelReload()),
+          Qt::BlockingQueuedConnection);
+
+  connect(updateObject_, SIGNAL(feedsUpdated(QList<int>,QList<int>,bool)),
+          window, SLOT(slotFeedsUpdated(QList<int>,QList<int>,bool)));
+  connect(updateObject_, SIGNAL(setStatusFeeds(QList<int>,QStringList)),
+          window, SLOT(setStatusFeeds(QList<int>,QStringList)));
+
+  connect(parseObject_, SIGNAL(feedCountsUpdate(FeedCountStruct)),
+          window, SLOT(slotFeedCountsUpdate(FeedCountStruct)));
+  connect(parseObject_, SIGNAL(feedsCountsUpdate(QList<FeedCountStruct>)),
+          window, SLOT(slotFeedsCountsUpdate(QList<FeedCountStruct>)));
+
+  connect(parseObject_, SIGNAL(signalPlaySound(QString)),
+          window, SLOT(slotPlaySound(QString)));
+  connect(parseObject_, SIGNAL(signalAddColorList(int,QString)),
+          window, SLOT(slotAddColorList(int,QString)));
+  connect(parseObject_, SIGNAL(signalNotificationData(NotificationFeedStruct)),
+          window, SLOT(slotNotificationData(NotificationFeedStruct)));
+
+  connect(window, SIGNAL(signalNextUpdate(bool)),
+          updateObject_, SLOT(slotNextUpdateFeed(bool)));
+  connect(updateObject_, SIGNAL(signalUpdateModel(bool)),
+          window, SLOT(feedsModelReload(bool)));
+  connect(updateObject_, SIGNAL(signalUpdateNews(int)),
+          window, SLOT(slotUpdateNews(int)));
+  connect(updateObject_, SIGNAL(signalCountsStatusBar(int,int)),
+          window, SLOT(slotCountsStatusBar(int,int)));
+
+  connect(window, SIGNAL(signalRecountCategoryCounts()),
+          updateObject_, SLOT(slotRecountCategoryCounts()));
+  connect(updateObject_, SIGNAL(signalRecountCategoryCounts(CategoryCountStruct)),
+          window, SLOT(slotRecountCategoryCounts(CategoryCountStruct)),
+          Qt::QueuedConnection);
+  connect(window, SIGNAL(signalRecountFeedCounts(int,bool)),
+          updateObject_, SLOT(slotRecountFeedCounts(int,bool)));
+  connect(updateObject_, SIGNAL(feedCountsUpdate(FeedCountStruct)),
+          window, SLOT(slotFeedCountsUpdate(FeedCountStruct)));
+  connect(updateObject_, SIGNAL(feedsCountsUpdate(QList<FeedCountStruct>)),
+          window, SLOT(slotFeedsCountsUpdate(QList<FeedCountStruct>)));
+  connect(updateObject_, SIGNAL(signalFeedsViewportUpdate()),
+          window, SLOT(slotFeedsViewportUpdate()));
+  connect(window, SIGNAL(signalSetFeedRead(int,int,int,QList<int>)),
+          updateObject_, SLOT(slotSetFeedRead(int,int,int,QList<int>)),
+          Qt::DirectConnection);
+  connect(window, SIGNAL(signalMarkFeedRead(int,bool,bool)),
+          updateObject_, SLOT(slotMarkFeedRead(int,bool,bool)));
+  connect(window, SIGNAL(signalRefreshInfoTray()),
+          updateObject_, SLOT(slotRefreshInfoTray()));
+  connect(updateObject_, SIGNAL(signalRefreshInfoTray(int,int)),
+          window, SLOT(slotRefreshInfoTray(int,int)));
+  connect(window, SIGNAL(signalUpdateStatus(int,bool)),
+          updateObject_, SLOT(slotUpdateStatus(int,bool)));
+  connect(window, SIGNAL(signalMarkAllFeedsRead()),
+          updateObject_, SLOT(slotMarkAllFeedsRead()));
+  connect(window, SIGNAL(signalMarkReadCategory(int,int)),
+          updateObject_, SLOT(slotMarkReadCategory(int,int)));
+  connect(window, SIGNAL(signalRefreshNewsView(int)),
+          updateObject_, SIGNAL(signalMarkAllFeedsRead(int)));
+  connect(updateObject_, SIGNAL(signalMarkAllFeedsRead(int)),
+          window, SLOT(slotRefreshNewsView(int)));
+  connect(window, SIGNAL(signalMarkAllFeedsOld()),
+          updateObject_, SLOT(slotMarkAllFeedsOld()));
+
+  connect(window, SIGNAL(signalSetFeedsFilter(bool)),
+          updateObject_, SIGNAL(signalSetFeedsFilter(bool)));
+  connect(updateObject_, SIGNAL(signalSetFeedsFilter(bool)),
+          window, SLOT(setFeedsFilter(bool)), Qt::QueuedConnection);
+
+  connect(parseObject_, SIGNAL(signalUserFilterProgress(int,int)),
+          window, SLOT(slotUserFilterProgress(int,int)));
+  connect(parseObject_, SIGNAL(signalUserFilterFinished(int)),
+          window, SLOT(slotUserFilterFinished(int)));
+
+  connect(window, SIGNAL(faviconRequestUrl(QString,QString)),
+          faviconObject_, SLOT(requestUrl(QString,QString)));
+  // Icons are decoded and scaled by faviconObject_, window only shows them
+  connect(faviconObject_, SIGNAL(signalIconReady(QString,QByteArray)),
+          updateObject_, SLOT(slotIconSave(QString,QByteArray)));
+  connect(faviconObject_, SIGNAL(signalIconReady(QString,QByteArray)),
+          window, SIGNAL(signalIconFeedReady(QString,QByteArray)));
+  connect(updateObject_, SIGNAL(signalIconsUpdate(QList<int>,QList<QByteArray>)),
+          window, SLOT(slotIconsFeedUpdate(QList<int>,QList<QByteArray>)));
 }
 
 UpdateFeeds::~UpdateFeeds()
 {
   requestFeed_->deleteLater();
   parseObject_->deleteLater();
-
-  if (!addFeed_) {
-    updateObject_->deleteLater();
-    faviconObject_->deleteLater();
-
-    getFaviconThread_->exit();
-    getFaviconThread_->wait();
-    delete getFaviconThread_;
-  }
+  updateObject_->deleteLater();
+  faviconObject_->deleteLater();
+  if (webSubClient_)
+    webSubClient_->deleteLater();
+  if (syncClient_)
+    syncClient_->deleteLater();
+  if (imagePrefetcher_)
+    imagePrefetcher_->deleteLater();
+  if (articleFetcher_)
+    articleFetcher_->deleteLater();
+
+  getFaviconThread_->exit();
+  getFaviconThread_->wait();
+  delete getFaviconThread_;
 
   getFeedThread_->exit();
   getFeedThread_->wait();
@@ -224,17 +440,32 @@ UpdateFeeds::~UpdateFeeds()
   updateFeedThread_->exit();
   updateFeedThread_->wait();
   delete updateFeedThread_;
+
+  foreach (ParseWorker *parseWorker, parseWorkers_) {
+    parseWorker->deleteLater();
+  }
+  foreach (QThread *parseThread, parseThreads_) {
+    parseThread->exit();
+    parseThread->wait();
+    delete parseThread;
+  }
 }
 
 void UpdateFeeds::disconnectObjects()
 {
-  if (!addFeed_) {
-    updateObject_->disconnect(updateObject_);
-    updateObject_->disconnect(parseObject_);
-    updateObject_->disconnect(requestFeed_);
-    updateObject_->disconnect(parent());
-    faviconObject_->disconnectObjects();
-  }
+  updateObject_->disconnect(updateObject_);
+  updateObject_->disconnect(parseObject_);
+  updateObject_->disconnect(requestFeed_);
+  updateObject_->disconnect(parent());
+  faviconObject_->disconnectObjects();
+  if (webSubClient_)
+    webSubClient_->disconnectObjects();
+  if (syncClient_)
+    syncClient_->disconnectObjects();
+  if (imagePrefetcher_)
+    imagePrefetcher_->disconnectObjects();
+  if (articleFetcher_)
+    articleFetcher_->disconnectObjects();
 
   requestFeed_->disconnectObjects();
   requestFeed_->disconnect(parent());
@@ -250,8 +481,7 @@ void UpdateFeeds::startSaveTimer()
     connect(saveMemoryDBTimer_, SIGNAL(timeout()), this, SLOT(saveMemoryDatabase()));
   }
 
-  Settings settings;
-  int saveInterval = settings.value("Settings/saveDBMemFileInterval", 30).toInt();
+  int saveInterval = Settings::snapshot()->saveDBMemFileInterval;
   saveMemoryDBTimer_->start(saveInterval*60*1000);
 }
 
@@ -263,17 +493,59 @@ void UpdateFeeds::saveMemoryDatabase()
   emit signalSaveMemoryDatabase();
 }
 
+/** @brief Free buffers of update objects kept between feeds
+ *----------------------------------------------------------------------------*/
+void UpdateFeeds::releaseMemory()
+{
+  foreach (ParseWorker *parseWorker, parseWorkers_) {
+    QMetaObject::invokeMethod(parseWorker, "releaseMemory", Qt::QueuedConnection);
+  }
+  Database::releaseMemory();
+}
+
 //------------------------------------------------------------------------------
 UpdateObject::UpdateObject(QObject *parent)
   : QObject(parent)
   , isSaveMemoryDatabase(false)
+  , cycleCost_(0)
+  , checkTime_(0)
+  , requestBatchOpen_(false)
+  , pendingProgress_(-1)
+  , pendingFeedsDone_(false)
+  , pendingFinish_(false)
   , updateFeedsCount_(0)
+  , categoryCountsSent_(false)
+  , trayNewCount_(-1)
+  , trayUnreadCount_(-1)
 {
   setObjectName("updateObject_");
 
   mainWindow_ = mainApp->mainWindow();
 
   db_ = Database::connection("secondConnection");
+  queries_.setDatabase(db_);
+
+  QSharedPointer<const SettingsSnapshot> options = Settings::snapshot();
+  adaptiveUpdate_ = options->adaptiveUpdate;
+  staggeredUpdate_ = options->staggeredUpdate;
+  webSubEnabled_ = options->webSubEnabled;
+  costBudget_ = qint64(qMax(0, options->updateCostBudget)) * 1000;
+
+  QSqlQuery q(db_);
+  q.exec("SELECT feedId, value FROM feeds_ex WHERE name='fetchFailures'");
+  while (q.next())
+    feedFailures_.insert(q.value(0).toInt(), q.value(1).toInt());
+
+  q.exec("SELECT feedId FROM feeds_ex WHERE name='costDemotionDisabled'");
+  while (q.next())
+    costExemptFeeds_.insert(q.value(0).toInt());
+  if (costBudget_ > 0) {
+    q.exec("SELECT feedId FROM feeds_ex WHERE name='costDemoted'");
+    while (q.next())
+      demotedFeeds_.insert(q.value(0).toInt());
+  } else {
+    q.exec("DELETE FROM feeds_ex WHERE name='costDemoted'");
+  }
 
   updateModelTimer_ = new QTimer(this);
   updateModelTimer_->setSingleShot(true);
@@ -283,6 +555,54 @@ UpdateObject::UpdateObject(QObject *parent)
   timerUpdateNews_->setSingleShot(true);
   connect(timerUpdateNews_, SIGNAL(timeout()), this, SIGNAL(signalUpdateNews()));
 
+  staggerClock_.start();
+  staggerTimer_ = new QTimer(this);
+  staggerTimer_->setSingleShot(true);
+  connect(staggerTimer_, SIGNAL(timeout()), this, SLOT(slotStaggerTimeout()));
+
+  importTimer_ = new QTimer(this);
+  importTimer_->setSingleShot(true);
+  connect(importTimer_, SIGNAL(timeout()), this, SLOT(slotImportTimeout()));
+
+  progressTimer_ = new QTimer(this);
+  progressTimer_->setSingleShot(true);
+  progressTimer_->setInterval(PROGRESS_INTERVAL);
+  connect(progressTimer_, SIGNAL(timeout()), this, SLOT(flushProgress()));
+
+  newsStateTimer_ = new QTimer(this);
+  newsStateTimer_->setSingleShot(true);
+  connect(newsStateTimer_, SIGNAL(timeout()), this, SLOT(flushNewsState()));
+
+  iconSaveTimer_ = new QTimer(this);
+  iconSaveTimer_->setSingleShot(true);
+  connect(iconSaveTimer_, SIGNAL(timeout()), this, SLOT(saveIcons()));
+
+  unchangedSaveTimer_ = new QTimer(this);
+  unchangedSaveTimer_->setSingleShot(true);
+  connect(unchangedSaveTimer_, SIGNAL(timeout()), this, SLOT(saveUnchangedFeeds()));
+
+  vacuumTimer_ = new QTimer(this);
+  vacuumTimer_->setSingleShot(true);
+  connect(vacuumTimer_, SIGNAL(timeout()), this, SLOT(slotIdleVacuum()));
+  if (!mainApp->storeDBMemory() && Settings::snapshot()->incrementalVacuum)
+    vacuumTimer_->start(VACUUM_IDLE_INTERVAL);
+
+  archiveTimer_ = new QTimer(this);
+  archiveTimer_->setSingleShot(true);
+  connect(archiveTimer_, SIGNAL(timeout()), this, SLOT(slotIdleArchive()));
+  if (Database::archiveAttached())
+    archiveTimer_->start(ARCHIVE_IDLE_INTERVAL);
+
+  cleanUpTimer_ = new QTimer(this);
+  cleanUpTimer_->setSingleShot(true);
+  connect(cleanUpTimer_, SIGNAL(timeout()), this, SLOT(slotIdleCleanUp()));
+  if (options->cleanUpPending)
+    cleanUpTimer_->start(CLEANUP_IDLE_DELAY);
+
+  maintenanceTimer_ = new QTimer(this);
+  maintenanceTimer_->setSingleShot(true);
+  connect(maintenanceTimer_, SIGNAL(timeout()), this, SLOT(slotIdleMaintenance()));
+  maintenanceTimer_->start(MAINTENANCE_IDLE_INTERVAL);
 }
 
 UpdateObject::~UpdateObject()
@@ -293,33 +613,219 @@ UpdateObject::~UpdateObject()
 void UpdateObject::slotGetFeedTimer(int feedId)
 {
   QSqlQuery q(db_);
-  q.exec(QString("SELECT xmlUrl, lastBuildDate, authentication FROM feeds WHERE id=='%1' AND disableUpdate=0")
-         .arg(feedId));
+  q.prepare("SELECT xmlUrl, lastBuildDate, authentication, etag, "
+            "updated, ttl, skipHours, skipDays FROM feeds WHERE id==? AND disableUpdate=0 "
+            "AND id NOT IN (SELECT feedId FROM feeds_ex "
+            "WHERE name='fetchRetryAfter' AND value>?)");
+  q.addBindValue(feedId);
+  q.addBindValue(QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+  q.exec();
   if (q.next()) {
-    addFeedInQueue(feedId, q.value(0).toString(),
-                   q.value(1).toDateTime(), q.value(2).toInt());
+    if (isFeedDue(feedId, q.value(4).toString(), q.value(5).toInt(),
+                  q.value(6).toString(), q.value(7).toString(), false)) {
+      addFeedInQueue(feedId, q.value(0).toString(),
+                     q.value(1).toDateTime(), q.value(2).toInt(),
+                     q.value(3).toString());
+    }
   }
   emit showProgressBar(updateFeedsCount_);
 }
 
-void UpdateObject::slotGetAllFeedsTimer()
+/** @brief Update all feeds by timer
+ *
+ * In staggered mode feeds are spread evenly with jitter over half of
+ * update \a interval instead of being requested all at once. Feeds demoted
+ * by update cost budget are updated only on every few of timer updates.
+ *----------------------------------------------------------------------------*/
+void UpdateObject::slotGetAllFeedsTimer(int interval)
 {
+  QList<StaggeredFeed> feeds;
+  QString qStr("SELECT id, xmlUrl, lastBuildDate, authentication, etag, "
+               "updated, ttl, skipHours, skipDays FROM feeds "
+               "WHERE xmlUrl!='' AND disableUpdate=0 "
+               "AND (updateIntervalEnable==-1 OR updateIntervalEnable IS NULL) "
+               // Failing feeds wait for end of their back-off
+               "AND id NOT IN (SELECT feedId FROM feeds_ex "
+               "WHERE name='fetchRetryAfter' AND value>?)");
+  // Feeds with valid WebSub subscription are pushed by hub
+  if (webSubEnabled_) {
+    qStr.append(" AND id NOT IN (SELECT feedId FROM feeds_ex "
+                "WHERE name='websubLease' AND value>?)");
+  }
+  QString currentTime = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
   QSqlQuery q(db_);
-  q.exec("SELECT id, xmlUrl, lastBuildDate, authentication FROM feeds "
-         "WHERE xmlUrl!='' AND disableUpdate=0 "
-         "AND (updateIntervalEnable==-1 OR updateIntervalEnable IS NULL)");
+  q.prepare(qStr);
+  q.addBindValue(currentTime);
+  if (webSubEnabled_)
+    q.addBindValue(currentTime);
+  q.exec();
   while (q.next()) {
-    addFeedInQueue(q.value(0).toInt(), q.value(1).toString(),
-                   q.value(2).toDateTime(), q.value(3).toInt());
+    if (staggerIds_.contains(q.value(0).toInt()))
+      continue;
+    if (!isFeedDue(q.value(0).toInt(), q.value(5).toString(), q.value(6).toInt(),
+                   q.value(7).toString(), q.value(8).toString(), true))
+      continue;
+    if ((interval > 0) && demotedFeeds_.contains(q.value(0).toInt())) {
+      QDateTime updatedTime = QDateTime::fromString(q.value(5).toString(), Qt::ISODate);
+      updatedTime.setTimeSpec(Qt::UTC);
+      if (updatedTime.isValid() &&
+          (updatedTime.secsTo(QDateTime::currentDateTimeUtc()) <
+           qint64(interval) * FEED_DEMOTION_FACTOR - interval / 2))
+        continue;
+    }
+    StaggeredFeed feed;
+    feed.id = q.value(0).toInt();
+    feed.url = q.value(1).toString();
+    feed.date = q.value(2).toDateTime();
+    feed.auth = q.value(3).toInt();
+    feed.etag = q.value(4).toString();
+    feeds.append(feed);
   }
-  emit showProgressBar(updateFeedsCount_);
+
+  if (!staggeredUpdate_ || (interval <= 0) || (feeds.count() <= 1)) {
+    beginRequestBatch();
+    foreach (const StaggeredFeed &feed, feeds) {
+      addFeedInQueue(feed.id, feed.url, feed.date, feed.auth, feed.etag,
+                     demotedFeeds_.contains(feed.id) ? RequestFeed::PriorityDemoted
+                                                     : RequestFeed::PriorityScheduled);
+    }
+    flushRequestBatch();
+    emit showProgressBar(updateFeedsCount_);
+    return;
+  }
+
+  qint64 window = qint64(qMin(interval / 2, STAGGER_WINDOW_MAX)) * 1000;
+  qint64 step = window / feeds.count();
+  qint64 start = staggerClock_.elapsed();
+  for (int i = 0; i < feeds.count(); ++i) {
+    qint64 due = start + i * step;
+    if (step > 1)
+      due += qrand() % step;
+    staggerQueue_.insert(due, feeds.at(i));
+    staggerIds_.insert(feeds.at(i).id);
+  }
+  slotStaggerTimeout();
+}
+
+/** @brief Drop staggered feeds which are not requested yet
+ *----------------------------------------------------------------------------*/
+void UpdateObject::slotStopUpdate()
+{
+  staggerTimer_->stop();
+  staggerQueue_.clear();
+  staggerIds_.clear();
+
+  // Imported feeds are already counted in updateFeedsCount_
+  importTimer_->stop();
+  while (!importQueue_.isEmpty()) {
+    StaggeredFeed feed = importQueue_.takeFirst();
+    if (updateFeedsCount_ > 0)
+      updateFeedsCount_--;
+    finishUpdate(feed.id, false, 0, "0");
+  }
+}
+
+/** @brief Request staggered feeds which due time has come
+ *----------------------------------------------------------------------------*/
+void UpdateObject::slotStaggerTimeout()
+{
+  qint64 now = staggerClock_.elapsed();
+  bool added = false;
+  while (!staggerQueue_.isEmpty() && (staggerQueue_.begin().key() <= now)) {
+    QMultiMap<qint64, StaggeredFeed>::iterator it = staggerQueue_.begin();
+    StaggeredFeed feed = it.value();
+    staggerQueue_.erase(it);
+    staggerIds_.remove(feed.id);
+    addFeedInQueue(feed.id, feed.url, feed.date, feed.auth, feed.etag,
+                   demotedFeeds_.contains(feed.id) ? RequestFeed::PriorityDemoted
+                                                   : RequestFeed::PriorityScheduled);
+    added = true;
+  }
+  if (added)
+    emit showProgressBar(updateFeedsCount_);
+
+  if (!staggerQueue_.isEmpty())
+    staggerTimer_->start(int(staggerQueue_.begin().key() - now));
+}
+
+/** @brief Check if feed should be updated by timer
+ *
+ * Feed is skipped while its ttl is not expired and in hours and days listed
+ * in skipHours and skipDays. With adaptive update feed is also skipped until
+ * half of its average publish interval has passed since last update.
+ *----------------------------------------------------------------------------*/
+bool UpdateObject::isFeedDue(int feedId, const QString &updated, int ttl,
+                             const QString &skipHours, const QString &skipDays,
+                             bool adaptive)
+{
+  QDateTime currentTime = QDateTime::currentDateTimeUtc();
+  QDateTime updatedTime = QDateTime::fromString(updated, Qt::ISODate);
+  updatedTime.setTimeSpec(Qt::UTC);
+
+  if (!skipHours.isEmpty()) {
+    int hour = currentTime.time().hour();
+    foreach (const QString &skipHour, skipHours.split(",", QString::SkipEmptyParts)) {
+      bool ok;
+      if ((skipHour.trimmed().toInt(&ok) == hour) && ok)
+        return false;
+    }
+  }
+  if (!skipDays.isEmpty() &&
+      skipDays.split(",").contains(QLocale::c().dayName(currentTime.date().dayOfWeek()),
+                                   Qt::CaseInsensitive))
+    return false;
+
+  if (!updatedTime.isValid())
+    return true;
+  qint64 sinceUpdate = updatedTime.secsTo(currentTime);
+
+  if ((ttl > 0) && (sinceUpdate < ttl * 60))
+    return false;
+
+  if (adaptive && adaptiveUpdate_) {
+    if (!publishInterval_.contains(feedId)) {
+      int interval = 0;
+      QSqlQuery q = queries_.query("SELECT published FROM news WHERE feedId=? "
+                                   "ORDER BY published DESC LIMIT ?");
+      q.addBindValue(feedId);
+      q.addBindValue(ADAPTIVE_NEWS_COUNT);
+      q.exec();
+      QDateTime firstTime;
+      QDateTime lastTime;
+      int count = 0;
+      while (q.next()) {
+        QDateTime published = QDateTime::fromString(q.value(0).toString(), Qt::ISODate);
+        if (!published.isValid()) continue;
+        if (!count) firstTime = published;
+        lastTime = published;
+        count++;
+      }
+      if (count > 1)
+        interval = int(lastTime.secsTo(firstTime) / (count - 1));
+      publishInterval_.insert(feedId, interval);
+    }
+
+    int interval = qMin(publishInterval_.value(feedId) / 2, ADAPTIVE_INTERVAL_MAX);
+    if (sinceUpdate < interval)
+      return false;
+  }
+
+  return true;
 }
 
 /** @brief Process update feed action
  *---------------------------------------------------------------------------*/
 void UpdateObject::slotGetFeed(int feedId, QString feedUrl, QDateTime date, int auth)
 {
-  addFeedInQueue(feedId, feedUrl, date, auth);
+  QString etag;
+  QSqlQuery q(db_);
+  q.prepare("SELECT etag FROM feeds WHERE id=?");
+  q.addBindValue(feedId);
+  q.exec();
+  if (q.next())
+    etag = q.value(0).toString();
+
+  addFeedInQueue(feedId, feedUrl, date, auth, etag, RequestFeed::PriorityInteractive);
 
   emit showProgressBar(updateFeedsCount_);
 }
@@ -330,24 +836,29 @@ void UpdateObject::slotGetFeedsFolder(QString query)
 {
   QSqlQuery q(db_);
   q.exec(query);
+  beginRequestBatch();
   while (q.next()) {
     addFeedInQueue(q.value(0).toInt(), q.value(1).toString(),
                    q.value(2).toDateTime(), q.value(3).toInt());
   }
+  flushRequestBatch();
 
   emit showProgressBar(updateFeedsCount_);
 }
 
 /** @brief Process update all feeds action
  *---------------------------------------------------------------------------*/
-void UpdateObject::slotGetAllFeeds()
+void UpdateObject::slotGetAllFeeds(int priority)
 {
   QSqlQuery q(db_);
-  q.exec("SELECT id, xmlUrl, lastBuildDate, authentication FROM feeds WHERE xmlUrl!='' AND disableUpdate=0");
+  q.exec("SELECT id, xmlUrl, lastBuildDate, authentication, etag FROM feeds WHERE xmlUrl!='' AND disableUpdate=0");
+  beginRequestBatch();
   while (q.next()) {
     addFeedInQueue(q.value(0).toInt(), q.value(1).toString(),
-                   q.value(2).toDateTime(), q.value(3).toInt());
+                   q.value(2).toDateTime(), q.value(3).toInt(),
+                   q.value(4).toString(), priority);
   }
+  flushRequestBatch();
   emit showProgressBar(updateFeedsCount_);
 }
 
@@ -361,8 +872,6 @@ void UpdateObject::slotImportFeeds(QByteArray xmlData)
   int elementCount = 0;
   int outlineCount = 0;
   QSqlQuery q(db_);
-  QList<int> idsList;
-  QList<QString> urlsList;
   QXmlStreamReader xml;
   QString convertData;
   bool codecOk = false;
@@ -401,6 +910,26 @@ void UpdateObject::slotImportFeeds(QByteArray xmlData)
 
   db_.transaction();
 
+  // Existing feeds and children counts are read once instead of per outline
+  QSet<QString> xmlUrls;
+  q.exec("SELECT xmlUrl FROM feeds WHERE xmlUrl != ''");
+  while (q.next()) {
+    xmlUrls.insert(q.value(0).toString().toLower());
+  }
+  QHash<int, int> childCount;
+  q.exec("SELECT parentId, count(id) FROM feeds GROUP BY parentId");
+  while (q.next()) {
+    childCount.insert(q.value(0).toInt(), q.value(1).toInt());
+  }
+
+  QSqlQuery qFolder(db_);
+  qFolder.prepare("INSERT INTO feeds(text, title, xmlUrl, created, f_Expanded, parentId, rowToParent) "
+                  "VALUES (:text, :title, '', :feedCreateTime, 0, :parentId, :rowToParent)");
+  QSqlQuery qFeed(db_);
+  qFeed.prepare("INSERT INTO feeds(text, title, description, xmlUrl, htmlUrl, created, parentId, rowToParent) "
+                "VALUES(:text, :title, :description, :xmlUrl, :htmlUrl, :feedCreateTime, :parentId, :rowToParent)");
+  QString createTime = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+
   // Store hierarchy of "outline" tags. Next nested outline is pushed to stack.
   // When it closes, pop it out from stack. Top of stack is the root outline.
   QStack<int> parentIdsStack;
@@ -410,32 +939,26 @@ void UpdateObject::slotImportFeeds(QByteArray xmlData)
     if (xml.isStartElement()) {
       // Search for "outline" only
       if (xml.name() == "outline") {
-        qDebug() << outlineCount << "+:" << xml.prefix().toString()
-                 << ":" << xml.name().toString();
+        LOG_DEBUG(LogFile::Update) << outlineCount << "+:" << xml.prefix().toString()
+                                   << ":" << xml.name().toString();
 
         QString textString(xml.attributes().value("text").toString());
         QString titleString(xml.attributes().value("title").toString());
         QString xmlUrlString(xml.attributes().value("xmlUrl").toString());
         if (textString.isEmpty()) textString = titleString;
 
+        int parentId = parentIdsStack.top();
+
         //Folder finded
         if (xmlUrlString.isEmpty()) {
-          int rowToParent = 0;
-          q.exec(QString("SELECT count(id) FROM feeds WHERE parentId='%1'").
-                 arg(parentIdsStack.top()));
-          if (q.next()) rowToParent = q.value(0).toInt();
-
-          q.prepare("INSERT INTO feeds(text, title, xmlUrl, created, f_Expanded, parentId, rowToParent) "
-                    "VALUES (:text, :title, :xmlUrl, :feedCreateTime, 0, :parentId, :rowToParent)");
-          q.bindValue(":text", textString);
-          q.bindValue(":title", textString);
-          q.bindValue(":xmlUrl", "");
-          q.bindValue(":feedCreateTime",
-                      QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
-          q.bindValue(":parentId", parentIdsStack.top());
-          q.bindValue(":rowToParent", rowToParent);
-          q.exec();
-          parentIdsStack.push(q.lastInsertId().toInt());
+          qFolder.bindValue(":text", textString);
+          qFolder.bindValue(":title", textString);
+          qFolder.bindValue(":feedCreateTime", createTime);
+          qFolder.bindValue(":parentId", parentId);
+          qFolder.bindValue(":rowToParent", childCount.value(parentId));
+          qFolder.exec();
+          childCount[parentId]++;
+          parentIdsStack.push(qFolder.lastInsertId().toInt());
         }
         // Feed finded
         else {
@@ -448,37 +971,30 @@ void UpdateObject::slotImportFeeds(QByteArray xmlData)
             }
           }
 
-          bool isFeedDuplicated = false;
-          q.prepare("SELECT id FROM feeds WHERE xmlUrl LIKE :xmlUrl");
-          q.bindValue(":xmlUrl", xmlUrlString);
-          q.exec();
-          if (q.next())
-            isFeedDuplicated = true;
-
-          if (isFeedDuplicated) {
-            qDebug() << "duplicate feed:" << xmlUrlString << textString;
+          int feedId = 0;
+          if (xmlUrls.contains(xmlUrlString.toLower())) {
+            LOG_DEBUG(LogFile::Update) << "duplicate feed:" << xmlUrlString << textString;
           } else {
-            int rowToParent = 0;
-            q.exec(QString("SELECT count(id) FROM feeds WHERE parentId='%1'").
-                   arg(parentIdsStack.top()));
-            if (q.next()) rowToParent = q.value(0).toInt();
-
-            q.prepare("INSERT INTO feeds(text, title, description, xmlUrl, htmlUrl, created, parentId, rowToParent) "
-                      "VALUES(?, ?, ?, ?, ?, ?, ?, ?)");
-            q.addBindValue(textString);
-            q.addBindValue(xml.attributes().value("title").toString());
-            q.addBindValue(xml.attributes().value("description").toString());
-            q.addBindValue(xmlUrlString);
-            q.addBindValue(xml.attributes().value("htmlUrl").toString());
-            q.addBindValue(QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
-            q.addBindValue(parentIdsStack.top());
-            q.addBindValue(rowToParent);
-            q.exec();
-
-            idsList.append(q.lastInsertId().toInt());
-            urlsList.append(xmlUrlString);
+            qFeed.bindValue(":text", textString);
+            qFeed.bindValue(":title", titleString);
+            qFeed.bindValue(":description", xml.attributes().value("description").toString());
+            qFeed.bindValue(":xmlUrl", xmlUrlString);
+            qFeed.bindValue(":htmlUrl", xml.attributes().value("htmlUrl").toString());
+            qFeed.bindValue(":feedCreateTime", createTime);
+            qFeed.bindValue(":parentId", parentId);
+            qFeed.bindValue(":rowToParent", childCount.value(parentId));
+            qFeed.exec();
+            childCount[parentId]++;
+            xmlUrls.insert(xmlUrlString.toLower());
+
+            feedId = qFeed.lastInsertId().toInt();
+            StaggeredFeed feed;
+            feed.id = feedId;
+            feed.url = xmlUrlString;
+            feed.auth = 0;
+            importQueue_.append(feed);
           }
-          parentIdsStack.push(q.lastInsertId().toInt());
+          parentIdsStack.push(feedId);
         }
       }
     } else if (xml.isEndElement()) {
@@ -488,7 +1004,7 @@ void UpdateObject::slotImportFeeds(QByteArray xmlData)
       }
       ++elementCount;
     }
-    qDebug() << parentIdsStack;
+    LOG_DEBUG(LogFile::Update) << parentIdsStack;
   }
   if (xml.error()) {
     QString error = QString("Import error: Line = %1, Column = %2; Error = %3").
@@ -503,22 +1019,57 @@ void UpdateObject::slotImportFeeds(QByteArray xmlData)
 
   emit signalUpdateFeedsModel();
 
-  for (int i = 0; i < idsList.count(); i++) {
-    updateFeedsCount_ = updateFeedsCount_ + 2;
-    emit signalRequestUrl(idsList.at(i), urlsList.at(i), QDateTime(), "");
-  }
+  // Imported feeds are counted at once so update is not finished between
+  // batches, but requested few at a time by slotImportTimeout
+  updateFeedsCount_ = updateFeedsCount_ + 2 * importQueue_.count();
   emit showProgressBar(updateFeedsCount_);
+  if (!importQueue_.isEmpty() && !importTimer_->isActive())
+    importTimer_->start(0);
 }
 
-// ----------------------------------------------------------------------------
+/** @brief Request next batch of imported feeds
+ *
+ * Favicons are requested by main window when imported feed is updated,
+ * so they are spread out the same way.
+ *---------------------------------------------------------------------------*/
+void UpdateObject::slotImportTimeout()
+{
+  for (int i = 0; (i < IMPORT_FETCH_BATCH) && !importQueue_.isEmpty(); ++i) {
+    StaggeredFeed feed = importQueue_.takeFirst();
+    if (feedIdList_.contains(feed.id)) {
+      updateFeedsCount_ = updateFeedsCount_ - 2;
+      continue;
+    }
+    feedIdList_.insert(feed.id);
+    feedPriority_.insert(feed.id, RequestFeed::PriorityImport);
+    EventTrace::begin(EventTrace::FeedUpdate, feed.id);
+    emit signalRequestUrl(feed.id, feed.url, QDateTime(), "", "",
+                          RequestFeed::PriorityImport);
+  }
+
+  if (!importQueue_.isEmpty())
+    importTimer_->start(IMPORT_FETCH_INTERVAL);
+}
+
+/** @brief Put feed in update queue with update class \a priority
+ *
+ * Feed already waiting in background update is moved ahead when user
+ * updates it.
+ *---------------------------------------------------------------------------*/
 bool UpdateObject::addFeedInQueue(int feedId, const QString &feedUrl,
-                                  const QDateTime &date, int auth)
+                                  const QDateTime &date, int auth,
+                                  const QString &etag, int priority)
 {
-  int feedIdIndex = feedIdList_.indexOf(feedId);
-  if (feedIdIndex > -1) {
+  if (feedIdList_.contains(feedId)) {
+    if ((priority == RequestFeed::PriorityInteractive) &&
+        (feedPriority_.value(feedId) != RequestFeed::PriorityInteractive)) {
+      feedPriority_.insert(feedId, priority);
+      emit signalPromoteFeed(feedId);
+    }
     return false;
   } else {
-    feedIdList_.append(feedId);
+    feedIdList_.insert(feedId);
+    feedPriority_.insert(feedId, priority);
     updateFeedsCount_ = updateFeedsCount_ + 2;
     QString userInfo;
     if (auth == 1) {
@@ -532,26 +1083,74 @@ bool UpdateObject::addFeedInQueue(int feedId, const QString &feedUrl,
             arg(QString::fromUtf8(QByteArray::fromBase64(q.value(1).toByteArray())));
       }
     }
-    emit signalRequestUrl(feedId, feedUrl, date, userInfo);
+    EventTrace::begin(EventTrace::FeedUpdate, feedId);
+    if (requestBatchOpen_) {
+      FeedRequest request;
+      request.id = feedId;
+      request.url = feedUrl;
+      request.date = date;
+      request.userInfo = userInfo;
+      request.etag = etag;
+      request.priority = priority;
+      requestBatch_.append(request);
+    } else {
+      emit signalRequestUrl(feedId, feedUrl, date, userInfo, etag, priority);
+    }
     return true;
   }
 }
 
+/** @brief Collect feeds put in queue into one request to scheduler
+ *---------------------------------------------------------------------------*/
+void UpdateObject::beginRequestBatch()
+{
+  requestBatchOpen_ = true;
+}
+
+void UpdateObject::flushRequestBatch()
+{
+  requestBatchOpen_ = false;
+  if (requestBatch_.isEmpty()) return;
+
+  emit signalRequestUrls(requestBatch_);
+  requestBatch_.clear();
+}
+
 /** @brief Process network request completion
  *---------------------------------------------------------------------------*/
 void UpdateObject::getUrlDone(int result, int feedId, QString feedUrlStr,
                               QString error, QByteArray data, QDateTime dtReply,
-                              QString codecName)
+                              QString codecName, QString etag)
 {
-  qDebug() << "getUrl result = " << result << "error: " << error << "url: " << feedUrlStr;
+  LOG_DEBUG(LogFile::Update) << "getUrl result = " << result << "error: " << error << "url: " << feedUrlStr;
+  PipelineMetrics::recordRequest(feedId, result, error);
+  EventTrace::instant(EventTrace::Result, feedId, result);
 
   if (updateFeedsCount_ > 0) {
     updateFeedsCount_--;
-    emit loadProgress(updateFeedsCount_);
+    queueProgress(updateFeedsCount_);
   }
 
-  if (!data.isEmpty()) {
-    emit xmlReadyParse(data, feedId, dtReply, codecName);
+  // Stopped requests are not counted, they are reported as not modified
+  if ((result < 0) || !data.isEmpty())
+    updateFeedFailures(feedId, result < 0);
+
+  // Servers ignoring conditional requests send the same body again.
+  // It is not parsed, only time of update is set
+  if (!data.isEmpty() && isPayloadUnchanged(feedId, data)) {
+    LOG_DEBUG(LogFile::Update) << "Payload is unchanged:" << feedId;
+    queueUnchangedFeed(feedId, dtReply, etag);
+    finishUpdate(feedId, false, 0, "0");
+  } else if (!data.isEmpty()) {
+    FetchedFeedData *feed = new FetchedFeedData;
+    feed->feedId = feedId;
+    feed->data = data;
+    feed->dtReply = dtReply;
+    feed->codecName = codecName;
+    feed->etag = etag;
+    feed->priority = feedPriority_.value(feedId, RequestFeed::PriorityScheduled);
+    costFeeds_.insert(feedId);
+    emit feedReadyParse(FetchedFeed(feed));
   } else {
     QString status = "0";
     if (result < 0) {
@@ -563,28 +1162,181 @@ void UpdateObject::getUrlDone(int result, int feedId, QString feedUrlStr,
   }
 }
 
+/** @brief Store new URL of feed which is moved permanently
+ *
+ * URL is not changed if other feed already has it, or if feed needs
+ * authentication and new URL is on other server.
+ *---------------------------------------------------------------------------*/
+void UpdateObject::slotFeedUrlMoved(int feedId, QString newUrl)
+{
+  QSqlQuery q(db_);
+  q.prepare("SELECT id FROM feeds WHERE xmlUrl=?");
+  q.addBindValue(newUrl);
+  q.exec();
+  if (q.first()) return;
+
+  q.prepare("SELECT xmlUrl, authentication FROM feeds WHERE id=?");
+  q.addBindValue(feedId);
+  q.exec();
+  if (!q.first()) return;
+  QString oldUrl = q.value(0).toString();
+  if ((q.value(1).toInt() == 1) && (QUrl(oldUrl).host() != QUrl(newUrl).host()))
+    return;
+
+  q.prepare("UPDATE feeds SET xmlUrl=? WHERE id=?");
+  q.addBindValue(newUrl);
+  q.addBindValue(feedId);
+  if (q.exec()) {
+    LOG_DEBUG(LogFile::Update) << "Feed URL changed:" << feedId << oldUrl << "->" << newUrl;
+    emit signalUpdateFeedsModel();
+  }
+}
+
+/** @brief Check if payload of feed is the same as parsed last time
+ *
+ * Digest of last payload is kept in feeds_ex, it is replaced by digest
+ * of changed payload.
+ *----------------------------------------------------------------------------*/
+bool UpdateObject::isPayloadUnchanged(int feedId, const QByteArray &data)
+{
+  qint64 digest = Common::dataDigest(data);
+
+  QHash<int, qint64>::iterator it = payloadDigests_.find(feedId);
+  if (it == payloadDigests_.end()) {
+    QSqlQuery q = queries_.query("SELECT value FROM feeds_ex WHERE feedId=? AND name='payloadDigest'");
+    q.addBindValue(feedId);
+    q.exec();
+    it = payloadDigests_.insert(feedId, q.first() ? q.value(0).toLongLong() : 0);
+    q.finish();
+  }
+  if (it.value() == digest)
+    return true;
+
+  it.value() = digest;
+  QSqlQuery q = queries_.query("DELETE FROM feeds_ex WHERE feedId=? AND name='payloadDigest'");
+  q.addBindValue(feedId);
+  q.exec();
+  q = queries_.query("INSERT INTO feeds_ex(feedId, name, value) VALUES (?, 'payloadDigest', ?)");
+  q.addBindValue(feedId);
+  q.addBindValue(QString::number(digest));
+  q.exec();
+  q.finish();
+  return false;
+}
+
+/** @brief Queue update time of feed with unchanged payload to be saved
+ *   with others
+ *----------------------------------------------------------------------------*/
+void UpdateObject::queueUnchangedFeed(int feedId, const QDateTime &dtReply,
+                                      const QString &etag)
+{
+  UnchangedFeed feed;
+  feed.id = feedId;
+  feed.updated = QLocale::c().toString(QDateTime::currentDateTimeUtc(),
+                                       "yyyy-MM-ddTHH:mm:ss");
+  feed.lastBuildDate = dtReply.toString(Qt::ISODate);
+  feed.etag = etag;
+  unchangedFeeds_.append(feed);
+  if (!unchangedSaveTimer_->isActive())
+    unchangedSaveTimer_->start(UNCHANGED_SAVE_INTERVAL);
+}
+
+/** @brief Save update time of queued feeds in one transaction
+ *----------------------------------------------------------------------------*/
+void UpdateObject::saveUnchangedFeeds()
+{
+  if (unchangedFeeds_.isEmpty()) return;
+
+  db_.transaction();
+  QSqlQuery q = queries_.query("UPDATE feeds SET updated=?, lastBuildDate=?, etag=? WHERE id=?");
+  foreach (const UnchangedFeed &feed, unchangedFeeds_) {
+    q.addBindValue(feed.updated);
+    q.addBindValue(feed.lastBuildDate);
+    q.addBindValue(feed.etag);
+    q.addBindValue(feed.id);
+    q.exec();
+  }
+  q.finish();
+  db_.commit();
+  unchangedFeeds_.clear();
+}
+
+/** @brief Count failed updates of feed in a row
+ *
+ * After few failures feed is not updated by timer until its back-off is
+ * over. Back-off is doubled by each next failure, so dead feeds are probed
+ * rarely. Counter and time are kept in feeds_ex across restarts.
+ *---------------------------------------------------------------------------*/
+void UpdateObject::updateFeedFailures(int feedId, bool failed)
+{
+  if (!failed && !feedFailures_.contains(feedId))
+    return;
+
+  QSqlQuery q = queries_.query("DELETE FROM feeds_ex WHERE feedId=? "
+                               "AND name IN ('fetchFailures', 'fetchRetryAfter')");
+  q.addBindValue(feedId);
+  q.exec();
+  q.finish();
+  if (!failed) {
+    feedFailures_.remove(feedId);
+    return;
+  }
+
+  int failures = feedFailures_.value(feedId, 0) + 1;
+  feedFailures_.insert(feedId, failures);
+
+  q = queries_.query("INSERT INTO feeds_ex(feedId, name, value) VALUES (?, ?, ?)");
+  q.addBindValue(feedId);
+  q.addBindValue("fetchFailures");
+  q.addBindValue(failures);
+  q.exec();
+  if (failures >= FEED_BREAKER_FAILURES) {
+    qint64 backoff = qint64(FEED_BACKOFF_MIN) << qMin(failures - FEED_BREAKER_FAILURES, 16);
+    backoff = qMin(backoff, qint64(FEED_BACKOFF_MAX));
+    q.addBindValue(feedId);
+    q.addBindValue("fetchRetryAfter");
+    q.addBindValue(QDateTime::currentDateTimeUtc().addSecs(backoff).toString(Qt::ISODate));
+    q.exec();
+    LOG_DEBUG(LogFile::Update) << "Feed is failing:" << feedId << "failures:" << failures
+                               << "back-off:" << backoff;
+  }
+  q.finish();
+}
+
 void UpdateObject::finishUpdate(int feedId, bool changed, int newCount, QString status)
 {
   if (updateFeedsCount_ > 0) {
     updateFeedsCount_--;
-    emit loadProgress(updateFeedsCount_);
+    queueProgress(updateFeedsCount_);
   }
   bool finish = false;
   if (updateFeedsCount_ <= 0) {
     finish = true;
   }
 
-  int feedIdIndex = feedIdList_.indexOf(feedId);
-  if (feedIdIndex > -1) {
-    feedIdList_.takeAt(feedIdIndex);
+  if (feedIdList_.remove(feedId)) {
+    feedPriority_.remove(feedId);
+    EventTrace::end(EventTrace::FeedUpdate, feedId);
   }
 
-  QSqlQuery q(db_);
-  QString qStr = QString("UPDATE feeds SET status='%1' WHERE id=='%2'").
-      arg(status).arg(feedId);
-  q.exec(qStr);
+  if (costFeeds_.remove(feedId))
+    sampleFeedCost(feedId, newCount);
+  if ((status == "0") && demotedFeeds_.contains(feedId))
+    status = demotedStatus(feedId);
 
-  if (changed) {
+  // Status may hold translated text, it is bound
+  QSqlQuery q = queries_.query("UPDATE feeds SET status=? WHERE id=?");
+  q.addBindValue(status);
+  q.addBindValue(feedId);
+  q.exec();
+  q.finish();
+
+  // Publish interval is estimated again with new news
+  if (changed)
+    publishInterval_.remove(feedId);
+
+  // Headless daemon has no news view to update
+  if (changed && mainWindow_) {
     if (mainWindow_->currentNewsTab->type_ == NewsTabWidget::TabTypeFeed) {
       bool folderUpdate = false;
       int feedParentId = 0;
@@ -613,7 +1365,7 @@ void UpdateObject::finishUpdate(int feedId, bool changed, int newCount, QString
 
         int unreadCount = 0;
         int allCount = 0;
-        q.exec(QString("SELECT unread, undeleteCount FROM feeds WHERE id=='%1'").
+        q.exec(QString("SELECT unread, undeleteCount FROM feedsState WHERE feedId=='%1'").
                arg(mainWindow_->currentNewsTab->feedId_));
         if (q.first()) {
           unreadCount = q.value(0).toInt();
@@ -627,8 +1379,215 @@ void UpdateObject::finishUpdate(int feedId, bool changed, int newCount, QString
     }
   }
 
-  emit feedUpdated(feedId, changed, newCount, finish);
-  emit setStatusFeed(feedId, status);
+  pendingFeedsDone_ = true;
+  pendingFinish_ = pendingFinish_ || finish;
+  if (changed) {
+    updatedFeeds_.append(feedId);
+    updatedNewCounts_.append(newCount);
+  }
+  queueFeedStatus(feedId, status);
+  if (finish) {
+    applyCostBudget();
+    // End of update is shown at once
+    flushProgress();
+  }
+}
+
+/** @brief Keep average cost of feed update and its new news
+ *
+ * Cost is time of download, decode, parse and store of feed taken from
+ * pipeline metrics. Demoted feed is promoted back when it is not
+ * expensive anymore.
+ *---------------------------------------------------------------------------*/
+void UpdateObject::sampleFeedCost(int feedId, int newCount)
+{
+  qint64 cost = PipelineMetrics::feedCost(feedId);
+  if (cost < 0) return;
+
+  cycleCost_ += cost;
+  cycleFeeds_.insert(feedId);
+
+  FeedCost &feedCost = feedCosts_[feedId];
+  int weight = qMin(feedCost.samples, FEED_COST_SAMPLES - 1);
+  feedCost.cost = (feedCost.cost * weight + cost) / (weight + 1);
+  feedCost.newCount = (feedCost.newCount * weight + newCount) / (weight + 1);
+  feedCost.samples++;
+
+  if (demotedFeeds_.contains(feedId) &&
+      ((feedCost.cost < FEED_COST_MIN / 2) ||
+       (feedCost.cost / (feedCost.newCount + 1) < FEED_COST_PER_NEWS / 2)))
+    setFeedDemoted(feedId, false);
+}
+
+/** @brief Demote expensive feeds when update exceeds its cost budget
+ *
+ * Feeds of this update giving least new news for their cost are demoted
+ * first, until rest of update would fit into budget. Demoted feeds are
+ * updated by timer several times less often and after other feeds.
+ *---------------------------------------------------------------------------*/
+void UpdateObject::applyCostBudget()
+{
+  qint64 excess = cycleCost_ - costBudget_;
+  QSet<int> cycleFeeds = cycleFeeds_;
+  cycleCost_ = 0;
+  cycleFeeds_.clear();
+  if ((costBudget_ <= 0) || (excess <= 0))
+    return;
+
+  QList<QPair<double, int> > candidates;
+  foreach (int feedId, cycleFeeds) {
+    if (demotedFeeds_.contains(feedId) || costExemptFeeds_.contains(feedId))
+      continue;
+    const FeedCost &feedCost = feedCosts_[feedId];
+    double costPerNews = feedCost.cost / (feedCost.newCount + 1);
+    if ((feedCost.samples >= FEED_COST_SAMPLES) && (feedCost.cost >= FEED_COST_MIN) &&
+        (costPerNews >= FEED_COST_PER_NEWS))
+      candidates.append(qMakePair(costPerNews, feedId));
+  }
+  std::sort(candidates.begin(), candidates.end());
+
+  LOG_DEBUG(LogFile::Update) << "Update cost over budget:" << excess
+                             << "candidates:" << candidates.count();
+  for (int i = candidates.count() - 1; (i >= 0) && (excess > 0); --i) {
+    int feedId = candidates.at(i).second;
+    excess -= feedCosts_.value(feedId).cost;
+    setFeedDemoted(feedId, true);
+  }
+}
+
+/** @brief Mark feed as demoted by update cost budget or promote it back
+ *
+ * State is kept in feeds_ex across restarts. Status of feed shows that it
+ * is demoted, unless feed has error.
+ *---------------------------------------------------------------------------*/
+void UpdateObject::setFeedDemoted(int feedId, bool demoted)
+{
+  QSqlQuery q = queries_.query("DELETE FROM feeds_ex WHERE feedId=? AND name='costDemoted'");
+  q.addBindValue(feedId);
+  q.exec();
+  q.finish();
+
+  QString status = "0";
+  if (demoted) {
+    demotedFeeds_.insert(feedId);
+    q = queries_.query("INSERT INTO feeds_ex(feedId, name, value) VALUES (?, 'costDemoted', ?)");
+    q.addBindValue(feedId);
+    q.addBindValue(QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+    q.exec();
+    q.finish();
+    status = demotedStatus(feedId);
+  } else {
+    demotedFeeds_.remove(feedId);
+  }
+  LOG_DEBUG(LogFile::Update) << "Feed" << (demoted ? "demoted:" : "promoted:") << feedId
+                             << "cost:" << feedCosts_.value(feedId).cost
+                             << "new news:" << feedCosts_.value(feedId).newCount;
+
+  q = queries_.query("UPDATE feeds SET status=? WHERE id=? "
+                     "AND (status='0' OR status='' OR status IS NULL OR status LIKE '2 %')");
+  q.addBindValue(status);
+  q.addBindValue(feedId);
+  q.exec();
+  if (q.numRowsAffected() > 0)
+    queueFeedStatus(feedId, status);
+  q.finish();
+}
+
+/** @brief Status of feed demoted by update cost budget
+ *
+ * Status code 2 is shown with its own bullet in feeds tree.
+ *---------------------------------------------------------------------------*/
+QString UpdateObject::demotedStatus(int feedId) const
+{
+  FeedCost feedCost = feedCosts_.value(feedId);
+  if (!feedCost.samples)
+    return QString("2 %1").arg(tr("Updated less often, update is expensive for its new news"));
+  return QString("2 %1").arg(tr("Updated less often, update takes %1 ms for %2 new news on average").
+                             arg(feedCost.cost).arg(feedCost.newCount, 0, 'f', 1));
+}
+
+/** @brief Enable or disable demotion of feed by update cost budget
+ *
+ * Called from feed properties. Feed with disabled demotion is promoted
+ * at once.
+ *---------------------------------------------------------------------------*/
+void UpdateObject::slotCostDemotion(int feedId, bool enabled)
+{
+  if (enabled == !costExemptFeeds_.contains(feedId))
+    return;
+
+  QSqlQuery q = queries_.query("DELETE FROM feeds_ex WHERE feedId=? AND name='costDemotionDisabled'");
+  q.addBindValue(feedId);
+  q.exec();
+  q.finish();
+  if (enabled) {
+    costExemptFeeds_.remove(feedId);
+    return;
+  }
+
+  costExemptFeeds_.insert(feedId);
+  q = queries_.query("INSERT INTO feeds_ex(feedId, name, value) VALUES (?, 'costDemotionDisabled', 1)");
+  q.addBindValue(feedId);
+  q.exec();
+  q.finish();
+  if (demotedFeeds_.contains(feedId))
+    setFeedDemoted(feedId, false);
+}
+
+/** @brief Keep progress of update till next snapshot for GUI
+ *---------------------------------------------------------------------------*/
+void UpdateObject::queueProgress(int value)
+{
+  pendingProgress_ = value;
+  if (!progressTimer_->isActive())
+    progressTimer_->start();
+}
+
+/** @brief Keep status of feed till next snapshot for GUI
+ *
+ * Only last status of feed is sent, e.g. a feed requested and finished
+ * between two snapshots does not blink in feeds tree.
+ *---------------------------------------------------------------------------*/
+void UpdateObject::queueFeedStatus(int feedId, QString status)
+{
+  pendingStatus_.insert(feedId, status);
+  if (!progressTimer_->isActive())
+    progressTimer_->start();
+}
+
+/** @brief Send collected progress, statuses and finished feeds to GUI
+ *
+ * During large update GUI gets one call of each kind per interval
+ * instead of calls for every feed.
+ *---------------------------------------------------------------------------*/
+void UpdateObject::flushProgress()
+{
+  progressTimer_->stop();
+
+  if (pendingProgress_ >= 0) {
+    emit loadProgress(pendingProgress_);
+    pendingProgress_ = -1;
+  }
+
+  if (!pendingStatus_.isEmpty()) {
+    QList<int> feedIds;
+    QStringList statuses;
+    QHash<int, QString>::const_iterator it = pendingStatus_.constBegin();
+    for (; it != pendingStatus_.constEnd(); ++it) {
+      feedIds.append(it.key());
+      statuses.append(it.value());
+    }
+    pendingStatus_.clear();
+    emit setStatusFeeds(feedIds, statuses);
+  }
+
+  if (pendingFeedsDone_) {
+    emit feedsUpdated(updatedFeeds_, updatedNewCounts_, pendingFinish_);
+    updatedFeeds_.clear();
+    updatedNewCounts_.clear();
+    pendingFeedsDone_ = false;
+    pendingFinish_ = false;
+  }
 }
 
 /** @brief Start timer if feed presents in queue
@@ -643,22 +1602,56 @@ void UpdateObject::slotNextUpdateFeed(bool finish)
   }
 }
 
+/** @brief Send counters of categories requested by main window
+ *---------------------------------------------------------------------------*/
 void UpdateObject::slotRecountCategoryCounts()
 {
-  QList<int> deletedList;
-  QList<int> starredList;
-  QList<int> readList;
-  QStringList labelList;
+  emitCategoryCounts(true);
+}
+
+/** @brief Send counters of categories if news were changed here
+ *
+ * Counters are kept by triggers, so signal is sent only when they differ
+ * from last sent ones.
+ *---------------------------------------------------------------------------*/
+void UpdateObject::slotCategoryCountsChanged()
+{
+  emitCategoryCounts(false);
+}
+
+void UpdateObject::emitCategoryCounts(bool force)
+{
+  CategoryCountStruct counts;
+  counts.allStarredCount = 0;
+  counts.unreadStarredCount = 0;
+  counts.deletedCount = 0;
+
   QSqlQuery q(db_);
-  q.exec("SELECT deleted, starred, read, label FROM news WHERE deleted < 2");
+  q.exec("SELECT category, allCount, unreadCount FROM categoryCounts");
   while (q.next()) {
-    deletedList.append(q.value(0).toInt());
-    starredList.append(q.value(1).toInt());
-    readList.append(q.value(2).toInt());
-    labelList.append(q.value(3).toString());
+    int category = q.value(0).toInt();
+    if (category == CATEGORY_STARRED) {
+      counts.allStarredCount = q.value(1).toInt();
+      counts.unreadStarredCount = q.value(2).toInt();
+    } else if (category == CATEGORY_DELETED) {
+      counts.deletedCount = q.value(1).toInt();
+    } else if ((category > 0) && q.value(1).toInt()) {
+      counts.allLabelCount.insert(category, q.value(1).toInt());
+      counts.unreadLabelCount.insert(category, q.value(2).toInt());
+    }
   }
 
-  emit signalRecountCategoryCounts(deletedList, starredList, readList, labelList);
+  if (!force && categoryCountsSent_ &&
+      (counts.allStarredCount == lastCategoryCounts_.allStarredCount) &&
+      (counts.unreadStarredCount == lastCategoryCounts_.unreadStarredCount) &&
+      (counts.deletedCount == lastCategoryCounts_.deletedCount) &&
+      (counts.allLabelCount == lastCategoryCounts_.allLabelCount) &&
+      (counts.unreadLabelCount == lastCategoryCounts_.unreadLabelCount))
+    return;
+
+  lastCategoryCounts_ = counts;
+  categoryCountsSent_ = true;
+  emit signalRecountCategoryCounts(counts);
 }
 
 /** @brief Update feed counters and all its parents
@@ -672,56 +1665,50 @@ void UpdateObject::slotRecountCategoryCounts()
  *----------------------------------------------------------------------------*/
 void UpdateObject::slotRecountFeedCounts(int feedId, bool updateViewport)
 {
-  QSqlQuery q(db_);
-  QString qStr;
+  QSqlQuery q;
 
   db_.transaction();
 
   int feedParId = 0;
   bool isFolder = false;
-  qStr = QString("SELECT parentId, xmlUrl FROM feeds WHERE id=='%1'").
-      arg(feedId);
-  q.exec(qStr);
+  q = queries_.query("SELECT parentId, xmlUrl FROM feeds WHERE id=?");
+  q.addBindValue(feedId);
+  q.exec();
   if (q.next()) {
     feedParId = q.value(0).toInt();
     if (q.value(1).toString().isEmpty())
       isFolder = true;
   }
+  q.finish();
 
   int undeleteCount = 0;
   int unreadCount = 0;
   int newCount = 0;
 
   if (!isFolder) {
-    // Calculate all news (not mark deleted)
-    qStr = QString("SELECT count(id) FROM news WHERE feedId=='%1' AND deleted==0").
-        arg(feedId);
-    q.exec(qStr);
-    if (q.next()) undeleteCount = q.value(0).toInt();
-
-    // Calculate unread news
-    qStr = QString("SELECT count(read) FROM news WHERE feedId=='%1' AND read==0 AND deleted==0").
-        arg(feedId);
-    q.exec(qStr);
-    if (q.next()) unreadCount = q.value(0).toInt();
-
-    // Calculate new news
-    qStr = QString("SELECT count(new) FROM news WHERE feedId=='%1' AND new==1 AND deleted==0").
-        arg(feedId);
-    q.exec(qStr);
-    if (q.next()) newCount = q.value(0).toInt();
+    // Calculate all (not mark deleted), unread and new news in one pass
+    SQLiteStatement *statement = queries_.statement(kNewsCountsQuery);
+    statement->bind(1, feedId);
+    NewsCountsRow row;
+    if (statement->fetch(&row)) {
+      undeleteCount = row.undeleteCount;
+      unreadCount = row.unreadCount;
+      newCount = row.newCount;
+    }
+    statement->reset();
 
     int unreadCountOld = 0;
     int newCountOld = 0;
     int undeleteCountOld = 0;
-    qStr = QString("SELECT unread, newCount, undeleteCount FROM feeds WHERE id=='%1'").
-        arg(feedId);
-    q.exec(qStr);
+    q = queries_.query("SELECT unread, newCount, undeleteCount FROM feedsState WHERE feedId=?");
+    q.addBindValue(feedId);
+    q.exec();
     if (q.next()) {
       unreadCountOld = q.value(0).toInt();
       newCountOld = q.value(1).toInt();
       undeleteCountOld = q.value(2).toInt();
     }
+    q.finish();
 
     if ((unreadCount == unreadCountOld) && (newCount == newCountOld) &&
         (undeleteCount == undeleteCountOld)) {
@@ -730,10 +1717,12 @@ void UpdateObject::slotRecountFeedCounts(int feedId, bool updateViewport)
     }
 
     // Save unread and new news number for feed
-    qStr = QString("UPDATE feeds SET unread='%1', newCount='%2', undeleteCount='%3' "
-                   "WHERE id=='%4'").
-        arg(unreadCount).arg(newCount).arg(undeleteCount).arg(feedId);
-    q.exec(qStr);
+    q = queries_.query("UPDATE feedsState SET unread=?, newCount=?, undeleteCount=? WHERE feedId=?");
+    q.addBindValue(unreadCount);
+    q.addBindValue(newCount);
+    q.addBindValue(undeleteCount);
+    q.addBindValue(feedId);
+    q.exec();
 
     // Update view of the feed
     FeedCountStruct counts;
@@ -749,9 +1738,12 @@ void UpdateObject::slotRecountFeedCounts(int feedId, bool updateViewport)
     if (idList.count()) {
       foreach (int id, idList) {
         int parId = 0;
-        q.exec(QString("SELECT parentId FROM feeds WHERE id=='%1'").arg(id));
+        q = queries_.query("SELECT parentId FROM feeds WHERE id=?");
+        q.addBindValue(id);
+        q.exec();
         if (q.next())
           parId = q.value(0).toInt();
+        q.finish();
 
         if (parId) {
           if (idParList.indexOf(parId) == -1) {
@@ -759,35 +1751,29 @@ void UpdateObject::slotRecountFeedCounts(int feedId, bool updateViewport)
           }
         }
 
-        // Calculate all news (not mark deleted)
-        qStr = QString("SELECT count(id) FROM news WHERE feedId=='%1' AND deleted==0").
-            arg(id);
-        q.exec(qStr);
-        if (q.next()) undeleteCount = q.value(0).toInt();
-
-        // Calculate unread news
-        qStr = QString("SELECT count(read) FROM news WHERE feedId=='%1' AND read==0 AND deleted==0").
-            arg(id);
-        q.exec(qStr);
-        if (q.next()) unreadCount = q.value(0).toInt();
-
-        // Calculate new news
-        qStr = QString("SELECT count(new) FROM news WHERE feedId=='%1' AND new==1 AND deleted==0").
-            arg(id);
-        q.exec(qStr);
-        if (q.next()) newCount = q.value(0).toInt();
+        // Calculate all (not mark deleted), unread and new news in one pass
+        SQLiteStatement *statement = queries_.statement(kNewsCountsQuery);
+        statement->bind(1, id);
+        NewsCountsRow row;
+        if (statement->fetch(&row)) {
+          undeleteCount = row.undeleteCount;
+          unreadCount = row.unreadCount;
+          newCount = row.newCount;
+        }
+        statement->reset();
 
         int unreadCountOld = 0;
         int newCountOld = 0;
         int undeleteCountOld = 0;
-        qStr = QString("SELECT unread, newCount, undeleteCount FROM feeds WHERE id=='%1'").
-            arg(id);
-        q.exec(qStr);
+        q = queries_.query("SELECT unread, newCount, undeleteCount FROM feedsState WHERE feedId=?");
+        q.addBindValue(id);
+        q.exec();
         if (q.next()) {
           unreadCountOld = q.value(0).toInt();
           newCountOld = q.value(1).toInt();
           undeleteCountOld = q.value(2).toInt();
         }
+        q.finish();
 
         if ((unreadCount == unreadCountOld) && (newCount == newCountOld) &&
             (undeleteCount == undeleteCountOld)) {
@@ -796,10 +1782,12 @@ void UpdateObject::slotRecountFeedCounts(int feedId, bool updateViewport)
         changed = true;
 
         // Save unread and new news number for parent
-        qStr = QString("UPDATE feeds SET unread='%1', newCount='%2', undeleteCount='%3' "
-                       "WHERE id=='%4'").
-            arg(unreadCount).arg(newCount).arg(undeleteCount).arg(id);
-        q.exec(qStr);
+        q = queries_.query("UPDATE feedsState SET unread=?, newCount=?, undeleteCount=? WHERE feedId=?");
+        q.addBindValue(unreadCount);
+        q.addBindValue(newCount);
+        q.addBindValue(undeleteCount);
+        q.addBindValue(id);
+        q.exec();
 
         // Update view of the parent
         FeedCountStruct counts;
@@ -819,21 +1807,31 @@ void UpdateObject::slotRecountFeedCounts(int feedId, bool updateViewport)
         while (l_feedParId) {
           QString updated;
 
-          qStr = QString("SELECT sum(unread), sum(newCount), sum(undeleteCount), "
-                         "max(updated) FROM feeds WHERE parentId=='%1'").
-              arg(l_feedParId);
-          q.exec(qStr);
+          q = queries_.query("SELECT sum(feedsState.unread), sum(feedsState.newCount), "
+                             "sum(feedsState.undeleteCount), max(updated) FROM feeds "
+                             "LEFT JOIN feedsState ON feedsState.feedId=feeds.id WHERE parentId=?");
+          q.addBindValue(l_feedParId);
+          q.exec();
           if (q.next()) {
             unreadCount   = q.value(0).toInt();
             newCount      = q.value(1).toInt();
             undeleteCount = q.value(2).toInt();
             updated       = q.value(3).toString();
           }
-          qStr = QString("UPDATE feeds SET unread='%1', newCount='%2', undeleteCount='%3', "
-                         "updated='%4' WHERE id=='%5'").
-              arg(unreadCount).arg(newCount).arg(undeleteCount).arg(updated).
-              arg(l_feedParId);
-          q.exec(qStr);
+          q.finish();
+          q = queries_.query("UPDATE feedsState SET unread=?, newCount=?, undeleteCount=? "
+                             "WHERE feedId=?");
+          q.addBindValue(unreadCount);
+          q.addBindValue(newCount);
+          q.addBindValue(undeleteCount);
+          q.addBindValue(l_feedParId);
+          q.exec();
+          q = queries_.query("UPDATE feeds SET updated=? "
+                             "WHERE id=? AND ifnull(updated, '')!=ifnull(?, '')");
+          q.addBindValue(updated);
+          q.addBindValue(l_feedParId);
+          q.addBindValue(updated);
+          q.exec();
 
           // Update view
           FeedCountStruct counts;
@@ -845,8 +1843,11 @@ void UpdateObject::slotRecountFeedCounts(int feedId, bool updateViewport)
           emit feedCountsUpdate(counts);
 
           if (feedId == l_feedParId) break;
-          q.exec(QString("SELECT parentId FROM feeds WHERE id==%1").arg(l_feedParId));
+          q = queries_.query("SELECT parentId FROM feeds WHERE id=?");
+          q.addBindValue(l_feedParId);
+          q.exec();
           if (q.next()) l_feedParId = q.value(0).toInt();
+          q.finish();
         }
       }
     }
@@ -857,21 +1858,32 @@ void UpdateObject::slotRecountFeedCounts(int feedId, bool updateViewport)
   while (l_feedParId) {
     QString updated;
 
-    qStr = QString("SELECT sum(unread), sum(newCount), sum(undeleteCount), "
-                   "max(updated) FROM feeds WHERE parentId=='%1'").
-        arg(l_feedParId);
-    q.exec(qStr);
+    q = queries_.query("SELECT sum(feedsState.unread), sum(feedsState.newCount), "
+                       "sum(feedsState.undeleteCount), max(updated) FROM feeds "
+                       "LEFT JOIN feedsState ON feedsState.feedId=feeds.id WHERE parentId=?");
+    q.addBindValue(l_feedParId);
+    q.exec();
     if (q.next()) {
       unreadCount   = q.value(0).toInt();
       newCount      = q.value(1).toInt();
       undeleteCount = q.value(2).toInt();
       updated       = q.value(3).toString();
     }
-    qStr = QString("UPDATE feeds SET unread='%1', newCount='%2', undeleteCount='%3', "
-                   "updated='%4' WHERE id=='%5'").
-        arg(unreadCount).arg(newCount).arg(undeleteCount).arg(updated).
-        arg(l_feedParId);
-    q.exec(qStr);
+    q.finish();
+    q = queries_.query("UPDATE feedsState SET unread=?, newCount=?, undeleteCount=? "
+                       "WHERE feedId=?");
+    q.addBindValue(unreadCount);
+    q.addBindValue(newCount);
+    q.addBindValue(undeleteCount);
+    q.addBindValue(l_feedParId);
+    q.exec();
+    // Row of folder is written only if its update time changes
+    q = queries_.query("UPDATE feeds SET updated=? "
+                       "WHERE id=? AND ifnull(updated, '')!=ifnull(?, '')");
+    q.addBindValue(updated);
+    q.addBindValue(l_feedParId);
+    q.addBindValue(updated);
+    q.exec();
 
     // Update view
     FeedCountStruct counts;
@@ -882,30 +1894,32 @@ void UpdateObject::slotRecountFeedCounts(int feedId, bool updateViewport)
     counts.updated = updated;
     emit feedCountsUpdate(counts);
 
-    q.exec(QString("SELECT parentId FROM feeds WHERE id==%1").arg(l_feedParId));
+    q = queries_.query("SELECT parentId FROM feeds WHERE id=?");
+    q.addBindValue(l_feedParId);
+    q.exec();
     if (q.next()) l_feedParId = q.value(0).toInt();
+    q.finish();
   }
   db_.commit();
 
   if (updateViewport) emit signalFeedsViewportUpdate();
 }
 
-/** @brief Get feeds ids list string of folder \a idFolder
+/** @brief Get condition selecting news of all feeds in folder \a idFolder
+ *
+ * Folder tree is walked by recursive query inside SQLite using parentId
+ * index, so condition stays short for any number of feeds. \a idFolder is
+ * included in set itself, thus for feed condition selects its own news.
  *---------------------------------------------------------------------------*/
 QString UpdateObject::getIdFeedsString(int idFolder, int idException)
 {
-  QList<int> idList = getIdFeedsInList(db_, idFolder);
-  if (idList.count()) {
-    QString str;
-    foreach (int id, idList) {
-      if (id == idException) continue;
-      if (!str.isEmpty()) str.append(" OR ");
-      str.append(QString("feedId=%1").arg(id));
-    }
-    return str;
-  } else {
-    return QString("feedId=-1");
-  }
+  if (idFolder <= 0) return QString("feedId=-1");
+
+  return QString("feedId IN (WITH RECURSIVE folder(id) AS ("
+                 "SELECT %1 UNION ALL "
+                 "SELECT feeds.id FROM feeds, folder WHERE feeds.parentId=folder.id) "
+                 "SELECT id FROM folder WHERE id!=%2)").
+      arg(idFolder).arg(idException);
 }
 
 /** @brief Get feeds ids list of folder \a idFolder
@@ -916,20 +1930,15 @@ QList<int> UpdateObject::getIdFeedsInList(QSqlDatabase &db, int idFolder)
   if (idFolder <= 0) return idList;
 
   QSqlQuery q(db);
-  QQueue<int> parentIds;
-  parentIds.enqueue(idFolder);
-  while (!parentIds.empty()) {
-    int parentId = parentIds.dequeue();
-    QString qStr = QString("SELECT id, xmlUrl FROM feeds WHERE parentId='%1'").
-        arg(parentId);
-    q.exec(qStr);
-    while (q.next()) {
-      int feedId = q.value(0).toInt();
-      if (!q.value(1).toString().isEmpty())
-        idList << feedId;
-      if (q.value(1).toString().isEmpty())
-        parentIds.enqueue(feedId);
-    }
+  q.prepare("WITH RECURSIVE folder(id, xmlUrl) AS ("
+            "SELECT id, xmlUrl FROM feeds WHERE parentId=? UNION ALL "
+            "SELECT feeds.id, feeds.xmlUrl FROM feeds, folder "
+            "WHERE feeds.parentId=folder.id AND ifnull(folder.xmlUrl, '')='') "
+            "SELECT id FROM folder WHERE ifnull(xmlUrl, '')!=''");
+  q.addBindValue(idFolder);
+  q.exec();
+  while (q.next()) {
+    idList << q.value(0).toInt();
   }
   return idList;
 }
@@ -938,53 +1947,55 @@ QList<int> UpdateObject::getIdFeedsInList(QSqlDatabase &db, int idFolder)
  *---------------------------------------------------------------------------*/
 void UpdateObject::slotSetFeedRead(int readType, int feedId, int idException, QList<int> idNewsList)
 {
-  QSqlDatabase db = QSqlDatabase::database();
+  // Called directly by main window, so news are written by its connection
+  // before next feed is selected and counters are recounted in own thread
+  QSqlDatabase db = Database::threadConnection();
   QSqlQuery q(db);
 
+  flushNewsState();
+
   if (readType != FeedReadSwitchingTab) {
     db.transaction();
     QString idFeedsStr = getIdFeedsString(feedId, idException);
     if (((readType == FeedReadSwitchingFeed) && mainWindow_->markReadSwitchingFeed_) ||
         ((readType == FeedReadClosingTab) && mainWindow_->markReadClosingTab_) ||
         ((readType == FeedReadPlaceToTray) && mainWindow_->markReadMinimize_)) {
-      if (idFeedsStr == "feedId=-1") {
-        q.exec(QString("UPDATE news SET read=2 WHERE feedId='%1' AND read!=2").arg(feedId));
-      } else {
-        q.exec(QString("UPDATE news SET read=2 WHERE (%1) AND read!=2").arg(idFeedsStr));
-      }
-    } else {
-      if (idFeedsStr == "feedId=-1") {
-        q.exec(QString("UPDATE news SET read=2 WHERE feedId='%1' AND read=1").arg(feedId));
-      } else {
-        q.exec(QString("UPDATE news SET read=2 WHERE (%1) AND read=1").arg(idFeedsStr));
-      }
-    }
-    if (idFeedsStr == "feedId=-1") {
-      q.exec(QString("UPDATE news SET new=0 WHERE feedId='%1' AND new=1").arg(feedId));
+      q.exec(QString("UPDATE news SET read=2 WHERE %1 AND read!=2").arg(idFeedsStr));
     } else {
-      q.exec(QString("UPDATE news SET new=0 WHERE (%1) AND new=1").arg(idFeedsStr));
+      q.exec(QString("UPDATE news SET read=2 WHERE %1 AND read=1").arg(idFeedsStr));
     }
+    q.exec(QString("UPDATE news SET new=0 WHERE %1 AND new=1").arg(idFeedsStr));
     if (mainWindow_->markNewsReadOn_ && mainWindow_->markPrevNewsRead_)
       q.exec(QString("UPDATE news SET read=2 WHERE id IN (SELECT currentNews FROM feeds WHERE id='%1')").arg(feedId));
     db.commit();
-
-    slotRecountFeedCounts(feedId);
-    slotRecountCategoryCounts();
-
-    if (readType != FeedReadPlaceToTray)
-      slotRefreshInfoTray();
   } else {
-    QString idStr;
+    QStringList idStrList;
     foreach (int newsId, idNewsList) {
-      if (!idStr.isEmpty()) idStr.append(" OR ");
-      idStr.append(QString("id='%1'").arg(newsId));
+      idStrList.append(QString::number(newsId));
     }
+    QString idStr = idStrList.join(",");
 
     db.transaction();
-    q.exec(QString("UPDATE news SET read=2 WHERE (%1) AND read==1").arg(idStr));
-    q.exec(QString("UPDATE news SET new=0 WHERE (%1) AND new==1").arg(idStr));
+    q.exec(QString("UPDATE news SET read=2 WHERE id IN (%1) AND read==1").arg(idStr));
+    q.exec(QString("UPDATE news SET new=0 WHERE id IN (%1) AND new==1").arg(idStr));
     db.commit();
+  }
+
+  QMetaObject::invokeMethod(this, "slotRecountFeedRead", Qt::QueuedConnection,
+                            Q_ARG(int, readType), Q_ARG(int, feedId));
+}
+
+/** @brief Recount counters after feed is marked read by slotSetFeedRead
+ *---------------------------------------------------------------------------*/
+void UpdateObject::slotRecountFeedRead(int readType, int feedId)
+{
+  if (readType != FeedReadSwitchingTab) {
+    slotRecountFeedCounts(feedId);
+    slotCategoryCountsChanged();
 
+    if (readType != FeedReadPlaceToTray)
+      refreshInfoTray(false);
+  } else {
     if (feedId > -1)
       slotRecountFeedCounts(feedId, false);
   }
@@ -994,6 +2005,7 @@ void UpdateObject::slotSetFeedRead(int readType, int feedId, int idException, QL
 
 void UpdateObject::slotMarkFeedRead(int id, bool isFolder, bool openFeed)
 {
+  flushNewsState();
   db_.transaction();
   QSqlQuery q(db_);
   QString qStr;
@@ -1031,9 +2043,9 @@ void UpdateObject::slotUpdateStatus(int feedId, bool changed)
   if (changed) {
     slotRecountFeedCounts(feedId);
   }
-  slotRefreshInfoTray();
+  refreshInfoTray(false);
 
-  if (feedId > 0) {
+  if ((feedId > 0) && mainWindow_) {
     bool folderUpdate = false;
     int feedParentId = 0;
     QSqlQuery q(db_);
@@ -1055,7 +2067,7 @@ void UpdateObject::slotUpdateStatus(int feedId, bool changed)
     if ((feedId == mainWindow_->currentNewsTab->feedId_) || folderUpdate) {
       int unreadCount = 0;
       int allCount = 0;
-      q.exec(QString("SELECT unread, undeleteCount FROM feeds WHERE id=='%1'").
+      q.exec(QString("SELECT unread, undeleteCount FROM feedsState WHERE feedId=='%1'").
              arg(mainWindow_->currentNewsTab->feedId_));
       if (q.next()) {
         unreadCount = q.value(0).toInt();
@@ -1068,24 +2080,41 @@ void UpdateObject::slotUpdateStatus(int feedId, bool changed)
 
 void UpdateObject::slotMarkAllFeedsRead()
 {
+  flushNewsState();
+
   QSqlQuery q(db_);
+  QList<FeedCountStruct> countsList;
 
+  db_.transaction();
   q.exec("UPDATE news SET read=2 WHERE read!=2 AND deleted==0");
   q.exec("UPDATE news SET new=0 WHERE new==1 AND deleted==0");
 
-  q.exec("SELECT id FROM feeds WHERE unread!=0");
+  // All news are read now, so counters of feeds and folders are cleared
+  // directly instead of recounting each of them
+  q.exec("SELECT feedId, undeleteCount FROM feedsState WHERE unread!=0 OR newCount!=0");
   while (q.next()) {
-    slotRecountFeedCounts(q.value(0).toInt());
+    FeedCountStruct counts;
+    counts.feedId = q.value(0).toInt();
+    counts.unreadCount = 0;
+    counts.newCount = 0;
+    counts.undeleteCount = q.value(1).toInt();
+    countsList.append(counts);
   }
-  slotRecountCategoryCounts();
+  q.exec("UPDATE feedsState SET unread=0, newCount=0 WHERE unread!=0 OR newCount!=0");
+  db_.commit();
 
-  slotRefreshInfoTray();
+  if (!countsList.isEmpty())
+    emit feedsCountsUpdate(countsList);
+  slotCategoryCountsChanged();
+
+  refreshInfoTray(false);
 
   emit signalMarkAllFeedsRead();
 }
 
 void UpdateObject::slotMarkReadCategory(int type, int idLabel)
 {
+  flushNewsState();
   QString qStr;
   switch (type) {
   case NewsTabWidget::TabTypeUnread:
@@ -1096,20 +2125,23 @@ void UpdateObject::slotMarkReadCategory(int type, int idLabel)
     break;
   case NewsTabWidget::TabTypeLabel:
     if (idLabel != 0) {
-      qStr = QString("feedId > 0 AND deleted = 0 AND label LIKE '%,%1,%'").
+      qStr = QString("feedId > 0 AND deleted = 0 AND "
+                     "id IN (SELECT newsId FROM newsLabels WHERE labelId=%1)").
           arg(idLabel);
     } else {
-      qStr = QString("feedId > 0 AND deleted = 0 AND label!='' AND label!=','");
+      qStr = QString("feedId > 0 AND deleted = 0 AND id IN (SELECT newsId FROM newsLabels)");
     }
     break;
+  default:
+    return;
   }
 
-  QSqlQuery q;
+  QSqlQuery q(db_);
   q.exec(QString("UPDATE news SET read=1 WHERE %1").arg(qStr));
   q.exec(QString("UPDATE news SET new=0 WHERE %1").arg(qStr));
 
   QList<int> idList;
-  q.exec("SELECT id FROM feeds WHERE unread!=0");
+  q.exec("SELECT feedId FROM feedsState WHERE unread!=0");
   while (q.next()) {
     idList.append(q.value(0).toInt());
   }
@@ -1119,30 +2151,149 @@ void UpdateObject::slotMarkReadCategory(int type, int idLabel)
   }
 }
 
-/** @brief Save icon in DB and emit signal to update it
+/** @brief Queue icon to be saved in DB with others received meanwhile
  *----------------------------------------------------------------------------*/
 void UpdateObject::slotIconSave(QString feedUrl, QByteArray faviconData)
 {
-  int feedId = 0;
+  pendingIcons_.append(qMakePair(feedUrl, faviconData));
+  if (!iconSaveTimer_->isActive())
+    iconSaveTimer_->start(ICON_SAVE_INTERVAL);
+}
 
-  QSqlQuery q(db_);
-  q.prepare("SELECT id FROM feeds WHERE xmlUrl LIKE :xmlUrl");
-  q.bindValue(":xmlUrl", feedUrl);
-  q.exec();
-  if (q.next()) {
-    feedId = q.value(0).toInt();
+/** @brief Save queued icons in one transaction and emit signal to update them
+ *
+ * Feeds of one site usually get the same icon. Its data is encoded once
+ * and shared by all of them, also in feeds model.
+ *----------------------------------------------------------------------------*/
+void UpdateObject::saveIcons()
+{
+  if (pendingIcons_.isEmpty()) return;
+
+  QList<int> feedIds;
+  QList<QByteArray> faviconsData;
+  QHash<QByteArray, QByteArray> encodedIcons;
+
+  db_.transaction();
+  for (int i = 0; i < pendingIcons_.count(); ++i) {
+    const QString &feedUrl = pendingIcons_.at(i).first;
+    QByteArray faviconData = pendingIcons_.at(i).second;
+
+    int feedId = 0;
+    QSqlQuery q = queries_.query("SELECT id FROM feeds WHERE xmlUrl LIKE ?");
+    q.addBindValue(feedUrl);
+    q.exec();
+    if (q.next()) {
+      feedId = q.value(0).toInt();
+    }
+    q.finish();
+
+    QHash<QByteArray, QByteArray>::iterator it = encodedIcons.find(faviconData);
+    if (it == encodedIcons.end()) {
+      it = encodedIcons.insert(faviconData, faviconData.toBase64());
+    } else {
+      faviconData = it.key();
+    }
+
+    if (feedId) {
+      q = queries_.query("INSERT OR REPLACE INTO feedsIcons(feedId, image) VALUES (?, ?)");
+      q.addBindValue(feedId);
+      q.addBindValue(it.value());
+      q.exec();
+      q.finish();
+    }
+
+    feedIds.append(feedId);
+    faviconsData.append(faviconData);
   }
+  db_.commit();
 
-  q.prepare("UPDATE feeds SET image = ? WHERE id == ?");
-  q.addBindValue(faviconData.toBase64());
-  q.addBindValue(feedId);
-  q.exec();
+  LOG_DEBUG(LogFile::Update) << "icons saved:" << pendingIcons_.count()
+                             << "distinct:" << encodedIcons.count();
+  pendingIcons_.clear();
+
+  emit signalIconsUpdate(feedIds, faviconsData);
+}
 
-  emit signalIconUpdate(feedId, faviconData);
+/** @brief Queue change of news \a field to be written with others
+ *
+ * Can be called from any thread. Changes of read and new state are counted
+ * for \a feedId after write, pass 0 for fields not affecting feed counters.
+ *---------------------------------------------------------------------------*/
+void UpdateObject::setNewsState(int newsId, int feedId, const QString &field,
+                                const QVariant &value)
+{
+  QMutexLocker locker(&newsStateMutex_);
+  bool start = newsState_.isEmpty();
+  newsState_[field].insert(newsId, value);
+  if (feedId > 0)
+    newsStateFeeds_.insert(feedId);
+  if (start)
+    QMetaObject::invokeMethod(this, "startNewsStateTimer", Qt::QueuedConnection);
+}
+
+// ----------------------------------------------------------------------------
+void UpdateObject::startNewsStateTimer()
+{
+  if (!newsStateTimer_->isActive())
+    newsStateTimer_->start(NEWS_STATE_INTERVAL);
+}
+
+/** @brief Write queued news state changes in one transaction
+ *
+ * Called by timer and before any other change of news, so queued changes
+ * are never applied out of order.
+ *---------------------------------------------------------------------------*/
+void UpdateObject::flushNewsState()
+{
+  QHash<QString, QHash<int, QVariant> > state;
+  QSet<int> feeds;
+  {
+    QMutexLocker locker(&newsStateMutex_);
+    if (newsState_.isEmpty()) return;
+    state = newsState_;
+    feeds = newsStateFeeds_;
+    newsState_.clear();
+    newsStateFeeds_.clear();
+  }
+
+  // Written by connection of calling thread, it may be main window
+  QSqlDatabase db = Database::threadConnection();
+  QSqlQuery q(db);
+  db.transaction();
+  QHash<QString, QHash<int, QVariant> >::const_iterator field = state.constBegin();
+  for (; field != state.constEnd(); ++field) {
+    // News set to the same value are written by one statement
+    QMap<QString, QStringList> idsByValue;
+    QHash<int, QVariant>::const_iterator news = field.value().constBegin();
+    for (; news != field.value().constEnd(); ++news) {
+      idsByValue[news.value().toString()].append(QString::number(news.key()));
+    }
+    QMap<QString, QStringList>::const_iterator ids = idsByValue.constBegin();
+    for (; ids != idsByValue.constEnd(); ++ids) {
+      q.prepare(QString("UPDATE news SET %1=? WHERE id IN (%2)").
+                arg(field.key()).arg(ids.value().join(",")));
+      q.addBindValue(ids.key());
+      if (!q.exec()) {
+        qCritical() << __PRETTY_FUNCTION__ << __LINE__
+                    << "q.lastError(): " << q.lastError().text();
+      }
+    }
+  }
+  db.commit();
+
+  LOG_DEBUG(LogFile::Update) << "news state written:" << state.keys() << feeds.count();
+
+  foreach (int feedId, feeds) {
+    QMetaObject::invokeMethod(this, "slotUpdateStatus", Qt::QueuedConnection,
+                              Q_ARG(int, feedId), Q_ARG(bool, true));
+  }
+  QMetaObject::invokeMethod(this, "slotCategoryCountsChanged", Qt::QueuedConnection);
 }
 
 void UpdateObject::slotSqlQueryExec(QString query)
 {
+  flushNewsState();
+
   QSqlQuery q(db_);
   if (!q.exec(query)) {
     qCritical() << __PRETTY_FUNCTION__ << __LINE__
@@ -1154,45 +2305,216 @@ void UpdateObject::slotSqlQueryExec(QString query)
  *---------------------------------------------------------------------------*/
 void UpdateObject::slotMarkAllFeedsOld()
 {
+  flushNewsState();
   QSqlQuery q(db_);
   q.exec("UPDATE news SET new=0 WHERE new==1 AND deleted==0");
 
-  q.exec("SELECT id FROM feeds WHERE newCount!=0");
+  q.exec("SELECT feedId FROM feedsState WHERE newCount!=0");
   while (q.next()) {
     slotRecountFeedCounts(q.value(0).toInt());
   }
-  slotRecountCategoryCounts();
+  slotCategoryCountsChanged();
 
   if ((mainWindow_->currentNewsTab != NULL) && (mainWindow_->currentNewsTab->type_ < NewsTabWidget::TabTypeWeb)) {
     emit signalUpdateNews(NewsTabWidget::RefreshWithPos);
   }
 
-  slotRefreshInfoTray();
+  refreshInfoTray(false);
+}
+
+/** @brief Count feeds of folder \a folderId for feed properties dialog
+ *---------------------------------------------------------------------------*/
+void UpdateObject::slotFeedsCount(int folderId)
+{
+  emit signalFeedsCount(folderId, getIdFeedsInList(db_, folderId).count());
 }
 
+/** @brief Send totals of new and unread news requested by main window
+ *---------------------------------------------------------------------------*/
 void UpdateObject::slotRefreshInfoTray()
 {
-  // Calculate new and unread news number
+  refreshInfoTray(true);
+}
+
+/** @brief Send totals of new and unread news if they are changed
+ *
+ * Totals are kept by triggers in categories counters table.
+ *---------------------------------------------------------------------------*/
+void UpdateObject::refreshInfoTray(bool force)
+{
   int newCount = 0;
   int unreadCount = 0;
   QSqlQuery q(db_);
-  q.exec("SELECT sum(newCount), sum(unread) FROM feeds WHERE xmlUrl!=''");
+  q.exec(QString("SELECT allCount, unreadCount FROM categoryCounts WHERE category=%1").
+         arg(CATEGORY_TOTAL));
   if (q.first()) {
     newCount    = q.value(0).toInt();
     unreadCount = q.value(1).toInt();
   }
 
+  if (!force && (newCount == trayNewCount_) && (unreadCount == trayUnreadCount_))
+    return;
+
+  trayNewCount_ = newCount;
+  trayUnreadCount_ = unreadCount;
   emit signalRefreshInfoTray(newCount, unreadCount);
 }
 
 void UpdateObject::saveMemoryDatabase()
 {
+  flushNewsState();
   isSaveMemoryDatabase = true;
   Database::sqliteDBMemFile(db_);
   isSaveMemoryDatabase = false;
 }
 
+/** @brief Return free pages of base file in small slices while idle
+ *---------------------------------------------------------------------------*/
+void UpdateObject::slotIdleVacuum()
+{
+  bool busy = updateFeedsCount_ || !feedIdList_.isEmpty() || isSaveMemoryDatabase;
+  bool more = false;
+  if (!busy)
+    more = Database::incrementalVacuum(db_, VACUUM_SLICE_PAGES);
+  vacuumTimer_->start(more ? VACUUM_SLICE_INTERVAL : VACUUM_IDLE_INTERVAL);
+}
+
+/** @brief Move old news to archive base in chunks while idle
+ *---------------------------------------------------------------------------*/
+void UpdateObject::slotIdleArchive()
+{
+  bool busy = updateFeedsCount_ || !feedIdList_.isEmpty() || isSaveMemoryDatabase;
+  bool more = false;
+  if (!busy) {
+    QSet<int> feedIds;
+    more = Database::archiveNews(db_, ARCHIVE_SLICE_NEWS, &feedIds);
+    foreach (int feedId, feedIds) {
+      slotRecountFeedCounts(feedId);
+    }
+  }
+  archiveTimer_->start(more ? ARCHIVE_SLICE_INTERVAL : ARCHIVE_IDLE_INTERVAL);
+}
+
+/** @brief Optimize query planner and check base one table at a time while idle
+ *
+ * Runs every MAINTENANCE_DAYS, results and durations are kept in table
+ * info and shown in storage information of about dialog.
+ *---------------------------------------------------------------------------*/
+void UpdateObject::slotIdleMaintenance()
+{
+  bool busy = updateFeedsCount_ || !feedIdList_.isEmpty() || isSaveMemoryDatabase;
+  if (busy) {
+    maintenanceTimer_->start(MAINTENANCE_IDLE_INTERVAL);
+    return;
+  }
+
+  if (checkTables_.isEmpty()) {
+    QDateTime lastCheck = QDateTime::fromString(
+          Database::infoValue(db_, "quickCheck").section(",", 0, 0), Qt::ISODate);
+    if (lastCheck.isValid() &&
+        (lastCheck.daysTo(QDateTime::currentDateTime()) < MAINTENANCE_DAYS)) {
+      maintenanceTimer_->start(MAINTENANCE_IDLE_INTERVAL);
+      return;
+    }
+
+    Database::optimizePlanner(db_);
+    checkTables_ = Database::quickCheckTables(db_);
+    checkErrors_.clear();
+    checkTime_ = 0;
+    maintenanceTimer_->start(MAINTENANCE_SLICE_INTERVAL);
+    return;
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+  QString table = checkTables_.takeFirst();
+  QStringList errors = Database::quickCheck(db_, table);
+  checkTime_ += timer.elapsed();
+  if (!errors.isEmpty()) {
+    qWarning() << "Quick check of" << table << "failed:" << errors;
+    checkErrors_.append(errors);
+  }
+
+  if (!checkTables_.isEmpty()) {
+    maintenanceTimer_->start(MAINTENANCE_SLICE_INTERVAL);
+    return;
+  }
+
+  Database::setInfoValue(db_, "quickCheck",
+                         QString("%1, %2 ms, %3").
+                         arg(QDateTime::currentDateTime().toString(Qt::ISODate)).
+                         arg(checkTime_).
+                         arg(checkErrors_.isEmpty() ? "ok" : checkErrors_.join("; ")));
+  checkErrors_.clear();
+  maintenanceTimer_->start(MAINTENANCE_IDLE_INTERVAL);
+}
+
+/** @brief Run clean up left by previous shutdown when updates are idle
+ *---------------------------------------------------------------------------*/
+void UpdateObject::slotIdleCleanUp()
+{
+  bool busy = updateFeedsCount_ || !feedIdList_.isEmpty() || isSaveMemoryDatabase;
+  if (busy) {
+    cleanUpTimer_->start(CLEANUP_IDLE_DELAY);
+    return;
+  }
+
+  startShutdownCleanUp();
+  // Counters of feeds may be changed
+  emit signalUpdateModel();
+
+  Settings settings;
+  settings.setValue("Settings/cleanUpPending", false);
+}
+
+/** @brief Replace news purged by clean up with digests of their keys
+ *
+ * Rows with deleted=2 are kept only to find duplicates, so they are
+ * moved to newsTombstones. The last news is kept, so its id is not given
+ * to new news again. Tombstones older than the oldest item served by feed
+ * are dropped.
+ *---------------------------------------------------------------------------*/
+void UpdateObject::compactTombstones()
+{
+  QSqlQuery q(db_);
+  q.setForwardOnly(true);
+  QSqlQuery qInsert(db_);
+  qInsert.prepare("INSERT INTO newsTombstones(feedId, published, digests) VALUES (?, ?, ?)");
+
+  q.exec("SELECT feedId, guid, title, published, link_href FROM news "
+         "WHERE deleted>=2 AND id < (SELECT max(id) FROM news)");
+  while (q.next()) {
+    QSet<qint64> digests;
+    ParseObject::addNewsKeys(&digests, q.value(1).toString(), q.value(2).toString(),
+                             q.value(3).toString(), q.value(4).toString());
+    qInsert.addBindValue(q.value(0));
+    qInsert.addBindValue(q.value(3));
+    qInsert.addBindValue(ParseObject::digestsData(digests));
+    qInsert.exec();
+  }
+  q.exec("DELETE FROM news WHERE deleted>=2 AND id < (SELECT max(id) FROM news)");
+
+  q.exec(QString("DELETE FROM newsTombstones WHERE published!='' AND published < "
+                 "(SELECT strftime('%Y-%m-%dT%H:%M:%S', value, '-%1 days') FROM feeds_ex "
+                 "WHERE feeds_ex.feedId=newsTombstones.feedId AND name='tombstoneHorizon')").
+         arg(TOMBSTONE_HORIZON_MARGIN));
+}
+
+/** @brief Condition of news which may be deleted by clean up
+ *---------------------------------------------------------------------------*/
+QString UpdateObject::cleanUpCandidates(bool neverUnread, bool neverStar, bool neverLabel)
+{
+  QString candidateStr = "deleted == 0";
+  if (neverUnread) candidateStr.append(" AND read!=0");
+  if (neverStar) candidateStr.append(" AND starred==0");
+  if (neverLabel) candidateStr.append(" AND (label=='' OR label==',' OR label IS NULL)");
+  return candidateStr;
+}
+
 /** @brief Delete news from the feed by criteria
+ *
+ * With \a isShutdown criteria of clean up on shutdown are used, it runs
+ * on idle after next start.
  *---------------------------------------------------------------------------*/
 void UpdateObject::startCleanUp(bool isShutdown, QStringList feedsIdList, QList<int> foldersIdList)
 {
@@ -1201,127 +2523,129 @@ void UpdateObject::startCleanUp(bool isShutdown, QStringList feedsIdList, QList<
   bool fullCleanUp = false;
   int countDeleted = 0;
 
-  Settings settings;
+  QSharedPointer<const SettingsSnapshot> options = Settings::snapshot();
   if (isShutdown) {
-    settings.beginGroup("Settings");
-    cleanupOn = settings.value("cleanupOnShutdown", true).toBool();
-    optimizeDB = settings.value("optimizeDB", false).toBool();
+    cleanupOn = options->cleanupOnShutdown;
+    optimizeDB = options->optimizeDB;
   } else {
-    settings.beginGroup("CleanUpWizard");
-    fullCleanUp = settings.value("fullCleanUp", false).toBool();
-  }
-  int maxDayCleanUp = settings.value("maxDayClearUp", 30).toInt();
-  int maxNewsCleanUp = settings.value("maxNewsClearUp", 200).toInt();
-  bool dayCleanUpOn = settings.value("dayClearUpOn", true).toBool();
-  bool newsCleanUpOn = settings.value("newsClearUpOn", true).toBool();
-  bool readCleanUp = settings.value("readClearUp", false).toBool();
-  bool neverUnreadCleanUp = settings.value("neverUnreadClearUp", true).toBool();
-  bool neverStarCleanUp = settings.value("neverStarClearUp", true).toBool();
-  bool neverLabelCleanUp = settings.value("neverLabelClearUp", true).toBool();
-  bool cleanUpDeleted = settings.value("cleanUpDeleted", false).toBool();
-  settings.endGroup();
+    fullCleanUp = options->fullCleanUp;
+  }
+  const SettingsSnapshot::CleanUp &cleanUp =
+      isShutdown ? options->shutdownCleanUp : options->wizardCleanUp;
+  int maxDayCleanUp = cleanUp.maxDayCleanUp;
+  int maxNewsCleanUp = cleanUp.maxNewsCleanUp;
+  bool dayCleanUpOn = cleanUp.dayCleanUpOn;
+  bool newsCleanUpOn = cleanUp.newsCleanUpOn;
+  bool readCleanUp = cleanUp.readCleanUp;
+  bool neverUnreadCleanUp = cleanUp.neverUnreadCleanUp;
+  bool neverStarCleanUp = cleanUp.neverStarCleanUp;
+  bool neverLabelCleanUp = cleanUp.neverLabelCleanUp;
+  bool cleanUpDeleted = cleanUp.cleanUpDeleted;
 
   db_.transaction();
 
   QSqlQuery q(db_);
   QString qStr;
 
-  if (isShutdown) {
-    q.exec("UPDATE news SET new=0 WHERE new==1");
-    q.exec("UPDATE news SET read=2 WHERE read==1");
-    q.exec("UPDATE feeds SET newCount=0 WHERE newCount!=0");
-  }
-
   if (cleanupOn) {
     if (!isShutdown) {
       q.exec("SELECT count(id) FROM news WHERE deleted < 2");
       if (q.first()) countDeleted = q.value(0).toInt();
     }
 
-    // Run Cleanup for all feeds, except categories
-    foreach (QString feedId, feedsIdList) {
-      int countDelNews = 0;
-      int countAllNews = 0;
+    QString feedsIdStr = feedsIdList.join(",");
+    QString qStr1;
+    if (fullCleanUp)
+      qStr1 = "DELETE FROM news";
+    else
+      qStr1 = QString("UPDATE news SET description='', content='', received='', "
+                      "author_name='', author_uri='', author_email='', "
+                      "category='', new='', read='', starred='', label='', "
+                      "deleteDate='', feedParentId='', deleted=2");
+
+    // News which may be deleted by criteria below
+    QString candidateStr = cleanUpCandidates(neverUnreadCleanUp, neverStarCleanUp,
+                                             neverLabelCleanUp);
+
+    // Feeds which counters have to be recalculated
+    QSet<int> changedFeeds;
+    int progress = 0;
+    int progressMax = feedsIdList.count() + CLEANUP_STEPS;
+
+    if (fullCleanUp) {
+      q.exec(QString("DELETE FROM news WHERE feedId IN (%1) AND deleted >= 2").arg(feedsIdStr));
+    }
 
-      qStr = QString("SELECT undeleteCount FROM feeds WHERE id=='%1'").arg(feedId);
-      q.exec(qStr);
-      if (q.next()) countAllNews = q.value(0).toInt();
-
-      if (fullCleanUp)
-        q.exec(QString("DELETE FROM news WHERE feedId=='%1' AND deleted >= 2").arg(feedId));
-
-      QString qStr1 = QString("UPDATE news SET description='', content='', received='', "
-                              "author_name='', author_uri='', author_email='', "
-                              "category='', new='', read='', starred='', label='', "
-                              "deleteDate='', feedParentId='', deleted=2");
-
-      qStr = QString("SELECT id, received FROM news WHERE feedId=='%1' AND deleted == 0").
-          arg(feedId);
-      if (neverUnreadCleanUp) qStr.append(" AND read!=0");
-      if (neverStarCleanUp) qStr.append(" AND starred==0");
-      if (neverLabelCleanUp) qStr.append(" AND (label=='' OR label==',' OR label IS NULL)");
-      qStr.append(" ORDER BY published");
-      q.exec(qStr);
+    // Keep maxNewsCleanUp news in feed, oldest news are deleted first
+    if (newsCleanUpOn) {
+      QList<QPair<int,int> > overLimitList;
+      q.exec(QString("SELECT feedId, undeleteCount FROM feedsState WHERE feedId IN (%1) AND undeleteCount > %2").
+             arg(feedsIdStr).arg(maxNewsCleanUp));
       while (q.next()) {
-        int newsId = q.value(0).toInt();
-
-        if (newsCleanUpOn && (countDelNews < (countAllNews - maxNewsCleanUp))) {
-          if (fullCleanUp)
-            qStr = QString("DELETE FROM news WHERE id='%1'").arg(newsId);
-          else
-            qStr = QString("%1 WHERE id=='%2'").arg(qStr1).arg(newsId);
-          QSqlQuery qt(db_);
-          qt.exec(qStr);
-          countDelNews++;
-          continue;
-        }
+        overLimitList.append(qMakePair(q.value(0).toInt(), q.value(1).toInt() - maxNewsCleanUp));
+      }
+      for (int i = 0; i < overLimitList.count(); ++i) {
+        qStr = QString("%1 WHERE id IN (SELECT id FROM news WHERE feedId=='%2' AND %3 "
+                       "ORDER BY published LIMIT %4)").
+            arg(qStr1).arg(overLimitList.at(i).first).arg(candidateStr).
+            arg(overLimitList.at(i).second);
+        if (q.exec(qStr) && (q.numRowsAffected() > 0))
+          changedFeeds.insert(overLimitList.at(i).first);
+      }
+    }
+    emit signalCleanUpProgress(++progress, progressMax);
+
+    // Delete news received more than maxDayCleanUp days ago
+    if (dayCleanUpOn) {
+      QString dateStr = QDate::currentDate().addDays(-maxDayCleanUp).toString(Qt::ISODate);
+      QString whereStr = QString(" WHERE feedId IN (%1) AND %2 AND received!='' AND received < '%3'").
+          arg(feedsIdStr).arg(candidateStr).arg(dateStr);
+      q.exec("SELECT DISTINCT feedId FROM news" + whereStr);
+      while (q.next()) {
+        changedFeeds.insert(q.value(0).toInt());
+      }
+      q.exec(qStr1 + whereStr);
+    }
+    emit signalCleanUpProgress(++progress, progressMax);
+
+    // Delete read news
+    if (readCleanUp) {
+      QString whereStr = QString(" WHERE feedId IN (%1) AND %2").arg(feedsIdStr).arg(candidateStr);
+      if (!fullCleanUp)
+        whereStr.append(" AND read!=0");
+      q.exec("SELECT DISTINCT feedId FROM news" + whereStr);
+      while (q.next()) {
+        changedFeeds.insert(q.value(0).toInt());
+      }
+      q.exec(qStr1 + whereStr);
+    }
+    emit signalCleanUpProgress(++progress, progressMax);
 
-        QDateTime dateTime = QDateTime::fromString(q.value(1).toString(), Qt::ISODate);
-        if (dayCleanUpOn &&
-            (dateTime.daysTo(QDateTime::currentDateTime()) > maxDayCleanUp)) {
-          if (fullCleanUp)
-            qStr = QString("DELETE FROM news WHERE id='%1'").arg(newsId);
-          else
-            qStr = QString("%1 WHERE id=='%2'").arg(qStr1).arg(newsId);
-          QSqlQuery qt(db_);
-          qt.exec(qStr);
-          countDelNews++;
-          continue;
-        }
+    // Recalculate counters. Only changed feeds on shutdown,
+    // cleanup wizard corrects counters of all chosen feeds
+    foreach (QString feedIdStr, feedsIdList) {
+      emit signalCleanUpProgress(++progress, progressMax);
 
-        if (readCleanUp) {
-          if (fullCleanUp)
-            qStr = QString("DELETE FROM news WHERE id='%1'").arg(newsId);
-          else
-            qStr = QString("%1 WHERE read!=0 AND id=='%2'").arg(qStr1).arg(newsId);
-          QSqlQuery qt(db_);
-          qt.exec(qStr);
-          countDelNews++;
-        }
-      }
+      int feedId = feedIdStr.toInt();
+      if (isShutdown && !changedFeeds.contains(feedId))
+        continue;
 
       int undeleteCount = 0;
-      qStr = QString("SELECT count(id) FROM news WHERE feedId=='%1' AND deleted==0").
-          arg(feedId);
-      q.exec(qStr);
-      if (q.next()) undeleteCount = q.value(0).toInt();
-
       int unreadCount = 0;
-      qStr = QString("SELECT count(read) FROM news WHERE feedId=='%1' AND read==0 AND deleted==0").
-          arg(feedId);
-      q.exec(qStr);
-      if (q.next()) unreadCount = q.value(0).toInt();
-
       int newCount = 0;
+      q.exec(QString("SELECT count(id), sum(read==0), sum(new==1) FROM news "
+                     "WHERE feedId=='%1' AND deleted==0").arg(feedId));
+      if (q.next()) {
+        undeleteCount = q.value(0).toInt();
+        unreadCount = q.value(1).toInt();
+        newCount = q.value(2).toInt();
+      }
+
       if (!isShutdown) {
-        qStr = QString("SELECT count(new) FROM news WHERE feedId=='%1' AND new==1 AND deleted==0").
-            arg(feedId);
-        q.exec(qStr);
-        if (q.next()) newCount = q.value(0).toInt();
-        qStr = QString("UPDATE feeds SET unread='%1', newCount='%2', undeleteCount='%3' WHERE id=='%4'").
+        qStr = QString("UPDATE feedsState SET unread='%1', newCount='%2', undeleteCount='%3' WHERE feedId=='%4'").
             arg(unreadCount).arg(newCount).arg(undeleteCount).arg(feedId);
       } else {
-        qStr = QString("UPDATE feeds SET unread='%1', undeleteCount='%2' WHERE id=='%3'").
+        qStr = QString("UPDATE feedsState SET unread='%1', undeleteCount='%2' WHERE feedId=='%3'").
             arg(unreadCount).arg(undeleteCount).arg(feedId);
       }
       q.exec(qStr);
@@ -1340,7 +2664,8 @@ void UpdateObject::startCleanUp(bool isShutdown, QStringList feedsIdList, QList<
 
         // Calculate sum of all feeds with same parent
         qStr = QString("SELECT sum(unread), sum(undeleteCount), sum(newCount) "
-                       "FROM feeds WHERE parentId=='%1'").arg(folderId);
+                       "FROM feedsState WHERE feedId IN "
+                       "(SELECT id FROM feeds WHERE parentId=='%1')").arg(folderId);
         q.exec(qStr);
         if (q.next()) {
           unreadCount   = q.value(0).toInt();
@@ -1349,7 +2674,7 @@ void UpdateObject::startCleanUp(bool isShutdown, QStringList feedsIdList, QList<
         }
 
         if (unreadCount != -1) {
-          qStr = QString("UPDATE feeds SET unread='%1', undeleteCount='%2', newCount='%3' WHERE id=='%4'").
+          qStr = QString("UPDATE feedsState SET unread='%1', undeleteCount='%2', newCount='%3' WHERE feedId=='%4'").
               arg(unreadCount).arg(undeleteCount).arg(newCount).arg(folderId);
           q.exec(qStr);
         }
@@ -1368,6 +2693,7 @@ void UpdateObject::startCleanUp(bool isShutdown, QStringList feedsIdList, QList<
              "category='', new='', read='', starred='', label='', "
              "deleteDate='', feedParentId='', deleted=2 WHERE deleted==1");
     }
+    compactTombstones();
     if (!isShutdown) {
       q.exec("SELECT count(id) FROM news WHERE deleted < 2");
       if (q.first()) countDeleted = countDeleted - q.value(0).toInt();
@@ -1378,7 +2704,7 @@ void UpdateObject::startCleanUp(bool isShutdown, QStringList feedsIdList, QList<
   db_.commit();
 
   if (!mainApp->storeDBMemory()) {
-    if ((cleanupOn && optimizeDB) || !isShutdown)
+    if (((cleanupOn && optimizeDB) || !isShutdown) && Database::vacuumNeeded(db_))
       db_.exec("VACUUM");
   } else {
     saveMemoryDatabase();
@@ -1386,12 +2712,39 @@ void UpdateObject::startCleanUp(bool isShutdown, QStringList feedsIdList, QList<
       Database::setVacuum();
   }
 
-  emit signalFinishCleanUp(countDeleted);
+  // Clean up wizard may be open while shutdown clean up runs on idle
+  if (!isShutdown)
+    emit signalFinishCleanUp(countDeleted);
 }
 
-/** @brief Delete news from the feed by criteria
+/** @brief Mark news of ending session as not new and read ones as old
+ *
+ * Only feeds with new news and not purged news are touched, so it stays
+ * short on large base.
+ *---------------------------------------------------------------------------*/
+void UpdateObject::resetSessionFlags()
+{
+  db_.transaction();
+  QSqlQuery q(db_);
+  q.exec("UPDATE news SET new=0 WHERE feedId IN "
+         "(SELECT feedId FROM feedsState WHERE newCount!=0) AND new==1");
+  q.exec("UPDATE news SET read=2 WHERE deleted IN (0, 1) AND read==1");
+  q.exec("UPDATE feedsState SET newCount=0 WHERE newCount!=0");
+  q.finish();
+  db_.commit();
+}
+
+/** @brief Reset flags of session and clean up news by shutdown criteria
  *---------------------------------------------------------------------------*/
 void UpdateObject::cleanUpShutdown()
+{
+  resetSessionFlags();
+  startShutdownCleanUp();
+}
+
+/** @brief Clean up all feeds by criteria of clean up on shutdown
+ *---------------------------------------------------------------------------*/
+void UpdateObject::startShutdownCleanUp()
 {
   QSqlQuery q(db_);
   QStringList feedsIdList;
@@ -1410,9 +2763,24 @@ void UpdateObject::cleanUpShutdown()
   startCleanUp(true, feedsIdList, foldersIdList);
 }
 
+/** @brief Save state which is lost otherwise and quit
+ *
+ * Clean up and vacuum are left for idle time after next start, so
+ * shutdown is not killed by session end in the middle of writing.
+ *---------------------------------------------------------------------------*/
 void UpdateObject::quitApp()
 {
-  cleanUpShutdown();
+  flushNewsState();
+  saveIcons();
+  resetSessionFlags();
+
+  if (Settings::snapshot()->cleanupOnShutdown) {
+    Settings settings;
+    settings.setValue("Settings/cleanUpPending", true);
+  }
+
+  if (mainApp->storeDBMemory())
+    saveMemoryDatabase();
 
   QTimer::singleShot(0, mainApp, SLOT(quitApplication()));
 }
@@ -21,10 +21,18 @@
 #include <QThread>
 #include <QtSql>
 #include <QQueue>
+#include <QElapsedTimer>
+#include <QSet>
+#include <QMutex>
 
 #include "requestfeed.h"
 #include "parseobject.h"
+#include "querycache.h"
 #include "faviconobject.h"
+#include "imageprefetcher.h"
+#include "articlefetcher.h"
+#include "websubclient.h"
+#include "greadersync.h"
 #include "newstabwidget.h"
 
 class UpdateObject;
@@ -34,7 +42,7 @@ class UpdateFeeds : public QObject
 {
   Q_OBJECT
 public:
-  explicit UpdateFeeds(QObject *parent, bool addFeed = false);
+  explicit UpdateFeeds(QObject *parent);
   ~UpdateFeeds();
 
   void disconnectObjects();
@@ -44,18 +52,26 @@ public:
   RequestFeed *requestFeed_;
   ParseObject *parseObject_;
   FaviconObject *faviconObject_;
+  ImagePrefetcher *imagePrefetcher_;
+  ArticleFetcher *articleFetcher_;
+  WebSubClient *webSubClient_;
+  GReaderSync *syncClient_;
   QThread *getFeedThread_;
   QThread *updateFeedThread_;
   QThread *getFaviconThread_;
+  QList<QThread *> parseThreads_;
+  QList<ParseWorker *> parseWorkers_;
 
 public slots:
   void saveMemoryDatabase();
+  void releaseMemory();
 
 signals:
   void signalSaveMemoryDatabase();
 
 private:
-  bool addFeed_;
+  void connectWindow(QObject *window);
+
   QTimer *saveMemoryDBTimer_;
 
 };
@@ -68,22 +84,31 @@ public:
   ~UpdateObject();
 
   static QList<int> getIdFeedsInList(QSqlDatabase &db, int idFolder);
+  static QString getIdFeedsString(int idFolder, int idException = -1);
+  static QString cleanUpCandidates(bool neverUnread, bool neverStar, bool neverLabel);
+
+  void setNewsState(int newsId, int feedId, const QString &field,
+                    const QVariant &value);
 
   bool isSaveMemoryDatabase;
 
 public slots:
   void slotGetFeedTimer(int feedId);
-  void slotGetAllFeedsTimer();
+  void slotGetAllFeedsTimer(int interval = 0);
+  void slotStopUpdate();
   void slotGetFeed(int feedId, QString feedUrl, QDateTime date, int auth);
   void slotGetFeedsFolder(QString query);
-  void slotGetAllFeeds();
+  void slotGetAllFeeds(int priority = RequestFeed::PriorityScheduled);
   void slotImportFeeds(QByteArray xmlData);
   void getUrlDone(int result, int feedId, QString feedUrlStr,
                   QString error, QByteArray data,
-                  QDateTime dtReply, QString codecName);
+                  QDateTime dtReply, QString codecName, QString etag);
   void finishUpdate(int feedId, bool changed, int newCount, QString status);
+  void slotFeedUrlMoved(int feedId, QString newUrl);
+  void queueFeedStatus(int feedId, QString status);
   void slotNextUpdateFeed(bool finish);
   void slotRecountCategoryCounts();
+  void slotCategoryCountsChanged();
   void slotRecountFeedCounts(int feedId, bool updateViewport = true);
   void slotSetFeedRead(int readType, int feedId, int idException, QList<int> idNewsList);
   void slotMarkFeedRead(int id, bool isFolder, bool openFeed);
@@ -94,10 +119,13 @@ public slots:
   void slotSqlQueryExec(QString query);
   void slotMarkAllFeedsOld();
   void slotRefreshInfoTray();
+  void slotFeedsCount(int folderId);
+  void slotCostDemotion(int feedId, bool enabled);
   void saveMemoryDatabase();
   void startCleanUp(bool isShutdown, QStringList feedsIdList, QList<int> foldersIdList);
   void cleanUpShutdown();
   void quitApp();
+  void flushNewsState();
 
 signals:
   void showProgressBar(int value);
@@ -105,37 +133,147 @@ signals:
   void signalMessageStatusBar(QString message, int timeout = 0);
   void signalUpdateFeedsModel();
   void signalRequestUrl(int feedId, QString urlString,
-                        QDateTime date, QString userInfo);
-  void xmlReadyParse(QByteArray data, int feedId,
-                     QDateTime dtReply, QString codecName);
-  void setStatusFeed(int feedId, QString status);
-  void feedUpdated(int feedId, bool changed, int newCount, bool finish);
+                        QDateTime date, QString userInfo, QString etag,
+                        int priority);
+  void signalRequestUrls(FeedRequestList requests);
+  void signalPromoteFeed(int feedId);
+  void feedReadyParse(const FetchedFeed &feed);
+  void setStatusFeeds(QList<int> feedIds, QStringList statuses);
+  void feedsUpdated(QList<int> feedIds, QList<int> newCounts, bool finish);
   void signalUpdateModel(bool checkFilter = true);
   void signalUpdateNews(int refresh = NewsTabWidget::RefreshInsert);
   void signalCountsStatusBar(int unreadCount, int allCount);
-  void signalRecountCategoryCounts(QList<int> deletedList, QList<int> starredList,
-                                   QList<int> readList, QStringList labelList);
+  void signalRecountCategoryCounts(CategoryCountStruct counts);
   void feedCountsUpdate(FeedCountStruct counts);
+  void feedsCountsUpdate(QList<FeedCountStruct> countsList);
   void signalFeedsViewportUpdate();
   void signalRefreshInfoTray(int newCount, int unreadCount);
   void signalMarkAllFeedsRead(int nextUnread = -1);
-  void signalIconUpdate(int feedId, QByteArray faviconData);
+  void signalIconsUpdate(QList<int> feedIds, QList<QByteArray> faviconsData);
   void signalSetFeedsFilter(bool clicked = false);
   void signalFinishCleanUp(int countDeleted);
+  void signalCleanUpProgress(int value, int maximum);
+  void signalFeedsCount(int folderId, int count);
 
 private slots:
+  void slotStaggerTimeout();
+  void slotImportTimeout();
+  void startNewsStateTimer();
+  void flushProgress();
+  void saveIcons();
+  void saveUnchangedFeeds();
+  void slotRecountFeedRead(int readType, int feedId);
+  void slotIdleVacuum();
+  void slotIdleArchive();
+  void slotIdleCleanUp();
+  void slotIdleMaintenance();
   bool addFeedInQueue(int feedId, const QString &feedUrl,
-                      const QDateTime &date, int auth);
+                      const QDateTime &date, int auth,
+                      const QString &etag = QString(),
+                      int priority = RequestFeed::PriorityScheduled);
 
 private:
-  QString getIdFeedsString(int idFolder, int idException = -1);
+  struct StaggeredFeed {
+    int id;
+    QString url;
+    QDateTime date;
+    int auth;
+    QString etag;
+  };
+  struct UnchangedFeed {
+    int id;
+    QString updated;
+    QString lastBuildDate;
+    QString etag;
+  };
+  // Average cost of feed update and its yield of new news
+  struct FeedCost {
+    FeedCost() : samples(0), cost(0), newCount(0) {}
+
+    int samples;
+    qint64 cost;
+    double newCount;
+  };
+
+  bool isFeedDue(int feedId, const QString &updated, int ttl,
+                 const QString &skipHours, const QString &skipDays,
+                 bool adaptive);
+  void updateFeedFailures(int feedId, bool failed);
+  void sampleFeedCost(int feedId, int newCount);
+  void applyCostBudget();
+  void setFeedDemoted(int feedId, bool demoted);
+  QString demotedStatus(int feedId) const;
+  bool isPayloadUnchanged(int feedId, const QByteArray &data);
+  void queueUnchangedFeed(int feedId, const QDateTime &dtReply, const QString &etag);
+  void beginRequestBatch();
+  void flushRequestBatch();
+  void queueProgress(int value);
+  void compactTombstones();
+  void resetSessionFlags();
+  void emitCategoryCounts(bool force);
+  void refreshInfoTray(bool force);
+  void startShutdownCleanUp();
 
   MainWindow *mainWindow_;
   QSqlDatabase db_;
-  QList<int> feedIdList_;
+  QueryCache queries_;
+  bool adaptiveUpdate_;
+  QHash<int, int> publishInterval_;
+  QHash<int, int> feedFailures_;
+  // Update cost budget of one update of feeds (ms), 0 if disabled
+  qint64 costBudget_;
+  qint64 cycleCost_;
+  QSet<int> cycleFeeds_;
+  QSet<int> costFeeds_;  // feeds sent to parser, their cost is sampled
+  QHash<int, FeedCost> feedCosts_;
+  QSet<int> demotedFeeds_;
+  QSet<int> costExemptFeeds_;
+  bool staggeredUpdate_;
+  QMultiMap<qint64, StaggeredFeed> staggerQueue_;
+  QSet<int> staggerIds_;
+  QElapsedTimer staggerClock_;
+  QTimer *staggerTimer_;
+  QList<StaggeredFeed> importQueue_;
+  QTimer *importTimer_;
+  QMutex newsStateMutex_;
+  QHash<QString, QHash<int, QVariant> > newsState_;
+  QSet<int> newsStateFeeds_;
+  QTimer *newsStateTimer_;
+  QList<QPair<QString, QByteArray> > pendingIcons_;
+  QTimer *iconSaveTimer_;
+  QHash<int, qint64> payloadDigests_;
+  QList<UnchangedFeed> unchangedFeeds_;
+  QTimer *unchangedSaveTimer_;
+  QTimer *vacuumTimer_;
+  QTimer *archiveTimer_;
+  QTimer *cleanUpTimer_;
+  QTimer *maintenanceTimer_;
+  QStringList checkTables_;  // tables left to quick check in this run
+  QStringList checkErrors_;
+  qint64 checkTime_;
+  bool webSubEnabled_;
+  QSet<int> feedIdList_;
+  // Requests collected by addFeedInQueue() while batch is open
+  bool requestBatchOpen_;
+  FeedRequestList requestBatch_;
+  // Snapshot of update progress sent to GUI by progressTimer_
+  QTimer *progressTimer_;
+  int pendingProgress_;
+  QHash<int, QString> pendingStatus_;
+  QList<int> updatedFeeds_;
+  QList<int> updatedNewCounts_;
+  bool pendingFeedsDone_;
+  bool pendingFinish_;
+  QHash<int, int> feedPriority_;
   int updateFeedsCount_;
   QTimer *updateModelTimer_;
   QTimer *timerUpdateNews_;
+  // Last counters of categories sent to GUI
+  bool categoryCountsSent_;
+  CategoryCountStruct lastCategoryCounts_;
+  // Last totals sent to tray
+  int trayNewCount_;
+  int trayUnreadCount_;
 
 };
 
@@ -22,6 +22,7 @@
 #include "webpluginfactory.h"
 #include "adblockicon.h"
 #include "adblockmanager.h"
+#include "imageprefetcher.h"
 
 #include <QAction>
 #include <QDesktopServices>
@@ -44,6 +45,7 @@ WebPage::WebPage(QObject *parent)
 
   connect(this, SIGNAL(loadProgress(int)), this, SLOT(progress(int)));
   connect(this, SIGNAL(loadFinished(bool)), this, SLOT(finished()));
+  connect(mainFrame(), SIGNAL(urlChanged(QUrl)), this, SLOT(urlChanged(QUrl)));
 
   connect(this, SIGNAL(unsupportedContent(QNetworkReply*)),
           this, SLOT(handleUnsupportedContent(QNetworkReply*)));
@@ -113,11 +115,41 @@ bool WebPage::isLoading() const
 
 void WebPage::urlChanged(const QUrl &url)
 {
-  Q_UNUSED(url)
-
   if (isLoading()) {
     adBlockedEntries_.clear();
+    blockedUrls_.clear();
+  }
+
+  applyElementHiding(url);
+}
+
+/** @brief Add element hiding rules of domain to user style sheet of page
+ *
+ * Style sheet is used by document from its start, so hidden elements are
+ * never shown and page is not laid out again after load.
+ *----------------------------------------------------------------------------*/
+void WebPage::applyElementHiding(const QUrl &url)
+{
+  AdBlockManager* manager = AdBlockManager::instance();
+  QString elementHiding = manager->elementHidingRulesForDomain(url);
+  if (elementHiding == elementHiding_) {
+    return;
   }
+  elementHiding_ = elementHiding;
+
+  // Empty URL makes page use global style sheet again
+  if (elementHiding.isEmpty()) {
+    settings()->setUserStyleSheetUrl(QUrl());
+    return;
+  }
+
+  // Global style sheet is data URL made by MainApplication::userStyleSheet()
+  QString globalStyle = QWebSettings::globalSettings()->userStyleSheetUrl().toString();
+  QByteArray style = QByteArray::fromBase64(globalStyle.section(QLatin1Char(','), 1).toLatin1());
+  style.append("\n/* AdBlock */\n");
+  style.append(elementHiding.toUtf8());
+  settings()->setUserStyleSheetUrl(
+        QUrl(QString("data:text/css;charset=utf-8;base64,%1").arg(QString(style.toBase64()))));
 }
 
 void WebPage::progress(int prog)
@@ -212,6 +244,10 @@ void WebPage::populateNetworkRequest(QNetworkRequest &request)
       request.setRawHeader("X-QuiteRSS-UserLoadAction", QByteArray("1"));
     }
   }
+
+  // Image of news is shown from cache also when server is not reachable
+  if (ImagePrefetcher::isPrefetched(request.url()))
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferCache);
 }
 
 void WebPage::addAdBlockRule(const AdBlockRule* rule, const QUrl &url)
@@ -220,9 +256,13 @@ void WebPage::addAdBlockRule(const AdBlockRule* rule, const QUrl &url)
   entry.rule = rule;
   entry.url = url;
 
-  if (!adBlockedEntries_.contains(entry)) {
-    adBlockedEntries_.append(entry);
+  // Entries are searched only for URL blocked again
+  const QByteArray encodedUrl = url.toEncoded(QUrl::RemoveFragment);
+  if (blockedUrls_.contains(encodedUrl) && adBlockedEntries_.contains(entry)) {
+    return;
   }
+  blockedUrls_.insert(encodedUrl);
+  adBlockedEntries_.append(entry);
 }
 
 QVector<WebPage::AdBlockedEntry> WebPage::adBlockedEntries() const
@@ -230,59 +270,33 @@ QVector<WebPage::AdBlockedEntry> WebPage::adBlockedEntries() const
   return adBlockedEntries_;
 }
 
+/** @brief Hide elements of page which objects were blocked
+ *
+ * All objects are found by one query and matched against blocked URLs.
+ *----------------------------------------------------------------------------*/
 void WebPage::cleanBlockedObjects()
 {
   AdBlockManager* manager = AdBlockManager::instance();
-  if (!manager->isEnabled()) {
+  if (!manager->isEnabled() || blockedUrls_.isEmpty()) {
     return;
   }
 
-  const QWebElement docElement = mainFrame()->documentElement();
+  const QUrl baseUrl = mainFrame()->baseUrl();
+  const QWebElementCollection elements =
+      mainFrame()->documentElement().findAll("img[src], iframe[src], embed[src]");
 
-  foreach (const AdBlockedEntry &entry, adBlockedEntries_) {
-    const QString urlString = entry.url.toString();
-    if (urlString.endsWith(QLatin1String(".js")) || urlString.endsWith(QLatin1String(".css"))) {
-      continue;
-    }
-
-    QString urlEnd;
-
-    int pos = urlString.lastIndexOf(QLatin1Char('/'));
-    if (pos > 8) {
-      urlEnd = urlString.mid(pos + 1);
-    }
-
-    if (urlString.endsWith(QLatin1Char('/'))) {
-      urlEnd = urlString.left(urlString.size() - 1);
-    }
-
-    QString selector("img[src$=\"%1\"], iframe[src$=\"%1\"],embed[src$=\"%1\"]");
-    QWebElementCollection elements = docElement.findAll(selector.arg(urlEnd));
-
-    foreach (QWebElement element, elements) {
-      QString src = element.attribute("src");
-      src.remove(QLatin1String("../"));
-
-      if (urlString.contains(src)) {
-        element.setStyleProperty("display", "none");
-      }
+  bool hidden = false;
+  foreach (QWebElement element, elements) {
+    const QUrl src = baseUrl.resolved(QUrl(element.attribute("src")));
+    if (blockedUrls_.contains(src.toEncoded(QUrl::RemoveFragment))) {
+      element.setStyleProperty("display", "none");
+      hidden = true;
     }
   }
 
-  // Apply domain-specific element hiding rules
-  QString elementHiding = manager->elementHidingRulesForDomain(mainFrame()->url());
-  if (elementHiding.isEmpty()) {
-    return;
-  }
-
-  elementHiding.append(QLatin1String("\n</style>"));
-
-  QWebElement bodyElement = docElement.findFirst("body");
-  bodyElement.appendInside("<style type=\"text/css\">\n/* AdBlock */\n" + elementHiding);
-
   // When hiding some elements, scroll position of page will change
   // If user loaded anchor link in background tab (and didn't show it yet), fix the scroll position
-  if (view() && !view()->isVisible() && !mainFrame()->url().fragment().isEmpty()) {
+  if (hidden && view() && !view()->isVisible() && !mainFrame()->url().fragment().isEmpty()) {
     mainFrame()->scrollToAnchor(mainFrame()->url().fragment());
   }
 }
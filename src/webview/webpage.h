@@ -19,6 +19,7 @@
 #define WEBPAGE_H
 
 #include <QNetworkAccessManager>
+#include <QSet>
 #include <QWebPage>
 #include <QSslCertificate>
 
@@ -68,6 +69,7 @@ private slots:
   void downloadRequested(const QNetworkRequest &request);
   void cleanBlockedObjects();
   void urlChanged(const QUrl &url);
+  void applyElementHiding(const QUrl &url);
 #if QT_VERSION >= 0x050905
   void slotFullScreenRequested(QWebFullScreenRequest fullScreenRequest);
 #endif
@@ -81,6 +83,8 @@ private:
   bool adjustingScheduled_;
   static QList<WebPage*> livingPages_;
   QVector<AdBlockedEntry> adBlockedEntries_;
+  QSet<QByteArray> blockedUrls_;
+  QString elementHiding_;
 
   int loadProgress_;
 
@@ -17,6 +17,8 @@
 * ============================================================ */
 #include "webview.h"
 #include "webpage.h"
+#include "mainapplication.h"
+#include "networkmanager.h"
 
 #include <QApplication>
 #include <QInputEvent>
@@ -161,9 +163,7 @@ void WebView::slotLoadStarted()
 
 void WebView::slotLoadProgress(int value)
 {
-  if (value > 60) {
-    checkRss();
-  }
+  checkRss(value > 60);
 }
 
 void WebView::slotLoadFinished()
@@ -171,16 +171,28 @@ void WebView::slotLoadFinished()
   isLoading_ = false;
 }
 
-void WebView::checkRss()
+/** @brief Show if page has RSS links
+ *
+ * Links are usually found by NetworkManager in received head of page.
+ * Document is searched only when it has not answered and \a queryPage is set.
+ *----------------------------------------------------------------------------*/
+void WebView::checkRss(bool queryPage)
 {
   if (rssChecked_) {
     return;
   }
 
-  rssChecked_ = true;
   QWebFrame* frame = page()->mainFrame();
-  const QWebElementCollection links = frame->findAllElements("link[type=\"application/rss+xml\"]");
+  // Until page is committed url() is the one of previous page
+  QUrl pageUrl = queryPage ? frame->url() : frame->requestedUrl();
+  if (!mainApp->networkManager()->findFeedLinks(pageUrl, &hasRss_)) {
+    if (!queryPage) {
+      return;
+    }
+    const QWebElementCollection links = frame->findAllElements("link[type=\"application/rss+xml\"]");
+    hasRss_ = links.count() != 0;
+  }
 
-  hasRss_ = links.count() != 0;
+  rssChecked_ = true;
   emit rssChanged(hasRss_);
 }
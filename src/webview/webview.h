@@ -59,7 +59,7 @@ private slots:
   void slotLoadStarted();
   void slotLoadProgress(int value);
   void slotLoadFinished();
-  void checkRss();
+  void checkRss(bool queryPage);
 
 private:
   bool isLoading_;